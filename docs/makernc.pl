@@ -85,6 +85,7 @@ my %typehint2xmltype =
    "sched_class" => "Enum",
    "maybe_int32" => "String",
    "maybe_memsize" => "String",
+   "maybe_bandwidth" => "String",
    "maybe_duration_inf" => "String",
    "allow_multicast" => "Comma",
    "transport_selector" => "Enum",
@@ -101,6 +102,7 @@ my %typehint2unit =
    "bandwidth" => "bandwidth",
    "memsize" => "memsize",
    "maybe_memsize" => "memsize",
+   "maybe_bandwidth" => "bandwidth",
    "maybe_duration_inf" => "duration_inf");
 
 my %enum_values =
@@ -486,6 +488,7 @@ sub read_config {
               'DDSI_INCLUDE_SSL' => 1,
               'DDSI_INCLUDE_NETWORK_PARTITIONS' => 1,
               'DDSI_INCLUDE_SSM' => 1,
+              'DDSI_INCLUDE_LATENCY_STATS' => 1,
               # excluded options
               'DDSI_INCLUDE_NETWORK_CHANNELS' => 0,
               'DDSI_INCLUDE_BANDWIDTH_LIMITING' => 0);
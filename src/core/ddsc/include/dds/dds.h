@@ -1768,6 +1768,50 @@ dds_write(dds_entity_t writer, const void *data);
 DDS_EXPORT void
 dds_write_flush(dds_entity_t writer);
 
+/**
+ * @brief Function invoked when the memory of a sample written with dds_write_pinned
+ * is no longer referenced.
+ */
+typedef void (*dds_pinned_release_fn) (void *arg);
+
+/**
+ * @brief Write the value of a data instance without copying the contents of large sequences
+ *
+ * This behaves like dds_write, except that the application guarantees that the
+ * memory of the sample, including the buffers of its sequences, remains valid and
+ * unchanged until "release" has been invoked.  This allows the contents of sequences
+ * of primitive types that are larger than the configured threshold
+ * (Internal/PinnedReferenceThreshold) to be transmitted directly from the
+ * application's memory instead of first being copied.
+ *
+ * The release function is invoked exactly once, also if the operation fails.  This
+ * may be before dds_write_pinned returns, but also much later, as the data may be
+ * needed for retransmits and for late-joining readers, and the function may be
+ * invoked on any thread.
+ *
+ * @param[in]  writer The writer entity.
+ * @param[in]  data Value to be written.
+ * @param[in]  release Function to invoke once the memory is no longer referenced.
+ * @param[in]  arg Argument passed to the release function.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The writer successfully wrote the value.
+ * @retval DDS_RETCODE_ERROR
+ *             An internal error has occurred.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             One of the given arguments is not valid.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_ALREADY_DELETED
+ *             The entity has already been deleted.
+ * @retval DDS_RETCODE_TIMEOUT
+ *             The writer failed to write the value reliably within the specified max_blocking_time.
+ */
+DDS_EXPORT dds_return_t
+dds_write_pinned(dds_entity_t writer, const void *data, dds_pinned_release_fn release, void *arg);
+
 /**
  * @brief Write a serialized value of a data instance
  *
@@ -3142,6 +3186,12 @@ dds_instance_get_key(
  * Invoking on a Writer or Reader behaves as if dds_begin_coherent was invoked on its parent
  * Publisher or Subscriber respectively.
  *
+ * For a Publisher, the samples written by its writers with a PRESENTATION QoS that has
+ * coherent_access set, until the matching dds_end_coherent, form a coherent set per writer.
+ * Readers with coherent_access set hold back such a set until it is complete, then make all
+ * of it available at once.  Calls may be nested, the set ends with the outermost
+ * dds_end_coherent.  For a Subscriber, this is a no-op: sets become visible atomically.
+ *
  * @param[in]  entity The entity that is prepared for coherent access.
  *
  * @returns A dds_return_t indicating success or failure.
@@ -3152,6 +3202,8 @@ dds_instance_get_key(
  *             An internal error has occurred.
  * @retval DDS_RETCODE_BAD_PARAMETER
  *             The provided entity is invalid or not supported.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The provided entity is not a Publisher, Subscriber, Writer or Reader.
  */
 DDS_EXPORT dds_return_t
 dds_begin_coherent(dds_entity_t entity);
@@ -3170,6 +3222,10 @@ dds_begin_coherent(dds_entity_t entity);
  *             The operation was successful.
  * @retval DDS_RETCODE_BAD_PARAMETER
  *             The provided entity is invalid or not supported.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The provided entity is not a Publisher, Subscriber, Writer or Reader.
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET
+ *             The Publisher is not in a coherent set.
  */
 DDS_EXPORT dds_return_t
 dds_end_coherent(dds_entity_t entity);
@@ -3371,6 +3427,112 @@ dds_get_matched_publication_data (
   dds_entity_t reader,
   dds_instance_handle_t ih);
 
+/**
+ * @brief Statistics on the communication with a reader matched with a
+ * writer
+ *
+ * The counters are cumulative from the moment of matching.  Readers in
+ * the same process are served directly and have no statistics, for
+ * those all fields are 0.
+ */
+typedef struct dds_matched_subscription_statistics {
+  /** Estimated round-trip time: from transmitting a sample until the
+      reader acknowledges it, including any delay in acknowledging on
+      the side of the reader; 0 if no estimate is available yet. */
+  dds_duration_t rtt;
+  /** Number of retransmit requests for samples from this reader */
+  uint32_t nacks;
+  /** Number of retransmit requests for fragments from this reader */
+  uint32_t nackfrags;
+  /** Number of samples and fragments retransmitted in response to
+      requests from this reader */
+  uint64_t rexmit_count;
+  /** Number of bytes requested by this reader that were still available */
+  uint64_t nacked_bytes;
+  /** Total time the writer was blocked because its history cache was
+      full while this reader was the one (or one of the ones) furthest
+      behind */
+  dds_duration_t throttled_time;
+} dds_matched_subscription_statistics_t;
+
+/**
+ * @brief Statistics on the communication with a writer matched with a
+ * reader
+ *
+ * The counters are cumulative from the moment of matching.  Writers in
+ * the same process deliver data directly and have no statistics, for
+ * those all fields are 0.
+ */
+typedef struct dds_matched_publication_statistics {
+  /** Number of retransmit requests for samples sent to this writer */
+  uint32_t nacks;
+  /** Number of retransmit requests for fragments sent to this writer */
+  uint32_t nackfrags;
+  /** Number of samples requested (one sample can be requested many times) */
+  uint64_t nacked_samples;
+  /** Number of fragments requested (idem) */
+  uint64_t nacked_fragments;
+} dds_matched_publication_statistics_t;
+
+/**
+ * @brief Get statistics on the communication with a reader matched with
+ * the provided writer
+ *
+ * This operation looks up the reader instance handle in the set of
+ * readers matched with the specified writer and returns the statistics
+ * gathered for that combination.  This is intended for finding slow or
+ * lossy readers without enabling tracing.
+ *
+ * @param[in] writer   The writer.
+ * @param[in] ih       The instance handle of a reader.
+ * @param[out] stats   Where to store the statistics.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The statistics were stored in stats.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The entity parameter is not valid or stats = NULL.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET
+ *             ih is not an instance handle of a matched reader.
+ */
+DDS_EXPORT dds_return_t
+dds_get_matched_subscription_statistics (
+  dds_entity_t writer,
+  dds_instance_handle_t ih,
+  dds_matched_subscription_statistics_t *stats);
+
+/**
+ * @brief Get statistics on the communication with a writer matched with
+ * the provided reader
+ *
+ * This operation looks up the writer instance handle in the set of
+ * writers matched with the specified reader and returns the statistics
+ * gathered for that combination.
+ *
+ * @param[in] reader   The reader.
+ * @param[in] ih       The instance handle of a writer.
+ * @param[out] stats   Where to store the statistics.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The statistics were stored in stats.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The entity parameter is not valid or stats = NULL.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_PRECONDITION_NOT_MET
+ *             ih is not an instance handle of a matched writer.
+ */
+DDS_EXPORT dds_return_t
+dds_get_matched_publication_statistics (
+  dds_entity_t reader,
+  dds_instance_handle_t ih,
+  dds_matched_publication_statistics_t *stats);
+
 /**
  * @brief This operation manually asserts the liveliness of a writer
  * or domain participant.
@@ -3428,6 +3590,74 @@ dds_domain_set_deafmute (
   bool mute,
   dds_duration_t reset_after);
 
+/**
+ * @brief Stages of the data path distinguished in the latency statistics
+ */
+typedef enum dds_latency_stage {
+  DDS_LATENCY_SERIALIZE,  /**< dds_write to serialized sample */
+  DDS_LATENCY_WHC_INSERT, /**< inserting the sample in the writer history cache */
+  DDS_LATENCY_XPACK,      /**< constructing the messages and adding them to a packet */
+  DDS_LATENCY_SEND,       /**< first data added to a packet to the packet being sent */
+  DDS_LATENCY_RECEIVE,    /**< packet received to start of processing the sample */
+  DDS_LATENCY_DEFRAG,     /**< defragmentation and reordering */
+  DDS_LATENCY_DQUEUE,     /**< waiting in the delivery queue */
+  DDS_LATENCY_RHC_INSERT  /**< delivery of received data into the reader history caches */
+} dds_latency_stage_t;
+
+#define DDS_LATENCY_NSTAGES 8
+
+/**
+ * @brief Latency statistics of a single stage of the data path, all times in ns;
+ * the percentiles are accurate to within about 6%
+ */
+typedef struct dds_latency_stage_stats {
+  const char *name;     /**< short name of the stage */
+  uint64_t count;       /**< number of measurements, all others are 0 if count = 0 */
+  dds_duration_t min;
+  dds_duration_t mean;
+  dds_duration_t p50;
+  dds_duration_t p90;
+  dds_duration_t p99;
+  dds_duration_t p999;
+  dds_duration_t max;
+} dds_latency_stage_stats_t;
+
+typedef struct dds_latency_stats {
+  dds_latency_stage_stats_t stage[DDS_LATENCY_NSTAGES]; /**< indexed by dds_latency_stage_t */
+} dds_latency_stats_t;
+
+/**
+ * @brief Retrieves the latency statistics of the data path of application
+ * readers and writers.
+ *
+ * Collecting these statistics requires the library to have been built with
+ * ENABLE_LATENCY_STATS and Internal/LatencyStatistics to be set in the
+ * configuration.  The statistics are kept per thread and cover all domains
+ * in the process since it was initialized, including threads that have since
+ * terminated.  Each stage is measured by the thread performing it, so the
+ * stages of the writing side and the receiving side of a single sample are
+ * not related.
+ *
+ * @param[in]  entity  A domain entity or an entity bound to a domain, such
+ *                     as a participant, reader or writer.
+ * @param[out] stats   Statistics per stage.
+ *
+ * @returns A dds_return_t indicating success or failure.
+ *
+ * @retval DDS_RETCODE_OK
+ *             The operation was successful.
+ * @retval DDS_RETCODE_BAD_PARAMETER
+ *             The entity parameter is not a valid parameter or stats is NULL.
+ * @retval DDS_RETCODE_ILLEGAL_OPERATION
+ *             The operation is invoked on an inappropriate object.
+ * @retval DDS_RETCODE_UNSUPPORTED
+ *             The library was built without support for latency statistics.
+ */
+DDS_EXPORT dds_return_t
+dds_get_latency_stats (
+  dds_entity_t entity,
+  dds_latency_stats_t *stats);
+
 #if defined (__cplusplus)
 }
 #endif
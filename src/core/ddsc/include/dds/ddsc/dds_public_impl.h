@@ -52,6 +52,8 @@ dds_key_descriptor_t;
   API is a pointer to the "topic_descriptor_t" struct type.
 */
 
+struct dds_topic_cdr_ops;
+
 typedef struct dds_topic_descriptor
 {
   const uint32_t m_size;               /* Size of topic type */
@@ -63,6 +65,9 @@ typedef struct dds_topic_descriptor
   const uint32_t m_nops;               /* Number of ops in m_ops */
   const uint32_t * m_ops;              /* Marshalling meta data */
   const char * m_meta;                 /* XML topic description meta data */
+  /* Extensions, only present if indicated by a flag, so that descriptors
+     generated for older versions remain valid */
+  const struct dds_topic_cdr_ops * m_cdr_ops; /* Specialized (de)serializers (iff DDS_TOPIC_CDR_OPS) */
 }
 dds_topic_descriptor_t;
 
@@ -71,6 +76,7 @@ dds_topic_descriptor_t;
 #define DDS_TOPIC_NO_OPTIMIZE 0x0001
 #define DDS_TOPIC_FIXED_KEY 0x0002
 #define DDS_TOPIC_CONTAINS_UNION 0x0004
+#define DDS_TOPIC_CDR_OPS 0x0008
 
 /*
   Masks for read condition, read, take: there is only one mask here,
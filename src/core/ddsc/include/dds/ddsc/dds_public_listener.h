@@ -202,6 +202,26 @@ DDS_EXPORT void dds_lset_publication_matched (dds_listener_t * __restrict listen
  */
 DDS_EXPORT void dds_lset_subscription_matched (dds_listener_t * __restrict listener, dds_on_subscription_matched_fn callback);
 
+/**
+ * @brief Set whether the listener callbacks are invoked asynchronously
+ *
+ * By default, listener callbacks are invoked by the thread that causes the
+ * status change, which usually is a thread receiving or delivering data, so
+ * that a slow callback delays the processing of data for all other readers
+ * served by that thread.  When set, the status changes of a reader are
+ * instead recorded and the callbacks invoked by a small pool of threads owned
+ * by the domain.  Status changes that occur while an invocation is pending are
+ * coalesced into a single invocation.  Callbacks for a single entity are still
+ * invoked one at a time and are no longer invoked once its deletion starts.
+ *
+ * This setting only affects readers and is not inherited by the children of
+ * the entity the listener is set on.
+ *
+ * @param[in,out] listener The pointer to the listener structure
+ * @param[in] async Whether to invoke the callbacks asynchronously
+ */
+DDS_EXPORT void dds_lset_async (dds_listener_t * __restrict listener, bool async);
+
 
 /************************************************************************************************
  *  Getters
@@ -311,6 +331,14 @@ DDS_EXPORT void dds_lget_publication_matched (const dds_listener_t * __restrict
  */
 DDS_EXPORT void dds_lget_subscription_matched (const dds_listener_t * __restrict listener, dds_on_subscription_matched_fn *callback);
 
+/**
+ * @brief Get whether the listener callbacks are invoked asynchronously
+ *
+ * @param[in] listener The pointer to the listener structure
+ * @param[in,out] async Pointer where the setting is stored (false if listener is NULL)
+ */
+DDS_EXPORT void dds_lget_async (const dds_listener_t * __restrict listener, bool *async);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -73,6 +73,9 @@ DDS_EXPORT inline void dds_rhc_relinquish_ownership (struct dds_rhc * __restrict
 DDS_EXPORT inline void dds_rhc_set_qos (struct dds_rhc *rhc, const struct dds_qos *qos) {
   rhc->common.ops->rhc_ops.set_qos (&rhc->common.rhc, qos);
 }
+DDS_EXPORT inline void dds_rhc_commit (struct dds_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo) {
+  rhc->common.ops->rhc_ops.commit (&rhc->common.rhc, wrinfo);
+}
 DDS_EXPORT inline void dds_rhc_free (struct dds_rhc *rhc) {
   rhc->common.ops->rhc_ops.free (&rhc->common.rhc);
 }
@@ -21,6 +21,12 @@ extern "C" {
 DDS_EXPORT dds_entity_t dds_domain_create_internal (dds_domain **domain_out, dds_domainid_t id, bool implicit, const char *config) ddsrt_nonnull((1,4));
 DDS_EXPORT dds_domain *dds_domain_find_locked (dds_domainid_t id);
 
+/* Maximum number of threads invoking asynchronous listeners in a domain */
+#define DDS_LISTENER_EXECUTOR_MAX_THREADS 4
+
+/* Creates the threads for invoking asynchronous listeners if they don't exist yet */
+dds_return_t dds_domain_listener_executor_init (dds_domain *domain);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -86,6 +86,17 @@ DDS_EXPORT void dds_entity_status_signal (dds_entity *e, uint32_t status);
 
 DDS_EXPORT void dds_entity_invoke_listener (const dds_entity *entity, enum dds_status_id which, const void *vst);
 
+/* Asynchronous listener invocation: "schedule" records a status change and,
+   unless one is pending already, submits "job" (with the entity as argument)
+   to the domain's listener executor.  The job repeatedly takes the pending
+   statuses until there are none left and then calls "done".  All of these
+   must be called with m_observers_lock held; "done" releases it.  A pending
+   job counts as a listener invocation in progress (m_cb_pending_count), so
+   deleting the entity or changing its listener waits for it. */
+DDS_EXPORT void dds_entity_async_listener_schedule (dds_entity *e, enum dds_status_id which, void (*job) (void *arg));
+DDS_EXPORT uint32_t dds_entity_async_listener_take (dds_entity *e);
+DDS_EXPORT void dds_entity_async_listener_done (dds_entity *e);
+
 DDS_EXPORT dds_participant *dds_entity_participant (const dds_entity *e);
 DDS_EXPORT const ddsi_guid_t *dds_entity_participant_guid (const dds_entity *e);
 DDS_EXPORT void dds_entity_final_deinit_before_free (dds_entity *e);
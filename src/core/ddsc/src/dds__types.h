@@ -16,6 +16,7 @@
 
 #include "dds/dds.h"
 #include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/thread_pool.h"
 #include "dds/ddsi/q_rtps.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsrt/avl.h"
@@ -61,6 +62,7 @@ typedef bool (*dds_querycondition_filter_with_ctx_fn) (const void * sample, cons
 
 struct dds_listener {
   uint32_t inherited;
+  bool async; /* invoke on the domain's listener executor; not inherited */
   dds_on_inconsistent_topic_fn on_inconsistent_topic;
   void *on_inconsistent_topic_arg;
   dds_on_liveliness_lost_fn on_liveliness_lost;
@@ -154,6 +156,8 @@ typedef struct dds_entity {
   dds_listener_t m_listener;        /* [m_observers_lock] */
   uint32_t m_cb_count;              /* [m_observers_lock] */
   uint32_t m_cb_pending_count;      /* [m_observers_lock] */
+  uint32_t m_cb_async_pending;      /* [m_observers_lock] statuses awaiting an asynchronous listener invocation */
+  bool m_cb_async_scheduled;        /* [m_observers_lock] asynchronous listener job submitted to executor */
   dds_entity_observer *m_observers; /* [m_observers_lock] */
 } dds_entity;
 
@@ -228,6 +232,9 @@ typedef struct dds_domain {
 
   struct ddsi_builtin_topic_interface btif;
   struct ddsi_domaingv gv;
+
+  /* Threads invoking asynchronous listeners, created on first use */
+  ddsrt_thread_pool m_listener_executor; /* [m_entity.m_mutex] */
 } dds_domain;
 
 typedef struct dds_subscriber {
@@ -236,6 +243,7 @@ typedef struct dds_subscriber {
 
 typedef struct dds_publisher {
   struct dds_entity m_entity;
+  uint32_t m_coherent_depth; /* nesting depth of begin_coherent, protected by m_entity.m_mutex */
 } dds_publisher;
 
 typedef struct dds_ktopic {
@@ -314,7 +322,7 @@ typedef struct dds_topic {
   dds_inconsistent_topic_status_t m_inconsistent_topic_status;
 } dds_topic;
 
-typedef uint32_t dds_querycond_mask_t;
+typedef uint64_t dds_querycond_mask_t;
 
 typedef struct dds_readcond {
   dds_entity m_entity;
@@ -325,7 +333,7 @@ typedef struct dds_readcond {
   struct dds_readcond *m_next;
   struct {
     dds_querycondition_filter_fn m_filter;
-    dds_querycond_mask_t m_qcmask; /* condition mask in RHC*/
+    uint32_t m_qcgroup; /* index of filter in RHC query condition bitmaps */
   } m_query;
 } dds_readcond;
 
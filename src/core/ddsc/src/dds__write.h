@@ -33,6 +33,10 @@ dds_return_t dds_write_impl (dds_writer *wr, const void *data, dds_time_t tstamp
 dds_return_t dds_writecdr_impl (dds_writer *wr, struct ddsi_serdata *d, dds_time_t tstamp, dds_write_action action);
 dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d, bool flush);
 
+/* Begin/end a coherent set on the writer, on behalf of its publisher; m_mutex must be held */
+void dds_write_begin_coherent (dds_writer *wr);
+dds_return_t dds_write_end_coherent (dds_writer *wr);
+
 #if defined (__cplusplus)
 }
 #endif
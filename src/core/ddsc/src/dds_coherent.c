@@ -16,14 +16,43 @@
 #include "dds__subscriber.h"
 #include "dds__publisher.h"
 
+static dds_return_t dds_coherent_impl (dds_entity_t entity, bool begin)
+{
+  /* readers and writers forward to their subscriber/publisher */
+  dds_entity *e;
+  dds_entity_t parent;
+  bool publisher;
+  dds_return_t ret;
+  if ((ret = dds_entity_pin (entity, &e)) != DDS_RETCODE_OK)
+    return ret;
+  switch (dds_entity_kind (e))
+  {
+    case DDS_KIND_READER:
+    case DDS_KIND_WRITER:
+      parent = e->m_parent->m_hdllink.hdl;
+      break;
+    case DDS_KIND_PUBLISHER:
+    case DDS_KIND_SUBSCRIBER:
+      parent = entity;
+      break;
+    default:
+      dds_entity_unpin (e);
+      return DDS_RETCODE_ILLEGAL_OPERATION;
+  }
+  publisher = (dds_entity_kind (e) == DDS_KIND_WRITER || dds_entity_kind (e) == DDS_KIND_PUBLISHER);
+  dds_entity_unpin (e);
+  if (publisher)
+    return begin ? dds_publisher_begin_coherent (parent) : dds_publisher_end_coherent (parent);
+  else
+    return begin ? dds_subscriber_begin_coherent (parent) : dds_subscriber_end_coherent (parent);
+}
+
 dds_return_t dds_begin_coherent (dds_entity_t entity)
 {
-  static const dds_entity_kind_t kinds[] = { DDS_KIND_READER, DDS_KIND_WRITER, DDS_KIND_PUBLISHER, DDS_KIND_SUBSCRIBER };
-  return dds_generic_unimplemented_operation_manykinds (entity, sizeof (kinds) / sizeof (kinds[0]), kinds);
+  return dds_coherent_impl (entity, true);
 }
 
 dds_return_t dds_end_coherent (dds_entity_t entity)
 {
-  static const dds_entity_kind_t kinds[] = { DDS_KIND_READER, DDS_KIND_WRITER, DDS_KIND_PUBLISHER, DDS_KIND_SUBSCRIBER };
-  return dds_generic_unimplemented_operation_manykinds (entity, sizeof (kinds) / sizeof (kinds[0]), kinds);
+  return dds_coherent_impl (entity, false);
 }
@@ -14,6 +14,7 @@
 #include "dds/ddsrt/process.h"
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsrt/static_assert.h"
 #include "dds__init.h"
 #include "dds/ddsc/dds_rhc.h"
 #include "dds__domain.h"
@@ -28,6 +29,7 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_gc.h"
 #include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_latency_stats.h"
 
 static dds_return_t dds_domain_free (dds_entity *vdomain);
 
@@ -268,6 +270,9 @@ static dds_return_t dds_domain_free (dds_entity *vdomain)
 
   rtps_fini (&domain->gv);
 
+  /* all readers are gone, and with them any pending asynchronous listener invocations */
+  ddsrt_thread_pool_free (domain->m_listener_executor);
+
   /* tearing down the top-level object has more consequences, so it waits until signalled that all
      domains have been removed */
   ddsrt_mutex_lock (&dds_global.m_mutex);
@@ -286,6 +291,19 @@ static dds_return_t dds_domain_free (dds_entity *vdomain)
   return DDS_RETCODE_NO_DATA;
 }
 
+dds_return_t dds_domain_listener_executor_init (dds_domain *domain)
+{
+  dds_return_t ret = DDS_RETCODE_OK;
+  ddsrt_mutex_lock (&domain->m_entity.m_mutex);
+  if (domain->m_listener_executor == NULL)
+  {
+    if ((domain->m_listener_executor = ddsrt_thread_pool_new (1, DDS_LISTENER_EXECUTOR_MAX_THREADS, 0, NULL)) == NULL)
+      ret = DDS_RETCODE_OUT_OF_RESOURCES;
+  }
+  ddsrt_mutex_unlock (&domain->m_entity.m_mutex);
+  return ret;
+}
+
 dds_return_t dds_domain_set_deafmute (dds_entity_t entity, bool deaf, bool mute, dds_duration_t reset_after)
 {
   struct dds_entity *e;
@@ -303,6 +321,59 @@ dds_return_t dds_domain_set_deafmute (dds_entity_t entity, bool deaf, bool mute,
   return rc;
 }
 
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+DDSRT_STATIC_ASSERT (DDS_LATENCY_NSTAGES == DDSI_LATENCY_NSTAGES &&
+                     (int) DDS_LATENCY_SERIALIZE == (int) DDSI_LATENCY_SERIALIZE &&
+                     (int) DDS_LATENCY_RHC_INSERT == (int) DDSI_LATENCY_RHC_INSERT);
+
+dds_return_t dds_get_latency_stats (dds_entity_t entity, dds_latency_stats_t *stats)
+{
+  struct dds_entity *e;
+  dds_return_t rc;
+  if (stats == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((rc = dds_entity_pin (entity, &e)) < 0)
+    return rc;
+  if (e->m_domain == NULL)
+    rc = DDS_RETCODE_ILLEGAL_OPERATION;
+  else
+  {
+    /* the statistics are process-wide, the entity is only needed to guarantee
+       the thread states exist */
+    struct ddsi_latency_stats *st = ddsrt_malloc (sizeof (*st));
+    ddsi_latency_stats_get_all (st);
+    for (int i = 0; i < DDS_LATENCY_NSTAGES; i++)
+    {
+      const struct ddsi_latency_hist *h = &st->stage[i];
+      dds_latency_stage_stats_t *s = &stats->stage[i];
+      memset (s, 0, sizeof (*s));
+      s->name = ddsi_latency_stage_name ((enum ddsi_latency_stage) i);
+      if ((s->count = h->count) > 0)
+      {
+        s->min = h->min;
+        s->mean = h->sum / (int64_t) h->count;
+        s->p50 = ddsi_latency_hist_percentile (h, 0.5);
+        s->p90 = ddsi_latency_hist_percentile (h, 0.9);
+        s->p99 = ddsi_latency_hist_percentile (h, 0.99);
+        s->p999 = ddsi_latency_hist_percentile (h, 0.999);
+        s->max = h->max;
+      }
+    }
+    ddsrt_free (st);
+    rc = DDS_RETCODE_OK;
+  }
+  dds_entity_unpin (e);
+  return rc;
+}
+#else
+dds_return_t dds_get_latency_stats (dds_entity_t entity, dds_latency_stats_t *stats)
+{
+  (void) entity;
+  (void) stats;
+  return DDS_RETCODE_UNSUPPORTED;
+}
+#endif
+
 #include "dds__entity.h"
 static void pushdown_set_batch (struct dds_entity *e, bool enable)
 {
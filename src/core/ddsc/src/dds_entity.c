@@ -15,6 +15,7 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/log.h"
 #include "dds__entity.h"
+#include "dds__domain.h"
 #include "dds__write.h"
 #include "dds__writer.h"
 #include "dds__reader.h"
@@ -201,6 +202,8 @@ dds_entity_t dds_entity_init (dds_entity *e, dds_entity *parent, dds_entity_kind
   e->m_qos = qos;
   e->m_cb_count = 0;
   e->m_cb_pending_count = 0;
+  e->m_cb_async_pending = 0;
+  e->m_cb_async_scheduled = false;
   e->m_observers = NULL;
 
   /* TODO: CHAM-96: Implement dynamic enabling of entity. */
@@ -1003,6 +1006,42 @@ void dds_entity_invoke_listener (const dds_entity *entity, enum dds_status_id wh
   }
 }
 
+void dds_entity_async_listener_schedule (dds_entity *e, enum dds_status_id which, void (*job) (void *arg))
+{
+  /* m_observers_lock held; the executor is guaranteed to exist because it is
+     created before an asynchronous listener is installed */
+  e->m_cb_async_pending |= 1u << which;
+  if (!e->m_cb_async_scheduled)
+  {
+    e->m_cb_async_scheduled = true;
+    e->m_cb_pending_count++;
+    const dds_return_t rc = ddsrt_thread_pool_submit (e->m_domain->m_listener_executor, job, e);
+    assert (rc == DDS_RETCODE_OK);
+    (void) rc;
+  }
+}
+
+uint32_t dds_entity_async_listener_take (dds_entity *e)
+{
+  /* m_observers_lock held; statuses that have been disabled in the meantime
+     (e.g., because the entity is being deleted) are dropped */
+  const uint32_t enabled = ddsrt_atomic_ld32 (&e->m_status.m_status_and_mask) >> SAM_ENABLED_SHIFT;
+  const uint32_t pending = e->m_cb_async_pending & enabled;
+  e->m_cb_async_pending = 0;
+  return pending;
+}
+
+void dds_entity_async_listener_done (dds_entity *e)
+{
+  /* m_observers_lock held, released on return: the entity may be freed
+     immediately after */
+  assert (e->m_cb_async_scheduled && e->m_cb_async_pending == 0);
+  e->m_cb_async_scheduled = false;
+  e->m_cb_pending_count--;
+  ddsrt_cond_broadcast (&e->m_observers_cond);
+  ddsrt_mutex_unlock (&e->m_observers_lock);
+}
+
 static void clear_status_with_listener (struct dds_entity *e)
 {
   const struct dds_listener *lst = &e->m_listener;
@@ -1080,6 +1119,15 @@ dds_return_t dds_set_listener (dds_entity_t entity, const dds_listener_t *listen
   if ((rc = dds_entity_pin (entity, &e)) != DDS_RETCODE_OK)
     return rc;
 
+  if (listener && listener->async && dds_entity_kind (e) == DDS_KIND_READER)
+  {
+    if ((rc = dds_domain_listener_executor_init (e->m_domain)) != DDS_RETCODE_OK)
+    {
+      dds_entity_unpin (e);
+      return rc;
+    }
+  }
+
   ddsrt_mutex_lock (&e->m_observers_lock);
   while (e->m_cb_pending_count > 0)
     ddsrt_cond_wait (&e->m_observers_cond, &e->m_observers_lock);
@@ -55,6 +55,7 @@ void dds_reset_listener (dds_listener_t * __restrict listener)
   {
     dds_listener_t * const l = listener;
     l->inherited = 0;
+    l->async = false;
     l->on_data_available = 0;
     l->on_data_on_readers = 0;
     l->on_inconsistent_topic = 0;
@@ -202,6 +203,7 @@ void dds_merge_listener (dds_listener_t * __restrict dst, const dds_listener_t *
     uint32_t inherited = dst->inherited;
     dds_combine_listener (dds_combine_listener_merge, dst, src);
     dst->inherited = inherited;
+    dst->async = dst->async || src->async;
   }
 }
 
@@ -292,6 +294,12 @@ void dds_lset_subscription_matched (dds_listener_t * __restrict listener, dds_on
     listener->on_subscription_matched = callback;
 }
 
+void dds_lset_async (dds_listener_t * __restrict listener, bool async)
+{
+  if (listener)
+    listener->async = async;
+}
+
 /************************************************************************************************
  *  Getters
  ************************************************************************************************/
@@ -373,3 +381,9 @@ void dds_lget_subscription_matched (const dds_listener_t * __restrict listener,
   if (callback)
     *callback = listener ? listener->on_subscription_matched : 0;
 }
+
+void dds_lget_async (const dds_listener_t * __restrict listener, bool *async)
+{
+  if (async)
+    *async = listener ? listener->async : false;
+}
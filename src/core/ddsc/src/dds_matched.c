@@ -226,3 +226,106 @@ dds_builtintopic_endpoint_t *dds_get_matched_publication_data (dds_entity_t read
     return ret;
   }
 }
+
+dds_return_t dds_get_matched_subscription_statistics (dds_entity_t writer, dds_instance_handle_t ih, dds_matched_subscription_statistics_t *stats)
+{
+  dds_writer *wr;
+  dds_return_t rc;
+  if (stats == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((rc = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+    return rc;
+  else
+  {
+    const struct entity_index *gh = wr->m_entity.m_domain->gv.entity_index;
+    ddsrt_avl_iter_t it;
+    rc = DDS_RETCODE_PRECONDITION_NOT_MET;
+    memset (stats, 0, sizeof (*stats));
+    thread_state_awake (lookup_thread_state (), &wr->m_entity.m_domain->gv);
+    ddsrt_mutex_lock (&wr->m_wr->e.lock);
+    for (const struct wr_prd_match *m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->m_wr->readers, &it);
+         m != NULL && rc != DDS_RETCODE_OK;
+         m = ddsrt_avl_iter_next (&it))
+    {
+      struct proxy_reader *prd;
+      if ((prd = entidx_lookup_proxy_reader_guid (gh, &m->prd_guid)) != NULL && prd->e.iid == ih)
+      {
+        stats->rtt = (dds_duration_t) (nn_lat_estim_current (&m->rtt) * 1e3);
+        stats->nacks = m->rexmit_requests;
+        stats->nackfrags = m->rexmit_frag_requests;
+        stats->rexmit_count = m->rexmit_count;
+        stats->nacked_bytes = m->nacked_bytes;
+        stats->throttled_time = m->throttled_time;
+        rc = DDS_RETCODE_OK;
+      }
+    }
+    for (const struct wr_rd_match *m = ddsrt_avl_iter_first (&wr_local_readers_treedef, &wr->m_wr->local_readers, &it);
+         m != NULL && rc != DDS_RETCODE_OK;
+         m = ddsrt_avl_iter_next (&it))
+    {
+      struct reader *rd;
+      if ((rd = entidx_lookup_reader_guid (gh, &m->rd_guid)) != NULL && rd->e.iid == ih)
+        rc = DDS_RETCODE_OK;
+    }
+    ddsrt_mutex_unlock (&wr->m_wr->e.lock);
+    thread_state_asleep (lookup_thread_state ());
+    dds_writer_unlock (wr);
+    return rc;
+  }
+}
+
+dds_return_t dds_get_matched_publication_statistics (dds_entity_t reader, dds_instance_handle_t ih, dds_matched_publication_statistics_t *stats)
+{
+  dds_reader *rd;
+  dds_return_t rc;
+  if (stats == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if ((rc = dds_reader_lock (reader, &rd)) != DDS_RETCODE_OK)
+    return rc;
+  else
+  {
+    const struct entity_index *gh = rd->m_entity.m_domain->gv.entity_index;
+    struct proxy_writer *pwr = NULL;
+    ddsrt_avl_iter_t it;
+    rc = DDS_RETCODE_PRECONDITION_NOT_MET;
+    memset (stats, 0, sizeof (*stats));
+    thread_state_awake (lookup_thread_state (), &rd->m_entity.m_domain->gv);
+    ddsrt_mutex_lock (&rd->m_rd->e.lock);
+    for (const struct rd_pwr_match *m = ddsrt_avl_iter_first (&rd_writers_treedef, &rd->m_rd->writers, &it);
+         m != NULL && pwr == NULL;
+         m = ddsrt_avl_iter_next (&it))
+    {
+      struct proxy_writer *x;
+      if ((x = entidx_lookup_proxy_writer_guid (gh, &m->pwr_guid)) != NULL && x->e.iid == ih)
+        pwr = x;
+    }
+    for (const struct rd_wr_match *m = ddsrt_avl_iter_first (&rd_local_writers_treedef, &rd->m_rd->local_writers, &it);
+         m != NULL && pwr == NULL && rc != DDS_RETCODE_OK;
+         m = ddsrt_avl_iter_next (&it))
+    {
+      struct writer *wr;
+      if ((wr = entidx_lookup_writer_guid (gh, &m->wr_guid)) != NULL && wr->e.iid == ih)
+        rc = DDS_RETCODE_OK;
+    }
+    ddsrt_mutex_unlock (&rd->m_rd->e.lock);
+    if (pwr != NULL)
+    {
+      /* the statistics are protected by the proxy writer's lock, which
+         is better not nested inside the reader's */
+      const struct pwr_rd_match *m;
+      ddsrt_mutex_lock (&pwr->e.lock);
+      if ((m = ddsrt_avl_lookup (&pwr_readers_treedef, &pwr->readers, &rd->m_rd->e.guid)) != NULL)
+      {
+        stats->nacks = m->nacks_sent;
+        stats->nackfrags = m->nackfrags_sent;
+        stats->nacked_samples = m->nacked_samples;
+        stats->nacked_fragments = m->nacked_fragments;
+        rc = DDS_RETCODE_OK;
+      }
+      ddsrt_mutex_unlock (&pwr->e.lock);
+    }
+    thread_state_asleep (lookup_thread_state ());
+    dds_reader_unlock (rd);
+    return rc;
+  }
+}
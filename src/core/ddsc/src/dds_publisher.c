@@ -16,6 +16,7 @@
 #include "dds__participant.h"
 #include "dds__publisher.h"
 #include "dds__writer.h"
+#include "dds__write.h"
 #include "dds__qos.h"
 #include "dds/ddsi/ddsi_iid.h"
 #include "dds/ddsi/q_entity.h"
@@ -64,6 +65,7 @@ dds_entity_t dds__create_publisher_l (dds_participant *par, bool implicit, const
   }
 
   pub = dds_alloc (sizeof (*pub));
+  pub->m_coherent_depth = 0;
   hdl = dds_entity_init (&pub->m_entity, &par->m_entity, DDS_KIND_PUBLISHER, implicit, new_qos, listener, DDS_PUBLISHER_STATUS_MASK);
   pub->m_entity.m_iid = ddsi_iid_gen ();
   dds_entity_register_child (&par->m_entity, &pub->m_entity);
@@ -124,12 +126,57 @@ dds_return_t dds_wait_for_acks (dds_entity_t publisher_or_writer, dds_duration_t
   }
 }
 
+static dds_return_t publisher_coherent_writers (dds_publisher *pub, bool begin)
+{
+  /* Pre: pub locked; lock order is publisher, then writer */
+  dds_return_t ret = DDS_RETCODE_OK;
+  ddsrt_avl_iter_t it;
+  for (dds_entity *e = ddsrt_avl_iter_first (&dds_entity_children_td, &pub->m_entity.m_children, &it); e != NULL; e = ddsrt_avl_iter_next (&it))
+  {
+    dds_entity *x;
+    if (dds_entity_kind (e) != DDS_KIND_WRITER)
+      continue;
+    /* writers that are being deleted can't be pinned and needn't be bothered */
+    if (dds_entity_pin (e->m_hdllink.hdl, &x) != DDS_RETCODE_OK)
+      continue;
+    assert (x == e);
+    ddsrt_mutex_lock (&x->m_mutex);
+    if (begin)
+      dds_write_begin_coherent ((dds_writer *) x);
+    else
+    {
+      dds_return_t rc = dds_write_end_coherent ((dds_writer *) x);
+      if (rc != DDS_RETCODE_OK && ret == DDS_RETCODE_OK)
+        ret = rc;
+    }
+    ddsrt_mutex_unlock (&x->m_mutex);
+    dds_entity_unpin (x);
+  }
+  return ret;
+}
+
 dds_return_t dds_publisher_begin_coherent (dds_entity_t publisher)
 {
-  return dds_generic_unimplemented_operation (publisher, DDS_KIND_PUBLISHER);
+  dds_publisher *pub;
+  dds_return_t ret;
+  if ((ret = dds_publisher_lock (publisher, &pub)) != DDS_RETCODE_OK)
+    return ret;
+  if (pub->m_coherent_depth++ == 0)
+    ret = publisher_coherent_writers (pub, true);
+  dds_publisher_unlock (pub);
+  return ret;
 }
 
 dds_return_t dds_publisher_end_coherent (dds_entity_t publisher)
 {
-  return dds_generic_unimplemented_operation (publisher, DDS_KIND_PUBLISHER);
+  dds_publisher *pub;
+  dds_return_t ret;
+  if ((ret = dds_publisher_lock (publisher, &pub)) != DDS_RETCODE_OK)
+    return ret;
+  if (pub->m_coherent_depth == 0)
+    ret = DDS_RETCODE_PRECONDITION_NOT_MET;
+  else if (--pub->m_coherent_depth == 0)
+    ret = publisher_coherent_writers (pub, false);
+  dds_publisher_unlock (pub);
+  return ret;
 }
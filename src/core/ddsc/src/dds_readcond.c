@@ -50,7 +50,7 @@ dds_readcond *dds_create_readcond (dds_reader *rd, dds_entity_kind_t kind, uint3
   if (kind == DDS_KIND_COND_QUERY)
   {
     cond->m_query.m_filter = filter;
-    cond->m_query.m_qcmask = 0;
+    cond->m_query.m_qcgroup = 0;
   }
   if (!dds_rhc_add_readcondition (rd->m_rhc, cond))
   {
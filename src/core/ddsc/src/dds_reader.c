@@ -16,6 +16,7 @@
 #include "dds/ddsrt/static_assert.h"
 #include "dds__participant.h"
 #include "dds__subscriber.h"
+#include "dds__domain.h"
 #include "dds__reader.h"
 #include "dds__listener.h"
 #include "dds__init.h"
@@ -105,26 +106,10 @@ static dds_return_t dds_reader_status_validate (uint32_t mask)
   return (mask & ~DDS_READER_STATUS_MASK) ? DDS_RETCODE_BAD_PARAMETER : DDS_RETCODE_OK;
 }
 
-void dds_reader_data_available_cb (struct dds_reader *rd)
+static void dds_reader_invoke_data_available_listener (struct dds_reader *rd)
 {
-  /* DATA_AVAILABLE is special in two ways: firstly, it should first try
-     DATA_ON_READERS on the line of ancestors, and if not consumed set the
-     status on the subscriber; secondly it is the only one for which
-     overhead really matters.  Otherwise, it is pretty much like
-     dds_reader_status_cb. */
-
-  const uint32_t data_av_enabled = (ddsrt_atomic_ld32 (&rd->m_entity.m_status.m_status_and_mask) & (DDS_DATA_AVAILABLE_STATUS << SAM_ENABLED_SHIFT));
-  if (data_av_enabled == 0)
-    return;
-
-  ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
-  rd->m_entity.m_cb_pending_count++;
-
-  /* FIXME: why wait if no listener is set? */
-  while (rd->m_entity.m_cb_count > 0)
-    ddsrt_cond_wait (&rd->m_entity.m_observers_cond, &rd->m_entity.m_observers_lock);
-  rd->m_entity.m_cb_count++;
-
+  /* m_observers_lock held and m_cb_count raised, one of on_data_on_readers
+     and on_data_available set; the lock is released during the invocation */
   struct dds_listener const * const lst = &rd->m_entity.m_listener;
   dds_entity * const sub = rd->m_entity.m_parent;
   if (lst->on_data_on_readers)
@@ -150,12 +135,138 @@ void dds_reader_data_available_cb (struct dds_reader *rd)
     ddsrt_mutex_unlock (&sub->m_observers_lock);
     ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
   }
-  else if (rd->m_entity.m_listener.on_data_available)
+  else
   {
+    assert (lst->on_data_available);
     ddsrt_mutex_unlock (&rd->m_entity.m_observers_lock);
     lst->on_data_available (rd->m_entity.m_hdllink.hdl, lst->on_data_available_arg);
     ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
   }
+}
+
+union dds_reader_listener_status {
+  struct dds_requested_deadline_missed_status requested_deadline_missed;
+  struct dds_requested_incompatible_qos_status requested_incompatible_qos;
+  struct dds_sample_lost_status sample_lost;
+  struct dds_sample_rejected_status sample_rejected;
+  struct dds_liveliness_changed_status liveliness_changed;
+  struct dds_subscription_matched_status subscription_matched;
+};
+
+static void dds_reader_take_listener_status (struct dds_reader *rd, enum dds_status_id status_id, union dds_reader_listener_status *st)
+{
+  /* m_observers_lock held: copies the status for passing it to the listener
+     and resets the change counters, like a synchronous invocation does */
+  switch (status_id)
+  {
+    case DDS_REQUESTED_DEADLINE_MISSED_STATUS_ID:
+      st->requested_deadline_missed = rd->m_requested_deadline_missed_status;
+      rd->m_requested_deadline_missed_status.total_count_change = 0;
+      break;
+    case DDS_REQUESTED_INCOMPATIBLE_QOS_STATUS_ID:
+      st->requested_incompatible_qos = rd->m_requested_incompatible_qos_status;
+      rd->m_requested_incompatible_qos_status.total_count_change = 0;
+      break;
+    case DDS_SAMPLE_LOST_STATUS_ID:
+      st->sample_lost = rd->m_sample_lost_status;
+      rd->m_sample_lost_status.total_count_change = 0;
+      break;
+    case DDS_SAMPLE_REJECTED_STATUS_ID:
+      st->sample_rejected = rd->m_sample_rejected_status;
+      rd->m_sample_rejected_status.total_count_change = 0;
+      break;
+    case DDS_LIVELINESS_CHANGED_STATUS_ID:
+      st->liveliness_changed = rd->m_liveliness_changed_status;
+      rd->m_liveliness_changed_status.alive_count_change = 0;
+      rd->m_liveliness_changed_status.not_alive_count_change = 0;
+      break;
+    case DDS_SUBSCRIPTION_MATCHED_STATUS_ID:
+      st->subscription_matched = rd->m_subscription_matched_status;
+      rd->m_subscription_matched_status.total_count_change = 0;
+      rd->m_subscription_matched_status.current_count_change = 0;
+      break;
+    case DDS_DATA_ON_READERS_STATUS_ID:
+    case DDS_DATA_AVAILABLE_STATUS_ID:
+    case DDS_INCONSISTENT_TOPIC_STATUS_ID:
+    case DDS_LIVELINESS_LOST_STATUS_ID:
+    case DDS_PUBLICATION_MATCHED_STATUS_ID:
+    case DDS_OFFERED_DEADLINE_MISSED_STATUS_ID:
+    case DDS_OFFERED_INCOMPATIBLE_QOS_STATUS_ID:
+      assert (0);
+  }
+}
+
+static void dds_reader_async_listener_job (void *varg)
+{
+  /* Runs on the listener executor.  Invocations remain serialized with any
+     synchronous ones (the listener may have been changed from synchronous
+     to asynchronous while one was in progress) through m_cb_count.  Status
+     changes occurring while the listener is called are picked up in the
+     next iteration, so at most one job per reader is outstanding. */
+  struct dds_reader * const rd = varg;
+  uint32_t pending;
+  ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
+  while (rd->m_entity.m_cb_count > 0)
+    ddsrt_cond_wait (&rd->m_entity.m_observers_cond, &rd->m_entity.m_observers_lock);
+  rd->m_entity.m_cb_count++;
+  while ((pending = dds_entity_async_listener_take (&rd->m_entity)) != 0)
+  {
+    if (pending & DDS_DATA_AVAILABLE_STATUS)
+    {
+      dds_reader_invoke_data_available_listener (rd);
+      pending &= ~DDS_DATA_AVAILABLE_STATUS;
+    }
+    for (uint32_t id = 0; pending != 0; id++)
+    {
+      if (!(pending & (1u << id)))
+        continue;
+      const enum dds_status_id status_id = (enum dds_status_id) id;
+      union dds_reader_listener_status st;
+      pending &= ~(1u << id);
+      dds_reader_take_listener_status (rd, status_id, &st);
+      ddsrt_mutex_unlock (&rd->m_entity.m_observers_lock);
+      dds_entity_invoke_listener (&rd->m_entity, status_id, &st);
+      ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
+    }
+  }
+  rd->m_entity.m_cb_count--;
+  dds_entity_async_listener_done (&rd->m_entity);
+}
+
+void dds_reader_data_available_cb (struct dds_reader *rd)
+{
+  /* DATA_AVAILABLE is special in two ways: firstly, it should first try
+     DATA_ON_READERS on the line of ancestors, and if not consumed set the
+     status on the subscriber; secondly it is the only one for which
+     overhead really matters.  Otherwise, it is pretty much like
+     dds_reader_status_cb. */
+
+  const uint32_t data_av_enabled = (ddsrt_atomic_ld32 (&rd->m_entity.m_status.m_status_and_mask) & (DDS_DATA_AVAILABLE_STATUS << SAM_ENABLED_SHIFT));
+  if (data_av_enabled == 0)
+    return;
+
+  struct dds_listener const * const lst = &rd->m_entity.m_listener;
+  dds_entity * const sub = rd->m_entity.m_parent;
+  ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
+  if (lst->async && (lst->on_data_on_readers || lst->on_data_available))
+  {
+    /* no need to wait for an invocation in progress: that's the job's problem */
+    dds_entity_async_listener_schedule (&rd->m_entity, DDS_DATA_AVAILABLE_STATUS_ID, dds_reader_async_listener_job);
+    ddsrt_mutex_unlock (&rd->m_entity.m_observers_lock);
+    return;
+  }
+
+  rd->m_entity.m_cb_pending_count++;
+
+  /* FIXME: why wait if no listener is set? */
+  while (rd->m_entity.m_cb_count > 0)
+    ddsrt_cond_wait (&rd->m_entity.m_observers_cond, &rd->m_entity.m_observers_lock);
+  rd->m_entity.m_cb_count++;
+
+  if (lst->on_data_on_readers || lst->on_data_available)
+  {
+    dds_reader_invoke_data_available_listener (rd);
+  }
   else
   {
     dds_entity_status_set (&rd->m_entity, DDS_DATA_AVAILABLE_STATUS);
@@ -205,8 +316,11 @@ void dds_reader_status_cb (void *ventity, const status_cb_data_t *data)
      and that similarly the listener function and argument pointers
      are stable */
   /* FIXME: why do this if no listener is set? */
+  /* Asynchronous listeners get a copy of the status taken while holding
+     m_observers_lock, so there is no need to wait for them */
   ddsrt_mutex_lock (&rd->m_entity.m_observers_lock);
-  while (rd->m_entity.m_cb_count > 0)
+  const bool async = lst->async;
+  while (!async && rd->m_entity.m_cb_count > 0)
     ddsrt_cond_wait (&rd->m_entity.m_observers_cond, &rd->m_entity.m_observers_lock);
 
   /* Update status metrics. */
@@ -326,6 +440,10 @@ void dds_reader_status_cb (void *ventity, const status_cb_data_t *data)
   {
     /* Don't invoke listeners or set status flag if masked */
   }
+  else if (invoke && async)
+  {
+    dds_entity_async_listener_schedule (&rd->m_entity, status_id, dds_reader_async_listener_job);
+  }
   else if (invoke)
   {
     rd->m_entity.m_cb_pending_count++;
@@ -456,6 +574,12 @@ static dds_entity_t dds_create_reader_int (dds_entity_t participant_or_subscribe
     goto err_bad_qos;
   }
 
+  if (listener && listener->async && (rc = dds_domain_listener_executor_init (sub->m_entity.m_domain)) != DDS_RETCODE_OK)
+  {
+    dds_delete_qos (rqos);
+    goto err_bad_qos;
+  }
+
   /* Create reader and associated read cache (if not provided by caller) */
   struct dds_reader * const rd = dds_alloc (sizeof (*rd));
   const dds_entity_t reader = dds_entity_init (&rd->m_entity, &sub->m_entity, DDS_KIND_READER, false, rqos, listener, DDS_READER_STATUS_MASK);
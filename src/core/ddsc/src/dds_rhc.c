@@ -19,6 +19,7 @@ extern inline bool dds_rhc_store (struct dds_rhc * __restrict rhc, const struct
 extern inline void dds_rhc_unregister_wr (struct dds_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict pwr_info);
 extern inline void dds_rhc_relinquish_ownership (struct dds_rhc * __restrict rhc, const uint64_t wr_iid);
 extern inline void dds_rhc_set_qos (struct dds_rhc *rhc, const struct dds_qos *qos);
+extern inline void dds_rhc_commit (struct dds_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo);
 extern inline void dds_rhc_free (struct dds_rhc *rhc);
 extern inline int dds_rhc_read (struct dds_rhc *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, uint32_t mask, dds_instance_handle_t handle, struct dds_readcond *cond);
 extern inline int dds_rhc_take (struct dds_rhc *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, uint32_t mask, dds_instance_handle_t handle, struct dds_readcond *cond);
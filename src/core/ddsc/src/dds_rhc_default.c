@@ -22,6 +22,8 @@
 
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/static_assert.h"
 
 #include "dds__entity.h"
 #include "dds__reader.h"
@@ -152,6 +154,31 @@
    from 0 to 1, as this indicates the attached waitsets must be signalled.
    The actual signalling of the waitsets then takes places later, by calling
    "signal_conditions" after releasing the RHC lock.
+
+   QUERY CONDITIONS
+   ================
+
+   Query conditions additionally cache the result of their filter in each
+   instance (for the invalid sample) and each sample.  Conditions with the
+   same filter function share a "group" and thus a bit, so that a filter is
+   evaluated only once per sample no matter how many conditions use it.  The
+   bits are stored in bitmaps of "nwords" words allocated from pages owned
+   by the RHC; adding a group beyond the current width moves all bitmaps to
+   wider ones.  An instance or sample has no bitmap at all while there are
+   no query conditions.
+
+   COHERENT SETS
+   =============
+
+   If the reader has PRESENTATION coherent_access set, samples that are part
+   of a coherent set (i.e., have a non-zero "coherent_set_seq" in the writer
+   info) are not stored but held in a per-writer pending set, protected by
+   "coherent_lock" rather than by the RHC lock.  When the writer commits the
+   set, all its samples are stored in one go under a single acquisition of
+   the RHC lock, after which the listener is invoked once and each triggered
+   waitset is signalled once.  A pending set is discarded when a sample
+   arrives from the same writer that is not part of it (because the commit
+   got lost), or when the writer disappears.
 */
 
 /* FIXME: tkmap should perhaps retain data with timestamp set to invalid
@@ -160,7 +187,8 @@
    even when generating an invalid sample for an unregister message using
    the tkmap data. */
 
-#define MAX_ATTACHED_QUERYCONDS (CHAR_BIT * sizeof (dds_querycond_mask_t))
+#define QC_WORD_BITS (CHAR_BIT * sizeof (dds_querycond_mask_t))
+#define QCPAGE_NBITMAPS 256
 #define MAX_FAST_TRIGGERS 32
 
 #define INCLUDE_TRACE 1
@@ -246,12 +274,12 @@ struct rhc_sample {
   struct ddsi_serdata *sample; /* serialised data (either just_key or real data) */
   struct rhc_sample *next;     /* next sample in time ordering, or oldest sample if most recent */
   uint64_t wr_iid;             /* unique id for writer of this sample (perhaps better in serdata) */
-  dds_querycond_mask_t conds;  /* matching query conditions */
+  dds_querycond_mask_t *conds; /* matching query condition groups, NULL if no qconds */
   bool isread;                 /* READ or NOT_READ sample state */
   uint32_t disposed_gen;       /* snapshot of instance counter at time of insertion */
   uint32_t no_writers_gen;     /* __/ */
 #ifdef DDSI_INCLUDE_LIFESPAN
-  struct lifespan_fhnode lifespan;  /* fibheap node for lifespan */
+  struct lifespan_node lifespan;  /* expiry node for lifespan */
   struct rhc_instance *inst;   /* reference to rhc instance */
 #endif
 };
@@ -262,7 +290,7 @@ struct rhc_instance {
   struct rhc_sample *latest;   /* latest received sample; circular list old->new; null if no sample */
   uint32_t nvsamples;          /* number of "valid" samples in instance */
   uint32_t nvread;             /* number of READ "valid" samples in instance (0 <= nvread <= nvsamples) */
-  dds_querycond_mask_t conds;  /* matching query conditions */
+  dds_querycond_mask_t *conds; /* matching query condition groups (invalid sample), NULL if no qconds */
   uint32_t wrcount;            /* number of live writers */
   unsigned isnew : 1;          /* NEW or NOT_NEW view state */
   unsigned a_sample_free : 1;  /* whether or not a_sample is in use */
@@ -283,6 +311,26 @@ struct rhc_instance {
   struct rhc_sample a_sample;  /* pre-allocated storage for 1 sample */
 };
 
+/* Bitmaps for the query condition groups are allocated from pages, each page
+   holding QCPAGE_NBITMAPS bitmaps of nwords words; free bitmaps are linked
+   through their first word */
+struct rhc_qcpage {
+  struct rhc_qcpage *next;
+  dds_querycond_mask_t bits[];
+};
+
+struct rhc_qcpool {
+  uint32_t nwords;                   /* words per bitmap, 0 if no qconds */
+  struct rhc_qcpage *pages;
+  dds_querycond_mask_t *freelist;
+};
+
+struct rhc_qcgroup {
+  bool (*filter) (const void *sample); /* NULL if slot is unused */
+  uint32_t nconds;                   /* # attached query conditions with this filter */
+  uint32_t nsamplest;                /* # of those that check the sample state */
+};
+
 typedef enum rhc_store_result {
   RHC_STORED,
   RHC_FILTERED,
@@ -326,14 +374,45 @@ struct dds_rhc_default {
   dds_readcond * conds;              /* List of associated read conditions */
   uint32_t nconds;                   /* Number of associated read conditions */
   uint32_t nqconds;                  /* Number of associated query conditions */
-  dds_querycond_mask_t qconds_samplest;  /* Mask of associated query conditions that check the sample state */
   void *qcond_eval_samplebuf;        /* Temporary storage for evaluating query conditions, NULL if no qconds */
+  uint32_t nqcgroups;                /* Number of slots in qcgroups (used or not) */
+  struct rhc_qcgroup *qcgroups;      /* Query condition groups, index = bit in bitmaps */
+  struct rhc_qcpool qcpool;          /* Bitmap storage for instances and samples */
+  dds_querycond_mask_t *qcgroups_samplest; /* Groups containing conditions that check the sample state */
+  dds_querycond_mask_t *qc_scratch;  /* Copy of bitmap of a sample that got freed/reused before updating conditions */
 #ifdef DDSI_INCLUDE_LIFESPAN
   struct lifespan_adm lifespan;      /* Lifespan administration */
 #endif
 #ifdef DDSI_INCLUDE_DEADLINE_MISSED
   struct deadline_adm deadline; /* Deadline missed administration */
 #endif
+
+  bool coherent_access;              /* true if PRESENTATION coherent_access */
+  ddsrt_mutex_t coherent_lock;       /* protects coherent_sets, never held together with "lock" */
+  struct rhc_coherent_set *coherent_sets; /* uncommitted coherent sets, at most one per writer */
+  ddsrt_atomic_uint32_t n_coherent_sets;  /* number of entries in coherent_sets */
+};
+
+struct rhc_coherent_sample {
+  struct ddsi_writer_info wrinfo;
+  struct ddsi_serdata *sample;
+  struct ddsi_tkmap_instance *tk;
+};
+
+struct rhc_coherent_set {
+  struct rhc_coherent_set *next;
+  uint64_t wr_iid;
+  int64_t seq;                       /* coherent set sequence number */
+  uint32_t n, size;
+  struct rhc_coherent_sample *samples;
+};
+
+/* Everything that must be done after releasing the RHC lock following one or
+   more store operations */
+struct rhc_store_notify {
+  bool data_available;
+  size_t ntriggers;
+  dds_entity *triggers[MAX_FAST_TRIGGERS];
 };
 
 struct trigger_info_cmn {
@@ -347,16 +426,16 @@ struct trigger_info_pre {
 };
 
 struct trigger_info_qcond {
-  /* 0 or inst->conds depending on whether an invalid/valid sample was pushed out/added;
+  /* NULL or inst->conds/sample->conds depending on whether an invalid/valid sample was pushed out/added;
      inc_xxx_read is there so read can indicate a sample changed from unread to read */
   bool dec_invsample_read;
   bool dec_sample_read;
   bool inc_invsample_read;
   bool inc_sample_read;
-  dds_querycond_mask_t dec_conds_invsample;
-  dds_querycond_mask_t dec_conds_sample;
-  dds_querycond_mask_t inc_conds_invsample;
-  dds_querycond_mask_t inc_conds_sample;
+  const dds_querycond_mask_t *dec_conds_invsample;
+  const dds_querycond_mask_t *dec_conds_sample;
+  const dds_querycond_mask_t *inc_conds_invsample;
+  const dds_querycond_mask_t *inc_conds_sample;
 };
 
 struct trigger_info_post {
@@ -368,6 +447,7 @@ static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, cons
 static void dds_rhc_default_unregister_wr (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo);
 static void dds_rhc_default_relinquish_ownership (struct dds_rhc_default * __restrict rhc, const uint64_t wr_iid);
 static void dds_rhc_default_set_qos (struct dds_rhc_default *rhc, const struct dds_qos *qos);
+static void dds_rhc_default_commit (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo);
 static int dds_rhc_default_read (struct dds_rhc_default *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, uint32_t mask, dds_instance_handle_t handle, dds_readcond *cond);
 static int dds_rhc_default_take (struct dds_rhc_default *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, uint32_t mask, dds_instance_handle_t handle, dds_readcond *cond);
 static int dds_rhc_default_takecdr (struct dds_rhc_default *rhc, bool lock, struct ddsi_serdata ** values, dds_sample_info_t *info_seq, uint32_t max_samples, uint32_t sample_states, uint32_t view_states, uint32_t instance_states, dds_instance_handle_t handle);
@@ -390,6 +470,9 @@ static void dds_rhc_default_relinquish_ownership_wrap (struct ddsi_rhc * __restr
 static void dds_rhc_default_set_qos_wrap (struct ddsi_rhc *rhc, const struct dds_qos *qos) {
   dds_rhc_default_set_qos ((struct dds_rhc_default *) rhc, qos);
 }
+static void dds_rhc_default_commit_wrap (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo) {
+  dds_rhc_default_commit ((struct dds_rhc_default *) rhc, wrinfo);
+}
 static int dds_rhc_default_read_wrap (struct dds_rhc *rhc, bool lock, void **values, dds_sample_info_t *info_seq, uint32_t max_samples, uint32_t mask, dds_instance_handle_t handle, dds_readcond *cond) {
   return dds_rhc_default_read ((struct dds_rhc_default *) rhc, lock, values, info_seq, max_samples, mask, handle, cond);
 }
@@ -421,6 +504,7 @@ static const struct dds_rhc_ops dds_rhc_default_ops = {
     .unregister_wr = dds_rhc_default_unregister_wr_wrap,
     .relinquish_ownership = dds_rhc_default_relinquish_ownership_wrap,
     .set_qos = dds_rhc_default_set_qos_wrap,
+    .commit = dds_rhc_default_commit_wrap,
     .free = dds_rhc_default_free_wrap
   },
   .read = dds_rhc_default_read_wrap,
@@ -479,6 +563,7 @@ static void topicless_to_clean_invsample (const struct ddsi_sertopic *topic, con
 
 static unsigned qmask_of_inst (const struct rhc_instance *inst);
 static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s);
+static const dds_querycond_mask_t *qcbits_save (struct dds_rhc_default *rhc, const dds_querycond_mask_t *bm);
 static void get_trigger_info_cmn (struct trigger_info_cmn *info, struct rhc_instance *inst);
 static void get_trigger_info_pre (struct trigger_info_pre *info, struct rhc_instance *inst);
 static void init_trigger_info_qcond (struct trigger_info_qcond *qc);
@@ -574,7 +659,7 @@ static void drop_expired_samples (struct dds_rhc_default *rhc, struct rhc_sample
   {
     inst->latest = NULL;
   }
-  trig_qc.dec_conds_sample = sample->conds;
+  trig_qc.dec_conds_sample = qcbits_save (rhc, sample->conds);
   free_sample (rhc, inst, sample);
   get_trigger_info_cmn (&post.c, inst);
   update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst, NULL, &ntriggers);
@@ -645,6 +730,9 @@ struct dds_rhc *dds_rhc_default_new_xchecks (dds_reader *reader, struct ddsi_dom
 
   lwregs_init (&rhc->registrations);
   ddsrt_mutex_init (&rhc->lock);
+  ddsrt_mutex_init (&rhc->coherent_lock);
+  rhc->coherent_sets = NULL;
+  ddsrt_atomic_st32 (&rhc->n_coherent_sets, 0);
   rhc->instances = ddsrt_hh_new (1, instance_iid_hash, instance_iid_eq);
   ddsrt_circlist_init (&rhc->nonempty_instances);
   rhc->topic = topic;
@@ -682,6 +770,7 @@ static void dds_rhc_default_set_qos (struct dds_rhc_default * rhc, const dds_qos
   rhc->reliable = (qos->reliability.kind == DDS_RELIABILITY_RELIABLE);
   assert(qos->history.kind != DDS_HISTORY_KEEP_LAST || qos->history.depth > 0);
   rhc->history_depth = (qos->history.kind == DDS_HISTORY_KEEP_LAST) ? (uint32_t)qos->history.depth : ~0u;
+  rhc->coherent_access = qos->presentation.coherent_access;
   /* FIXME: updating deadline duration not yet supported
   rhc->deadline.dur = qos->deadline.deadline; */
 }
@@ -700,6 +789,193 @@ static bool eval_predicate_invsample (const struct dds_rhc_default *rhc, const s
   return ret;
 }
 
+static void qcpool_init (struct rhc_qcpool *pool, uint32_t nwords)
+{
+  /* a free bitmap stores the link to the next one in its first word */
+  DDSRT_STATIC_ASSERT_CODE (sizeof (dds_querycond_mask_t *) <= sizeof (dds_querycond_mask_t));
+  pool->nwords = nwords;
+  pool->pages = NULL;
+  pool->freelist = NULL;
+}
+
+static void qcpool_fini (struct rhc_qcpool *pool)
+{
+  while (pool->pages)
+  {
+    struct rhc_qcpage *page = pool->pages;
+    pool->pages = page->next;
+    ddsrt_free (page);
+  }
+  pool->freelist = NULL;
+}
+
+static dds_querycond_mask_t *qcpool_alloc (struct rhc_qcpool *pool)
+{
+  dds_querycond_mask_t *bm;
+  if (pool->nwords == 0)
+    return NULL;
+  if (pool->freelist == NULL)
+  {
+    struct rhc_qcpage *page = ddsrt_malloc (sizeof (*page) + QCPAGE_NBITMAPS * pool->nwords * sizeof (page->bits[0]));
+    page->next = pool->pages;
+    pool->pages = page;
+    for (uint32_t i = QCPAGE_NBITMAPS; i > 0; i--)
+    {
+      bm = &page->bits[(i - 1) * pool->nwords];
+      memcpy (bm, &pool->freelist, sizeof (pool->freelist));
+      pool->freelist = bm;
+    }
+  }
+  bm = pool->freelist;
+  memcpy (&pool->freelist, bm, sizeof (pool->freelist));
+  memset (bm, 0, pool->nwords * sizeof (*bm));
+  return bm;
+}
+
+static void qcpool_free (struct rhc_qcpool *pool, dds_querycond_mask_t *bm)
+{
+  if (bm != NULL)
+  {
+    memcpy (bm, &pool->freelist, sizeof (pool->freelist));
+    pool->freelist = bm;
+  }
+}
+
+static bool qcbits_test (const dds_querycond_mask_t *bm, uint32_t group)
+{
+  return bm != NULL && (bm[group / QC_WORD_BITS] & ((dds_querycond_mask_t) 1 << (group % QC_WORD_BITS))) != 0;
+}
+
+static void qcbits_assign (dds_querycond_mask_t *bm, uint32_t group, bool value)
+{
+  const dds_querycond_mask_t bit = (dds_querycond_mask_t) 1 << (group % QC_WORD_BITS);
+  if (value)
+    bm[group / QC_WORD_BITS] |= bit;
+  else
+    bm[group / QC_WORD_BITS] &= ~bit;
+}
+
+static bool qcbits_any (const struct dds_rhc_default *rhc, const dds_querycond_mask_t *bm)
+{
+  if (bm != NULL)
+  {
+    for (uint32_t i = 0; i < rhc->qcpool.nwords; i++)
+      if (bm[i] != 0)
+        return true;
+  }
+  return false;
+}
+
+static bool qcbits_intersect (const struct dds_rhc_default *rhc, const dds_querycond_mask_t *a, const dds_querycond_mask_t *b)
+{
+  if (a != NULL && b != NULL)
+  {
+    for (uint32_t i = 0; i < rhc->qcpool.nwords; i++)
+      if ((a[i] & b[i]) != 0)
+        return true;
+  }
+  return false;
+}
+
+static bool qcbits_equal (const struct dds_rhc_default *rhc, const dds_querycond_mask_t *a, const dds_querycond_mask_t *b)
+{
+  /* NULL is equivalent to all zeros */
+  if (a == b)
+    return true;
+  else if (a == NULL)
+    return !qcbits_any (rhc, b);
+  else if (b == NULL)
+    return !qcbits_any (rhc, a);
+  else
+    return memcmp (a, b, rhc->qcpool.nwords * sizeof (*a)) == 0;
+}
+
+static dds_querycond_mask_t qcbits_word0 (const dds_querycond_mask_t *bm)
+{
+  /* for tracing only */
+  return (bm != NULL) ? bm[0] : 0;
+}
+
+static const dds_querycond_mask_t *qcbits_save (struct dds_rhc_default *rhc, const dds_querycond_mask_t *bm)
+{
+  /* for passing the bits of a sample that gets freed or reused to update_conditions_locked */
+  if (bm == NULL)
+    return NULL;
+  memcpy (rhc->qc_scratch, bm, rhc->qcpool.nwords * sizeof (*bm));
+  return rhc->qc_scratch;
+}
+
+static void qcbits_eval_groups (const struct dds_rhc_default *rhc, dds_querycond_mask_t *bm)
+{
+  /* qcond_eval_samplebuf holds the sample; each filter is called only once,
+     regardless of the number of conditions using it */
+  for (uint32_t g = 0; g < rhc->nqcgroups; g++)
+    if (rhc->qcgroups[g].filter != 0)
+      qcbits_assign (bm, g, rhc->qcgroups[g].filter (rhc->qcond_eval_samplebuf));
+}
+
+static void qcbits_eval_sample (const struct dds_rhc_default *rhc, dds_querycond_mask_t *bm, const struct ddsi_serdata *sample)
+{
+  ddsi_serdata_to_sample (sample, rhc->qcond_eval_samplebuf, NULL, NULL);
+  qcbits_eval_groups (rhc, bm);
+}
+
+static void qcbits_eval_invsample (const struct dds_rhc_default *rhc, dds_querycond_mask_t *bm, const struct rhc_instance *inst)
+{
+  topicless_to_clean_invsample (rhc->topic, inst->tk->m_sample, rhc->qcond_eval_samplebuf, NULL, NULL);
+  qcbits_eval_groups (rhc, bm);
+}
+
+static dds_querycond_mask_t *qcbits_realloc (dds_querycond_mask_t *bm, uint32_t oldnwords, uint32_t nwords)
+{
+  if (nwords == 0)
+  {
+    ddsrt_free (bm);
+    return NULL;
+  }
+  bm = ddsrt_realloc (bm, nwords * sizeof (*bm));
+  if (nwords > oldnwords)
+    memset (bm + oldnwords, 0, (nwords - oldnwords) * sizeof (*bm));
+  return bm;
+}
+
+static void qcbits_relayout (struct dds_rhc_default *rhc, uint32_t nwords)
+{
+  /* Moves the bitmaps of all instances and samples to a new pool with bitmaps of
+     nwords words, or releases them if nwords = 0 */
+  const uint32_t ncopy = (nwords < rhc->qcpool.nwords) ? nwords : rhc->qcpool.nwords;
+  struct rhc_qcpool pool;
+  struct ddsrt_hh_iter it;
+  qcpool_init (&pool, nwords);
+  for (struct rhc_instance *inst = ddsrt_hh_iter_first (rhc->instances, &it); inst != NULL; inst = ddsrt_hh_iter_next (&it))
+  {
+    dds_querycond_mask_t *bm = qcpool_alloc (&pool);
+    if (ncopy > 0)
+      memcpy (bm, inst->conds, ncopy * sizeof (*bm));
+    inst->conds = bm;
+    if (inst->latest)
+    {
+      struct rhc_sample *sample = inst->latest->next, * const end = sample;
+      do {
+        bm = qcpool_alloc (&pool);
+        if (ncopy > 0)
+          memcpy (bm, sample->conds, ncopy * sizeof (*bm));
+        sample->conds = bm;
+        sample = sample->next;
+      } while (sample != end);
+    }
+  }
+  rhc->qcgroups_samplest = qcbits_realloc (rhc->qcgroups_samplest, rhc->qcpool.nwords, nwords);
+  rhc->qc_scratch = qcbits_realloc (rhc->qc_scratch, rhc->qcpool.nwords, nwords);
+  qcpool_fini (&rhc->qcpool);
+  rhc->qcpool = pool;
+}
+
+static bool qcond_matches (const dds_readcond *cond, const dds_querycond_mask_t *bm)
+{
+  return cond == NULL || cond->m_query.m_filter == 0 || qcbits_test (bm, cond->m_query.m_qcgroup);
+}
+
 static struct rhc_sample *alloc_sample (struct rhc_instance *inst)
 {
   if (inst->a_sample_free)
@@ -721,10 +997,8 @@ static struct rhc_sample *alloc_sample (struct rhc_instance *inst)
 
 static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct rhc_sample *s)
 {
-#ifndef DDSI_INCLUDE_LIFESPAN
-  DDSRT_UNUSED_ARG (rhc);
-#endif
   ddsi_serdata_unref (s->sample);
+  qcpool_free (&rhc->qcpool, s->conds);
 #ifdef DDSI_INCLUDE_LIFESPAN
   lifespan_unregister_sample_locked (&rhc->lifespan, &s->lifespan);
 #endif
@@ -745,7 +1019,7 @@ static void free_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
 static void inst_clear_invsample (struct dds_rhc_default *rhc, struct rhc_instance *inst, struct trigger_info_qcond *trig_qc)
 {
   assert (inst->inv_exists);
-  assert (trig_qc->dec_conds_invsample == 0);
+  assert (trig_qc->dec_conds_invsample == NULL);
   inst->inv_exists = 0;
   trig_qc->dec_conds_invsample = inst->conds;
   if (inst->inv_isread)
@@ -768,7 +1042,7 @@ static void inst_set_invsample (struct dds_rhc_default *rhc, struct rhc_instance
   {
     /* Obviously optimisable, but that is perhaps not worth the bother */
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
-    assert (trig_qc->inc_conds_invsample == 0);
+    assert (trig_qc->inc_conds_invsample == NULL);
     trig_qc->inc_conds_invsample = inst->conds;
     inst->inv_exists = 1;
     inst->inv_isread = 0;
@@ -785,6 +1059,7 @@ static void free_empty_instance (struct rhc_instance *inst, struct dds_rhc_defau
   if (!inst->isdisposed)
     deadline_unregister_instance_locked (&rhc->deadline, &inst->deadline);
 #endif
+  qcpool_free (&rhc->qcpool, inst->conds);
   ddsrt_free (inst);
 }
 
@@ -834,8 +1109,25 @@ static void free_instance_rhc_free_wrap (void *vnode, void *varg)
   free_instance_rhc_free (vnode, varg);
 }
 
+static void free_coherent_set (struct dds_rhc_default *rhc, struct rhc_coherent_set *cs)
+{
+  for (uint32_t i = 0; i < cs->n; i++)
+  {
+    ddsi_tkmap_instance_unref (rhc->tkmap, cs->samples[i].tk);
+    ddsi_serdata_unref (cs->samples[i].sample);
+  }
+  ddsrt_free (cs->samples);
+  ddsrt_free (cs);
+}
+
 static void dds_rhc_default_free (struct dds_rhc_default *rhc)
 {
+  while (rhc->coherent_sets)
+  {
+    struct rhc_coherent_set *cs = rhc->coherent_sets;
+    rhc->coherent_sets = cs->next;
+    free_coherent_set (rhc, cs);
+  }
 #ifdef DDSI_INCLUDE_LIFESPAN
   dds_rhc_default_sample_expired_cb (rhc, DDSRT_MTIME_NEVER);
   lifespan_fini (&rhc->lifespan);
@@ -850,8 +1142,13 @@ static void dds_rhc_default_free (struct dds_rhc_default *rhc)
 #endif
   ddsrt_hh_free (rhc->instances);
   lwregs_fini (&rhc->registrations);
+  qcpool_fini (&rhc->qcpool);
+  ddsrt_free (rhc->qcgroups);
+  ddsrt_free (rhc->qcgroups_samplest);
+  ddsrt_free (rhc->qc_scratch);
   if (rhc->qcond_eval_samplebuf != NULL)
     ddsi_sertopic_free_sample (rhc->topic, rhc->qcond_eval_samplebuf, DDS_FREE_ALL);
+  ddsrt_mutex_destroy (&rhc->coherent_lock);
   ddsrt_mutex_destroy (&rhc->lock);
   ddsrt_free (rhc);
 }
@@ -881,10 +1178,10 @@ static void init_trigger_info_qcond (struct trigger_info_qcond *qc)
   qc->dec_sample_read = false;
   qc->inc_invsample_read = false;
   qc->inc_sample_read = false;
-  qc->dec_conds_invsample = 0;
-  qc->dec_conds_sample = 0;
-  qc->inc_conds_invsample = 0;
-  qc->inc_conds_sample = 0;
+  qc->dec_conds_invsample = NULL;
+  qc->dec_conds_sample = NULL;
+  qc->inc_conds_invsample = NULL;
+  qc->inc_conds_sample = NULL;
 }
 
 static bool trigger_info_differs (const struct dds_rhc_default *rhc, const struct trigger_info_pre *pre, const struct trigger_info_post *post, const struct trigger_info_qcond *trig_qc)
@@ -896,8 +1193,8 @@ static bool trigger_info_differs (const struct dds_rhc_default *rhc, const struc
   else if (rhc->nqconds == 0)
     return false;
   else
-    return (trig_qc->dec_conds_invsample != trig_qc->inc_conds_invsample ||
-            trig_qc->dec_conds_sample != trig_qc->inc_conds_sample ||
+    return (!qcbits_equal (rhc, trig_qc->dec_conds_invsample, trig_qc->inc_conds_invsample) ||
+            !qcbits_equal (rhc, trig_qc->dec_conds_sample, trig_qc->inc_conds_sample) ||
             trig_qc->dec_invsample_read != trig_qc->inc_invsample_read ||
             trig_qc->dec_sample_read != trig_qc->inc_sample_read);
 }
@@ -922,7 +1219,7 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
     assert (inst->latest != NULL);
     s = inst->latest->next;
-    assert (trig_qc->dec_conds_sample == 0);
+    assert (trig_qc->dec_conds_sample == NULL);
     ddsi_serdata_unref (s->sample);
 
 #ifdef DDSI_INCLUDE_LIFESPAN
@@ -930,7 +1227,7 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
 #endif
 
     trig_qc->dec_sample_read = s->isread;
-    trig_qc->dec_conds_sample = s->conds;
+    trig_qc->dec_conds_sample = qcbits_save (rhc, s->conds);
     if (s->isread)
     {
       inst->nvread--;
@@ -961,6 +1258,7 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
 
     /* add new latest sample */
     s = alloc_sample (inst);
+    s->conds = qcpool_alloc (&rhc->qcpool);
     inst_clear_invsample_if_exists (rhc, inst, trig_qc);
     if (inst->latest == NULL)
     {
@@ -991,13 +1289,8 @@ static bool add_sample (struct dds_rhc_default *rhc, struct rhc_instance *inst,
     deadline_renew_instance_locked (&rhc->deadline, &inst->deadline);
 #endif
 
-  s->conds = 0;
   if (rhc->nqconds != 0)
-  {
-    for (dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
-      if (rc->m_query.m_filter != 0 && eval_predicate_sample (rhc, s->sample, rc->m_query.m_filter))
-        s->conds |= rc->m_query.m_qcmask;
-  }
+    qcbits_eval_sample (rhc, s->conds, s->sample);
 
   trig_qc->inc_conds_sample = s->conds;
   inst->latest = s;
@@ -1364,7 +1657,7 @@ static struct rhc_instance *alloc_new_instance (struct dds_rhc_default *rhc, con
   inst->isdisposed = (serdata->statusinfo & NN_STATUSINFO_DISPOSE) != 0;
   inst->isnew = 1;
   inst->a_sample_free = 1;
-  inst->conds = 0;
+  inst->conds = qcpool_alloc (&rhc->qcpool);
   inst->wr_iid = wrinfo->iid;
   inst->wr_iid_islive = (inst->wrcount != 0);
   inst->wr_guid = wrinfo->guid;
@@ -1372,15 +1665,7 @@ static struct rhc_instance *alloc_new_instance (struct dds_rhc_default *rhc, con
   inst->strength = wrinfo->ownership_strength;
 
   if (rhc->nqconds != 0)
-  {
-    for (dds_readcond *c = rhc->conds; c != NULL; c = c->m_next)
-    {
-      assert ((dds_entity_kind (&c->m_entity) == DDS_KIND_COND_READ && c->m_query.m_filter == 0) ||
-              (dds_entity_kind (&c->m_entity) == DDS_KIND_COND_QUERY && c->m_query.m_filter != 0));
-      if (c->m_query.m_filter && eval_predicate_invsample (rhc, inst, c->m_query.m_filter))
-        inst->conds |= c->m_query.m_qcmask;
-    }
-  }
+    qcbits_eval_invsample (rhc, inst->conds, inst);
 
 #ifdef DDSI_INCLUDE_DEADLINE_MISSED
   if (!inst->isdisposed)
@@ -1459,8 +1744,10 @@ static rhc_store_result_t rhc_store_new_instance (struct rhc_instance **out_inst
   delivered (true unless a reliable sample rejected).
 */
 
-static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk)
+static bool dds_rhc_default_store_locked (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk, struct rhc_store_notify * __restrict notify, status_cb_data_t * __restrict cb_data)
 {
+  /* Pre: rhc->lock held; on return cb_data->raw_status_id >= 0 if a reader status
+     callback is required */
   const uint64_t wr_iid = wrinfo->iid;
   const unsigned statusinfo = sample->statusinfo;
   const bool has_data = (sample->kind == SDK_DATA);
@@ -1471,10 +1758,10 @@ static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, cons
   struct trigger_info_post post;
   struct trigger_info_qcond trig_qc;
   rhc_store_result_t stored;
-  status_cb_data_t cb_data;   /* Callback data for reader status callback */
   bool delivered = true;
   bool notify_data_available = false;
 
+  cb_data->raw_status_id = -1;
   TRACE ("rhc_store(%"PRIx64",%"PRIx64" si %x has_data %d:", tk->m_iid, wr_iid, statusinfo, has_data);
   if (!has_data && statusinfo == 0)
   {
@@ -1487,12 +1774,9 @@ static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, cons
 
   dummy_instance.iid = tk->m_iid;
   stored = RHC_FILTERED;
-  cb_data.raw_status_id = -1;
 
   init_trigger_info_qcond (&trig_qc);
 
-  ddsrt_mutex_lock (&rhc->lock);
-
   inst = ddsrt_hh_lookup (rhc->instances, &dummy_instance);
   if (inst == NULL)
   {
@@ -1508,7 +1792,7 @@ static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, cons
     else
     {
       TRACE (" new instance");
-      stored = rhc_store_new_instance (&inst, rhc, wrinfo, sample, tk, has_data, &cb_data, &post, &trig_qc);
+      stored = rhc_store_new_instance (&inst, rhc, wrinfo, sample, tk, has_data, cb_data, &post, &trig_qc);
       if (stored != RHC_STORED)
       {
         goto error_or_nochange;
@@ -1542,10 +1826,10 @@ static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, cons
     }
     /* notify sample lost */
 
-    cb_data.raw_status_id = (int) DDS_SAMPLE_LOST_STATUS_ID;
-    cb_data.extra = 0;
-    cb_data.handle = 0;
-    cb_data.add = true;
+    cb_data->raw_status_id = (int) DDS_SAMPLE_LOST_STATUS_ID;
+    cb_data->extra = 0;
+    cb_data->handle = 0;
+    cb_data->add = true;
     goto error_or_nochange;
   }
   else
@@ -1617,7 +1901,7 @@ static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, cons
       if (has_data)
       {
         TRACE (" add_sample");
-        if (!add_sample (rhc, inst, wrinfo, sample, &cb_data, &trig_qc))
+        if (!add_sample (rhc, inst, wrinfo, sample, cb_data, &trig_qc))
         {
           TRACE ("(reject)");
           stored = RHC_REJECTED;
@@ -1699,40 +1983,169 @@ static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, cons
 
   TRACE (")\n");
 
-  dds_entity *triggers[MAX_FAST_TRIGGERS];
-  size_t ntriggers = 0;
   if (trigger_info_differs (rhc, &pre, &post, &trig_qc))
-    update_conditions_locked (rhc, true, &pre, &post, &trig_qc, inst, triggers, &ntriggers);
+    update_conditions_locked (rhc, true, &pre, &post, &trig_qc, inst, notify->triggers, &notify->ntriggers);
 
   assert (rhc_check_counts_locked (rhc, true, true));
 
-  ddsrt_mutex_unlock (&rhc->lock);
+  if (notify_data_available)
+    notify->data_available = true;
+  return delivered;
+
+error_or_nochange:
 
+  if (rhc->reliable && (stored == RHC_REJECTED))
+  {
+    delivered = false;
+  }
+
+  TRACE (")\n");
+  return delivered;
+}
+
+static void rhc_store_notify (struct dds_rhc_default *rhc, const struct rhc_store_notify *notify, const status_cb_data_t *cb_data, uint32_t ncb)
+{
+  /* Pre: rhc->lock not held */
   if (rhc->reader)
   {
-    if (notify_data_available)
+    for (uint32_t i = 0; i < ncb; i++)
+      dds_reader_status_cb (&rhc->reader->m_entity, &cb_data[i]);
+    if (notify->data_available)
       dds_reader_data_available_cb (rhc->reader);
-    for (size_t i = 0; i < ntriggers; i++)
-      dds_entity_status_signal (triggers[i], 0);
+    for (size_t i = 0; i < notify->ntriggers; i++)
+      dds_entity_status_signal (notify->triggers[i], 0);
   }
+}
 
-  return delivered;
+static struct rhc_coherent_set *unlink_coherent_set_locked (struct dds_rhc_default *rhc, uint64_t wr_iid)
+{
+  struct rhc_coherent_set *cs, **pcs = &rhc->coherent_sets;
+  while ((cs = *pcs) != NULL && cs->wr_iid != wr_iid)
+    pcs = &cs->next;
+  if (cs != NULL)
+  {
+    *pcs = cs->next;
+    ddsrt_atomic_dec32 (&rhc->n_coherent_sets);
+  }
+  return cs;
+}
 
-error_or_nochange:
+static bool coherent_set_hold (struct dds_rhc_default *rhc, const struct ddsi_writer_info *wrinfo, struct ddsi_serdata *sample, struct ddsi_tkmap_instance *tk)
+{
+  /* Returns true if the sample is part of a coherent set and has been added to the
+     pending set of the writer, false if it is to be stored immediately.  Any set
+     pending for the writer that the sample does not belong to is incomplete, and
+     so gets discarded. */
+  struct rhc_coherent_set *cs, *drop = NULL;
+  ddsrt_mutex_lock (&rhc->coherent_lock);
+  if ((cs = unlink_coherent_set_locked (rhc, wrinfo->iid)) != NULL && cs->seq != wrinfo->coherent_set_seq)
+  {
+    drop = cs;
+    cs = NULL;
+  }
+  if (wrinfo->coherent_set_seq != 0)
+  {
+    if (cs == NULL)
+    {
+      cs = ddsrt_malloc (sizeof (*cs));
+      cs->wr_iid = wrinfo->iid;
+      cs->seq = wrinfo->coherent_set_seq;
+      cs->n = 0;
+      cs->size = 8;
+      cs->samples = ddsrt_malloc (cs->size * sizeof (*cs->samples));
+    }
+    else if (cs->n == cs->size)
+    {
+      cs->size *= 2;
+      cs->samples = ddsrt_realloc (cs->samples, cs->size * sizeof (*cs->samples));
+    }
+    cs->samples[cs->n].wrinfo = *wrinfo;
+    cs->samples[cs->n].sample = ddsi_serdata_ref (sample);
+    cs->samples[cs->n].tk = tk;
+    ddsi_tkmap_instance_ref (tk);
+    cs->n++;
+    cs->next = rhc->coherent_sets;
+    rhc->coherent_sets = cs;
+    ddsrt_atomic_inc32 (&rhc->n_coherent_sets);
+  }
+  ddsrt_mutex_unlock (&rhc->coherent_lock);
+  if (drop)
+  {
+    TRACE ("rhc_store(wr %"PRIx64"): discarding incomplete coherent set %"PRId64" (%"PRIu32" samples)\n", drop->wr_iid, drop->seq, drop->n);
+    free_coherent_set (rhc, drop);
+  }
+  return (cs != NULL);
+}
 
-  if (rhc->reliable && (stored == RHC_REJECTED))
+static void coherent_set_drop (struct dds_rhc_default *rhc, uint64_t wr_iid)
+{
+  struct rhc_coherent_set *cs;
+  if (ddsrt_atomic_ld32 (&rhc->n_coherent_sets) == 0)
+    return;
+  ddsrt_mutex_lock (&rhc->coherent_lock);
+  cs = unlink_coherent_set_locked (rhc, wr_iid);
+  ddsrt_mutex_unlock (&rhc->coherent_lock);
+  if (cs)
+    free_coherent_set (rhc, cs);
+}
+
+static bool dds_rhc_default_store (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo, struct ddsi_serdata * __restrict sample, struct ddsi_tkmap_instance * __restrict tk)
+{
+  struct rhc_store_notify notify = { .data_available = false, .ntriggers = 0 };
+  status_cb_data_t cb_data;   /* Callback data for reader status callback */
+  bool delivered;
+
+  if (rhc->coherent_access && (wrinfo->coherent_set_seq != 0 || ddsrt_atomic_ld32 (&rhc->n_coherent_sets) > 0))
   {
-    delivered = false;
+    if (coherent_set_hold (rhc, wrinfo, sample, tk))
+      return true;
   }
 
+  ddsrt_mutex_lock (&rhc->lock);
+  delivered = dds_rhc_default_store_locked (rhc, wrinfo, sample, tk, &notify, &cb_data);
   ddsrt_mutex_unlock (&rhc->lock);
-  TRACE (")\n");
+  rhc_store_notify (rhc, &notify, &cb_data, (cb_data.raw_status_id >= 0) ? 1 : 0);
+  return delivered;
+}
 
-  /* Make any reader status callback */
+static void dds_rhc_default_commit (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo)
+{
+  /* Stores all samples of the set under a single acquisition of the RHC lock, so
+     that a reader sees either none or all of them.  A sample rejected because of
+     resource limits can't be retried later on without breaking that guarantee,
+     so it is simply lost. */
+  struct rhc_store_notify notify = { .data_available = false, .ntriggers = 0 };
+  struct rhc_coherent_set *cs;
+  status_cb_data_t *cb_data;
+  uint32_t ncb = 0;
 
-  if (cb_data.raw_status_id >= 0 && rhc->reader)
-    dds_reader_status_cb (&rhc->reader->m_entity, &cb_data);
-  return delivered;
+  if (ddsrt_atomic_ld32 (&rhc->n_coherent_sets) == 0)
+    return;
+  ddsrt_mutex_lock (&rhc->coherent_lock);
+  cs = unlink_coherent_set_locked (rhc, wrinfo->iid);
+  ddsrt_mutex_unlock (&rhc->coherent_lock);
+  if (cs == NULL)
+    return;
+  if (cs->seq != wrinfo->coherent_set_seq)
+  {
+    TRACE ("rhc_commit(wr %"PRIx64" set %"PRId64"): discarding incomplete coherent set %"PRId64"\n", wrinfo->iid, wrinfo->coherent_set_seq, cs->seq);
+    free_coherent_set (rhc, cs);
+    return;
+  }
+
+  TRACE ("rhc_commit(wr %"PRIx64" set %"PRId64" n %"PRIu32")\n", wrinfo->iid, cs->seq, cs->n);
+  cb_data = ddsrt_malloc (cs->n * sizeof (*cb_data));
+  ddsrt_mutex_lock (&rhc->lock);
+  for (uint32_t i = 0; i < cs->n; i++)
+  {
+    (void) dds_rhc_default_store_locked (rhc, &cs->samples[i].wrinfo, cs->samples[i].sample, cs->samples[i].tk, &notify, &cb_data[ncb]);
+    if (cb_data[ncb].raw_status_id >= 0)
+      ncb++;
+  }
+  ddsrt_mutex_unlock (&rhc->lock);
+  rhc_store_notify (rhc, &notify, cb_data, ncb);
+  ddsrt_free (cb_data);
+  free_coherent_set (rhc, cs);
 }
 
 static void dds_rhc_default_unregister_wr (struct dds_rhc_default * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo)
@@ -1758,6 +2171,8 @@ static void dds_rhc_default_unregister_wr (struct dds_rhc_default * __restrict r
   const uint64_t wr_iid = wrinfo->iid;
   const int auto_dispose = wrinfo->auto_dispose;
 
+  coherent_set_drop (rhc, wr_iid);
+
   size_t ntriggers = SIZE_MAX;
 
   ddsrt_mutex_lock (&rhc->lock);
@@ -1975,14 +2390,11 @@ static void patch_generations (dds_sample_info_t *si, uint32_t last_of_inst)
   }
 }
 
-static bool read_sample_update_conditions (struct dds_rhc_default *rhc, struct trigger_info_pre *pre, struct trigger_info_post *post, struct trigger_info_qcond *trig_qc, struct rhc_instance *inst, dds_querycond_mask_t conds, bool sample_wasread)
+static bool read_sample_update_conditions (struct dds_rhc_default *rhc, struct trigger_info_pre *pre, struct trigger_info_post *post, struct trigger_info_qcond *trig_qc, struct rhc_instance *inst, const dds_querycond_mask_t *conds, bool sample_wasread)
 {
-  /* No query conditions that are dependent on sample states */
-  if (rhc->qconds_samplest == 0)
-    return false;
-
-  /* Some, but perhaps none that matches this sample */
-  if ((conds & rhc->qconds_samplest) == 0)
+  /* No query conditions that are dependent on sample states, or perhaps
+     some but none that matches this sample */
+  if (!qcbits_intersect (rhc, conds, rhc->qcgroups_samplest))
     return false;
 
   TRACE("read_sample_update_conditions\n");
@@ -1992,15 +2404,15 @@ static bool read_sample_update_conditions (struct dds_rhc_default *rhc, struct t
   get_trigger_info_cmn (&post->c, inst);
   size_t ntriggers = SIZE_MAX;
   update_conditions_locked (rhc, false, pre, post, trig_qc, inst, NULL, &ntriggers);
-  trig_qc->dec_conds_sample = trig_qc->inc_conds_sample = 0;
+  trig_qc->dec_conds_sample = trig_qc->inc_conds_sample = NULL;
   pre->c = post->c;
   return false;
 }
 
-static bool take_sample_update_conditions (struct dds_rhc_default *rhc, struct trigger_info_pre *pre, struct trigger_info_post *post, struct trigger_info_qcond *trig_qc, struct rhc_instance *inst, dds_querycond_mask_t conds, bool sample_wasread)
+static bool take_sample_update_conditions (struct dds_rhc_default *rhc, struct trigger_info_pre *pre, struct trigger_info_post *post, struct trigger_info_qcond *trig_qc, struct rhc_instance *inst, const dds_querycond_mask_t *conds, bool sample_wasread)
 {
   /* Mostly the same as read_...: but we are deleting samples (so no "inc sample") and need to process all query conditions that match this sample. */
-  if (rhc->nqconds == 0 || conds == 0)
+  if (rhc->nqconds == 0 || !qcbits_any (rhc, conds))
     return false;
 
   TRACE("take_sample_update_conditions\n");
@@ -2009,7 +2421,7 @@ static bool take_sample_update_conditions (struct dds_rhc_default *rhc, struct t
   get_trigger_info_cmn (&post->c, inst);
   size_t ntriggers = SIZE_MAX;
   update_conditions_locked (rhc, false, pre, post, trig_qc, inst, NULL, &ntriggers);
-  trig_qc->dec_conds_sample = 0;
+  trig_qc->dec_conds_sample = NULL;
   pre->c = post->c;
   return false;
 }
@@ -2031,7 +2443,6 @@ static int dds_rhc_read_w_qminv (struct dds_rhc_default *rhc, bool lock, void **
 
   if (!ddsrt_circlist_isempty (&rhc->nonempty_instances))
   {
-    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_filter) ? cond->m_query.m_qcmask : 0;
     struct rhc_instance * inst = oldest_nonempty_instance (rhc);
     struct rhc_instance * const end = inst;
     do
@@ -2054,7 +2465,7 @@ static int dds_rhc_read_w_qminv (struct dds_rhc_default *rhc, bool lock, void **
             struct rhc_sample *sample = inst->latest->next, * const end1 = sample;
             do
             {
-              if ((qmask_of_sample (sample) & qminv) == 0 && (qcmask == 0 || (sample->conds & qcmask)))
+              if ((qmask_of_sample (sample) & qminv) == 0 && qcond_matches (cond, sample->conds))
               {
                 /* sample state matches too */
                 set_sample_info (info_seq + n, inst, sample);
@@ -2077,7 +2488,7 @@ static int dds_rhc_read_w_qminv (struct dds_rhc_default *rhc, bool lock, void **
             while (sample != end1);
           }
 
-          if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcmask == 0 || (inst->conds & qcmask)))
+          if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && qcond_matches (cond, inst->conds))
           {
             set_sample_info_invsample (info_seq + n, inst);
             topicless_to_clean_invsample (rhc->topic, inst->tk->m_sample, values[n], 0, 0);
@@ -2102,10 +2513,10 @@ static int dds_rhc_read_w_qminv (struct dds_rhc_default *rhc, bool lock, void **
           {
             size_t ntriggers = SIZE_MAX;
             get_trigger_info_cmn (&post.c, inst);
-            assert (trig_qc.dec_conds_invsample == 0);
-            assert (trig_qc.dec_conds_sample == 0);
-            assert (trig_qc.inc_conds_invsample == 0);
-            assert (trig_qc.inc_conds_sample == 0);
+            assert (trig_qc.dec_conds_invsample == NULL);
+            assert (trig_qc.dec_conds_sample == NULL);
+            assert (trig_qc.inc_conds_invsample == NULL);
+            assert (trig_qc.inc_conds_sample == NULL);
             update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst, NULL, &ntriggers);
           }
 
@@ -2148,7 +2559,6 @@ static int dds_rhc_take_w_qminv (struct dds_rhc_default *rhc, bool lock, void **
 
   if (!ddsrt_circlist_isempty (&rhc->nonempty_instances))
   {
-    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_filter) ? cond->m_query.m_qcmask : 0;
     struct rhc_instance *inst = oldest_nonempty_instance (rhc);
     unsigned n_insts = rhc->n_nonempty_instances;
     while (n_insts-- > 0 && n < max_samples)
@@ -2175,7 +2585,7 @@ static int dds_rhc_take_w_qminv (struct dds_rhc_default *rhc, bool lock, void **
             {
               struct rhc_sample * const sample1 = sample->next;
 
-              if ((qmask_of_sample (sample) & qminv) != 0 || (qcmask != 0 && !(sample->conds & qcmask)))
+              if ((qmask_of_sample (sample) & qminv) != 0 || !qcond_matches (cond, sample->conds))
               {
                 /* sample mask doesn't match, or content predicate doesn't match */
                 psample = sample;
@@ -2215,7 +2625,7 @@ static int dds_rhc_take_w_qminv (struct dds_rhc_default *rhc, bool lock, void **
             }
           }
 
-          if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcmask == 0 || (inst->conds & qcmask) != 0))
+          if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && qcond_matches (cond, inst->conds))
           {
             struct trigger_info_qcond dummy_trig_qc;
 #ifndef NDEBUG
@@ -2239,10 +2649,10 @@ static int dds_rhc_take_w_qminv (struct dds_rhc_default *rhc, bool lock, void **
             /* if nsamples = 0, it won't match anything, so no need to do
                anything here for drop_instance_noupdate_no_writers */
             get_trigger_info_cmn (&post.c, inst);
-            assert (trig_qc.dec_conds_invsample == 0);
-            assert (trig_qc.dec_conds_sample == 0);
-            assert (trig_qc.inc_conds_invsample == 0);
-            assert (trig_qc.inc_conds_sample == 0);
+            assert (trig_qc.dec_conds_invsample == NULL);
+            assert (trig_qc.dec_conds_sample == NULL);
+            assert (trig_qc.inc_conds_invsample == NULL);
+            assert (trig_qc.inc_conds_sample == NULL);
             update_conditions_locked (rhc, false, &pre, &post, &trig_qc, inst, NULL, &ntriggers);
           }
 
@@ -2303,7 +2713,6 @@ static int dds_rhc_takecdr_w_qminv (struct dds_rhc_default *rhc, bool lock, stru
 
   if (!ddsrt_circlist_isempty (&rhc->nonempty_instances))
   {
-    const dds_querycond_mask_t qcmask = (cond && cond->m_query.m_filter) ? cond->m_query.m_qcmask : 0;
     struct rhc_instance *inst = oldest_nonempty_instance (rhc);
     unsigned n_insts = rhc->n_nonempty_instances;
     while (n_insts-- > 0 && n < max_samples)
@@ -2330,7 +2739,7 @@ static int dds_rhc_takecdr_w_qminv (struct dds_rhc_default *rhc, bool lock, stru
             {
               struct rhc_sample * const sample1 = sample->next;
 
-              if ((qmask_of_sample (sample) & qminv) != 0 || (qcmask && !(sample->conds & qcmask)))
+              if ((qmask_of_sample (sample) & qminv) != 0 || !qcond_matches (cond, sample->conds))
               {
                 psample = sample;
               }
@@ -2362,7 +2771,7 @@ static int dds_rhc_takecdr_w_qminv (struct dds_rhc_default *rhc, bool lock, stru
             }
           }
 
-          if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && (qcmask == 0 || (inst->conds & qcmask) != 0))
+          if (inst->inv_exists && n < max_samples && (qmask_of_invsample (inst) & qminv) == 0 && qcond_matches (cond, inst->conds))
           {
             struct trigger_info_qcond dummy_trig_qc;
 #ifndef NDEBUG
@@ -2482,32 +2891,11 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc_default *rhc, dds_
   assert ((dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_READ && cond->m_query.m_filter == 0) ||
           (dds_entity_kind (&cond->m_entity) == DDS_KIND_COND_QUERY && cond->m_query.m_filter != 0));
   assert (ddsrt_atomic_ld32 (&cond->m_entity.m_status.m_trigger) == 0);
-  assert (cond->m_query.m_qcmask == 0);
 
   cond->m_qminv = qmask_from_dcpsquery (cond->m_sample_states, cond->m_view_states, cond->m_instance_states);
 
   ddsrt_mutex_lock (&rhc->lock);
 
-  /* Allocate a slot in the condition bitmasks; return an error no more slots are available */
-  if (cond->m_query.m_filter != 0)
-  {
-    dds_querycond_mask_t avail_qcmask = ~(dds_querycond_mask_t)0;
-    for (dds_readcond *rc = rhc->conds; rc != NULL; rc = rc->m_next)
-    {
-      assert ((rc->m_query.m_filter == 0 && rc->m_query.m_qcmask == 0) || (rc->m_query.m_filter != 0 && rc->m_query.m_qcmask != 0));
-      avail_qcmask &= ~rc->m_query.m_qcmask;
-    }
-    if (avail_qcmask == 0)
-    {
-      /* no available indices */
-      ddsrt_mutex_unlock (&rhc->lock);
-      return false;
-    }
-
-    /* use the least significant bit set */
-    cond->m_query.m_qcmask = avail_qcmask & (~avail_qcmask + 1);
-  }
-
   rhc->nconds++;
   cond->m_next = rhc->conds;
   rhc->conds = cond;
@@ -2529,29 +2917,62 @@ static bool dds_rhc_default_add_readcondition (struct dds_rhc_default *rhc, dds_
   }
   else
   {
-    if (cond_is_sample_state_dependent (cond))
-      rhc->qconds_samplest |= cond->m_query.m_qcmask;
     if (rhc->nqconds++ == 0)
     {
       assert (rhc->qcond_eval_samplebuf == NULL);
       rhc->qcond_eval_samplebuf = ddsi_sertopic_alloc_sample (rhc->topic);
     }
 
-    /* Attaching a query condition means clearing the allocated bit in all instances and
-       samples, except for those that match the predicate. */
-    const dds_querycond_mask_t qcmask = cond->m_query.m_qcmask;
+    /* Query conditions with the same filter share a group (i.e., a bit in the bitmaps);
+       otherwise it gets the first unused group, widening the bitmaps if necessary */
+    uint32_t g, gfree = UINT32_MAX;
+    for (g = 0; g < rhc->nqcgroups && rhc->qcgroups[g].filter != cond->m_query.m_filter; g++)
+      if (rhc->qcgroups[g].filter == 0 && gfree == UINT32_MAX)
+        gfree = g;
+    const bool newgroup = (g == rhc->nqcgroups);
+    if (newgroup)
+    {
+      if (gfree != UINT32_MAX)
+        g = gfree;
+      else
+        rhc->qcgroups = ddsrt_realloc (rhc->qcgroups, ++rhc->nqcgroups * sizeof (*rhc->qcgroups));
+      rhc->qcgroups[g].filter = cond->m_query.m_filter;
+      rhc->qcgroups[g].nconds = 0;
+      rhc->qcgroups[g].nsamplest = 0;
+      if (g / QC_WORD_BITS >= rhc->qcpool.nwords)
+        qcbits_relayout (rhc, g / QC_WORD_BITS + 1);
+    }
+    cond->m_query.m_qcgroup = g;
+    rhc->qcgroups[g].nconds++;
+    if (cond_is_sample_state_dependent (cond) && rhc->qcgroups[g].nsamplest++ == 0)
+      qcbits_assign (rhc->qcgroups_samplest, g, true);
+
+    /* A new group means setting its bit in all instances and samples that match the
+       predicate and clearing it in all others, an existing one already has them set. */
     for (struct rhc_instance *inst = ddsrt_hh_iter_first (rhc->instances, &it); inst != NULL; inst = ddsrt_hh_iter_next (&it))
     {
-      const bool instmatch = eval_predicate_invsample (rhc, inst, cond->m_query.m_filter);;
+      bool instmatch;
       uint32_t matches = 0;
 
-      inst->conds = (inst->conds & ~qcmask) | (instmatch ? qcmask : 0);
+      if (!newgroup)
+        instmatch = qcbits_test (inst->conds, g);
+      else
+      {
+        instmatch = eval_predicate_invsample (rhc, inst, cond->m_query.m_filter);
+        qcbits_assign (inst->conds, g, instmatch);
+      }
       if (inst->latest)
       {
         struct rhc_sample *sample = inst->latest->next, * const end = sample;
         do {
-          const bool m = eval_predicate_sample (rhc, sample->sample, cond->m_query.m_filter);
-          sample->conds = (sample->conds & ~qcmask) | (m ? qcmask : 0);
+          bool m;
+          if (!newgroup)
+            m = qcbits_test (sample->conds, g);
+          else
+          {
+            m = eval_predicate_sample (rhc, sample->sample, cond->m_query.m_filter);
+            qcbits_assign (sample->conds, g, m);
+          }
           matches += m;
           sample = sample->next;
         } while (sample != end);
@@ -2587,14 +3008,24 @@ static void dds_rhc_default_remove_readcondition (struct dds_rhc_default *rhc, d
   rhc->nconds--;
   if (cond->m_query.m_filter)
   {
+    const uint32_t g = cond->m_query.m_qcgroup;
+    assert (g < rhc->nqcgroups && rhc->qcgroups[g].filter == cond->m_query.m_filter && rhc->qcgroups[g].nconds > 0);
+    if (cond_is_sample_state_dependent (cond) && --rhc->qcgroups[g].nsamplest == 0)
+      qcbits_assign (rhc->qcgroups_samplest, g, false);
+    /* the bits of an unused group are simply ignored until the group gets reused */
+    if (--rhc->qcgroups[g].nconds == 0)
+      rhc->qcgroups[g].filter = 0;
+    cond->m_query.m_qcgroup = 0;
     rhc->nqconds--;
-    rhc->qconds_samplest &= ~cond->m_query.m_qcmask;
-    cond->m_query.m_qcmask = 0;
     if (rhc->nqconds == 0)
     {
       assert (rhc->qcond_eval_samplebuf != NULL);
       ddsi_sertopic_free_sample (rhc->topic, rhc->qcond_eval_samplebuf, DDS_FREE_ALL);
       rhc->qcond_eval_samplebuf = NULL;
+      qcbits_relayout (rhc, 0);
+      ddsrt_free (rhc->qcgroups);
+      rhc->qcgroups = NULL;
+      rhc->nqcgroups = 0;
     }
   }
   ddsrt_mutex_unlock (&rhc->lock);
@@ -2610,9 +3041,17 @@ static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_f
   TRACE ("update_conditions_locked(%p %p) - inst %"PRIu32" nonempty %"PRIu32" disp %"PRIu32" nowr %"PRIu32" new %"PRIu32" samples %"PRIu32" read %"PRIu32"\n",
          (void *) rhc, (void *) inst, rhc->n_instances, rhc->n_nonempty_instances, rhc->n_not_alive_disposed,
          rhc->n_not_alive_no_writers, rhc->n_new, rhc->n_vsamples, rhc->n_vread);
-  TRACE ("  read -[%d,%d]+[%d,%d] qcmask -[%"PRIx32",%"PRIx32"]+[%"PRIx32",%"PRIx32"]\n",
+  TRACE ("  read -[%d,%d]+[%d,%d] qcmask -[%"PRIx64",%"PRIx64"]+[%"PRIx64",%"PRIx64"]\n",
          trig_qc->dec_invsample_read, trig_qc->dec_sample_read, trig_qc->inc_invsample_read, trig_qc->inc_sample_read,
-         trig_qc->dec_conds_invsample, trig_qc->dec_conds_sample, trig_qc->inc_conds_invsample, trig_qc->inc_conds_sample);
+         qcbits_word0 (trig_qc->dec_conds_invsample), qcbits_word0 (trig_qc->dec_conds_sample),
+         qcbits_word0 (trig_qc->inc_conds_invsample), qcbits_word0 (trig_qc->inc_conds_sample));
+
+  /* If no sample or invalid sample matching any query condition was added or removed,
+     the incremental change for the query conditions is 0 */
+  const bool qc_changed =
+    rhc->nqconds > 0 &&
+    (qcbits_any (rhc, trig_qc->dec_conds_invsample) || qcbits_any (rhc, trig_qc->dec_conds_sample) ||
+     qcbits_any (rhc, trig_qc->inc_conds_invsample) || qcbits_any (rhc, trig_qc->inc_conds_sample));
 
   assert (rhc->n_nonempty_instances >= rhc->n_not_alive_disposed + rhc->n_not_alive_no_writers);
 #ifndef DDSI_INCLUDE_LIFESPAN
@@ -2656,7 +3095,7 @@ static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_f
         DDS_FATAL ("update_readconditions: sample_states invalid: %"PRIx32"\n", iter->m_sample_states);
     }
 
-    TRACE ("  cond %p %08"PRIx32": ", (void *) iter, iter->m_query.m_qcmask);
+    TRACE ("  cond %p %"PRIu32": ", (void *) iter, iter->m_query.m_qcgroup);
     if (iter->m_query.m_filter == 0)
     {
       assert (dds_entity_kind (&iter->m_entity) == DDS_KIND_COND_READ);
@@ -2679,41 +3118,44 @@ static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_f
     else if (m_pre || m_post) /* no need to look any further if both are false */
     {
       assert (dds_entity_kind (&iter->m_entity) == DDS_KIND_COND_QUERY);
-      assert (iter->m_query.m_qcmask != 0);
-      const dds_querycond_mask_t qcmask = iter->m_query.m_qcmask;
+      assert (iter->m_query.m_qcgroup < rhc->nqcgroups && rhc->qcgroups[iter->m_query.m_qcgroup].filter == iter->m_query.m_filter);
+      const uint32_t g = iter->m_query.m_qcgroup;
       int32_t mdelta = 0;
 
-      switch (iter->m_sample_states)
+      if (qc_changed)
       {
-        case DDS_SST_READ:
-          if (trig_qc->dec_invsample_read)
-            mdelta -= (trig_qc->dec_conds_invsample & qcmask) != 0;
-          if (trig_qc->dec_sample_read)
-            mdelta -= (trig_qc->dec_conds_sample & qcmask) != 0;
-          if (trig_qc->inc_invsample_read)
-            mdelta += (trig_qc->inc_conds_invsample & qcmask) != 0;
-          if (trig_qc->inc_sample_read)
-            mdelta += (trig_qc->inc_conds_sample & qcmask) != 0;
-          break;
-        case DDS_SST_NOT_READ:
-          if (!trig_qc->dec_invsample_read)
-            mdelta -= (trig_qc->dec_conds_invsample & qcmask) != 0;
-          if (!trig_qc->dec_sample_read)
-            mdelta -= (trig_qc->dec_conds_sample & qcmask) != 0;
-          if (!trig_qc->inc_invsample_read)
-            mdelta += (trig_qc->inc_conds_invsample & qcmask) != 0;
-          if (!trig_qc->inc_sample_read)
-            mdelta += (trig_qc->inc_conds_sample & qcmask) != 0;
-          break;
-        case DDS_SST_READ | DDS_SST_NOT_READ:
-        case 0:
-          mdelta -= (trig_qc->dec_conds_invsample & qcmask) != 0;
-          mdelta -= (trig_qc->dec_conds_sample & qcmask) != 0;
-          mdelta += (trig_qc->inc_conds_invsample & qcmask) != 0;
-          mdelta += (trig_qc->inc_conds_sample & qcmask) != 0;
-          break;
-        default:
-          DDS_FATAL ("update_readconditions: sample_states invalid: %"PRIx32"\n", iter->m_sample_states);
+        switch (iter->m_sample_states)
+        {
+          case DDS_SST_READ:
+            if (trig_qc->dec_invsample_read)
+              mdelta -= qcbits_test (trig_qc->dec_conds_invsample, g);
+            if (trig_qc->dec_sample_read)
+              mdelta -= qcbits_test (trig_qc->dec_conds_sample, g);
+            if (trig_qc->inc_invsample_read)
+              mdelta += qcbits_test (trig_qc->inc_conds_invsample, g);
+            if (trig_qc->inc_sample_read)
+              mdelta += qcbits_test (trig_qc->inc_conds_sample, g);
+            break;
+          case DDS_SST_NOT_READ:
+            if (!trig_qc->dec_invsample_read)
+              mdelta -= qcbits_test (trig_qc->dec_conds_invsample, g);
+            if (!trig_qc->dec_sample_read)
+              mdelta -= qcbits_test (trig_qc->dec_conds_sample, g);
+            if (!trig_qc->inc_invsample_read)
+              mdelta += qcbits_test (trig_qc->inc_conds_invsample, g);
+            if (!trig_qc->inc_sample_read)
+              mdelta += qcbits_test (trig_qc->inc_conds_sample, g);
+            break;
+          case DDS_SST_READ | DDS_SST_NOT_READ:
+          case 0:
+            mdelta -= qcbits_test (trig_qc->dec_conds_invsample, g);
+            mdelta -= qcbits_test (trig_qc->dec_conds_sample, g);
+            mdelta += qcbits_test (trig_qc->inc_conds_invsample, g);
+            mdelta += qcbits_test (trig_qc->inc_conds_sample, g);
+            break;
+          default:
+            DDS_FATAL ("update_readconditions: sample_states invalid: %"PRIx32"\n", iter->m_sample_states);
+        }
       }
 
       if (m_pre == m_post)
@@ -2747,12 +3189,12 @@ static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_f
            difference is in whether the number of matches should be added or subtracted. */
         int32_t mcurrent = 0;
         if (inst->inv_exists)
-          mcurrent += (qmask_of_invsample (inst) & iter->m_qminv) == 0 && (inst->conds & qcmask) != 0;
+          mcurrent += (qmask_of_invsample (inst) & iter->m_qminv) == 0 && qcbits_test (inst->conds, g);
         if (inst->latest)
         {
           struct rhc_sample *sample = inst->latest->next, * const end = sample;
           do {
-            mcurrent += (qmask_of_sample (sample) & iter->m_qminv) == 0 && (sample->conds & qcmask) != 0;
+            mcurrent += (qmask_of_sample (sample) & iter->m_qminv) == 0 && qcbits_test (sample->conds, g);
             sample = sample->next;
           } while (sample != end);
         }
@@ -2789,7 +3231,19 @@ static bool update_conditions_locked (struct dds_rhc_default *rhc, bool called_f
 
     if (trigger)
     {
-      if (*ntriggers < MAX_FAST_TRIGGERS)
+      /* a batch of stores may trigger the same condition more than once; outside
+         a store there is no array (and ntriggers is SIZE_MAX) */
+      size_t i = 0;
+      if (*ntriggers <= MAX_FAST_TRIGGERS)
+      {
+        while (i < *ntriggers && triggers[i] != &iter->m_entity)
+          i++;
+      }
+      if (*ntriggers > MAX_FAST_TRIGGERS)
+        dds_entity_status_signal (&iter->m_entity, DDS_DATA_AVAILABLE_STATUS);
+      else if (i < *ntriggers)
+        ; /* already scheduled for signalling */
+      else if (*ntriggers < MAX_FAST_TRIGGERS)
         triggers[(*ntriggers)++] = &iter->m_entity;
       else
         dds_entity_status_signal (&iter->m_entity, DDS_DATA_AVAILABLE_STATUS);
@@ -2829,6 +3283,14 @@ static int dds_rhc_default_takecdr (struct dds_rhc_default *rhc, bool lock, stru
 
 #ifndef NDEBUG
 #define CHECK_MAX_CONDS 64
+static void check_qcbits (const struct dds_rhc_default *rhc, const dds_querycond_mask_t *bm)
+{
+  /* qcond_eval_samplebuf holds the sample; bits of unused groups are don't cares */
+  for (uint32_t g = 0; g < rhc->nqcgroups; g++)
+    if (rhc->qcgroups[g].filter != 0)
+      assert (qcbits_test (bm, g) == rhc->qcgroups[g].filter (rhc->qcond_eval_samplebuf));
+}
+
 static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_conds, bool check_qcmask)
 {
   if (!rhc->xchecks)
@@ -2840,7 +3302,6 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
   unsigned n_vsamples = 0, n_vread = 0;
   unsigned n_invsamples = 0, n_invread = 0;
   unsigned cond_match_count[CHECK_MAX_CONDS];
-  dds_querycond_mask_t enabled_qcmask = 0;
   struct rhc_instance *inst;
   struct ddsrt_hh_iter iter;
   dds_readcond *rciter;
@@ -2853,9 +3314,25 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
   {
     assert ((dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_READ && rciter->m_query.m_filter == 0) ||
             (dds_entity_kind (&rciter->m_entity) == DDS_KIND_COND_QUERY && rciter->m_query.m_filter != 0));
-    assert ((rciter->m_query.m_filter != 0) == (rciter->m_query.m_qcmask != 0));
-    assert (!(enabled_qcmask & rciter->m_query.m_qcmask));
-    enabled_qcmask |= rciter->m_query.m_qcmask;
+    assert (rciter->m_query.m_filter == 0 || (rciter->m_query.m_qcgroup < rhc->nqcgroups && rhc->qcgroups[rciter->m_query.m_qcgroup].filter == rciter->m_query.m_filter));
+  }
+  assert ((rhc->nqconds == 0) == (rhc->qcpool.nwords == 0));
+  assert (rhc->nqcgroups <= rhc->qcpool.nwords * QC_WORD_BITS);
+  for (i = 0; i < rhc->nqcgroups; i++)
+  {
+    uint32_t nconds = 0, nsamplest = 0;
+    for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
+    {
+      if (rciter->m_query.m_filter != 0 && rciter->m_query.m_qcgroup == i)
+      {
+        nconds++;
+        nsamplest += cond_is_sample_state_dependent (rciter);
+      }
+    }
+    assert (nconds == rhc->qcgroups[i].nconds);
+    assert (nsamplest == rhc->qcgroups[i].nsamplest);
+    assert ((rhc->qcgroups[i].filter != 0) == (nconds > 0));
+    assert (qcbits_test (rhc->qcgroups_samplest, i) == (nsamplest > 0));
   }
 
   for (inst = ddsrt_hh_iter_first (rhc->instances, &iter); inst; inst = ddsrt_hh_iter_next (&iter))
@@ -2909,23 +3386,14 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
     {
       if (check_qcmask && rhc->nqconds > 0)
       {
-        dds_querycond_mask_t qcmask;
         topicless_to_clean_invsample (rhc->topic, inst->tk->m_sample, rhc->qcond_eval_samplebuf, 0, 0);
-        qcmask = 0;
-        for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
-          if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
-            qcmask |= rciter->m_query.m_qcmask;
-        assert ((inst->conds & enabled_qcmask) == qcmask);
+        check_qcbits (rhc, inst->conds);
         if (inst->latest)
         {
           struct rhc_sample *sample = inst->latest->next, * const end = sample;
           do {
             ddsi_serdata_to_sample (sample->sample, rhc->qcond_eval_samplebuf, NULL, NULL);
-            qcmask = 0;
-            for (rciter = rhc->conds; rciter; rciter = rciter->m_next)
-              if (rciter->m_query.m_filter != 0 && rciter->m_query.m_filter (rhc->qcond_eval_samplebuf))
-                qcmask |= rciter->m_query.m_qcmask;
-            assert ((sample->conds & enabled_qcmask) == qcmask);
+            check_qcbits (rhc, sample->conds);
             sample = sample->next;
           } while (sample != end);
         }
@@ -2940,12 +3408,12 @@ static int rhc_check_counts_locked (struct dds_rhc_default *rhc, bool check_cond
         else
         {
           if (inst->inv_exists)
-            cond_match_count[i] += (qmask_of_invsample (inst) & rciter->m_qminv) == 0 && (inst->conds & rciter->m_query.m_qcmask) != 0;
+            cond_match_count[i] += (qmask_of_invsample (inst) & rciter->m_qminv) == 0 && qcbits_test (inst->conds, rciter->m_query.m_qcgroup);
           if (inst->latest)
           {
             struct rhc_sample *sample = inst->latest->next, * const end = sample;
             do {
-              cond_match_count[i] += ((qmask_of_sample (sample) & rciter->m_qminv) == 0 && (sample->conds & rciter->m_query.m_qcmask) != 0);
+              cond_match_count[i] += ((qmask_of_sample (sample) & rciter->m_qminv) == 0 && qcbits_test (sample->conds, rciter->m_query.m_qcgroup));
               sample = sample->next;
             } while (sample != end);
           }
@@ -93,13 +93,26 @@ dds_return_t dds_notify_readers (dds_entity_t subscriber)
   return DDS_RETCODE_UNSUPPORTED;
 }
 
+/* Coherent sets are held back by the readers until they are complete and then become
+   visible in a single step, so there is no need for the application to bracket its
+   accesses; these merely validate the subscriber. */
 dds_return_t dds_subscriber_begin_coherent (dds_entity_t e)
 {
-  return dds_generic_unimplemented_operation (e, DDS_KIND_SUBSCRIBER);
+  dds_subscriber *sub;
+  dds_return_t ret;
+  if ((ret = dds_subscriber_lock (e, &sub)) != DDS_RETCODE_OK)
+    return ret;
+  dds_subscriber_unlock (sub);
+  return DDS_RETCODE_OK;
 }
 
 dds_return_t dds_subscriber_end_coherent (dds_entity_t e)
 {
-  return dds_generic_unimplemented_operation (e, DDS_KIND_SUBSCRIBER);
+  dds_subscriber *sub;
+  dds_return_t ret;
+  if ((ret = dds_subscriber_lock (e, &sub)) != DDS_RETCODE_OK)
+    return ret;
+  dds_subscriber_unlock (sub);
+  return DDS_RETCODE_OK;
 }
 
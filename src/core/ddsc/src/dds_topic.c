@@ -412,7 +412,10 @@ dds_entity_t dds_create_topic (dds_entity_t participant, const dds_topic_descrip
   st->serpool = ppent->m_domain->gv.serpool;
   st->type.m_size = desc->m_size;
   st->type.m_align = desc->m_align;
-  st->type.m_flagset = desc->m_flagset;
+  /* specialized (de)serializers don't affect the type, so they mustn't affect
+     the comparison of sertopics either */
+  st->type.m_flagset = desc->m_flagset & ~(uint32_t) DDS_TOPIC_CDR_OPS;
+  st->type.m_cdr_ops = (desc->m_flagset & DDS_TOPIC_CDR_OPS) ? desc->m_cdr_ops : NULL;
   st->type.m_nkeys = desc->m_nkeys;
   st->type.m_keys = ddsrt_malloc (st->type.m_nkeys  * sizeof (*st->type.m_keys));
   for (uint32_t i = 0; i < st->type.m_nkeys; i++)
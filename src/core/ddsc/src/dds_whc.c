@@ -53,7 +53,7 @@ struct whc_node {
   ddsrt_mtime_t last_rexmit_ts;
   uint32_t rexmit_count;
 #ifdef DDSI_INCLUDE_LIFESPAN
-  struct lifespan_fhnode lifespan; /* fibheap node for lifespan */
+  struct lifespan_node lifespan; /* expiry node for lifespan */
 #endif
   struct ddsi_serdata *serdata;
 };
@@ -11,6 +11,7 @@
  */
 #include <assert.h>
 #include <string.h>
+#include "dds/ddsrt/heap.h"
 #include "dds__writer.h"
 #include "dds__write.h"
 #include "dds/ddsi/ddsi_tkmap.h"
@@ -26,6 +27,7 @@
 #include "dds/ddsi/q_radmin.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/ddsi_deliver_locally.h"
+#include "dds/ddsi/ddsi_latency_stats.h"
 
 dds_return_t dds_write (dds_entity_t writer, const void *data)
 {
@@ -109,12 +111,20 @@ static struct ddsi_serdata *local_make_sample (struct ddsi_tkmap_instance **tk,
   }
   else
   {
-    /* ouch ... convert a serdata from one sertopic to another ... */
-    ddsrt_iovec_t iov;
+    /* ouch ... convert a serdata from one sertopic to another ... the serialised
+       representation need not be contiguous, so it may take several references */
     uint32_t size = ddsi_serdata_size (si->src_payload);
-    (void) ddsi_serdata_to_ser_ref (si->src_payload, 0, size, &iov);
-    struct ddsi_serdata *d = ddsi_serdata_from_ser_iov (topic, si->src_payload->kind, 1, &iov, size);
-    ddsi_serdata_to_ser_unref (si->src_payload, &iov);
+    ddsrt_iovec_t *iov = NULL;
+    uint32_t niov = 0;
+    for (uint32_t off = 0; off < size; off += (uint32_t) iov[niov - 1].iov_len)
+    {
+      iov = ddsrt_realloc (iov, (niov + 1) * sizeof (*iov));
+      (void) ddsi_serdata_to_ser_ref (si->src_payload, off, size - off, &iov[niov++]);
+    }
+    struct ddsi_serdata *d = ddsi_serdata_from_ser_iov (topic, si->src_payload->kind, (ddsrt_msg_iovlen_t) niov, iov, size);
+    for (uint32_t i = 0; i < niov; i++)
+      ddsi_serdata_to_ser_unref (si->src_payload, &iov[i]);
+    ddsrt_free (iov);
     if (d)
     {
       d->statusinfo = si->src_payload->statusinfo;
@@ -148,14 +158,15 @@ static dds_return_t local_on_delivery_failure_fastpath (struct entity_common *so
   }
 }
 
+static const struct deliver_locally_ops deliver_locally_ops = {
+  .makesample = local_make_sample,
+  .first_reader = writer_first_in_sync_reader,
+  .next_reader = writer_next_in_sync_reader,
+  .on_failure_fastpath = local_on_delivery_failure_fastpath
+};
+
 static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *payload, struct ddsi_tkmap_instance *tk)
 {
-  static const struct deliver_locally_ops deliver_locally_ops = {
-    .makesample = local_make_sample,
-    .first_reader = writer_first_in_sync_reader,
-    .next_reader = writer_next_in_sync_reader,
-    .on_failure_fastpath = local_on_delivery_failure_fastpath
-  };
   struct local_sourceinfo sourceinfo = {
     .src_topic = wr->topic,
     .src_payload = payload,
@@ -165,13 +176,20 @@ static dds_return_t deliver_locally (struct writer *wr, struct ddsi_serdata *pay
   dds_return_t rc;
   struct ddsi_writer_info wrinfo;
   ddsi_make_writer_info (&wrinfo, &wr->e, wr->xqos, payload->statusinfo);
+  if (wr->xqos->presentation.coherent_access)
+  {
+    /* the sample has been stamped with the set it belongs to when it was written */
+    ddsrt_mutex_lock (&wr->e.lock);
+    wrinfo.coherent_set_seq = wr->cs_seq;
+    ddsrt_mutex_unlock (&wr->e.lock);
+  }
   rc = deliver_locally_allinsync (wr->e.gv, &wr->e, false, &wr->rdary, &wrinfo, &deliver_locally_ops, &sourceinfo);
   if (rc == DDS_RETCODE_TIMEOUT)
     DDS_CERROR (&wr->e.gv->logconfig, "The writer could not deliver data on time, probably due to a local reader resources being full\n");
   return rc;
 }
 
-dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstamp, dds_write_action action)
+static dds_return_t dds_write_impl_common (dds_writer *wr, const void * data, dds_time_t tstamp, dds_write_action action, dds_pinned_release_fn release, void *release_arg)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
   const bool writekey = action & DDS_WR_KEY_BIT;
@@ -187,17 +205,26 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
   /* Check for topic filter */
   if (wr->m_topic->filter_fn && !writekey)
     if (! wr->m_topic->filter_fn (data, wr->m_topic->filter_ctx))
+    {
+      if (release)
+        release (release_arg);
       return DDS_RETCODE_OK;
+    }
 
   thread_state_awake (ts1, &wr->m_entity.m_domain->gv);
 
   /* Serialize and write data or key */
-  d = ddsi_serdata_from_sample (ddsi_wr->topic, writekey ? SDK_KEY : SDK_DATA, data);
+  int64_t tlat = DDSI_LATENCY_START (wr->m_entity.m_domain->gv.config.latency_stats);
+  if (release == NULL)
+    d = ddsi_serdata_from_sample (ddsi_wr->topic, writekey ? SDK_KEY : SDK_DATA, data);
+  else
+    d = ddsi_serdata_from_pinned_sample (ddsi_wr->topic, writekey ? SDK_KEY : SDK_DATA, data, release, release_arg);
   d->statusinfo = (((action & DDS_WR_DISPOSE_BIT) ? NN_STATUSINFO_DISPOSE : 0) |
                    ((action & DDS_WR_UNREGISTER_BIT) ? NN_STATUSINFO_UNREGISTER : 0));
   d->timestamp.v = tstamp;
   ddsi_serdata_ref (d);
   tk = ddsi_tkmap_lookup_instance_ref (wr->m_entity.m_domain->gv.m_tkmap, d);
+  (void) DDSI_LATENCY_LAP (DDSI_LATENCY_SERIALIZE, tlat);
   w_rc = write_sample_gc (ts1, wr->m_xp, ddsi_wr, d, tk);
 
   if (w_rc >= 0) {
@@ -220,6 +247,34 @@ dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstam
   return ret;
 }
 
+dds_return_t dds_write_impl (dds_writer *wr, const void * data, dds_time_t tstamp, dds_write_action action)
+{
+  return dds_write_impl_common (wr, data, tstamp, action, NULL, NULL);
+}
+
+dds_return_t dds_write_pinned (dds_entity_t writer, const void *data, dds_pinned_release_fn release, void *arg)
+{
+  dds_return_t ret;
+  dds_writer *wr;
+
+  if (release == NULL)
+    return DDS_RETCODE_BAD_PARAMETER;
+  if (data == NULL)
+  {
+    release (arg);
+    return DDS_RETCODE_BAD_PARAMETER;
+  }
+
+  if ((ret = dds_writer_lock (writer, &wr)) != DDS_RETCODE_OK)
+  {
+    release (arg);
+    return ret;
+  }
+  ret = dds_write_impl_common (wr, data, dds_time (), 0, release, arg);
+  dds_writer_unlock (wr);
+  return ret;
+}
+
 dds_return_t dds_writecdr_impl_lowlevel (struct writer *ddsi_wr, struct nn_xpack *xp, struct ddsi_serdata *d, bool flush)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
@@ -263,6 +318,35 @@ dds_return_t dds_writecdr_impl (dds_writer *wr, struct ddsi_serdata *d, dds_time
   return dds_writecdr_impl_lowlevel (wr->m_wr, wr->m_xp, d, !wr->whc_batch);
 }
 
+void dds_write_begin_coherent (dds_writer *wr)
+{
+  writer_begin_coherent (wr->m_wr);
+}
+
+dds_return_t dds_write_end_coherent (dds_writer *wr)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct writer *ddsi_wr = wr->m_wr;
+  seqno_t cs_seq;
+  int w_rc;
+
+  thread_state_awake (ts1, &wr->m_entity.m_domain->gv);
+  if ((w_rc = writer_end_coherent (ts1, wr->m_xp, ddsi_wr, &cs_seq)) >= 0)
+  {
+    /* a coherent set must not linger in the packing buffer, whatever the batching mode */
+    nn_xpack_send (wr->m_xp, false);
+    if (cs_seq != 0)
+    {
+      struct ddsi_writer_info wrinfo;
+      ddsi_make_writer_info (&wrinfo, &ddsi_wr->e, ddsi_wr->xqos, 0);
+      wrinfo.coherent_set_seq = cs_seq;
+      deliver_locally_commit (ddsi_wr->e.gv, &ddsi_wr->e, false, NULL, &ddsi_wr->rdary, &wrinfo, &deliver_locally_ops);
+    }
+  }
+  thread_state_asleep (ts1);
+  return (w_rc >= 0) ? DDS_RETCODE_OK : (w_rc == DDS_RETCODE_TIMEOUT) ? DDS_RETCODE_TIMEOUT : DDS_RETCODE_ERROR;
+}
+
 void dds_write_flush (dds_entity_t writer)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
@@ -19,6 +19,7 @@
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_xmsg.h"
+#include "dds/ddsi/q_transmit.h"
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds__writer.h"
 #include "dds__listener.h"
@@ -343,6 +344,9 @@ dds_entity_t dds_create_writer (dds_entity_t participant_or_publisher, dds_entit
   thread_state_awake (lookup_thread_state (), &pub->m_entity.m_domain->gv);
   rc = new_writer (&wr->m_wr, &wr->m_entity.m_domain->gv, &wr->m_entity.m_guid, NULL, dds_entity_participant_guid (&pub->m_entity), tp->m_stopic, wqos, wr->m_whc, dds_writer_status_cb, wr);
   assert(rc == DDS_RETCODE_OK);
+  /* a writer created in the middle of a coherent set is part of it */
+  if (pub->m_coherent_depth > 0)
+    writer_begin_coherent (wr->m_wr);
   thread_state_asleep (lookup_thread_state ());
 
   wr->m_entity.m_iid = get_entity_instance_id (&wr->m_entity.m_domain->gv, &wr->m_entity.m_guid);
@@ -0,0 +1,167 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/sockets.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define NSAMPLES 100
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_BUSY_POLL "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><Internal><MultipleReceiveThreads>%s</MultipleReceiveThreads><ReceiveBusyPoll socket=\"%s\">10 ms</ReceiveBusyPoll></Internal>"
+
+static dds_entity_t create_domain (dds_domainid_t domid, const char *multiple_recv_threads, const char *socket)
+{
+  char *conf_raw, *conf;
+  dds_entity_t dom;
+  (void) ddsrt_asprintf (&conf_raw, DDS_CONFIG_BUSY_POLL, multiple_recv_threads, socket);
+  conf = ddsrt_expand_envvars (conf_raw, domid);
+  dom = dds_create_domain (domid, conf);
+  dds_free (conf);
+  dds_free (conf_raw);
+  return dom;
+}
+
+/* Sums the number of packets received by the receive threads dedicated to a
+   single socket while spinning and after blocking */
+static void get_poll_counts (dds_entity_t entity, uint64_t *nspin, uint64_t *nblock)
+{
+  struct dds_entity *x;
+  CU_ASSERT_FATAL (dds_entity_pin (entity, &x) == DDS_RETCODE_OK);
+  const struct ddsi_domaingv *gv = &x->m_domain->gv;
+  *nspin = *nblock = 0;
+  for (uint32_t i = 0; i < gv->n_recv_threads; i++)
+  {
+    if (gv->recv_threads[i].arg.mode != RTM_SINGLE)
+      continue;
+    *nspin += ddsrt_atomic_ld64 (&gv->recv_threads[i].arg.u.single.npoll_spin);
+    *nblock += ddsrt_atomic_ld64 (&gv->recv_threads[i].arg.u.single.npoll_block);
+  }
+  dds_entity_unpin (x);
+}
+
+CU_Test(ddsc_busy_poll, counters)
+{
+  char topic_name[100];
+  const dds_entity_t pub_dom = create_domain (DDS_DOMAINID_PUB, "true", "false");
+  CU_ASSERT_FATAL (pub_dom > 0);
+  const dds_entity_t sub_dom = create_domain (DDS_DOMAINID_SUB, "true", "false");
+  CU_ASSERT_FATAL (sub_dom > 0);
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+
+  create_unique_topic_name ("ddsc_busy_poll", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_publication_matched_status_t pm;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &pm) == DDS_RETCODE_OK);
+    if (pm.current_count == 0)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (pm.current_count == 0 && dds_time () < tmatch);
+  CU_ASSERT_FATAL (pm.current_count == 1);
+
+  /* idle for much longer than the budget: the threads give up spinning and
+     block */
+  uint64_t nspin0, nblock0;
+  dds_sleepfor (DDS_MSECS (100));
+  get_poll_counts (sub_pp, &nspin0, &nblock0);
+  CU_ASSERT (nblock0 > 0);
+
+  /* samples arriving well within the budget are picked up while spinning */
+  for (int32_t i = 0; i < NSAMPLES; i++)
+  {
+    Space_Type1 s = { i, 0, 0 };
+    CU_ASSERT_FATAL (dds_write (wr, &s) == DDS_RETCODE_OK);
+    dds_sleepfor (DDS_MSECS (1));
+  }
+  int32_t count = 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (count < NSAMPLES && dds_time () < tend)
+  {
+    Space_Type1 s;
+    void *ptr = &s;
+    dds_sample_info_t si;
+    int32_t n = dds_take (rd, &ptr, &si, 1, 1);
+    CU_ASSERT_FATAL (n >= 0);
+    if (n == 0)
+      dds_sleepfor (DDS_MSECS (10));
+    else
+      count++;
+  }
+  CU_ASSERT (count == NSAMPLES);
+
+  uint64_t nspin1, nblock1;
+  get_poll_counts (sub_pp, &nspin1, &nblock1);
+  CU_ASSERT (nspin1 > nspin0);
+  CU_ASSERT (nblock1 >= nblock0);
+  dds_delete (pub_dom);
+  dds_delete (sub_dom);
+}
+
+static void logsink (void *arg, const dds_log_data_t *msg)
+{
+  ddsrt_atomic_uint32_t *nwarnings = arg;
+  if (strstr (msg->message, "ReceiveBusyPoll has no effect") != NULL)
+    ddsrt_atomic_inc32 (nwarnings);
+}
+
+CU_Test(ddsc_busy_poll, single_receive_thread)
+{
+  /* there is nothing to spin for if all sockets are handled by one thread */
+  ddsrt_atomic_uint32_t nwarnings = DDSRT_ATOMIC_UINT32_INIT (0);
+  dds_set_log_sink (logsink, &nwarnings);
+  const dds_entity_t dom = create_domain (DDS_DOMAINID_PUB, "false", "false");
+  CU_ASSERT_FATAL (dom > 0);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nwarnings) == 1);
+  uint64_t nspin, nblock;
+  get_poll_counts (dom, &nspin, &nblock);
+  CU_ASSERT (nspin == 0 && nblock == 0);
+  dds_delete (dom);
+  dds_set_log_sink (NULL, NULL);
+}
+
+CU_Test(ddsc_busy_poll, socket_option)
+{
+  /* SO_BUSY_POLL is set on the receive sockets where it exists, elsewhere
+     asking for it makes the configuration invalid */
+  const dds_entity_t dom = create_domain (DDS_DOMAINID_PUB, "true", "true");
+#ifdef SO_BUSY_POLL
+  CU_ASSERT (dom > 0);
+  dds_delete (dom);
+#else
+  CU_ASSERT (dom < 0);
+#endif
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsi/ddsi_cdrstream.h"
+
+#include "test_common.h"
+#include "CdrOpsTypes.h"
+
+#define NSAMPLES 10
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+/* The specialized (de)serializers generated by idlc are wrapped in functions
+   that count the calls */
+static ddsrt_atomic_uint32_t nwrite, nread, nnormalize;
+
+static void counting_write (dds_ostream_t * __restrict os, const void * __restrict sample)
+{
+  ddsrt_atomic_inc32 (&nwrite);
+  CdrOpsTypes_T_cdr_ops.m_write (os, sample);
+}
+
+static void counting_read (dds_istream_t * __restrict is, void * __restrict sample)
+{
+  ddsrt_atomic_inc32 (&nread);
+  CdrOpsTypes_T_cdr_ops.m_read (is, sample);
+}
+
+static bool counting_normalize (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)
+{
+  ddsrt_atomic_inc32 (&nnormalize);
+  return CdrOpsTypes_T_cdr_ops.m_normalize (data, off, size, bswap);
+}
+
+static dds_topic_cdr_ops_t counting_cdr_ops;
+
+static void cdr_ops_init (void)
+{
+  counting_cdr_ops.m_write = counting_write;
+  counting_cdr_ops.m_read = counting_read;
+  counting_cdr_ops.m_normalize = counting_normalize;
+  counting_cdr_ops.m_extract_key = CdrOpsTypes_T_cdr_ops.m_extract_key;
+  ddsrt_atomic_st32 (&nwrite, 0);
+  ddsrt_atomic_st32 (&nread, 0);
+  ddsrt_atomic_st32 (&nnormalize, 0);
+}
+
+/* Sends samples from one domain to a reader in another, with both topics
+   created from a copy of the generated descriptor with the given flags and
+   the counting (de)serializers */
+static void pubsub (uint32_t flagset)
+{
+  const dds_topic_descriptor_t desc = {
+    .m_size = CdrOpsTypes_T_desc.m_size,
+    .m_align = CdrOpsTypes_T_desc.m_align,
+    .m_flagset = flagset,
+    .m_nkeys = CdrOpsTypes_T_desc.m_nkeys,
+    .m_typename = CdrOpsTypes_T_desc.m_typename,
+    .m_keys = CdrOpsTypes_T_desc.m_keys,
+    .m_nops = CdrOpsTypes_T_desc.m_nops,
+    .m_ops = CdrOpsTypes_T_desc.m_ops,
+    .m_meta = CdrOpsTypes_T_desc.m_meta,
+    .m_cdr_ops = &counting_cdr_ops
+  };
+  char topic_name[100];
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_SUB);
+  const dds_entity_t pub_dom = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (pub_dom > 0);
+  const dds_entity_t sub_dom = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (sub_dom > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+
+  create_unique_topic_name ("ddsc_cdr_ops", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_publication_matched_status_t pm;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &pm) == DDS_RETCODE_OK);
+    if (pm.current_count == 0)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (pm.current_count == 0 && dds_time () < tmatch);
+  CU_ASSERT_FATAL (pm.current_count == 1);
+
+  for (int32_t i = 0; i < NSAMPLES; i++)
+  {
+    char str[20];
+    (void) snprintf (str, sizeof (str), "sample %"PRId32, i);
+    CdrOpsTypes_T s = { i, str };
+    CU_ASSERT_FATAL (dds_write (wr, &s) == DDS_RETCODE_OK);
+  }
+
+  int32_t count = 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (count < NSAMPLES && dds_time () < tend)
+  {
+    void *ptr = NULL;
+    dds_sample_info_t si;
+    int32_t n = dds_take (rd, &ptr, &si, 1, 1);
+    CU_ASSERT_FATAL (n >= 0);
+    if (n == 0)
+      dds_sleepfor (DDS_MSECS (10));
+    else
+    {
+      const CdrOpsTypes_T *s = ptr;
+      char str[20];
+      CU_ASSERT_FATAL (si.valid_data);
+      (void) snprintf (str, sizeof (str), "sample %"PRId32, s->k);
+      CU_ASSERT (strcmp (s->s, str) == 0);
+      count++;
+      (void) dds_return_loan (rd, &ptr, n);
+    }
+  }
+  CU_ASSERT (count == NSAMPLES);
+  dds_delete (pub_dom);
+  dds_delete (sub_dom);
+}
+
+CU_Test(ddsc_cdr_ops, descriptor)
+{
+  /* idlc -specialize refers to the generated functions from the descriptor */
+  CU_ASSERT (CdrOpsTypes_T_desc.m_flagset & DDS_TOPIC_CDR_OPS);
+  CU_ASSERT (CdrOpsTypes_T_desc.m_cdr_ops == &CdrOpsTypes_T_cdr_ops);
+}
+
+CU_Test(ddsc_cdr_ops, used, .init = cdr_ops_init)
+{
+  /* serialized by the writer, normalized on reception and deserialized when
+     taken */
+  pubsub (CdrOpsTypes_T_desc.m_flagset);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nwrite) >= NSAMPLES);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nnormalize) >= NSAMPLES);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nread) >= NSAMPLES);
+}
+
+CU_Test(ddsc_cdr_ops, flag_required, .init = cdr_ops_init)
+{
+  /* without the flag, m_cdr_ops doesn't exist in the descriptor: it may have
+     been generated for an older version */
+  pubsub (CdrOpsTypes_T_desc.m_flagset & ~(uint32_t) DDS_TOPIC_CDR_OPS);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nwrite) == 0);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nnormalize) == 0);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nread) == 0);
+}
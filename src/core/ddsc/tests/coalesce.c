@@ -0,0 +1,259 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/misc.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+#include "RoundTrip.h"
+
+#define NSAMPLES 10
+#define SAMPLE_SIZE 256000u
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_COALESCE "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><Internal><CoalesceFragments>%s</CoalesceFragments>%s</Internal><Tracing><PacketCaptureFile>%s</PacketCaptureFile></Tracing>"
+
+/* Offsets in the captured records (see pcap.c): the pcap file header, then
+   per record a pcap record header, fake IPv4 and UDP headers and the RTPS
+   message; and in a DATA_FRAG the fragmentsInSubmessage field */
+#define PCAP_FILE_HDR_SIZE 24
+#define PCAP_REC_HDR_SIZE 16
+#define RTPS_OFFSET (20 + 8)
+#define RTPS_HDR_SIZE 20
+#define SMID_DATA_FRAG 0x16
+#define DATA_FRAG_NFRAGS_OFFSET 28
+
+static char g_pcap_file[64];
+
+static void coalesce_init (void)
+{
+  (void) snprintf (g_pcap_file, sizeof (g_pcap_file), "cyclonedds_coalesce_test.%"PRIdPID".pcap", ddsrt_getpid ());
+  (void) remove (g_pcap_file);
+}
+
+static void coalesce_fini (void)
+{
+  (void) remove (g_pcap_file);
+}
+
+static uint16_t rd16 (const unsigned char *p, bool little_endian)
+{
+  return little_endian ? (uint16_t) (p[0] | (p[1] << 8)) : (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+/* Returns the largest number of fragments in any DATA_FRAG submessage in the
+   captured packets */
+static uint16_t max_frags_per_datafrag (void)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  FILE *fp = fopen (g_pcap_file, "rb");
+  DDSRT_WARNING_MSVC_ON(4996);
+  CU_ASSERT_FATAL (fp != NULL);
+  (void) fseek (fp, 0, SEEK_END);
+  const long sz = ftell (fp);
+  (void) fseek (fp, 0, SEEK_SET);
+  CU_ASSERT_FATAL (sz >= PCAP_FILE_HDR_SIZE);
+  unsigned char *buf = ddsrt_malloc ((size_t) sz);
+  CU_ASSERT_FATAL (fread (buf, (size_t) sz, 1, fp) == 1);
+  fclose (fp);
+
+  uint16_t max = 0;
+  size_t off = PCAP_FILE_HDR_SIZE;
+  while (off + PCAP_REC_HDR_SIZE <= (size_t) sz)
+  {
+    uint32_t incl_len;
+    memcpy (&incl_len, buf + off + 8, sizeof (incl_len));
+    off += PCAP_REC_HDR_SIZE;
+    if (off + incl_len > (size_t) sz)
+      break;
+    const unsigned char *rtps = buf + off + RTPS_OFFSET;
+    const size_t rtps_sz = (incl_len > RTPS_OFFSET) ? incl_len - RTPS_OFFSET : 0;
+    size_t smoff = RTPS_HDR_SIZE;
+    if (rtps_sz < RTPS_HDR_SIZE || memcmp (rtps, "RTPS", 4) != 0)
+      smoff = rtps_sz;
+    while (smoff + 4 <= rtps_sz)
+    {
+      const unsigned char *sm = rtps + smoff;
+      const bool le = (sm[1] & 1) != 0;
+      const uint16_t octets = rd16 (sm + 2, le);
+      if (sm[0] == SMID_DATA_FRAG && smoff + DATA_FRAG_NFRAGS_OFFSET + 2 <= rtps_sz)
+      {
+        const uint16_t n = rd16 (sm + DATA_FRAG_NFRAGS_OFFSET, le);
+        if (n > max)
+          max = n;
+      }
+      smoff = (octets == 0) ? rtps_sz : smoff + 4 + octets;
+    }
+    off += incl_len;
+  }
+  ddsrt_free (buf);
+  return max;
+}
+
+static dds_entity_t create_domain (dds_domainid_t domid, const char *coalesce, const char *rate)
+{
+  char *conf_raw, *conf, *rate_elem;
+  dds_entity_t dom;
+  if (rate)
+    (void) ddsrt_asprintf (&rate_elem, "<LargeSampleRate>%s</LargeSampleRate>", rate);
+  else
+    rate_elem = ddsrt_strdup ("");
+  (void) ddsrt_asprintf (&conf_raw, DDS_CONFIG_COALESCE, coalesce, rate_elem, (domid == DDS_DOMAINID_PUB) ? g_pcap_file : "");
+  conf = ddsrt_expand_envvars (conf_raw, domid);
+  dom = dds_create_domain (domid, conf);
+  CU_ASSERT_FATAL (dom > 0);
+  dds_free (conf);
+  dds_free (conf_raw);
+  dds_free (rate_elem);
+  return dom;
+}
+
+static uint32_t get_large_sample_rate (dds_entity_t entity)
+{
+  struct dds_entity *x;
+  uint32_t rate;
+  CU_ASSERT_FATAL (dds_entity_pin (entity, &x) == DDS_RETCODE_OK);
+  rate = x->m_domain->gv.config.large_sample_rate.value;
+  dds_entity_unpin (x);
+  return rate;
+}
+
+/* Writes NSAMPLES large samples from one domain to a reader in another and
+   checks that they are all reassembled correctly, returning the time it took
+   to write them */
+static dds_duration_t pubsub (const char *coalesce, const char *rate, uint32_t expected_rate, uint16_t *max_frags)
+{
+  char topic_name[100];
+  const dds_entity_t pub_dom = create_domain (DDS_DOMAINID_PUB, coalesce, rate);
+  const dds_entity_t sub_dom = create_domain (DDS_DOMAINID_SUB, coalesce, rate);
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+  CU_ASSERT (get_large_sample_rate (pub_pp) == expected_rate);
+
+  create_unique_topic_name ("ddsc_coalesce", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &RoundTripModule_DataType_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &RoundTripModule_DataType_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_publication_matched_status_t pm;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &pm) == DDS_RETCODE_OK);
+    if (pm.current_count == 0)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (pm.current_count == 0 && dds_time () < tmatch);
+  CU_ASSERT_FATAL (pm.current_count == 1);
+
+  /* the first byte identifies the sample, the others follow from it */
+  unsigned char *payload = ddsrt_malloc (SAMPLE_SIZE);
+  const dds_time_t t0 = dds_time ();
+  for (uint32_t i = 0; i < NSAMPLES; i++)
+  {
+    for (uint32_t j = 0; j < SAMPLE_SIZE; j++)
+      payload[j] = (unsigned char) (i + j);
+    RoundTripModule_DataType s = { .payload = { ._maximum = SAMPLE_SIZE, ._length = SAMPLE_SIZE, ._buffer = payload, ._release = false } };
+    CU_ASSERT_FATAL (dds_write (wr, &s) == DDS_RETCODE_OK);
+  }
+  const dds_duration_t dt = dds_time () - t0;
+  ddsrt_free (payload);
+
+  uint32_t count = 0;
+  bool seen[NSAMPLES] = { false };
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  while (count < NSAMPLES && dds_time () < tend)
+  {
+    void *ptr = NULL;
+    dds_sample_info_t si;
+    int32_t n = dds_take (rd, &ptr, &si, 1, 1);
+    CU_ASSERT_FATAL (n >= 0);
+    if (n == 0)
+      dds_sleepfor (DDS_MSECS (10));
+    else
+    {
+      const RoundTripModule_DataType *s = ptr;
+      CU_ASSERT_FATAL (si.valid_data);
+      CU_ASSERT_FATAL (s->payload._length == SAMPLE_SIZE);
+      const unsigned char first = s->payload._buffer[0];
+      CU_ASSERT_FATAL (first < NSAMPLES && !seen[first]);
+      seen[first] = true;
+      uint32_t j;
+      for (j = 0; j < SAMPLE_SIZE; j++)
+        if (s->payload._buffer[j] != (unsigned char) (first + j))
+          break;
+      CU_ASSERT (j == SAMPLE_SIZE);
+      count++;
+      (void) dds_return_loan (rd, &ptr, n);
+    }
+  }
+  CU_ASSERT (count == NSAMPLES);
+  dds_delete (pub_dom);
+  dds_delete (sub_dom);
+  *max_frags = max_frags_per_datafrag ();
+  return dt;
+}
+
+CU_Test(ddsc_coalesce, default_rate, .init = coalesce_init, .fini = coalesce_fini)
+{
+  /* coalescing fragments implies pacing at 1 GB/s */
+  uint16_t max_frags;
+  (void) pubsub ("true", NULL, 1000000000u, &max_frags);
+  CU_ASSERT (max_frags > 1);
+}
+
+CU_Test(ddsc_coalesce, explicit_rate, .init = coalesce_init, .fini = coalesce_fini)
+{
+  /* at 20 MB/s, writing NSAMPLES samples of 256 kB takes at least 100ms even
+     allowing for the first message of each sample going out immediately */
+  uint16_t max_frags;
+  const dds_duration_t dt = pubsub ("true", "20 MB/s", 20000000u, &max_frags);
+  CU_ASSERT (max_frags > 1);
+  CU_ASSERT (dt >= DDS_MSECS (100));
+}
+
+CU_Test(ddsc_coalesce, unpaced, .init = coalesce_init, .fini = coalesce_fini)
+{
+  /* pacing can be disabled explicitly, the receiver must still get all
+     samples, if need be through retransmits */
+  uint16_t max_frags;
+  (void) pubsub ("true", "inf", 0, &max_frags);
+  CU_ASSERT (max_frags > 1);
+}
+
+CU_Test(ddsc_coalesce, disabled, .init = coalesce_init, .fini = coalesce_fini)
+{
+  /* without coalescing, there is no pacing by default and each DATA_FRAG
+     contains a single fragment */
+  uint16_t max_frags;
+  (void) pubsub ("false", NULL, 0, &max_frags);
+  CU_ASSERT (max_frags == 1);
+}
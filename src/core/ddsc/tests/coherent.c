@@ -0,0 +1,258 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+#define SET_SIZE 3
+
+static dds_entity_t g_pub_domain, g_sub_domain;
+static dds_entity_t g_pub_participant, g_sub_participant;
+static ddsrt_atomic_uint32_t g_data_available;
+
+static void coherent_init (void)
+{
+  /* Two domains mapped to the same port numbers, so that the coherent sets can be
+     exchanged over the network as well as delivered locally */
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_SUB);
+  g_pub_domain = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (g_pub_domain > 0);
+  g_sub_domain = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (g_sub_domain > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  g_pub_participant = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (g_pub_participant > 0);
+  g_sub_participant = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (g_sub_participant > 0);
+  ddsrt_atomic_st32 (&g_data_available, 0);
+}
+
+static void coherent_fini (void)
+{
+  dds_delete (g_pub_domain);
+  dds_delete (g_sub_domain);
+}
+
+static void data_available_cb (dds_entity_t rd, void *arg)
+{
+  (void) rd; (void) arg;
+  ddsrt_atomic_inc32 (&g_data_available);
+}
+
+static int32_t count_samples (dds_entity_t rd)
+{
+  Space_Type1 buf[2 * SET_SIZE + 2];
+  void *ptrs[2 * SET_SIZE + 2];
+  dds_sample_info_t si[2 * SET_SIZE + 2];
+  for (size_t i = 0; i < sizeof (ptrs) / sizeof (ptrs[0]); i++)
+    ptrs[i] = &buf[i];
+  const int32_t n = dds_read (rd, ptrs, si, sizeof (ptrs) / sizeof (ptrs[0]), sizeof (ptrs) / sizeof (ptrs[0]));
+  CU_ASSERT_FATAL (n >= 0);
+  return n;
+}
+
+static void wait_for_samples (dds_entity_t rd, int32_t n)
+{
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  while (count_samples (rd) < n && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT_FATAL (count_samples (rd) == n);
+}
+
+static void wait_for_match (dds_entity_t rd, uint32_t n)
+{
+  dds_subscription_matched_status_t st;
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  do {
+    CU_ASSERT_FATAL (dds_get_subscription_matched_status (rd, &st) == DDS_RETCODE_OK);
+    if (st.current_count < n)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (st.current_count < n && dds_time () < tend);
+  CU_ASSERT_FATAL (st.current_count == n);
+}
+
+static void test_coherent (bool remote)
+{
+  const dds_entity_t sub_participant = remote ? g_sub_participant : g_pub_participant;
+  char topicname[100];
+  create_unique_topic_name ("ddsc_coherent", topicname, sizeof (topicname));
+
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_presentation (qos, DDS_PRESENTATION_TOPIC, true, false);
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+
+  const dds_entity_t pub_tp = dds_create_topic (g_pub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = remote ? dds_create_topic (sub_participant, &Space_Type1_desc, topicname, NULL, NULL) : pub_tp;
+  CU_ASSERT_FATAL (sub_tp > 0);
+
+  /* Two publishers offering coherent access, only one of which writes coherent sets;
+     the samples of the other one must not be held back */
+  const dds_entity_t pub = dds_create_publisher (g_pub_participant, qos, NULL);
+  CU_ASSERT_FATAL (pub > 0);
+  const dds_entity_t pub_nc = dds_create_publisher (g_pub_participant, qos, NULL);
+  CU_ASSERT_FATAL (pub_nc > 0);
+  const dds_entity_t wr = dds_create_writer (pub, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t wr_nc = dds_create_writer (pub_nc, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr_nc > 0);
+
+  dds_listener_t *listener = dds_create_listener (NULL);
+  dds_lset_data_available (listener, data_available_cb);
+  const dds_entity_t sub = dds_create_subscriber (sub_participant, qos, NULL);
+  CU_ASSERT_FATAL (sub > 0);
+  const dds_entity_t rd = dds_create_reader (sub, sub_tp, qos, listener);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_listener (listener);
+  dds_delete_qos (qos);
+  wait_for_match (rd, 2);
+
+  for (int32_t set = 0; set < 2; set++)
+  {
+    const int32_t nbefore = set * (SET_SIZE + 1);
+    dds_return_t rc;
+
+    /* begin/end on the writer are forwarded to the publisher; nesting is allowed */
+    rc = dds_begin_coherent (wr);
+    CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+    if (set == 1)
+    {
+      rc = dds_begin_coherent (pub);
+      CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+    }
+    for (int32_t i = 0; i < SET_SIZE; i++)
+    {
+      Space_Type1 sample = { set * SET_SIZE + i, set, 0 };
+      rc = dds_write (wr, &sample);
+      CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+      if (i == 1)
+      {
+        Space_Type1 sample_nc = { 100 + set, set, 1 };
+        rc = dds_write (wr_nc, &sample_nc);
+        CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+      }
+    }
+    if (set == 1)
+    {
+      rc = dds_end_coherent (pub);
+      CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+    }
+
+    /* only the sample written outside the set is visible, and with it a data available
+       notification */
+    wait_for_samples (rd, nbefore + 1);
+    if (remote)
+      dds_sleepfor (DDS_MSECS (100));
+    CU_ASSERT_FATAL (count_samples (rd) == nbefore + 1);
+    const uint32_t da = ddsrt_atomic_ld32 (&g_data_available);
+    CU_ASSERT_FATAL (da == (uint32_t) (2 * set + 1));
+
+    /* committing makes the entire set visible at once, with a single notification */
+    rc = dds_end_coherent (wr);
+    CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+    wait_for_samples (rd, nbefore + SET_SIZE + 1);
+    if (remote)
+      dds_sleepfor (DDS_MSECS (100));
+    CU_ASSERT_FATAL (ddsrt_atomic_ld32 (&g_data_available) == da + 1);
+  }
+
+  /* end without begin */
+  CU_ASSERT (dds_end_coherent (pub) == DDS_RETCODE_PRECONDITION_NOT_MET);
+}
+
+CU_Test (ddsc_coherent, local, .init = coherent_init, .fini = coherent_fini)
+{
+  test_coherent (false);
+}
+
+CU_Test (ddsc_coherent, remote, .init = coherent_init, .fini = coherent_fini)
+{
+  test_coherent (true);
+}
+
+CU_Test (ddsc_coherent, entity_kinds, .init = coherent_init, .fini = coherent_fini)
+{
+  char topicname[100];
+  create_unique_topic_name ("ddsc_coherent", topicname, sizeof (topicname));
+  const dds_entity_t tp = dds_create_topic (g_pub_participant, &Space_Type1_desc, topicname, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  const dds_entity_t sub = dds_create_subscriber (g_pub_participant, NULL, NULL);
+  CU_ASSERT_FATAL (sub > 0);
+  const dds_entity_t rd = dds_create_reader (sub, tp, NULL, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t pub = dds_create_publisher (g_pub_participant, NULL, NULL);
+  CU_ASSERT_FATAL (pub > 0);
+  const dds_entity_t wr = dds_create_writer (pub, tp, NULL, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+
+  const dds_entity_t ok[] = { pub, wr, sub, rd };
+  for (size_t i = 0; i < sizeof (ok) / sizeof (ok[0]); i++)
+  {
+    CU_ASSERT (dds_begin_coherent (ok[i]) == DDS_RETCODE_OK);
+    CU_ASSERT (dds_end_coherent (ok[i]) == DDS_RETCODE_OK);
+  }
+  /* writing in a set without coherent access is plain writing */
+  Space_Type1 sample = { 0, 0, 0 };
+  CU_ASSERT (dds_begin_coherent (pub) == DDS_RETCODE_OK);
+  CU_ASSERT (dds_write (wr, &sample) == DDS_RETCODE_OK);
+  CU_ASSERT (count_samples (rd) == 1);
+  CU_ASSERT (dds_end_coherent (pub) == DDS_RETCODE_OK);
+
+  CU_ASSERT (dds_begin_coherent (g_pub_participant) == DDS_RETCODE_ILLEGAL_OPERATION);
+  CU_ASSERT (dds_end_coherent (tp) == DDS_RETCODE_ILLEGAL_OPERATION);
+  CU_ASSERT (dds_begin_coherent (314159265) == DDS_RETCODE_BAD_PARAMETER);
+}
+
+CU_Test (ddsc_coherent, late_joiner, .init = coherent_init, .fini = coherent_fini)
+{
+  /* The commit message is stored in the writer history cache along with the samples,
+     but it carries no sample and so must not be delivered to late-joining readers */
+  char topicname[100];
+  create_unique_topic_name ("ddsc_coherent", topicname, sizeof (topicname));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_presentation (qos, DDS_PRESENTATION_TOPIC, true, false);
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t tp = dds_create_topic (g_pub_participant, &Space_Type1_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  const dds_entity_t pub = dds_create_publisher (g_pub_participant, qos, NULL);
+  CU_ASSERT_FATAL (pub > 0);
+  const dds_entity_t wr = dds_create_writer (pub, tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+
+  CU_ASSERT_FATAL (dds_begin_coherent (wr) == DDS_RETCODE_OK);
+  for (int32_t i = 0; i < SET_SIZE; i++)
+  {
+    Space_Type1 sample = { i, 0, 0 };
+    CU_ASSERT_FATAL (dds_write (wr, &sample) == DDS_RETCODE_OK);
+  }
+  CU_ASSERT_FATAL (dds_end_coherent (wr) == DDS_RETCODE_OK);
+
+  const dds_entity_t sub = dds_create_subscriber (g_pub_participant, qos, NULL);
+  CU_ASSERT_FATAL (sub > 0);
+  const dds_entity_t rd = dds_create_reader (sub, tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  CU_ASSERT (count_samples (rd) == SET_SIZE);
+}
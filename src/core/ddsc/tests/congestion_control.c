@@ -0,0 +1,94 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+
+#include "test_common.h"
+#include "RoundTrip.h"
+
+#define SAMPLE_SIZE 1000u
+#define MAX_SAMPLES 200
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+/* At 1 kB/s, each sample takes about a second once the initial burst of
+   64 kB has been used; the samples are small enough not to be fragmented,
+   or they would be spread out over time while transmitting them */
+#define DDS_CONFIG_CONGESTION_CONTROL "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><Internal><CongestionControl>true</CongestionControl><CongestionControlMinRate>1 kB/s</CongestionControlMinRate><CongestionControlMaxRate>1 kB/s</CongestionControlMaxRate></Internal>"
+
+CU_Test(ddsc_congestion_control, max_blocking_time)
+{
+  /* waiting for the congestion controller is bounded by the max_blocking_time
+     like waiting for acknowledgements is */
+  char topic_name[100];
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_CONGESTION_CONTROL, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_CONGESTION_CONTROL, DDS_DOMAINID_SUB);
+  const dds_entity_t pub_dom = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (pub_dom > 0);
+  const dds_entity_t sub_dom = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (sub_dom > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+
+  create_unique_topic_name ("ddsc_congestion_control", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_MSECS (100));
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &RoundTripModule_DataType_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &RoundTripModule_DataType_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (qos);
+
+  dds_publication_matched_status_t pm;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &pm) == DDS_RETCODE_OK);
+    if (pm.current_count == 0)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (pm.current_count == 0 && dds_time () < tmatch);
+  CU_ASSERT_FATAL (pm.current_count == 1);
+
+  unsigned char *payload = ddsrt_calloc (1, SAMPLE_SIZE);
+  RoundTripModule_DataType s = { .payload = { ._maximum = SAMPLE_SIZE, ._length = SAMPLE_SIZE, ._buffer = payload, ._release = false } };
+
+  /* the initial burst goes out immediately, the next sample has to wait far
+     longer than allowed */
+  dds_return_t ret = DDS_RETCODE_OK;
+  dds_duration_t dt = 0;
+  int n;
+  for (n = 0; n < MAX_SAMPLES && ret == DDS_RETCODE_OK; n++)
+  {
+    const dds_time_t t0 = dds_time ();
+    ret = dds_write (wr, &s);
+    dt = dds_time () - t0;
+  }
+  CU_ASSERT (n > 1);
+  CU_ASSERT (ret == DDS_RETCODE_TIMEOUT);
+  CU_ASSERT (dt >= DDS_MSECS (90) && dt < DDS_MSECS (500));
+
+  /* once the debt has been paid off, writing is possible again */
+  dds_sleepfor (DDS_MSECS (1500));
+  CU_ASSERT (dds_write (wr, &s) == DDS_RETCODE_OK);
+  ddsrt_free (payload);
+  dds_delete (pub_dom);
+  dds_delete (sub_dom);
+}
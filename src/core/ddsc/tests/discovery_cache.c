@@ -0,0 +1,160 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/misc.h"
+#include "dds/ddsrt/process.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_LOCAL 0
+#define DDS_DOMAINID_REMOTE 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+#define DDS_CONFIG_CACHE "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId><Cache><File>%s</File><ConfirmTimeout>%s</ConfirmTimeout></Cache></Discovery>"
+
+static char g_cache_file[64];
+static char g_topic_name[100];
+
+static dds_entity_t create_domain_with_cache (const char *confirm_timeout)
+{
+  char *conf_raw, *conf;
+  dds_entity_t dom;
+  (void) ddsrt_asprintf (&conf_raw, DDS_CONFIG_CACHE, g_cache_file, confirm_timeout);
+  conf = ddsrt_expand_envvars (conf_raw, DDS_DOMAINID_LOCAL);
+  dom = dds_create_domain (DDS_DOMAINID_LOCAL, conf);
+  CU_ASSERT_FATAL (dom > 0);
+  dds_free (conf);
+  dds_free (conf_raw);
+  return dom;
+}
+
+static dds_entity_t create_reader (dds_domainid_t domid)
+{
+  dds_entity_t pp, tp, rd;
+  pp = dds_create_participant (domid, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  tp = dds_create_topic (pp, &Space_Type1_desc, g_topic_name, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  rd = dds_create_reader (pp, tp, NULL, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  return rd;
+}
+
+static uint32_t matched_writers (dds_entity_t rd)
+{
+  dds_subscription_matched_status_t st;
+  dds_return_t rc = dds_get_subscription_matched_status (rd, &st);
+  CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  return st.current_count;
+}
+
+static bool wait_for_matched_writers (dds_entity_t rd, uint32_t n, dds_duration_t timeout)
+{
+  const dds_time_t tend = dds_time () + timeout;
+  while (matched_writers (rd) != n && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  return matched_writers (rd) == n;
+}
+
+static long file_size (const char *name)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  FILE *fp;
+  long sz;
+  if ((fp = fopen (name, "rb")) == NULL)
+    return -1;
+  (void) fseek (fp, 0, SEEK_END);
+  sz = ftell (fp);
+  fclose (fp);
+  return sz;
+  DDSRT_WARNING_MSVC_ON(4996);
+}
+
+/* Runs a domain with a discovery cache that discovers a writer in another domain,
+   then shuts down first the domain with the cache and then the other one, so that
+   the cache file contains a participant and a writer that no longer exist */
+static void discovery_cache_init (void)
+{
+  dds_entity_t dom_local, dom_remote, pp, tp, wr, rd;
+  char *conf;
+
+  (void) snprintf (g_cache_file, sizeof (g_cache_file), "cyclonedds_dcache_test.%"PRIdPID".cache", ddsrt_getpid ());
+  (void) remove (g_cache_file);
+  create_unique_topic_name ("ddsc_discovery_cache", g_topic_name, sizeof (g_topic_name));
+
+  dom_local = create_domain_with_cache ("10 s");
+  conf = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_REMOTE);
+  dom_remote = dds_create_domain (DDS_DOMAINID_REMOTE, conf);
+  CU_ASSERT_FATAL (dom_remote > 0);
+  dds_free (conf);
+
+  pp = dds_create_participant (DDS_DOMAINID_REMOTE, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  tp = dds_create_topic (pp, &Space_Type1_desc, g_topic_name, NULL, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  wr = dds_create_writer (pp, tp, NULL, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  rd = create_reader (DDS_DOMAINID_LOCAL);
+  CU_ASSERT_FATAL (wait_for_matched_writers (rd, 1, DDS_SECS (10)));
+
+  dds_delete (dom_local);
+  dds_delete (dom_remote);
+}
+
+static void discovery_cache_fini (void)
+{
+  char *tmpname;
+  (void) ddsrt_asprintf (&tmpname, "%s.tmp", g_cache_file);
+  (void) remove (tmpname);
+  (void) remove (g_cache_file);
+  dds_free (tmpname);
+}
+
+CU_Test(ddsc_discovery_cache, save, .init = discovery_cache_init, .fini = discovery_cache_fini)
+{
+  /* the final state is written on shutdown: a header and at least a participant and
+     a writer record */
+  char *tmpname;
+  CU_ASSERT (file_size (g_cache_file) > 64);
+  (void) ddsrt_asprintf (&tmpname, "%s.tmp", g_cache_file);
+  CU_ASSERT (file_size (tmpname) < 0);
+  dds_free (tmpname);
+}
+
+CU_Test(ddsc_discovery_cache, load, .init = discovery_cache_init, .fini = discovery_cache_fini)
+{
+  /* the remote domain is gone, so the only way the reader can match the writer is
+     through the proxies restored from the cache, and those exist before the reader
+     is created */
+  dds_entity_t dom = create_domain_with_cache ("10 s");
+  dds_entity_t rd = create_reader (DDS_DOMAINID_LOCAL);
+  CU_ASSERT (matched_writers (rd) == 1);
+  dds_delete (dom);
+}
+
+CU_Test(ddsc_discovery_cache, expiry, .init = discovery_cache_init, .fini = discovery_cache_fini, .timeout = 20)
+{
+  /* without confirmation from live discovery data the restored proxies must be
+     deleted once the confirmation timeout expires, and then they are no longer
+     written to the cache file either */
+  const long size_before = file_size (g_cache_file);
+  dds_entity_t dom = create_domain_with_cache ("1 s");
+  dds_entity_t rd = create_reader (DDS_DOMAINID_LOCAL);
+  CU_ASSERT_FATAL (matched_writers (rd) == 1);
+  CU_ASSERT (wait_for_matched_writers (rd, 0, DDS_SECS (5)));
+  dds_delete (dom);
+  CU_ASSERT (file_size (g_cache_file) < size_before);
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_lease.h"
+#include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/q_xmsg.h"
+#include "dds/ddsi/q_ddsi_discovery.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+/* Tracing must be enabled for the trace sink to see the "(known, unchanged)"
+   lines that distinguish a skipped repeat from a fully processed message */
+#define DDS_CONFIG_TRACE "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Tracing><Category>trace</Category><OutputFile>stderr</OutputFile></Tracing>"
+
+/* The discovery messages are injected as if they came from a participant in
+   another process, one that doesn't really exist */
+static const ddsi_guid_prefix_t fake_prefix = { .u = { 0x12345678, 0x9abcdef0, 0x0fedcba9 } };
+
+static ddsrt_atomic_uint32_t nunchanged;
+static dds_entity_t g_domain;
+static struct ddsi_domaingv *g_gv;
+
+static void tracesink (void *arg, const dds_log_data_t *msg)
+{
+  (void) arg;
+  if (strstr (msg->message, "(known, unchanged)") != NULL)
+    ddsrt_atomic_inc32 (&nunchanged);
+}
+
+static void discovery_repeat_init (void)
+{
+  struct dds_entity *x;
+  char *conf = ddsrt_expand_envvars (DDS_CONFIG_TRACE, 0);
+  ddsrt_atomic_st32 (&nunchanged, 0);
+  dds_set_trace_sink (tracesink, NULL);
+  g_domain = dds_create_domain (0, conf);
+  CU_ASSERT_FATAL (g_domain > 0);
+  dds_free (conf);
+  CU_ASSERT_FATAL (dds_entity_pin (g_domain, &x) == DDS_RETCODE_OK);
+  g_gv = &x->m_domain->gv;
+  dds_entity_unpin (x);
+}
+
+static void discovery_repeat_fini (void)
+{
+  dds_delete (g_domain);
+  dds_set_trace_sink (NULL, NULL);
+}
+
+/* Serializes the parameter list the way the SPDP and SEDP writers do,
+   including the CDR header */
+static void *make_payload (const ddsi_plist_t *ps, nn_parameterid_t keyparam, uint32_t *size)
+{
+  struct nn_xmsg *mpayload = nn_xmsg_new (g_gv->xmsgpool, &fake_prefix, 0, NN_XMSG_KIND_DATA);
+  struct ddsi_plist_sample plist_sample;
+  struct ddsi_serdata *serdata;
+  void *payload;
+  ddsi_plist_addtomsg (mpayload, ps, ~(uint64_t)0, ~(uint64_t)0);
+  nn_xmsg_addpar_sentinel (mpayload);
+  nn_xmsg_payload_to_plistsample (&plist_sample, keyparam, mpayload);
+  serdata = ddsi_serdata_from_sample (g_gv->plist_topic, SDK_DATA, &plist_sample);
+  nn_xmsg_free (mpayload);
+  CU_ASSERT_FATAL (serdata != NULL);
+  *size = ddsi_serdata_size (serdata);
+  payload = ddsrt_malloc (*size);
+  ddsi_serdata_to_ser (serdata, 0, *size, payload);
+  ddsi_serdata_unref (serdata);
+  return payload;
+}
+
+static void *make_spdp (const char *name, uint32_t *size)
+{
+  struct nn_locators_one loc = { .next = NULL, .loc = g_gv->loc_meta_uc };
+  ddsi_plist_t ps;
+  ddsi_plist_init_empty (&ps);
+  ps.present |= PP_PARTICIPANT_GUID | PP_BUILTIN_ENDPOINT_SET | PP_PROTOCOL_VERSION | PP_VENDORID |
+    PP_PARTICIPANT_LEASE_DURATION | PP_METATRAFFIC_UNICAST_LOCATOR | PP_DEFAULT_UNICAST_LOCATOR | PP_ENTITY_NAME;
+  ps.participant_guid.prefix = fake_prefix;
+  ps.participant_guid.entityid.u = NN_ENTITYID_PARTICIPANT;
+  ps.builtin_endpoint_set = 0;
+  ps.protocol_version.major = RTPS_MAJOR;
+  ps.protocol_version.minor = RTPS_MINOR;
+  ps.vendorid = NN_VENDORID_ECLIPSE;
+  ps.participant_lease_duration = DDS_SECS (10);
+  ps.metatraffic_unicast_locators.n = 1;
+  ps.metatraffic_unicast_locators.first = ps.metatraffic_unicast_locators.last = &loc;
+  ps.default_unicast_locators = ps.metatraffic_unicast_locators;
+  ps.entity_name = (char *) name;
+  return make_payload (&ps, PID_PARTICIPANT_GUID, size);
+}
+
+static void *make_sedp (const ddsi_guid_t *guid, const char *name, uint32_t *size)
+{
+  ddsi_plist_t ps;
+  ddsi_plist_init_empty (&ps);
+  ps.present |= PP_ENDPOINT_GUID | PP_PROTOCOL_VERSION | PP_VENDORID | PP_ENTITY_NAME;
+  ps.endpoint_guid = *guid;
+  ps.protocol_version.major = RTPS_MAJOR;
+  ps.protocol_version.minor = RTPS_MINOR;
+  ps.vendorid = NN_VENDORID_ECLIPSE;
+  ps.entity_name = (char *) name;
+  ps.qos.present |= QP_TOPIC_NAME | QP_TYPE_NAME;
+  ps.qos.topic_name = (char *) "discovery_repeat";
+  ps.qos.type_name = (char *) "Space::Type1";
+  return make_payload (&ps, PID_ENDPOINT_GUID, size);
+}
+
+static void inject (seqno_t seq, bool participant, const void *payload, uint32_t size)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct receiver_state rst;
+  memset (&rst, 0, sizeof (rst));
+  rst.src_guid_prefix = fake_prefix;
+  rst.vendor = NN_VENDORID_ECLIPSE;
+  rst.protocol_version.major = RTPS_MAJOR;
+  rst.protocol_version.minor = RTPS_MINOR;
+  rst.gv = g_gv;
+  thread_state_awake (ts1, g_gv);
+  handle_cached_discovery_data (&rst, seq, participant, payload, size);
+  thread_state_asleep (ts1);
+}
+
+struct ppstate {
+  seqno_t seq;
+  uint64_t hash;
+  int64_t tlease;
+};
+
+static bool get_ppstate (struct ppstate *st)
+{
+  const ddsi_guid_t guid = { .prefix = fake_prefix, .entityid = { .u = NN_ENTITYID_PARTICIPANT } };
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct proxy_participant *proxypp;
+  thread_state_awake (ts1, g_gv);
+  if ((proxypp = entidx_lookup_proxy_participant_guid (g_gv->entity_index, &guid)) != NULL)
+  {
+    struct lease *lease = ddsrt_atomic_ldvoidp (&proxypp->minl_auto);
+    ddsrt_mutex_lock (&proxypp->e.lock);
+    st->seq = proxypp->seq;
+    st->hash = proxypp->spdp_hash;
+    ddsrt_mutex_unlock (&proxypp->e.lock);
+    st->tlease = lease ? (int64_t) ddsrt_atomic_ld64 (&lease->tend) : 0;
+  }
+  thread_state_asleep (ts1);
+  return proxypp != NULL;
+}
+
+static bool get_epstate (const ddsi_guid_t *guid, seqno_t *seq, uint64_t *hash)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct proxy_writer *pwr;
+  thread_state_awake (ts1, g_gv);
+  if ((pwr = entidx_lookup_proxy_writer_guid (g_gv->entity_index, guid)) != NULL)
+  {
+    ddsrt_mutex_lock (&pwr->e.lock);
+    *seq = pwr->c.seq;
+    *hash = pwr->c.sedp_hash;
+    ddsrt_mutex_unlock (&pwr->e.lock);
+  }
+  thread_state_asleep (ts1);
+  return pwr != NULL;
+}
+
+CU_Test(ddsc_discovery_repeat, spdp, .init = discovery_repeat_init, .fini = discovery_repeat_fini)
+{
+  struct ppstate st0, st1, st2;
+  uint32_t sz1, sz2;
+  void *spdp1 = make_spdp ("a", &sz1);
+  void *spdp2 = make_spdp ("b", &sz2);
+
+  inject (1, true, spdp1, sz1);
+  CU_ASSERT_FATAL (get_ppstate (&st0));
+  CU_ASSERT (st0.seq == 1 && st0.hash != 0 && st0.tlease != 0);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nunchanged) == 0);
+
+  /* a periodic repeat is skipped, but still renews the lease */
+  dds_sleepfor (DDS_MSECS (100));
+  inject (2, true, spdp1, sz1);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nunchanged) == 1);
+  CU_ASSERT_FATAL (get_ppstate (&st1));
+  CU_ASSERT (st1.seq == 2 && st1.hash == st0.hash);
+  CU_ASSERT (st1.tlease >= st0.tlease + DDS_MSECS (100));
+
+  /* the same sequence number with a different payload is processed in full,
+     leaving the hash of the new payload */
+  inject (2, true, spdp2, sz2);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nunchanged) == 1);
+  CU_ASSERT_FATAL (get_ppstate (&st2));
+  CU_ASSERT (st2.seq == 2 && st2.hash != st0.hash && st2.hash != 0);
+
+  ddsrt_free (spdp1);
+  ddsrt_free (spdp2);
+}
+
+CU_Test(ddsc_discovery_repeat, sedp, .init = discovery_repeat_init, .fini = discovery_repeat_fini)
+{
+  const ddsi_guid_t wrguid = { .prefix = fake_prefix, .entityid = { .u = (1 << 8) | NN_ENTITYID_KIND_WRITER_WITH_KEY } };
+  uint32_t szpp, sz1, sz2;
+  void *spdp = make_spdp ("a", &szpp);
+  void *sedp1 = make_sedp (&wrguid, "a", &sz1);
+  void *sedp2 = make_sedp (&wrguid, "b", &sz2);
+  seqno_t seq;
+  uint64_t hash0, hash;
+
+  inject (1, true, spdp, szpp);
+  inject (1, false, sedp1, sz1);
+  CU_ASSERT_FATAL (get_epstate (&wrguid, &seq, &hash0));
+  CU_ASSERT (seq == 1 && hash0 != 0);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nunchanged) == 0);
+
+  /* a repeat is skipped */
+  inject (2, false, sedp1, sz1);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nunchanged) == 1);
+  CU_ASSERT_FATAL (get_epstate (&wrguid, &seq, &hash));
+  CU_ASSERT (seq == 2 && hash == hash0);
+
+  /* the same sequence number with a different payload is not */
+  inject (2, false, sedp2, sz2);
+  CU_ASSERT (ddsrt_atomic_ld32 (&nunchanged) == 1);
+  CU_ASSERT_FATAL (get_epstate (&wrguid, &seq, &hash));
+  CU_ASSERT (seq == 2 && hash != hash0 && hash != 0);
+
+  ddsrt_free (spdp);
+  ddsrt_free (sedp1);
+  ddsrt_free (sedp2);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_gc.h"
+#include "dds/ddsi/q_addrset.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds__entity.h"
+
+#include "CUnit/Test.h"
+
+/* Teardown of a remote participant: all its proxy endpoints are deleted in
+   one go, each through the garbage collector (xtests/benchmarks/gc_bench
+   times this for a large number of endpoints) */
+
+static void create_proxy_endpoints (struct ddsi_domaingv *gv, const ddsi_guid_t *ppguid, uint32_t n)
+{
+  struct addrset *as = new_addrset ();
+  ddsi_plist_t plist;
+  ddsi_plist_init_empty (&plist);
+  plist.qos.present |= QP_TOPIC_NAME | QP_TYPE_NAME;
+  plist.qos.topic_name = ddsrt_strdup ("gc_teardown");
+  plist.qos.type_name = ddsrt_strdup ("gc_teardown_type");
+  for (uint32_t i = 0; i < n; i++)
+  {
+    const bool is_writer = (i % 2) == 0;
+    ddsi_guid_t guid = { .prefix = ppguid->prefix, .entityid = { .u = ((i + 1) << 8) | (is_writer ? NN_ENTITYID_KIND_WRITER_WITH_KEY : NN_ENTITYID_KIND_READER_WITH_KEY) } };
+    ddsi_plist_t eplist;
+    ddsi_plist_init_empty (&eplist);
+    ddsi_plist_mergein_missing (&eplist, &plist, ~(uint64_t)0, ~(uint64_t)0);
+    ddsi_xqos_mergein_missing (&eplist.qos, is_writer ? &gv->default_xqos_wr : &gv->default_xqos_rd, ~(uint64_t)0);
+    if (is_writer)
+      CU_ASSERT_FATAL (new_proxy_writer (gv, ppguid, &guid, as, &eplist, gv->user_dqueue, gv->xevents, ddsrt_time_wallclock (), 1) == 0);
+    else
+    {
+#ifdef DDSI_INCLUDE_SSM
+      CU_ASSERT_FATAL (new_proxy_reader (gv, ppguid, &guid, as, &eplist, ddsrt_time_wallclock (), 1, 0) == 0);
+#else
+      CU_ASSERT_FATAL (new_proxy_reader (gv, ppguid, &guid, as, &eplist, ddsrt_time_wallclock (), 1) == 0);
+#endif
+    }
+    ddsi_plist_fini (&eplist);
+  }
+  ddsi_plist_fini (&plist);
+  unref_addrset (as);
+}
+
+static uint32_t count_proxy_endpoints (struct ddsi_domaingv *gv, const ddsi_guid_t *ppguid, uint32_t n)
+{
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    const bool is_writer = (i % 2) == 0;
+    ddsi_guid_t guid = { .prefix = ppguid->prefix, .entityid = { .u = ((i + 1) << 8) | (is_writer ? NN_ENTITYID_KIND_WRITER_WITH_KEY : NN_ENTITYID_KIND_READER_WITH_KEY) } };
+    if (is_writer && entidx_lookup_proxy_writer_guid (gv->entity_index, &guid) != NULL)
+      count++;
+    else if (!is_writer && entidx_lookup_proxy_reader_guid (gv->entity_index, &guid) != NULL)
+      count++;
+  }
+  return count;
+}
+
+CU_Test (ddsc_gc, teardown_proxy_endpoints)
+{
+  const uint32_t n = 100;
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  struct dds_entity *x;
+  CU_ASSERT_FATAL (dds_entity_pin (pp, &x) == DDS_RETCODE_OK);
+  struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+
+  ddsi_guid_t ppguid;
+  memset (&ppguid, 0, sizeof (ppguid));
+  ppguid.prefix.u[0] = 0x12345678;
+  ppguid.prefix.u[1] = 0x9abcdef0;
+  ppguid.prefix.u[2] = 1;
+  ppguid.entityid.u = NN_ENTITYID_PARTICIPANT;
+  ddsi_plist_t ppplist;
+  ddsi_plist_init_empty (&ppplist);
+
+  thread_state_awake (ts1, gv);
+  new_proxy_participant (gv, &ppguid, 0, NULL, new_addrset (), new_addrset (), &ppplist, DDS_INFINITY, NN_VENDORID_ECLIPSE, 0, ddsrt_time_wallclock (), 1);
+  create_proxy_endpoints (gv, &ppguid, n);
+  CU_ASSERT_FATAL (count_proxy_endpoints (gv, &ppguid, n) == n);
+  thread_state_asleep (ts1);
+  ddsi_plist_fini (&ppplist);
+
+  thread_state_awake (ts1, gv);
+  CU_ASSERT_FATAL (delete_proxy_participant_by_guid (gv, &ppguid, ddsrt_time_wallclock (), 1) == 0);
+  thread_state_asleep (ts1);
+  gcreq_queue_drain (gv->gcreq_queue);
+
+  thread_state_awake (ts1, gv);
+  CU_ASSERT (entidx_lookup_proxy_participant_guid (gv->entity_index, &ppguid) == NULL);
+  CU_ASSERT (count_proxy_endpoints (gv, &ppguid, n) == 0);
+  thread_state_asleep (ts1);
+  dds_entity_unpin (x);
+  dds_delete (pp);
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsi/ddsi_latency_stats.h"
+
+#include "test_common.h"
+
+#define NSAMPLES 10
+
+/* The element only exists if support for it is included */
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+#define DDS_CONFIG_LATENCY_STATS "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Internal><LatencyStatistics>true</LatencyStatistics></Internal>"
+#else
+#define DDS_CONFIG_LATENCY_STATS "${CYCLONEDDS_URI}"
+#endif
+
+CU_Test(ddsc_latency_stats, get)
+{
+  char topic_name[100];
+  char *conf = ddsrt_expand_envvars (DDS_CONFIG_LATENCY_STATS, 0);
+  const dds_entity_t dom = dds_create_domain (0, conf);
+  CU_ASSERT_FATAL (dom > 0);
+  dds_free (conf);
+  const dds_entity_t pp = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  create_unique_topic_name ("ddsc_latency_stats", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t tp = dds_create_topic (pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (tp > 0);
+  const dds_entity_t wr = dds_create_writer (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t rd = dds_create_reader (pp, tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  for (int32_t i = 0; i < NSAMPLES; i++)
+  {
+    Space_Type1 s = { i, i, i };
+    CU_ASSERT_FATAL (dds_write (wr, &s) == DDS_RETCODE_OK);
+  }
+
+  dds_latency_stats_t st;
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  CU_ASSERT (dds_get_latency_stats (wr, NULL) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_get_latency_stats (0, &st) < 0);
+  CU_ASSERT_FATAL (dds_get_latency_stats (wr, &st) == DDS_RETCODE_OK);
+  for (int i = 0; i < DDS_LATENCY_NSTAGES; i++)
+  {
+    CU_ASSERT (st.stage[i].name != NULL);
+    CU_ASSERT (st.stage[i].min <= st.stage[i].p50 && st.stage[i].p50 <= st.stage[i].p999);
+    CU_ASSERT (st.stage[i].p999 <= st.stage[i].max + st.stage[i].max / 16 + 1);
+  }
+  CU_ASSERT (st.stage[DDS_LATENCY_SERIALIZE].count >= NSAMPLES);
+  CU_ASSERT (st.stage[DDS_LATENCY_WHC_INSERT].count >= NSAMPLES);
+#else
+  /* without support, the API still exists but fails, and the instrumentation
+     of the data path compiles to nothing */
+  CU_ASSERT (dds_get_latency_stats (wr, &st) == DDS_RETCODE_UNSUPPORTED);
+  CU_ASSERT (dds_get_latency_stats (wr, NULL) == DDS_RETCODE_UNSUPPORTED);
+  int64_t t = DDSI_LATENCY_START (true);
+  CU_ASSERT (t == 0);
+  t = DDSI_LATENCY_LAP (DDSI_LATENCY_SERIALIZE, INT64_C (1));
+  CU_ASSERT (t == 0);
+#endif
+
+  /* the instrumentation must not affect the data */
+  int32_t count = 0;
+  Space_Type1 s;
+  void *ptr = &s;
+  dds_sample_info_t si;
+  while (dds_take (rd, &ptr, &si, 1, 1) == 1)
+  {
+    CU_ASSERT (si.valid_data && s.long_2 == s.long_1);
+    count++;
+  }
+  CU_ASSERT (count == NSAMPLES);
+  dds_delete (dom);
+}
@@ -198,6 +198,27 @@ data_available_cb(
     ddsrt_mutex_unlock(&g_mutex);
 }
 
+static ddsrt_thread_t  async_cb_thread;
+static uint32_t        async_cb_count = 0;
+static bool            async_cb_block = false;
+
+static void
+data_available_async_cb(
+        dds_entity_t reader,
+        void* arg)
+{
+    (void)arg;
+    ddsrt_mutex_lock(&g_mutex);
+    cb_reader = reader;
+    cb_called |= DDS_DATA_AVAILABLE_STATUS;
+    async_cb_thread = ddsrt_thread_self();
+    async_cb_count++;
+    ddsrt_cond_broadcast(&g_cond);
+    while (async_cb_block)
+        ddsrt_cond_wait(&g_cond, &g_mutex);
+    ddsrt_mutex_unlock(&g_mutex);
+}
+
 static void
 sample_rejected_cb(
         dds_entity_t reader,
@@ -581,6 +602,15 @@ CU_Test(ddsc_listener, getters_setters)
     TEST_GET_SET(listener, data_available, data_available_cb);
     DDSRT_WARNING_MSVC_ON(6387);
 
+    bool async = true;
+    dds_lget_async(listener, &async);
+    CU_ASSERT_EQUAL(async, false);
+    dds_lset_async(listener, true);
+    dds_lget_async(listener, &async);
+    CU_ASSERT_EQUAL(async, true);
+    dds_lget_async(NULL, &async);
+    CU_ASSERT_EQUAL(async, false);
+
     dds_delete_listener(listener);
 }
 
@@ -1010,6 +1040,93 @@ CU_Test(ddsc_listener, data_available_delete_writer_disposed, .init=init_trigger
     CU_ASSERT_EQUAL_FATAL(status, 0);
 }
 
+CU_Test(ddsc_listener, data_available_async, .init=init_triggering_base, .fini=fini_triggering_base)
+{
+    dds_entity_t reader, writer;
+    dds_return_t ret;
+    uint32_t triggered;
+    RoundTripModule_DataType sample;
+    memset (&sample, 0, sizeof (sample));
+
+    async_cb_count = 0;
+
+    /* Invoked on the listener executor, so also the matched status */
+    dds_lset_async(g_listener, true);
+    dds_lset_data_available(g_listener, data_available_async_cb);
+    dds_lset_subscription_matched(g_listener, subscription_matched_cb);
+    reader = dds_create_reader(g_subscriber, g_topic, g_qos, g_listener);
+    CU_ASSERT_FATAL(reader > 0);
+    writer = dds_create_writer(g_publisher, g_topic, g_qos, NULL);
+    CU_ASSERT_FATAL(writer > 0);
+    triggered = waitfor_cb(DDS_SUBSCRIPTION_MATCHED_STATUS);
+    CU_ASSERT_EQUAL_FATAL(triggered & DDS_SUBSCRIPTION_MATCHED_STATUS, DDS_SUBSCRIPTION_MATCHED_STATUS);
+    CU_ASSERT_EQUAL_FATAL(cb_reader, reader);
+    CU_ASSERT_EQUAL_FATAL(cb_subscription_matched_status.current_count, 1);
+
+    /* Delivery is done by the writing thread: the callback must run elsewhere,
+       and writing must not be held up by it blocking */
+    ddsrt_mutex_lock(&g_mutex);
+    async_cb_block = true;
+    ddsrt_mutex_unlock(&g_mutex);
+    ret = dds_write(writer, &sample);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    triggered = waitfor_cb(DDS_DATA_AVAILABLE_STATUS);
+    CU_ASSERT_EQUAL_FATAL(triggered & DDS_DATA_AVAILABLE_STATUS, DDS_DATA_AVAILABLE_STATUS);
+    CU_ASSERT_EQUAL_FATAL(cb_reader, reader);
+    CU_ASSERT_FATAL(!ddsrt_thread_equal(async_cb_thread, ddsrt_thread_self()));
+    for (int i = 0; i < 10; i++)
+    {
+        ret = dds_write(writer, &sample);
+        CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    }
+
+    /* The notifications for the samples written while the callback was
+       blocked must be coalesced into a single invocation */
+    ddsrt_mutex_lock(&g_mutex);
+    async_cb_block = false;
+    ddsrt_cond_broadcast(&g_cond);
+    while (async_cb_count < 2)
+        CU_ASSERT_FATAL(ddsrt_cond_waitfor(&g_cond, &g_mutex, DDS_SECS(5)));
+    ddsrt_mutex_unlock(&g_mutex);
+    dds_sleepfor(DDS_MSECS(100));
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_EQUAL(async_cb_count, 2);
+    ddsrt_mutex_unlock(&g_mutex);
+
+    void *ptrs[16] = { NULL };
+    dds_sample_info_t si[16];
+    ret = dds_take(reader, ptrs, si, 16, 16);
+    CU_ASSERT_EQUAL_FATAL(ret, 11);
+    (void) dds_return_loan(reader, ptrs, ret);
+
+    /* No callbacks may occur once deleting the reader returns, even if some
+       notifications were still pending */
+    ddsrt_mutex_lock(&g_mutex);
+    async_cb_block = true;
+    cb_called = 0;
+    ddsrt_mutex_unlock(&g_mutex);
+    ret = dds_write(writer, &sample);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    triggered = waitfor_cb(DDS_DATA_AVAILABLE_STATUS);
+    CU_ASSERT_EQUAL_FATAL(triggered & DDS_DATA_AVAILABLE_STATUS, DDS_DATA_AVAILABLE_STATUS);
+    ret = dds_write(writer, &sample);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    ddsrt_mutex_lock(&g_mutex);
+    async_cb_block = false;
+    ddsrt_cond_broadcast(&g_cond);
+    ddsrt_mutex_unlock(&g_mutex);
+    ret = dds_delete(reader);
+    CU_ASSERT_EQUAL_FATAL(ret, DDS_RETCODE_OK);
+    ddsrt_mutex_lock(&g_mutex);
+    const uint32_t count_at_delete = async_cb_count;
+    ddsrt_mutex_unlock(&g_mutex);
+    dds_sleepfor(DDS_MSECS(100));
+    ddsrt_mutex_lock(&g_mutex);
+    CU_ASSERT_EQUAL(async_cb_count, count_at_delete);
+    ddsrt_mutex_unlock(&g_mutex);
+    dds_delete(writer);
+}
+
 CU_Test(ddsc_listener, data_on_readers, .init=init_triggering_test, .fini=fini_triggering_test)
 {
     dds_return_t ret;
@@ -0,0 +1,234 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+/* The writer is matched with a reader in the same domain and a reader in a
+   different domain, the reader is matched with a writer in the same domain
+   and one in a different domain */
+static dds_entity_t g_pub_domain, g_sub_domain;
+static dds_entity_t g_pub_pp, g_sub_pp;
+static dds_entity_t g_pub_tp, g_sub_tp;
+static dds_entity_t g_writer, g_local_reader;
+static dds_entity_t g_reader, g_local_writer;
+
+static void matched_init (void)
+{
+  char topic_name[100];
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_SUB);
+  g_pub_domain = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (g_pub_domain > 0);
+  g_sub_domain = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (g_sub_domain > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+
+  g_pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (g_pub_pp > 0);
+  g_sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (g_sub_pp > 0);
+  create_unique_topic_name ("ddsc_matched", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  g_pub_tp = dds_create_topic (g_pub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (g_pub_tp > 0);
+  g_sub_tp = dds_create_topic (g_sub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (g_sub_tp > 0);
+  g_writer = dds_create_writer (g_pub_pp, g_pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (g_writer > 0);
+  g_local_reader = dds_create_reader (g_pub_pp, g_pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (g_local_reader > 0);
+  g_reader = dds_create_reader (g_sub_pp, g_sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (g_reader > 0);
+  g_local_writer = dds_create_writer (g_sub_pp, g_sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (g_local_writer > 0);
+  dds_delete_qos (qos);
+}
+
+static void matched_fini (void)
+{
+  dds_delete (g_sub_domain);
+  dds_delete (g_pub_domain);
+}
+
+static bool wait_for_matched (dds_entity_t wr, dds_entity_t rd, uint32_t n)
+{
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  dds_publication_matched_status_t pm;
+  dds_subscription_matched_status_t sm;
+  do {
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &pm) == DDS_RETCODE_OK);
+    CU_ASSERT_FATAL (dds_get_subscription_matched_status (rd, &sm) == DDS_RETCODE_OK);
+    if (pm.current_count == n && sm.current_count == n)
+      return true;
+    dds_sleepfor (DDS_MSECS (10));
+  } while (dds_time () < tend);
+  return false;
+}
+
+static dds_instance_handle_t get_ih (dds_entity_t e)
+{
+  dds_instance_handle_t ih;
+  CU_ASSERT_FATAL (dds_get_instance_handle (e, &ih) == DDS_RETCODE_OK);
+  return ih;
+}
+
+CU_Test(ddsc_matched, bad_param, .init = matched_init, .fini = matched_fini)
+{
+  const dds_entity_t bad_handles[] = { 0, -1, 1, INT32_MAX };
+  dds_matched_subscription_statistics_t ss;
+  dds_matched_publication_statistics_t ps;
+  dds_instance_handle_t ihs[2];
+  for (size_t i = 0; i < sizeof (bad_handles) / sizeof (bad_handles[0]); i++)
+  {
+    CU_ASSERT (dds_get_matched_subscriptions (bad_handles[i], ihs, 2) == DDS_RETCODE_BAD_PARAMETER);
+    CU_ASSERT (dds_get_matched_publications (bad_handles[i], ihs, 2) == DDS_RETCODE_BAD_PARAMETER);
+    CU_ASSERT (dds_get_matched_subscription_statistics (bad_handles[i], 0, &ss) == DDS_RETCODE_BAD_PARAMETER);
+    CU_ASSERT (dds_get_matched_publication_statistics (bad_handles[i], 0, &ps) == DDS_RETCODE_BAD_PARAMETER);
+  }
+
+  /* an array without a size or a size without an array */
+  CU_ASSERT (dds_get_matched_subscriptions (g_writer, ihs, 0) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_get_matched_subscriptions (g_writer, NULL, 1) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_get_matched_publications (g_reader, ihs, 0) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_get_matched_publications (g_reader, NULL, 1) == DDS_RETCODE_BAD_PARAMETER);
+
+  CU_ASSERT (dds_get_matched_subscription_statistics (g_writer, get_ih (g_local_reader), NULL) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_get_matched_publication_statistics (g_reader, get_ih (g_local_writer), NULL) == DDS_RETCODE_BAD_PARAMETER);
+
+  /* deleted entities */
+  const dds_entity_t wr = g_writer, rd = g_reader;
+  CU_ASSERT_FATAL (dds_delete (wr) == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (dds_delete (rd) == DDS_RETCODE_OK);
+  CU_ASSERT (dds_get_matched_subscriptions (wr, NULL, 0) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_get_matched_publications (rd, NULL, 0) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_get_matched_subscription_statistics (wr, 0, &ss) == DDS_RETCODE_BAD_PARAMETER);
+  CU_ASSERT (dds_get_matched_publication_statistics (rd, 0, &ps) == DDS_RETCODE_BAD_PARAMETER);
+}
+
+CU_Test(ddsc_matched, wrong_kind, .init = matched_init, .fini = matched_fini)
+{
+  const dds_entity_t not_writers[] = { g_pub_pp, g_pub_tp, g_local_reader, dds_get_publisher (g_writer) };
+  const dds_entity_t not_readers[] = { g_sub_pp, g_sub_tp, g_local_writer, dds_get_subscriber (g_reader) };
+  dds_matched_subscription_statistics_t ss;
+  dds_matched_publication_statistics_t ps;
+  dds_instance_handle_t ihs[2];
+  for (size_t i = 0; i < sizeof (not_writers) / sizeof (not_writers[0]); i++)
+  {
+    CU_ASSERT_FATAL (not_writers[i] > 0);
+    CU_ASSERT (dds_get_matched_subscriptions (not_writers[i], ihs, 2) == DDS_RETCODE_ILLEGAL_OPERATION);
+    CU_ASSERT (dds_get_matched_subscription_statistics (not_writers[i], get_ih (g_local_reader), &ss) == DDS_RETCODE_ILLEGAL_OPERATION);
+  }
+  for (size_t i = 0; i < sizeof (not_readers) / sizeof (not_readers[0]); i++)
+  {
+    CU_ASSERT_FATAL (not_readers[i] > 0);
+    CU_ASSERT (dds_get_matched_publications (not_readers[i], ihs, 2) == DDS_RETCODE_ILLEGAL_OPERATION);
+    CU_ASSERT (dds_get_matched_publication_statistics (not_readers[i], get_ih (g_local_writer), &ps) == DDS_RETCODE_ILLEGAL_OPERATION);
+  }
+}
+
+CU_Test(ddsc_matched, buffer_size, .init = matched_init, .fini = matched_fini)
+{
+  dds_instance_handle_t ihs[3], ih_local, ih_remote;
+  CU_ASSERT_FATAL (wait_for_matched (g_writer, g_reader, 2));
+
+  /* the count is returned regardless of the size of the array, only as many
+     entries as fit are filled in */
+  CU_ASSERT (dds_get_matched_subscriptions (g_writer, NULL, 0) == 2);
+  ihs[0] = ihs[1] = ihs[2] = 0;
+  CU_ASSERT (dds_get_matched_subscriptions (g_writer, ihs, 1) == 2);
+  CU_ASSERT (ihs[0] != 0 && ihs[1] == 0);
+  CU_ASSERT (dds_get_matched_subscriptions (g_writer, ihs, 3) == 2);
+  CU_ASSERT (ihs[1] != 0 && ihs[2] == 0);
+  ih_local = get_ih (g_local_reader);
+  ih_remote = (ihs[0] == ih_local) ? ihs[1] : ihs[0];
+  CU_ASSERT ((ihs[0] == ih_local || ihs[1] == ih_local) && ih_remote != ih_local);
+
+  CU_ASSERT (dds_get_matched_publications (g_reader, NULL, 0) == 2);
+  ihs[0] = ihs[1] = ihs[2] = 0;
+  CU_ASSERT (dds_get_matched_publications (g_reader, ihs, 1) == 2);
+  CU_ASSERT (ihs[0] != 0 && ihs[1] == 0);
+  CU_ASSERT (dds_get_matched_publications (g_reader, ihs, 3) == 2);
+  CU_ASSERT (ihs[1] != 0 && ihs[2] == 0);
+  ih_local = get_ih (g_local_writer);
+  CU_ASSERT (ihs[0] == ih_local || ihs[1] == ih_local);
+}
+
+CU_Test(ddsc_matched, match_unmatch, .init = matched_init, .fini = matched_fini)
+{
+  dds_matched_subscription_statistics_t ss;
+  dds_matched_publication_statistics_t ps;
+  dds_instance_handle_t ihs[2], ih_remote_rd, ih_remote_wr;
+  CU_ASSERT_FATAL (wait_for_matched (g_writer, g_reader, 2));
+
+  CU_ASSERT_FATAL (dds_get_matched_subscriptions (g_writer, ihs, 2) == 2);
+  ih_remote_rd = (ihs[0] == get_ih (g_local_reader)) ? ihs[1] : ihs[0];
+  CU_ASSERT_FATAL (dds_get_matched_publications (g_reader, ihs, 2) == 2);
+  ih_remote_wr = (ihs[0] == get_ih (g_local_writer)) ? ihs[1] : ihs[0];
+
+  /* local matches have no statistics, but they are matches */
+  CU_ASSERT (dds_get_matched_subscription_statistics (g_writer, get_ih (g_local_reader), &ss) == DDS_RETCODE_OK);
+  CU_ASSERT (ss.rtt == 0 && ss.nacks == 0 && ss.nackfrags == 0 && ss.rexmit_count == 0 && ss.nacked_bytes == 0 && ss.throttled_time == 0);
+  CU_ASSERT (dds_get_matched_publication_statistics (g_reader, get_ih (g_local_writer), &ps) == DDS_RETCODE_OK);
+  CU_ASSERT (ps.nacks == 0 && ps.nackfrags == 0 && ps.nacked_samples == 0 && ps.nacked_fragments == 0);
+
+  /* remote ones do, the writer times the acknowledgement of the data, one
+     sample at a time, and only reports a round-trip time once it has a
+     handful of measurements */
+  CU_ASSERT (dds_get_matched_subscription_statistics (g_writer, ih_remote_rd, &ss) == DDS_RETCODE_OK);
+  CU_ASSERT (ss.rtt == 0);
+  CU_ASSERT (dds_get_matched_publication_statistics (g_reader, ih_remote_wr, &ps) == DDS_RETCODE_OK);
+  for (int32_t i = 0; i < 20 && ss.rtt == 0; i++)
+  {
+    Space_Type1 s = { i, i, i };
+    CU_ASSERT_FATAL (dds_write (g_writer, &s) == DDS_RETCODE_OK);
+    CU_ASSERT_FATAL (dds_wait_for_acks (g_writer, DDS_SECS (5)) == DDS_RETCODE_OK);
+    CU_ASSERT_FATAL (dds_get_matched_subscription_statistics (g_writer, ih_remote_rd, &ss) == DDS_RETCODE_OK);
+  }
+  CU_ASSERT (ss.rtt > 0);
+
+  /* handles of entities that aren't matched */
+  CU_ASSERT (dds_get_matched_subscription_statistics (g_writer, get_ih (g_reader), &ss) == DDS_RETCODE_PRECONDITION_NOT_MET);
+  CU_ASSERT (dds_get_matched_subscription_statistics (g_writer, get_ih (g_writer), &ss) == DDS_RETCODE_PRECONDITION_NOT_MET);
+  CU_ASSERT (dds_get_matched_publication_statistics (g_reader, get_ih (g_writer), &ps) == DDS_RETCODE_PRECONDITION_NOT_MET);
+  CU_ASSERT (dds_get_matched_publication_statistics (g_reader, get_ih (g_reader), &ps) == DDS_RETCODE_PRECONDITION_NOT_MET);
+
+  /* deleting the local reader and writer removes those matches, deleting the
+     remote reader removes the last one of the writer */
+  const dds_instance_handle_t ih_local_rd = get_ih (g_local_reader);
+  const dds_instance_handle_t ih_local_wr = get_ih (g_local_writer);
+  CU_ASSERT_FATAL (dds_delete (g_local_reader) == DDS_RETCODE_OK);
+  CU_ASSERT_FATAL (dds_delete (g_local_writer) == DDS_RETCODE_OK);
+  CU_ASSERT (dds_get_matched_subscriptions (g_writer, ihs, 2) == 1);
+  CU_ASSERT (ihs[0] == ih_remote_rd);
+  CU_ASSERT (dds_get_matched_publications (g_reader, ihs, 2) == 1);
+  CU_ASSERT (ihs[0] == ih_remote_wr);
+  CU_ASSERT (dds_get_matched_subscription_statistics (g_writer, ih_local_rd, &ss) == DDS_RETCODE_PRECONDITION_NOT_MET);
+  CU_ASSERT (dds_get_matched_publication_statistics (g_reader, ih_local_wr, &ps) == DDS_RETCODE_PRECONDITION_NOT_MET);
+  CU_ASSERT (dds_get_matched_subscription_statistics (g_writer, ih_remote_rd, &ss) == DDS_RETCODE_OK);
+  CU_ASSERT (dds_get_matched_publication_statistics (g_reader, ih_remote_wr, &ps) == DDS_RETCODE_OK);
+
+  CU_ASSERT_FATAL (dds_delete (g_reader) == DDS_RETCODE_OK);
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  while (dds_get_matched_subscriptions (g_writer, NULL, 0) != 0 && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  CU_ASSERT (dds_get_matched_subscriptions (g_writer, NULL, 0) == 0);
+  CU_ASSERT (dds_get_matched_subscription_statistics (g_writer, ih_remote_rd, &ss) == DDS_RETCODE_PRECONDITION_NOT_MET);
+}
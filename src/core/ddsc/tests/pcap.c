@@ -0,0 +1,370 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/misc.h"
+#include "dds/ddsrt/process.h"
+#include "dds/ddsrt/string.h"
+
+#include "test_common.h"
+
+#define NSAMPLES 20
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+#define DDS_CONFIG_PCAP "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><Tracing><PacketCaptureFile>%s</PacketCaptureFile>%s</Tracing>"
+
+/* Offsets in the captured records: a pcap record header, fake IPv4 and UDP
+   headers and then the RTPS message */
+#define PCAP_FILE_HDR_SIZE 24
+#define PCAP_REC_HDR_SIZE 16
+#define IPV4_TTL_OFFSET 8
+#define RTPS_OFFSET (20 + 8)
+#define RTPS_HDR_SIZE 20
+
+#define SMID_DATA 0x15
+#define SMID_DATA_FRAG 0x16
+#define SMID_HEARTBEAT 0x07
+#define SMID_GAP 0x08
+#define SMID_ACKNACK 0x06
+#define SMID_INFO_DST 0x0e
+
+struct record {
+  uint32_t incl_len, orig_len;
+  unsigned char ttl;
+  bool is_rtps; /* false for the 1-byte packets used to wake up receive threads */
+  const unsigned char *rtps; /* incl_len - RTPS_OFFSET bytes */
+};
+
+struct capture {
+  unsigned char *buf;
+  uint32_t snaplen;
+  uint32_t nrecs;
+  struct record *recs;
+};
+
+static char g_pcap_file[64];
+static char g_topic_name[2][100];
+
+static void pcap_init (void)
+{
+  (void) snprintf (g_pcap_file, sizeof (g_pcap_file), "cyclonedds_pcap_test.%"PRIdPID".pcap", ddsrt_getpid ());
+  (void) remove (g_pcap_file);
+  create_unique_topic_name ("ddsc_pcap_a", g_topic_name[0], sizeof (g_topic_name[0]));
+  create_unique_topic_name ("ddsc_pcap_b", g_topic_name[1], sizeof (g_topic_name[1]));
+}
+
+static void pcap_fini (void)
+{
+  (void) remove (g_pcap_file);
+}
+
+static void read_capture (struct capture *cap)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  FILE *fp;
+  long sz;
+  fp = fopen (g_pcap_file, "rb");
+  CU_ASSERT_FATAL (fp != NULL);
+  (void) fseek (fp, 0, SEEK_END);
+  sz = ftell (fp);
+  (void) fseek (fp, 0, SEEK_SET);
+  CU_ASSERT_FATAL (sz >= PCAP_FILE_HDR_SIZE);
+  cap->buf = ddsrt_malloc ((size_t) sz);
+  CU_ASSERT_FATAL (fread (cap->buf, (size_t) sz, 1, fp) == 1);
+  fclose (fp);
+  DDSRT_WARNING_MSVC_ON(4996);
+
+  uint32_t magic;
+  memcpy (&magic, cap->buf, sizeof (magic));
+  CU_ASSERT_FATAL (magic == 0xa1b2c3d4);
+  memcpy (&cap->snaplen, cap->buf + 16, sizeof (cap->snaplen));
+  cap->nrecs = 0;
+  cap->recs = NULL;
+  size_t off = PCAP_FILE_HDR_SIZE;
+  while (off < (size_t) sz)
+  {
+    struct record r;
+    CU_ASSERT_FATAL (off + PCAP_REC_HDR_SIZE <= (size_t) sz);
+    memcpy (&r.incl_len, cap->buf + off + 8, sizeof (r.incl_len));
+    memcpy (&r.orig_len, cap->buf + off + 12, sizeof (r.orig_len));
+    off += PCAP_REC_HDR_SIZE;
+    CU_ASSERT_FATAL (r.incl_len > RTPS_OFFSET && off + r.incl_len <= (size_t) sz);
+    r.ttl = cap->buf[off + IPV4_TTL_OFFSET];
+    r.rtps = cap->buf + off + RTPS_OFFSET;
+    r.is_rtps = (r.incl_len >= RTPS_OFFSET + RTPS_HDR_SIZE && memcmp (r.rtps, "RTPS", 4) == 0);
+    cap->recs = ddsrt_realloc (cap->recs, (cap->nrecs + 1) * sizeof (*cap->recs));
+    cap->recs[cap->nrecs++] = r;
+    off += r.incl_len;
+  }
+}
+
+static void free_capture (struct capture *cap)
+{
+  ddsrt_free (cap->recs);
+  ddsrt_free (cap->buf);
+}
+
+static uint16_t smhdr_octets (const unsigned char *sm)
+{
+  if (sm[1] & 1)
+    return (uint16_t) (sm[2] | (sm[3] << 8));
+  else
+    return (uint16_t) ((sm[2] << 8) | sm[3]);
+}
+
+/* Calls "f" for each complete submessage, stopping early if "f" returns true;
+   returns whether any call returned true */
+static bool any_submsg (const struct record *r, bool (*f) (const unsigned char *sm, size_t len, const void *arg), const void *arg)
+{
+  const size_t sz = r->incl_len - RTPS_OFFSET;
+  size_t off = RTPS_HDR_SIZE;
+  if (!r->is_rtps)
+    return false;
+  while (off + 4 <= sz)
+  {
+    const unsigned char *sm = r->rtps + off;
+    const uint16_t octets = smhdr_octets (sm);
+    const size_t end = (octets == 0) ? sz : off + 4 + octets;
+    if (end > sz)
+      break;
+    if (f (sm, end - off, arg))
+      return true;
+    off = end;
+  }
+  return false;
+}
+
+static bool is_data_of (const unsigned char *sm, size_t len, const void *wrid)
+{
+  return (sm[0] == SMID_DATA || sm[0] == SMID_DATA_FRAG) && len >= 16 && memcmp (sm + 12, wrid, 4) == 0;
+}
+
+static bool refers_to (const unsigned char *sm, size_t len, const void *wrid)
+{
+  switch (sm[0])
+  {
+    case SMID_DATA: case SMID_DATA_FRAG:
+      return is_data_of (sm, len, wrid);
+    case SMID_HEARTBEAT: case SMID_GAP: case SMID_ACKNACK:
+      return len >= 12 && memcmp (sm + 8, wrid, 4) == 0;
+    default:
+      return false;
+  }
+}
+
+static bool is_info_dst (const unsigned char *sm, size_t len, const void *prefix)
+{
+  return sm[0] == SMID_INFO_DST && len >= 16 && memcmp (sm + 4, prefix, 12) == 0;
+}
+
+static dds_entity_t create_domain (dds_domainid_t domid, const char *pcap_options)
+{
+  char *conf_raw, *conf;
+  dds_entity_t dom;
+  if (pcap_options)
+    (void) ddsrt_asprintf (&conf_raw, DDS_CONFIG_PCAP, g_pcap_file, pcap_options);
+  else
+    conf_raw = ddsrt_strdup (DDS_CONFIG_NO_PORT_GAIN);
+  conf = ddsrt_expand_envvars (conf_raw, domid);
+  dom = dds_create_domain (domid, conf);
+  CU_ASSERT_FATAL (dom > 0);
+  dds_free (conf);
+  dds_free (conf_raw);
+  return dom;
+}
+
+static void wait_for_match (dds_entity_t wr)
+{
+  dds_publication_matched_status_t st;
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &st) == DDS_RETCODE_OK);
+    if (st.current_count == 0)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (st.current_count == 0 && dds_time () < tend);
+  CU_ASSERT_FATAL (st.current_count == 1);
+}
+
+/* Captures the traffic of a domain with best-effort writers for two topics,
+   each matched by a reader in another domain; writer A is deleted immediately
+   after writing its last sample, which for a best-effort writer means it is
+   gone long before the capture thread gets to the last packets.  The entity ids of the writers and the GUID prefix
+   of the subscribing participant are returned for checking the capture. */
+static void run (const char *pcap_options, bool filter_on_sub_prefix, unsigned char wrid[2][4], unsigned char sub_prefix[12])
+{
+  dds_entity_t sub_dom, pub_dom, sub_pp, pub_pp, wr[2];
+  dds_guid_t guid;
+
+  sub_dom = create_domain (DDS_DOMAINID_SUB, NULL);
+  sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+  CU_ASSERT_FATAL (dds_get_guid (sub_pp, &guid) == DDS_RETCODE_OK);
+  memcpy (sub_prefix, guid.v, 12);
+  if (!filter_on_sub_prefix)
+    pub_dom = create_domain (DDS_DOMAINID_PUB, pcap_options);
+  else
+  {
+    /* PacketCaptureGuidPrefixes takes the prefix as 3 32-bit hex numbers */
+    char *opts;
+    uint32_t p[3];
+    for (int i = 0; i < 3; i++)
+      p[i] = ((uint32_t) sub_prefix[4*i] << 24) | ((uint32_t) sub_prefix[4*i+1] << 16) | ((uint32_t) sub_prefix[4*i+2] << 8) | sub_prefix[4*i+3];
+    (void) ddsrt_asprintf (&opts, "%s<PacketCaptureGuidPrefixes>%"PRIx32":%"PRIx32":%"PRIx32"</PacketCaptureGuidPrefixes>", pcap_options, p[0], p[1], p[2]);
+    pub_dom = create_domain (DDS_DOMAINID_PUB, opts);
+    dds_free (opts);
+  }
+  pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_BEST_EFFORT, 0);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  for (int k = 0; k < 2; k++)
+  {
+    const dds_entity_t pub_tp = dds_create_topic (pub_pp, &Space_Type1_desc, g_topic_name[k], qos, NULL);
+    CU_ASSERT_FATAL (pub_tp > 0);
+    const dds_entity_t sub_tp = dds_create_topic (sub_pp, &Space_Type1_desc, g_topic_name[k], qos, NULL);
+    CU_ASSERT_FATAL (sub_tp > 0);
+    CU_ASSERT_FATAL (dds_create_reader (sub_pp, sub_tp, qos, NULL) > 0);
+    wr[k] = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+    CU_ASSERT_FATAL (wr[k] > 0);
+    CU_ASSERT_FATAL (dds_get_guid (wr[k], &guid) == DDS_RETCODE_OK);
+    memcpy (wrid[k], guid.v + 12, 4);
+  }
+  dds_delete_qos (qos);
+  for (int k = 0; k < 2; k++)
+    wait_for_match (wr[k]);
+
+  for (int32_t i = 0; i < NSAMPLES; i++)
+  {
+    Space_Type1 s = { i, i, i };
+    CU_ASSERT_FATAL (dds_write (wr[1], &s) == DDS_RETCODE_OK);
+    CU_ASSERT_FATAL (dds_write (wr[0], &s) == DDS_RETCODE_OK);
+  }
+  CU_ASSERT_FATAL (dds_delete (wr[0]) == DDS_RETCODE_OK);
+
+  /* all captured packets are written out when the domain is deleted */
+  dds_delete (pub_dom);
+  dds_delete (sub_dom);
+}
+
+static uint32_t count_sent_data (const struct capture *cap, const unsigned char wrid[4])
+{
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < cap->nrecs; i++)
+    if (cap->recs[i].ttl == 255 && any_submsg (&cap->recs[i], is_data_of, wrid))
+      n++;
+  return n;
+}
+
+static void check_complete (const char *pcap_options)
+{
+  unsigned char wrid[2][4], sub_prefix[12];
+  struct capture cap;
+  run (pcap_options, false, wrid, sub_prefix);
+  read_capture (&cap);
+  CU_ASSERT (cap.snaplen == 65535);
+  for (uint32_t i = 0; i < cap.nrecs; i++)
+  {
+    CU_ASSERT (cap.recs[i].incl_len == cap.recs[i].orig_len);
+    CU_ASSERT (cap.recs[i].ttl == 128 || cap.recs[i].ttl == 255);
+  }
+  /* the samples are written alternately, so they can't share packets */
+  CU_ASSERT (count_sent_data (&cap, wrid[0]) == NSAMPLES);
+  CU_ASSERT (count_sent_data (&cap, wrid[1]) == NSAMPLES);
+  free_capture (&cap);
+}
+
+CU_Test(ddsc_pcap, synchronous, .init = pcap_init, .fini = pcap_fini)
+{
+  check_complete ("");
+}
+
+CU_Test(ddsc_pcap, ring, .init = pcap_init, .fini = pcap_fini)
+{
+  check_complete ("<PacketCaptureBufferSize>1 MiB</PacketCaptureBufferSize>");
+}
+
+CU_Test(ddsc_pcap, snaplen, .init = pcap_init, .fini = pcap_fini)
+{
+  unsigned char wrid[2][4], sub_prefix[12];
+  struct capture cap;
+  bool truncated = false;
+  run ("<PacketCaptureSnapLength>64 B</PacketCaptureSnapLength>", false, wrid, sub_prefix);
+  read_capture (&cap);
+  CU_ASSERT (cap.snaplen == 64 + RTPS_OFFSET);
+  CU_ASSERT (cap.nrecs > 0);
+  for (uint32_t i = 0; i < cap.nrecs; i++)
+  {
+    CU_ASSERT (cap.recs[i].incl_len <= 64 + RTPS_OFFSET);
+    CU_ASSERT (cap.recs[i].incl_len <= cap.recs[i].orig_len);
+    if (cap.recs[i].incl_len < cap.recs[i].orig_len)
+    {
+      CU_ASSERT (cap.recs[i].incl_len == 64 + RTPS_OFFSET);
+      truncated = true;
+    }
+  }
+  /* SPDP messages are always longer than 64 bytes */
+  CU_ASSERT (truncated);
+  free_capture (&cap);
+}
+
+CU_Test(ddsc_pcap, guid_prefix_filter, .init = pcap_init, .fini = pcap_fini)
+{
+  unsigned char wrid[2][4], sub_prefix[12];
+  struct capture cap;
+  run ("<PacketCaptureBufferSize>1 MiB</PacketCaptureBufferSize>", true, wrid, sub_prefix);
+  read_capture (&cap);
+  CU_ASSERT (cap.nrecs > 0);
+  for (uint32_t i = 0; i < cap.nrecs; i++)
+  {
+    const struct record *r = &cap.recs[i];
+    CU_ASSERT (r->is_rtps);
+    CU_ASSERT (memcmp (r->rtps + 8, sub_prefix, 12) == 0 || any_submsg (r, is_info_dst, sub_prefix));
+  }
+  free_capture (&cap);
+}
+
+static void check_topic_filter (const char *pcap_options)
+{
+  unsigned char wrid[2][4], sub_prefix[12];
+  struct capture cap;
+  char *opts;
+  (void) ddsrt_asprintf (&opts, "%s<PacketCaptureTopics>%s</PacketCaptureTopics>", pcap_options, g_topic_name[0]);
+  run (opts, false, wrid, sub_prefix);
+  dds_free (opts);
+  read_capture (&cap);
+  CU_ASSERT (cap.nrecs > 0);
+  for (uint32_t i = 0; i < cap.nrecs; i++)
+    CU_ASSERT (any_submsg (&cap.recs[i], refers_to, wrid[0]));
+  /* deleting writer A must not affect the filtering */
+  CU_ASSERT (count_sent_data (&cap, wrid[0]) == NSAMPLES);
+  CU_ASSERT (count_sent_data (&cap, wrid[1]) == 0);
+  free_capture (&cap);
+}
+
+CU_Test(ddsc_pcap, topic_filter_synchronous, .init = pcap_init, .fini = pcap_fini)
+{
+  check_topic_filter ("");
+}
+
+CU_Test(ddsc_pcap, topic_filter_ring, .init = pcap_init, .fini = pcap_fini)
+{
+  check_topic_filter ("<PacketCaptureBufferSize>1 MiB</PacketCaptureBufferSize>");
+}
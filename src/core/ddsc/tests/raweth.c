@@ -0,0 +1,120 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/io.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+
+/* Raw ethernet over the loopback interface: no multicast, so the peers are
+   listed explicitly using fixed participant indices. */
+#define DDS_CONFIG_RAWETH "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<General><Transport>raweth</Transport><NetworkInterfaceAddress>lo</NetworkInterfaceAddress></General><Discovery><ExternalDomainId>0</ExternalDomainId><ParticipantIndex>${CYCLONEDDS_DOMAIN_ID}</ParticipantIndex><Peers><Peer address=\"[00:00:00:00:00:00]:7410\"/><Peer address=\"[00:00:00:00:00:00]:7412\"/></Peers></Discovery><RawEthernet><PacketRings>%s</PacketRings></RawEthernet>"
+
+#define NSAMPLES 500
+
+static bool create_domain (dds_entity_t *dom, dds_domainid_t domid, const char *rings)
+{
+  char *conf_raw, *conf;
+  (void) ddsrt_asprintf (&conf_raw, DDS_CONFIG_RAWETH, rings);
+  conf = ddsrt_expand_envvars (conf_raw, domid);
+  *dom = dds_create_domain (domid, conf);
+  dds_free (conf);
+  dds_free (conf_raw);
+  return *dom > 0;
+}
+
+static void raweth_pubsub (const char *rings)
+{
+  char topic_name[100];
+  dds_entity_t pub_dom, sub_dom;
+
+  /* raw sockets require privileges that normally aren't available */
+  if (!create_domain (&pub_dom, DDS_DOMAINID_PUB, rings))
+  {
+    printf ("ddsc_raweth: raw ethernet not available, skipping\n");
+    return;
+  }
+  CU_ASSERT_FATAL (create_domain (&sub_dom, DDS_DOMAINID_SUB, rings));
+
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  if (pub_pp < 0 || sub_pp < 0)
+  {
+    printf ("ddsc_raweth: raw ethernet not available, skipping\n");
+    dds_delete (sub_dom);
+    dds_delete (pub_dom);
+    return;
+  }
+  create_unique_topic_name ("ddsc_raweth", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+
+  dds_publication_matched_status_t pm;
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &pm) == DDS_RETCODE_OK);
+  } while (pm.current_count == 0 && dds_time () < tend);
+  CU_ASSERT_FATAL (pm.current_count == 1);
+
+  /* every sample must arrive, in order */
+  for (int32_t i = 0; i < NSAMPLES; i++)
+  {
+    Space_Type1 s = { i, i, i };
+    CU_ASSERT_FATAL (dds_write (wr, &s) == DDS_RETCODE_OK);
+  }
+  int32_t count = 0;
+  tend = dds_time () + DDS_SECS (10);
+  while (count < NSAMPLES && dds_time () < tend)
+  {
+    Space_Type1 s;
+    void *ptr = &s;
+    dds_sample_info_t si;
+    if (dds_take (rd, &ptr, &si, 1, 1) == 1)
+    {
+      CU_ASSERT (si.valid_data && s.long_1 == count);
+      count++;
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  CU_ASSERT (count == NSAMPLES);
+  dds_delete (sub_dom);
+  dds_delete (pub_dom);
+}
+
+CU_Test(ddsc_raweth, pubsub)
+{
+  raweth_pubsub ("false");
+}
+
+CU_Test(ddsc_raweth, pubsub_rings)
+{
+  raweth_pubsub ("true");
+}
@@ -0,0 +1,364 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/q_bitset.h"
+#include "dds/ddsi/q_bswap.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_misc.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_transmit.h"
+#include "dds/ddsi/q_whc.h"
+#include "dds/ddsi/q_xmsg.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+#include "RoundTrip.h"
+
+#define NSAMPLES 4
+#define SAMPLE_SIZE 20000u
+#define FRAGMENT_SIZE 1344u
+#define FRAGS_PER_MSG 10u /* fit in a message of 14720 bytes */
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+/* The coalescing window is long enough for the requests queued by a test
+   not to be flushed by the event before the test flushes them itself */
+#define DDS_CONFIG_REXMIT "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><General><FragmentSize>1344 B</FragmentSize><MaxMessageSize>14720 B</MaxMessageSize></General><Internal><RetransmitCoalescingWindow>1 s</RetransmitCoalescingWindow><MaxQueuedRexmitBytes>30 kB</MaxQueuedRexmitBytes></Internal>"
+
+/* The messages added to the xpack by writer_rexmit_flush are captured by a
+   fake connection that keeps only the DATA_FRAG submessages */
+#define MAX_DATAFRAGS 64
+
+struct datafrag {
+  uint32_t rdid;
+  int64_t seq;
+  uint32_t start; /* 0-based */
+  uint32_t n;
+};
+
+struct capture {
+  struct ddsi_tran_conn conn;
+  uint32_t npackets;
+  uint32_t ndatafrags;
+  struct datafrag datafrags[MAX_DATAFRAGS];
+};
+
+static dds_entity_t g_pub_dom, g_sub_dom, g_wr;
+static struct ddsi_domaingv *g_gv;
+static struct writer *g_wrp;
+static struct dds_entity *g_wr_entity;
+static ddsi_guid_t g_prd_guid[2];
+static uint32_t g_size, g_nfrags; /* serialized size and number of fragments of each sample */
+
+static void flush (struct capture *cap);
+
+static ssize_t capture_write (ddsi_tran_conn_t conn, const nn_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
+{
+  struct capture * const cap = (struct capture *) conn;
+  unsigned char buf[65536];
+  size_t len = 0;
+  (void) dst;
+  (void) flags;
+  for (size_t i = 0; i < niov; i++)
+  {
+    CU_ASSERT_FATAL (len + iov[i].iov_len <= sizeof (buf));
+    memcpy (buf + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  cap->npackets++;
+  size_t off = RTPS_MESSAGE_HEADER_SIZE;
+  while (off < len)
+  {
+    const SubmessageHeader_t *hdr = (const SubmessageHeader_t *) (buf + off);
+    if (hdr->submessageId == SMID_DATA_FRAG)
+    {
+      DataFrag_t df;
+      memcpy (&df, hdr, sizeof (df));
+      CU_ASSERT_FATAL (cap->ndatafrags < MAX_DATAFRAGS);
+      struct datafrag * const d = &cap->datafrags[cap->ndatafrags++];
+      d->rdid = nn_ntoh_entityid (df.x.readerId).u;
+      d->seq = fromSN (df.x.writerSN);
+      d->start = df.fragmentStartingNum - 1;
+      d->n = df.fragmentsInSubmessage;
+    }
+    off += RTPS_SUBMESSAGE_HEADER_SIZE + hdr->octetsToNextHeader;
+  }
+  return (ssize_t) len;
+}
+
+static void rexmit_init (void)
+{
+  char topic_name[100];
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_REXMIT, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_REXMIT, DDS_DOMAINID_SUB);
+  g_pub_dom = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (g_pub_dom > 0);
+  g_sub_dom = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (g_sub_dom > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+
+  /* transient-local so the samples stay available for retransmitting once
+     they have been acknowledged */
+  create_unique_topic_name ("ddsc_rexmit", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  dds_qset_durability_service (qos, 0, DDS_HISTORY_KEEP_LAST, NSAMPLES, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, NSAMPLES);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &RoundTripModule_DataType_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &RoundTripModule_DataType_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  for (int i = 0; i < 2; i++)
+  {
+    const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+    CU_ASSERT_FATAL (rd > 0);
+  }
+  g_wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (g_wr > 0);
+  dds_delete_qos (qos);
+
+  dds_publication_matched_status_t pm;
+  const dds_time_t tmatch = dds_time () + DDS_SECS (10);
+  do {
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (g_wr, &pm) == DDS_RETCODE_OK);
+    if (pm.current_count < 2)
+      dds_sleepfor (DDS_MSECS (10));
+  } while (pm.current_count < 2 && dds_time () < tmatch);
+  CU_ASSERT_FATAL (pm.current_count == 2);
+
+  /* sample i has sequence number i + 1 */
+  unsigned char *payload = ddsrt_calloc (1, SAMPLE_SIZE);
+  for (uint32_t i = 0; i < NSAMPLES; i++)
+  {
+    RoundTripModule_DataType s = { .payload = { ._maximum = SAMPLE_SIZE, ._length = SAMPLE_SIZE, ._buffer = payload, ._release = false } };
+    CU_ASSERT_FATAL (dds_write (g_wr, &s) == DDS_RETCODE_OK);
+  }
+  ddsrt_free (payload);
+  CU_ASSERT_FATAL (dds_wait_for_acks (g_wr, DDS_SECS (10)) == DDS_RETCODE_OK);
+
+  CU_ASSERT_FATAL (dds_entity_pin (g_wr, &g_wr_entity) == DDS_RETCODE_OK);
+  g_gv = &g_wr_entity->m_domain->gv;
+  g_wrp = ((struct dds_writer *) g_wr_entity)->m_wr;
+  CU_ASSERT_FATAL (g_wrp->rexmit_xevent != NULL);
+  ddsrt_mutex_lock (&g_wrp->e.lock);
+  struct whc_borrowed_sample sample;
+  CU_ASSERT_FATAL (whc_borrow_sample (g_wrp->whc, 1, &sample));
+  g_size = ddsi_serdata_size (sample.serdata);
+  g_nfrags = (g_size + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE;
+  whc_return_sample (g_wrp->whc, &sample, false);
+  CU_ASSERT_FATAL (g_nfrags > FRAGS_PER_MSG);
+  ddsrt_avl_iter_t it;
+  int k = 0;
+  for (struct wr_prd_match *m = ddsrt_avl_iter_first (&wr_readers_treedef, &g_wrp->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+    g_prd_guid[k++] = m->prd_guid;
+  ddsrt_mutex_unlock (&g_wrp->e.lock);
+  CU_ASSERT_FATAL (k == 2);
+
+  /* get rid of any retransmit requests from the readers that are still
+     pending even though they have acknowledged everything */
+  struct capture cap;
+  flush (&cap);
+}
+
+static void rexmit_fini (void)
+{
+  dds_entity_unpin (g_wr_entity);
+  dds_delete (g_pub_dom);
+  dds_delete (g_sub_dom);
+}
+
+static struct proxy_reader *prd (int i)
+{
+  struct proxy_reader *p = entidx_lookup_proxy_reader_guid (g_gv->entity_index, &g_prd_guid[i]);
+  CU_ASSERT_FATAL (p != NULL);
+  return p;
+}
+
+/* Requests the retransmit of fragments [first,first+n) of "seq" by reader
+   "i", or of the full sample if n == 0 */
+static bool request (int i, int64_t seq, uint32_t first, uint32_t n)
+{
+  uint32_t bits[(SAMPLE_SIZE / FRAGMENT_SIZE + 32) / 32] = { 0 };
+  bool ok;
+  for (uint32_t f = 0; f < n; f++)
+    nn_bitset_set (n, bits, f);
+  thread_state_awake (lookup_thread_state (), g_gv);
+  ddsrt_mutex_lock (&g_wrp->e.lock);
+  ok = writer_rexmit_request_wrlock_held (g_wrp, prd (i), seq, g_size, first, n, (n > 0) ? bits : NULL);
+  ddsrt_mutex_unlock (&g_wrp->e.lock);
+  thread_state_asleep (lookup_thread_state ());
+  return ok;
+}
+
+static uint32_t queued_bytes (void)
+{
+  uint32_t n;
+  ddsrt_mutex_lock (&g_wrp->e.lock);
+  n = g_wrp->rexmit_reqs_bytes;
+  ddsrt_mutex_unlock (&g_wrp->e.lock);
+  return n;
+}
+
+static uint32_t queued_requests (void)
+{
+  uint32_t n;
+  ddsrt_avl_iter_t it;
+  ddsrt_mutex_lock (&g_wrp->e.lock);
+  n = 0;
+  for (struct wr_rexmit_req *req = ddsrt_avl_iter_first (&wr_rexmit_reqs_treedef, &g_wrp->rexmit_reqs, &it); req; req = ddsrt_avl_iter_next (&it))
+    n++;
+  ddsrt_mutex_unlock (&g_wrp->e.lock);
+  return n;
+}
+
+/* Flushes the queued requests through an xpack with the capturing
+   connection */
+static void flush (struct capture *cap)
+{
+  memset (cap, 0, sizeof (*cap));
+  cap->conn.m_base.gv = g_gv;
+  cap->conn.m_write_fn = capture_write;
+  cap->conn.m_connless = true;
+  struct nn_xpack *xp = nn_xpack_new (&cap->conn, 0, false);
+  thread_state_awake (lookup_thread_state (), g_gv);
+  writer_rexmit_flush (xp, g_wrp);
+  nn_xpack_send (xp, true);
+  thread_state_asleep (lookup_thread_state ());
+  nn_xpack_free (xp);
+  CU_ASSERT (queued_requests () == 0);
+  CU_ASSERT (queued_bytes () == 0);
+}
+
+static bool same_datafrag (const struct datafrag *a, const struct datafrag *b)
+{
+  return a->rdid == b->rdid && a->seq == b->seq && a->start == b->start && a->n == b->n;
+}
+
+/* Number of distinct DATA_FRAGs for "seq": a message addressed to all
+   readers is sent to each of the writer's addresses */
+static uint32_t count_datafrags (const struct capture *cap, int64_t seq)
+{
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < cap->ndatafrags; i++)
+  {
+    uint32_t j;
+    for (j = 0; j < i && !same_datafrag (&cap->datafrags[i], &cap->datafrags[j]); j++)
+      ;
+    if (cap->datafrags[i].seq == seq && j == i)
+      n++;
+  }
+  return n;
+}
+
+static bool has_datafrag (const struct capture *cap, uint32_t rdid, int64_t seq, uint32_t start, uint32_t n)
+{
+  const struct datafrag d = { .rdid = rdid, .seq = seq, .start = start, .n = n };
+  for (uint32_t i = 0; i < cap->ndatafrags; i++)
+    if (same_datafrag (&cap->datafrags[i], &d))
+      return true;
+  return false;
+}
+
+CU_Test(ddsc_rexmit, consecutive_fragments, .init = rexmit_init, .fini = rexmit_fini)
+{
+  /* consecutive fragments go in a single DATA_FRAG, a gap starts a new one */
+  struct capture cap;
+  CU_ASSERT_FATAL (request (0, 1, 2, 8));
+  CU_ASSERT_FATAL (request (0, 1, 12, 2));
+  CU_ASSERT (queued_requests () == 1);
+  CU_ASSERT (queued_bytes () == 10 * FRAGMENT_SIZE);
+  flush (&cap);
+  CU_ASSERT (count_datafrags (&cap, 1) == 2);
+  CU_ASSERT (has_datafrag (&cap, g_prd_guid[0].entityid.u, 1, 2, 8));
+  CU_ASSERT (has_datafrag (&cap, g_prd_guid[0].entityid.u, 1, 12, 2));
+
+  /* a full sample goes out in as few messages as possible */
+  CU_ASSERT_FATAL (request (0, 2, 0, 0));
+  flush (&cap);
+  CU_ASSERT (count_datafrags (&cap, 2) == 2);
+  CU_ASSERT (has_datafrag (&cap, g_prd_guid[0].entityid.u, 2, 0, FRAGS_PER_MSG));
+  CU_ASSERT (has_datafrag (&cap, g_prd_guid[0].entityid.u, 2, FRAGS_PER_MSG, g_nfrags - FRAGS_PER_MSG));
+}
+
+CU_Test(ddsc_rexmit, duplicate_requests, .init = rexmit_init, .fini = rexmit_fini)
+{
+  /* repeated and overlapping NACKs from one reader don't add anything, nor
+     do they change the reader it is sent to */
+  struct capture cap;
+  CU_ASSERT_FATAL (request (0, 1, 2, 4));
+  const uint32_t bytes = queued_bytes ();
+  CU_ASSERT (bytes == 4 * FRAGMENT_SIZE);
+  CU_ASSERT_FATAL (request (0, 1, 2, 4));
+  CU_ASSERT_FATAL (request (0, 1, 3, 2));
+  CU_ASSERT (queued_requests () == 1);
+  CU_ASSERT (queued_bytes () == bytes);
+  CU_ASSERT_FATAL (request (0, 1, 4, 3));
+  CU_ASSERT (queued_bytes () == 5 * FRAGMENT_SIZE);
+  flush (&cap);
+  CU_ASSERT (count_datafrags (&cap, 1) == 1);
+  CU_ASSERT (has_datafrag (&cap, g_prd_guid[0].entityid.u, 1, 2, 5));
+}
+
+CU_Test(ddsc_rexmit, multiple_readers, .init = rexmit_init, .fini = rexmit_fini)
+{
+  /* requests from different readers for the same sample result in a single
+     retransmit addressed to all readers, with the union of the fragments */
+  struct capture cap;
+  CU_ASSERT_FATAL (request (0, 3, 0, 3));
+  CU_ASSERT_FATAL (request (1, 3, 2, 3));
+  CU_ASSERT (queued_requests () == 1);
+  CU_ASSERT (queued_bytes () == 5 * FRAGMENT_SIZE);
+  flush (&cap);
+  CU_ASSERT (count_datafrags (&cap, 3) == 1);
+  CU_ASSERT (has_datafrag (&cap, 0, 3, 0, 5));
+  CU_ASSERT (!has_datafrag (&cap, g_prd_guid[0].entityid.u, 3, 0, 5));
+  CU_ASSERT (!has_datafrag (&cap, g_prd_guid[1].entityid.u, 3, 0, 5));
+}
+
+CU_Test(ddsc_rexmit, max_queued_bytes, .init = rexmit_init, .fini = rexmit_fini)
+{
+  /* a request for a new sample is refused once MaxQueuedRexmitBytes (30 kB)
+     is reached, but the first is always accepted and requests for samples
+     already queued are merged */
+  struct capture cap;
+  CU_ASSERT_FATAL (g_gv->config.max_queued_rexmit_bytes == 30 * 1024);
+  CU_ASSERT (request (0, 1, 0, 0));
+  CU_ASSERT (request (0, 2, 0, 0));
+  CU_ASSERT (queued_bytes () == 2 * g_nfrags * FRAGMENT_SIZE);
+  CU_ASSERT (!request (0, 3, 0, 0));
+  CU_ASSERT (!request (1, 4, 0, 3));
+  CU_ASSERT (request (1, 2, 0, 0));
+  CU_ASSERT (queued_requests () == 2);
+  flush (&cap);
+  CU_ASSERT (count_datafrags (&cap, 1) == 2);
+  CU_ASSERT (count_datafrags (&cap, 2) == 2);
+  CU_ASSERT (count_datafrags (&cap, 3) == 0);
+
+  /* flushing frees up the space */
+  CU_ASSERT (request (0, 3, 0, 0));
+  flush (&cap);
+  CU_ASSERT (count_datafrags (&cap, 3) == 2);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds/ddsi/ddsi_rxfilter.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_lease.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_NO_PORT_GAIN "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+static dds_entity_t g_pub_domain, g_sub_domain;
+static dds_entity_t g_writer, g_reader;
+static struct ddsi_domaingv *g_sub_gv;
+static ddsi_guid_t g_wr_guid;
+
+static void rxfilter_init (void)
+{
+  char topic_name[100];
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_NO_PORT_GAIN, DDS_DOMAINID_SUB);
+  g_pub_domain = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (g_pub_domain > 0);
+  g_sub_domain = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (g_sub_domain > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+  create_unique_topic_name ("ddsc_rxfilter", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_BEST_EFFORT, 0);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  g_writer = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (g_writer > 0);
+  g_reader = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (g_reader > 0);
+  dds_delete_qos (qos);
+
+  /* both sides must have discovered each other for the data to go out */
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  dds_publication_matched_status_t pm;
+  dds_subscription_matched_status_t sm;
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (g_writer, &pm) == DDS_RETCODE_OK);
+    CU_ASSERT_FATAL (dds_get_subscription_matched_status (g_reader, &sm) == DDS_RETCODE_OK);
+  } while ((pm.current_count == 0 || sm.current_count == 0) && dds_time () < tend);
+  CU_ASSERT_FATAL (pm.current_count == 1 && sm.current_count == 1);
+
+  struct dds_entity *x;
+  CU_ASSERT_FATAL (dds_entity_pin (g_writer, &x) == DDS_RETCODE_OK);
+  g_wr_guid = x->m_guid;
+  dds_entity_unpin (x);
+  CU_ASSERT_FATAL (dds_entity_pin (sub_pp, &x) == DDS_RETCODE_OK);
+  g_sub_gv = &x->m_domain->gv;
+  dds_entity_unpin (x);
+}
+
+static void rxfilter_fini (void)
+{
+  dds_delete (g_sub_domain);
+  dds_delete (g_pub_domain);
+}
+
+static void set_filtered (bool filtered)
+{
+  /* the filter contains every proxy writer with local readers, so the only way to
+     make the subscribing side drop the data while the writer still sends it is by
+     manipulating the filter directly */
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct proxy_writer *pwr;
+  thread_state_awake (ts1, g_sub_gv);
+  pwr = entidx_lookup_proxy_writer_guid (g_sub_gv->entity_index, &g_wr_guid);
+  CU_ASSERT_FATAL (pwr != NULL);
+  ddsrt_mutex_lock (&pwr->e.lock);
+  if (filtered)
+    ddsi_rxfilter_remove (g_sub_gv->rxfilter, pwr);
+  else
+    ddsi_rxfilter_add (g_sub_gv->rxfilter, pwr);
+  ddsrt_mutex_unlock (&pwr->e.lock);
+  thread_state_asleep (ts1);
+}
+
+static bool proxypp_lease_renewed_since (ddsrt_etime_t t)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct proxy_participant *proxypp;
+  struct lease *lease;
+  ddsi_guid_t ppguid;
+  bool renewed;
+  ppguid.prefix = g_wr_guid.prefix;
+  ppguid.entityid.u = NN_ENTITYID_PARTICIPANT;
+  thread_state_awake (ts1, g_sub_gv);
+  proxypp = entidx_lookup_proxy_participant_guid (g_sub_gv->entity_index, &ppguid);
+  CU_ASSERT_FATAL (proxypp != NULL);
+  lease = ddsrt_atomic_ldvoidp (&proxypp->minl_auto);
+  CU_ASSERT_FATAL (lease != NULL);
+  renewed = (int64_t) ddsrt_atomic_ld64 (&lease->tend) >= ddsrt_etime_add_duration (t, lease->tdur).v;
+  thread_state_asleep (ts1);
+  return renewed;
+}
+
+static int32_t write_and_take (int32_t n, dds_duration_t timeout)
+{
+  int32_t count = 0;
+  for (int32_t i = 0; i < n; i++)
+  {
+    Space_Type1 s = { i, i, i };
+    CU_ASSERT_FATAL (dds_write (g_writer, &s) == DDS_RETCODE_OK);
+  }
+  const dds_time_t tend = dds_time () + timeout;
+  while (count < n && dds_time () < tend)
+  {
+    Space_Type1 s;
+    void *ptr = &s;
+    dds_sample_info_t si;
+    if (dds_take (g_reader, &ptr, &si, 1, 1) == 1)
+      count++;
+    else
+      dds_sleepfor (DDS_MSECS (10));
+  }
+  return count;
+}
+
+CU_Test(ddsc_rxfilter, accept, .init = rxfilter_init, .fini = rxfilter_fini)
+{
+  struct ddsi_rxfilter_stats st0, st1;
+  ddsi_rxfilter_get_stats (g_sub_gv->rxfilter, &st0);
+  CU_ASSERT (write_and_take (10, DDS_SECS (5)) == 10);
+  ddsi_rxfilter_get_stats (g_sub_gv->rxfilter, &st1);
+  CU_ASSERT (st1.accepted >= st0.accepted + 10);
+  CU_ASSERT (st1.dropped == st0.dropped);
+}
+
+CU_Test(ddsc_rxfilter, drop, .init = rxfilter_init, .fini = rxfilter_fini)
+{
+  struct ddsi_rxfilter_stats st0, st1;
+  set_filtered (true);
+  ddsi_rxfilter_get_stats (g_sub_gv->rxfilter, &st0);
+
+  /* the dropped data still renews the lease of the participant: let the discovery
+     traffic die down and check the lease as soon as the data has been dropped to
+     make it unlikely that anything else renewed it */
+  dds_sleepfor (DDS_MSECS (100));
+  const ddsrt_etime_t tstart = ddsrt_time_elapsed ();
+  for (int32_t i = 0; i < 10; i++)
+  {
+    Space_Type1 s = { i, i, i };
+    CU_ASSERT_FATAL (dds_write (g_writer, &s) == DDS_RETCODE_OK);
+  }
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  do {
+    dds_sleepfor (DDS_MSECS (1));
+    ddsi_rxfilter_get_stats (g_sub_gv->rxfilter, &st1);
+  } while (st1.dropped < st0.dropped + 10 && dds_time () < tend);
+  CU_ASSERT (st1.dropped >= st0.dropped + 10);
+  CU_ASSERT (st1.accepted == st0.accepted);
+  CU_ASSERT (proxypp_lease_renewed_since (tstart));
+  {
+    Space_Type1 s;
+    void *ptr = &s;
+    dds_sample_info_t si;
+    CU_ASSERT (dds_take (g_reader, &ptr, &si, 1, 1) == 0);
+  }
+
+  set_filtered (false);
+  CU_ASSERT (write_and_take (10, DDS_SECS (5)) == 10);
+}
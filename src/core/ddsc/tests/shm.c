@@ -0,0 +1,194 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsi/ddsi_shm.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_PUB 0
+#define DDS_DOMAINID_SUB 1
+#define DDS_CONFIG_SHM "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<General><EnableSharedMemory>true</EnableSharedMemory></General><Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+
+/* Fixed ports, so that a process can create the segments a crashed one left
+   behind: a domain id that is unlikely to be used by other tests */
+#define SHM_STALE_DOMAINID 37
+#define DDS_CONFIG_SHM_FIXED "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<General><EnableSharedMemory>true</EnableSharedMemory></General><Discovery><ParticipantIndex>0</ParticipantIndex></Discovery>"
+
+static struct ddsi_domaingv *get_gv (dds_entity_t pp)
+{
+  struct dds_entity *x;
+  struct ddsi_domaingv *gv;
+  CU_ASSERT_FATAL (dds_entity_pin (pp, &x) == DDS_RETCODE_OK);
+  gv = &x->m_domain->gv;
+  dds_entity_unpin (x);
+  return gv;
+}
+
+static bool wait_for_reachable (const struct ddsi_domaingv *gv, const nn_locator_t *loc, bool reachable)
+{
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  while (ddsi_shm_peer_reachable (gv, loc) != reachable && dds_time () < tend)
+    dds_sleepfor (DDS_MSECS (10));
+  return ddsi_shm_peer_reachable (gv, loc) == reachable;
+}
+
+static bool segment_exists (uint32_t domain_id, uint32_t port)
+{
+  char name[64];
+  int fd;
+  CU_ASSERT_FATAL (ddsi_shm_segment_name (name, sizeof (name), domain_id, port));
+  if ((fd = shm_open (name, O_RDONLY, 0)) < 0)
+    return false;
+  close (fd);
+  return true;
+}
+
+CU_Test(ddsc_shm, loopback)
+{
+  char topic_name[100];
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_SHM, DDS_DOMAINID_PUB);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_SHM, DDS_DOMAINID_SUB);
+  const dds_entity_t pub_dom = dds_create_domain (DDS_DOMAINID_PUB, conf_pub);
+  CU_ASSERT_FATAL (pub_dom > 0);
+  const dds_entity_t sub_dom = dds_create_domain (DDS_DOMAINID_SUB, conf_sub);
+  CU_ASSERT_FATAL (sub_dom > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+  struct ddsi_domaingv * const pub_gv = get_gv (pub_pp);
+  struct ddsi_domaingv * const sub_gv = get_gv (sub_pp);
+  if (pub_gv->shm_xmit_conn == NULL || sub_gv->shm_disc_conn == NULL)
+  {
+    /* e.g., /dev/shm not available */
+    printf ("ddsc_shm_loopback: shared memory not available, skipping\n");
+    dds_delete (sub_dom);
+    dds_delete (pub_dom);
+    return;
+  }
+
+  /* the peer is registered once its SPDP message has been received */
+  CU_ASSERT_FATAL (wait_for_reachable (pub_gv, &sub_gv->loc_default_uc, true));
+
+  create_unique_topic_name ("ddsc_shm_loopback", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, 10);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  for (int32_t i = 0; i < 10; i++)
+  {
+    Space_Type1 s = { i, i, i };
+    CU_ASSERT_FATAL (dds_write (wr, &s) == DDS_RETCODE_OK);
+  }
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+
+  int32_t count = 0;
+  const dds_time_t tend = dds_time () + DDS_SECS (5);
+  while (count < 10 && dds_time () < tend)
+  {
+    Space_Type1 s;
+    void *ptr = &s;
+    dds_sample_info_t si;
+    if (dds_take (rd, &ptr, &si, 1, 1) == 1)
+    {
+      CU_ASSERT (si.valid_data && s.long_1 == count);
+      count++;
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (10));
+    }
+  }
+  CU_ASSERT (count == 10);
+
+  /* deleting the subscribing domain makes the publishing one delete the proxy
+     participant, and so the peer */
+  nn_locator_t sub_loc = sub_gv->loc_default_uc;
+  dds_delete (sub_dom);
+  CU_ASSERT (wait_for_reachable (pub_gv, &sub_loc, false));
+  dds_delete (pub_dom);
+}
+
+CU_Test(ddsc_shm, stale_segment)
+{
+  /* a process that gets killed leaves its segments behind, a new process
+     using the same ports must replace them */
+  char *conf = ddsrt_expand_envvars (DDS_CONFIG_SHM_FIXED, SHM_STALE_DOMAINID);
+  uint32_t ports[2];
+  char name[64];
+  int status, fds[2];
+  pid_t pid;
+
+  if (!ddsi_shm_segment_name (name, sizeof (name), SHM_STALE_DOMAINID, 0))
+  {
+    printf ("ddsc_shm_stale_segment: shared memory not available, skipping\n");
+    dds_free (conf);
+    return;
+  }
+  CU_ASSERT_FATAL (pipe (fds) == 0);
+  CU_ASSERT_FATAL ((pid = fork ()) >= 0);
+  if (pid == 0)
+  {
+    const dds_entity_t dom = dds_create_domain (SHM_STALE_DOMAINID, conf);
+    const dds_entity_t pp = dds_create_participant (SHM_STALE_DOMAINID, NULL, NULL);
+    struct ddsi_domaingv *gv;
+    if (dom > 0 && pp > 0 && (gv = get_gv (pp))->shm_disc_conn != NULL && gv->shm_data_conn != NULL)
+    {
+      ports[0] = gv->loc_meta_uc.port;
+      ports[1] = gv->loc_default_uc.port;
+      if (write (fds[1], ports, sizeof (ports)) == (ssize_t) sizeof (ports))
+        raise (SIGKILL);
+    }
+    _exit (1);
+  }
+  close (fds[1]);
+  CU_ASSERT_FATAL (read (fds[0], ports, sizeof (ports)) == (ssize_t) sizeof (ports));
+  close (fds[0]);
+  CU_ASSERT_FATAL (waitpid (pid, &status, 0) == pid);
+  CU_ASSERT_FATAL (WIFSIGNALED (status) && WTERMSIG (status) == SIGKILL);
+  for (size_t i = 0; i < sizeof (ports) / sizeof (ports[0]); i++)
+    CU_ASSERT_FATAL (segment_exists (SHM_STALE_DOMAINID, ports[i]));
+
+  const dds_entity_t dom = dds_create_domain (SHM_STALE_DOMAINID, conf);
+  CU_ASSERT_FATAL (dom > 0);
+  dds_free (conf);
+  const dds_entity_t pp = dds_create_participant (SHM_STALE_DOMAINID, NULL, NULL);
+  CU_ASSERT_FATAL (pp > 0);
+  struct ddsi_domaingv * const gv = get_gv (pp);
+  CU_ASSERT_FATAL (gv->loc_meta_uc.port == ports[0] && gv->loc_default_uc.port == ports[1]);
+  CU_ASSERT (gv->shm_disc_conn != NULL);
+  CU_ASSERT (gv->shm_data_conn != NULL);
+  dds_delete (dom);
+  for (size_t i = 0; i < sizeof (ports) / sizeof (ports[0]); i++)
+    CU_ASSERT (!segment_exists (SHM_STALE_DOMAINID, ports[i]));
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_receive.h"
+#include "dds/ddsi/q_sockwaitset.h"
+#include "dds__entity.h"
+
+#include "test_common.h"
+
+#define DDS_DOMAINID_SUB 0
+#define DDS_DOMAINID_PUB 1
+
+/* The subscribing side accepts connections on a dynamically allocated port, the
+   publishing side doesn't accept any and connects to it */
+#define DDS_CONFIG_TCP_SUB "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<General><Transport>tcp</Transport></General><TCP><Port>0</Port></TCP><Discovery><ExternalDomainId>0</ExternalDomainId></Discovery>"
+#define DDS_CONFIG_TCP_PUB "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<General><Transport>tcp</Transport></General><TCP><Port>-1</Port></TCP><Discovery><ExternalDomainId>0</ExternalDomainId><Peers><Peer address=\"127.0.0.1:%u\"/></Peers></Discovery>"
+
+#define NSAMPLES 100
+
+static struct ddsi_domaingv *get_gv (dds_entity_t pp)
+{
+  struct dds_entity *x;
+  struct ddsi_domaingv *gv;
+  CU_ASSERT_FATAL (dds_entity_pin (pp, &x) == DDS_RETCODE_OK);
+  gv = &x->m_domain->gv;
+  dds_entity_unpin (x);
+  return gv;
+}
+
+CU_Test(ddsc_tcp, recv_thread_waitset)
+{
+  /* only the fields looked at matter, and the waitset is never dereferenced */
+  struct ddsi_domaingv *gv = ddsrt_calloc (1, sizeof (*gv));
+  char dummy;
+  os_sockWaitset ws = (os_sockWaitset) &dummy;
+
+  gv->n_recv_threads = 0;
+  CU_ASSERT (recv_thread_waitset (gv) == NULL);
+
+  gv->n_recv_threads = 1;
+  gv->recv_threads[0].arg.mode = RTM_SINGLE;
+  CU_ASSERT (recv_thread_waitset (gv) == NULL);
+
+  gv->n_recv_threads = 3;
+  gv->recv_threads[1].arg.mode = RTM_MANY;
+  gv->recv_threads[1].arg.u.many.ws = ws;
+  gv->recv_threads[2].arg.mode = RTM_SINGLE;
+  CU_ASSERT (recv_thread_waitset (gv) == ws);
+
+  gv->recv_threads[0].arg.mode = RTM_MANY;
+  gv->recv_threads[0].arg.u.many.ws = NULL;
+  CU_ASSERT (recv_thread_waitset (gv) == ws);
+
+  ddsrt_free (gv);
+}
+
+CU_Test(ddsc_tcp, pubsub)
+{
+  char topic_name[100];
+  char *conf_raw, *conf;
+
+  conf = ddsrt_expand_envvars (DDS_CONFIG_TCP_SUB, DDS_DOMAINID_SUB);
+  const dds_entity_t sub_dom = dds_create_domain (DDS_DOMAINID_SUB, conf);
+  CU_ASSERT_FATAL (sub_dom > 0);
+  dds_free (conf);
+  const dds_entity_t sub_pp = dds_create_participant (DDS_DOMAINID_SUB, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+  struct ddsi_domaingv * const sub_gv = get_gv (sub_pp);
+  CU_ASSERT_FATAL (recv_thread_waitset (sub_gv) != NULL);
+
+  (void) ddsrt_asprintf (&conf_raw, DDS_CONFIG_TCP_PUB, sub_gv->loc_meta_uc.port);
+  conf = ddsrt_expand_envvars (conf_raw, DDS_DOMAINID_PUB);
+  const dds_entity_t pub_dom = dds_create_domain (DDS_DOMAINID_PUB, conf);
+  CU_ASSERT_FATAL (pub_dom > 0);
+  dds_free (conf);
+  dds_free (conf_raw);
+  const dds_entity_t pub_pp = dds_create_participant (DDS_DOMAINID_PUB, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  CU_ASSERT_FATAL (recv_thread_waitset (get_gv (pub_pp)) != NULL);
+
+  create_unique_topic_name ("ddsc_tcp", topic_name, sizeof (topic_name));
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &Space_Type1_desc, topic_name, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+
+  /* discovery in both directions requires both the connection made by the
+     publishing side and the one accepted by the subscribing side to be serviced
+     by the receive threads */
+  dds_publication_matched_status_t pm;
+  dds_time_t tend = dds_time () + DDS_SECS (10);
+  do {
+    dds_sleepfor (DDS_MSECS (10));
+    CU_ASSERT_FATAL (dds_get_publication_matched_status (wr, &pm) == DDS_RETCODE_OK);
+  } while (pm.current_count == 0 && dds_time () < tend);
+  CU_ASSERT_FATAL (pm.current_count == 1);
+
+  for (int32_t i = 0; i < NSAMPLES; i++)
+  {
+    Space_Type1 s = { i, i, i };
+    CU_ASSERT_FATAL (dds_write (wr, &s) == DDS_RETCODE_OK);
+  }
+  int32_t count = 0;
+  tend = dds_time () + DDS_SECS (10);
+  while (count < NSAMPLES && dds_time () < tend)
+  {
+    Space_Type1 s;
+    void *ptr = &s;
+    dds_sample_info_t si;
+    if (dds_take (rd, &ptr, &si, 1, 1) == 1)
+    {
+      CU_ASSERT (si.valid_data && s.long_1 == count);
+      count++;
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  CU_ASSERT (count == NSAMPLES);
+  dds_delete (pub_dom);
+  dds_delete (sub_dom);
+}
@@ -10,9 +10,11 @@
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
 #include <stdio.h>
+#include <string.h>
 #include "dds/dds.h"
-#include "Space.h"
-#include "CUnit/Test.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/environ.h"
+#include "test_common.h"
 
 #define MAX_SAMPLES  (7)
 CU_Test(ddsc_transient_local, late_joiner)
@@ -95,3 +97,96 @@ CU_Test(ddsc_transient_local, late_joiner)
     dds_delete(par);
     dds_delete_qos(qos);
 }
+
+/* A late-joining reader in another domain must receive the full history, and
+   in order, when the writer streams it (Internal/HistoricalDataStreaming) rather
+   than the reader requesting it in response to a heartbeat: the history is far
+   larger than what a single burst of the stream covers.  The reader would also
+   get it all without streaming, the writer's trace shows that it was streamed */
+#define HISTORY_NSAMPLES 1000
+#define DDS_CONFIG_HISTORY_STREAMING "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><Internal><HistoricalDataStreaming>4 kB</HistoricalDataStreaming></Internal>"
+#define DDS_CONFIG_HISTORY_STREAMING_TRACE DDS_CONFIG_HISTORY_STREAMING "<Tracing><Category>trace</Category><OutputFile>stderr</OutputFile></Tracing>"
+
+static ddsrt_atomic_uint32_t history_bursts, history_done;
+
+static void history_tracesink (void *arg, const dds_log_data_t *msg)
+{
+  (void) arg;
+  if (strstr (msg->message, "writer_history_push:") != NULL)
+  {
+    ddsrt_atomic_inc32 (&history_bursts);
+    if (strstr (msg->message, "(done)") != NULL)
+      ddsrt_atomic_inc32 (&history_done);
+  }
+}
+
+CU_Test(ddsc_transient_local, history_streaming)
+{
+  char topicname[100];
+  ddsrt_atomic_st32 (&history_bursts, 0);
+  ddsrt_atomic_st32 (&history_done, 0);
+  dds_set_trace_sink (history_tracesink, NULL);
+  char *conf_pub = ddsrt_expand_envvars (DDS_CONFIG_HISTORY_STREAMING_TRACE, 0);
+  char *conf_sub = ddsrt_expand_envvars (DDS_CONFIG_HISTORY_STREAMING, 1);
+  const dds_entity_t pub_dom = dds_create_domain (0, conf_pub);
+  CU_ASSERT_FATAL (pub_dom > 0);
+  const dds_entity_t sub_dom = dds_create_domain (1, conf_sub);
+  CU_ASSERT_FATAL (sub_dom > 0);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  const dds_entity_t pub_pp = dds_create_participant (0, NULL, NULL);
+  CU_ASSERT_FATAL (pub_pp > 0);
+  const dds_entity_t sub_pp = dds_create_participant (1, NULL, NULL);
+  CU_ASSERT_FATAL (sub_pp > 0);
+
+  /* a single instance, so that the order of the samples is defined */
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_ALL, 0);
+  create_unique_topic_name ("ddsc_transient_local_history", topicname, sizeof (topicname));
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &Space_Type1_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (pub_tp > 0);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &Space_Type1_desc, topicname, qos, NULL);
+  CU_ASSERT_FATAL (sub_tp > 0);
+  dds_qos_t *wrqos = dds_create_qos ();
+  dds_copy_qos (wrqos, qos);
+  dds_qset_history (wrqos, DDS_HISTORY_KEEP_LAST, HISTORY_NSAMPLES);
+  dds_qset_durability_service (wrqos, 0, DDS_HISTORY_KEEP_LAST, HISTORY_NSAMPLES, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED, DDS_LENGTH_UNLIMITED);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, wrqos, NULL);
+  CU_ASSERT_FATAL (wr > 0);
+  dds_delete_qos (wrqos);
+  for (int32_t i = 0; i < HISTORY_NSAMPLES; i++)
+  {
+    Space_Type1 sample = { 0, i, 0 };
+    CU_ASSERT_FATAL (dds_write (wr, &sample) == DDS_RETCODE_OK);
+  }
+
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  CU_ASSERT_FATAL (rd > 0);
+  dds_delete_qos (qos);
+  const dds_time_t tend = dds_time () + DDS_SECS (10);
+  int32_t count = 0;
+  while (count < HISTORY_NSAMPLES && dds_time () < tend)
+  {
+    Space_Type1 s;
+    void *ptr = &s;
+    dds_sample_info_t si;
+    if (dds_take (rd, &ptr, &si, 1, 1) == 1)
+    {
+      CU_ASSERT (si.valid_data && s.long_2 == count);
+      count++;
+    }
+    else
+    {
+      dds_sleepfor (DDS_MSECS (1));
+    }
+  }
+  CU_ASSERT (count == HISTORY_NSAMPLES);
+  dds_delete (sub_dom);
+  dds_delete (pub_dom);
+  dds_set_trace_sink (NULL, NULL);
+  /* streamed in several bursts, and completely */
+  CU_ASSERT (ddsrt_atomic_ld32 (&history_bursts) > 1);
+  CU_ASSERT (ddsrt_atomic_ld32 (&history_done) == 1);
+}
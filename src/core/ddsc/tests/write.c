@@ -158,3 +158,68 @@ CU_Test(ddsc_write, simpletypes)
     dds_delete(top);
     dds_delete(par);
 }
+
+static uint32_t pinned_released;
+
+static void pinned_release(void *arg)
+{
+    uint32_t *count = arg;
+    (*count)++;
+}
+
+CU_Test(ddsc_write_pinned, basic, .init = setup, .fini = teardown)
+{
+    const uint32_t size = 100000;
+    dds_entity_t reader;
+    dds_return_t status;
+    RoundTripModule_DataType pinned;
+    void *raw = NULL;
+    dds_sample_info_t si;
+
+    reader = dds_create_reader(participant, topic, NULL, NULL);
+    CU_ASSERT_FATAL(reader > 0);
+
+    /* large enough to be referenced rather than copied; written twice so the
+       history of the writer no longer references the first one */
+    memset(&pinned, 0, sizeof(pinned));
+    pinned.payload._length = size;
+    pinned.payload._buffer = dds_alloc(size);
+    for (uint32_t i = 0; i < size; i++)
+        pinned.payload._buffer[i] = (uint8_t) i;
+    pinned_released = 0;
+    status = dds_write_pinned(writer, &pinned, pinned_release, &pinned_released);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_take(reader, &raw, &si, 1, 1);
+    CU_ASSERT_EQUAL_FATAL(status, 1);
+    const RoundTripModule_DataType *rdata = raw;
+    CU_ASSERT_EQUAL_FATAL(rdata->payload._length, size);
+    CU_ASSERT_FATAL(memcmp(rdata->payload._buffer, pinned.payload._buffer, size) == 0);
+    status = dds_return_loan(reader, &raw, 1);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+
+    status = dds_write(writer, &data);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    status = dds_delete(reader);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_OK);
+    CU_ASSERT_EQUAL(pinned_released, 1);
+    dds_free(pinned.payload._buffer);
+}
+
+CU_Test(ddsc_write_pinned, bad_parameters, .init = setup, .fini = teardown)
+{
+    dds_return_t status;
+
+    status = dds_write_pinned(writer, &data, 0, NULL);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+
+    /* release must be called on failure as well */
+    pinned_released = 0;
+    DDSRT_WARNING_MSVC_OFF(6387);
+    status = dds_write_pinned(writer, NULL, pinned_release, &pinned_released);
+    DDSRT_WARNING_MSVC_ON(6387);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_BAD_PARAMETER);
+    CU_ASSERT_EQUAL(pinned_released, 1);
+    status = dds_write_pinned(publisher, &data, pinned_release, &pinned_released);
+    CU_ASSERT_EQUAL_FATAL(status, DDS_RETCODE_ILLEGAL_OPERATION);
+    CU_ASSERT_EQUAL(pinned_released, 2);
+}
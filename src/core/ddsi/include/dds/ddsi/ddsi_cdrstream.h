@@ -12,6 +12,11 @@
 #ifndef DDSI_CDRSTREAM_H
 #define DDSI_CDRSTREAM_H
 
+#include <string.h>
+#include <assert.h>
+
+#include "dds/export.h"
+#include "dds/ddsrt/bswap.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
 
@@ -19,16 +24,22 @@
 extern "C" {
 #endif
 
+/* CDR stream primitives shared by the interpreter for the marshalling ops and
+   the type-specific (de)serializers that idlc generates with -specialize, so
+   that both produce the same representation. */
 typedef struct dds_istream {
   const unsigned char *m_buffer;
   uint32_t m_size;      /* Buffer size */
   uint32_t m_index;     /* Read/write offset from start of buffer */
 } dds_istream_t;
 
+struct dds_ostream_refs;
+
 typedef struct dds_ostream {
   unsigned char *m_buffer;
   uint32_t m_size;      /* Buffer size */
   uint32_t m_index;     /* Read/write offset from start of buffer */
+  struct dds_ostream_refs *m_refs; /* Large sequences referenced rather than copied (or NULL) */
 } dds_ostream_t;
 
 typedef struct dds_ostreamBE {
@@ -39,6 +50,232 @@ DDS_EXPORT void dds_ostream_init (dds_ostream_t * __restrict st, uint32_t size);
 DDS_EXPORT void dds_ostream_fini (dds_ostream_t * __restrict st);
 DDS_EXPORT void dds_ostreamBE_init (dds_ostreamBE_t * __restrict st, uint32_t size);
 DDS_EXPORT void dds_ostreamBE_fini (dds_ostreamBE_t * __restrict st);
+DDS_EXPORT void dds_ostream_grow (dds_ostream_t * __restrict st, uint32_t size);
+
+DDS_EXPORT inline void dds_cdr_resize (dds_ostream_t * __restrict s, uint32_t l)
+{
+  if (s->m_size < l + s->m_index)
+    dds_ostream_grow (s, l);
+}
+
+DDS_EXPORT inline void dds_cdr_alignto (dds_istream_t * __restrict s, uint32_t a)
+{
+  s->m_index = (s->m_index + a - 1) & ~(a - 1);
+  assert (s->m_index < s->m_size);
+}
+
+DDS_EXPORT inline uint32_t dds_cdr_alignto_clear_and_resize (dds_ostream_t * __restrict s, uint32_t a, uint32_t extra)
+{
+  const uint32_t m = s->m_index % a;
+  if (m == 0)
+  {
+    dds_cdr_resize (s, extra);
+    return 0;
+  }
+  else
+  {
+    const uint32_t pad = a - m;
+    dds_cdr_resize (s, pad + extra);
+    for (uint32_t i = 0; i < pad; i++)
+      s->m_buffer[s->m_index++] = 0;
+    return pad;
+  }
+}
+
+DDS_EXPORT inline uint8_t dds_is_get1 (dds_istream_t * __restrict s)
+{
+  assert (s->m_index < s->m_size);
+  uint8_t v = *(s->m_buffer + s->m_index);
+  s->m_index++;
+  return v;
+}
+
+DDS_EXPORT inline uint16_t dds_is_get2 (dds_istream_t * __restrict s)
+{
+  dds_cdr_alignto (s, 2);
+  uint16_t v = * ((uint16_t *) (s->m_buffer + s->m_index));
+  s->m_index += 2;
+  return v;
+}
+
+DDS_EXPORT inline uint32_t dds_is_get4 (dds_istream_t * __restrict s)
+{
+  dds_cdr_alignto (s, 4);
+  uint32_t v = * ((uint32_t *) (s->m_buffer + s->m_index));
+  s->m_index += 4;
+  return v;
+}
+
+DDS_EXPORT inline uint64_t dds_is_get8 (dds_istream_t * __restrict s)
+{
+  dds_cdr_alignto (s, 8);
+  uint64_t v = * ((uint64_t *) (s->m_buffer + s->m_index));
+  s->m_index += 8;
+  return v;
+}
+
+DDS_EXPORT inline void dds_is_get_bytes (dds_istream_t * __restrict s, void * __restrict b, uint32_t num, uint32_t elem_size)
+{
+  dds_cdr_alignto (s, elem_size);
+  memcpy (b, s->m_buffer + s->m_index, num * elem_size);
+  s->m_index += num * elem_size;
+}
+
+DDS_EXPORT inline void dds_is_skip (dds_istream_t * __restrict s, uint32_t num, uint32_t elem_size)
+{
+  dds_cdr_alignto (s, elem_size);
+  s->m_index += num * elem_size;
+}
+
+DDS_EXPORT inline void dds_os_put1 (dds_ostream_t * __restrict s, uint8_t v)
+{
+  dds_cdr_resize (s, 1);
+  *((uint8_t *) (s->m_buffer + s->m_index)) = v;
+  s->m_index += 1;
+}
+
+DDS_EXPORT inline void dds_os_put2 (dds_ostream_t * __restrict s, uint16_t v)
+{
+  dds_cdr_alignto_clear_and_resize (s, 2, 2);
+  *((uint16_t *) (s->m_buffer + s->m_index)) = v;
+  s->m_index += 2;
+}
+
+DDS_EXPORT inline void dds_os_put4 (dds_ostream_t * __restrict s, uint32_t v)
+{
+  dds_cdr_alignto_clear_and_resize (s, 4, 4);
+  *((uint32_t *) (s->m_buffer + s->m_index)) = v;
+  s->m_index += 4;
+}
+
+DDS_EXPORT inline void dds_os_put8 (dds_ostream_t * __restrict s, uint64_t v)
+{
+  dds_cdr_alignto_clear_and_resize (s, 8, 8);
+  *((uint64_t *) (s->m_buffer + s->m_index)) = v;
+  s->m_index += 8;
+}
+
+DDS_EXPORT inline void dds_os_put_bytes (dds_ostream_t * __restrict s, const void * __restrict b, uint32_t l)
+{
+  dds_cdr_resize (s, l);
+  memcpy (s->m_buffer + s->m_index, b, l);
+  s->m_index += l;
+}
+
+DDS_EXPORT inline void dds_os_put_bytes_aligned (dds_ostream_t * __restrict s, const void * __restrict b, uint32_t n, uint32_t a)
+{
+  const uint32_t l = n * a;
+  dds_cdr_alignto_clear_and_resize (s, a, l);
+  memcpy (s->m_buffer + s->m_index, b, l);
+  s->m_index += l;
+}
+
+/* Generated code accesses fields of any primitive type (including enums,
+   floating-point types and booleans) through these, transferring the bits
+   without interpretation, exactly like the interpreter */
+DDS_EXPORT inline void dds_os_put1p (dds_ostream_t * __restrict s, const void * __restrict p) { uint8_t v; memcpy (&v, p, 1); dds_os_put1 (s, v); }
+DDS_EXPORT inline void dds_os_put2p (dds_ostream_t * __restrict s, const void * __restrict p) { uint16_t v; memcpy (&v, p, 2); dds_os_put2 (s, v); }
+DDS_EXPORT inline void dds_os_put4p (dds_ostream_t * __restrict s, const void * __restrict p) { uint32_t v; memcpy (&v, p, 4); dds_os_put4 (s, v); }
+DDS_EXPORT inline void dds_os_put8p (dds_ostream_t * __restrict s, const void * __restrict p) { uint64_t v; memcpy (&v, p, 8); dds_os_put8 (s, v); }
+DDS_EXPORT inline void dds_is_get1p (dds_istream_t * __restrict s, void * __restrict p) { const uint8_t v = dds_is_get1 (s); memcpy (p, &v, 1); }
+DDS_EXPORT inline void dds_is_get2p (dds_istream_t * __restrict s, void * __restrict p) { const uint16_t v = dds_is_get2 (s); memcpy (p, &v, 2); }
+DDS_EXPORT inline void dds_is_get4p (dds_istream_t * __restrict s, void * __restrict p) { const uint32_t v = dds_is_get4 (s); memcpy (p, &v, 4); }
+DDS_EXPORT inline void dds_is_get8p (dds_istream_t * __restrict s, void * __restrict p) { const uint64_t v = dds_is_get8 (s); memcpy (p, &v, 8); }
+
+/* Normalization: validates the CDR representation in data[*off .. size)
+   while converting it in-place to native endianness, advancing *off */
+DDS_EXPORT inline uint32_t dds_cdr_check_align_prim (uint32_t off, uint32_t size, uint32_t a_lg2)
+{
+  assert (a_lg2 <= 3);
+  const uint32_t a = 1u << a_lg2;
+  assert (off <= size);
+  const uint32_t off1 = (off + a - 1) & ~(a - 1);
+  assert (off <= off1);
+  if (size < off1 + a)
+    return UINT32_MAX;
+  return off1;
+}
+
+DDS_EXPORT inline bool dds_stream_normalize_uint8 (uint32_t * __restrict off, uint32_t size)
+{
+  if (*off == size)
+    return false;
+  (*off)++;
+  return true;
+}
+
+DDS_EXPORT inline bool dds_stream_normalize_uint16 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)
+{
+  if ((*off = dds_cdr_check_align_prim (*off, size, 1)) == UINT32_MAX)
+    return false;
+  if (bswap)
+    *((uint16_t *) (data + *off)) = ddsrt_bswap2u (*((uint16_t *) (data + *off)));
+  (*off) += 2;
+  return true;
+}
+
+DDS_EXPORT inline bool dds_stream_normalize_uint32 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)
+{
+  if ((*off = dds_cdr_check_align_prim (*off, size, 2)) == UINT32_MAX)
+    return false;
+  if (bswap)
+    *((uint32_t *) (data + *off)) = ddsrt_bswap4u (*((uint32_t *) (data + *off)));
+  (*off) += 4;
+  return true;
+}
+
+DDS_EXPORT inline bool dds_stream_normalize_uint64 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)
+{
+  if ((*off = dds_cdr_check_align_prim (*off, size, 3)) == UINT32_MAX)
+    return false;
+  if (bswap)
+    *((uint64_t *) (data + *off)) = ddsrt_bswap8u (*((uint64_t *) (data + *off)));
+  (*off) += 8;
+  return true;
+}
+
+/* Strings and sequences of primitive types; elem_size is 1, 2, 4 or 8 */
+DDS_EXPORT void dds_stream_write_string (dds_ostream_t * __restrict os, const char * __restrict val);
+DDS_EXPORT char *dds_stream_reuse_string (dds_istream_t * __restrict is, char * __restrict str);
+DDS_EXPORT void dds_stream_reuse_string_bound (dds_istream_t * __restrict is, char * __restrict str, const uint32_t bound);
+DDS_EXPORT void dds_stream_skip_string (dds_istream_t * __restrict is);
+DDS_EXPORT void dds_stream_extract_string (dds_istream_t * __restrict is, dds_ostream_t * __restrict os);
+DDS_EXPORT void dds_stream_write_primseq (dds_ostream_t * __restrict os, const dds_sequence_t * __restrict seq, uint32_t elem_size);
+DDS_EXPORT void dds_stream_read_primseq (dds_istream_t * __restrict is, dds_sequence_t * __restrict seq, uint32_t elem_size);
+DDS_EXPORT void dds_stream_skip_primseq (dds_istream_t * __restrict is, uint32_t elem_size);
+DDS_EXPORT bool dds_stream_normalize_string (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, size_t maxsz);
+DDS_EXPORT bool dds_stream_normalize_primarray (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, uint32_t num, uint32_t elem_size);
+DDS_EXPORT bool dds_stream_normalize_primseq (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, uint32_t elem_size);
+
+/* Type-specific (de)serializers, optionally generated by idlc (-specialize)
+   using the primitives above.  These must be equivalent to interpreting the
+   marshalling ops, which are used for anything not provided here.  The
+   topic descriptor refers to them if DDS_TOPIC_CDR_OPS is set, and
+   dds_create_topic copies them to ddsi_sertopic_default_desc::m_cdr_ops. */
+typedef struct dds_topic_cdr_ops {
+  void (*m_write) (dds_ostream_t * __restrict os, const void * __restrict sample);
+  void (*m_read) (dds_istream_t * __restrict is, void * __restrict sample);
+  bool (*m_normalize) (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap);
+  void (*m_extract_key) (dds_istream_t * __restrict is, dds_ostream_t * __restrict os);
+} dds_topic_cdr_ops_t;
+
+/* A stream with m_refs set doesn't copy the contents of sequences of primitive
+   types of at least m_threshold bytes, but records their address and the
+   position in the stream where they should have been.  The number of bytes
+   referenced is always a multiple of 8 (any remainder is copied), so that
+   alignment in the stream is the same as if they had been copied. */
+struct dds_ostream_ref {
+  uint32_t m_index;     /* Offset from start of buffer where referenced bytes belong */
+  uint32_t m_size;      /* Number of bytes referenced, multiple of 8 */
+  const void *m_ptr;
+};
+
+struct dds_ostream_refs {
+  uint32_t m_threshold;
+  uint32_t m_count;
+  uint32_t m_max;
+  struct dds_ostream_ref *m_refs;
+};
 
 bool dds_stream_normalize (void * __restrict data, uint32_t size, bool bswap, const struct ddsi_sertopic_default * __restrict topic, bool just_key);
 
@@ -12,9 +12,9 @@
 #ifndef DDSI_DEADLINE_H
 #define DDSI_DEADLINE_H
 
-#include "dds/ddsrt/circlist.h"
 #include "dds/ddsrt/time.h"
 #include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_expiry.h"
 #include "dds/ddsi/q_xevent.h"
 
 #if defined (__cplusplus)
@@ -24,23 +24,23 @@ extern "C" {
 typedef ddsrt_mtime_t (*deadline_missed_cb_t)(void *hc, ddsrt_mtime_t tnow);
 
 struct deadline_adm {
-  struct ddsrt_circlist list;               /* linked list for deadline missed */
-  struct xevent *evt;                       /* xevent that triggers when deadline expires for an instance */
+  struct expiry_adm exp;                    /* time-bucketed administration for deadline missed */
+  struct xevent *evt;                       /* xevent that triggers when the first bucket of deadlines expires */
   deadline_missed_cb_t deadline_missed_cb;  /* callback for deadline missed; this cb can use deadline_next_missed_locked to get next instance that has a missed deadline */
-  size_t list_offset;                       /* offset of deadline_adm element in whc or rhc */
+  size_t adm_offset;                        /* offset of deadline_adm element in whc or rhc */
   size_t elem_offset;                       /* offset of deadline_elem element in whc or rhc instance */
   dds_duration_t dur;                       /* deadline duration */
 };
 
 struct deadline_elem {
-  struct ddsrt_circlist_elem e;
+  struct expiry_node e;
   ddsrt_mtime_t t_deadline;
 };
 
-DDS_EXPORT void deadline_init (const struct ddsi_domaingv *gv, struct deadline_adm *deadline_adm, size_t list_offset, size_t elem_offset, deadline_missed_cb_t deadline_missed_cb);
+DDS_EXPORT void deadline_init (const struct ddsi_domaingv *gv, struct deadline_adm *deadline_adm, size_t adm_offset, size_t elem_offset, deadline_missed_cb_t deadline_missed_cb);
 DDS_EXPORT void deadline_stop (const struct deadline_adm *deadline_adm);
 DDS_EXPORT void deadline_clear (struct deadline_adm *deadline_adm);
-DDS_EXPORT void deadline_fini (const struct deadline_adm *deadline_adm);
+DDS_EXPORT void deadline_fini (struct deadline_adm *deadline_adm);
 DDS_EXPORT ddsrt_mtime_t deadline_next_missed_locked (struct deadline_adm *deadline_adm, ddsrt_mtime_t tnow, void **instance);
 DDS_EXPORT void deadline_register_instance_real (struct deadline_adm *deadline_adm, struct deadline_elem *elem, ddsrt_mtime_t tprev, ddsrt_mtime_t tnow);
 DDS_EXPORT void deadline_unregister_instance_real (struct deadline_adm *deadline_adm, struct deadline_elem *elem);
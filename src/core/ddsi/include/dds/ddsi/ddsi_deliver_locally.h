@@ -55,6 +55,10 @@ dds_return_t deliver_locally_one (struct ddsi_domaingv *gv, struct entity_common
 
 dds_return_t deliver_locally_allinsync (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, struct local_reader_ary *fastpath_rdary, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops, void *vsourceinfo);
 
+/* Commits the coherent set identified by wrinfo->coherent_set_seq in the reader with
+   GUID rdguid or, if rdguid is NULL, in all in-sync readers; ops->makesample is not used */
+void deliver_locally_commit (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, const ddsi_guid_t *rdguid, struct local_reader_ary *fastpath_rdary, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -0,0 +1,56 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_DISCOVERY_CACHE_H
+#define DDSI_DISCOVERY_CACHE_H
+
+#include "dds/ddsi/ddsi_guid.h"
+#include "dds/ddsi/q_rtps.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+struct receiver_state;
+struct ddsi_discovery_cache;
+
+/* The discovery cache retains the most recent SPDP and SEDP payloads of all proxy
+   participants, proxy writers and proxy readers and periodically writes them to a
+   file.  On start-up, the contents of that file are replayed through the regular
+   discovery code, so that proxies (and therefore matches) exist right away.  Entries
+   loaded this way are tentative: those not confirmed by live discovery data within
+   Discovery/Cache/ConfirmTimeout are deleted again, exactly as if their lease had
+   expired.
+
+   Returns NULL if no cache file has been configured. */
+struct ddsi_discovery_cache *ddsi_discovery_cache_new (struct ddsi_domaingv *gv);
+void ddsi_discovery_cache_free (struct ddsi_discovery_cache *dc);
+
+/* Replays the cache file and schedules periodic writing of the cache; must be called
+   before the receive threads are started. */
+void ddsi_discovery_cache_start (struct ddsi_discovery_cache *dc);
+
+/* Writes the final state to the file and stops the periodic writing; must be called
+   before the proxies get deleted during shutdown. */
+void ddsi_discovery_cache_stop (struct ddsi_discovery_cache *dc);
+
+/* Records (or confirms) the discovery payload for a proxy entity after it has been
+   processed successfully; payload includes the 4-byte CDR encapsulation header */
+void ddsi_discovery_cache_update (struct ddsi_discovery_cache *dc, const ddsi_guid_t *guid, const struct receiver_state *rst, seqno_t seq, const void *payload, uint32_t size);
+
+void ddsi_discovery_cache_remove (struct ddsi_discovery_cache *dc, const ddsi_guid_t *guid);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_DISCOVERY_CACHE_H */
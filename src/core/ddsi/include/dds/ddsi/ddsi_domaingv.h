@@ -39,12 +39,15 @@ struct addrset;
 struct xeventq;
 struct gcreq_queue;
 struct entity_index;
+struct ddsi_rxfilter;
 struct lease;
 struct ddsi_tran_conn;
 struct ddsi_tran_listener;
 struct ddsi_tran_factory;
 struct ddsrt_thread_pool_s;
 struct debug_monitor;
+struct ddsi_discovery_cache;
+struct ddsi_partition_match_cache;
 struct ddsi_tkmap;
 
 typedef struct config_in_addr_node {
@@ -73,6 +76,9 @@ struct recv_thread_arg {
     struct {
       const nn_locator_t *loc;
       struct ddsi_tran_conn *conn;
+      /* busy-poll statistics: packets received while spinning, resp. after blocking */
+      ddsrt_atomic_uint64_t npoll_spin;
+      ddsrt_atomic_uint64_t npoll_block;
     } single;
     struct {
       os_sockWaitset ws;
@@ -96,6 +102,10 @@ struct ddsi_domaingv {
      participants, proxy readers and proxy writers by GUID. */
   struct entity_index *entity_index;
 
+  /* Proxy writers whose data is of interest, for dropping uninteresting
+     data early in the receive path */
+  struct ddsi_rxfilter *rxfilter;
+
   /* Timed events admin */
   struct xeventq *xevents;
 
@@ -145,6 +155,13 @@ struct ddsi_domaingv {
      but it seems the only way to get the users what they expect. */
   struct ddsi_tran_conn * xmit_conn;
 
+  /* Shared-memory rings for same-host peers (if enabled): the transmit
+     connection is tried before xmit_conn, the others receive on the rings
+     for the discovery and data unicast ports */
+  struct ddsi_tran_conn * shm_xmit_conn;
+  struct ddsi_tran_conn * shm_disc_conn;
+  struct ddsi_tran_conn * shm_data_conn;
+
   /* TCP listener */
   struct ddsi_tran_listener * listener;
 
@@ -224,7 +241,7 @@ struct ddsi_domaingv {
      trigger socket.) Receive buffer pool is per receive thread,
      it is only a global variable because it needs to be freed way later
      than the receive thread itself terminates */
-#define MAX_RECV_THREADS 3
+#define MAX_RECV_THREADS 5
   uint32_t n_recv_threads;
   struct recv_thread {
     const char *name;
@@ -271,6 +288,9 @@ struct ddsi_domaingv {
      delivery queue; currently just SEDP and PMD */
   struct nn_dqueue *builtins_dqueue;
 
+  /* Persistent cache of discovered proxies, NULL if disabled */
+  struct ddsi_discovery_cache *discovery_cache;
+
   struct debug_monitor *debmon;
 
 #ifndef DDSI_INCLUDE_NETWORK_CHANNELS
@@ -299,6 +319,7 @@ struct ddsi_domaingv {
   /* File for dumping captured packets, NULL if disabled */
   FILE *pcap_fp;
   ddsrt_mutex_t pcap_lock;
+  struct pcap_state *pcap;
 
   struct ddsi_builtin_topic_interface *builtin_topic_interface;
 
@@ -306,6 +327,9 @@ struct ddsi_domaingv {
 
   ddsrt_mutex_t sertopics_lock;
   struct ddsrt_hh *sertopics;
+
+  /* Interned partition sets of all endpoints and cached partition matching results */
+  struct ddsi_partition_match_cache *partition_match_cache;
 };
 
 #if defined (__cplusplus)
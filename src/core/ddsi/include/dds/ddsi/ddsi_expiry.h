@@ -0,0 +1,73 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_EXPIRY_H
+#define DDSI_EXPIRY_H
+
+#include <stdbool.h>
+#include "dds/export.h"
+#include "dds/ddsrt/avl.h"
+#include "dds/ddsrt/time.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Coarse-grained, time-bucketed administration of expiry times, shared by
+   lifespan and deadline.  Time is divided into intervals of "granularity"
+   and all nodes expiring in the same interval are kept in an unordered
+   list in a single bucket.  Buckets are ordered on time in an AVL tree, but
+   as expiry times are mostly increasing, the most recently used bucket is
+   cached and inserting and moving nodes is typically O(1).  A bucket is
+   due once the end of its interval has been reached, at which point all
+   its nodes have expired.  Expiry is therefore signalled at most one
+   granularity late, but never early. */
+
+struct expiry_bucket;
+
+struct expiry_node {
+  struct expiry_node *next, *prev;
+  struct expiry_bucket *bucket;
+};
+
+struct expiry_adm {
+  ddsrt_avl_tree_t buckets;           /* buckets, ordered on time */
+  struct expiry_bucket *latest;       /* most recently inserted-into bucket (can be NULL) */
+  dds_duration_t granularity;         /* width of a bucket, > 0 */
+};
+
+DDS_EXPORT void expiry_adm_init (struct expiry_adm *adm, dds_duration_t granularity);
+DDS_EXPORT void expiry_adm_fini (struct expiry_adm *adm);
+DDS_EXPORT bool expiry_adm_empty (const struct expiry_adm *adm);
+
+/* Returns the time at which the node would be due if it were inserted with
+   expiry time "t", useful for scheduling an event */
+DDS_EXPORT ddsrt_mtime_t expiry_due_time (const struct expiry_adm *adm, ddsrt_mtime_t t);
+
+/* Inserts "node" with expiry time "t" (not DDS_NEVER) and returns the time
+   at which it will be due */
+DDS_EXPORT ddsrt_mtime_t expiry_insert (struct expiry_adm *adm, struct expiry_node *node, ddsrt_mtime_t t);
+DDS_EXPORT void expiry_remove (struct expiry_adm *adm, struct expiry_node *node);
+
+/* Changes the expiry time of "node" to "t", this is a no-op if "t" falls in
+   the same bucket */
+DDS_EXPORT void expiry_move (struct expiry_adm *adm, struct expiry_node *node, ddsrt_mtime_t t);
+
+/* Returns a node from a bucket that is due at "tnow", without removing it;
+   or NULL if there is no such node, in which case "*tnext" is set to the
+   time the first bucket will be due (DDSRT_MTIME_NEVER if empty) */
+DDS_EXPORT struct expiry_node *expiry_next_due (const struct expiry_adm *adm, ddsrt_mtime_t tnow, ddsrt_mtime_t *tnext);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_EXPIRY_H */
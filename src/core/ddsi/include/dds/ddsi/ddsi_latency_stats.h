@@ -0,0 +1,109 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_LATENCY_STATS_H
+#define DDSI_LATENCY_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "dds/export.h"
+#include "dds/ddsrt/time.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Stages of the data path between dds_write and the reader history cache,
+   each measured as the time between two consecutive boundaries in the
+   handling of a sample (or, for SEND, of a packet) by the thread doing the
+   work.  The writing side is in the writing thread except for SEND, the
+   receiving side starts in the receive thread and ends in the delivery
+   thread, unless delivery is synchronous. */
+enum ddsi_latency_stage {
+  DDSI_LATENCY_SERIALIZE,  /* dds_write to serialized sample */
+  DDSI_LATENCY_WHC_INSERT, /* inserting the sample in the writer history cache */
+  DDSI_LATENCY_XPACK,      /* constructing the messages and adding them to a packet */
+  DDSI_LATENCY_SEND,       /* first message added to a packet to packet sent */
+  DDSI_LATENCY_RECEIVE,    /* packet received to start of processing the data submessage */
+  DDSI_LATENCY_DEFRAG,     /* defragmentation and reordering up to ready for delivery */
+  DDSI_LATENCY_DQUEUE,     /* waiting in the delivery queue */
+  DDSI_LATENCY_RHC_INSERT  /* delivery of received data into the reader history caches */
+};
+#define DDSI_LATENCY_NSTAGES ((int) DDSI_LATENCY_RHC_INSERT + 1)
+
+/* Log-linear histogram of durations in ns, like an HDR histogram with 16
+   sub-buckets per power of two, so that any value is represented with an
+   error of at most 1/16th; covers up to 2^40 ns (about 18 minutes), larger
+   values are counted in the last bucket. */
+#define DDSI_LATENCY_HIST_SUBBITS 4
+#define DDSI_LATENCY_HIST_MAXBITS 40
+#define DDSI_LATENCY_HIST_NBUCKETS ((DDSI_LATENCY_HIST_MAXBITS - DDSI_LATENCY_HIST_SUBBITS + 1) << DDSI_LATENCY_HIST_SUBBITS)
+
+struct ddsi_latency_hist {
+  uint64_t count;
+  int64_t sum;
+  int64_t min;
+  int64_t max;
+  uint64_t buckets[DDSI_LATENCY_HIST_NBUCKETS];
+};
+
+struct ddsi_latency_stats {
+  struct ddsi_latency_hist stage[DDSI_LATENCY_NSTAGES];
+};
+
+DDS_EXPORT const char *ddsi_latency_stage_name (enum ddsi_latency_stage stage);
+DDS_EXPORT void ddsi_latency_hist_init (struct ddsi_latency_hist *h);
+DDS_EXPORT void ddsi_latency_hist_add (struct ddsi_latency_hist *h, int64_t dt);
+DDS_EXPORT void ddsi_latency_hist_merge (struct ddsi_latency_hist *dst, const struct ddsi_latency_hist *src);
+
+/* Smallest value such that at least fraction "p" of the values in the histogram
+   is less than or equal to it, within the resolution of the histogram; 0 if
+   the histogram is empty */
+DDS_EXPORT int64_t ddsi_latency_hist_percentile (const struct ddsi_latency_hist *h, double p);
+
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+struct thread_state1;
+
+/* Statistics are kept per thread, in the thread state, and allocated when
+   the thread first records a measurement.  The statistics of threads that
+   have terminated are merged into a process-wide set of retired ones.
+
+   Recording is done by the owning thread without any synchronisation, so
+   reading them while they are being updated may give slightly inconsistent
+   results. */
+DDS_EXPORT int64_t ddsi_latency_stats_lap (enum ddsi_latency_stage stage, int64_t tstart);
+void ddsi_latency_stats_retire (struct thread_state1 *ts1);
+void ddsi_latency_stats_fini (void);
+
+/* Copies the statistics of the thread in slot "idx" of the thread states if
+   it has any, returns false if it doesn't (or if idx is out of range) */
+DDS_EXPORT bool ddsi_latency_stats_get_thread (uint32_t idx, char *name, size_t namesize, struct ddsi_latency_stats *st);
+
+/* Sum of the statistics of all threads, including those that have terminated */
+DDS_EXPORT void ddsi_latency_stats_get_all (struct ddsi_latency_stats *st);
+
+/* DDSI_LATENCY_START returns the start time for a measurement, or 0 if
+   not enabled; DDSI_LATENCY_LAP records the time elapsed since "t" (if
+   non-0) in "stage" and returns the current time to serve as the start of
+   the next stage */
+#define DDSI_LATENCY_START(enabled) ((enabled) ? ddsrt_time_monotonic ().v : 0)
+#define DDSI_LATENCY_LAP(stage, t) (((t) != 0) ? ddsi_latency_stats_lap ((stage), (t)) : 0)
+#else
+#define DDSI_LATENCY_START(enabled) ((int64_t) 0)
+#define DDSI_LATENCY_LAP(stage, t) ((void) (t), (int64_t) 0)
+#endif
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_LATENCY_STATS_H */
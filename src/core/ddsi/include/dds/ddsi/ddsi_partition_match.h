@@ -0,0 +1,50 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_PARTITION_MATCH_H
+#define DDSI_PARTITION_MATCH_H
+
+#include <stdbool.h>
+#include "dds/export.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct dds_qos;
+struct ddsi_partition_set;
+struct ddsi_partition_match_cache;
+
+/* Partition matching between endpoints using interned partition sets.  Each
+   distinct list of partition names maps to a single reference-counted set, in
+   which the names without wildcards are represented by domain-wide integer ids
+   (so that matching those is an intersection of two sorted integer arrays) and
+   the wildcard expressions are pre-processed once.  Results are remembered in a
+   fixed-size cache indexed by the pair of set ids, so repeated matching of the
+   same combinations (the normal case in discovery of large systems) is a single
+   lookup.
+
+   Matching results are identical to those of partitions_match_p. */
+DDS_EXPORT struct ddsi_partition_match_cache *ddsi_partition_match_cache_new (void);
+DDS_EXPORT void ddsi_partition_match_cache_free (struct ddsi_partition_match_cache *pmc);
+
+/* Returns a reference to the interned set for the partition QoS in qos; an
+   absent or empty partition QoS is the default partition */
+DDS_EXPORT struct ddsi_partition_set *ddsi_partition_set_ref (struct ddsi_partition_match_cache *pmc, const struct dds_qos *qos);
+DDS_EXPORT void ddsi_partition_set_unref (struct ddsi_partition_match_cache *pmc, struct ddsi_partition_set *ps);
+
+DDS_EXPORT bool ddsi_partition_sets_match (struct ddsi_partition_match_cache *pmc, const struct ddsi_partition_set *a, const struct ddsi_partition_set *b);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_PARTITION_MATCH_H */
@@ -70,8 +70,11 @@ extern "C" {
 #define NN_ADLINK_FL_PARTICIPANT_IS_DDSI2       (1u << 4)
 #define NN_ADLINK_FL_MINIMAL_BES_MODE           (1u << 5)
 #define NN_ADLINK_FL_SUPPORTS_STATUSINFOX       (1u << 5)
+#define NN_ADLINK_FL_SHARED_MEMORY              (1u << 6)
 /* SUPPORTS_STATUSINFOX: when set, also means any combination of
    write/unregister/dispose supported */
+/* SHARED_MEMORY: when set, the "unused" words in the version info identify
+   the host and network namespace of the participant (see ddsi_shm.h) */
 
 /* For locators one could patch the received message data to create
    singly-linked lists (parameter header -> offset of next entry in
@@ -236,6 +239,7 @@ struct nn_rdata;
 
 DDS_EXPORT unsigned char *ddsi_plist_quickscan (struct nn_rsample_info *dest, const struct nn_rmsg *rmsg, const ddsi_plist_src_t *src);
 DDS_EXPORT const unsigned char *ddsi_plist_findparam_native_unchecked (const void *src, nn_parameterid_t pid);
+DDS_EXPORT dds_return_t ddsi_plist_findparam_checking (const void *buf, size_t bufsz, uint16_t encoding, nn_parameterid_t needle, void **needlep, size_t *needlesz);
 
 #if defined (__cplusplus)
 }
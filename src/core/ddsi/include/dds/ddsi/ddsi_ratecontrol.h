@@ -0,0 +1,64 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_RATECONTROL_H
+#define DDSI_RATECONTROL_H
+
+#include <stdbool.h>
+#include "dds/export.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsi/q_rtps.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+/* Congestion controller for a reliable writer: a token bucket filled at a
+   rate that is adapted to the feedback from the readers.  It starts at the
+   maximum rate, halves the rate at most once per round-trip time when
+   data is lost, and increases it by 1/8th per round-trip time as long as
+   the writer is limited by the rate and the readers acknowledge new data.
+   The round-trip time is that of the reader giving the feedback, which the
+   writer measures for each matched reader (see wr_prd_match::rtt). */
+
+struct ddsi_ratecontrol {
+  double rate;                  /* current rate, bytes/second */
+  double min_rate, max_rate;    /* bounds on rate */
+  double tokens;                /* bytes that may be sent, negative if in debt */
+  ddsrt_mtime_t tupdate;        /* time tokens were last updated */
+  ddsrt_mtime_t tadjust;        /* time rate was last adjusted */
+  bool limited;                 /* rate was limiting since last adjustment */
+};
+
+/* max_rate = 0 means no upper bound (other than INT32_MAX) */
+DDS_EXPORT void ddsi_ratecontrol_init (struct ddsi_ratecontrol *rc, uint32_t min_rate, uint32_t max_rate, ddsrt_mtime_t tnow);
+DDS_EXPORT void ddsi_ratecontrol_fini (struct ddsi_ratecontrol *rc);
+
+/* Returns how long to wait before sending is allowed (<= 0 if allowed now) */
+DDS_EXPORT dds_duration_t ddsi_ratecontrol_delay (struct ddsi_ratecontrol *rc, ddsrt_mtime_t tnow);
+
+/* Accounts for sending "nbytes" of new data or retransmits, which may
+   cause a debt */
+DDS_EXPORT void ddsi_ratecontrol_consume (struct ddsi_ratecontrol *rc, uint32_t nbytes);
+
+/* Feedback from a reader with round-trip time "rtt" (0 if unknown): an
+   acknowledgement, "advanced" if it includes new data; or loss.  Both
+   return true if the rate was changed. */
+DDS_EXPORT bool ddsi_ratecontrol_ack (struct ddsi_ratecontrol *rc, bool advanced, dds_duration_t rtt, ddsrt_mtime_t tnow);
+DDS_EXPORT bool ddsi_ratecontrol_loss (struct ddsi_ratecontrol *rc, dds_duration_t rtt, ddsrt_mtime_t tnow);
+
+DDS_EXPORT double ddsi_ratecontrol_rate (const struct ddsi_ratecontrol *rc);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_RATECONTROL_H */
@@ -39,6 +39,7 @@ struct ddsi_writer_info
   bool auto_dispose;
   int32_t ownership_strength;
   uint64_t iid;
+  int64_t coherent_set_seq; /* sequence number of the first sample of the coherent set, 0 if none */
 #ifdef DDSI_INCLUDE_LIFESPAN
   ddsrt_mtime_t lifespan_exp;
 #endif
@@ -50,11 +51,17 @@ typedef void (*ddsi_rhc_unregister_wr_t) (struct ddsi_rhc * __restrict rhc, cons
 typedef void (*ddsi_rhc_relinquish_ownership_t) (struct ddsi_rhc * __restrict rhc, const uint64_t wr_iid);
 typedef void (*ddsi_rhc_set_qos_t) (struct ddsi_rhc *rhc, const struct dds_qos *qos);
 
+/* Samples stored with a non-zero coherent_set_seq may be held back by the reader
+   history cache until the writer commits the set: commit then makes all samples
+   of the set identified by wrinfo->coherent_set_seq visible at once */
+typedef void (*ddsi_rhc_commit_t) (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo);
+
 struct ddsi_rhc_ops {
   ddsi_rhc_store_t store;
   ddsi_rhc_unregister_wr_t unregister_wr;
   ddsi_rhc_relinquish_ownership_t relinquish_ownership;
   ddsi_rhc_set_qos_t set_qos;
+  ddsi_rhc_commit_t commit;
   ddsi_rhc_free_t free;
 };
 
@@ -74,6 +81,9 @@ DDS_EXPORT inline void ddsi_rhc_relinquish_ownership (struct ddsi_rhc * __restri
 DDS_EXPORT inline void ddsi_rhc_set_qos (struct ddsi_rhc *rhc, const struct dds_qos *qos) {
   rhc->ops->set_qos (rhc, qos);
 }
+DDS_EXPORT inline void ddsi_rhc_commit (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo) {
+  rhc->ops->commit (rhc, wrinfo);
+}
 DDS_EXPORT inline void ddsi_rhc_free (struct ddsi_rhc *rhc) {
   rhc->ops->free (rhc);
 }
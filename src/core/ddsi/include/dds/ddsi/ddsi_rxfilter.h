@@ -0,0 +1,58 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_RXFILTER_H
+#define DDSI_RXFILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "dds/export.h"
+#include "dds/ddsi/ddsi_guid.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+struct proxy_writer;
+struct ddsi_rxfilter;
+
+/* The receive filter is a set of the proxy writers whose data may be of
+   interest, that is, those with at least one local reader and those whose
+   liveliness is asserted by their data.  It is much smaller than the entity
+   index, and DATA/DATAFRAG submessages from application writers not in it are
+   dropped before they are parsed.
+
+   Lookups are lock-free and require the thread to be awake, updates must be
+   done while holding pwr->e.lock. */
+struct ddsi_rxfilter *ddsi_rxfilter_new (struct ddsi_domaingv *gv);
+void ddsi_rxfilter_free (struct ddsi_rxfilter *rxf);
+
+DDS_EXPORT void ddsi_rxfilter_add (struct ddsi_rxfilter *rxf, struct proxy_writer *pwr);
+DDS_EXPORT void ddsi_rxfilter_remove (struct ddsi_rxfilter *rxf, struct proxy_writer *pwr);
+
+/* Returns whether data from the writer should be processed, updates the
+   statistics accordingly */
+bool ddsi_rxfilter_accept (struct ddsi_rxfilter *rxf, const ddsi_guid_t *pwr_guid);
+
+struct ddsi_rxfilter_stats {
+  uint64_t accepted;
+  uint64_t dropped;
+};
+
+DDS_EXPORT void ddsi_rxfilter_get_stats (const struct ddsi_rxfilter *rxf, struct ddsi_rxfilter_stats *st);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* DDSI_RXFILTER_H */
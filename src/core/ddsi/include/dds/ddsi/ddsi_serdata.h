@@ -73,6 +73,19 @@ typedef struct ddsi_serdata * (*ddsi_serdata_from_keyhash_t) (const struct ddsi_
      unless additional application knowledge is available */
 typedef struct ddsi_serdata * (*ddsi_serdata_from_sample_t) (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const void *sample);
 
+/* Called when a serdata constructed by ddsi_serdata_from_pinned_sample_t no longer references
+   the application's memory; this can be any thread */
+typedef void (*ddsi_serdata_release_t) (void *arg);
+
+/* Construct a serdata from an application sample, like ddsi_serdata_from_sample_t, but with
+   the application guaranteeing that the sample's memory remains valid and unchanged until
+   "release" is called.  This allows the serdata to reference (parts of) the sample rather than
+   copying them.
+   - "release" must be called exactly once, also if the serdata copied everything (in which case
+     it may be called before returning) or could not be constructed
+   - optional, may be a null pointer */
+typedef struct ddsi_serdata * (*ddsi_serdata_from_pinned_sample_t) (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const void *sample, ddsi_serdata_release_t release, void *arg);
+
 /* Construct a topic-less serdata with just a keyvalue given a normal serdata (either key or data)
    - used for mapping key values to instance ids in tkmap
    - two reasons: size (keys are typically smaller than samples), and data in tkmap
@@ -96,6 +109,9 @@ typedef void (*ddsi_serdata_to_ser_t) (const struct ddsi_serdata *d, size_t off,
    - instead of copying, this gives a reference that must remain valid until the
      corresponding call to to_ser_unref
    - multiple calls to to_ser_ref() may be issued in parallel
+   - if the serialised data is not stored contiguously, it may provide a reference to fewer
+     than 'sz' bytes (but at least 1), and the caller then has to call it again for the
+     remainder; each call must be matched by a call to to_ser_unref
    - lazily creating the serialised representation is allowed (though I'm not sure
      how that would work with knowing the serialised size beforehand ...) */
 typedef struct ddsi_serdata * (*ddsi_serdata_to_ser_ref_t) (const struct ddsi_serdata *d, size_t off, size_t sz, ddsrt_iovec_t *ref);
@@ -151,12 +167,20 @@ struct ddsi_serdata_ops {
   ddsi_serdata_topicless_to_sample_t topicless_to_sample;
   ddsi_serdata_free_t free;
   ddsi_serdata_print_t print;
+  ddsi_serdata_from_pinned_sample_t from_pinned_sample;
 };
 
+#define DDSI_SERDATA_HAS_FROM_PINNED_SAMPLE 1
+
 #define DDSI_SERDATA_HAS_PRINT 1
 
 DDS_EXPORT void ddsi_serdata_init (struct ddsi_serdata *d, const struct ddsi_sertopic *tp, enum ddsi_serdata_kind kind);
 
+/* Construct a serdata of kind EMPTY, carrying no sample at all (e.g., the commit of a
+   coherent set); it uses its own serdata_ops rather than those of the topic, and has
+   size 0 */
+DDS_EXPORT struct ddsi_serdata *ddsi_serdata_new_empty (const struct ddsi_sertopic *tp);
+
 DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_ref (const struct ddsi_serdata *serdata_const) {
   struct ddsi_serdata *serdata = (struct ddsi_serdata *)serdata_const;
   ddsrt_atomic_inc32 (&serdata->refc);
@@ -188,6 +212,17 @@ DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_sample (const struct dd
   return topic->serdata_ops->from_sample (topic, kind, sample);
 }
 
+DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_from_pinned_sample (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const void *sample, ddsi_serdata_release_t release, void *arg) {
+  if (topic->serdata_ops->from_pinned_sample)
+    return topic->serdata_ops->from_pinned_sample (topic, kind, sample, release, arg);
+  else
+  {
+    struct ddsi_serdata *d = topic->serdata_ops->from_sample (topic, kind, sample);
+    release (arg);
+    return d;
+  }
+}
+
 DDS_EXPORT inline struct ddsi_serdata *ddsi_serdata_to_topicless (const struct ddsi_serdata *d) {
   return d->ops->to_topicless (d);
 }
@@ -56,10 +56,13 @@ typedef struct dds_keyhash {
 #define DDSI_SERDATA_DEFAULT_DEBUG_FIELDS
 #endif
 
+struct ddsi_serdata_pinned;
+
 /* There is an alignment requirement on the raw data (it must be at
    offset mod 8 for the conversion to/from a dds_stream to work).
    So we define two types: one without any additional padding, and
-   one where the appropriate amount of padding is inserted */
+   one where the appropriate amount of padding is inserted.  "pinned"
+   is only used for samples referencing application memory */
 #define DDSI_SERDATA_DEFAULT_PREPAD   \
   struct ddsi_serdata c;              \
   uint32_t pos;                       \
@@ -67,6 +70,7 @@ typedef struct dds_keyhash {
   DDSI_SERDATA_DEFAULT_DEBUG_FIELDS   \
   dds_keyhash_t keyhash;              \
   struct serdatapool *serpool;        \
+  struct ddsi_serdata_pinned *pinned; \
   struct ddsi_serdata_default *next /* in pool->freelist */
 #define DDSI_SERDATA_DEFAULT_POSTPAD  \
   struct CDRHeader hdr;               \
@@ -108,6 +112,7 @@ struct ddsi_sertopic_default_desc {
   uint32_t *m_keys;   /* Key descriptors (NULL iff m_nkeys 0) */
   uint32_t m_nops;    /* Number of words in m_ops (which >= number of ops stored in preproc output) */
   uint32_t *m_ops;    /* Marshalling meta data */
+  const struct dds_topic_cdr_ops *m_cdr_ops; /* Specialized (de)serializers, NULL if none */
 };
 
 struct ddsi_sertopic_default {
@@ -0,0 +1,62 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#ifndef DDSI_SHM_H
+#define DDSI_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "dds/export.h"
+#include "dds/ddsi/ddsi_guid.h"
+#include "dds/ddsi/q_protocol.h"
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+struct ddsi_domaingv;
+struct nn_adlink_participant_version_info;
+
+/* The shared-memory transport complements UDP for processes on the same host
+   and in the same network namespace: every unicast receive socket gets a
+   shared-memory ring named after that identity, the domain id and its port.
+   Participants advertise the identity in their SPDP messages, and for those
+   proxy participants that have the same identity, the UDP unicast locators
+   are registered with the transport so that messages addressed to them are
+   put in the ring for that port instead of being sent over the network, if
+   the ring exists.  Locators are left unchanged, so interoperability with
+   processes not using it is unaffected.
+
+   Returns -1 if not supported on this platform. */
+int ddsi_shm_init (struct ddsi_domaingv *gv);
+
+/* Sets the flag and the identity in the version info advertised in SPDP if
+   shared memory is in use */
+void ddsi_shm_set_participant_version_info (const struct ddsi_domaingv *gv, struct nn_adlink_participant_version_info *info);
+
+/* Registers the UDP unicast locators of the proxy participant with the given
+   prefix with the transport if it advertises the same identity, and
+   unregisters them when the proxy participant is deleted */
+void ddsi_shm_add_peer (struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix, const struct nn_adlink_participant_version_info *info, uint32_t nlocs, const nn_locator_t *locs);
+void ddsi_shm_remove_peer (struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix);
+
+/* Returns whether messages to "loc" go through shared memory */
+DDS_EXPORT bool ddsi_shm_peer_reachable (const struct ddsi_domaingv *gv, const nn_locator_t *loc);
+
+/* Name of the segment for the given domain and port, fails if the identity
+   of the host and network namespace can't be determined */
+DDS_EXPORT bool ddsi_shm_segment_name (char *dst, size_t size, uint32_t domain_id, uint32_t port);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif
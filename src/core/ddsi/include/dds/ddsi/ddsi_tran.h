@@ -59,6 +59,8 @@ typedef int (*ddsi_tran_listen_fn_t) (ddsi_tran_listener_t);
 typedef void (*ddsi_tran_free_fn_t) (ddsi_tran_factory_t);
 typedef void (*ddsi_tran_peer_locator_fn_t) (ddsi_tran_conn_t, nn_locator_t *);
 typedef void (*ddsi_tran_disable_multiplexing_fn_t) (ddsi_tran_conn_t);
+typedef bool (*ddsi_tran_buffered_fn_t) (ddsi_tran_conn_t);
+typedef void (*ddsi_tran_flush_fn_t) (ddsi_tran_conn_t);
 typedef ddsi_tran_conn_t (*ddsi_tran_accept_fn_t) (ddsi_tran_listener_t);
 typedef dds_return_t (*ddsi_tran_create_conn_fn_t) (ddsi_tran_conn_t *conn, ddsi_tran_factory_t fact, uint32_t, const struct ddsi_tran_qos *);
 typedef dds_return_t (*ddsi_tran_create_listener_fn_t) (ddsi_tran_listener_t *listener, ddsi_tran_factory_t fact, uint32_t port, const struct ddsi_tran_qos *);
@@ -120,6 +122,8 @@ struct ddsi_tran_conn
   ddsi_tran_peer_locator_fn_t m_peer_locator_fn;
   ddsi_tran_disable_multiplexing_fn_t m_disable_multiplexing_fn;
   ddsi_tran_locator_fn_t m_locator_fn;
+  ddsi_tran_buffered_fn_t m_buffered_fn;
+  ddsi_tran_flush_fn_t m_flush_fn;
 
   /* Data */
 
@@ -128,6 +132,7 @@ struct ddsi_tran_conn
   bool m_stream;
   bool m_closed;
   ddsrt_atomic_uint32_t m_count;
+  ddsrt_atomic_uint32_t m_write_pending; /* set while data is waiting for the socket to become writable */
 
   /* Relationships */
 
@@ -251,6 +256,9 @@ inline ssize_t ddsi_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_
 }
 bool ddsi_conn_peer_locator (ddsi_tran_conn_t conn, nn_locator_t * loc);
 void ddsi_conn_disable_multiplexing (ddsi_tran_conn_t conn);
+bool ddsi_conn_buffered (ddsi_tran_conn_t conn);
+bool ddsi_conn_write_pending (ddsi_tran_conn_t conn);
+void ddsi_conn_flush (ddsi_tran_conn_t conn);
 void ddsi_conn_add_ref (ddsi_tran_conn_t conn);
 void ddsi_conn_free (ddsi_tran_conn_t conn);
 int ddsi_conn_join_mc (ddsi_tran_conn_t conn, const nn_locator_t *srcip, const nn_locator_t *mcip, const struct nn_interface *interf);
@@ -36,9 +36,9 @@ struct addrset {
 typedef void (*addrset_forall_fun_t) (const nn_locator_t *loc, void *arg);
 typedef ssize_t (*addrset_forone_fun_t) (const nn_locator_t *loc, void *arg);
 
-struct addrset *new_addrset (void);
+DDS_EXPORT struct addrset *new_addrset (void);
 struct addrset *ref_addrset (struct addrset *as);
-void unref_addrset (struct addrset *as);
+DDS_EXPORT void unref_addrset (struct addrset *as);
 void add_to_addrset (const struct ddsi_domaingv *gv, struct addrset *as, const nn_locator_t *loc);
 void remove_from_addrset (const struct ddsi_domaingv *gv, struct addrset *as, const nn_locator_t *loc);
 int addrset_purge (struct addrset *as);
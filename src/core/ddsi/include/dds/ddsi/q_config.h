@@ -179,6 +179,10 @@ struct config
   uint32_t enabled_xchecks;
   char *servicename;
   char *pcap_file;
+  uint32_t pcap_buffer_size;
+  uint32_t pcap_snaplen;
+  char *pcap_guid_prefixes;
+  char *pcap_topics;
 
   char *networkAddressString;
   char **networkRecvAddressStrings;
@@ -204,6 +208,9 @@ struct config
   char *defaultMulticastAddressString;
   char *assumeMulticastCapable;
   int64_t spdp_interval;
+  char *discovery_cache_file;
+  int64_t discovery_cache_write_interval;
+  int64_t discovery_cache_confirm_timeout;
   int64_t spdp_response_delay_max;
   int64_t lease_duration;
   int64_t const_hb_intv_sched;
@@ -212,6 +219,9 @@ struct config
   int64_t const_hb_intv_min;
   enum retransmit_merging retransmit_merging;
   int64_t retransmit_merging_period;
+  int64_t retransmit_coalescing_window;
+  uint32_t history_burst_bytes;
+  int64_t history_burst_interval;
   int squash_participants;
   int liveliness_monitoring;
   int noprogress_log_stacktraces;
@@ -220,6 +230,8 @@ struct config
   int xpack_send_async;
   enum boolean_default multiple_recv_threads;
   unsigned recv_thread_stop_maxretries;
+  int64_t recv_busy_poll;
+  int recv_busy_poll_socket;
 
   unsigned primary_reorder_maxsamples;
   unsigned secondary_reorder_maxsamples;
@@ -234,13 +246,24 @@ struct config
   int publish_uc_locators; /* Publish discovery unicast locators */
   int enable_uc_locators; /* If false, don't even try to create a unicast socket */
 
+  int enable_shm;
+  uint32_t shm_ring_size;
+
   /* TCP transport configuration */
   int tcp_nodelay;
   int tcp_port;
   int64_t tcp_read_timeout;
   int64_t tcp_write_timeout;
+  uint32_t tcp_rbuf_size;
+  uint32_t tcp_sendq_size;
   int tcp_use_peeraddr_for_unicast;
 
+  /* Raw ethernet transport configuration */
+  int raweth_rings;
+  uint32_t raweth_rx_block_size;
+  uint32_t raweth_rx_blocks;
+  int64_t raweth_rx_block_timeout;
+
 #ifdef DDSI_INCLUDE_SSL
   /* SSL support for TCP */
   int ssl_enable;
@@ -277,6 +300,7 @@ struct config
   int xmit_lossiness;           /**<< fraction of packets to drop on xmit, in units of 1e-3 */
   uint32_t rmsg_chunk_size;          /**<< size of a chunk in the receive buffer */
   uint32_t rbuf_size;                /* << size of a single receiver buffer */
+  uint32_t rbuf_arena_size;          /* << size of arena for receive buffers per receive thread, 0 = none */
   enum besmode besmode;
   int meas_hb_to_ack_latency;
   int unicast_response_to_spdp_messages;
@@ -303,6 +327,8 @@ struct config
   int64_t nack_delay;
   int64_t preemptive_ack_delay;
   int64_t schedule_time_rounding;
+  int64_t control_aggregation_window;
+  int64_t expiry_granularity;
   int64_t auto_resched_nack_delay;
   int64_t ds_grace_period;
 #ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
@@ -315,6 +341,12 @@ struct config
   int retry_on_reject_besteffort;
   int generate_keyhash;
   uint32_t max_sample_size;
+  uint32_t pinned_reference_threshold;
+  int coalesce_fragments;
+  struct config_maybe_uint32 large_sample_rate; /* bytes/second, 0 = unlimited */
+  int congestion_control;
+  uint32_t congestion_control_min_rate; /* bytes/second */
+  uint32_t congestion_control_max_rate; /* bytes/second, 0 = unlimited */
 
   /* compability options */
   enum nn_standards_conformance standards_conformance;
@@ -325,6 +357,9 @@ struct config
   struct ddsi_portmapping ports;
 
   int monitor_port;
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  int latency_stats;
+#endif
 
   int enable_control_topic;
   int initial_deaf;
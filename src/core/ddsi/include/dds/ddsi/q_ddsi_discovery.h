@@ -12,6 +12,8 @@
 #ifndef NN_DDSI_DISCOVERY_H
 #define NN_DDSI_DISCOVERY_H
 
+#include <stdbool.h>
+#include "dds/ddsi/q_rtps.h"
 #include "dds/ddsi/q_unused.h"
 
 #if defined (__cplusplus)
@@ -24,6 +26,7 @@ struct reader;
 struct nn_rsample_info;
 struct nn_rdata;
 struct ddsi_plist;
+struct receiver_state;
 
 int spdp_write (struct participant *pp);
 int spdp_dispose_unregister (struct participant *pp);
@@ -35,6 +38,9 @@ int sedp_dispose_unregister_reader (struct reader *rd);
 
 int sedp_write_topic (struct participant *pp, const struct ddsi_plist *datap);
 
+/* Processes SPDP/SEDP data restored from the discovery cache as if it had just been received */
+void handle_cached_discovery_data (const struct receiver_state *rst, seqno_t seq, bool participant, const void *vdata, uint32_t len);
+
 int builtins_dqueue_handler (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const ddsi_guid_t *rdguid, void *qarg);
 
 #if defined (__cplusplus)
@@ -21,6 +21,7 @@
 #include "dds/ddsi/q_protocol.h"
 #include "dds/ddsi/q_lat_estim.h"
 #include "dds/ddsi/q_hbcontrol.h"
+#include "dds/ddsi/ddsi_ratecontrol.h"
 #include "dds/ddsi/q_feature_check.h"
 #include "dds/ddsi/q_inverse_uint32_set.h"
 
@@ -45,6 +46,7 @@ struct lease;
 
 struct proxy_group;
 struct proxy_endpoint_common;
+struct ddsi_partition_set;
 typedef void (*ddsi2direct_directread_cb_t) (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, void *arg);
 
 enum entity_kind {
@@ -112,6 +114,8 @@ struct wr_prd_match {
   unsigned has_replied_to_hb: 1; /* we must keep sending HBs until all readers have this set */
   unsigned all_have_replied_to_hb: 1; /* true iff 'has_replied_to_hb' for all readers in subtree */
   unsigned is_reliable: 1; /* true iff reliable proxy reader */
+  unsigned holding_up_writer: 1; /* true iff writer is being throttled waiting for this reader */
+  unsigned hist_started: 1; /* true iff the first burst of history has been sent to this reader */
   seqno_t min_seq; /* smallest ack'd seq nr in subtree */
   seqno_t max_seq; /* sort-of highest ack'd seq nr in subtree (see augment function) */
   seqno_t seq; /* highest acknowledged seq nr */
@@ -123,7 +127,24 @@ struct wr_prd_match {
   struct nn_lat_estim hb_to_ack_latency;
   ddsrt_wctime_t hb_to_ack_latency_tlastlog;
   uint32_t non_responsive_count;
-  uint32_t rexmit_requests;
+  uint32_t rexmit_requests; /* cum received ACKNACKs that did request retransmission */
+  uint32_t rexmit_frag_requests; /* cum received NACKFRAGs */
+  uint64_t rexmit_count; /* cum samples and fragments retransmitted in response to this reader */
+  uint64_t nacked_bytes; /* cum bytes requested by this reader that were still available */
+  dds_duration_t throttled_time; /* cum time writer was blocked with this reader among the slowest */
+  struct nn_lat_estim rtt; /* time from transmitting the writer's RTT probe until ack by this reader */
+  seqno_t hist_next_seq; /* next sample of the history to push to this reader, 0 if not streaming history */
+  seqno_t hist_max_seq; /* last sample of the history to push to this reader */
+};
+
+struct wr_rexmit_req {
+  ddsrt_avl_node_t avlnode;
+  seqno_t seq;
+  ddsi_guid_t prd_guid; /* first requesting reader, only meaningful if !multiple */
+  unsigned multiple: 1; /* requested by more than one reader: send to all */
+  uint32_t bytes; /* number of bytes accounted for in wr->rexmit_reqs_bytes */
+  uint32_t nfrags; /* number of bits in "frags" */
+  uint32_t frags[]; /* fragments to retransmit */
 };
 
 enum pwr_rd_match_syncstate {
@@ -142,6 +163,10 @@ struct pwr_rd_match {
   ddsrt_etime_t t_heartbeat_accepted; /* (local) time a heartbeat was last accepted */
   ddsrt_mtime_t t_last_nack; /* (local) time we last sent a NACK */  /* FIXME: probably elapsed time is better */
   seqno_t seq_last_nack; /* last seq for which we requested a retransmit */
+  uint32_t nacks_sent; /* cum ACKNACKs sent that requested retransmission */
+  uint32_t nackfrags_sent; /* cum NACKFRAGs sent */
+  uint64_t nacked_samples; /* cum samples requested (a sample can be counted many times) */
+  uint64_t nacked_fragments; /* cum fragments requested (idem) */
   struct xevent *acknack_xevent; /* entry in xevent queue for sending acknacks */
   enum pwr_rd_match_syncstate in_sync; /* whether in sync with the proxy writer */
   union {
@@ -252,9 +277,14 @@ struct writer
   nn_count_t hbfragcount; /* last hb frag seq number */
   int throttling; /* non-zero when some thread is waiting for the WHC to shrink */
   struct hbcontrol hbcontrol; /* controls heartbeat timing, piggybacking */
+  struct ddsi_ratecontrol ratecontrol; /* controls transmit rate if rate_controlled */
+  seqno_t rtt_probe_seq; /* sample being used for measuring round-trip times to readers (0 if none) */
+  ddsrt_mtime_t rtt_probe_t; /* time rtt_probe_seq was transmitted */
   struct dds_qos *xqos;
+  struct ddsi_partition_set *partset; /* interned partition QoS (which is immutable) for matching */
   enum writer_state state;
   unsigned reliable: 1; /* iff 1, writer is reliable <=> heartbeat_xevent != NULL */
+  unsigned rate_controlled: 1; /* iff 1, transmit rate is determined by ratecontrol (Internal/CongestionControl) */
   unsigned handle_as_transient_local: 1; /* controls whether data is retained in WHC */
   unsigned include_keyhash: 1; /* iff 1, this writer includes a keyhash; keyless topics => include_keyhash = 0 */
   unsigned retransmitting: 1; /* iff 1, this writer is currently retransmitting */
@@ -286,6 +316,10 @@ struct writer
   uint32_t rexmit_count; /* cum samples retransmitted (counting events; 1 sample can be counted many times) */
   uint32_t rexmit_lost_count; /* cum samples lost but retransmit requested (also counting events) */
   struct xeventq *evq; /* timed event queue to be used by this writer */
+  struct xevent *rexmit_xevent; /* timed event for sending coalesced retransmits, NULL <=> unreliable or RetransmitCoalescingWindow = 0 */
+  ddsrt_avl_tree_t rexmit_reqs; /* pending retransmit requests, wr_rexmit_req, ordered on sequence number */
+  uint32_t rexmit_reqs_bytes; /* approximate number of bytes in rexmit_reqs */
+  struct xevent *history_xevent; /* timed event for streaming the history to late-joining readers, NULL <=> volatile, unreliable or HistoricalDataStreaming disabled */
   struct local_reader_ary rdary; /* LOCAL readers for fast-pathing; if not fast-pathed, fall back to scanning local_readers */
   struct lease *lease; /* for liveliness administration (writer can only become inactive when using manual liveliness) */
 };
@@ -310,6 +344,7 @@ struct reader
   void * status_cb_entity;
   struct ddsi_rhc * rhc; /* reader history, tracks registrations and data */
   struct dds_qos *xqos;
+  struct ddsi_partition_set *partset; /* interned partition QoS (which is immutable) for matching */
   unsigned reliable: 1; /* 1 iff reader is reliable */
   unsigned handle_as_transient_local: 1; /* 1 iff reader wants historical data from proxy writers */
 #ifdef DDSI_INCLUDE_SSM
@@ -344,6 +379,7 @@ struct proxy_participant
   struct proxy_endpoint_common *endpoints; /* all proxy endpoints can be reached from here */
   ddsrt_avl_tree_t groups; /* table of all groups (publisher, subscriber), see struct proxy_group */
   seqno_t seq; /* sequence number of most recent SPDP message */
+  uint64_t spdp_hash; /* hash of the SPDP payload with sequence number seq, 0 if unknown */
   unsigned kernel_sequence_numbers : 1; /* whether this proxy participant generates OSPL kernel sequence numbers */
   unsigned implicitly_created : 1; /* participants are implicitly created for Cloud/Fog discovered endpoints */
   unsigned is_ddsi2_pp: 1; /* if this is the federation-leader on the remote node */
@@ -375,10 +411,12 @@ struct proxy_endpoint_common
   struct proxy_endpoint_common *next_ep; /* next \ endpoint belonging to this proxy participant */
   struct proxy_endpoint_common *prev_ep; /* prev / -- this is in arbitrary ordering */
   struct dds_qos *xqos; /* proxy endpoint QoS lives here; FIXME: local ones should have it moved to common as well */
+  struct ddsi_partition_set *partset; /* interned partition QoS for matching */
   struct addrset *as; /* address set to use for communicating with this endpoint */
   ddsi_guid_t group_guid; /* 0:0:0:0 if not available */
   nn_vendorid_t vendor; /* cached from proxypp->vendor */
   seqno_t seq; /* sequence number of most recent SEDP message */
+  uint64_t sedp_hash; /* hash of the SEDP payload with sequence number seq, 0 if unknown */
 };
 
 struct generic_proxy_endpoint {
@@ -428,6 +466,7 @@ struct proxy_reader {
 
 DDS_EXPORT extern const ddsrt_avl_treedef_t wr_readers_treedef;
 DDS_EXPORT extern const ddsrt_avl_treedef_t wr_local_readers_treedef;
+DDS_EXPORT extern const ddsrt_avl_treedef_t wr_rexmit_reqs_treedef;
 DDS_EXPORT extern const ddsrt_avl_treedef_t rd_writers_treedef;
 DDS_EXPORT extern const ddsrt_avl_treedef_t rd_local_writers_treedef;
 DDS_EXPORT extern const ddsrt_avl_treedef_t pwr_readers_treedef;
@@ -652,8 +691,8 @@ int writer_set_notalive (struct writer *wr, bool notify);
 /* Set when this proxy participant is not to be announced on the built-in topics yet */
 #define CF_PROXYPP_NO_SPDP                     (1 << 3)
 
-void new_proxy_participant (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, uint32_t bes, const struct ddsi_guid *privileged_pp_guid, struct addrset *as_default, struct addrset *as_meta, const struct ddsi_plist *plist, dds_duration_t tlease_dur, nn_vendorid_t vendor, unsigned custom_flags, ddsrt_wctime_t timestamp, seqno_t seq);
-int delete_proxy_participant_by_guid (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, ddsrt_wctime_t timestamp, int isimplicit);
+DDS_EXPORT void new_proxy_participant (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, uint32_t bes, const struct ddsi_guid *privileged_pp_guid, struct addrset *as_default, struct addrset *as_meta, const struct ddsi_plist *plist, dds_duration_t tlease_dur, nn_vendorid_t vendor, unsigned custom_flags, ddsrt_wctime_t timestamp, seqno_t seq);
+DDS_EXPORT int delete_proxy_participant_by_guid (struct ddsi_domaingv *gv, const struct ddsi_guid *guid, ddsrt_wctime_t timestamp, int isimplicit);
 
 int update_proxy_participant_plist_locked (struct proxy_participant *proxypp, seqno_t seq, const struct ddsi_plist *datap, ddsrt_wctime_t timestamp);
 int update_proxy_participant_plist (struct proxy_participant *proxypp, seqno_t seq, const struct ddsi_plist *datap, ddsrt_wctime_t timestamp);
@@ -664,8 +703,8 @@ void purge_proxy_participants (struct ddsi_domaingv *gv, const nn_locator_t *loc
 
 /* To create a new proxy writer or reader; the proxy participant is
    determined from the GUID and must exist. */
-  int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid, const struct ddsi_guid *guid, struct addrset *as, const struct ddsi_plist *plist, struct nn_dqueue *dqueue, struct xeventq *evq, ddsrt_wctime_t timestamp, seqno_t seq);
-int new_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid, const struct ddsi_guid *guid, struct addrset *as, const struct ddsi_plist *plist, ddsrt_wctime_t timestamp, seqno_t seq
+DDS_EXPORT int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid, const struct ddsi_guid *guid, struct addrset *as, const struct ddsi_plist *plist, struct nn_dqueue *dqueue, struct xeventq *evq, ddsrt_wctime_t timestamp, seqno_t seq);
+DDS_EXPORT int new_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid, const struct ddsi_guid *guid, struct addrset *as, const struct ddsi_plist *plist, ddsrt_wctime_t timestamp, seqno_t seq
 #ifdef DDSI_INCLUDE_SSM
                       , int favours_ssm
 #endif
@@ -40,8 +40,7 @@ struct gcreq {
   struct gcreq_queue *queue;
   gcreq_cb_t cb;
   void *arg;
-  uint32_t nvtimes;
-  struct idx_vtime vtimes[];
+  unsigned ready: 1; /* set once it needn't wait for threads to make progress */
 };
 
 DDS_EXPORT struct gcreq_queue *gcreq_queue_new (struct ddsi_domaingv *gv);
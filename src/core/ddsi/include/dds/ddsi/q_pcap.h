@@ -21,7 +21,8 @@ extern "C" {
 
 struct msghdr;
 
-FILE * new_pcap_file (struct ddsi_domaingv *gv, const char *name);
+void pcap_init (struct ddsi_domaingv *gv);
+void pcap_fini (struct ddsi_domaingv *gv);
 
 void write_pcap_received (struct ddsi_domaingv *gv, ddsrt_wctime_t tstamp, const struct sockaddr_storage *src, const struct sockaddr_storage *dst, unsigned char *buf, size_t sz);
 void write_pcap_sent (struct ddsi_domaingv *gv, ddsrt_wctime_t tstamp, const struct sockaddr_storage *src,
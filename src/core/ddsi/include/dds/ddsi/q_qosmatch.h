@@ -12,13 +12,15 @@
 #ifndef Q_QOSMATCH_H
 #define Q_QOSMATCH_H
 
+#include "dds/export.h"
+
 #if defined (__cplusplus)
 extern "C" {
 #endif
 
 struct dds_qos;
 
-int partitions_match_p (const struct dds_qos *a, const struct dds_qos *b);
+DDS_EXPORT int partitions_match_p (const struct dds_qos *a, const struct dds_qos *b);
 
 /* perform reader/writer QoS (and topic name, type name, partition) matching;
    mask can be used to exclude some of these (including topic name and type
@@ -96,6 +96,11 @@ struct nn_rmsg {
   /* whether to log */
   bool trace;
 
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  /* time of reception if latency statistics are enabled, else 0 */
+  int64_t tlat;
+#endif
+
   struct nn_rmsg_chunk chunk;
 };
 DDSRT_STATIC_ASSERT (sizeof (struct nn_rmsg) == offsetof (struct nn_rmsg, chunk) + sizeof (struct nn_rmsg_chunk));
@@ -132,6 +137,9 @@ struct nn_rsample_info {
   unsigned statusinfo: 2;       /* just the two defined bits from the status info */
   unsigned bswap: 1;            /* so we can extract well formatted writer info quicker */
   unsigned complex_qos: 1;      /* includes QoS other than keyhash, 2-bit statusinfo, PT writer info */
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  int64_t tlat;                 /* end of the previous stage for application data if latency statistics are enabled, else 0 */
+#endif
 };
 
 struct nn_rdata {
@@ -203,14 +211,23 @@ typedef int32_t nn_reorder_result_t;
 
 typedef void (*nn_dqueue_callback_t) (void *arg);
 
-struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size);
-void nn_rbufpool_setowner (struct nn_rbufpool *rbp, ddsrt_thread_t tid);
-void nn_rbufpool_free (struct nn_rbufpool *rbp);
+DDS_EXPORT struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size, uint32_t arena_size);
+DDS_EXPORT void nn_rbufpool_setowner (struct nn_rbufpool *rbp, ddsrt_thread_t tid);
+DDS_EXPORT void nn_rbufpool_free (struct nn_rbufpool *rbp);
+
+struct nn_rbufpool_stats {
+  size_t arena_size; /* 0 if no arena */
+  uint64_t n_arena_allocs; /* receive buffers taken from the arena */
+  uint64_t n_heap_allocs; /* receive buffers allocated on the heap */
+};
+
+/* Only the owner of the pool may call this */
+DDS_EXPORT void nn_rbufpool_get_stats (const struct nn_rbufpool *rbp, struct nn_rbufpool_stats *st);
 
-struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbufpool);
-void nn_rmsg_setsize (struct nn_rmsg *rmsg, uint32_t size);
-void nn_rmsg_commit (struct nn_rmsg *rmsg);
-void nn_rmsg_free (struct nn_rmsg *rmsg);
+DDS_EXPORT struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbufpool);
+DDS_EXPORT void nn_rmsg_setsize (struct nn_rmsg *rmsg, uint32_t size);
+DDS_EXPORT void nn_rmsg_commit (struct nn_rmsg *rmsg);
+DDS_EXPORT void nn_rmsg_free (struct nn_rmsg *rmsg);
 void *nn_rmsg_alloc (struct nn_rmsg *rmsg, uint32_t size);
 
 struct nn_rdata *nn_rdata_new (struct nn_rmsg *rmsg, uint32_t start, uint32_t endp1, uint32_t submsg_offset, uint32_t payload_offset);
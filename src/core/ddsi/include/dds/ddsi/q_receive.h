@@ -12,6 +12,8 @@
 #ifndef Q_RECEIVE_H
 #define Q_RECEIVE_H
 
+#include "dds/export.h"
+
 #if defined (__cplusplus)
 extern "C" {
 #endif
@@ -21,8 +23,14 @@ struct nn_rsample_info;
 struct nn_rdata;
 struct ddsi_tran_listener;
 struct recv_thread_arg;
+struct os_sockWaitset;
 
 void trigger_recv_threads (const struct ddsi_domaingv *gv);
+
+/* Waitset of the receive thread that handles all connections without a thread of
+   their own, including those created on the fly by connection-oriented transports;
+   NULL if there is no such thread */
+DDS_EXPORT struct os_sockWaitset *recv_thread_waitset (const struct ddsi_domaingv *gv);
 uint32_t recv_thread (void *vrecv_thread_arg);
 uint32_t listen_thread (struct ddsi_tran_listener * listener);
 int user_dqueue_handler (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const ddsi_guid_t *rdguid, void *qarg);
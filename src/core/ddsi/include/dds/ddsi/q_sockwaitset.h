@@ -101,6 +101,15 @@ os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws);
 */
 int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, struct ddsi_tran_conn ** conn);
 
+/*
+  Requests that CONN's queued output be flushed from the thread handling
+  events on WS once its socket becomes writable.  The request remains in
+  effect for as long as ddsi_conn_write_pending (CONN) holds; the flushing
+  is done by os_sockWaitsetWait and os_sockWaitsetNextEvent as part of
+  the normal event handling.  May be called from any thread.
+*/
+void os_sockWaitsetWantWrite (os_sockWaitset ws, struct ddsi_tran_conn * conn);
+
 /* Remove connection */
 void os_sockWaitsetRemove (os_sockWaitset ws, struct ddsi_tran_conn * conn);
 
@@ -59,6 +59,7 @@ enum thread_state {
 struct ddsi_domaingv;
 struct config;
 struct ddsrt_log_cfg;
+struct ddsi_latency_stats;
 
 /*
  * vtime indicates progress for the garbage collector and the liveliness monitoring.
@@ -89,6 +90,13 @@ void thread_vtime_trace (struct thread_state1 *ts1);
 #define thread_vtime_trace(ts1) do { } while (0)
 #endif /* Q_THREAD_DEBUG */
 
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+#define Q_THREAD_BASE_LATENCY_STATS \
+  ddsrt_atomic_voidp_t latstats;
+#else
+#define Q_THREAD_BASE_LATENCY_STATS
+#endif
+
 #define THREAD_BASE                             \
   ddsrt_atomic_uint32_t vtime;                  \
   enum thread_state state;                      \
@@ -97,6 +105,7 @@ void thread_vtime_trace (struct thread_state1 *ts1);
   uint32_t (*f) (void *arg);                    \
   void *f_arg;                                  \
   Q_THREAD_BASE_DEBUG /* note: no semicolon! */ \
+  Q_THREAD_BASE_LATENCY_STATS /* idem */        \
   char name[24] /* note: no semicolon! */
 
 struct thread_state_base {
@@ -116,6 +125,9 @@ struct thread_states {
   ddsrt_mutex_t lock;
   uint32_t nthreads;
   struct thread_state1 *ts; /* [nthreads] */
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  struct ddsi_latency_stats *latstats_retired; /* of threads that have been reaped */
+#endif
 };
 
 extern DDS_EXPORT struct thread_states thread_states;
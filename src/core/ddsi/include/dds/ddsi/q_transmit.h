@@ -39,8 +39,29 @@ int write_sample_nogc (struct thread_state1 * const ts1, struct nn_xpack *xp, st
 int write_sample_gc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata);
 int write_sample_nogc_notk (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, struct ddsi_serdata *serdata);
 
+/* Coherent sets: samples written between begin and end carry the sequence number of
+   the first sample of the set, end sends a commit message and returns the sequence
+   number of the committed set in *cs_seq (0 if there was nothing to commit) */
+void writer_begin_coherent (struct writer *wr);
+int writer_end_coherent (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, seqno_t *cs_seq);
+
+/* Sends the pending retransmit requests, wr->lock must not be held */
+void writer_rexmit_flush (struct nn_xpack *xp, struct writer *wr);
+
+/* Sends the next burst of historical data to the readers that are catching
+   up (see writer_add_connection), wr->lock must not be held; returns the
+   time at which the next burst is due, or NEVER when done */
+ddsrt_mtime_t writer_history_push (struct nn_xpack *xp, struct writer *wr, ddsrt_mtime_t tnow);
+
 /* When calling the following functions, wr->lock must be held */
 dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, struct proxy_reader *prd,struct nn_xmsg **msg, int isnew);
+
+/* Queues a request from "prd" for retransmitting sample "seq" of "size"
+   bytes, for the scheduler used when RetransmitCoalescingWindow > 0.  If
+   "bits" is NULL, the entire sample is requested, else the fragments set
+   in the bitmap (0-based "base", length "numbits").  Returns false if
+   too much data is already queued for retransmission. */
+bool writer_rexmit_request_wrlock_held (struct writer *wr, const struct proxy_reader *prd, seqno_t seq, uint32_t size, uint32_t base, uint32_t numbits, const uint32_t *bits);
 int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew);
 void add_Heartbeat (struct nn_xmsg *msg, struct writer *wr, const struct whc_state *whcst, int hbansreq, int hbliveliness, ddsi_entityid_t dst, int issync);
 dds_return_t write_hb_liveliness (struct ddsi_domaingv * const gv, struct ddsi_guid *wr_guid, struct nn_xpack *xp);
@@ -67,6 +67,8 @@ DDS_EXPORT struct xevent *qxev_acknack (struct xeventq *evq, ddsrt_mtime_t tsche
 DDS_EXPORT struct xevent *qxev_spdp (struct xeventq *evq, ddsrt_mtime_t tsched, const ddsi_guid_t *pp_guid, const ddsi_guid_t *proxypp_guid);
 DDS_EXPORT struct xevent *qxev_pmd_update (struct xeventq *evq, ddsrt_mtime_t tsched, const ddsi_guid_t *pp_guid);
 DDS_EXPORT struct xevent *qxev_delete_writer (struct xeventq *evq, ddsrt_mtime_t tsched, const ddsi_guid_t *guid);
+DDS_EXPORT struct xevent *qxev_rexmit (struct xeventq *evq, ddsrt_mtime_t tsched, const ddsi_guid_t *wr_guid);
+DDS_EXPORT struct xevent *qxev_history (struct xeventq *evq, ddsrt_mtime_t tsched, const ddsi_guid_t *wr_guid);
 
 /* cb will be called with now = NEVER if the event is still enqueued when when xeventq_free starts cleaning up */
 DDS_EXPORT struct xevent *qxev_callback (struct xeventq *evq, ddsrt_mtime_t tsched, void (*cb) (struct xevent *xev, void *arg, ddsrt_mtime_t now), void *arg);
@@ -27,10 +27,39 @@
 #define DDS_ENDIAN false
 #endif
 
+extern inline void dds_cdr_resize (dds_ostream_t * __restrict s, uint32_t l);
+extern inline void dds_cdr_alignto (dds_istream_t * __restrict s, uint32_t a);
+extern inline uint32_t dds_cdr_alignto_clear_and_resize (dds_ostream_t * __restrict s, uint32_t a, uint32_t extra);
+extern inline uint8_t dds_is_get1 (dds_istream_t * __restrict s);
+extern inline uint16_t dds_is_get2 (dds_istream_t * __restrict s);
+extern inline uint32_t dds_is_get4 (dds_istream_t * __restrict s);
+extern inline uint64_t dds_is_get8 (dds_istream_t * __restrict s);
+extern inline void dds_is_get_bytes (dds_istream_t * __restrict s, void * __restrict b, uint32_t num, uint32_t elem_size);
+extern inline void dds_is_skip (dds_istream_t * __restrict s, uint32_t num, uint32_t elem_size);
+extern inline void dds_os_put1 (dds_ostream_t * __restrict s, uint8_t v);
+extern inline void dds_os_put2 (dds_ostream_t * __restrict s, uint16_t v);
+extern inline void dds_os_put4 (dds_ostream_t * __restrict s, uint32_t v);
+extern inline void dds_os_put8 (dds_ostream_t * __restrict s, uint64_t v);
+extern inline void dds_os_put_bytes (dds_ostream_t * __restrict s, const void * __restrict b, uint32_t l);
+extern inline void dds_os_put_bytes_aligned (dds_ostream_t * __restrict s, const void * __restrict b, uint32_t n, uint32_t a);
+extern inline void dds_os_put1p (dds_ostream_t * __restrict s, const void * __restrict p);
+extern inline void dds_os_put2p (dds_ostream_t * __restrict s, const void * __restrict p);
+extern inline void dds_os_put4p (dds_ostream_t * __restrict s, const void * __restrict p);
+extern inline void dds_os_put8p (dds_ostream_t * __restrict s, const void * __restrict p);
+extern inline void dds_is_get1p (dds_istream_t * __restrict s, void * __restrict p);
+extern inline void dds_is_get2p (dds_istream_t * __restrict s, void * __restrict p);
+extern inline void dds_is_get4p (dds_istream_t * __restrict s, void * __restrict p);
+extern inline void dds_is_get8p (dds_istream_t * __restrict s, void * __restrict p);
+extern inline uint32_t dds_cdr_check_align_prim (uint32_t off, uint32_t size, uint32_t a_lg2);
+extern inline bool dds_stream_normalize_uint8 (uint32_t * __restrict off, uint32_t size);
+extern inline bool dds_stream_normalize_uint16 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap);
+extern inline bool dds_stream_normalize_uint32 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap);
+extern inline bool dds_stream_normalize_uint64 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap);
+
 static void dds_stream_write (dds_ostream_t * __restrict os, const char * __restrict data, const uint32_t * __restrict ops);
 static void dds_stream_read (dds_istream_t * __restrict is, char * __restrict data, const uint32_t * __restrict ops);
 
-static void dds_ostream_grow (dds_ostream_t * __restrict st, uint32_t size)
+void dds_ostream_grow (dds_ostream_t * __restrict st, uint32_t size)
 {
   uint32_t needed = size + st->m_index;
 
@@ -43,12 +72,6 @@ static void dds_ostream_grow (dds_ostream_t * __restrict st, uint32_t size)
   st->m_size = newSize;
 }
 
-static void dds_cdr_resize (dds_ostream_t * __restrict s, uint32_t l)
-{
-  if (s->m_size < l + s->m_index)
-    dds_ostream_grow (s, l);
-}
-
 void dds_ostream_init (dds_ostream_t * __restrict st, uint32_t size)
 {
   memset (st, 0, sizeof (*st));
@@ -72,102 +95,11 @@ void dds_ostreamBE_fini (dds_ostreamBE_t * __restrict st)
   dds_ostream_fini (&st->x);
 }
 
-static void dds_cdr_alignto (dds_istream_t * __restrict s, uint32_t a)
-{
-  s->m_index = (s->m_index + a - 1) & ~(a - 1);
-  assert (s->m_index < s->m_size);
-}
-
-static uint32_t dds_cdr_alignto_clear_and_resize (dds_ostream_t * __restrict s, uint32_t a, uint32_t extra)
-{
-  const uint32_t m = s->m_index % a;
-  if (m == 0)
-  {
-    dds_cdr_resize (s, extra);
-    return 0;
-  }
-  else
-  {
-    const uint32_t pad = a - m;
-    dds_cdr_resize (s, pad + extra);
-    for (uint32_t i = 0; i < pad; i++)
-      s->m_buffer[s->m_index++] = 0;
-    return pad;
-  }
-}
-
 static uint32_t dds_cdr_alignto_clear_and_resize_be (dds_ostreamBE_t * __restrict s, uint32_t a, uint32_t extra)
 {
   return dds_cdr_alignto_clear_and_resize (&s->x, a, extra);
 }
 
-static uint8_t dds_is_get1 (dds_istream_t * __restrict s)
-{
-  assert (s->m_index < s->m_size);
-  uint8_t v = *(s->m_buffer + s->m_index);
-  s->m_index++;
-  return v;
-}
-
-static uint16_t dds_is_get2 (dds_istream_t * __restrict s)
-{
-  dds_cdr_alignto (s, 2);
-  uint16_t v = * ((uint16_t *) (s->m_buffer + s->m_index));
-  s->m_index += 2;
-  return v;
-}
-
-static uint32_t dds_is_get4 (dds_istream_t * __restrict s)
-{
-  dds_cdr_alignto (s, 4);
-  uint32_t v = * ((uint32_t *) (s->m_buffer + s->m_index));
-  s->m_index += 4;
-  return v;
-}
-
-static uint64_t dds_is_get8 (dds_istream_t * __restrict s)
-{
-  dds_cdr_alignto (s, 8);
-  uint64_t v = * ((uint64_t *) (s->m_buffer + s->m_index));
-  s->m_index += 8;
-  return v;
-}
-
-static void dds_is_get_bytes (dds_istream_t * __restrict s, void * __restrict b, uint32_t num, uint32_t elem_size)
-{
-  dds_cdr_alignto (s, elem_size);
-  memcpy (b, s->m_buffer + s->m_index, num * elem_size);
-  s->m_index += num * elem_size;
-}
-
-static void dds_os_put1 (dds_ostream_t * __restrict s, uint8_t v)
-{
-  dds_cdr_resize (s, 1);
-  *((uint8_t *) (s->m_buffer + s->m_index)) = v;
-  s->m_index += 1;
-}
-
-static void dds_os_put2 (dds_ostream_t * __restrict s, uint16_t v)
-{
-  dds_cdr_alignto_clear_and_resize (s, 2, 2);
-  *((uint16_t *) (s->m_buffer + s->m_index)) = v;
-  s->m_index += 2;
-}
-
-static void dds_os_put4 (dds_ostream_t * __restrict s, uint32_t v)
-{
-  dds_cdr_alignto_clear_and_resize (s, 4, 4);
-  *((uint32_t *) (s->m_buffer + s->m_index)) = v;
-  s->m_index += 4;
-}
-
-static void dds_os_put8 (dds_ostream_t * __restrict s, uint64_t v)
-{
-  dds_cdr_alignto_clear_and_resize (s, 8, 8);
-  *((uint64_t *) (s->m_buffer + s->m_index)) = v;
-  s->m_index += 8;
-}
-
 static void dds_os_put1be (dds_ostreamBE_t * __restrict s, uint8_t v)
 {
   dds_os_put1 (&s->x, v);
@@ -188,21 +120,6 @@ static void dds_os_put8be (dds_ostreamBE_t * __restrict s, uint64_t v)
   dds_os_put8 (&s->x, ddsrt_toBE8u (v));
 }
 
-static void dds_os_put_bytes (dds_ostream_t * __restrict s, const void * __restrict b, uint32_t l)
-{
-  dds_cdr_resize (s, l);
-  memcpy (s->m_buffer + s->m_index, b, l);
-  s->m_index += l;
-}
-
-static void dds_os_put_bytes_aligned (dds_ostream_t * __restrict s, const void * __restrict b, uint32_t n, uint32_t a)
-{
-  const uint32_t l = n * a;
-  dds_cdr_alignto_clear_and_resize (s, a, l);
-  memcpy (s->m_buffer + s->m_index, b, l);
-  s->m_index += l;
-}
-
 static uint32_t get_type_size (enum dds_stream_typecode type)
 {
   DDSRT_STATIC_ASSERT (DDS_OP_VAL_1BY == 1 && DDS_OP_VAL_2BY == 2 && DDS_OP_VAL_4BY == 3 && DDS_OP_VAL_8BY == 4);
@@ -386,7 +303,7 @@ uint32_t dds_stream_countops (const uint32_t * __restrict ops)
   return (uint32_t) (ops_end - ops);
 }
 
-static void dds_stream_reuse_string_bound (dds_istream_t * __restrict is, char * __restrict str, const uint32_t bound)
+void dds_stream_reuse_string_bound (dds_istream_t * __restrict is, char * __restrict str, const uint32_t bound)
 {
   const uint32_t length = dds_is_get4 (is);
   const void *src = is->m_buffer + is->m_index;
@@ -398,7 +315,7 @@ static void dds_stream_reuse_string_bound (dds_istream_t * __restrict is, char *
   is->m_index += length;
 }
 
-static char *dds_stream_reuse_string (dds_istream_t * __restrict is, char * __restrict str)
+char *dds_stream_reuse_string (dds_istream_t * __restrict is, char * __restrict str)
 {
   const uint32_t length = dds_is_get4 (is);
   const void *src = is->m_buffer + is->m_index;
@@ -415,13 +332,28 @@ static void dds_stream_skip_forward (dds_istream_t * __restrict is, uint32_t len
     is->m_index += len * elem_size;
 }
 
-static void dds_stream_skip_string (dds_istream_t * __restrict is)
+void dds_stream_skip_string (dds_istream_t * __restrict is)
 {
   const uint32_t length = dds_is_get4 (is);
   dds_stream_skip_forward (is, length, 1);
 }
 
-static void dds_stream_write_string (dds_ostream_t * __restrict os, const char * __restrict val)
+void dds_stream_skip_primseq (dds_istream_t * __restrict is, uint32_t elem_size)
+{
+  const uint32_t num = dds_is_get4 (is);
+  if (num > 0)
+    dds_is_skip (is, num, elem_size);
+}
+
+void dds_stream_extract_string (dds_istream_t * __restrict is, dds_ostream_t * __restrict os)
+{
+  const uint32_t sz = dds_is_get4 (is);
+  dds_os_put4 (os, sz);
+  dds_os_put_bytes (os, is->m_buffer + is->m_index, sz);
+  is->m_index += sz;
+}
+
+void dds_stream_write_string (dds_ostream_t * __restrict os, const char * __restrict val)
 {
   uint32_t size = 1;
 
@@ -533,6 +465,36 @@ static const uint32_t *skip_sequence_insns (const uint32_t * __restrict ops, uin
   return NULL;
 }
 
+static void dds_os_put_primseq_bytes (dds_ostream_t * __restrict os, const void * __restrict b, uint32_t num, uint32_t elem_size)
+{
+  struct dds_ostream_refs * const refs = os->m_refs;
+  const uint32_t l = num * elem_size;
+  uint32_t lref;
+  if (refs == NULL || l < refs->m_threshold || (lref = l & ~(uint32_t) 7) == 0)
+    dds_os_put_bytes_aligned (os, b, num, elem_size);
+  else
+  {
+    (void) dds_cdr_alignto_clear_and_resize (os, elem_size, l - lref);
+    if (refs->m_count == refs->m_max)
+    {
+      refs->m_max = (refs->m_max == 0) ? 4 : 2 * refs->m_max;
+      refs->m_refs = ddsrt_realloc (refs->m_refs, refs->m_max * sizeof (*refs->m_refs));
+    }
+    refs->m_refs[refs->m_count].m_index = os->m_index;
+    refs->m_refs[refs->m_count].m_size = lref;
+    refs->m_refs[refs->m_count].m_ptr = b;
+    refs->m_count++;
+    dds_os_put_bytes (os, (const char *) b + lref, l - lref);
+  }
+}
+
+void dds_stream_write_primseq (dds_ostream_t * __restrict os, const dds_sequence_t * __restrict seq, uint32_t elem_size)
+{
+  dds_os_put4 (os, seq->_length);
+  if (seq->_length > 0)
+    dds_os_put_primseq_bytes (os, seq->_buffer, seq->_length, elem_size);
+}
+
 static const uint32_t *dds_stream_write_seq (dds_ostream_t * __restrict os, const char * __restrict addr, const uint32_t * __restrict ops, uint32_t insn)
 {
   const dds_sequence_t * const seq = (const dds_sequence_t *) addr;
@@ -547,7 +509,7 @@ static const uint32_t *dds_stream_write_seq (dds_ostream_t * __restrict os, cons
   switch (subtype)
   {
     case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY:
-      dds_os_put_bytes_aligned (os, seq->_buffer, num, get_type_size (subtype));
+      dds_os_put_primseq_bytes (os, seq->_buffer, num, get_type_size (subtype));
       return ops + 2;
     case DDS_OP_VAL_STR: {
       const char **ptr = (const char **) seq->_buffer;
@@ -700,6 +662,24 @@ static void realloc_sequence_buffer_if_needed (dds_sequence_t * __restrict seq,
   }
 }
 
+static void dds_stream_read_primseq_elems (dds_istream_t * __restrict is, dds_sequence_t * __restrict seq, uint32_t num, uint32_t elem_size)
+{
+  realloc_sequence_buffer_if_needed (seq, num, elem_size, false);
+  seq->_length = (num <= seq->_maximum) ? num : seq->_maximum;
+  dds_is_get_bytes (is, seq->_buffer, seq->_length, elem_size);
+  if (seq->_length < num)
+    dds_stream_skip_forward (is, num - seq->_length, elem_size);
+}
+
+void dds_stream_read_primseq (dds_istream_t * __restrict is, dds_sequence_t * __restrict seq, uint32_t elem_size)
+{
+  const uint32_t num = dds_is_get4 (is);
+  if (num == 0)
+    seq->_length = 0;
+  else
+    dds_stream_read_primseq_elems (is, seq, num, elem_size);
+}
+
 static const uint32_t *dds_stream_read_seq (dds_istream_t * __restrict is, char * __restrict addr, const uint32_t * __restrict ops, uint32_t insn)
 {
   dds_sequence_t * const seq = (dds_sequence_t *) addr;
@@ -713,15 +693,9 @@ static const uint32_t *dds_stream_read_seq (dds_istream_t * __restrict is, char
 
   switch (subtype)
   {
-    case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY: {
-      const uint32_t elem_size = get_type_size (subtype);
-      realloc_sequence_buffer_if_needed (seq, num, elem_size, false);
-      seq->_length = (num <= seq->_maximum) ? num : seq->_maximum;
-      dds_is_get_bytes (is, seq->_buffer, seq->_length, elem_size);
-      if (seq->_length < num)
-        dds_stream_skip_forward (is, num - seq->_length, elem_size);
+    case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY:
+      dds_stream_read_primseq_elems (is, seq, num, get_type_size (subtype));
       return ops + 2;
-    }
     case DDS_OP_VAL_STR: {
       realloc_sequence_buffer_if_needed (seq, num, sizeof (char *), true);
       seq->_length = (num <= seq->_maximum) ? num : seq->_maximum;
@@ -874,19 +848,6 @@ static void dds_stream_read (dds_istream_t * __restrict is, char * __restrict da
 
 static bool stream_normalize (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, const uint32_t * __restrict ops);
 
-static uint32_t check_align_prim (uint32_t off, uint32_t size, uint32_t a_lg2)
-{
-  assert (a_lg2 <= 3);
-  const uint32_t a = 1u << a_lg2;
-  assert (size <= CDR_SIZE_MAX);
-  assert (off <= size);
-  const uint32_t off1 = (off + a - 1) & ~(a - 1);
-  assert (off <= off1 && off1 <= CDR_SIZE_MAX);
-  if (size < off1 + a)
-    return UINT32_MAX;
-  return off1;
-}
-
 static uint32_t check_align_prim_many (uint32_t off, uint32_t size, uint32_t a_lg2, uint32_t n)
 {
   assert (a_lg2 <= 3);
@@ -900,37 +861,9 @@ static uint32_t check_align_prim_many (uint32_t off, uint32_t size, uint32_t a_l
   return off1;
 }
 
-static bool normalize_uint8 (uint32_t *off, uint32_t size)
-{
-  if (*off == size)
-    return false;
-  (*off)++;
-  return true;
-}
-
-static bool normalize_uint16 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)
-{
-  if ((*off = check_align_prim (*off, size, 1)) == UINT32_MAX)
-    return false;
-  if (bswap)
-    *((uint16_t *) (data + *off)) = ddsrt_bswap2u (*((uint16_t *) (data + *off)));
-  (*off) += 2;
-  return true;
-}
-
-static bool normalize_uint32 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)
-{
-  if ((*off = check_align_prim (*off, size, 2)) == UINT32_MAX)
-    return false;
-  if (bswap)
-    *((uint32_t *) (data + *off)) = ddsrt_bswap4u (*((uint32_t *) (data + *off)));
-  (*off) += 4;
-  return true;
-}
-
 static bool read_and_normalize_uint32 (uint32_t * __restrict val, char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)
 {
-  if ((*off = check_align_prim (*off, size, 2)) == UINT32_MAX)
+  if ((*off = dds_cdr_check_align_prim (*off, size, 2)) == UINT32_MAX)
     return false;
   if (bswap)
     *((uint32_t *) (data + *off)) = ddsrt_bswap4u (*((uint32_t *) (data + *off)));
@@ -939,17 +872,7 @@ static bool read_and_normalize_uint32 (uint32_t * __restrict val, char * __restr
   return true;
 }
 
-static bool normalize_uint64 (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)
-{
-  if ((*off = check_align_prim (*off, size, 3)) == UINT32_MAX)
-    return false;
-  if (bswap)
-    *((uint64_t *) (data + *off)) = ddsrt_bswap8u (*((uint64_t *) (data + *off)));
-  (*off) += 8;
-  return true;
-}
-
-static bool normalize_string (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, size_t maxsz)
+bool dds_stream_normalize_string (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, size_t maxsz)
 {
   uint32_t sz;
   if (!read_and_normalize_uint32 (&sz, data, off, size, bswap))
@@ -962,16 +885,16 @@ static bool normalize_string (char * __restrict data, uint32_t * __restrict off,
   return true;
 }
 
-static bool normalize_primarray (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, uint32_t num, enum dds_stream_typecode type)
+bool dds_stream_normalize_primarray (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, uint32_t num, uint32_t elem_size)
 {
-  switch (type)
+  switch (elem_size)
   {
-    case DDS_OP_VAL_1BY:
+    case 1:
       if ((*off = check_align_prim_many (*off, size, 0, num)) == UINT32_MAX)
         return false;
       *off += num;
       return true;
-    case DDS_OP_VAL_2BY:
+    case 2:
       if ((*off = check_align_prim_many (*off, size, 1, num)) == UINT32_MAX)
         return false;
       if (bswap)
@@ -982,7 +905,7 @@ static bool normalize_primarray (char * __restrict data, uint32_t * __restrict o
       }
       *off += 2 * num;
       return true;
-    case DDS_OP_VAL_4BY:
+    case 4:
       if ((*off = check_align_prim_many (*off, size, 2, num)) == UINT32_MAX)
         return false;
       if (bswap)
@@ -993,7 +916,7 @@ static bool normalize_primarray (char * __restrict data, uint32_t * __restrict o
       }
       *off += 4 * num;
       return true;
-    case DDS_OP_VAL_8BY:
+    case 8:
       if ((*off = check_align_prim_many (*off, size, 3, num)) == UINT32_MAX)
         return false;
       if (bswap)
@@ -1011,6 +934,14 @@ static bool normalize_primarray (char * __restrict data, uint32_t * __restrict o
   return false;
 }
 
+bool dds_stream_normalize_primseq (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, uint32_t elem_size)
+{
+  uint32_t num;
+  if (!read_and_normalize_uint32 (&num, data, off, size, bswap))
+    return false;
+  return num == 0 || dds_stream_normalize_primarray (data, off, size, bswap, num, elem_size);
+}
+
 static const uint32_t *normalize_seq (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap, const uint32_t * __restrict ops, uint32_t insn)
 {
   const enum dds_stream_typecode subtype = DDS_OP_SUBTYPE (insn);
@@ -1022,13 +953,13 @@ static const uint32_t *normalize_seq (char * __restrict data, uint32_t * __restr
   switch (subtype)
   {
     case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY:
-      if (!normalize_primarray (data, off, size, bswap, num, subtype))
+      if (!dds_stream_normalize_primarray (data, off, size, bswap, num, get_type_size (subtype)))
         return NULL;
       return ops + 2;
     case DDS_OP_VAL_STR: case DDS_OP_VAL_BST: {
       const size_t maxsz = (subtype == DDS_OP_VAL_STR) ? SIZE_MAX : ops[2];
       for (uint32_t i = 0; i < num; i++)
-        if (!normalize_string (data, off, size, bswap, maxsz))
+        if (!dds_stream_normalize_string (data, off, size, bswap, maxsz))
           return NULL;
       return ops + (subtype == DDS_OP_VAL_STR ? 2 : 3);
     }
@@ -1051,13 +982,13 @@ static const uint32_t *normalize_arr (char * __restrict data, uint32_t * __restr
   switch (subtype)
   {
     case DDS_OP_VAL_1BY: case DDS_OP_VAL_2BY: case DDS_OP_VAL_4BY: case DDS_OP_VAL_8BY:
-      if (!normalize_primarray (data, off, size, bswap, num, subtype))
+      if (!dds_stream_normalize_primarray (data, off, size, bswap, num, get_type_size (subtype)))
         return NULL;
       return ops + 3;
     case DDS_OP_VAL_STR: case DDS_OP_VAL_BST: {
       const size_t maxsz = (subtype == DDS_OP_VAL_STR) ? SIZE_MAX : ops[4];
       for (uint32_t i = 0; i < num; i++)
-        if (!normalize_string (data, off, size, bswap, maxsz))
+        if (!dds_stream_normalize_string (data, off, size, bswap, maxsz))
           return NULL;
       return ops + (subtype == DDS_OP_VAL_STR ? 3 : 5);
     }
@@ -1078,13 +1009,13 @@ static bool normalize_uni_disc (uint32_t * __restrict val, char * __restrict dat
   switch (disctype)
   {
     case DDS_OP_VAL_1BY:
-      if ((*off = check_align_prim (*off, size, 0)) == UINT32_MAX)
+      if ((*off = dds_cdr_check_align_prim (*off, size, 0)) == UINT32_MAX)
         return false;
       *val = *((uint8_t *) (data + *off));
       (*off) += 1;
       return true;
     case DDS_OP_VAL_2BY:
-      if ((*off = check_align_prim (*off, size, 1)) == UINT32_MAX)
+      if ((*off = dds_cdr_check_align_prim (*off, size, 1)) == UINT32_MAX)
         return false;
       if (bswap)
         *((uint16_t *) (data + *off)) = ddsrt_bswap2u (*((uint16_t *) (data + *off)));
@@ -1092,7 +1023,7 @@ static bool normalize_uni_disc (uint32_t * __restrict val, char * __restrict dat
       (*off) += 2;
       return true;
     case DDS_OP_VAL_4BY:
-      if ((*off = check_align_prim (*off, size, 2)) == UINT32_MAX)
+      if ((*off = dds_cdr_check_align_prim (*off, size, 2)) == UINT32_MAX)
         return false;
       if (bswap)
         *((uint32_t *) (data + *off)) = ddsrt_bswap4u (*((uint32_t *) (data + *off)));
@@ -1117,11 +1048,11 @@ static const uint32_t *normalize_uni (char * __restrict data, uint32_t * __restr
     const enum dds_stream_typecode valtype = DDS_JEQ_TYPE (jeq_op[0]);
     switch (valtype)
     {
-      case DDS_OP_VAL_1BY: if (!normalize_uint8 (off, size)) return NULL; break;
-      case DDS_OP_VAL_2BY: if (!normalize_uint16 (data, off, size, bswap)) return NULL; break;
-      case DDS_OP_VAL_4BY: if (!normalize_uint32 (data, off, size, bswap)) return NULL; break;
-      case DDS_OP_VAL_8BY: if (!normalize_uint64 (data, off, size, bswap)) return NULL; break;
-      case DDS_OP_VAL_STR: if (!normalize_string (data, off, size, bswap, SIZE_MAX)) return NULL; break;
+      case DDS_OP_VAL_1BY: if (!dds_stream_normalize_uint8 (off, size)) return NULL; break;
+      case DDS_OP_VAL_2BY: if (!dds_stream_normalize_uint16 (data, off, size, bswap)) return NULL; break;
+      case DDS_OP_VAL_4BY: if (!dds_stream_normalize_uint32 (data, off, size, bswap)) return NULL; break;
+      case DDS_OP_VAL_8BY: if (!dds_stream_normalize_uint64 (data, off, size, bswap)) return NULL; break;
+      case DDS_OP_VAL_STR: if (!dds_stream_normalize_string (data, off, size, bswap, SIZE_MAX)) return NULL; break;
       case DDS_OP_VAL_BST: case DDS_OP_VAL_SEQ: case DDS_OP_VAL_ARR: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU:
         if (!stream_normalize (data, off, size, bswap, jeq_op + DDS_OP_ADR_JSR (jeq_op[0])))
           return NULL;
@@ -1141,12 +1072,12 @@ static bool stream_normalize (char * __restrict data, uint32_t * __restrict off,
       case DDS_OP_ADR: {
         switch (DDS_OP_TYPE (insn))
         {
-          case DDS_OP_VAL_1BY: if (!normalize_uint8 (off, size)) return false; ops += 2; break;
-          case DDS_OP_VAL_2BY: if (!normalize_uint16 (data, off, size, bswap)) return false; ops += 2; break;
-          case DDS_OP_VAL_4BY: if (!normalize_uint32 (data, off, size, bswap)) return false; ops += 2; break;
-          case DDS_OP_VAL_8BY: if (!normalize_uint64 (data, off, size, bswap)) return false; ops += 2; break;
-          case DDS_OP_VAL_STR: if (!normalize_string (data, off, size, bswap, SIZE_MAX)) return false; ops += 2; break;
-          case DDS_OP_VAL_BST: if (!normalize_string (data, off, size, bswap, ops[2])) return false; ops += 3; break;
+          case DDS_OP_VAL_1BY: if (!dds_stream_normalize_uint8 (off, size)) return false; ops += 2; break;
+          case DDS_OP_VAL_2BY: if (!dds_stream_normalize_uint16 (data, off, size, bswap)) return false; ops += 2; break;
+          case DDS_OP_VAL_4BY: if (!dds_stream_normalize_uint32 (data, off, size, bswap)) return false; ops += 2; break;
+          case DDS_OP_VAL_8BY: if (!dds_stream_normalize_uint64 (data, off, size, bswap)) return false; ops += 2; break;
+          case DDS_OP_VAL_STR: if (!dds_stream_normalize_string (data, off, size, bswap, SIZE_MAX)) return false; ops += 2; break;
+          case DDS_OP_VAL_BST: if (!dds_stream_normalize_string (data, off, size, bswap, ops[2])) return false; ops += 3; break;
           case DDS_OP_VAL_SEQ: ops = normalize_seq (data, off, size, bswap, ops, insn); if (!ops) return false; break;
           case DDS_OP_VAL_ARR: ops = normalize_arr (data, off, size, bswap, ops, insn); if (!ops) return false; break;
           case DDS_OP_VAL_UNI: ops = normalize_uni (data, off, size, bswap, ops, insn); if (!ops) return false; break;
@@ -1178,12 +1109,12 @@ static bool stream_normalize_key (void * __restrict data, uint32_t size, bool bs
     assert (insn_key_ok_p (*op));
     switch (DDS_OP_TYPE (*op))
     {
-      case DDS_OP_VAL_1BY: if (!normalize_uint8 (&off, size)) return false; break;
-      case DDS_OP_VAL_2BY: if (!normalize_uint16 (data, &off, size, bswap)) return false; break;
-      case DDS_OP_VAL_4BY: if (!normalize_uint32 (data, &off, size, bswap)) return false; break;
-      case DDS_OP_VAL_8BY: if (!normalize_uint64 (data, &off, size, bswap)) return false; break;
-      case DDS_OP_VAL_STR: if (!normalize_string (data, &off, size, bswap, SIZE_MAX)) return false; break;
-      case DDS_OP_VAL_BST: if (!normalize_string (data, &off, size, bswap, op[2])) return false; break;
+      case DDS_OP_VAL_1BY: if (!dds_stream_normalize_uint8 (&off, size)) return false; break;
+      case DDS_OP_VAL_2BY: if (!dds_stream_normalize_uint16 (data, &off, size, bswap)) return false; break;
+      case DDS_OP_VAL_4BY: if (!dds_stream_normalize_uint32 (data, &off, size, bswap)) return false; break;
+      case DDS_OP_VAL_8BY: if (!dds_stream_normalize_uint64 (data, &off, size, bswap)) return false; break;
+      case DDS_OP_VAL_STR: if (!dds_stream_normalize_string (data, &off, size, bswap, SIZE_MAX)) return false; break;
+      case DDS_OP_VAL_BST: if (!dds_stream_normalize_string (data, &off, size, bswap, op[2])) return false; break;
       case DDS_OP_VAL_ARR: if (!normalize_arr (data, &off, size, bswap, op, *op)) return false; break;
       case DDS_OP_VAL_SEQ: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU:
         abort ();
@@ -1202,6 +1133,8 @@ bool dds_stream_normalize (void * __restrict data, uint32_t size, bool bswap, co
   else
   {
     uint32_t off = 0;
+    if (topic->type.m_cdr_ops && topic->type.m_cdr_ops->m_normalize)
+      return topic->type.m_cdr_ops->m_normalize (data, &off, size, bswap);
     return stream_normalize (data, &off, size, bswap, topic->type.m_ops);
   }
 }
@@ -1427,7 +1360,10 @@ void dds_stream_read_sample (dds_istream_t * __restrict is, void * __restrict da
       dds_stream_free_sample (data, desc->m_ops);
       memset (data, 0, desc->m_size);
     }
-    dds_stream_read (is, data, desc->m_ops);
+    if (desc->m_cdr_ops && desc->m_cdr_ops->m_read)
+      desc->m_cdr_ops->m_read (is, data);
+    else
+      dds_stream_read (is, data, desc->m_ops);
   }
 }
 
@@ -1436,6 +1372,8 @@ void dds_stream_write_sample (dds_ostream_t * __restrict os, const void * __rest
   const struct ddsi_sertopic_default_desc *desc = &topic->type;
   if (topic->opt_size && desc->m_align && (os->m_index % desc->m_align) == 0)
     dds_os_put_bytes (os, data, desc->m_size);
+  else if (desc->m_cdr_ops && desc->m_cdr_ops->m_write)
+    desc->m_cdr_ops->m_write (os, data);
   else
     dds_stream_write (os, data, desc->m_ops);
 }
@@ -1587,10 +1525,7 @@ static void dds_stream_extract_key_from_key_prim_op (dds_istream_t * __restrict
     case DDS_OP_VAL_4BY: dds_os_put4 (os, dds_is_get4 (is)); break;
     case DDS_OP_VAL_8BY: dds_os_put8 (os, dds_is_get8 (is)); break;
     case DDS_OP_VAL_STR: case DDS_OP_VAL_BST: {
-      uint32_t sz = dds_is_get4 (is);
-      dds_os_put4 (os, sz);
-      dds_os_put_bytes (os, is->m_buffer + is->m_index, sz);
-      is->m_index += sz;
+      dds_stream_extract_string (is, os);
       break;
     }
     case DDS_OP_VAL_ARR: {
@@ -1602,7 +1537,6 @@ static void dds_stream_extract_key_from_key_prim_op (dds_istream_t * __restrict
       void * const dst = os->m_buffer + os->m_index;
       dds_is_get_bytes (is, dst, num, align);
       os->m_index += num * align;
-      is->m_index += num * align;
       break;
     }
     case DDS_OP_VAL_SEQ: case DDS_OP_VAL_UNI: case DDS_OP_VAL_STU: {
@@ -1893,8 +1827,13 @@ static void dds_stream_extract_keyBE_from_data1 (dds_istream_t * __restrict is,
 void dds_stream_extract_key_from_data (dds_istream_t * __restrict is, dds_ostream_t * __restrict os, const struct ddsi_sertopic_default * __restrict topic)
 {
   const struct ddsi_sertopic_default_desc *desc = &topic->type;
-  uint32_t keys_remaining = desc->m_nkeys;
-  dds_stream_extract_key_from_data1 (is, os, desc->m_ops, &keys_remaining);
+  if (desc->m_cdr_ops && desc->m_cdr_ops->m_extract_key)
+    desc->m_cdr_ops->m_extract_key (is, os);
+  else
+  {
+    uint32_t keys_remaining = desc->m_nkeys;
+    dds_stream_extract_key_from_data1 (is, os, desc->m_ops, &keys_remaining);
+  }
 }
 
 void dds_stream_extract_keyBE_from_data (dds_istream_t * __restrict is, dds_ostreamBE_t * __restrict os, const struct ddsi_sertopic_default * __restrict topic)
@@ -2253,6 +2192,7 @@ void dds_ostream_from_serdata_default (dds_ostream_t * __restrict s, struct ddsi
   s->m_buffer = (unsigned char *) d;
   s->m_index = (uint32_t) offsetof (struct ddsi_serdata_default, data);
   s->m_size = d->size + s->m_index;
+  s->m_refs = NULL;
 #if DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN
   assert (d->hdr.identifier == CDR_LE);
 #elif DDSRT_ENDIAN == DDSRT_BIG_ENDIAN
@@ -2282,6 +2222,7 @@ void dds_ostreamBE_from_serdata_default (dds_ostreamBE_t * __restrict s, struct
   s->x.m_buffer = (unsigned char *) d;
   s->x.m_index = (uint32_t) offsetof (struct ddsi_serdata_default, data);
   s->x.m_size = d->size + s->x.m_index;
+  s->x.m_refs = NULL;
   assert (d->hdr.identifier == CDR_BE);
 }
 
@@ -11,48 +11,48 @@
  */
 #include <stddef.h>
 #include <stdlib.h>
-#include "dds/ddsrt/circlist.h"
+#include <assert.h>
 #include "dds/ddsrt/time.h"
 #include "dds/ddsi/ddsi_deadline.h"
+#include "dds/ddsi/ddsi_expiry.h"
+#include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_xevent.h"
 
 static void instance_deadline_missed_cb (struct xevent *xev, void *varg, ddsrt_mtime_t tnow)
 {
   struct deadline_adm * const deadline_adm = varg;
-  ddsrt_mtime_t next_valid = deadline_adm->deadline_missed_cb((char *)deadline_adm - deadline_adm->list_offset, tnow);
+  ddsrt_mtime_t next_valid = deadline_adm->deadline_missed_cb((char *)deadline_adm - deadline_adm->adm_offset, tnow);
   resched_xevent_if_earlier (xev, next_valid);
 }
 
-/* Gets the instance from the list in deadline admin that has the earliest missed deadline and
- * removes the instance element from the list. If no more instances with missed deadline exist
- * in the list, the deadline (nn_mtime_t) for the first instance to 'expire' is returned. If the
- * list is empty, DDSRT_MTIME_NEVER is returned */
+/* Gets an instance from the bucket in the deadline admin that is due and removes the
+ * instance element from the admin. Deadlines in a bucket are missed together, which may
+ * be up to the granularity of the admin later than the actual deadline. If no more
+ * instances with missed deadline exist, the time the next bucket becomes due (nn_mtime_t)
+ * is returned. If the admin is empty, DDSRT_MTIME_NEVER is returned */
 ddsrt_mtime_t deadline_next_missed_locked (struct deadline_adm *deadline_adm, ddsrt_mtime_t tnow, void **instance)
 {
-  struct deadline_elem *elem = NULL;
-  if (!ddsrt_circlist_isempty (&deadline_adm->list))
+  struct expiry_node *node;
+  ddsrt_mtime_t tnext;
+  if ((node = expiry_next_due (&deadline_adm->exp, tnow, &tnext)) != NULL)
   {
-    struct ddsrt_circlist_elem *list_elem = ddsrt_circlist_oldest (&deadline_adm->list);
-    elem = DDSRT_FROM_CIRCLIST (struct deadline_elem, e, list_elem);
-    if (elem->t_deadline.v <= tnow.v)
-    {
-      ddsrt_circlist_remove (&deadline_adm->list, &elem->e);
-      if (instance != NULL)
-        *instance = (char *)elem - deadline_adm->elem_offset;
-      return (ddsrt_mtime_t) { 0 };
-    }
+    struct deadline_elem *elem = (struct deadline_elem *) node;
+    expiry_remove (&deadline_adm->exp, &elem->e);
+    if (instance != NULL)
+      *instance = (char *)elem - deadline_adm->elem_offset;
+    return (ddsrt_mtime_t) { 0 };
   }
   if (instance != NULL)
     *instance = NULL;
-  return (elem != NULL) ? elem->t_deadline : DDSRT_MTIME_NEVER;
+  return tnext;
 }
 
-void deadline_init (const struct ddsi_domaingv *gv, struct deadline_adm *deadline_adm, size_t list_offset, size_t elem_offset, deadline_missed_cb_t deadline_missed_cb)
+void deadline_init (const struct ddsi_domaingv *gv, struct deadline_adm *deadline_adm, size_t adm_offset, size_t elem_offset, deadline_missed_cb_t deadline_missed_cb)
 {
-  ddsrt_circlist_init (&deadline_adm->list);
+  expiry_adm_init (&deadline_adm->exp, gv->config.expiry_granularity);
   deadline_adm->evt = qxev_callback (gv->xevents, DDSRT_MTIME_NEVER, instance_deadline_missed_cb, deadline_adm);
   deadline_adm->deadline_missed_cb = deadline_missed_cb;
-  deadline_adm->list_offset = list_offset;
+  deadline_adm->adm_offset = adm_offset;
   deadline_adm->elem_offset = elem_offset;
 }
 
@@ -66,10 +66,9 @@ void deadline_clear (struct deadline_adm *deadline_adm)
   while ((deadline_next_missed_locked (deadline_adm, DDSRT_MTIME_NEVER, NULL)).v == 0);
 }
 
-void deadline_fini (const struct deadline_adm *deadline_adm)
+void deadline_fini (struct deadline_adm *deadline_adm)
 {
-  assert (ddsrt_circlist_isempty (&deadline_adm->list));
-  (void) deadline_adm;
+  expiry_adm_fini (&deadline_adm->exp);
 }
 
 extern inline void deadline_register_instance_locked (struct deadline_adm *deadline_adm, struct deadline_elem *elem, ddsrt_mtime_t tnow);
@@ -77,10 +76,10 @@ extern inline void deadline_reregister_instance_locked (struct deadline_adm *dea
 
 void deadline_register_instance_real (struct deadline_adm *deadline_adm, struct deadline_elem *elem, ddsrt_mtime_t tprev, ddsrt_mtime_t tnow)
 {
-  ddsrt_circlist_append(&deadline_adm->list, &elem->e);
   elem->t_deadline = (tprev.v + deadline_adm->dur >= tnow.v) ? tprev : tnow;
   elem->t_deadline.v += deadline_adm->dur;
-  resched_xevent_if_earlier (deadline_adm->evt, elem->t_deadline);
+  const ddsrt_mtime_t tdue = expiry_insert (&deadline_adm->exp, &elem->e, elem->t_deadline);
+  resched_xevent_if_earlier (deadline_adm->evt, tdue);
 }
 
 extern inline void deadline_unregister_instance_locked (struct deadline_adm *deadline_adm, struct deadline_elem *elem);
@@ -89,24 +88,24 @@ void deadline_unregister_instance_real (struct deadline_adm *deadline_adm, struc
 {
   /* Updating the scheduled event with the new shortest expiry
    * is not required, because the event will be rescheduled when
-   * this removed element expires. Only remove the element from the
-   * deadline list */
+   * the bucket this element was in becomes due. Only remove the
+   * element from the deadline admin */
 
   elem->t_deadline = DDSRT_MTIME_NEVER;
-  ddsrt_circlist_remove(&deadline_adm->list, &elem->e);
+  expiry_remove (&deadline_adm->exp, &elem->e);
 }
 
 extern inline void deadline_renew_instance_locked (struct deadline_adm *deadline_adm, struct deadline_elem *elem);
 
 void deadline_renew_instance_real (struct deadline_adm *deadline_adm, struct deadline_elem *elem)
 {
-  /* move element to end of the list (list->latest) and update deadline
-     according to current deadline duration in rhc (event with old deadline
-     will still be triggered, but has no effect on this instance because in
-     the callback the deadline (which will be the updated value) will be
-     checked for expiry */
-  ddsrt_circlist_remove(&deadline_adm->list, &elem->e);
+  /* update deadline according to current deadline duration in rhc and move
+     the element to the corresponding bucket, which is a no-op if it remains
+     in the same bucket; typically the new deadline falls in the most recent
+     bucket and otherwise creates a new one, both cheap. The event for the
+     old bucket will still be triggered, but has no effect on this instance
+     because it is no longer in that bucket */
   elem->t_deadline = ddsrt_time_monotonic();
   elem->t_deadline.v += deadline_adm->dur;
-  ddsrt_circlist_append(&deadline_adm->list, &elem->e);
+  expiry_move (&deadline_adm->exp, &elem->e, elem->t_deadline);
 }
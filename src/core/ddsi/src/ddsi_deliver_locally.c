@@ -267,3 +267,38 @@ dds_return_t deliver_locally_allinsync (struct ddsi_domaingv *gv, struct entity_
   } while (rc == DDS_RETCODE_TRY_AGAIN);
   return rc;
 }
+
+void deliver_locally_commit (struct ddsi_domaingv *gv, struct entity_common *source_entity, bool source_entity_locked, const ddsi_guid_t *rdguid, struct local_reader_ary *fastpath_rdary, const struct ddsi_writer_info *wrinfo, const struct deliver_locally_ops * __restrict ops)
+{
+  /* The samples of the set have already been delivered, so this only needs to visit
+     the same readers again, in the same way */
+  assert (wrinfo->coherent_set_seq != 0);
+  if (rdguid)
+  {
+    struct reader *rd;
+    if ((rd = entidx_lookup_reader_guid (gv->entity_index, rdguid)) != NULL)
+      ddsi_rhc_commit (rd->rhc, wrinfo);
+    return;
+  }
+
+  ddsrt_mutex_lock (&fastpath_rdary->rdary_lock);
+  if (fastpath_rdary->fastpath_ok)
+  {
+    EETRACE (source_entity, " => EVERYONE (commit)\n");
+    for (uint32_t i = 0; fastpath_rdary->rdary[i]; i++)
+      ddsi_rhc_commit (fastpath_rdary->rdary[i]->rhc, wrinfo);
+    ddsrt_mutex_unlock (&fastpath_rdary->rdary_lock);
+  }
+  else
+  {
+    ddsrt_avl_iter_t it;
+    struct reader *rd;
+    ddsrt_mutex_unlock (&fastpath_rdary->rdary_lock);
+    if (!source_entity_locked)
+      ddsrt_mutex_lock (&source_entity->lock);
+    for (rd = ops->first_reader (gv->entity_index, source_entity, &it); rd != NULL; rd = ops->next_reader (gv->entity_index, &it))
+      ddsi_rhc_commit (rd->rhc, wrinfo);
+    if (!source_entity_locked)
+      ddsrt_mutex_unlock (&source_entity->lock);
+  }
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/io.h"
+#include "dds/ddsrt/avl.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/q_xevent.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_radmin.h"
+#include "dds/ddsi/q_ddsi_discovery.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
+
+/* File layout: a header followed by records up to end-of-file, each record a struct
+   dcache_rec followed by "size" bytes of payload.  The file is only ever meant to be
+   read back by the same build on the same machine, so all is in native format, the
+   header merely allows detecting a mismatch. */
+#define DCACHE_MAGIC 0x43444443u /* "CDDC" */
+#define DCACHE_VERSION 1u
+
+struct dcache_file_hdr {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t rec_size;
+  uint32_t domain_id;
+};
+
+struct dcache_rec {
+  ddsi_guid_t guid;
+  ddsi_guid_prefix_t src_guid_prefix;
+  nn_vendorid_t vendor;
+  nn_protocol_version_t protocol_version;
+  nn_locator_t srcloc;
+  seqno_t seq;
+  uint32_t size;
+};
+
+struct dcache_entry {
+  ddsrt_avl_node_t avlnode;
+  struct dcache_rec rec;
+  unsigned char *payload;
+  bool confirmed; /* set once live discovery data has been received */
+};
+
+struct ddsi_discovery_cache {
+  struct ddsi_domaingv *gv;
+  ddsrt_mutex_t lock;
+  ddsrt_avl_tree_t entries;
+  bool dirty;
+  bool replaying;
+  struct xevent *write_xev;
+  struct xevent *confirm_xev;
+};
+
+static int compare_guid (const void *va, const void *vb)
+{
+  return memcmp (va, vb, sizeof (ddsi_guid_t));
+}
+
+static const ddsrt_avl_treedef_t dcache_treedef =
+  DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct dcache_entry, avlnode), offsetof (struct dcache_entry, rec.guid), compare_guid, 0);
+
+static bool is_participant_entry (const struct dcache_entry *e)
+{
+  return e->rec.guid.entityid.u == NN_ENTITYID_PARTICIPANT;
+}
+
+static void free_entry (void *ve)
+{
+  struct dcache_entry *e = ve;
+  ddsrt_free (e->payload);
+  ddsrt_free (e);
+}
+
+struct ddsi_discovery_cache *ddsi_discovery_cache_new (struct ddsi_domaingv *gv)
+{
+  struct ddsi_discovery_cache *dc;
+  if (gv->config.discovery_cache_file == NULL || *gv->config.discovery_cache_file == 0)
+    return NULL;
+  dc = ddsrt_malloc (sizeof (*dc));
+  dc->gv = gv;
+  ddsrt_mutex_init (&dc->lock);
+  ddsrt_avl_init (&dcache_treedef, &dc->entries);
+  dc->dirty = false;
+  dc->replaying = false;
+  dc->write_xev = NULL;
+  dc->confirm_xev = NULL;
+  return dc;
+}
+
+void ddsi_discovery_cache_free (struct ddsi_discovery_cache *dc)
+{
+  assert (dc->write_xev == NULL && dc->confirm_xev == NULL);
+  ddsrt_avl_free (&dcache_treedef, &dc->entries, free_entry);
+  ddsrt_mutex_destroy (&dc->lock);
+  ddsrt_free (dc);
+}
+
+static bool dcache_read_file (struct ddsi_discovery_cache *dc)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  struct ddsi_domaingv * const gv = dc->gv;
+  struct dcache_file_hdr hdr;
+  struct dcache_rec rec;
+  uint32_t n = 0;
+  FILE *fp;
+
+  if ((fp = fopen (gv->config.discovery_cache_file, "rb")) == NULL)
+  {
+    GVLOGDISC ("discovery cache: %s does not exist yet\n", gv->config.discovery_cache_file);
+    return false;
+  }
+  if (fread (&hdr, sizeof (hdr), 1, fp) != 1 ||
+      hdr.magic != DCACHE_MAGIC || hdr.version != DCACHE_VERSION ||
+      hdr.rec_size != sizeof (struct dcache_rec) || hdr.domain_id != gv->config.domainId)
+  {
+    GVWARNING ("discovery cache: %s has an unsupported format or is for another domain, ignoring it\n", gv->config.discovery_cache_file);
+    fclose (fp);
+    return false;
+  }
+  while (fread (&rec, sizeof (rec), 1, fp) == 1)
+  {
+    struct dcache_entry *e;
+    ddsrt_avl_ipath_t path;
+    if (rec.size < 4 || rec.size > gv->config.max_msg_size)
+      break;
+    e = ddsrt_malloc (sizeof (*e));
+    e->rec = rec;
+    e->payload = ddsrt_malloc (rec.size);
+    e->confirmed = false;
+    if (fread (e->payload, rec.size, 1, fp) != 1)
+    {
+      free_entry (e);
+      break;
+    }
+    if (ddsrt_avl_lookup_ipath (&dcache_treedef, &dc->entries, &e->rec.guid, &path) != NULL)
+      free_entry (e);
+    else
+    {
+      ddsrt_avl_insert_ipath (&dcache_treedef, &dc->entries, e, &path);
+      n++;
+    }
+  }
+  if (!feof (fp))
+    GVWARNING ("discovery cache: %s is truncated or corrupt, using first %"PRIu32" entries\n", gv->config.discovery_cache_file, n);
+  fclose (fp);
+  GVLOGDISC ("discovery cache: loaded %"PRIu32" entries from %s\n", n, gv->config.discovery_cache_file);
+  return n > 0;
+  DDSRT_WARNING_MSVC_ON(4996);
+}
+
+static void dcache_replay (struct ddsi_discovery_cache *dc)
+{
+  struct ddsi_domaingv * const gv = dc->gv;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  ddsrt_avl_iter_t it;
+  struct dcache_entry *e;
+
+  /* The receive threads haven't been started yet and updates and removals are
+     ignored while replaying, so the entries can safely be used without holding
+     the lock, and that is required because the regular discovery code calls
+     back into the cache */
+  ddsrt_mutex_lock (&dc->lock);
+  dc->replaying = true;
+  ddsrt_mutex_unlock (&dc->lock);
+  thread_state_awake (ts1, gv);
+  for (int pass = 0; pass < 2; pass++)
+  {
+    /* participants first, so that endpoints find their participant */
+    for (e = ddsrt_avl_iter_first (&dcache_treedef, &dc->entries, &it); e; e = ddsrt_avl_iter_next (&it))
+    {
+      struct receiver_state rst;
+      if (is_participant_entry (e) != (pass == 0))
+        continue;
+      memset (&rst, 0, sizeof (rst));
+      rst.src_guid_prefix = e->rec.src_guid_prefix;
+      rst.vendor = e->rec.vendor;
+      rst.protocol_version = e->rec.protocol_version;
+      rst.srcloc = e->rec.srcloc;
+      rst.gv = gv;
+      GVLOGDISC ("discovery cache: replay "PGUIDFMT" ", PGUID (e->rec.guid));
+      handle_cached_discovery_data (&rst, e->rec.seq, pass == 0, e->payload, e->rec.size);
+      thread_state_awake_to_awake_no_nest (ts1);
+    }
+  }
+  thread_state_asleep (ts1);
+  ddsrt_mutex_lock (&dc->lock);
+  dc->replaying = false;
+  ddsrt_mutex_unlock (&dc->lock);
+}
+
+static void dcache_confirm_timeout (struct xevent *xev, void *varg, ddsrt_mtime_t tnow)
+{
+  struct ddsi_discovery_cache * const dc = varg;
+  struct ddsi_domaingv * const gv = dc->gv;
+  const ddsrt_wctime_t timestamp = ddsrt_time_wallclock ();
+  ddsi_guid_t *guids;
+  uint32_t n = 0, nmax = 0;
+  ddsrt_avl_iter_t it;
+  struct dcache_entry *e;
+  (void) xev;
+  (void) tnow;
+
+  ddsrt_mutex_lock (&dc->lock);
+  for (e = ddsrt_avl_iter_first (&dcache_treedef, &dc->entries, &it); e; e = ddsrt_avl_iter_next (&it))
+    nmax++;
+  guids = ddsrt_malloc ((nmax > 0 ? nmax : 1) * sizeof (*guids));
+  for (e = ddsrt_avl_iter_first (&dcache_treedef, &dc->entries, &it); e; e = ddsrt_avl_iter_next (&it))
+    if (!e->confirmed)
+      guids[n++] = e->rec.guid;
+  ddsrt_mutex_unlock (&dc->lock);
+
+  /* Anything that hasn't been confirmed by now is treated as if its lease expired;
+     deleting a proxy participant takes care of its endpoints and deleting the proxy
+     entities removes the entries from the cache */
+  GVLOGDISC ("discovery cache: %"PRIu32" unconfirmed entries\n", n);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    if (guids[i].entityid.u == NN_ENTITYID_PARTICIPANT)
+      (void) delete_proxy_participant_by_guid (gv, &guids[i], timestamp, 1);
+    else if (is_writer_entityid (guids[i].entityid))
+      (void) delete_proxy_writer (gv, &guids[i], timestamp, 1);
+    else
+      (void) delete_proxy_reader (gv, &guids[i], timestamp, 1);
+    ddsi_discovery_cache_remove (dc, &guids[i]);
+  }
+  ddsrt_free (guids);
+}
+
+static void dcache_write_file (struct ddsi_discovery_cache *dc)
+{
+  DDSRT_WARNING_MSVC_OFF(4996);
+  struct ddsi_domaingv * const gv = dc->gv;
+  struct dcache_file_hdr hdr;
+  unsigned char *buf;
+  size_t bufsz = sizeof (hdr), pos = 0;
+  ddsrt_avl_iter_t it;
+  struct dcache_entry *e;
+  uint32_t n = 0;
+  char *tmpname;
+  FILE *fp;
+
+  /* Serialize into memory while holding the lock and do the file I/O outside it,
+     to avoid blocking discovery processing on disk writes */
+  ddsrt_mutex_lock (&dc->lock);
+  if (!dc->dirty)
+  {
+    ddsrt_mutex_unlock (&dc->lock);
+    return;
+  }
+  for (e = ddsrt_avl_iter_first (&dcache_treedef, &dc->entries, &it); e; e = ddsrt_avl_iter_next (&it))
+    if (e->confirmed)
+      bufsz += sizeof (e->rec) + e->rec.size;
+  buf = ddsrt_malloc (bufsz);
+  hdr.magic = DCACHE_MAGIC;
+  hdr.version = DCACHE_VERSION;
+  hdr.rec_size = (uint32_t) sizeof (struct dcache_rec);
+  hdr.domain_id = gv->config.domainId;
+  memcpy (buf + pos, &hdr, sizeof (hdr)); pos += sizeof (hdr);
+  for (e = ddsrt_avl_iter_first (&dcache_treedef, &dc->entries, &it); e; e = ddsrt_avl_iter_next (&it))
+  {
+    if (!e->confirmed)
+      continue;
+    memcpy (buf + pos, &e->rec, sizeof (e->rec)); pos += sizeof (e->rec);
+    memcpy (buf + pos, e->payload, e->rec.size); pos += e->rec.size;
+    n++;
+  }
+  assert (pos == bufsz);
+  dc->dirty = false;
+  ddsrt_mutex_unlock (&dc->lock);
+
+  /* Write a temporary file and rename it, so a crash while writing never
+     leaves a half-written cache behind */
+  (void) ddsrt_asprintf (&tmpname, "%s.tmp", gv->config.discovery_cache_file);
+  if ((fp = fopen (tmpname, "wb")) == NULL)
+    GVWARNING ("discovery cache: %s could not be opened for writing\n", tmpname);
+  else
+  {
+    const bool ok = (fwrite (buf, bufsz, 1, fp) == 1);
+    if (fclose (fp) != 0 || !ok)
+      GVWARNING ("discovery cache: write to %s failed\n", tmpname);
+    else
+    {
+#ifdef _WIN32
+      (void) remove (gv->config.discovery_cache_file);
+#endif
+      if (rename (tmpname, gv->config.discovery_cache_file) != 0)
+        GVWARNING ("discovery cache: rename of %s failed\n", tmpname);
+      else
+        GVLOGDISC ("discovery cache: wrote %"PRIu32" entries to %s\n", n, gv->config.discovery_cache_file);
+    }
+  }
+  ddsrt_free (tmpname);
+  ddsrt_free (buf);
+  DDSRT_WARNING_MSVC_ON(4996);
+}
+
+static void dcache_write_periodic (struct xevent *xev, void *varg, ddsrt_mtime_t tnow)
+{
+  struct ddsi_discovery_cache * const dc = varg;
+  dcache_write_file (dc);
+  (void) resched_xevent_if_earlier (xev, ddsrt_mtime_add_duration (tnow, dc->gv->config.discovery_cache_write_interval));
+}
+
+void ddsi_discovery_cache_start (struct ddsi_discovery_cache *dc)
+{
+  struct ddsi_domaingv * const gv = dc->gv;
+  const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  if (dcache_read_file (dc))
+  {
+    dcache_replay (dc);
+    dc->confirm_xev = qxev_callback (gv->xevents, ddsrt_mtime_add_duration (tnow, gv->config.discovery_cache_confirm_timeout), dcache_confirm_timeout, dc);
+  }
+  dc->write_xev = qxev_callback (gv->xevents, ddsrt_mtime_add_duration (tnow, gv->config.discovery_cache_write_interval), dcache_write_periodic, dc);
+}
+
+void ddsi_discovery_cache_stop (struct ddsi_discovery_cache *dc)
+{
+  if (dc->confirm_xev)
+  {
+    delete_xevent_callback (dc->confirm_xev);
+    dc->confirm_xev = NULL;
+  }
+  if (dc->write_xev)
+  {
+    delete_xevent_callback (dc->write_xev);
+    dc->write_xev = NULL;
+  }
+  dcache_write_file (dc);
+}
+
+void ddsi_discovery_cache_update (struct ddsi_discovery_cache *dc, const ddsi_guid_t *guid, const struct receiver_state *rst, seqno_t seq, const void *payload, uint32_t size)
+{
+  struct dcache_entry *e;
+  ddsrt_avl_ipath_t path;
+  ddsrt_mutex_lock (&dc->lock);
+  if (dc->replaying)
+  {
+    ddsrt_mutex_unlock (&dc->lock);
+    return;
+  }
+  if ((e = ddsrt_avl_lookup_ipath (&dcache_treedef, &dc->entries, guid, &path)) == NULL)
+  {
+    e = ddsrt_malloc (sizeof (*e));
+    e->rec.guid = *guid;
+    e->rec.size = 0;
+    e->payload = NULL;
+    ddsrt_avl_insert_ipath (&dcache_treedef, &dc->entries, e, &path);
+  }
+  else if (e->confirmed && e->rec.seq == seq && e->rec.size == size)
+  {
+    /* periodic SPDP and retransmitted SEDP: nothing changed */
+    ddsrt_mutex_unlock (&dc->lock);
+    return;
+  }
+  e->rec.src_guid_prefix = rst->src_guid_prefix;
+  e->rec.vendor = rst->vendor;
+  e->rec.protocol_version = rst->protocol_version;
+  e->rec.srcloc = rst->srcloc;
+  e->rec.seq = seq;
+  if (e->rec.size != size)
+  {
+    e->payload = ddsrt_realloc (e->payload, size);
+    e->rec.size = size;
+  }
+  memcpy (e->payload, payload, size);
+  e->confirmed = true;
+  dc->dirty = true;
+  ddsrt_mutex_unlock (&dc->lock);
+}
+
+void ddsi_discovery_cache_remove (struct ddsi_discovery_cache *dc, const ddsi_guid_t *guid)
+{
+  struct dcache_entry *e;
+  ddsrt_avl_dpath_t path;
+  ddsrt_mutex_lock (&dc->lock);
+  /* the replay iterates over the entries without holding the lock; whatever gets
+     deleted while replaying is removed by the confirmation timeout instead */
+  if (!dc->replaying && (e = ddsrt_avl_lookup_dpath (&dcache_treedef, &dc->entries, guid, &path)) != NULL)
+  {
+    ddsrt_avl_delete_dpath (&dcache_treedef, &dc->entries, e, &path);
+    free_entry (e);
+    dc->dirty = true;
+  }
+  ddsrt_mutex_unlock (&dc->lock);
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stddef.h>
+#include <assert.h>
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/avl.h"
+#include "dds/ddsi/ddsi_expiry.h"
+
+struct expiry_bucket {
+  ddsrt_avl_node_t avlnode;
+  int64_t idx;                        /* covers [tstart, tstart + granularity) */
+  int64_t tstart;                     /* idx * granularity */
+  struct expiry_node *first, *last;   /* unordered, never empty */
+};
+
+static int compare_bucket_idx (const void *va, const void *vb)
+{
+  const int64_t *a = va;
+  const int64_t *b = vb;
+  return (*a == *b) ? 0 : (*a < *b) ? -1 : 1;
+}
+
+static const ddsrt_avl_treedef_t expiry_bucket_td = DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct expiry_bucket, avlnode), offsetof (struct expiry_bucket, idx), compare_bucket_idx, 0);
+
+void expiry_adm_init (struct expiry_adm *adm, dds_duration_t granularity)
+{
+  ddsrt_avl_init (&expiry_bucket_td, &adm->buckets);
+  adm->latest = NULL;
+  adm->granularity = (granularity > 0) ? granularity : 1;
+}
+
+void expiry_adm_fini (struct expiry_adm *adm)
+{
+  /* all nodes are owned by the caller, so freeing a non-empty administration
+     would leave dangling pointers in them */
+  assert (expiry_adm_empty (adm));
+  ddsrt_avl_free (&expiry_bucket_td, &adm->buckets, ddsrt_free);
+}
+
+bool expiry_adm_empty (const struct expiry_adm *adm)
+{
+  return ddsrt_avl_is_empty (&adm->buckets);
+}
+
+static bool in_bucket (const struct expiry_adm *adm, const struct expiry_bucket *b, ddsrt_mtime_t t)
+{
+  return t.v >= b->tstart && t.v - b->tstart < adm->granularity;
+}
+
+static int64_t bucket_idx (const struct expiry_adm *adm, ddsrt_mtime_t t)
+{
+  assert (t.v >= 0 && t.v != DDS_NEVER);
+  return t.v / adm->granularity;
+}
+
+static ddsrt_mtime_t bucket_due (const struct expiry_adm *adm, int64_t idx)
+{
+  /* last time covered by the bucket, avoiding DDS_NEVER/overflow */
+  const int64_t start = idx * adm->granularity;
+  if (start >= DDS_NEVER - (adm->granularity - 1))
+    return (ddsrt_mtime_t) { DDS_NEVER - 1 };
+  return (ddsrt_mtime_t) { start + adm->granularity - 1 };
+}
+
+ddsrt_mtime_t expiry_due_time (const struct expiry_adm *adm, ddsrt_mtime_t t)
+{
+  return bucket_due (adm, bucket_idx (adm, t));
+}
+
+ddsrt_mtime_t expiry_insert (struct expiry_adm *adm, struct expiry_node *node, ddsrt_mtime_t t)
+{
+  struct expiry_bucket *b;
+  if (adm->latest != NULL && in_bucket (adm, adm->latest, t))
+    b = adm->latest;
+  else
+  {
+    const int64_t idx = bucket_idx (adm, t);
+    ddsrt_avl_ipath_t path;
+    if ((b = ddsrt_avl_lookup_ipath (&expiry_bucket_td, &adm->buckets, &idx, &path)) == NULL)
+    {
+      b = ddsrt_malloc (sizeof (*b));
+      b->idx = idx;
+      b->tstart = idx * adm->granularity;
+      b->first = b->last = NULL;
+      ddsrt_avl_insert_ipath (&expiry_bucket_td, &adm->buckets, b, &path);
+    }
+    adm->latest = b;
+  }
+  node->bucket = b;
+  node->next = NULL;
+  node->prev = b->last;
+  if (b->last)
+    b->last->next = node;
+  else
+    b->first = node;
+  b->last = node;
+  return bucket_due (adm, b->idx);
+}
+
+void expiry_remove (struct expiry_adm *adm, struct expiry_node *node)
+{
+  struct expiry_bucket * const b = node->bucket;
+  assert (b != NULL);
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    b->first = node->next;
+  if (node->next)
+    node->next->prev = node->prev;
+  else
+    b->last = node->prev;
+  node->bucket = NULL;
+  if (b->first == NULL)
+  {
+    ddsrt_avl_delete (&expiry_bucket_td, &adm->buckets, b);
+    if (adm->latest == b)
+      adm->latest = NULL;
+    ddsrt_free (b);
+  }
+}
+
+void expiry_move (struct expiry_adm *adm, struct expiry_node *node, ddsrt_mtime_t t)
+{
+  assert (node->bucket != NULL);
+  if (!in_bucket (adm, node->bucket, t))
+  {
+    expiry_remove (adm, node);
+    (void) expiry_insert (adm, node, t);
+  }
+}
+
+struct expiry_node *expiry_next_due (const struct expiry_adm *adm, ddsrt_mtime_t tnow, ddsrt_mtime_t *tnext)
+{
+  const struct expiry_bucket *b;
+  if ((b = ddsrt_avl_find_min (&expiry_bucket_td, &adm->buckets)) == NULL)
+  {
+    *tnext = DDSRT_MTIME_NEVER;
+    return NULL;
+  }
+  *tnext = bucket_due (adm, b->idx);
+  return (tnext->v <= tnow.v) ? b->first : NULL;
+}
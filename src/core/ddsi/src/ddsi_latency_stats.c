@@ -0,0 +1,222 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/ddsi_latency_stats.h"
+
+#define HIST_SUBCOUNT (1 << DDSI_LATENCY_HIST_SUBBITS)
+#define HIST_MAXVAL ((INT64_C (1) << DDSI_LATENCY_HIST_MAXBITS) - 1)
+
+const char *ddsi_latency_stage_name (enum ddsi_latency_stage stage)
+{
+  switch (stage)
+  {
+    case DDSI_LATENCY_SERIALIZE: return "serialize";
+    case DDSI_LATENCY_WHC_INSERT: return "whc-insert";
+    case DDSI_LATENCY_XPACK: return "xpack";
+    case DDSI_LATENCY_SEND: return "send";
+    case DDSI_LATENCY_RECEIVE: return "receive";
+    case DDSI_LATENCY_DEFRAG: return "defrag";
+    case DDSI_LATENCY_DQUEUE: return "dqueue";
+    case DDSI_LATENCY_RHC_INSERT: return "rhc-insert";
+  }
+  return "?";
+}
+
+static uint32_t hist_log2 (uint64_t v)
+{
+  uint32_t n = 0;
+  if (v >= (UINT64_C (1) << 32)) { v >>= 32; n += 32; }
+  if (v >= (UINT64_C (1) << 16)) { v >>= 16; n += 16; }
+  if (v >= (UINT64_C (1) << 8)) { v >>= 8; n += 8; }
+  if (v >= (UINT64_C (1) << 4)) { v >>= 4; n += 4; }
+  if (v >= (UINT64_C (1) << 2)) { v >>= 2; n += 2; }
+  if (v >= (UINT64_C (1) << 1)) { n += 1; }
+  return n;
+}
+
+static uint32_t hist_bucket (int64_t dt)
+{
+  /* values below 2^SUBBITS each have their own bucket, above that there are
+     2^SUBBITS buckets for each power of two; values are clamped to the range
+     covered by the histogram (a negative value can only result from a clock
+     oddity) */
+  const uint64_t v = (dt < 0) ? 0 : (dt > HIST_MAXVAL) ? (uint64_t) HIST_MAXVAL : (uint64_t) dt;
+  if (v < HIST_SUBCOUNT)
+    return (uint32_t) v;
+  const uint32_t e = hist_log2 (v);
+  const uint32_t sub = (uint32_t) (v >> (e - DDSI_LATENCY_HIST_SUBBITS)) & (HIST_SUBCOUNT - 1);
+  return ((e - DDSI_LATENCY_HIST_SUBBITS + 1) << DDSI_LATENCY_HIST_SUBBITS) + sub;
+}
+
+static int64_t hist_bucket_upper (uint32_t idx)
+{
+  if (idx < HIST_SUBCOUNT)
+    return (int64_t) idx;
+  const uint32_t shift = (idx >> DDSI_LATENCY_HIST_SUBBITS) - 1;
+  const uint64_t lower = (uint64_t) (HIST_SUBCOUNT + (idx & (HIST_SUBCOUNT - 1))) << shift;
+  return (int64_t) (lower + (UINT64_C (1) << shift) - 1);
+}
+
+void ddsi_latency_hist_init (struct ddsi_latency_hist *h)
+{
+  memset (h, 0, sizeof (*h));
+  h->min = INT64_MAX;
+}
+
+void ddsi_latency_hist_add (struct ddsi_latency_hist *h, int64_t dt)
+{
+  h->count++;
+  h->sum += dt;
+  if (dt < h->min)
+    h->min = dt;
+  if (dt > h->max)
+    h->max = dt;
+  h->buckets[hist_bucket (dt)]++;
+}
+
+void ddsi_latency_hist_merge (struct ddsi_latency_hist *dst, const struct ddsi_latency_hist *src)
+{
+  if (src->count == 0)
+    return;
+  dst->count += src->count;
+  dst->sum += src->sum;
+  if (src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+  for (uint32_t i = 0; i < DDSI_LATENCY_HIST_NBUCKETS; i++)
+    dst->buckets[i] += src->buckets[i];
+}
+
+int64_t ddsi_latency_hist_percentile (const struct ddsi_latency_hist *h, double p)
+{
+  if (h->count == 0)
+    return 0;
+  /* rank of the value, counting from 1: the smallest n for which n/count >= p */
+  uint64_t rank = (uint64_t) (p * (double) h->count);
+  if ((double) rank < p * (double) h->count)
+    rank++;
+  if (rank < 1)
+    rank = 1;
+  else if (rank > h->count)
+    rank = h->count;
+  uint64_t acc = 0;
+  for (uint32_t i = 0; i < DDSI_LATENCY_HIST_NBUCKETS; i++)
+  {
+    if ((acc += h->buckets[i]) >= rank)
+    {
+      /* upper bound of the bucket, but never outside the observed range */
+      const int64_t v = hist_bucket_upper (i);
+      return (v > h->max) ? h->max : (v < h->min) ? h->min : v;
+    }
+  }
+  return h->max;
+}
+
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+
+static void stats_init (struct ddsi_latency_stats *st)
+{
+  for (int i = 0; i < DDSI_LATENCY_NSTAGES; i++)
+    ddsi_latency_hist_init (&st->stage[i]);
+}
+
+static void stats_merge (struct ddsi_latency_stats *dst, const struct ddsi_latency_stats *src)
+{
+  for (int i = 0; i < DDSI_LATENCY_NSTAGES; i++)
+    ddsi_latency_hist_merge (&dst->stage[i], &src->stage[i]);
+}
+
+int64_t ddsi_latency_stats_lap (enum ddsi_latency_stage stage, int64_t tstart)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  struct ddsi_latency_stats *st = ddsrt_atomic_ldvoidp (&ts1->latstats);
+  const int64_t tnow = ddsrt_time_monotonic ().v;
+  if (st == NULL)
+  {
+    /* only the owning thread ever sets it, readers hold thread_states.lock and
+       the thread state is only reaped when the thread no longer uses it */
+    st = ddsrt_malloc (sizeof (*st));
+    stats_init (st);
+    ddsrt_atomic_stvoidp (&ts1->latstats, st);
+  }
+  ddsi_latency_hist_add (&st->stage[stage], tnow - tstart);
+  return tnow;
+}
+
+void ddsi_latency_stats_retire (struct thread_state1 *ts1)
+{
+  /* called with thread_states.lock held */
+  struct ddsi_latency_stats *st;
+  if ((st = ddsrt_atomic_ldvoidp (&ts1->latstats)) == NULL)
+    return;
+  if (thread_states.latstats_retired == NULL)
+  {
+    thread_states.latstats_retired = ddsrt_malloc (sizeof (*thread_states.latstats_retired));
+    stats_init (thread_states.latstats_retired);
+  }
+  stats_merge (thread_states.latstats_retired, st);
+  ddsrt_atomic_stvoidp (&ts1->latstats, NULL);
+  ddsrt_free (st);
+}
+
+void ddsi_latency_stats_fini (void)
+{
+  /* called when the thread states are freed */
+  ddsrt_free (thread_states.latstats_retired);
+  thread_states.latstats_retired = NULL;
+}
+
+bool ddsi_latency_stats_get_thread (uint32_t idx, char *name, size_t namesize, struct ddsi_latency_stats *st)
+{
+  bool found = false;
+  if (thread_states.ts == NULL)
+    return false;
+  ddsrt_mutex_lock (&thread_states.lock);
+  if (idx < thread_states.nthreads && thread_states.ts[idx].state != THREAD_STATE_ZERO)
+  {
+    const struct ddsi_latency_stats *tst = ddsrt_atomic_ldvoidp (&thread_states.ts[idx].latstats);
+    if (tst != NULL)
+    {
+      *st = *tst;
+      (void) ddsrt_strlcpy (name, thread_states.ts[idx].name, namesize);
+      found = true;
+    }
+  }
+  ddsrt_mutex_unlock (&thread_states.lock);
+  return found;
+}
+
+void ddsi_latency_stats_get_all (struct ddsi_latency_stats *st)
+{
+  stats_init (st);
+  if (thread_states.ts == NULL)
+    return;
+  ddsrt_mutex_lock (&thread_states.lock);
+  if (thread_states.latstats_retired)
+    stats_merge (st, thread_states.latstats_retired);
+  for (uint32_t i = 0; i < thread_states.nthreads; i++)
+  {
+    const struct ddsi_latency_stats *tst;
+    if (thread_states.ts[i].state != THREAD_STATE_ZERO && (tst = ddsrt_atomic_ldvoidp (&thread_states.ts[i].latstats)) != NULL)
+      stats_merge (st, tst);
+  }
+  ddsrt_mutex_unlock (&thread_states.lock);
+}
+
+#endif /* DDSI_INCLUDE_LATENCY_STATS */
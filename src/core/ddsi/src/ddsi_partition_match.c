@@ -0,0 +1,331 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsi/ddsi_xqos.h"
+#include "dds/ddsi/q_misc.h"
+#include "dds/ddsi/ddsi_partition_match.h"
+
+/* Match results are cached in a direct-mapped table indexed by a hash of the
+   pair of set ids, a colliding pair simply replaces the old entry.  Set ids are
+   never reused (and 0 is never used), so stale entries for deleted sets are
+   harmless and there is nothing to invalidate. */
+#define PM_RESULT_CACHE_LG2 12
+
+struct pm_name {
+  uint64_t id;
+  uint32_t hash;
+  uint32_t refc;
+  uint32_t len;
+  char str[];
+};
+
+struct pm_pattern {
+  const struct pm_name *name;
+  uint32_t prefixlen; /* literal characters preceding the first wildcard */
+  uint32_t minlen; /* minimum length of a matching name: number of non-'*' characters */
+  bool anylen; /* contains a '*', else only names of length minlen can match */
+  bool prefix_only; /* literal prefix followed by a single '*' */
+};
+
+struct ddsi_partition_set {
+  uint64_t id;
+  uint32_t hash;
+  uint32_t refc;
+  uint32_t n;
+  char * const *strs; /* partition names as in the QoS, for interning */
+  uint32_t nplain;
+  const struct pm_name **plain; /* names without wildcards, sorted on id */
+  uint32_t nwild;
+  struct pm_pattern *wild; /* names with wildcards */
+};
+
+struct pm_result {
+  uint64_t a, b;
+  bool match;
+};
+
+struct ddsi_partition_match_cache {
+  ddsrt_mutex_t lock;
+  uint64_t next_name_id;
+  uint64_t next_set_id;
+  struct ddsrt_hh *names;
+  struct ddsrt_hh *sets;
+  struct pm_result results[1u << PM_RESULT_CACHE_LG2];
+};
+
+static uint32_t pm_name_hash (const void *vn)
+{
+  const struct pm_name *n = vn;
+  return n->hash;
+}
+
+static int pm_name_equal (const void *va, const void *vb)
+{
+  const struct pm_name *a = va, *b = vb;
+  return a->len == b->len && memcmp (a->str, b->str, a->len) == 0;
+}
+
+static uint32_t pm_set_hash (const void *vs)
+{
+  const struct ddsi_partition_set *s = vs;
+  return s->hash;
+}
+
+static int pm_set_equal (const void *va, const void *vb)
+{
+  const struct ddsi_partition_set *a = va, *b = vb;
+  if (a->n != b->n)
+    return 0;
+  for (uint32_t i = 0; i < a->n; i++)
+    if (strcmp (a->strs[i], b->strs[i]) != 0)
+      return 0;
+  return 1;
+}
+
+struct ddsi_partition_match_cache *ddsi_partition_match_cache_new (void)
+{
+  struct ddsi_partition_match_cache *pmc = ddsrt_malloc (sizeof (*pmc));
+  ddsrt_mutex_init (&pmc->lock);
+  pmc->next_name_id = 1;
+  pmc->next_set_id = 1;
+  pmc->names = ddsrt_hh_new (1, pm_name_hash, pm_name_equal);
+  pmc->sets = ddsrt_hh_new (1, pm_set_hash, pm_set_equal);
+  memset (pmc->results, 0, sizeof (pmc->results));
+  return pmc;
+}
+
+void ddsi_partition_match_cache_free (struct ddsi_partition_match_cache *pmc)
+{
+#ifndef NDEBUG
+  {
+    struct ddsrt_hh_iter it;
+    assert (ddsrt_hh_iter_first (pmc->sets, &it) == NULL);
+    assert (ddsrt_hh_iter_first (pmc->names, &it) == NULL);
+  }
+#endif
+  ddsrt_hh_free (pmc->sets);
+  ddsrt_hh_free (pmc->names);
+  ddsrt_mutex_destroy (&pmc->lock);
+  ddsrt_free (pmc);
+}
+
+static bool is_wildcard_partition (const char *str)
+{
+  return strchr (str, '*') || strchr (str, '?');
+}
+
+static struct pm_name *pm_name_ref (struct ddsi_partition_match_cache *pmc, const char *str)
+{
+  const size_t len = strlen (str);
+  struct pm_name *n = ddsrt_malloc (sizeof (*n) + len + 1);
+  n->hash = ddsrt_mh3 (str, len, 0);
+  n->len = (uint32_t) len;
+  memcpy (n->str, str, len + 1);
+  struct pm_name *x;
+  if ((x = ddsrt_hh_lookup (pmc->names, n)) != NULL)
+  {
+    ddsrt_free (n);
+    x->refc++;
+    return x;
+  }
+  n->id = pmc->next_name_id++;
+  n->refc = 1;
+  ddsrt_hh_add (pmc->names, n);
+  return n;
+}
+
+static void pm_name_unref (struct ddsi_partition_match_cache *pmc, const struct pm_name *cn)
+{
+  struct pm_name *n = (struct pm_name *) cn;
+  if (--n->refc == 0)
+  {
+    ddsrt_hh_remove (pmc->names, n);
+    ddsrt_free (n);
+  }
+}
+
+static void pm_pattern_init (struct pm_pattern *p, const struct pm_name *name)
+{
+  const char *s = name->str;
+  uint32_t i, nstar = 0;
+  p->name = name;
+  for (i = 0; s[i] != '*' && s[i] != '?'; i++)
+    ;
+  p->prefixlen = i;
+  p->minlen = 0;
+  for (i = 0; s[i]; i++)
+  {
+    if (s[i] == '*')
+      nstar++;
+    else
+      p->minlen++;
+  }
+  p->anylen = (nstar > 0);
+  p->prefix_only = (nstar == 1 && s[p->prefixlen] == '*' && s[p->prefixlen + 1] == 0);
+}
+
+static bool pm_pattern_match (const struct pm_pattern *p, const struct pm_name *name)
+{
+  if (name->len < p->minlen || (!p->anylen && name->len != p->minlen))
+    return false;
+  if (memcmp (name->str, p->name->str, p->prefixlen) != 0)
+    return false;
+  return p->prefix_only || ddsi2_patmatch (p->name->str + p->prefixlen, name->str + p->prefixlen);
+}
+
+static int compare_name_id (const void *va, const void *vb)
+{
+  const struct pm_name * const *a = va;
+  const struct pm_name * const *b = vb;
+  return ((*a)->id == (*b)->id) ? 0 : ((*a)->id < (*b)->id) ? -1 : 1;
+}
+
+static uint32_t pm_strs_hash (uint32_t n, char * const *strs)
+{
+  uint32_t h = n;
+  for (uint32_t i = 0; i < n; i++)
+    h = ddsrt_mh3 (strs[i], strlen (strs[i]) + 1, h);
+  return h;
+}
+
+struct ddsi_partition_set *ddsi_partition_set_ref (struct ddsi_partition_match_cache *pmc, const struct dds_qos *qos)
+{
+  /* The default partition matches exactly like a partition with an empty name,
+     using that representation avoids special-casing it everywhere */
+  static char empty[] = "";
+  static char * const default_strs[] = { empty };
+  struct ddsi_partition_set template, *ps;
+  if ((qos->present & QP_PARTITION) && qos->partition.n > 0)
+  {
+    template.n = qos->partition.n;
+    template.strs = qos->partition.strs;
+  }
+  else
+  {
+    template.n = 1;
+    template.strs = default_strs;
+  }
+  template.hash = pm_strs_hash (template.n, template.strs);
+
+  ddsrt_mutex_lock (&pmc->lock);
+  if ((ps = ddsrt_hh_lookup (pmc->sets, &template)) != NULL)
+  {
+    ps->refc++;
+    ddsrt_mutex_unlock (&pmc->lock);
+    return ps;
+  }
+
+  ps = ddsrt_malloc (sizeof (*ps));
+  ps->id = pmc->next_set_id++;
+  ps->hash = template.hash;
+  ps->refc = 1;
+  ps->n = template.n;
+  ps->plain = ddsrt_malloc (template.n * sizeof (*ps->plain));
+  ps->wild = ddsrt_malloc (template.n * sizeof (*ps->wild));
+  char **strs = ddsrt_malloc (template.n * sizeof (*strs));
+  ps->nplain = ps->nwild = 0;
+  for (uint32_t i = 0; i < template.n; i++)
+  {
+    struct pm_name * const name = pm_name_ref (pmc, template.strs[i]);
+    strs[i] = name->str;
+    if (!is_wildcard_partition (name->str))
+      ps->plain[ps->nplain++] = name;
+    else
+      pm_pattern_init (&ps->wild[ps->nwild++], name);
+  }
+  ps->strs = strs;
+  qsort ((void *) ps->plain, ps->nplain, sizeof (*ps->plain), compare_name_id);
+  ddsrt_hh_add (pmc->sets, ps);
+  ddsrt_mutex_unlock (&pmc->lock);
+  return ps;
+}
+
+void ddsi_partition_set_unref (struct ddsi_partition_match_cache *pmc, struct ddsi_partition_set *ps)
+{
+  ddsrt_mutex_lock (&pmc->lock);
+  if (--ps->refc == 0)
+  {
+    ddsrt_hh_remove (pmc->sets, ps);
+    for (uint32_t i = 0; i < ps->nplain; i++)
+      pm_name_unref (pmc, ps->plain[i]);
+    for (uint32_t i = 0; i < ps->nwild; i++)
+      pm_name_unref (pmc, ps->wild[i].name);
+    ddsrt_free ((void *) ps->strs);
+    ddsrt_free ((void *) ps->plain);
+    ddsrt_free (ps->wild);
+    ddsrt_free (ps);
+  }
+  ddsrt_mutex_unlock (&pmc->lock);
+}
+
+static bool pm_match_wild_plain (const struct ddsi_partition_set *a, const struct ddsi_partition_set *b)
+{
+  /* a wildcard expression never matches another wildcard expression, so only
+     the names without wildcards in b need to be considered */
+  for (uint32_t i = 0; i < a->nwild; i++)
+    for (uint32_t j = 0; j < b->nplain; j++)
+      if (pm_pattern_match (&a->wild[i], b->plain[j]))
+        return true;
+  return false;
+}
+
+static bool pm_sets_match (const struct ddsi_partition_set *a, const struct ddsi_partition_set *b)
+{
+  uint32_t i = 0, j = 0;
+  while (i < a->nplain && j < b->nplain)
+  {
+    if (a->plain[i]->id == b->plain[j]->id)
+      return true;
+    else if (a->plain[i]->id < b->plain[j]->id)
+      i++;
+    else
+      j++;
+  }
+  return pm_match_wild_plain (a, b) || pm_match_wild_plain (b, a);
+}
+
+bool ddsi_partition_sets_match (struct ddsi_partition_match_cache *pmc, const struct ddsi_partition_set *a, const struct ddsi_partition_set *b)
+{
+  /* matching is symmetrical, normalize the order to double the hit rate */
+  if (a->id > b->id)
+  {
+    const struct ddsi_partition_set *t = a; a = b; b = t;
+  }
+  const uint64_t h = ((a->id * UINT64_C (0x9e3779b97f4a7c15)) ^ b->id) * UINT64_C (0xbf58476d1ce4e5b9);
+  struct pm_result * const r = &pmc->results[h >> (64 - PM_RESULT_CACHE_LG2)];
+  bool match;
+  ddsrt_mutex_lock (&pmc->lock);
+  if (r->a == a->id && r->b == b->id)
+  {
+    match = r->match;
+    ddsrt_mutex_unlock (&pmc->lock);
+    return match;
+  }
+  ddsrt_mutex_unlock (&pmc->lock);
+
+  /* the sets themselves are immutable and the caller holds references to them,
+     so the evaluation doesn't need the lock */
+  match = pm_sets_match (a, b);
+  ddsrt_mutex_lock (&pmc->lock);
+  r->a = a->id;
+  r->b = b->id;
+  r->match = match;
+  ddsrt_mutex_unlock (&pmc->lock);
+  return match;
+}
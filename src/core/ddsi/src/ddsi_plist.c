@@ -298,6 +298,13 @@ static dds_return_t deser_locator (void * __restrict dst, size_t * __restrict ds
   struct dd tmpdd = *dd;
   tmpdd.buf += *srcoff;
   tmpdd.bufsz -= *srcoff;
+  /* do_locator silently drops locators of unsupported kinds, but the flag gets set
+     regardless and so the list must be initialized before the first one */
+  if (!(*flagset->present & flag))
+  {
+    x->n = 0;
+    x->first = x->last = NULL;
+  }
   if (do_locator (x, flagset->present, flagset->wanted, flag, &tmpdd, dd->factory) < 0)
     return DDS_RETCODE_BAD_PARAMETER;
   *srcoff += 24;
@@ -1349,6 +1356,13 @@ static dds_return_t dvx_endpoint_guid (void * __restrict dst, const struct dd *
   }
 }
 
+static dds_return_t dvx_coherent_set_seqno (void * __restrict dst, const struct dd * __restrict dd)
+{
+  const nn_sequence_number_t *sn = dst;
+  (void) dd;
+  return (fromSN (*sn) > 0) ? 0 : DDS_RETCODE_BAD_PARAMETER;
+}
+
 #ifdef DDSI_INCLUDE_SSM
 static dds_return_t dvx_reader_favours_ssm (void * __restrict dst, const struct dd * __restrict dd)
 {
@@ -1411,6 +1425,7 @@ static const struct piddesc piddesc_omg[] = {
 #endif
   PP  (DOMAIN_ID,                           domain_id, Xu),
   PP  (DOMAIN_TAG,                          domain_tag, XS),
+  PPV (COHERENT_SET,                        coherent_set_seqno, Xi, Xu),
   { PID_STATUSINFO, PDF_FUNCTION, PP_STATUSINFO, "STATUSINFO",
     offsetof (struct ddsi_plist, statusinfo), membersize (struct ddsi_plist, statusinfo),
     { .f = { .deser = deser_statusinfo, .ser = ser_statusinfo, .print = print_statusinfo } }, 0 },
@@ -2678,6 +2693,49 @@ const unsigned char *ddsi_plist_findparam_native_unchecked (const void *src, nn_
   return (unsigned char *) (par + 1);
 }
 
+dds_return_t ddsi_plist_findparam_checking (const void *buf, size_t bufsz, uint16_t encoding, nn_parameterid_t needle, void **needlep, size_t *needlesz)
+{
+  /* Scans the parameter list in buf looking just for needle, setting *needlep to the address of
+     its value (and *needlesz to its length) or to NULL if not found.  Only the structure of the
+     list is checked, not the contents of the parameters, and the scan stops at the first occurrence
+     of needle.  Meant for peeking at discovery data without the cost of decoding it. */
+  const unsigned char *pl = buf;
+  const unsigned char * const end = pl + bufsz;
+  bool bswap;
+  switch (encoding)
+  {
+    case PL_CDR_LE:
+      bswap = (DDSRT_ENDIAN != DDSRT_LITTLE_ENDIAN);
+      break;
+    case PL_CDR_BE:
+      bswap = (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN);
+      break;
+    default:
+      return DDS_RETCODE_BAD_PARAMETER;
+  }
+  *needlep = NULL;
+  while ((size_t) (end - pl) >= sizeof (nn_parameter_t))
+  {
+    nn_parameter_t par;
+    memcpy (&par, pl, sizeof (par));
+    const nn_parameterid_t pid = bswap ? ddsrt_bswap2u (par.parameterid) : par.parameterid;
+    const uint16_t length = bswap ? ddsrt_bswap2u (par.length) : par.length;
+    pl += sizeof (par);
+    if (pid == PID_SENTINEL)
+      return DDS_RETCODE_OK;
+    if (length > (size_t) (end - pl) || (length % 4) != 0)
+      return DDS_RETCODE_BAD_PARAMETER;
+    if (pid == needle)
+    {
+      *needlep = (void *) pl;
+      *needlesz = length;
+      return DDS_RETCODE_OK;
+    }
+    pl += length;
+  }
+  return DDS_RETCODE_BAD_PARAMETER;
+}
+
 unsigned char *ddsi_plist_quickscan (struct nn_rsample_info *dest, const struct nn_rmsg *rmsg, const ddsi_plist_src_t *src)
 {
   /* Sets a few fields in dest, returns address of first byte
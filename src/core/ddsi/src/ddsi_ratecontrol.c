@@ -0,0 +1,111 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <assert.h>
+#include <stdint.h>
+#include "dds/ddsi/q_unused.h"
+#include "dds/ddsi/ddsi_ratecontrol.h"
+
+/* Burst size: the bucket holds what can be sent in this time, but at least
+   enough for a typical sample so that small samples aren't delayed */
+#define RC_BURST_DURATION 0.005
+#define RC_MIN_BURST 65536.0
+
+/* Rate adjustments are made at most once per RTT, this is the RTT assumed
+   if the reader's is unknown and the lower bound on the reader's */
+#define RC_DEFAULT_RTT DDS_MSECS (10)
+#define RC_MIN_RTT DDS_MSECS (1)
+
+void ddsi_ratecontrol_init (struct ddsi_ratecontrol *rc, uint32_t min_rate, uint32_t max_rate, ddsrt_mtime_t tnow)
+{
+  rc->max_rate = (max_rate == 0 || max_rate > INT32_MAX) ? (double) INT32_MAX : (double) max_rate;
+  rc->min_rate = (min_rate == 0) ? 1.0 : (double) min_rate;
+  if (rc->min_rate > rc->max_rate)
+    rc->min_rate = rc->max_rate;
+  rc->rate = rc->max_rate;
+  rc->tokens = RC_MIN_BURST;
+  rc->tupdate = tnow;
+  rc->tadjust = tnow;
+  rc->limited = false;
+}
+
+void ddsi_ratecontrol_fini (UNUSED_ARG (struct ddsi_ratecontrol *rc))
+{
+}
+
+static double burst (const struct ddsi_ratecontrol *rc)
+{
+  const double b = rc->rate * RC_BURST_DURATION;
+  return (b > RC_MIN_BURST) ? b : RC_MIN_BURST;
+}
+
+dds_duration_t ddsi_ratecontrol_delay (struct ddsi_ratecontrol *rc, ddsrt_mtime_t tnow)
+{
+  if (tnow.v > rc->tupdate.v)
+  {
+    rc->tokens += rc->rate * (double) (tnow.v - rc->tupdate.v) / 1e9;
+    if (rc->tokens > burst (rc))
+      rc->tokens = burst (rc);
+    rc->tupdate = tnow;
+  }
+  if (rc->tokens >= 0)
+    return 0;
+  rc->limited = true;
+  return (dds_duration_t) (-rc->tokens * 1e9 / rc->rate) + 1;
+}
+
+void ddsi_ratecontrol_consume (struct ddsi_ratecontrol *rc, uint32_t nbytes)
+{
+  rc->tokens -= (double) nbytes;
+  if (rc->tokens < 0)
+    rc->limited = true;
+}
+
+static dds_duration_t adjust_interval (dds_duration_t rtt)
+{
+  if (rtt <= 0)
+    return RC_DEFAULT_RTT;
+  else if (rtt < RC_MIN_RTT)
+    return RC_MIN_RTT;
+  else
+    return rtt;
+}
+
+bool ddsi_ratecontrol_ack (struct ddsi_ratecontrol *rc, bool advanced, dds_duration_t rtt, ddsrt_mtime_t tnow)
+{
+  if (!advanced || !rc->limited || rc->rate >= rc->max_rate || tnow.v < rc->tadjust.v + adjust_interval (rtt))
+    return false;
+  rc->rate *= 1.125;
+  if (rc->rate > rc->max_rate)
+    rc->rate = rc->max_rate;
+  rc->tadjust = tnow;
+  rc->limited = false;
+  return true;
+}
+
+bool ddsi_ratecontrol_loss (struct ddsi_ratecontrol *rc, dds_duration_t rtt, ddsrt_mtime_t tnow)
+{
+  if (rc->rate <= rc->min_rate || tnow.v < rc->tadjust.v + adjust_interval (rtt))
+    return false;
+  rc->rate /= 2.0;
+  if (rc->rate < rc->min_rate)
+    rc->rate = rc->min_rate;
+  if (rc->tokens > burst (rc))
+    rc->tokens = burst (rc);
+  rc->tadjust = tnow;
+  rc->limited = false;
+  return true;
+}
+
+double ddsi_ratecontrol_rate (const struct ddsi_ratecontrol *rc)
+{
+  return rc->rate;
+}
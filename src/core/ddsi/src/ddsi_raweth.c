@@ -25,16 +25,39 @@
 #if defined(__linux) && !LWIP_SOCKET
 #include <linux/if_packet.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <ifaddrs.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <errno.h>
 
+/* TPACKET_ALIGN and TPACKET3_HDRLEN from linux/if_packet.h trip -Wsign-conversion */
+#define RAWETH_TP3_SLL_OFFSET (((sizeof (struct tpacket3_hdr)) + TPACKET_ALIGNMENT - 1) & ~((size_t) TPACKET_ALIGNMENT - 1))
+#define RAWETH_TP3_HDRLEN (RAWETH_TP3_SLL_OFFSET + sizeof (struct sockaddr_ll))
+
+/* Memory-mapped TPACKET_V3 receive rings: blocks are owned by the thread
+   calling read, which takes one frame per call and returns a block to the
+   kernel once it has taken all frames.  There is no transmit ring: the
+   destination address of a send applies to all frames queued in it, so every
+   frame would need a send of its own and a copy into the ring on top of it. */
+struct raweth_rings {
+  unsigned char *map;
+  size_t maplen;
+
+  struct tpacket_req3 rx;
+  unsigned char *rx_base;
+  uint32_t rx_block;
+  uint32_t rx_pkts_left;
+  struct tpacket3_hdr *rx_pkt;
+};
+
 typedef struct ddsi_raweth_conn {
   struct ddsi_tran_conn m_base;
   ddsrt_socket_t m_sock;
   int m_ifindex;
+  struct raweth_rings *m_rings;
 } *ddsi_raweth_conn_t;
 
 static char *ddsi_raweth_to_string (char *dst, size_t sizeof_dst, const nn_locator_t *loc, int with_port)
@@ -50,6 +73,73 @@ static char *ddsi_raweth_to_string (char *dst, size_t sizeof_dst, const nn_locat
   return dst;
 }
 
+static void set_srcloc (ddsi_tran_conn_t conn, nn_locator_t *srcloc, const struct sockaddr_ll *src)
+{
+  srcloc->tran = conn->m_factory;
+  srcloc->kind = NN_LOCATOR_KIND_RAWETH;
+  srcloc->port = ntohs (src->sll_protocol);
+  memset(srcloc->address, 0, 10);
+  memcpy(srcloc->address + 10, src->sll_addr, 6);
+}
+
+static void warn_truncated (ddsi_tran_conn_t conn, const struct sockaddr_ll *src, size_t size, size_t len)
+{
+  char addrbuf[DDSI_LOCSTRLEN];
+  (void) snprintf(addrbuf, sizeof(addrbuf), "[%02x:%02x:%02x:%02x:%02x:%02x]:%u",
+                  src->sll_addr[0], src->sll_addr[1], src->sll_addr[2],
+                  src->sll_addr[3], src->sll_addr[4], src->sll_addr[5], ntohs(src->sll_protocol));
+  DDS_CWARNING(&conn->m_base.gv->logconfig, "%s => %d truncated to %d\n", addrbuf, (int)size, (int)len);
+}
+
+static struct tpacket_block_desc *rx_block (const struct raweth_rings *r, uint32_t idx)
+{
+  return (struct tpacket_block_desc *) (r->rx_base + (size_t) idx * r->rx.tp_block_size);
+}
+
+static ssize_t ddsi_raweth_conn_read_ring (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, nn_locator_t *srcloc)
+{
+  struct raweth_rings * const r = ((ddsi_raweth_conn_t) conn)->m_rings;
+  struct tpacket_block_desc *bd = rx_block (r, r->rx_block);
+  const struct tpacket3_hdr *pkt;
+  const struct sockaddr_ll *src;
+  size_t size = 0;
+
+  if (r->rx_pkts_left == 0)
+  {
+    /* No block in hand: the socket is readable once the kernel has retired
+       one, but the caller may also come here without it being so */
+    if (!(*(volatile uint32_t *) &bd->hdr.bh1.block_status & TP_STATUS_USER))
+      return 0;
+    ddsrt_atomic_fence_acq ();
+    if ((r->rx_pkts_left = bd->hdr.bh1.num_pkts) == 0)
+      goto release_block;
+    r->rx_pkt = (struct tpacket3_hdr *) ((unsigned char *) bd + bd->hdr.bh1.offset_to_first_pkt);
+  }
+
+  pkt = r->rx_pkt;
+  src = (const struct sockaddr_ll *) ((const unsigned char *) pkt + RAWETH_TP3_SLL_OFFSET);
+  size = pkt->tp_snaplen;
+  if (size > len || pkt->tp_len > pkt->tp_snaplen)
+  {
+    warn_truncated (conn, src, pkt->tp_len, size > len ? len : size);
+    if (size > len)
+      size = len;
+  }
+  memcpy (buf, (const unsigned char *) pkt + pkt->tp_net, size);
+  if (srcloc)
+    set_srcloc (conn, srcloc, src);
+
+  r->rx_pkt = (struct tpacket3_hdr *) ((unsigned char *) pkt + pkt->tp_next_offset);
+  if (--r->rx_pkts_left > 0)
+    return (ssize_t) size;
+
+release_block:
+  ddsrt_atomic_fence_rel ();
+  *(volatile uint32_t *) &bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+  r->rx_block = (r->rx_block + 1) % r->rx.tp_block_nr;
+  return (ssize_t) size;
+}
+
 static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf, size_t len, bool allow_spurious, nn_locator_t *srcloc)
 {
   dds_return_t rc;
@@ -60,6 +150,9 @@ static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf
   socklen_t srclen = (socklen_t) sizeof (src);
   (void) allow_spurious;
 
+  if (((ddsi_raweth_conn_t) conn)->m_rings)
+    return ddsi_raweth_conn_read_ring (conn, buf, len, srcloc);
+
   msg_iov.iov_base = (void*) buf;
   msg_iov.iov_len = len;
 
@@ -77,13 +170,7 @@ static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf
   if (ret > 0)
   {
     if (srcloc)
-    {
-      srcloc->tran = conn->m_factory;
-      srcloc->kind = NN_LOCATOR_KIND_RAWETH;
-      srcloc->port = ntohs (src.sll_protocol);
-      memset(srcloc->address, 0, 10);
-      memcpy(srcloc->address + 10, src.sll_addr, 6);
-    }
+      set_srcloc (conn, srcloc, &src);
 
     /* Check for udp packet truncation */
     if ((((size_t) ret) > len)
@@ -92,11 +179,7 @@ static ssize_t ddsi_raweth_conn_read (ddsi_tran_conn_t conn, unsigned char * buf
 #endif
         )
     {
-      char addrbuf[DDSI_LOCSTRLEN];
-      (void) snprintf(addrbuf, sizeof(addrbuf), "[%02x:%02x:%02x:%02x:%02x:%02x]:%u",
-                      src.sll_addr[0], src.sll_addr[1], src.sll_addr[2],
-                      src.sll_addr[3], src.sll_addr[4], src.sll_addr[5], ntohs(src.sll_protocol));
-      DDS_CWARNING(&conn->m_base.gv->logconfig, "%s => %d truncated to %d\n", addrbuf, (int)ret, (int)len);
+      warn_truncated (conn, &src, (size_t) ret, len);
     }
   }
   else if (rc != DDS_RETCODE_OK &&
@@ -174,17 +257,83 @@ static int ddsi_raweth_conn_locator (ddsi_tran_factory_t fact, ddsi_tran_base_t
   return ret;
 }
 
+static uint32_t round_up_pow2 (uint32_t x, uint32_t min)
+{
+  uint32_t y = min;
+  while (y < x)
+    y *= 2;
+  return y;
+}
+
+static void release_ring (ddsrt_socket_t sock)
+{
+  struct tpacket_req3 req;
+  memset (&req, 0, sizeof (req));
+  (void) ddsrt_setsockopt (sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof (req));
+}
+
+static struct raweth_rings *setup_rings (const struct ddsi_domaingv *gv, ddsrt_socket_t sock)
+{
+  /* Messages are normally limited to MaxMessageSize, but a single submessage may exceed it */
+  const uint32_t pagesize = (uint32_t) sysconf (_SC_PAGESIZE);
+  const uint32_t maxframe = gv->config.max_msg_size + gv->config.fragment_size;
+  const dds_duration_t tov = gv->config.raweth_rx_block_timeout / DDS_NSECS_IN_MSEC;
+  struct raweth_rings *r;
+  struct tpacket_req3 *req;
+  int version = TPACKET_V3;
+  void *map;
+
+  if (ddsrt_setsockopt (sock, SOL_PACKET, PACKET_VERSION, &version, sizeof (version)) != DDS_RETCODE_OK)
+    return NULL;
+  r = ddsrt_malloc (sizeof (*r));
+  memset (r, 0, sizeof (*r));
+  req = &r->rx;
+  /* frame size & number are only checked for consistency by the kernel in V3 */
+  req->tp_block_size = round_up_pow2 (gv->config.raweth_rx_block_size, round_up_pow2 ((uint32_t) (maxframe + RAWETH_TP3_HDRLEN + 64), pagesize));
+  req->tp_block_nr = gv->config.raweth_rx_blocks;
+  req->tp_frame_size = TPACKET_ALIGNMENT << 7;
+  req->tp_frame_nr = (req->tp_block_size / req->tp_frame_size) * req->tp_block_nr;
+  req->tp_retire_blk_tov = (tov < 1) ? 1 : (unsigned) tov;
+  if (req->tp_block_nr == 0 || ddsrt_setsockopt (sock, SOL_PACKET, PACKET_RX_RING, req, sizeof (*req)) != DDS_RETCODE_OK)
+  {
+    ddsrt_free (r);
+    return NULL;
+  }
+  r->maplen = (size_t) req->tp_block_size * req->tp_block_nr;
+  if ((map = mmap (NULL, r->maplen, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0)) == MAP_FAILED)
+  {
+    release_ring (sock);
+    ddsrt_free (r);
+    return NULL;
+  }
+  r->map = map;
+  r->rx_base = r->map;
+  GVLOG (DDS_LC_CONFIG, "raweth socket %d: rx ring %u blocks of %u bytes\n",
+         (int) sock, req->tp_block_nr, req->tp_block_size);
+  return r;
+}
+
+static void free_rings (struct raweth_rings *r)
+{
+  munmap (r->map, r->maplen);
+  ddsrt_free (r);
+}
+
 static dds_return_t ddsi_raweth_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_factory_t fact, uint32_t port, const struct ddsi_tran_qos *qos)
 {
+  struct ddsi_domaingv const * const gv = fact->gv;
   ddsrt_socket_t sock;
   dds_return_t rc;
   ddsi_raweth_conn_t uc = NULL;
   struct sockaddr_ll addr;
   bool mcast = (qos->m_purpose == DDSI_TRAN_QOS_RECV_MC);
+  bool xmit = (qos->m_purpose == DDSI_TRAN_QOS_XMIT);
+  struct raweth_rings *rings = NULL;
 
-  /* If port is zero, need to create dynamic port */
+  /* The port number is the ethernet type, a transmit-only socket doesn't need one
+     because the destination address includes it */
 
-  if (port == 0 || port > 65535)
+  if ((port == 0 && !xmit) || port > 65535)
   {
     DDS_CERROR (&fact->gv->logconfig, "ddsi_raweth_create_conn %s port %u - using port number as ethernet type, %u won't do\n", mcast ? "multicast" : "unicast", port, port);
     return DDS_RETCODE_ERROR;
@@ -202,7 +351,7 @@ static dds_return_t ddsi_raweth_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tr
   addr.sll_protocol = htons((uint16_t)port);
   addr.sll_ifindex = (int)fact->gv->interfaceNo;
   addr.sll_pkttype = PACKET_HOST | PACKET_BROADCAST | PACKET_MULTICAST;
-  rc = ddsrt_bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+  rc = xmit ? DDS_RETCODE_OK : ddsrt_bind(sock, (struct sockaddr *)&addr, sizeof(addr));
   if (rc != DDS_RETCODE_OK)
   {
     ddsrt_close(sock);
@@ -210,8 +359,13 @@ static dds_return_t ddsi_raweth_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tr
     return DDS_RETCODE_ERROR;
   }
 
+  if (gv->config.raweth_rings && !xmit && (rings = setup_rings (gv, sock)) == NULL)
+    GVLOG (DDS_LC_CONFIG, "raweth socket %d: packet ring unavailable, using regular socket operations\n", (int) sock);
+
   if ((uc = (ddsi_raweth_conn_t) ddsrt_malloc (sizeof (*uc))) == NULL)
   {
+    if (rings)
+      free_rings (rings);
     ddsrt_close(sock);
     return DDS_RETCODE_ERROR;
   }
@@ -219,6 +373,7 @@ static dds_return_t ddsi_raweth_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tr
   memset (uc, 0, sizeof (*uc));
   uc->m_sock = sock;
   uc->m_ifindex = addr.sll_ifindex;
+  uc->m_rings = rings;
   ddsi_factory_conn_init (fact, &uc->m_base);
   uc->m_base.m_base.m_port = port;
   uc->m_base.m_base.m_trantype = DDSI_TRAN_CONN;
@@ -287,6 +442,8 @@ static void ddsi_raweth_release_conn (ddsi_tran_conn_t conn)
               conn->m_base.m_multicast ? "multicast" : "unicast",
               uc->m_sock,
               uc->m_base.m_base.m_port);
+  if (uc->m_rings)
+    free_rings (uc->m_rings);
   ddsrt_close (uc->m_sock);
   ddsrt_free (conn);
 }
@@ -358,8 +515,9 @@ static int ddsi_raweth_enumerate_interfaces (ddsi_tran_factory_t fact, enum tran
 
 static int ddsi_raweth_is_valid_port (ddsi_tran_factory_t fact, uint32_t port)
 {
+  /* 0 is fine for the transmit socket, create_conn rejects it for receiving */
   (void) fact;
-  return (port >= 1 && port <= 65535);
+  return (port <= 65535);
 }
 
 int ddsi_raweth_init (struct ddsi_domaingv *gv)
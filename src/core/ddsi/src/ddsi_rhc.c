@@ -16,3 +16,4 @@ extern inline bool ddsi_rhc_store (struct ddsi_rhc * __restrict rhc, const struc
 extern inline void ddsi_rhc_unregister_wr (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo);
 extern inline void ddsi_rhc_relinquish_ownership (struct ddsi_rhc * __restrict rhc, const uint64_t wr_iid);
 extern inline void ddsi_rhc_set_qos (struct ddsi_rhc *rhc, const struct dds_qos *qos);
+extern inline void ddsi_rhc_commit (struct ddsi_rhc * __restrict rhc, const struct ddsi_writer_info * __restrict wrinfo);
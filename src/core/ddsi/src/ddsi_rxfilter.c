@@ -0,0 +1,115 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stddef.h>
+#include <assert.h>
+
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/hopscotch.h"
+#include "dds/ddsi/ddsi_rxfilter.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_gc.h"
+#include "dds/ddsi/q_thread.h" /* for assert(thread is awake) */
+
+struct ddsi_rxfilter {
+  struct ddsrt_chh *pwrs;
+  ddsrt_atomic_uint64_t accepted;
+  ddsrt_atomic_uint64_t dropped;
+};
+
+/* Elements are proxy writers, templates are entity_commons: both start with
+   the entity_common that contains the GUID */
+static uint32_t rxfilter_hash (const void *va)
+{
+  const struct entity_common *a = va;
+  const uint64_t h =
+    ((uint64_t) a->guid.prefix.u[0] + UINT64_C (16292676669999574021)) * ((uint64_t) a->guid.prefix.u[1] + UINT64_C (10242350189706880077)) +
+    ((uint64_t) a->guid.prefix.u[2] + UINT64_C (12844332200329132887)) * ((uint64_t) a->guid.entityid.u + UINT64_C (16728792139623414127));
+  return (uint32_t) (h >> 32);
+}
+
+static int rxfilter_equals (const void *va, const void *vb)
+{
+  const struct entity_common *a = va, *b = vb;
+  return
+    a->guid.prefix.u[0] == b->guid.prefix.u[0] && a->guid.prefix.u[1] == b->guid.prefix.u[1] &&
+    a->guid.prefix.u[2] == b->guid.prefix.u[2] && a->guid.entityid.u == b->guid.entityid.u;
+}
+
+static void gc_buckets_cb (struct gcreq *gcreq)
+{
+  void *bs = gcreq->arg;
+  gcreq_free (gcreq);
+  ddsrt_free (bs);
+}
+
+static void gc_buckets (void *bs, void *varg)
+{
+  struct ddsi_domaingv *gv = varg;
+  struct gcreq *gcreq = gcreq_new (gv->gcreq_queue, gc_buckets_cb);
+  gcreq->arg = bs;
+  gcreq_enqueue (gcreq);
+}
+
+struct ddsi_rxfilter *ddsi_rxfilter_new (struct ddsi_domaingv *gv)
+{
+  struct ddsi_rxfilter *rxf = ddsrt_malloc (sizeof (*rxf));
+  if ((rxf->pwrs = ddsrt_chh_new (32, rxfilter_hash, rxfilter_equals, gc_buckets, gv)) == NULL)
+  {
+    ddsrt_free (rxf);
+    return NULL;
+  }
+  ddsrt_atomic_st64 (&rxf->accepted, 0);
+  ddsrt_atomic_st64 (&rxf->dropped, 0);
+  return rxf;
+}
+
+void ddsi_rxfilter_free (struct ddsi_rxfilter *rxf)
+{
+  ddsrt_chh_free (rxf->pwrs);
+  ddsrt_free (rxf);
+}
+
+void ddsi_rxfilter_add (struct ddsi_rxfilter *rxf, struct proxy_writer *pwr)
+{
+  /* already present is fine: it's a set */
+  (void) ddsrt_chh_add (rxf->pwrs, pwr);
+}
+
+void ddsi_rxfilter_remove (struct ddsi_rxfilter *rxf, struct proxy_writer *pwr)
+{
+  (void) ddsrt_chh_remove (rxf->pwrs, pwr);
+}
+
+bool ddsi_rxfilter_accept (struct ddsi_rxfilter *rxf, const ddsi_guid_t *pwr_guid)
+{
+  struct entity_common template;
+  assert (thread_is_awake ());
+  template.guid = *pwr_guid;
+  if (ddsrt_chh_lookup (rxf->pwrs, &template) != NULL)
+  {
+    ddsrt_atomic_inc64 (&rxf->accepted);
+    return true;
+  }
+  else
+  {
+    ddsrt_atomic_inc64 (&rxf->dropped);
+    return false;
+  }
+}
+
+void ddsi_rxfilter_get_stats (const struct ddsi_rxfilter *rxf, struct ddsi_rxfilter_stats *st)
+{
+  st->accepted = ddsrt_atomic_ld64 (&rxf->accepted);
+  st->dropped = ddsrt_atomic_ld64 (&rxf->dropped);
+}
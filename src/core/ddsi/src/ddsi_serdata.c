@@ -13,7 +13,9 @@
 #include <ctype.h>
 #include <assert.h>
 #include <string.h>
+#include <stdio.h>
 
+#include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/md5.h"
 #include "dds/ddsi/q_bswap.h"
 #include "dds/ddsi/q_config.h"
@@ -32,6 +34,85 @@ void ddsi_serdata_init (struct ddsi_serdata *d, const struct ddsi_sertopic *tp,
   ddsrt_atomic_st32 (&d->refc, 1);
 }
 
+/* A serdata of kind EMPTY carries no sample at all (e.g., the commit message of a
+   coherent set).  It is never deserialised or looked at by a reader, its size is
+   0 and it has no key, so it needn't involve the topic's serdata implementation */
+static uint32_t serdata_empty_get_size (const struct ddsi_serdata *d)
+{
+  (void) d;
+  return 0;
+}
+
+static bool serdata_empty_eqkey (const struct ddsi_serdata *a, const struct ddsi_serdata *b)
+{
+  (void) a; (void) b;
+  return false;
+}
+
+static void serdata_empty_to_ser (const struct ddsi_serdata *d, size_t off, size_t sz, void *buf)
+{
+  (void) d; (void) off; (void) sz; (void) buf;
+  assert (sz == 0);
+}
+
+static struct ddsi_serdata *serdata_empty_to_ser_ref (const struct ddsi_serdata *d, size_t off, size_t sz, ddsrt_iovec_t *ref)
+{
+  (void) off; (void) sz;
+  assert (sz == 0);
+  ref->iov_base = NULL;
+  ref->iov_len = 0;
+  return ddsi_serdata_ref (d);
+}
+
+static void serdata_empty_to_ser_unref (struct ddsi_serdata *d, const ddsrt_iovec_t *ref)
+{
+  (void) ref;
+  ddsi_serdata_unref (d);
+}
+
+static bool serdata_empty_to_sample (const struct ddsi_serdata *d, void *sample, void **bufptr, void *buflim)
+{
+  (void) d; (void) sample; (void) bufptr; (void) buflim;
+  return false;
+}
+
+static void serdata_empty_free (struct ddsi_serdata *d)
+{
+  ddsrt_free (d);
+}
+
+static size_t serdata_empty_print (const struct ddsi_sertopic *topic, const struct ddsi_serdata *d, char *buf, size_t size)
+{
+  (void) topic; (void) d;
+  return (size_t) snprintf (buf, size, "(empty)");
+}
+
+static const struct ddsi_serdata_ops serdata_empty_ops = {
+  .get_size = serdata_empty_get_size,
+  .eqkey = serdata_empty_eqkey,
+  .free = serdata_empty_free,
+  .from_ser = 0,
+  .from_ser_iov = 0,
+  .from_keyhash = 0,
+  .from_sample = 0,
+  .to_ser = serdata_empty_to_ser,
+  .to_sample = serdata_empty_to_sample,
+  .to_ser_ref = serdata_empty_to_ser_ref,
+  .to_ser_unref = serdata_empty_to_ser_unref,
+  .to_topicless = 0,
+  .topicless_to_sample = 0,
+  .print = serdata_empty_print,
+  .from_pinned_sample = 0
+};
+
+struct ddsi_serdata *ddsi_serdata_new_empty (const struct ddsi_sertopic *tp)
+{
+  struct ddsi_serdata *d = ddsrt_malloc (sizeof (*d));
+  ddsi_serdata_init (d, tp, SDK_EMPTY);
+  d->ops = &serdata_empty_ops;
+  return d;
+}
+
 extern inline struct ddsi_serdata *ddsi_serdata_ref (const struct ddsi_serdata *serdata_const);
 extern inline void ddsi_serdata_unref (struct ddsi_serdata *serdata);
 extern inline uint32_t ddsi_serdata_size (const struct ddsi_serdata *d);
@@ -39,6 +120,7 @@ extern inline struct ddsi_serdata *ddsi_serdata_from_ser (const struct ddsi_sert
 extern inline struct ddsi_serdata *ddsi_serdata_from_ser_iov (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, ddsrt_msg_iovlen_t niov, const ddsrt_iovec_t *iov, size_t size);
 extern inline struct ddsi_serdata *ddsi_serdata_from_keyhash (const struct ddsi_sertopic *topic, const struct nn_keyhash *keyhash);
 extern inline struct ddsi_serdata *ddsi_serdata_from_sample (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const void *sample);
+extern inline struct ddsi_serdata *ddsi_serdata_from_pinned_sample (const struct ddsi_sertopic *topic, enum ddsi_serdata_kind kind, const void *sample, ddsi_serdata_release_t release, void *arg);
 extern inline struct ddsi_serdata *ddsi_serdata_to_topicless (const struct ddsi_serdata *d);
 extern inline void ddsi_serdata_to_ser (const struct ddsi_serdata *d, size_t off, size_t sz, void *buf);
 extern inline struct ddsi_serdata *ddsi_serdata_to_ser_ref (const struct ddsi_serdata *d, size_t off, size_t sz, ddsrt_iovec_t *ref);
@@ -55,6 +55,30 @@ static int ispowerof2_size (size_t x)
 
 static size_t alignup_size (size_t x, size_t a);
 
+/* Samples written with ddsi_serdata_from_pinned_sample reference the contents
+   of large sequences of primitive types in the application's memory instead of
+   copying them.  The serialised representation then consists of pieces that
+   alternate between the serdata and the application's memory, and to_ser_ref
+   returns references to these pieces one at a time, so they can be gathered
+   into the outgoing message without copying.  Everything else (local delivery,
+   printing, extracting the key) operates on a temporary contiguous copy.
+   These use the regular operations (they have to, because the key-to-instance
+   map only considers samples with the same operations equal), which check for
+   the presence of "pinned". */
+struct serdata_pinned_piece {
+  uint32_t off;               /* offset in serialised representation (including CDR header) */
+  uint32_t len;               /* > 0 */
+  const char *ptr;
+};
+
+struct ddsi_serdata_pinned {
+  ddsi_serdata_release_t release;
+  void *release_arg;
+  uint32_t size;              /* size of serialised representation (including CDR header) */
+  uint32_t npieces;
+  struct serdata_pinned_piece pieces[];
+};
+
 struct serdatapool * ddsi_serdatapool_new (void)
 {
   struct serdatapool * pool;
@@ -136,6 +160,8 @@ static struct ddsi_serdata *fix_serdata_default_nokey(struct ddsi_serdata_defaul
 static uint32_t serdata_default_get_size(const struct ddsi_serdata *dcmn)
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *) dcmn;
+  if (d->pinned)
+    return d->pinned->size;
   return d->pos + (uint32_t)sizeof (struct CDRHeader);
 }
 
@@ -167,6 +193,11 @@ static void serdata_default_free(struct ddsi_serdata *dcmn)
 {
   struct ddsi_serdata_default *d = (struct ddsi_serdata_default *)dcmn;
   assert(ddsrt_atomic_ld32(&d->c.refc) == 0);
+  if (d->pinned)
+  {
+    d->pinned->release (d->pinned->release_arg);
+    ddsrt_free (d->pinned);
+  }
   if (d->size > MAX_SIZE_FOR_POOL || !nn_freelist_push (&d->serpool->freelist, d))
     dds_free (d);
 }
@@ -183,6 +214,7 @@ static void serdata_default_init(struct ddsi_serdata_default *d, const struct dd
   memset (d->keyhash.m_hash, 0, sizeof (d->keyhash.m_hash));
   d->keyhash.m_set = 0;
   d->keyhash.m_iskey = 0;
+  d->pinned = NULL;
 }
 
 static struct ddsi_serdata_default *serdata_default_allocnew (struct serdatapool *serpool, uint32_t init_size)
@@ -533,10 +565,177 @@ static struct ddsi_serdata *serdata_default_from_sample_rawcdr (const struct dds
   }
 }
 
+static const struct serdata_pinned_piece *serdata_pinned_lookup (const struct ddsi_serdata_pinned *p, size_t off)
+{
+  uint32_t lo = 0, hi = p->npieces;
+  while (hi - lo > 1)
+  {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if (p->pieces[mid].off <= off)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  assert (off >= p->pieces[lo].off && off - p->pieces[lo].off < p->pieces[lo].len);
+  return &p->pieces[lo];
+}
+
+static void serdata_pinned_to_ser (const struct ddsi_serdata *dcmn, size_t off, size_t sz, void *buf)
+{
+  const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *) dcmn;
+  const struct serdata_pinned_piece *pc = serdata_pinned_lookup (d->pinned, off);
+  char *dst = buf;
+  assert (sz <= d->pinned->size - off);
+  while (sz > 0)
+  {
+    const size_t poff = off - pc->off;
+    const size_t n = (pc->len - poff < sz) ? pc->len - poff : sz;
+    memcpy (dst, pc->ptr + poff, n);
+    dst += n;
+    off += n;
+    sz -= n;
+    pc++;
+  }
+}
+
+static struct ddsi_serdata *serdata_pinned_to_ser_ref (const struct ddsi_serdata *dcmn, size_t off, size_t sz, ddsrt_iovec_t *ref)
+{
+  const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *) dcmn;
+  const struct serdata_pinned_piece *pc = serdata_pinned_lookup (d->pinned, off);
+  const size_t poff = off - pc->off;
+  assert (sz > 0 && sz <= d->pinned->size - off);
+  ref->iov_base = (void *) (pc->ptr + poff);
+  ref->iov_len = (ddsrt_iov_len_t) ((pc->len - poff < sz) ? pc->len - poff : sz);
+  return ddsi_serdata_ref (dcmn);
+}
+
+static struct ddsi_serdata_default *serdata_pinned_flatten (const struct ddsi_serdata_default *d)
+{
+  const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *) d->c.topic;
+  const uint32_t n = d->pinned->size - (uint32_t) sizeof (struct CDRHeader);
+  struct ddsi_serdata_default *f = serdata_default_new_size (tp, d->c.kind, n);
+  serdata_pinned_to_ser (&d->c, sizeof (struct CDRHeader), n, serdata_default_append (&f, n));
+  f->hdr = d->hdr;
+  f->keyhash = d->keyhash;
+  f->c.hash = d->c.hash;
+  f->c.statusinfo = d->c.statusinfo;
+  f->c.timestamp = d->c.timestamp;
+  return f;
+}
+
+static struct ddsi_serdata *serdata_pinned_to_topicless (const struct ddsi_serdata *dcmn)
+{
+  struct ddsi_serdata_default *f = serdata_pinned_flatten ((const struct ddsi_serdata_default *) dcmn);
+  struct ddsi_serdata *tl = ddsi_serdata_to_topicless (&f->c);
+  ddsi_serdata_unref (&f->c);
+  return tl;
+}
+
+static bool serdata_pinned_to_sample (const struct ddsi_serdata *dcmn, void *sample, void **bufptr, void *buflim)
+{
+  struct ddsi_serdata_default *f = serdata_pinned_flatten ((const struct ddsi_serdata_default *) dcmn);
+  const bool ret = ddsi_serdata_to_sample (&f->c, sample, bufptr, buflim);
+  ddsi_serdata_unref (&f->c);
+  return ret;
+}
+
+static size_t serdata_pinned_print (const struct ddsi_sertopic *sertopic_common, const struct ddsi_serdata *dcmn, char *buf, size_t size)
+{
+  struct ddsi_serdata_default *f = serdata_pinned_flatten ((const struct ddsi_serdata_default *) dcmn);
+  const size_t ret = sertopic_common->serdata_ops->print (sertopic_common, &f->c, buf, size);
+  ddsi_serdata_unref (&f->c);
+  return ret;
+}
+
+static void serdata_default_make_pinned (struct ddsi_serdata_default *d, const struct dds_ostream_refs *refs, ddsi_serdata_release_t release, void *arg)
+{
+  /* stream positions are relative to the start of the serdata, contiguous offsets
+     (cpos, cnext) to the CDR header and "off" to the start of the serialised data */
+  const uint32_t hdroff = (uint32_t) offsetof (struct ddsi_serdata_default, hdr);
+  const uint32_t cend = d->pos + (uint32_t) sizeof (struct CDRHeader);
+  struct ddsi_serdata_pinned *p = ddsrt_malloc (sizeof (*p) + (2 * refs->m_count + 1) * sizeof (p->pieces[0]));
+  uint32_t cpos = 0, off = 0;
+  p->npieces = 0;
+  for (uint32_t i = 0; i <= refs->m_count; i++)
+  {
+    const uint32_t cnext = (i < refs->m_count) ? refs->m_refs[i].m_index - hdroff : cend;
+    if (cnext > cpos)
+    {
+      p->pieces[p->npieces].off = off;
+      p->pieces[p->npieces].len = cnext - cpos;
+      p->pieces[p->npieces].ptr = (const char *) &d->hdr + cpos;
+      p->npieces++;
+      off += cnext - cpos;
+      cpos = cnext;
+    }
+    if (i < refs->m_count)
+    {
+      p->pieces[p->npieces].off = off;
+      p->pieces[p->npieces].len = refs->m_refs[i].m_size;
+      p->pieces[p->npieces].ptr = refs->m_refs[i].m_ptr;
+      p->npieces++;
+      off += refs->m_refs[i].m_size;
+    }
+  }
+  assert ((off % 4) == 0);
+  p->size = off;
+  p->release = release;
+  p->release_arg = arg;
+  d->pinned = p;
+}
+
+static struct ddsi_serdata_default *serdata_default_from_pinned_sample_cdr_common (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample, ddsi_serdata_release_t release, void *arg)
+{
+  const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)tpcmn;
+  struct ddsi_serdata_default *d;
+  if (kind != SDK_DATA)
+  {
+    d = serdata_default_from_sample_cdr_common (tpcmn, kind, sample);
+    release (arg);
+    return d;
+  }
+  if ((d = serdata_default_new (tp, kind)) == NULL)
+  {
+    release (arg);
+    return NULL;
+  }
+  struct dds_ostream_refs refs = { .m_threshold = tp->c.gv->config.pinned_reference_threshold, .m_count = 0, .m_max = 0, .m_refs = NULL };
+  dds_ostream_t os;
+  gen_keyhash_from_sample (tp, &d->keyhash, sample);
+  dds_ostream_from_serdata_default (&os, d);
+  os.m_refs = &refs;
+  dds_stream_write_sample (&os, sample, tp);
+  dds_ostream_add_to_serdata_default (&os, &d);
+  if (refs.m_count == 0)
+    release (arg);
+  else
+    serdata_default_make_pinned (d, &refs, release, arg);
+  ddsrt_free (refs.m_refs);
+  return d;
+}
+
+static struct ddsi_serdata *serdata_default_from_pinned_sample_cdr (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample, ddsi_serdata_release_t release, void *arg)
+{
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_from_pinned_sample_cdr_common (tpcmn, kind, sample, release, arg)) == NULL)
+    return NULL;
+  return fix_serdata_default (d, tpcmn->serdata_basehash);
+}
+
+static struct ddsi_serdata *serdata_default_from_pinned_sample_cdr_nokey (const struct ddsi_sertopic *tpcmn, enum ddsi_serdata_kind kind, const void *sample, ddsi_serdata_release_t release, void *arg)
+{
+  struct ddsi_serdata_default *d;
+  if ((d = serdata_default_from_pinned_sample_cdr_common (tpcmn, kind, sample, release, arg)) == NULL)
+    return NULL;
+  return fix_serdata_default_nokey (d, tpcmn->serdata_basehash);
+}
+
 static struct ddsi_serdata *serdata_default_to_topicless (const struct ddsi_serdata *serdata_common)
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)d->c.topic;
+  if (d->pinned)
+    return serdata_pinned_to_topicless (serdata_common);
   assert (d->hdr.identifier == NATIVE_ENCODING || d->hdr.identifier == NATIVE_ENCODING_PL);
   struct ddsi_serdata_default *d_tl = serdata_default_new(tp, SDK_KEY);
   if (d_tl == NULL)
@@ -584,6 +783,11 @@ static struct ddsi_serdata *serdata_default_to_topicless (const struct ddsi_serd
 static void serdata_default_to_ser (const struct ddsi_serdata *serdata_common, size_t off, size_t sz, void *buf)
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
+  if (d->pinned)
+  {
+    serdata_pinned_to_ser (serdata_common, off, sz, buf);
+    return;
+  }
   assert (off < d->pos + sizeof(struct CDRHeader));
   assert (sz <= alignup_size (d->pos + sizeof(struct CDRHeader), 4) - off);
   memcpy (buf, (char *)&d->hdr + off, sz);
@@ -592,6 +796,8 @@ static void serdata_default_to_ser (const struct ddsi_serdata *serdata_common, s
 static struct ddsi_serdata *serdata_default_to_ser_ref (const struct ddsi_serdata *serdata_common, size_t off, size_t sz, ddsrt_iovec_t *ref)
 {
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
+  if (d->pinned)
+    return serdata_pinned_to_ser_ref (serdata_common, off, sz, ref);
   assert (off < d->pos + sizeof(struct CDRHeader));
   assert (sz <= alignup_size (d->pos + sizeof(struct CDRHeader), 4) - off);
   ref->iov_base = (char *)&d->hdr + off;
@@ -611,6 +817,8 @@ static bool serdata_default_to_sample_cdr (const struct ddsi_serdata *serdata_co
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *) d->c.topic;
   dds_istream_t is;
   if (bufptr) abort(); else { (void)buflim; } /* FIXME: haven't implemented that bit yet! */
+  if (d->pinned)
+    return serdata_pinned_to_sample (serdata_common, sample, bufptr, buflim);
   assert (d->hdr.identifier == NATIVE_ENCODING);
   dds_istream_from_serdata_default(&is, d);
   if (d->c.kind == SDK_KEY)
@@ -648,6 +856,8 @@ static size_t serdata_default_print_cdr (const struct ddsi_sertopic *sertopic_co
   const struct ddsi_serdata_default *d = (const struct ddsi_serdata_default *)serdata_common;
   const struct ddsi_sertopic_default *tp = (const struct ddsi_sertopic_default *)sertopic_common;
   dds_istream_t is;
+  if (d->pinned)
+    return serdata_pinned_print (sertopic_common, serdata_common, buf, size);
   dds_istream_from_serdata_default (&is, d);
   if (d->c.kind == SDK_KEY)
     return dds_stream_print_key (&is, tp, buf, size);
@@ -700,7 +910,8 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_cdr = {
   .to_ser_unref = serdata_default_to_ser_unref,
   .to_topicless = serdata_default_to_topicless,
   .topicless_to_sample = serdata_default_topicless_to_sample_cdr,
-  .print = serdata_default_print_cdr
+  .print = serdata_default_print_cdr,
+  .from_pinned_sample = serdata_default_from_pinned_sample_cdr
 };
 
 const struct ddsi_serdata_ops ddsi_serdata_ops_cdr_nokey = {
@@ -717,7 +928,8 @@ const struct ddsi_serdata_ops ddsi_serdata_ops_cdr_nokey = {
   .to_ser_unref = serdata_default_to_ser_unref,
   .to_topicless = serdata_default_to_topicless,
   .topicless_to_sample = serdata_default_topicless_to_sample_cdr_nokey,
-  .print = serdata_default_print_cdr
+  .print = serdata_default_print_cdr,
+  .from_pinned_sample = serdata_default_from_pinned_sample_cdr_nokey
 };
 
 const struct ddsi_serdata_ops ddsi_serdata_ops_plist = {
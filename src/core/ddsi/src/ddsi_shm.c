@@ -0,0 +1,934 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/ddsi_shm.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/q_config.h"
+#include "dds/ddsi/q_log.h"
+#include "dds/ddsi/q_gc.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/avl.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/mh3.h"
+#include "dds/ddsrt/static_assert.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+
+#if defined(__linux) && !LWIP_SOCKET
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define SHM_MAGIC 0x43534d31u /* "CSM1" */
+
+/* Maximum time a receive thread blocks, so it notices termination even if
+   the wake-up got lost */
+#define SHM_READ_TIMEOUT DDS_MSECS (100)
+
+/* Segment header, the fields written by the senders and those written by the
+   receiver are in separate cache lines.  The ring is a bounded multi-producer,
+   single-consumer queue: each slot carries a sequence number that tells
+   whether it is free for the producer claiming position "pos" (seq == pos) or
+   filled for the consumer (seq == pos + 1). */
+struct shm_hdr {
+  uint32_t magic;
+  uint32_t nslots;          /* power of 2 */
+  uint32_t slot_size;       /* max payload per slot */
+  uint32_t stride;          /* distance between slots */
+  int32_t owner_pid;
+  ddsrt_atomic_uint32_t alive;
+  char pad0[40];
+  ddsrt_atomic_uint32_t enq_pos;
+  char pad1[60];
+  ddsrt_atomic_uint32_t sleeping; /* futex word: 1 if receiver (about to be) blocked */
+  char pad2[60];
+  uint32_t deq_pos;         /* only accessed by receiver */
+  char pad3[60];
+};
+
+DDSRT_STATIC_ASSERT (sizeof (struct shm_hdr) == 256);
+
+struct shm_slot {
+  ddsrt_atomic_uint32_t seq;
+  uint32_t size;
+  int32_t src_kind;
+  uint32_t src_port;
+  unsigned char src_address[16];
+  unsigned char data[];
+};
+
+/* Segment of a peer, mapped for as long as one of the registered proxy
+   participants uses the locator; only "refc" changes after it has been
+   published, and only while holding m_lock */
+struct shm_peer {
+  nn_locator_t loc;
+  struct shm_hdr *hdr;
+  size_t size;
+  uint32_t refc;
+};
+
+/* Immutable table of peers sorted on locator, replaced as a whole on every
+   change so that the transmit path can use it without locking; replaced
+   tables and the segments that are no longer referenced are freed by the
+   garbage collector */
+struct shm_peertab {
+  uint32_t n;
+  struct shm_peer *peers[];
+};
+
+struct shm_peertab_gc {
+  struct shm_peertab *tab;
+  uint32_t ndead;
+  struct shm_peer *dead[];
+};
+
+/* Locators registered for a proxy participant */
+struct shm_reg {
+  ddsrt_avl_node_t avlnode;
+  ddsi_guid_prefix_t prefix;
+  uint32_t nlocs;
+  nn_locator_t *locs;
+};
+
+struct ddsi_shm_tran_factory {
+  struct ddsi_tran_factory m_base;
+  uint32_t m_identity[3];
+};
+
+typedef struct ddsi_shm_conn {
+  struct ddsi_tran_conn m_base;
+
+  /* receive side: owned segment */
+  char m_name[64];
+  struct shm_hdr *m_hdr;
+  size_t m_size;
+
+  /* transmit side: segments of the registered peers, m_lock serializes the
+     updates */
+  ddsrt_mutex_t m_lock;
+  ddsrt_atomic_voidp_t m_peertab;
+  ddsrt_avl_tree_t m_regs;
+  nn_locator_t m_srcloc;
+} *ddsi_shm_conn_t;
+
+static int compare_prefix (const void *va, const void *vb)
+{
+  return memcmp (va, vb, sizeof (ddsi_guid_prefix_t));
+}
+
+static const ddsrt_avl_treedef_t shm_regs_td = DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct shm_reg, avlnode), offsetof (struct shm_reg, prefix), compare_prefix, 0);
+
+static int compare_locator (const nn_locator_t *a, const nn_locator_t *b)
+{
+  if (a->port != b->port)
+    return (a->port < b->port) ? -1 : 1;
+  else if (a->kind != b->kind)
+    return (a->kind < b->kind) ? -1 : 1;
+  else
+    return memcmp (a->address, b->address, sizeof (a->address));
+}
+
+static int compare_peer (const void *va, const void *vb)
+{
+  const struct shm_peer * const *a = va, * const *b = vb;
+  return compare_locator (&(*a)->loc, &(*b)->loc);
+}
+
+static bool shm_identity (uint32_t id[3])
+{
+  /* The boot id distinguishes hosts (and boots), the inode of the network
+     namespace distinguishes the namespaces on a host: addresses and ports
+     only identify a process within a network namespace */
+  char bootid[64];
+  struct stat st;
+  size_t n;
+  FILE *fp;
+  if ((fp = fopen ("/proc/sys/kernel/random/boot_id", "r")) == NULL)
+    return false;
+  n = fread (bootid, 1, sizeof (bootid), fp);
+  fclose (fp);
+  if (n == 0 || stat ("/proc/self/ns/net", &st) < 0)
+    return false;
+  id[0] = ddsrt_mh3 (bootid, n, 0);
+  id[1] = (uint32_t) ((uint64_t) st.st_ino >> 32);
+  id[2] = (uint32_t) st.st_ino;
+  return true;
+}
+
+static void shm_name (char *dst, size_t size, const uint32_t id[3], uint32_t domain_id, uint32_t port)
+{
+  (void) snprintf (dst, size, "/cyclonedds-%08"PRIx32"%08"PRIx32"%08"PRIx32"-%"PRIu32"-%"PRIu32, id[0], id[1], id[2], domain_id, port);
+}
+
+bool ddsi_shm_segment_name (char *dst, size_t size, uint32_t domain_id, uint32_t port)
+{
+  uint32_t id[3];
+  if (!shm_identity (id))
+    return false;
+  shm_name (dst, size, id, domain_id, port);
+  return true;
+}
+
+static const uint32_t *shm_factory_identity (const struct ddsi_tran_conn *conn)
+{
+  return ((const struct ddsi_shm_tran_factory *) conn->m_factory)->m_identity;
+}
+
+static struct shm_slot *shm_slot (struct shm_hdr *hdr, uint32_t pos)
+{
+  return (struct shm_slot *) ((char *) (hdr + 1) + (size_t) (pos & (hdr->nslots - 1)) * hdr->stride);
+}
+
+static void shm_futex_wait (ddsrt_atomic_uint32_t *addr, uint32_t val, dds_duration_t timeout)
+{
+  struct timespec ts;
+  ts.tv_sec = (time_t) (timeout / DDS_NSECS_IN_SEC);
+  ts.tv_nsec = (long) (timeout % DDS_NSECS_IN_SEC);
+  (void) syscall (SYS_futex, &addr->v, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void shm_futex_wake (ddsrt_atomic_uint32_t *addr)
+{
+  (void) syscall (SYS_futex, &addr->v, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static bool shm_enqueue (struct shm_hdr *hdr, const nn_locator_t *srcloc, size_t niov, const ddsrt_iovec_t *iov, size_t len)
+{
+  struct shm_slot *slot;
+  uint32_t pos;
+
+  if (len > hdr->slot_size)
+    return false;
+  pos = ddsrt_atomic_ld32 (&hdr->enq_pos);
+  for (;;)
+  {
+    int32_t dif;
+    slot = shm_slot (hdr, pos);
+    dif = (int32_t) (ddsrt_atomic_ld32 (&slot->seq) - pos);
+    ddsrt_atomic_fence_acq ();
+    if (dif == 0)
+    {
+      if (ddsrt_atomic_cas32 (&hdr->enq_pos, pos, pos + 1))
+        break;
+      pos = ddsrt_atomic_ld32 (&hdr->enq_pos);
+    }
+    else if (dif < 0)
+      return false; /* full */
+    else
+      pos = ddsrt_atomic_ld32 (&hdr->enq_pos);
+  }
+
+  slot->size = (uint32_t) len;
+  slot->src_kind = srcloc->kind;
+  slot->src_port = srcloc->port;
+  memcpy (slot->src_address, srcloc->address, sizeof (slot->src_address));
+  {
+    size_t off = 0;
+    for (size_t i = 0; i < niov; i++)
+    {
+      memcpy (slot->data + off, iov[i].iov_base, iov[i].iov_len);
+      off += iov[i].iov_len;
+    }
+  }
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (&slot->seq, pos + 1);
+
+  /* Dekker-style handshake with the receiver: it sets "sleeping" before
+     re-checking the ring, we check "sleeping" after publishing */
+  ddsrt_atomic_fence ();
+  if (ddsrt_atomic_ld32 (&hdr->sleeping) && ddsrt_atomic_cas32 (&hdr->sleeping, 1, 0))
+    shm_futex_wake (&hdr->sleeping);
+  return true;
+}
+
+static struct shm_slot *shm_peek (struct shm_hdr *hdr)
+{
+  struct shm_slot *slot = shm_slot (hdr, hdr->deq_pos);
+  if ((int32_t) (ddsrt_atomic_ld32 (&slot->seq) - (hdr->deq_pos + 1)) < 0)
+    return NULL;
+  ddsrt_atomic_fence_acq ();
+  return slot;
+}
+
+static void shm_release (struct shm_hdr *hdr, struct shm_slot *slot)
+{
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_st32 (&slot->seq, hdr->deq_pos + hdr->nslots);
+  hdr->deq_pos++;
+}
+
+static ssize_t ddsi_shm_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * buf, size_t len, bool allow_spurious, nn_locator_t *srcloc)
+{
+  ddsi_shm_conn_t conn = (ddsi_shm_conn_t) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  struct shm_hdr * const hdr = conn->m_hdr;
+  struct shm_slot *slot;
+  ssize_t ret;
+  (void) allow_spurious;
+  assert (hdr != NULL);
+
+  if ((slot = shm_peek (hdr)) == NULL)
+  {
+    ddsrt_atomic_st32 (&hdr->sleeping, 1);
+    ddsrt_atomic_fence ();
+    if ((slot = shm_peek (hdr)) == NULL)
+    {
+      shm_futex_wait (&hdr->sleeping, 1, SHM_READ_TIMEOUT);
+      ddsrt_atomic_st32 (&hdr->sleeping, 0);
+      if ((slot = shm_peek (hdr)) == NULL)
+        return 0;
+    }
+    else
+    {
+      ddsrt_atomic_st32 (&hdr->sleeping, 0);
+    }
+  }
+
+  if (slot->size > len)
+  {
+    GVWARNING ("ddsi_shm_conn_read: dropped message of %"PRIu32" bytes (buffer %"PRIuSIZE" bytes)\n", slot->size, len);
+    ret = 0;
+  }
+  else
+  {
+    memcpy (buf, slot->data, slot->size);
+    if (srcloc)
+    {
+      srcloc->tran = gv->m_factory;
+      srcloc->kind = slot->src_kind;
+      srcloc->port = slot->src_port;
+      memcpy (srcloc->address, slot->src_address, sizeof (srcloc->address));
+    }
+    ret = (ssize_t) slot->size;
+  }
+  shm_release (hdr, slot);
+  return ret;
+}
+
+static bool shm_pid_alive (int32_t pid)
+{
+  /* EPERM means it exists but belongs to someone else */
+  return pid > 0 && (kill ((pid_t) pid, 0) == 0 || errno != ESRCH);
+}
+
+static bool shm_owner_alive (const struct shm_hdr *hdr)
+{
+  /* a process that crashed leaves its segment behind with "alive" set */
+  return ddsrt_atomic_ld32 (&hdr->alive) && shm_pid_alive (hdr->owner_pid);
+}
+
+static struct shm_peer *shm_peer_attach (ddsi_shm_conn_t conn, const nn_locator_t *loc)
+{
+  /* Maps the segment for the port of loc if it exists and is in use */
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  struct shm_peer *peer = NULL;
+  char name[64];
+  struct stat st;
+  void *p;
+  int fd;
+
+  shm_name (name, sizeof (name), shm_factory_identity (&conn->m_base), gv->config.extDomainId.value, loc->port);
+  if ((fd = shm_open (name, O_RDWR, 0)) < 0)
+    return NULL;
+  if (fstat (fd, &st) == 0 && (size_t) st.st_size >= sizeof (struct shm_hdr) &&
+      (p = mmap (NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED)
+  {
+    struct shm_hdr *hdr = p;
+    if (hdr->magic == SHM_MAGIC && shm_owner_alive (hdr) &&
+        sizeof (*hdr) + (size_t) hdr->nslots * hdr->stride <= (size_t) st.st_size)
+    {
+      GVTRACE ("ddsi_shm: attached to segment %s (pid %"PRId32")\n", name, hdr->owner_pid);
+      peer = ddsrt_malloc (sizeof (*peer));
+      peer->loc = *loc;
+      peer->loc.tran = NULL;
+      peer->hdr = hdr;
+      peer->size = (size_t) st.st_size;
+      peer->refc = 0;
+    }
+    else
+    {
+      munmap (p, (size_t) st.st_size);
+    }
+  }
+  close (fd);
+  return peer;
+}
+
+static void shm_peer_free (struct shm_peer *peer)
+{
+  munmap (peer->hdr, peer->size);
+  ddsrt_free (peer);
+}
+
+static struct shm_peer *shm_peertab_lookup (const struct shm_peertab *tab, const nn_locator_t *loc)
+{
+  uint32_t lo = 0, hi = (tab == NULL) ? 0 : tab->n;
+  while (lo < hi)
+  {
+    const uint32_t m = lo + (hi - lo) / 2;
+    const int c = compare_locator (&tab->peers[m]->loc, loc);
+    if (c == 0)
+      return tab->peers[m];
+    else if (c < 0)
+      lo = m + 1;
+    else
+      hi = m;
+  }
+  return NULL;
+}
+
+static void shm_gc_peertab (struct gcreq *gcreq)
+{
+  struct shm_peertab_gc *arg = gcreq->arg;
+  for (uint32_t i = 0; i < arg->ndead; i++)
+    shm_peer_free (arg->dead[i]);
+  ddsrt_free (arg->tab);
+  ddsrt_free (arg);
+  gcreq_free (gcreq);
+}
+
+static void shm_peertab_publish (ddsi_shm_conn_t conn, struct shm_peer **peers, uint32_t n, struct shm_peertab_gc *gcarg)
+{
+  /* must be called with m_lock held, takes ownership of gcarg */
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  struct shm_peertab *tab = ddsrt_malloc (sizeof (*tab) + n * sizeof (tab->peers[0]));
+  struct gcreq *gcreq;
+  tab->n = n;
+  memcpy (tab->peers, peers, n * sizeof (tab->peers[0]));
+  qsort (tab->peers, n, sizeof (tab->peers[0]), compare_peer);
+  gcarg->tab = ddsrt_atomic_ldvoidp (&conn->m_peertab);
+  ddsrt_atomic_fence_rel ();
+  ddsrt_atomic_stvoidp (&conn->m_peertab, tab);
+  gcreq = gcreq_new (gv->gcreq_queue, shm_gc_peertab);
+  gcreq->arg = gcarg;
+  gcreq_enqueue (gcreq);
+}
+
+static bool shm_same_identity (const ddsi_shm_conn_t conn, const struct nn_adlink_participant_version_info *info)
+{
+  const uint32_t *id = shm_factory_identity (&conn->m_base);
+  return (info->flags & NN_ADLINK_FL_SHARED_MEMORY) && memcmp (info->unused, id, 3 * sizeof (*id)) == 0;
+}
+
+void ddsi_shm_set_participant_version_info (const struct ddsi_domaingv *gv, struct nn_adlink_participant_version_info *info)
+{
+  const struct ddsi_tran_conn *conn = gv->shm_disc_conn ? gv->shm_disc_conn : gv->shm_data_conn;
+  if (conn != NULL)
+  {
+    info->flags |= NN_ADLINK_FL_SHARED_MEMORY;
+    memcpy (info->unused, shm_factory_identity (conn), sizeof (info->unused));
+  }
+}
+
+void ddsi_shm_add_peer (struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix, const struct nn_adlink_participant_version_info *info, uint32_t nlocs, const nn_locator_t *locs)
+{
+  ddsi_shm_conn_t conn = (ddsi_shm_conn_t) gv->shm_xmit_conn;
+  const struct shm_peertab *tab;
+  struct shm_peertab_gc *gcarg;
+  struct shm_peer **peers;
+  struct shm_reg *reg;
+  ddsrt_avl_ipath_t ip;
+  uint32_t n;
+
+  if (conn == NULL || !shm_same_identity (conn, info))
+    return;
+  ddsrt_mutex_lock (&conn->m_lock);
+  if (ddsrt_avl_lookup_ipath (&shm_regs_td, &conn->m_regs, prefix, &ip) != NULL)
+  {
+    ddsrt_mutex_unlock (&conn->m_lock);
+    return;
+  }
+  tab = ddsrt_atomic_ldvoidp (&conn->m_peertab);
+  n = (tab == NULL) ? 0 : tab->n;
+  peers = ddsrt_malloc ((n + nlocs) * sizeof (*peers));
+  gcarg = ddsrt_malloc (sizeof (*gcarg) + nlocs * sizeof (gcarg->dead[0]));
+  gcarg->ndead = 0;
+  if (n > 0)
+    memcpy (peers, tab->peers, n * sizeof (*peers));
+  reg = ddsrt_malloc (sizeof (*reg));
+  reg->prefix = *prefix;
+  reg->nlocs = 0;
+  reg->locs = ddsrt_malloc ((nlocs > 0 ? nlocs : 1) * sizeof (*reg->locs));
+  for (uint32_t i = 0; i < nlocs; i++)
+  {
+    struct shm_peer *peer, *newpeer;
+    uint32_t j;
+    if (locs[i].kind != NN_LOCATOR_KIND_UDPv4 && locs[i].kind != NN_LOCATOR_KIND_UDPv6)
+      continue;
+    for (j = 0; j < reg->nlocs; j++)
+      if (compare_locator (&reg->locs[j], &locs[i]) == 0)
+        break;
+    if (j < reg->nlocs)
+      continue;
+    for (j = 0; j < n; j++)
+      if (compare_locator (&peers[j]->loc, &locs[i]) == 0)
+        break;
+    if (j < n && shm_owner_alive (peers[j]->hdr))
+      peer = peers[j];
+    else if ((newpeer = shm_peer_attach (conn, &locs[i])) == NULL)
+      continue;
+    else if (j == n)
+      peer = peers[n++] = newpeer;
+    else
+    {
+      /* the segment got replaced because the owning process restarted
+         before its old incarnation was removed: take over its references */
+      newpeer->refc = peers[j]->refc;
+      gcarg->dead[gcarg->ndead++] = peers[j];
+      peer = peers[j] = newpeer;
+    }
+    peer->refc++;
+    reg->locs[reg->nlocs++] = peer->loc;
+  }
+  if (reg->nlocs == 0)
+  {
+    ddsrt_free (reg->locs);
+    ddsrt_free (reg);
+    ddsrt_free (gcarg);
+  }
+  else
+  {
+    GVLOGDISC (" (shm %"PRIu32")", reg->nlocs);
+    ddsrt_avl_insert_ipath (&shm_regs_td, &conn->m_regs, reg, &ip);
+    shm_peertab_publish (conn, peers, n, gcarg);
+  }
+  ddsrt_free (peers);
+  ddsrt_mutex_unlock (&conn->m_lock);
+}
+
+void ddsi_shm_remove_peer (struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix)
+{
+  ddsi_shm_conn_t conn = (ddsi_shm_conn_t) gv->shm_xmit_conn;
+  const struct shm_peertab *tab;
+  struct shm_peertab_gc *gcarg;
+  struct shm_peer **peers;
+  struct shm_reg *reg;
+  ddsrt_avl_dpath_t dp;
+  uint32_t n = 0;
+
+  if (conn == NULL)
+    return;
+  ddsrt_mutex_lock (&conn->m_lock);
+  if ((reg = ddsrt_avl_lookup_dpath (&shm_regs_td, &conn->m_regs, prefix, &dp)) == NULL)
+  {
+    ddsrt_mutex_unlock (&conn->m_lock);
+    return;
+  }
+  ddsrt_avl_delete_dpath (&shm_regs_td, &conn->m_regs, reg, &dp);
+  tab = ddsrt_atomic_ldvoidp (&conn->m_peertab);
+  assert (tab != NULL);
+  peers = ddsrt_malloc ((tab->n > 0 ? tab->n : 1) * sizeof (*peers));
+  gcarg = ddsrt_malloc (sizeof (*gcarg) + reg->nlocs * sizeof (gcarg->dead[0]));
+  gcarg->ndead = 0;
+  for (uint32_t i = 0; i < tab->n; i++)
+  {
+    struct shm_peer * const peer = tab->peers[i];
+    for (uint32_t j = 0; j < reg->nlocs; j++)
+    {
+      if (compare_locator (&peer->loc, &reg->locs[j]) == 0)
+      {
+        assert (peer->refc > 0);
+        peer->refc--;
+        break;
+      }
+    }
+    if (peer->refc > 0)
+      peers[n++] = peer;
+    else
+      gcarg->dead[gcarg->ndead++] = peer;
+  }
+  shm_peertab_publish (conn, peers, n, gcarg);
+  ddsrt_free (peers);
+  ddsrt_free (reg->locs);
+  ddsrt_free (reg);
+  ddsrt_mutex_unlock (&conn->m_lock);
+}
+
+static struct shm_peer *shm_lookup_peer (ddsi_shm_conn_t conn, const nn_locator_t *loc)
+{
+  /* must be called while awake, which guarantees the table and the segments
+     remain valid */
+  struct shm_peer *peer = shm_peertab_lookup (ddsrt_atomic_ldvoidp (&conn->m_peertab), loc);
+  return (peer != NULL && ddsrt_atomic_ld32 (&peer->hdr->alive)) ? peer : NULL;
+}
+
+bool ddsi_shm_peer_reachable (const struct ddsi_domaingv *gv, const nn_locator_t *loc)
+{
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  bool reachable;
+  if (gv->shm_xmit_conn == NULL)
+    return false;
+  thread_state_awake (ts1, gv);
+  reachable = (shm_lookup_peer ((ddsi_shm_conn_t) gv->shm_xmit_conn, loc) != NULL);
+  thread_state_asleep (ts1);
+  return reachable;
+}
+
+static ssize_t ddsi_shm_conn_write (ddsi_tran_conn_t conn_cmn, const nn_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
+{
+  ddsi_shm_conn_t conn = (ddsi_shm_conn_t) conn_cmn;
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  const struct shm_peer *peer;
+  ssize_t ret = -1;
+  size_t len = 0;
+  (void) flags;
+
+  for (size_t i = 0; i < niov; i++)
+    len += iov[i].iov_len;
+
+  if (dst == NULL)
+  {
+    /* writing to a receiving conn itself is used for waking up the receive
+       thread, there is no one else to send to */
+    if (conn->m_hdr == NULL)
+      return -1;
+    return shm_enqueue (conn->m_hdr, &conn->m_srcloc, niov, iov, len) ? (ssize_t) len : -1;
+  }
+
+  /* a locator that is not registered, a full ring or an oversized message
+     means the caller falls back to the regular transport */
+  thread_state_awake (ts1, gv);
+  if ((peer = shm_lookup_peer (conn, dst)) != NULL && shm_enqueue (peer->hdr, &conn->m_srcloc, niov, iov, len))
+    ret = (ssize_t) len;
+  thread_state_asleep (ts1);
+  return ret;
+}
+
+static ddsrt_socket_t ddsi_shm_conn_handle (ddsi_tran_base_t conn_cmn)
+{
+  (void) conn_cmn;
+  return DDSRT_INVALID_SOCKET;
+}
+
+static bool ddsi_shm_supports (const struct ddsi_tran_factory *fact, int32_t kind)
+{
+  /* never used for mapping locators, it only shadows the UDP transport */
+  (void) fact;
+  (void) kind;
+  return false;
+}
+
+static int ddsi_shm_conn_locator (ddsi_tran_factory_t fact, ddsi_tran_base_t conn_cmn, nn_locator_t *loc)
+{
+  (void) fact;
+  (void) conn_cmn;
+  (void) loc;
+  return -1;
+}
+
+static bool shm_remove_stale_segment (struct ddsi_domaingv *gv, const char *name)
+{
+  /* The UDP socket with this port is ours and the name includes the network
+     namespace, so an existing segment is normally a left-over of a crashed
+     process.  But a process in another PID namespace sharing /dev/shm could
+     still be using it, so only remove it if its owner no longer exists. */
+  struct stat st;
+  bool stale = true;
+  int fd;
+  if ((fd = shm_open (name, O_RDONLY, 0)) < 0)
+    return (errno == ENOENT);
+  if (fstat (fd, &st) < 0)
+    stale = false;
+  else if ((size_t) st.st_size >= sizeof (struct shm_hdr))
+  {
+    void *p = mmap (NULL, sizeof (struct shm_hdr), PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      stale = false;
+    else
+    {
+      const struct shm_hdr *hdr = p;
+      if (shm_pid_alive (hdr->owner_pid))
+      {
+        GVWARNING ("ddsi_shm: segment %s in use by pid %"PRId32"\n", name, hdr->owner_pid);
+        stale = false;
+      }
+      munmap (p, sizeof (struct shm_hdr));
+    }
+  }
+  close (fd);
+  if (stale)
+  {
+    GVLOG (DDS_LC_CONFIG, "ddsi_shm: removing stale segment %s\n", name);
+    (void) shm_unlink (name);
+  }
+  return stale;
+}
+
+static dds_return_t shm_create_segment (ddsi_shm_conn_t conn, uint32_t port)
+{
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  uint32_t slot_size, stride, nslots;
+  struct shm_hdr *hdr;
+  void *p;
+  int fd;
+
+  /* Messages are normally limited to MaxMessageSize, but a single submessage
+     may exceed it; those that don't fit take the regular path */
+  slot_size = (gv->config.max_msg_size + gv->config.fragment_size + 7u) & ~7u;
+  stride = (uint32_t) ((sizeof (struct shm_slot) + slot_size + 63u) & ~(size_t) 63u);
+  nslots = 4;
+  while ((uint64_t) 2 * nslots * stride <= gv->config.shm_ring_size)
+    nslots *= 2;
+
+  shm_name (conn->m_name, sizeof (conn->m_name), shm_factory_identity (&conn->m_base), gv->config.extDomainId.value, port);
+  if (!shm_remove_stale_segment (gv, conn->m_name))
+    return DDS_RETCODE_ERROR;
+  if ((fd = shm_open (conn->m_name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+  {
+    GVWARNING ("ddsi_shm: can't create segment %s (errno %d)\n", conn->m_name, errno);
+    return DDS_RETCODE_ERROR;
+  }
+  conn->m_size = sizeof (*hdr) + (size_t) nslots * stride;
+  if (ftruncate (fd, (off_t) conn->m_size) < 0 ||
+      (p = mmap (NULL, conn->m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+  {
+    GVWARNING ("ddsi_shm: can't map segment %s (errno %d)\n", conn->m_name, errno);
+    close (fd);
+    shm_unlink (conn->m_name);
+    return DDS_RETCODE_ERROR;
+  }
+  close (fd);
+
+  hdr = p;
+  hdr->nslots = nslots;
+  hdr->slot_size = slot_size;
+  hdr->stride = stride;
+  hdr->owner_pid = (int32_t) getpid ();
+  ddsrt_atomic_st32 (&hdr->enq_pos, 0);
+  ddsrt_atomic_st32 (&hdr->sleeping, 0);
+  hdr->deq_pos = 0;
+  for (uint32_t i = 0; i < nslots; i++)
+    ddsrt_atomic_st32 (&shm_slot (hdr, i)->seq, i);
+  ddsrt_atomic_st32 (&hdr->alive, 1);
+  ddsrt_atomic_fence_rel ();
+  hdr->magic = SHM_MAGIC;
+  conn->m_hdr = hdr;
+  GVLOG (DDS_LC_CONFIG, "ddsi_shm: segment %s: %"PRIu32" slots of %"PRIu32" bytes\n", conn->m_name, nslots, slot_size);
+  return DDS_RETCODE_OK;
+}
+
+static dds_return_t ddsi_shm_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_factory_t fact, uint32_t port, const ddsi_tran_qos_t *qos)
+{
+  struct ddsi_domaingv * const gv = fact->gv;
+  ddsi_shm_conn_t conn = ddsrt_malloc (sizeof (*conn));
+  memset (conn, 0, sizeof (*conn));
+
+  ddsi_factory_conn_init (fact, &conn->m_base);
+  conn->m_base.m_base.m_port = port;
+  conn->m_base.m_base.m_trantype = DDSI_TRAN_CONN;
+  conn->m_base.m_base.m_multicast = false;
+  conn->m_base.m_base.m_handle_fn = ddsi_shm_conn_handle;
+  conn->m_base.m_read_fn = ddsi_shm_conn_read;
+  conn->m_base.m_write_fn = ddsi_shm_conn_write;
+  conn->m_base.m_locator_fn = ddsi_shm_conn_locator;
+  ddsrt_mutex_init (&conn->m_lock);
+  ddsrt_atomic_stvoidp (&conn->m_peertab, NULL);
+  ddsrt_avl_init (&shm_regs_td, &conn->m_regs);
+
+  switch (qos->m_purpose)
+  {
+    case DDSI_TRAN_QOS_XMIT:
+      /* messages are sent on behalf of the regular transmit socket */
+      if (ddsi_conn_locator (gv->xmit_conn, &conn->m_srcloc) < 0)
+        conn->m_srcloc = gv->loc_default_uc;
+      break;
+    case DDSI_TRAN_QOS_RECV_UC:
+      conn->m_srcloc = gv->loc_default_uc;
+      if (shm_create_segment (conn, port) != DDS_RETCODE_OK)
+        goto fail;
+      break;
+    case DDSI_TRAN_QOS_RECV_MC:
+      goto fail;
+  }
+  GVTRACE ("ddsi_shm_create_conn %s port %"PRIu32"\n", conn->m_hdr ? "receive" : "transmit", port);
+  *conn_out = &conn->m_base;
+  return DDS_RETCODE_OK;
+
+fail:
+  ddsrt_mutex_destroy (&conn->m_lock);
+  ddsrt_free (conn);
+  return DDS_RETCODE_ERROR;
+}
+
+static void free_reg (void *vreg)
+{
+  struct shm_reg *reg = vreg;
+  ddsrt_free (reg->locs);
+  ddsrt_free (reg);
+}
+
+static void ddsi_shm_release_conn (ddsi_tran_conn_t conn_cmn)
+{
+  ddsi_shm_conn_t conn = (ddsi_shm_conn_t) conn_cmn;
+  struct ddsi_domaingv const * const gv = conn->m_base.m_base.gv;
+  struct shm_peertab *tab;
+  GVTRACE ("ddsi_shm_release_conn port %"PRIu32"\n", conn->m_base.m_base.m_port);
+  if (conn->m_hdr)
+  {
+    ddsrt_atomic_st32 (&conn->m_hdr->alive, 0);
+    (void) shm_unlink (conn->m_name);
+    munmap (conn->m_hdr, conn->m_size);
+  }
+  /* replaced tables have been handed to the garbage collector, which has
+     been stopped by now */
+  if ((tab = ddsrt_atomic_ldvoidp (&conn->m_peertab)) != NULL)
+  {
+    for (uint32_t i = 0; i < tab->n; i++)
+      shm_peer_free (tab->peers[i]);
+    ddsrt_free (tab);
+  }
+  ddsrt_avl_free (&shm_regs_td, &conn->m_regs, free_reg);
+  ddsrt_mutex_destroy (&conn->m_lock);
+  ddsrt_free (conn);
+}
+
+static int ddsi_shm_join_mc (ddsi_tran_conn_t conn, const nn_locator_t *srcloc, const nn_locator_t *mcloc, const struct nn_interface *interf)
+{
+  (void) conn; (void) srcloc; (void) mcloc; (void) interf;
+  return -1;
+}
+
+static int ddsi_shm_leave_mc (ddsi_tran_conn_t conn, const nn_locator_t *srcloc, const nn_locator_t *mcloc, const struct nn_interface *interf)
+{
+  (void) conn; (void) srcloc; (void) mcloc; (void) interf;
+  return -1;
+}
+
+static int ddsi_shm_is_mcaddr (const ddsi_tran_factory_t tran, const nn_locator_t *loc)
+{
+  (void) tran;
+  (void) loc;
+  return 0;
+}
+
+static enum ddsi_nearby_address_result ddsi_shm_is_nearby_address (const nn_locator_t *loc, const nn_locator_t *ownloc, size_t ninterf, const struct nn_interface *interf)
+{
+  (void) loc; (void) ownloc; (void) ninterf; (void) interf;
+  return DNAR_DISTANT;
+}
+
+static enum ddsi_locator_from_string_result ddsi_shm_address_from_string (ddsi_tran_factory_t tran, nn_locator_t *loc, const char *str)
+{
+  (void) tran; (void) loc; (void) str;
+  return AFSR_INVALID;
+}
+
+static char *ddsi_shm_locator_to_string (char *dst, size_t sizeof_dst, const nn_locator_t *loc, int with_port)
+{
+  if (with_port)
+    (void) snprintf (dst, sizeof_dst, "%"PRIu32, loc->port);
+  else if (sizeof_dst > 0)
+    dst[0] = 0;
+  return dst;
+}
+
+static int ddsi_shm_enumerate_interfaces (ddsi_tran_factory_t fact, enum transport_selector transport_selector, ddsrt_ifaddrs_t **ifs)
+{
+  (void) fact; (void) transport_selector;
+  *ifs = NULL;
+  return 0;
+}
+
+static int ddsi_shm_is_valid_port (ddsi_tran_factory_t fact, uint32_t port)
+{
+  (void) fact;
+  return (port <= 65535);
+}
+
+static void ddsi_shm_fini (ddsi_tran_factory_t fact)
+{
+  struct ddsi_domaingv const * const gv = fact->gv;
+  GVLOG (DDS_LC_CONFIG, "shm finalized\n");
+  ddsrt_free (fact);
+}
+
+int ddsi_shm_init (struct ddsi_domaingv *gv)
+{
+  struct ddsi_shm_tran_factory *fact = ddsrt_malloc (sizeof (*fact));
+  memset (fact, 0, sizeof (*fact));
+  if (!shm_identity (fact->m_identity))
+  {
+    GVWARNING ("ddsi_shm: can't determine the identity of the host and network namespace\n");
+    ddsrt_free (fact);
+    return -1;
+  }
+  fact->m_base.gv = gv;
+  fact->m_base.m_free_fn = ddsi_shm_fini;
+  fact->m_base.m_kind = NN_LOCATOR_KIND_INVALID;
+  fact->m_base.m_typename = "shm";
+  fact->m_base.m_default_spdp_address = NULL;
+  fact->m_base.m_connless = true;
+  fact->m_base.m_supports_fn = ddsi_shm_supports;
+  fact->m_base.m_create_conn_fn = ddsi_shm_create_conn;
+  fact->m_base.m_release_conn_fn = ddsi_shm_release_conn;
+  fact->m_base.m_join_mc_fn = ddsi_shm_join_mc;
+  fact->m_base.m_leave_mc_fn = ddsi_shm_leave_mc;
+  fact->m_base.m_is_mcaddr_fn = ddsi_shm_is_mcaddr;
+  fact->m_base.m_is_nearby_address_fn = ddsi_shm_is_nearby_address;
+  fact->m_base.m_locator_from_string_fn = ddsi_shm_address_from_string;
+  fact->m_base.m_locator_to_string_fn = ddsi_shm_locator_to_string;
+  fact->m_base.m_enumerate_interfaces_fn = ddsi_shm_enumerate_interfaces;
+  fact->m_base.m_is_valid_port_fn = ddsi_shm_is_valid_port;
+  ddsi_factory_add (gv, &fact->m_base);
+  GVLOG (DDS_LC_CONFIG, "shm initialized\n");
+  return 0;
+}
+
+#else
+
+int ddsi_shm_init (struct ddsi_domaingv *gv)
+{
+  (void) gv;
+  return -1;
+}
+
+void ddsi_shm_set_participant_version_info (const struct ddsi_domaingv *gv, struct nn_adlink_participant_version_info *info)
+{
+  (void) gv; (void) info;
+}
+
+void ddsi_shm_add_peer (struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix, const struct nn_adlink_participant_version_info *info, uint32_t nlocs, const nn_locator_t *locs)
+{
+  (void) gv; (void) prefix; (void) info; (void) nlocs; (void) locs;
+}
+
+void ddsi_shm_remove_peer (struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix)
+{
+  (void) gv; (void) prefix;
+}
+
+bool ddsi_shm_peer_reachable (const struct ddsi_domaingv *gv, const nn_locator_t *loc)
+{
+  (void) gv; (void) loc;
+  return false;
+}
+
+bool ddsi_shm_segment_name (char *dst, size_t size, uint32_t domain_id, uint32_t port)
+{
+  (void) dst; (void) size; (void) domain_id; (void) port;
+  return false;
+}
+
+#endif /* defined(__linux) && !LWIP_SOCKET */
@@ -24,6 +24,8 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/q_log.h"
 #include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_sockwaitset.h"
+#include "dds/ddsi/q_receive.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 
 #define INVALID_PORT (~0u)
@@ -37,6 +39,13 @@
   is not removed from cache but simply flagged as failed (may be subsequently
   replaced). Similarly server side sockets are not closed as are also used in socket
   wait set that manages their lifecycle.
+
+  Reads go through a receive buffer so that a single recv can yield many DDSI
+  messages; the buffer is only touched by the receive thread. Writes that do
+  not fit in the socket's send buffer are appended to a send queue (protected
+  by the mutex), which the receive thread drains once the socket becomes
+  writable. Once anything is queued, all subsequent writes are queued behind
+  it to preserve the byte stream.
 */
 
 union addr {
@@ -47,12 +56,26 @@ union addr {
 #endif
 };
 
+struct ddsi_tcp_sendq_elem {
+  struct ddsi_tcp_sendq_elem *next;
+  size_t len;
+  size_t off;
+  unsigned char data[];
+};
+
 typedef struct ddsi_tcp_conn {
   struct ddsi_tran_conn m_base;
   union addr m_peer_addr;
   uint32_t m_peer_port;
   ddsrt_mutex_t m_mutex;
   ddsrt_socket_t m_sock;
+  unsigned char *m_rbuf;
+  size_t m_rbuf_pos;
+  size_t m_rbuf_end;
+  struct ddsi_tcp_sendq_elem *m_sendq_first;
+  struct ddsi_tcp_sendq_elem *m_sendq_last;
+  size_t m_sendq_bytes;
+  ddsrt_mtime_t m_sendq_tprogress;
 #ifdef DDSI_INCLUDE_SSL
   SSL * m_ssl;
 #endif
@@ -252,6 +275,7 @@ static void ddsi_tcp_conn_connect (ddsi_tcp_conn_t conn, const ddsrt_msghdr_t *
   struct ddsi_domaingv const * const gv = fact->fact.gv;
   char buff[DDSI_LOCSTRLEN];
   ddsrt_socket_t sock;
+  os_sockWaitset ws;
   dds_return_t ret;
 
   if (ddsi_tcp_sock_new (fact, &sock, 0) != DDS_RETCODE_OK)
@@ -287,10 +311,13 @@ static void ddsi_tcp_conn_connect (ddsi_tcp_conn_t conn, const ddsrt_msghdr_t *
 
   (void)ddsrt_setsocknonblocking(conn->m_sock, true);
 
-  assert (conn->m_base.m_base.gv->n_recv_threads > 0);
-  assert (conn->m_base.m_base.gv->recv_threads[0].arg.mode == RTM_MANY);
-  os_sockWaitsetAdd (conn->m_base.m_base.gv->recv_threads[0].arg.u.many.ws, &conn->m_base);
-  os_sockWaitsetTrigger (conn->m_base.m_base.gv->recv_threads[0].arg.u.many.ws);
+  if ((ws = recv_thread_waitset (gv)) == NULL)
+    GVWARNING ("tcp connect socket %"PRIdSOCK": no receive thread for connections\n", sock);
+  else
+  {
+    os_sockWaitsetAdd (ws, &conn->m_base);
+    os_sockWaitsetTrigger (ws);
+  }
   return;
 
 fail_w_socket:
@@ -457,6 +484,7 @@ static ssize_t ddsi_tcp_conn_read (ddsi_tran_conn_t conn, unsigned char *buf, si
 {
   struct ddsi_tran_factory_tcp * const fact = (struct ddsi_tran_factory_tcp *) conn->m_factory;
   struct ddsi_domaingv const * const gv = fact->fact.gv;
+  const size_t rbuf_size = gv->config.tcp_rbuf_size;
   dds_return_t rc;
   ddsi_tcp_conn_t tcp = (ddsi_tcp_conn_t) conn;
   ssize_t (*rd) (ddsi_tcp_conn_t, void *, size_t, dds_return_t * err) = ddsi_tcp_conn_read_plain;
@@ -470,9 +498,31 @@ static ssize_t ddsi_tcp_conn_read (ddsi_tran_conn_t conn, unsigned char *buf, si
   }
 #endif
 
+  if (rbuf_size > 0 && tcp->m_rbuf == NULL)
+    tcp->m_rbuf = ddsrt_malloc (rbuf_size);
+
   while (true)
   {
-    n = rd (tcp, (char *) buf + pos, len - pos, &rc);
+    if (tcp->m_rbuf_pos < tcp->m_rbuf_end)
+    {
+      /* Serve from what a previous read left in the receive buffer */
+      const size_t avail = tcp->m_rbuf_end - tcp->m_rbuf_pos;
+      n = (ssize_t) ((avail < len - pos) ? avail : len - pos);
+      memcpy (buf + pos, tcp->m_rbuf + tcp->m_rbuf_pos, (size_t) n);
+      tcp->m_rbuf_pos += (size_t) n;
+    }
+    else if (len - pos >= rbuf_size)
+    {
+      /* Large reads gain nothing from an intermediate copy */
+      n = rd (tcp, (char *) buf + pos, len - pos, &rc);
+    }
+    else if ((n = rd (tcp, tcp->m_rbuf, rbuf_size, &rc)) > 0)
+    {
+      tcp->m_rbuf_pos = 0;
+      tcp->m_rbuf_end = (size_t) n;
+      continue;
+    }
+
     if (n > 0)
     {
       pos += (size_t) n;
@@ -516,6 +566,12 @@ static ssize_t ddsi_tcp_conn_read (ddsi_tran_conn_t conn, unsigned char *buf, si
   return -1;
 }
 
+static bool ddsi_tcp_conn_buffered (ddsi_tran_conn_t conn)
+{
+  ddsi_tcp_conn_t tcp = (ddsi_tcp_conn_t) conn;
+  return tcp->m_rbuf_pos < tcp->m_rbuf_end;
+}
+
 static ssize_t ddsi_tcp_conn_write_plain (ddsi_tcp_conn_t conn, const void * buf, size_t len, dds_return_t *rc)
 {
   ssize_t sent = -1;
@@ -591,6 +647,121 @@ static void set_msghdr_iov (ddsrt_msghdr_t *mhdr, ddsrt_iovec_t *iov, size_t iov
   mhdr->msg_iovlen = (ddsrt_msg_iovlen_t)iovlen;
 }
 
+static void ddsi_tcp_sendq_free (ddsi_tcp_conn_t conn)
+{
+  struct ddsi_tcp_sendq_elem *e;
+  while ((e = conn->m_sendq_first) != NULL)
+  {
+    conn->m_sendq_first = e->next;
+    ddsrt_free (e);
+  }
+  conn->m_sendq_last = NULL;
+  conn->m_sendq_bytes = 0;
+  ddsrt_atomic_st32 (&conn->m_base.m_write_pending, 0);
+}
+
+static void ddsi_tcp_sendq_append (ddsi_tcp_conn_t conn, const ddsrt_msghdr_t *msg, size_t skip, size_t len)
+{
+  /* Copies all but the first SKIP bytes of the LEN bytes in MSG to the tail of the queue */
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  struct ddsi_tcp_sendq_elem *e = ddsrt_malloc (sizeof (*e) + len - skip);
+  size_t off = 0;
+  e->next = NULL;
+  e->len = len - skip;
+  e->off = 0;
+  for (int i = 0; i < (int) msg->msg_iovlen; i++)
+  {
+    size_t n = msg->msg_iov[i].iov_len;
+    const char *p = msg->msg_iov[i].iov_base;
+    if (skip >= n)
+    {
+      skip -= n;
+      continue;
+    }
+    memcpy (e->data + off, p + skip, n - skip);
+    off += n - skip;
+    skip = 0;
+  }
+  assert (off == e->len);
+  if (conn->m_sendq_first == NULL)
+  {
+    conn->m_sendq_first = e;
+    conn->m_sendq_tprogress = ddsrt_time_monotonic ();
+  }
+  else
+  {
+    conn->m_sendq_last->next = e;
+  }
+  conn->m_sendq_last = e;
+  conn->m_sendq_bytes += e->len;
+  if (ddsrt_atomic_ld32 (&conn->m_base.m_write_pending) == 0)
+  {
+    ddsrt_atomic_st32 (&conn->m_base.m_write_pending, 1);
+    os_sockWaitsetWantWrite (recv_thread_waitset (gv), &conn->m_base);
+  }
+}
+
+static void ddsi_tcp_conn_flush (ddsi_tran_conn_t base)
+{
+  /* Called by the receive thread once the socket is writable */
+  ddsi_tcp_conn_t conn = (ddsi_tcp_conn_t) base;
+  struct ddsi_domaingv * const gv = conn->m_base.m_base.gv;
+  bool failed = false;
+  int sendflags = 0;
+#ifdef MSG_NOSIGNAL
+  sendflags |= MSG_NOSIGNAL;
+#endif
+
+  ddsrt_mutex_lock (&conn->m_mutex);
+  while (conn->m_sendq_first && !failed)
+  {
+    ddsrt_iovec_t iov[16];
+    ddsrt_msghdr_t msg;
+    struct ddsi_tcp_sendq_elem *e;
+    dds_return_t rc;
+    ssize_t ret;
+    size_t niov = 0;
+    for (e = conn->m_sendq_first; e && niov < sizeof (iov) / sizeof (iov[0]); e = e->next, niov++)
+    {
+      iov[niov].iov_base = e->data + e->off;
+      iov[niov].iov_len = (ddsrt_iov_len_t) (e->len - e->off);
+    }
+    memset (&msg, 0, sizeof (msg));
+    set_msghdr_iov (&msg, iov, niov);
+    rc = ddsrt_sendmsg (conn->m_sock, &msg, sendflags, &ret);
+    if (rc == DDS_RETCODE_INTERRUPTED)
+      continue;
+    else if (rc == DDS_RETCODE_TRY_AGAIN)
+      break;
+    else if (rc != DDS_RETCODE_OK || ret <= 0)
+    {
+      GVLOG (DDS_LC_TCP, "tcp flush: sock %"PRIdSOCK" error %"PRId32", dropping %"PRIuSIZE" queued bytes\n", conn->m_sock, rc, conn->m_sendq_bytes);
+      failed = true;
+      break;
+    }
+    conn->m_sendq_tprogress = ddsrt_time_monotonic ();
+    conn->m_sendq_bytes -= (size_t) ret;
+    while ((e = conn->m_sendq_first) != NULL && (size_t) ret >= e->len - e->off)
+    {
+      ret -= (ssize_t) (e->len - e->off);
+      conn->m_sendq_first = e->next;
+      ddsrt_free (e);
+    }
+    if (e)
+      e->off += (size_t) ret;
+    else
+      conn->m_sendq_last = NULL;
+  }
+  if (failed || conn->m_sendq_first == NULL)
+    ddsi_tcp_sendq_free (conn);
+  else
+    os_sockWaitsetWantWrite (recv_thread_waitset (gv), &conn->m_base);
+  ddsrt_mutex_unlock (&conn->m_mutex);
+
+  if (failed)
+    ddsi_tcp_cache_remove (conn);
+}
+
 static ssize_t ddsi_tcp_conn_write (ddsi_tran_conn_t base, const nn_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
 {
   struct ddsi_tran_factory_tcp * const fact = (struct ddsi_tran_factory_tcp *) base->m_factory;
@@ -604,6 +775,7 @@ static ssize_t ddsi_tcp_conn_write (ddsi_tran_conn_t base, const nn_locator_t *d
   ddsi_tcp_conn_t conn;
   int piecewise;
   bool connect = false;
+  bool dropped = false;
   ddsrt_msghdr_t msg;
   union {
     struct sockaddr_storage x;
@@ -687,11 +859,20 @@ static ssize_t ddsi_tcp_conn_write (ddsi_tran_conn_t base, const nn_locator_t *d
 #endif
     msg.msg_name = NULL;
     msg.msg_namelen = 0;
-    do
+    if (conn->m_sendq_first != NULL)
     {
-      rc = ddsrt_sendmsg (conn->m_sock, &msg, sendflags, &ret);
+      /* Must go behind what is already queued */
+      rc = DDS_RETCODE_TRY_AGAIN;
+      ret = -1;
+    }
+    else
+    {
+      do
+      {
+        rc = ddsrt_sendmsg (conn->m_sock, &msg, sendflags, &ret);
+      }
+      while (rc == DDS_RETCODE_INTERRUPTED);
     }
-    while (rc == DDS_RETCODE_INTERRUPTED);
     if (ret == -1)
     {
       if (rc == DDS_RETCODE_TRY_AGAIN)
@@ -725,7 +906,34 @@ static ssize_t ddsi_tcp_conn_write (ddsi_tran_conn_t base, const nn_locator_t *d
     }
   }
 
-  if (piecewise)
+  if (piecewise && gv->config.tcp_sendq_size > 0 && recv_thread_waitset (gv) != NULL
+#ifdef DDSI_INCLUDE_SSL
+      && !gv->config.ssl_enable
+#endif
+      )
+  {
+    /* A partially written message must be completed to keep the stream intact,
+       an unwritten one may be dropped if the queue is full; but a queue that
+       doesn't drain means the connection is as good as dead */
+    const dds_duration_t stalled = (conn->m_sendq_first == NULL) ? 0 : ddsrt_time_monotonic ().v - conn->m_sendq_tprogress.v;
+    if (stalled > gv->config.tcp_write_timeout)
+    {
+      GVWARNING ("tcp abandoning write on socket %"PRIdSOCK": no progress in %"PRIuSIZE" queued bytes\n", conn->m_sock, conn->m_sendq_bytes);
+      ddsi_tcp_sendq_free (conn);
+      ret = -1;
+    }
+    else if (ret == 0 && conn->m_sendq_bytes + len > gv->config.tcp_sendq_size)
+    {
+      GVLOG (DDS_LC_TCP, "tcp write: sock %"PRIdSOCK" send queue full, message dropped\n", conn->m_sock);
+      dropped = true;
+    }
+    else
+    {
+      ddsi_tcp_sendq_append (conn, &msg, (size_t) ret, len);
+      ret = (ssize_t) len;
+    }
+  }
+  else if (piecewise)
   {
     ssize_t (*wr) (ddsi_tcp_conn_t, const void *, size_t, dds_return_t *) = ddsi_tcp_conn_write_plain;
     int i = 0;
@@ -759,7 +967,11 @@ static ssize_t ddsi_tcp_conn_write (ddsi_tran_conn_t base, const nn_locator_t *d
 
   ddsrt_mutex_unlock (&conn->m_mutex);
 
-  if (ret == -1)
+  if (dropped)
+  {
+    return -1;
+  }
+  else if (ret == -1)
   {
     ddsi_tcp_cache_remove (conn);
   }
@@ -922,6 +1134,8 @@ static void ddsi_tcp_base_init (const struct ddsi_tran_factory_tcp *fact, struct
   base->m_write_fn = ddsi_tcp_conn_write;
   base->m_peer_locator_fn = ddsi_tcp_conn_peer_locator;
   base->m_disable_multiplexing_fn = 0;
+  base->m_buffered_fn = ddsi_tcp_conn_buffered;
+  base->m_flush_fn = ddsi_tcp_conn_flush;
   base->m_locator_fn = ddsi_tcp_locator;
 }
 
@@ -1001,6 +1215,8 @@ static void ddsi_tcp_conn_delete (ddsi_tcp_conn_t conn)
   {
     ddsi_tcp_sock_free (gv, conn->m_sock, "connection");
   }
+  ddsi_tcp_sendq_free (conn);
+  ddsrt_free (conn->m_rbuf);
   ddsrt_mutex_destroy (&conn->m_mutex);
   ddsrt_free (conn);
 }
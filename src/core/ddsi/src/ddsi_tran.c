@@ -160,6 +160,9 @@ void ddsi_conn_add_ref (ddsi_tran_conn_t conn)
 void ddsi_factory_conn_init (const struct ddsi_tran_factory *factory, ddsi_tran_conn_t conn)
 {
   ddsrt_atomic_st32 (&conn->m_count, 1);
+  ddsrt_atomic_st32 (&conn->m_write_pending, 0);
+  conn->m_buffered_fn = 0;
+  conn->m_flush_fn = 0;
   conn->m_connless = factory->m_connless;
   conn->m_stream = factory->m_stream;
   conn->m_factory = (struct ddsi_tran_factory *) factory;
@@ -172,6 +175,24 @@ void ddsi_conn_disable_multiplexing (ddsi_tran_conn_t conn)
     (conn->m_disable_multiplexing_fn) (conn);
 }
 
+bool ddsi_conn_buffered (ddsi_tran_conn_t conn)
+{
+  /* Whether data has been received from the socket that hasn't been read yet,
+     in which case the socket need not become readable before it is read */
+  return conn->m_buffered_fn ? (conn->m_buffered_fn) (conn) : false;
+}
+
+bool ddsi_conn_write_pending (ddsi_tran_conn_t conn)
+{
+  return ddsrt_atomic_ld32 (&conn->m_write_pending) != 0;
+}
+
+void ddsi_conn_flush (ddsi_tran_conn_t conn)
+{
+  if (conn->m_flush_fn)
+    (conn->m_flush_fn) (conn);
+}
+
 bool ddsi_conn_peer_locator (ddsi_tran_conn_t conn, nn_locator_t * loc)
 {
   if (conn->m_peer_locator_fn)
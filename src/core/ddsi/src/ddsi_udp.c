@@ -42,6 +42,7 @@ typedef struct ddsi_udp_conn {
   WSAEVENT m_sockEvent;
 #endif
   int m_diffserv;
+  union addr m_sockname; /* local address, for packet capture */
 } *ddsi_udp_conn_t;
 
 static void addr_to_loc (const struct ddsi_tran_factory *tran, nn_locator_t *dst, const union addr *src)
@@ -86,13 +87,7 @@ static ssize_t ddsi_udp_conn_read (ddsi_tran_conn_t conn_cmn, unsigned char * bu
       addr_to_loc (conn->m_base.m_factory, srcloc, &src);
 
     if (gv->pcap_fp)
-    {
-      union addr dest;
-      socklen_t dest_len = sizeof (dest);
-      if (ddsrt_getsockname (conn->m_sock, &dest.a, &dest_len) != DDS_RETCODE_OK)
-        memset (&dest, 0, sizeof (dest));
-      write_pcap_received (gv, ddsrt_time_wallclock (), &src.x, &dest.x, buf, (size_t) ret);
-    }
+      write_pcap_received (gv, ddsrt_time_wallclock (), &src.x, &conn->m_sockname.x, buf, (size_t) ret);
 
     /* Check for udp packet truncation */
 #if DDSRT_MSGHDR_FLAGS
@@ -165,13 +160,7 @@ static ssize_t ddsi_udp_conn_write (ddsi_tran_conn_t conn_cmn, const nn_locator_
 #endif
   } while (rc == DDS_RETCODE_INTERRUPTED || rc == DDS_RETCODE_TRY_AGAIN || (rc == DDS_RETCODE_NOT_ALLOWED && retry-- > 0));
   if (ret > 0 && gv->pcap_fp)
-  {
-    union addr sa;
-    socklen_t alen = sizeof (sa);
-    if (ddsrt_getsockname (conn->m_sock, &sa.a, &alen) != DDS_RETCODE_OK)
-      memset(&sa, 0, sizeof(sa));
-    write_pcap_sent (gv, ddsrt_time_wallclock (), &sa.x, &msg, (size_t) ret);
-  }
+    write_pcap_sent (gv, ddsrt_time_wallclock (), &conn->m_sockname.x, &msg, (size_t) ret);
   else if (rc != DDS_RETCODE_OK && rc != DDS_RETCODE_NOT_ALLOWED && rc != DDS_RETCODE_NO_CONNECTION)
   {
     GVERROR ("ddsi_udp_conn_write failed with retcode %"PRId32"\n", rc);
@@ -250,6 +239,19 @@ static dds_return_t set_dont_route (struct ddsi_domaingv const * const gv, ddsrt
   return rc;
 }
 
+#ifdef SO_BUSY_POLL
+static void set_busy_poll (struct ddsi_domaingv const * const gv, ddsrt_socket_t sock)
+{
+  /* Failure to set it (typically for lack of privileges) only costs some latency,
+     so it merely warrants a warning; platforms without SO_BUSY_POLL reject the
+     configuration instead */
+  const int usecs = (int) (gv->config.recv_busy_poll / 1000);
+  dds_return_t rc;
+  if ((rc = ddsrt_setsockopt (sock, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof (usecs))) != DDS_RETCODE_OK)
+    GVWARNING ("ddsi_udp_create_conn: set SO_BUSY_POLL = %d failed: %s\n", usecs, dds_strretcode (rc));
+}
+#endif
+
 static dds_return_t set_rcvbuf (struct ddsi_domaingv const * const gv, ddsrt_socket_t sock, const struct config_maybe_uint32 *min_size)
 {
   uint32_t size;
@@ -483,6 +485,10 @@ static dds_return_t ddsi_udp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_
     goto fail_w_socket;
   if (gv->config.dontRoute && (rc = set_dont_route (gv, sock, ipv6)) != DDS_RETCODE_OK)
     goto fail_w_socket;
+#ifdef SO_BUSY_POLL
+  if (qos->m_purpose != DDSI_TRAN_QOS_XMIT && gv->config.recv_busy_poll > 0 && gv->config.recv_busy_poll_socket)
+    set_busy_poll (gv, sock);
+#endif
 
   if ((rc = ddsrt_bind (sock, &socketname.a, ddsrt_sockaddr_get_size (&socketname.a))) != DDS_RETCODE_OK)
   {
@@ -521,6 +527,11 @@ static dds_return_t ddsi_udp_create_conn (ddsi_tran_conn_t *conn_out, ddsi_tran_
 
   conn->m_sock = sock;
   conn->m_diffserv = qos->m_diffserv;
+  {
+    socklen_t alen = sizeof (conn->m_sockname);
+    if (ddsrt_getsockname (sock, &conn->m_sockname.a, &alen) != DDS_RETCODE_OK)
+      memset (&conn->m_sockname, 0, sizeof (conn->m_sockname));
+  }
 #if defined _WIN32 && !defined WINCE
   conn->m_sockEvent = WSACreateEvent ();
   WSAEventSelect (conn->m_sock, conn->m_sockEvent, FD_WRITE);
@@ -177,9 +177,8 @@ DUPF(retransmit_merging);
 DUPF(sched_class);
 DUPF(maybe_memsize);
 DUPF(maybe_int32);
-#ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
 DUPF(bandwidth);
-#endif
+DUPF(maybe_bandwidth);
 DUPF(domainId);
 DUPF(transport_selector);
 DUPF(many_sockets_mode);
@@ -272,6 +271,8 @@ static const struct cfgelem general_cfgelems[] = {
   { LEAF("MaxMessageSize"), 1, "4096 B", ABSOFF(max_msg_size), 0, uf_memsize, 0, pf_memsize,
     BLURB("<p>This element specifies the maximum size of the UDP payload that DDSI2E will generate. DDSI2E will try to maintain this limit within the bounds of the DDSI specification, which means that in some cases (especially for very low values of MaxMessageSize) larger payloads may sporadically be observed (currently up to 1192 B).</p>\n\
 <p>On some networks it may be necessary to set this item to keep the packetsize below the MTU to prevent IP fragmentation. In those cases, it is generally advisable to also consider reducing Internal/FragmentSize.</p>") },
+  { LEAF("EnableSharedMemory"), 1, "false", ABSOFF(enable_shm), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element enables the exchange of messages with other processes on the same host via shared memory rather than the loopback interface. Each unicast receive socket gets a ring in shared memory, named after the host, network namespace, domain id and port number. Participants advertise their host and network namespace in the discovery data, and messages addressed to a unicast locator of a participant on the same host and in the same network namespace are written to the corresponding ring if it exists, falling back to the regular transport otherwise. Locators are not affected, so it works transparently with processes that do not use it. It is only available on Linux and in combination with the UDP transports, and multicasts still use the network.</p>") },
   { LEAF("FragmentSize"), 1, "1280 B", ABSOFF(fragment_size), 0, uf_memsize, 0, pf_memsize,
     BLURB("<p>This element specifies the size of DDSI sample fragments generated by DDSI2E. Samples larger than FragmentSize are fragmented into fragments of FragmentSize bytes each, except the last one, which may be smaller. The DDSI spec mandates a minimum fragment size of 1025 bytes, but DDSI2E will do whatever size is requested, accepting fragments of which the size is at least the minimum of 1025 and FragmentSize.</p>") },
   END_MARKER
@@ -379,6 +380,7 @@ static const struct cfgelem thread_properties_cfgattrs[] = {
     BLURB("<p>The Name of the thread for which properties are being set. The following threads exist:</p>\n\
 <ul><li><i>gc</i>: garbage collector thread involved in deleting entities;</li>\n\
 <li><i>recv</i>: receive thread, taking data from the network and running the protocol state machine;</li>\n\
+<li><i>recvMC</i>, <i>recvUC</i>: receive threads dedicated to the multicast and unicast data sockets (see Internal/MultipleReceiveThreads);</li>\n\
 <li><i>dq.builtins</i>: delivery thread for DDSI-builtin data, primarily for discovery;</li>\n\
 <li><i>lease</i>: DDSI liveliness monitoring;</li>\n\
 <li><i>tev</i>: general timed-event handling, retransmits and discovery;</li>\n\
@@ -484,6 +486,18 @@ static const struct cfgelem multiple_recv_threads_attrs[] = {
   END_MARKER
 };
 
+static const struct cfgelem recv_busy_poll_attrs[] = {
+  { ATTR("socket"), 1, "false", ABSOFF(recv_busy_poll_socket), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This attribute controls whether the SO_BUSY_POLL option is also set on the receive sockets, with the same duration as the busy-poll budget, so that the kernel polls the network device while the receive thread waits for data. It is only available on Linux, on other platforms setting it makes the configuration invalid, and raising it above the system-wide default may require special privileges.</p>") },
+  END_MARKER
+};
+
+static const struct cfgelem history_streaming_attrs[] = {
+  { ATTR("interval"), 1, "1 ms", ABSOFF(history_burst_interval), 0, uf_duration_us_1s, 0, pf_duration,
+    BLURB("<p>This attribute sets the interval between two consecutive bursts of historical data sent to a reader.</p>") },
+  END_MARKER
+};
+
 static const struct cfgelem internal_cfgelems[] = {
   { MOVED("MaxMessageSize", "CycloneDDS/General/MaxMessageSize") },
   { MOVED("FragmentSize", "CycloneDDS/General/FragmentSize") },
@@ -524,6 +538,10 @@ static const struct cfgelem internal_cfgelems[] = {
   { LEAF("RetransmitMergingPeriod"), 1, "5 ms", ABSOFF(retransmit_merging_period), 0, uf_duration_us_1s, 0, pf_duration,
     BLURB("<p>This setting determines the size of the time window in which a NACK of some sample is ignored because a retransmit of that sample has been multicasted too recently. This setting has no effect on unicasted retransmits.</p>\n\
 <p>See also Internal/RetransmitMerging.</p>") },
+  { LEAF("RetransmitCoalescingWindow"), 1, "0 ms", ABSOFF(retransmit_coalescing_window), 0, uf_duration_us_1s, 0, pf_duration,
+    BLURB("<p>This setting allows a reliable writer to collect the samples and fragments NACK'd by all its readers during this window before retransmitting them. Duplicate requests are then retransmitted only once, in order of sequence number, with as many consecutive fragments in a single message as fit in MaxMessageSize, and data requested by more than one reader is sent to all readers (using multicast if available) rather than to each reader individually. This reduces the retransmit traffic in case of correlated losses at the cost of delaying retransmits by at most the window. The default is 0, which retransmits each request immediately.</p>") },
+  { LEAF_W_ATTRS("HistoricalDataStreaming", history_streaming_attrs), 1, "0 B", ABSOFF(history_burst_bytes), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This element enables streaming the history of a reliable transient-local writer to a late-joining transient-local reader: instead of the reader requesting the samples it misses in response to heartbeats, the writer sends them directly to that reader in bursts of this many bytes, packed into as few messages as possible and with the interval between bursts set by the interval attribute. Retransmits requested by the reader for samples that are still to be streamed are served as usual and the stream continues after them, and once the entire history has been sent the writer sends a heartbeat to the reader so that it can request whatever it still misses. The resulting rate should not exceed what the reader can process, as lost data is recovered by the normal, much slower, mechanism. The default of 0 disables streaming.</p>") },
   { LEAF_W_ATTRS("HeartbeatInterval", heartbeat_interval_attrs), 1, "100 ms", ABSOFF(const_hb_intv_sched), 0, uf_duration_inf, 0, pf_duration,
     BLURB("<p>This element allows configuring the base interval for sending writer heartbeats and the bounds within which it can vary.</p>") },
   { LEAF("MaxQueuedRexmitBytes"), 1, "50 kB", ABSOFF(max_queued_rexmit_bytes), 0, uf_memsize, 0, pf_memsize,
@@ -547,6 +565,10 @@ static const struct cfgelem internal_cfgelems[] = {
     BLURB("<p>This setting controls the delay between the discovering a remote writer and sending a pre-emptive AckNack to discover the range of data available.</p>") },
   { LEAF("ScheduleTimeRounding"), 1, "0 ms", ABSOFF(schedule_time_rounding), 0, uf_duration_ms_1hr, 0, pf_duration,
     BLURB("<p>This setting allows the timing of scheduled events to be rounded up so that more events can be handled in a single cycle of the event queue. The default is 0 and causes no rounding at all, i.e. are scheduled exactly, whereas a value of 10ms would mean that events are rounded up to the nearest 10 milliseconds.</p>") },
+  { LEAF("ControlAggregationWindow"), 1, "0 ms", ABSOFF(control_aggregation_window), 0, uf_duration_ms_1hr, 0, pf_duration,
+    BLURB("<p>This setting allows HEARTBEAT and ACKNACK messages that are due within the same window to be combined into as few RTPS messages as possible, by rounding up their scheduled times to a multiple of the window and packing the resulting messages per destination. This substantially reduces the number of packets when many writers and readers communicate with the same remote participants, at the cost of delaying these messages by at most the window. The default is 0, which disables the aggregation.</p>") },
+  { LEAF("ExpiryGranularity"), 1, "1 ms", ABSOFF(expiry_granularity), 0, uf_duration_us_1s, 0, pf_duration,
+    BLURB("<p>This setting controls the granularity of the administration of sample expiry (lifespan QoS) and instance deadlines (deadline QoS) in readers and writers. Expiry times are grouped in intervals of this length and all samples and instances in an interval are processed together, which makes renewing a deadline or registering a sample cheap even with many instances, at the cost of signalling an expired lifespan or a missed deadline up to this much later. A value of 0 processes every expiry time individually.</p>") },
 #ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
   { LEAF("AuxiliaryBandwidthLimit"), 1, "inf", ABSOFF(auxiliary_bandwidth_limit), 0, uf_bandwidth, 0, pf_bandwidth,
     BLURB("<p>This element specifies the maximum transmit rate of auxiliary traffic not bound to a specific channel, such as discovery traffic, as well as auxiliary traffic related to a certain channel if that channel has elected to share this global AuxiliaryBandwidthLimit. Bandwidth limiting uses a leaky bucket scheme. The default value \"inf\" means DDSI2E imposes no limitation, the underlying operating system and hardware will likely limit the maimum transmit rate.</p>") },
@@ -565,12 +587,28 @@ static const struct cfgelem internal_cfgelems[] = {
     BLURB("<p>When true, include keyhashes in outgoing data for topics with keys.</p>") },
   { LEAF("MaxSampleSize"), 1, "2147483647 B", ABSOFF(max_sample_size), 0, uf_memsize, 0, pf_memsize,
     BLURB("<p>This setting controls the maximum (CDR) serialised size of samples that DDSI2E will forward in either direction. Samples larger than this are discarded with a warning.</p>") },
+  { LEAF("PinnedReferenceThreshold"), 1, "4 kB", ABSOFF(pinned_reference_threshold), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This setting controls the minimum size of the contents of a sequence of a primitive type in a sample written using dds_write_pinned for it to be transmitted directly from the application's memory, rather than first being copied into the serialised representation of the sample.</p>") },
+  { LEAF("CoalesceFragments"), 1, "false", ABSOFF(coalesce_fragments), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element controls whether the fragments of a large sample are combined into DataFrag submessages of as many fragments as fit in General/MaxMessageSize when the sample is first transmitted, rather than sending each fragment in a submessage of its own. Retransmits are done per fragment, unless Internal/RetransmitCoalescingWindow is set. This significantly reduces the cost of transmitting large samples, but the writer may then easily overrun the receivers, and so Internal/LargeSampleRate then limits the rate to 1 GB/s by default.</p>") },
+  { LEAF("CongestionControl"), 1, "false", ABSOFF(congestion_control), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element enables a congestion controller for reliable application writers, which adapts the rate at which a writer sends new data to the feedback from its readers. The rate is enforced by blocking the writing thread, for at most the max_blocking_time of the reliability QoS, after which the write fails with a timeout. It starts at Internal/CongestionControlMaxRate, is halved (at most once per round-trip time) whenever a reader requests a retransmit, and is increased by 1/8th per round-trip time as long as the writer is limited by it and the readers acknowledge new data. Retransmits count towards the rate as well. The round-trip time is that of the reader giving the feedback, estimated from the time between sending a sample and receiving its acknowledgement. The current rate and the round-trip times to the readers are shown in the debug monitor output.</p>") },
+  { LEAF("CongestionControlMinRate"), 1, "1 MB/s", ABSOFF(congestion_control_min_rate), 0, uf_bandwidth, 0, pf_bandwidth,
+    BLURB("<p>This element specifies the lowest transmit rate of a writer when Internal/CongestionControl is enabled.</p>") },
+  { LEAF("CongestionControlMaxRate"), 1, "inf", ABSOFF(congestion_control_max_rate), 0, uf_bandwidth, 0, pf_bandwidth,
+    BLURB("<p>This element specifies the initial and highest transmit rate of a writer when Internal/CongestionControl is enabled. The default value \"inf\" means the rate is bounded only by the implementation limit of 2GB/s.</p>") },
+  { LEAF("LargeSampleRate"), 1, "default", ABSOFF(large_sample_rate), 0, uf_maybe_bandwidth, 0, pf_maybe_bandwidth,
+    BLURB("<p>This element specifies the rate at which the fragments of a single large sample are transmitted by the writing thread. When the fragments that have been packed into messages are ahead of this rate by more than a millisecond, the packed messages are sent and the writing thread sleeps until it is back on schedule. If Internal/CongestionControl is enabled, the lower of this rate and the rate of the congestion controller is used. The value \"inf\" means the fragments are sent as fast as possible. The default value \"default\" means 1 GB/s if Internal/CoalesceFragments is enabled, because otherwise the writer easily overruns the receivers, and \"inf\" if it is not.</p>") },
   { LEAF("WriteBatch"), 1, "false", ABSOFF(whc_batch), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This element enables the batching of write operations. By default each write operation writes through the write cache and out onto the transport. Enabling write batching causes multiple small write operations to be aggregated within the write cache into a single larger write. This gives greater throughput at the expense of latency. Currently there is no mechanism for the write cache to automatically flush itself, so that if write batching is enabled, the application may have to use the dds_write_flush function to ensure that all samples are written.</p>") },
   { LEAF_W_ATTRS("LivelinessMonitoring", liveliness_monitoring_attrs), 1, "false", ABSOFF(liveliness_monitoring), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>This element controls whether or not implementation should internally monitor its own liveliness. If liveliness monitoring is enabled, stack traces can be dumped automatically when some thread appears to have stopped making progress.</p>") },
   { LEAF("MonitorPort"), 1, "-1", ABSOFF(monitor_port), 0, uf_int, 0, pf_int,
     BLURB("<p>This element allows configuring a service that dumps a text description of part the internal state to TCP clients. By default (-1), this is disabled; specifying 0 means a kernel-allocated port is used; a positive number is used as the TCP port number.</p>") },
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  { LEAF("LatencyStatistics"), 1, "false", ABSOFF(latency_stats), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element enables the collection of statistics on the time spent in each of the stages of the data path (serialization, writer history cache insertion, packing into messages, sending, receiving, defragmentation, waiting in the delivery queue and insertion into the reader history cache) for writers and readers of application data. The statistics are kept as histograms per thread and can be retrieved using dds_get_latency_stats or from the debug monitor (see Internal/MonitorPort). Only available if support for it was included at build time.</p>") },
+#endif
   { LEAF("AssumeMulticastCapable"), 1, "", ABSOFF(assumeMulticastCapable), 0, uf_string, ff_free, pf_string,
     BLURB("<p>This element controls which network interfaces are assumed to be capable of multicasting even when the interface flags returned by the operating system state it is not (this provides a workaround for some platforms). It is a comma-separated lists of patterns (with ? and * wildcards) against which the interface names are matched.</p>") },
   { LEAF("PrioritizeRetransmit"), 1, "true", ABSOFF(prioritize_retransmit), 0, uf_boolean, 0, pf_boolean,
@@ -583,6 +621,8 @@ static const struct cfgelem internal_cfgelems[] = {
     BLURB("<p>This element controls for how long a remote participant that was previously deleted will remain on a blacklist to prevent rediscovery, giving the software on a node time to perform any cleanup actions it needs to do. To some extent this delay is required internally by DDSI2E, but in the default configuration with the 'enforce' attribute set to false, DDSI2E will reallow rediscovery as soon as it has cleared its internal administration. Setting it to too small a value may result in the entry being pruned from the blacklist before DDSI2E is ready, it is therefore recommended to set it to at least several seconds.</p>") },
   { LEAF_W_ATTRS("MultipleReceiveThreads", multiple_recv_threads_attrs), 1, "default", ABSOFF(multiple_recv_threads), 0, uf_boolean_default, 0, pf_boolean_default,
     BLURB("<p>This element controls whether all traffic is handled by a single receive thread (false) or whether multiple receive threads may be used to improve latency (true). By default it is disabled on Windows because it appears that one cannot count on being able to send packets to oneself, which is necessary to stop the thread during shutdown. Currently multiple receive threads are only used for connectionless transport (e.g., UDP) and ManySocketsMode not set to single (the default).</p>") },
+  { LEAF_W_ATTRS("ReceiveBusyPoll", recv_busy_poll_attrs), 1, "0 s", ABSOFF(recv_busy_poll), 0, uf_duration_us_1s, 0, pf_duration,
+    BLURB("<p>This element sets the maximum time a receive thread dedicated to a single socket (see MultipleReceiveThreads) spins checking for incoming data before it blocks in the kernel waiting for it. It has no effect if there are no such threads, in which case a warning is given at startup. Spinning avoids the wake-up latency of a blocked thread at the cost of a CPU that is kept busy, and therefore it is usually combined with real-time scheduling of the <i>recvUC</i> and <i>recvMC</i> threads. At shutdown, the number of packets received while spinning and after blocking is logged in the \"config\" category. The default of 0 disables busy-polling.</p>") },
   { MGROUP("ControlTopic", control_topic_cfgelems, control_topic_cfgattrs), 1, 0, 0, 0, 0, 0, 0, 0,
     BLURB("<p>The ControlTopic element allows configured whether DDSI2E provides a special control interface via a predefined topic or not.<p>") },
   { GROUP("Test", internal_test_cfgelems),
@@ -600,8 +640,12 @@ static const struct cfgelem internal_cfgelems[] = {
 static const struct cfgelem sizing_cfgelems[] = {
   { LEAF("ReceiveBufferSize"), 1, "1 MiB", ABSOFF(rbuf_size), 0, uf_memsize, 0, pf_memsize,
     BLURB("<p>This element sets the size of a single receive buffer. Many receive buffers may be needed. The minimum workable size a little bit larger than Sizing/ReceiveBufferChunkSize, and the value used is taken as the configured value and the actual minimum workable size.</p>") },
+  { LEAF("ReceiveBufferArenaSize"), 1, "0 B", ABSOFF(rbuf_arena_size), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This element sets the size of the arena from which each receive thread takes its receive buffers, allocated and touched once at start-up instead of allocating and freeing individual receive buffers while running. On Linux, the arena uses huge pages when available, or else requests transparent huge pages, to reduce TLB misses at high packet rates. When the arena is exhausted, additional receive buffers are allocated from the heap. The default of 0 disables the arena.</p>") },
   { LEAF("ReceiveBufferChunkSize"), 1, "128 KiB", ABSOFF(rmsg_chunk_size), 0, uf_memsize, 0, pf_memsize,
     BLURB("<p>This element specifies the size of one allocation unit in the receive buffer. Must be greater than the maximum packet size by a modest amount (too large packets are dropped). Each allocation is shrunk immediately after processing a message, or freed straightaway.</p>") },
+  { LEAF("SharedMemoryRingSize"), 1, "1 MiB", ABSOFF(shm_ring_size), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This element specifies the size of the shared-memory ring created for each unicast receive socket when General/EnableSharedMemory is set. Each slot in the ring can hold a message of General/MaxMessageSize plus General/FragmentSize bytes, and the number of slots is rounded down to a power of two, with a minimum of 4. Messages for which there is no space in the ring are sent via the network instead.</p>") },
   END_MARKER
 };
 
@@ -623,6 +667,18 @@ static const struct cfgelem discovery_ports_cfgelems[] = {
   END_MARKER
 };
 
+static const struct cfgelem raweth_cfgelems[] = {
+  { LEAF("PacketRings"), 1, "false", ABSOFF(raweth_rings), 0, uf_boolean, 0, pf_boolean,
+    BLURB("<p>This element enables the use of memory-mapped packet rings (TPACKET_V3) shared with the kernel for receiving raw ethernet frames, avoiding a system call per frame received. This improves throughput, but the kernel only hands over a block of the receive ring once it is full or RxBlockTimeout has expired, which adds latency when the rate is low. Frames are always transmitted using regular socket operations. If the rings can't be set up, the transport falls back to regular socket operations.</p>") },
+  { LEAF("RxBlockSize"), 1, "64 KiB", ABSOFF(raweth_rx_block_size), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This element specifies the size of a block in the receive ring. The kernel hands over received frames a block at a time. It is rounded up to a power of two and to a multiple of the page size, and must be able to hold a frame of General/MaxMessageSize bytes.</p>") },
+  { LEAF("RxBlocks"), 1, "64", ABSOFF(raweth_rx_blocks), 0, uf_uint, 0, pf_uint,
+    BLURB("<p>This element specifies the number of blocks in the receive ring.</p>") },
+  { LEAF("RxBlockTimeout"), 1, "1 ms", ABSOFF(raweth_rx_block_timeout), 0, uf_duration_ms_1hr, 0, pf_duration,
+    BLURB("<p>This element specifies the time after which the kernel hands over a partially filled block of the receive ring, and therefore bounds the additional latency introduced by the ring. It is rounded to milliseconds, with a minimum of 1ms.</p>") },
+  END_MARKER
+};
+
 static const struct cfgelem tcp_cfgelems[] = {
   { LEAF ("Enable"), 1, "default", ABSOFF (compat_tcp_enable), 0, uf_boolean_default, 0, pf_nop,
     BLURB("<p>This element enables the optional TCP transport - deprecated, use General/Transport instead.</p>") },
@@ -633,7 +689,11 @@ static const struct cfgelem tcp_cfgelems[] = {
   { LEAF("ReadTimeout"), 1, "2 s", ABSOFF(tcp_read_timeout), 0, uf_duration_ms_1hr, 0, pf_duration,
     BLURB("<p>This element specifies the timeout for blocking TCP read operations. If this timeout expires then the connection is closed.</p>") },
   { LEAF("WriteTimeout"), 1, "2 s", ABSOFF(tcp_write_timeout), 0, uf_duration_ms_1hr, 0, pf_duration,
-    BLURB("<p>This element specifies the timeout for blocking TCP write operations. If this timeout expires then the connection is closed.</p>") },
+    BLURB("<p>This element specifies the timeout for blocking TCP write operations. If this timeout expires then the connection is closed. With a send queue, it is the maximum time the queue of a connection may remain non-empty without any of it being written before the connection is considered failed.</p>") },
+  { LEAF("ReadBufferSize"), 1, "64 KiB", ABSOFF(tcp_rbuf_size), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This element specifies the size of the per-connection receive buffer. Data is read from the socket into this buffer in as large chunks as are available, so that multiple DDSI messages can be obtained with a single system call. Setting it to 0 reads every message header and body directly from the socket.</p>") },
+  { LEAF("SendQueueSize"), 1, "1 MiB", ABSOFF(tcp_sendq_size), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This element specifies the maximum number of bytes that may be queued for transmission on a single connection when the socket's send buffer is full. Queued data is written by the receive thread once the socket becomes writable, so that a slow peer does not block the writing thread. Messages that do not fit in the queue are dropped and left to the reliability protocol to recover. Setting it to 0 restores blocking writes.</p>") },
   { LEAF ("AlwaysUsePeeraddrForUnicast"), 1, "false", ABSOFF (tcp_use_peeraddr_for_unicast), 0, uf_boolean, 0, pf_boolean,
     BLURB("<p>Setting this to true means the unicast addresses in SPDP packets will be ignored and the peer address from the TCP connection will be used instead. This may help work around incorrectly advertised addresses when using TCP.</p>") },
   END_MARKER
@@ -693,6 +753,16 @@ static const struct cfgelem discovery_peers_cfgelems[] = {
   END_MARKER
 };
 
+static const struct cfgelem discovery_cache_cfgelems[] = {
+  { LEAF("File"), 1, "", ABSOFF(discovery_cache_file), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This element specifies the file in which the discovered remote participants, readers and writers are stored, so that they can be restored immediately when the process restarts instead of having to wait for discovery to complete. The cache is disabled if the file name is empty. Each domain must use its own file.</p>") },
+  { LEAF("WriteInterval"), 1, "10 s", ABSOFF(discovery_cache_write_interval), 0, uf_duration_ms_1hr, 0, pf_duration,
+    BLURB("<p>This element specifies the interval at which the discovery cache is written to the file if it has changed. The cache is also written when the domain is deleted.</p>") },
+  { LEAF("ConfirmTimeout"), 1, "10 s", ABSOFF(discovery_cache_confirm_timeout), 0, uf_duration_ms_1hr, 0, pf_duration,
+    BLURB("<p>This element specifies how long remote entities restored from the discovery cache are retained without being confirmed by discovery messages from the remote side. Unconfirmed entities are deleted at the end of this period as if their lease expired.</p>") },
+  END_MARKER
+};
+
 static const struct cfgelem discovery_cfgelems[] = {
   { LEAF("Tag"), 0, "", ABSOFF(domainTag), 0, uf_string, ff_free, pf_string,
     BLURB("<p>String extension for domain id that remote participants must match to be discovered.</p>") },
@@ -720,6 +790,8 @@ static const struct cfgelem discovery_cfgelems[] = {
     BLURB("<p>Do not use.</p>") },
   { GROUP("Ports", discovery_ports_cfgelems),
     BLURB("<p>The Ports element allows specifying various parameters related to the port numbers used for discovery. These all have default values specified by the DDSI 2.1 specification and rarely need to be changed.</p>") },
+  { GROUP("Cache", discovery_cache_cfgelems),
+    BLURB("<p>The Cache element allows configuring a persistent cache of discovered remote entities that speeds up the restoration of communication after a restart of the process.</p>") },
   END_MARKER
 };
 
@@ -760,6 +832,14 @@ static const struct cfgelem tracing_cfgelems[] = {
     BLURB("<p>This option specifies whether the output is to be appended to an existing log file. The default is to create a new log file each time, which is generally the best option if a detailed log is generated.</p>") },
   { LEAF("PacketCaptureFile"), 1, "", ABSOFF(pcap_file), 0, uf_string, ff_free, pf_string,
     BLURB("<p>This option specifies the file to which received and sent packets will be logged in the \"pcap\" format suitable for analysis using common networking tools, such as WireShark. IP and UDP headers are fictitious, in particular the destination address of received packets. The TTL may be used to distinguish between sent and received packets: it is 255 for sent packets and 128 for received ones. Currently IPv4 only.</p>") },
+  { LEAF("PacketCaptureBufferSize"), 1, "0 B", ABSOFF(pcap_buffer_size), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This option specifies the size of the buffer in which captured packets are queued for writing to the Tracing/PacketCaptureFile by a separate thread. Packets that arrive while the buffer is full are dropped from the capture, but not from the communication. The size is rounded down to a power of two, with a minimum of 128kB. If 0, packets are written synchronously by the thread sending or receiving them.</p>") },
+  { LEAF("PacketCaptureSnapLength"), 1, "0 B", ABSOFF(pcap_snaplen), 0, uf_memsize, 0, pf_memsize,
+    BLURB("<p>This option specifies the maximum number of bytes of each DDSI message to capture, 0 meaning there is no limit.</p>") },
+  { LEAF("PacketCaptureGuidPrefixes"), 1, "", ABSOFF(pcap_guid_prefixes), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This option restricts the packet capture to messages from or to the participants with the listed GUID prefixes, written as a comma-separated list of the form <i>x:y:z</i> in hexadecimal. A message matches if the GUID prefix in the RTPS header or in an INFO_DST submessage is listed. If empty, there is no restriction.</p>") },
+  { LEAF("PacketCaptureTopics"), 1, "", ABSOFF(pcap_topics), 0, uf_string, ff_free, pf_string,
+    BLURB("<p>This option restricts the packet capture to messages containing data, heartbeats, gaps or acknowledgements of writers of the topics matching one of the comma-separated topic names, which may contain the usual wildcards '*' and '?'. Only writers that are known locally at the time a message is sent or received can be matched and messages of the built-in discovery writers never match. If empty, there is no restriction.</p>") },
   END_MARKER
 };
 
@@ -795,6 +875,8 @@ static const struct cfgelem domain_cfgelems[] = {
     BLURB("<p>The Internal elements deal with a variety of settings that evolving and that are not necessarily fully supported. For the vast majority of the Internal settings, the functionality per-se is supported, but the right to change the way the options control the functionality is reserved. This includes renaming or moving options.</p>") },
   { GROUP("TCP", tcp_cfgelems),
     BLURB("<p>The TCP element allows specifying various parameters related to running DDSI over TCP.</p>") },
+  { GROUP("RawEthernet", raweth_cfgelems),
+    BLURB("<p>The RawEthernet element allows specifying various parameters related to running DDSI directly over ethernet (General/Transport raweth).</p>") },
   { GROUP("ThreadPool", tp_cfgelems),
     BLURB("<p>The ThreadPool element allows specifying various parameters related to using a thread pool to send DDSI messages to multiple unicast addresses (TCP or UDP).</p>") },
 #ifdef DDSI_INCLUDE_SSL
@@ -881,7 +963,6 @@ static const struct unit unittab_memsize[] = {
   { NULL, 0 }
 };
 
-#ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
 static const struct unit unittab_bandwidth_bps[] = {
   { "b/s", 1 },{ "bps", 1 },
   { "Kib/s", 1024 },{ "Kibps", 1024 },
@@ -910,7 +991,6 @@ static const struct unit unittab_bandwidth_Bps[] = {
   { "GB/s", 1000000000 },{ "GBps", 1000000000 },
   { NULL, 0 }
 };
-#endif
 
 static void free_configured_elements (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem);
 static void free_configured_element (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem);
@@ -1588,38 +1668,67 @@ static void pf_string (struct cfgst *cfgst, void *parent, struct cfgelem const *
   cfg_logelem (cfgst, sources, "%s", *p ? *p : "(null)");
 }
 
-#ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
-static enum update_result uf_bandwidth (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
+static enum update_result uf_bandwidth1 (struct cfgst *cfgst, uint32_t *elem, const char *value)
 {
   int64_t bandwidth_bps = 0;
   if (strncmp (value, "inf", 3) == 0) {
     /* special case: inf needs no unit */
-    uint32_t * const elem = cfg_address (cfgst, parent, cfgelem);
     if (strspn (value + 3, " ") != strlen (value + 3) &&
-        lo.up_multiplier (cfgst, unittab_bandwidth_bps, value, 3, 1, 8, 1) == 0)
+        lookup_multiplier (cfgst, unittab_bandwidth_bps, value, 3, 1, 8, 1) == 0)
       return URES_ERROR;
     *elem = 0;
     return URES_SUCCESS;
-  } else if (uf_natint64_unit (cfgst, &bandwidth_bps, value, unittab_bandwidth_bps, 8, INT64_MAX) != URES_SUCCESS) {
+  } else if (uf_natint64_unit (cfgst, &bandwidth_bps, value, unittab_bandwidth_bps, 8, 0, INT64_MAX) != URES_SUCCESS) {
     return URES_ERROR;
   } else if (bandwidth_bps / 8 > INT_MAX) {
     return cfg_error (cfgst, "%s: value out of range", value);
   } else {
-    uint32_t * const elem = cfg_address (cfgst, parent, cfgelem);
     *elem = (uint32_t) (bandwidth_bps / 8);
     return URES_SUCCESS;
   }
 }
 
+static void pf_bandwidth1 (struct cfgst *cfgst, uint32_t value, uint32_t sources)
+{
+  if (value == 0)
+    cfg_logelem (cfgst, sources, "inf");
+  else
+    pf_int64_unit (cfgst, value, sources, unittab_bandwidth_Bps, "B/s");
+}
+
+static enum update_result uf_bandwidth (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
+{
+  uint32_t * const elem = cfg_address (cfgst, parent, cfgelem);
+  return uf_bandwidth1 (cfgst, elem, value);
+}
+
 static void pf_bandwidth(struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, uint32_t sources)
 {
   uint32_t const * const elem = cfg_address (cfgst, parent, cfgelem);
-  if (*elem == 0)
-    cfg_logelem (cfgst, sources, "inf");
+  pf_bandwidth1 (cfgst, *elem, sources);
+}
+
+static enum update_result uf_maybe_bandwidth (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
+{
+  struct config_maybe_uint32 * const elem = cfg_address (cfgst, parent, cfgelem);
+  if (ddsrt_strcasecmp (value, "default") == 0) {
+    elem->isdefault = 1;
+    elem->value = 0;
+    return URES_SUCCESS;
+  } else {
+    elem->isdefault = 0;
+    return uf_bandwidth1 (cfgst, &elem->value, value);
+  }
+}
+
+static void pf_maybe_bandwidth (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, uint32_t sources)
+{
+  struct config_maybe_uint32 const * const p = cfg_address (cfgst, parent, cfgelem);
+  if (p->isdefault)
+    cfg_logelem (cfgst, sources, "default");
   else
-    pf_int64_unit (cfgst, *elem, sources, unittab_bandwidth_Bps, "B/s");
+    pf_bandwidth1 (cfgst, p->value, sources);
 }
-#endif
 
 static enum update_result uf_memsize (struct cfgst *cfgst, void *parent, struct cfgelem const * const cfgelem, UNUSED_ARG (int first), const char *value)
 {
@@ -19,6 +19,7 @@
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/log.h"
 #include "dds/ddsrt/md5.h"
+#include "dds/ddsrt/mh3.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/avl.h"
 #include "dds/ddsrt/string.h"
@@ -37,6 +38,8 @@
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
+#include "dds/ddsi/ddsi_shm.h"
 #include "dds/ddsi/q_xmsg.h"
 #include "dds/ddsi/q_bswap.h"
 #include "dds/ddsi/q_transmit.h"
@@ -159,6 +162,29 @@ static int get_locator (const struct ddsi_domaingv *gv, nn_locator_t *loc, const
  ***
  *****************************************************************************/
 
+struct shm_locs_arg {
+  const struct ddsi_domaingv *gv;
+  uint32_t n;
+  nn_locator_t locs[4];
+};
+
+static void shm_locs_helper (const nn_locator_t *loc, void *varg)
+{
+  struct shm_locs_arg *arg = varg;
+  if (!ddsi_is_mcaddr (arg->gv, loc) && arg->n < sizeof (arg->locs) / sizeof (arg->locs[0]))
+    arg->locs[arg->n++] = *loc;
+}
+
+static void shm_add_proxy_participant (struct ddsi_domaingv *gv, const ddsi_plist_t *datap, struct addrset *as_default, struct addrset *as_meta)
+{
+  /* the unicast addresses are the ones for which shared memory can be used
+     instead, if the participant is in the same network namespace */
+  struct shm_locs_arg arg = { .gv = gv, .n = 0 };
+  addrset_forall (as_meta, shm_locs_helper, &arg);
+  addrset_forall (as_default, shm_locs_helper, &arg);
+  ddsi_shm_add_peer (gv, &datap->participant_guid.prefix, &datap->adlink_participant_version_info, arg.n, arg.locs);
+}
+
 static void maybe_add_pp_as_meta_to_as_disc (struct ddsi_domaingv *gv, const struct addrset *as_meta)
 {
   if (addrset_empty_mc (as_meta) || !(gv->config.allowMulticast & AMC_SPDP))
@@ -311,6 +337,7 @@ int spdp_write (struct participant *pp)
     if (pp->is_ddsi2_pp)
       ps.adlink_participant_version_info.flags |= NN_ADLINK_FL_PARTICIPANT_IS_DDSI2;
     ddsrt_mutex_unlock (&pp->e.gv->privileged_pp_lock);
+    ddsi_shm_set_participant_version_info (pp->e.gv, &ps.adlink_participant_version_info);
 
     if (ddsrt_gethostname(node, sizeof(node)-1) < 0)
       (void) ddsrt_strlcpy (node, "unknown", sizeof (node));
@@ -742,6 +769,8 @@ static int handle_SPDP_alive (const struct receiver_state *rst, seqno_t seq, dds
   GVLOGDISC ("}\n");
 
   maybe_add_pp_as_meta_to_as_disc (gv, as_meta);
+  if (gv->shm_xmit_conn && (datap->present & PP_ADLINK_PARTICIPANT_VERSION_INFO))
+    shm_add_proxy_participant (gv, datap, as_default, as_meta);
 
   new_proxy_participant
   (
@@ -797,6 +826,58 @@ static int handle_SPDP_alive (const struct receiver_state *rst, seqno_t seq, dds
   return 1;
 }
 
+/* Nearly all SPDP and SEDP messages in a system in steady state are periodic repeats of
+   earlier ones.  The proxy entities remember a hash of the payload of the message that
+   set their current state (the one with sequence number "seq"), so that a repeat can be
+   detected from the raw payload and the GUID extracted from it, without decoding the
+   parameter list. */
+static uint64_t discovery_payload_hash (const void *vdata, uint32_t len)
+{
+  const uint32_t h0 = ddsrt_mh3 (vdata, len, 0);
+  const uint32_t h1 = ddsrt_mh3 (vdata, len, h0 ^ 0x9e3779b9u);
+  const uint64_t h = ((uint64_t) h1 << 32) | h0;
+  return h ? h : 1; /* 0 is reserved for "unknown" */
+}
+
+static bool discovery_payload_guid (const void *vdata, uint32_t len, nn_parameterid_t pid, ddsi_guid_t *guid)
+{
+  const struct CDRHeader *data = vdata;
+  void *needle;
+  size_t needlesz;
+  if (len < 4 || ddsi_plist_findparam_checking ((const unsigned char *) vdata + 4, len - 4, data->identifier, pid, &needle, &needlesz) < 0)
+    return false;
+  if (needle == NULL || needlesz < sizeof (*guid))
+    return false;
+  memcpy (guid, needle, sizeof (*guid));
+  *guid = nn_ntoh_guid (*guid);
+  return true;
+}
+
+static bool handle_SPDP_repeat (const struct receiver_state *rst, seqno_t seq, const void *vdata, uint32_t len, uint64_t hash)
+{
+  struct ddsi_domaingv * const gv = rst->gv;
+  struct proxy_participant *proxypp;
+  struct lease *lease;
+  ddsi_guid_t guid;
+  bool repeat;
+  if (!discovery_payload_guid (vdata, len, PID_PARTICIPANT_GUID, &guid))
+    return false;
+  if ((proxypp = entidx_lookup_proxy_participant_guid (gv->entity_index, &guid)) == NULL)
+    return false;
+  ddsrt_mutex_lock (&proxypp->e.lock);
+  if ((repeat = (proxypp->spdp_hash == hash && !proxypp->implicitly_created)) && seq > proxypp->seq)
+    proxypp->seq = seq;
+  ddsrt_mutex_unlock (&proxypp->e.lock);
+  if (!repeat)
+    return false;
+  RSTTRACE ("SPDP ST0 "PGUIDFMT" (known, unchanged)\n", PGUID (guid));
+  if ((lease = ddsrt_atomic_ldvoidp (&proxypp->minl_auto)) != NULL)
+    lease_renew (lease, ddsrt_time_elapsed ());
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_update (gv->discovery_cache, &guid, rst, seq, vdata, len);
+  return true;
+}
+
 static void handle_SPDP (const struct receiver_state *rst, seqno_t seq, ddsrt_wctime_t timestamp, unsigned statusinfo, const void *vdata, uint32_t len)
 {
   struct ddsi_domaingv * const gv = rst->gv;
@@ -812,6 +893,13 @@ static void handle_SPDP (const struct receiver_state *rst, seqno_t seq, ddsrt_wc
     ddsi_plist_src_t src;
     int interesting = 0;
     dds_return_t plist_ret;
+    uint64_t hash = 0;
+    if (statusinfo == 0)
+    {
+      hash = discovery_payload_hash (vdata, len);
+      if (handle_SPDP_repeat (rst, seq, vdata, len, hash))
+        return;
+    }
     src.protocol_version = rst->protocol_version;
     src.vendorid = rst->vendor;
     src.encoding = data->identifier;
@@ -831,6 +919,19 @@ static void handle_SPDP (const struct receiver_state *rst, seqno_t seq, ddsrt_wc
     {
       case 0:
         interesting = handle_SPDP_alive (rst, seq, timestamp, &decoded_data);
+        if (decoded_data.present & PP_PARTICIPANT_GUID)
+        {
+          struct proxy_participant *proxypp;
+          if ((proxypp = entidx_lookup_proxy_participant_guid (gv->entity_index, &decoded_data.participant_guid)) != NULL)
+          {
+            ddsrt_mutex_lock (&proxypp->e.lock);
+            if (proxypp->seq == seq)
+              proxypp->spdp_hash = hash;
+            ddsrt_mutex_unlock (&proxypp->e.lock);
+            if (gv->discovery_cache)
+              ddsi_discovery_cache_update (gv->discovery_cache, &decoded_data.participant_guid, rst, seq, vdata, len);
+          }
+        }
         break;
 
       case NN_STATUSINFO_DISPOSE:
@@ -1341,6 +1442,42 @@ static void handle_SEDP_dead (const struct receiver_state *rst, ddsi_plist_t *da
   GVLOGDISC (" %s\n", (res < 0) ? " unknown" : " delete");
 }
 
+static struct generic_proxy_endpoint *lookup_proxy_endpoint (struct ddsi_domaingv *gv, const ddsi_guid_t *guid)
+{
+  struct entity_common *e;
+  if ((e = entidx_lookup_guid_untyped (gv->entity_index, guid)) == NULL)
+    return NULL;
+  if (e->kind != EK_PROXY_WRITER && e->kind != EK_PROXY_READER)
+    return NULL;
+  return (struct generic_proxy_endpoint *) e;
+}
+
+static bool handle_SEDP_repeat (const struct receiver_state *rst, seqno_t seq, const void *vdata, uint32_t len, uint64_t hash)
+{
+  struct ddsi_domaingv * const gv = rst->gv;
+  struct generic_proxy_endpoint *ep;
+  ddsi_guid_t guid;
+  bool repeat;
+  /* the address set of the proxy endpoint may depend on the source of the message, and a
+     discovery service may take over the proxy participant: in both cases repeats matter */
+  if (gv->config.tcp_use_peeraddr_for_unicast || vendor_is_cloud (rst->vendor))
+    return false;
+  if (!discovery_payload_guid (vdata, len, PID_ENDPOINT_GUID, &guid))
+    return false;
+  if ((ep = lookup_proxy_endpoint (gv, &guid)) == NULL)
+    return false;
+  ddsrt_mutex_lock (&ep->e.lock);
+  if ((repeat = (ep->c.sedp_hash == hash)) && seq > ep->c.seq)
+    ep->c.seq = seq;
+  ddsrt_mutex_unlock (&ep->e.lock);
+  if (!repeat)
+    return false;
+  GVLOGDISC (" "PGUIDFMT" (known, unchanged)\n", PGUID (guid));
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_update (gv->discovery_cache, &guid, rst, seq, vdata, len);
+  return true;
+}
+
 static void handle_SEDP (const struct receiver_state *rst, seqno_t seq, ddsrt_wctime_t timestamp, unsigned statusinfo, const void *vdata, uint32_t len)
 {
   struct ddsi_domaingv * const gv = rst->gv;
@@ -1356,6 +1493,13 @@ static void handle_SEDP (const struct receiver_state *rst, seqno_t seq, ddsrt_wc
     ddsi_plist_t decoded_data;
     ddsi_plist_src_t src;
     dds_return_t plist_ret;
+    uint64_t hash = 0;
+    if (statusinfo == 0)
+    {
+      hash = discovery_payload_hash (vdata, len);
+      if (handle_SEDP_repeat (rst, seq, vdata, len, hash))
+        return;
+    }
     src.protocol_version = rst->protocol_version;
     src.vendorid = rst->vendor;
     src.encoding = data->identifier;
@@ -1375,6 +1519,19 @@ static void handle_SEDP (const struct receiver_state *rst, seqno_t seq, ddsrt_wc
     {
       case 0:
         handle_SEDP_alive (rst, seq, &decoded_data, &rst->src_guid_prefix, rst->vendor, timestamp);
+        if (decoded_data.present & PP_ENDPOINT_GUID)
+        {
+          struct generic_proxy_endpoint *ep;
+          if ((ep = lookup_proxy_endpoint (gv, &decoded_data.endpoint_guid)) != NULL)
+          {
+            ddsrt_mutex_lock (&ep->e.lock);
+            if (ep->c.seq == seq)
+              ep->c.sedp_hash = hash;
+            ddsrt_mutex_unlock (&ep->e.lock);
+          }
+          if (gv->discovery_cache && entidx_lookup_guid_untyped (gv->entity_index, &decoded_data.endpoint_guid) != NULL)
+            ddsi_discovery_cache_update (gv->discovery_cache, &decoded_data.endpoint_guid, rst, seq, vdata, len);
+        }
         break;
 
       case NN_STATUSINFO_DISPOSE:
@@ -1388,6 +1545,15 @@ static void handle_SEDP (const struct receiver_state *rst, seqno_t seq, ddsrt_wc
   }
 }
 
+void handle_cached_discovery_data (const struct receiver_state *rst, seqno_t seq, bool participant, const void *vdata, uint32_t len)
+{
+  const ddsrt_wctime_t timestamp = ddsrt_time_wallclock ();
+  if (participant)
+    handle_SPDP (rst, seq, timestamp, 0, vdata, len);
+  else
+    handle_SEDP (rst, seq, timestamp, 0, vdata, len);
+}
+
 /******************************************************************************
  ***
  *** Topics
@@ -36,6 +36,10 @@
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_tran.h"
 #include "dds/ddsi/ddsi_tcp.h"
+#include "dds/ddsi/ddsi_rxfilter.h"
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+#include "dds/ddsi/ddsi_latency_stats.h"
+#endif
 
 #include "dds__whc.h"
 
@@ -204,6 +208,8 @@ static int print_participants (struct thread_state1 * const ts1, struct ddsi_dom
           x += cpf (conn, "    #acks %"PRIu32" #nacks %"PRIu32" #rexmit %"PRIu32" #lost %"PRIu32" #throttle %"PRIu32"\n",
                     w->num_acks_received, w->num_nacks_received, w->rexmit_count, w->rexmit_lost_count, w->throttle_count);
           x += cpf (conn, "    max-drop-seq %"PRId64"\n", writer_max_drop_seq (w));
+          if (w->rate_controlled)
+            x += cpf (conn, "    rate %.0f B/s\n", ddsi_ratecontrol_rate (&w->ratecontrol));
         }
         x += print_addrset_if_notempty (conn, "    as", w->as, "\n");
         for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &w->readers, &rdit); m; m = ddsrt_avl_iter_next (&rdit))
@@ -213,8 +219,10 @@ static int print_participants (struct thread_state1 * const ts1, struct ddsi_dom
           wr_prd_flags[1] = m->assumed_in_sync ? 's' : '.';
           wr_prd_flags[2] = m->has_replied_to_hb ? 'a' : '.'; /* a = ack seen */
           wr_prd_flags[3] = 0;
-          x += cpf (conn, "    prd "PGUIDFMT" %s @ %"PRId64" [%"PRId64",%"PRId64"] #nacks %"PRIu32"\n",
-                    PGUID (m->prd_guid), wr_prd_flags, m->seq, m->min_seq, m->max_seq, m->rexmit_requests);
+          x += cpf (conn, "    prd "PGUIDFMT" %s @ %"PRId64" [%"PRId64",%"PRId64"] #nacks %"PRIu32" #nackfrags %"PRIu32"\n",
+                    PGUID (m->prd_guid), wr_prd_flags, m->seq, m->min_seq, m->max_seq, m->rexmit_requests, m->rexmit_frag_requests);
+          x += cpf (conn, "      rtt %.0f us #rexmit %"PRIu64" nacked %"PRIu64" B throttled %"PRId64" ns\n",
+                    nn_lat_estim_current (&m->rtt), m->rexmit_count, m->nacked_bytes, m->throttled_time);
         }
         ddsrt_mutex_unlock (&w->e.lock);
       }
@@ -275,8 +283,9 @@ static int print_proxy_participants (struct thread_state1 * const ts1, struct dd
         x += cpf (conn, "    last_seq %"PRId64" last_fragnum %"PRIu32"\n", w->last_seq, w->last_fragnum);
         for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &w->readers, &rdit); m; m = ddsrt_avl_iter_next (&rdit))
         {
-          x += cpf (conn, "    rd "PGUIDFMT" (nack %"PRId64" %"PRId64")\n",
-                    PGUID (m->rd_guid), m->seq_last_nack, m->t_last_nack.v);
+          x += cpf (conn, "    rd "PGUIDFMT" (nack %"PRId64" %"PRId64") #nacks %"PRIu32" (%"PRIu64" samples) #nackfrags %"PRIu32" (%"PRIu64" frags)\n",
+                    PGUID (m->rd_guid), m->seq_last_nack, m->t_last_nack.v,
+                    m->nacks_sent, m->nacked_samples, m->nackfrags_sent, m->nacked_fragments);
           switch (m->in_sync)
           {
             case PRMSS_SYNC:
@@ -299,12 +308,75 @@ static int print_proxy_participants (struct thread_state1 * const ts1, struct dd
   return x;
 }
 
+static int print_receive_stats (struct ddsi_domaingv *gv, ddsi_tran_conn_t conn)
+{
+  struct ddsi_rxfilter_stats st;
+  int x;
+  ddsi_rxfilter_get_stats (gv->rxfilter, &st);
+  x = cpf (conn, "rxfilter accepted %"PRIu64" dropped %"PRIu64"\n", st.accepted, st.dropped);
+  if (gv->config.recv_busy_poll > 0)
+  {
+    /* only threads dedicated to a single socket busy-poll */
+    for (uint32_t i = 0; x == 0 && i < gv->n_recv_threads; i++)
+    {
+      const struct recv_thread_arg *arg = &gv->recv_threads[i].arg;
+      if (arg->mode != RTM_SINGLE)
+        continue;
+      x += cpf (conn, "%s busy-poll spin %"PRIu64" block %"PRIu64"\n", gv->recv_threads[i].name,
+                ddsrt_atomic_ld64 (&arg->u.single.npoll_spin), ddsrt_atomic_ld64 (&arg->u.single.npoll_block));
+    }
+  }
+  return x;
+}
+
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+static int print_latency_stats (struct ddsi_domaingv *gv, ddsi_tran_conn_t conn)
+{
+  /* statistics are kept per thread, for all threads in the process */
+  struct ddsi_latency_stats *st;
+  char name[24];
+  uint32_t nthreads;
+  int x = 0;
+  if (!gv->config.latency_stats)
+    return 0;
+  /* ddsi_latency_stats_get_thread checks the index again, with the lock held */
+  ddsrt_mutex_lock (&thread_states.lock);
+  nthreads = thread_states.nthreads;
+  ddsrt_mutex_unlock (&thread_states.lock);
+  st = ddsrt_malloc (sizeof (*st));
+  for (uint32_t i = 0; x == 0 && i < nthreads; i++)
+  {
+    if (!ddsi_latency_stats_get_thread (i, name, sizeof (name), st))
+      continue;
+    x += cpf (conn, "latency %s (ns)\n", name);
+    for (int k = 0; x == 0 && k < DDSI_LATENCY_NSTAGES; k++)
+    {
+      const struct ddsi_latency_hist *h = &st->stage[k];
+      if (h->count == 0)
+        continue;
+      x += cpf (conn, "  %-10s n %"PRIu64" min %"PRId64" mean %"PRId64" p50 %"PRId64" p90 %"PRId64" p99 %"PRId64" p99.9 %"PRId64" max %"PRId64"\n",
+                ddsi_latency_stage_name ((enum ddsi_latency_stage) k), h->count, h->min, h->sum / (int64_t) h->count,
+                ddsi_latency_hist_percentile (h, 0.5), ddsi_latency_hist_percentile (h, 0.9),
+                ddsi_latency_hist_percentile (h, 0.99), ddsi_latency_hist_percentile (h, 0.999), h->max);
+    }
+  }
+  ddsrt_free (st);
+  return x;
+}
+#endif
+
 static void debmon_handle_connection (struct debug_monitor *dm, ddsi_tran_conn_t conn)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
   struct plugin *p;
   int r = 0;
-  r += print_participants (ts1, dm->gv, conn);
+  r += print_receive_stats (dm->gv, conn);
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  if (r == 0)
+    r += print_latency_stats (dm->gv, conn);
+#endif
+  if (r == 0)
+    r += print_participants (ts1, dm->gv, conn);
   if (r == 0)
     r += print_proxy_participants (ts1, dm->gv, conn);
 
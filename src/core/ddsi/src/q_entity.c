@@ -48,6 +48,10 @@
 #include "dds__whc.h"
 #include "dds/ddsi/ddsi_iid.h"
 #include "dds/ddsi/ddsi_tkmap.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
+#include "dds/ddsi/ddsi_shm.h"
+#include "dds/ddsi/ddsi_partition_match.h"
+#include "dds/ddsi/ddsi_rxfilter.h"
 
 struct deleted_participant {
   ddsrt_avl_node_t avlnode;
@@ -69,12 +73,15 @@ struct alive_state {
 };
 
 static int compare_guid (const void *va, const void *vb);
+static int compare_seq (const void *va, const void *vb);
 static void augment_wr_prd_match (void *vnode, const void *vleft, const void *vright);
 
 const ddsrt_avl_treedef_t wr_readers_treedef =
   DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct wr_prd_match, avlnode), offsetof (struct wr_prd_match, prd_guid), compare_guid, augment_wr_prd_match);
 const ddsrt_avl_treedef_t wr_local_readers_treedef =
   DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct wr_rd_match, avlnode), offsetof (struct wr_rd_match, rd_guid), compare_guid, 0);
+const ddsrt_avl_treedef_t wr_rexmit_reqs_treedef =
+  DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct wr_rexmit_req, avlnode), offsetof (struct wr_rexmit_req, seq), compare_seq, 0);
 const ddsrt_avl_treedef_t rd_writers_treedef =
   DDSRT_AVL_TREEDEF_INITIALIZER (offsetof (struct rd_pwr_match, avlnode), offsetof (struct rd_pwr_match, pwr_guid), compare_guid, 0);
 const ddsrt_avl_treedef_t rd_local_writers_treedef =
@@ -119,6 +126,13 @@ static int compare_guid (const void *va, const void *vb)
   return memcmp (va, vb, sizeof (ddsi_guid_t));
 }
 
+static int compare_seq (const void *va, const void *vb)
+{
+  const seqno_t *a = va;
+  const seqno_t *b = vb;
+  return (*a == *b) ? 0 : (*a < *b) ? -1 : 1;
+}
+
 bool is_null_guid (const ddsi_guid_t *guid)
 {
   return guid->prefix.u[0] == 0 && guid->prefix.u[1] == 0 && guid->prefix.u[2] == 0 && guid->entityid.u == 0;
@@ -352,6 +366,7 @@ void ddsi_make_writer_info(struct ddsi_writer_info *wrinfo, const struct entity_
   wrinfo->ownership_strength = xqos->ownership_strength.value;
   wrinfo->auto_dispose = xqos->writer_data_lifecycle.autodispose_unregistered_instances;
   wrinfo->iid = e->iid;
+  wrinfo->coherent_set_seq = 0;
 #ifdef DDSI_INCLUDE_LIFESPAN
   if (xqos->lifespan.duration != DDS_INFINITY && (statusinfo & (NN_STATUSINFO_UNREGISTER | NN_STATUSINFO_DISPOSE)) == 0)
     wrinfo->lifespan_exp = ddsrt_mtime_add_duration(ddsrt_time_monotonic(), xqos->lifespan.duration);
@@ -1457,6 +1472,7 @@ static void free_wr_prd_match (struct wr_prd_match *m)
   if (m)
   {
     nn_lat_estim_fini (&m->hb_to_ack_latency);
+    nn_lat_estim_fini (&m->rtt);
     ddsrt_free (m);
   }
 }
@@ -1785,6 +1801,19 @@ static void update_reader_init_acknack_count (const ddsrt_log_cfg_t *logcfg, con
   }
 }
 
+static void proxy_writer_update_rxfilter_locked (struct proxy_writer *pwr)
+{
+  /* Data from a proxy writer without local readers can be dropped on receipt, except
+     when it asserts the liveliness of the writer or its participant.  Once the proxy
+     writer has been removed from the entity index, delete_proxy_writer removes it from
+     the filter, and it must not get added again. */
+  if ((!ddsrt_avl_is_empty (&pwr->readers) || pwr->c.xqos->liveliness.kind != DDS_LIVELINESS_AUTOMATIC) &&
+      entidx_lookup_proxy_writer_guid (pwr->e.gv->entity_index, &pwr->e.guid) == pwr)
+    ddsi_rxfilter_add (pwr->e.gv->rxfilter, pwr);
+  else
+    ddsi_rxfilter_remove (pwr->e.gv->rxfilter, pwr);
+}
+
 static void proxy_writer_drop_connection (const struct ddsi_guid *pwr_guid, struct reader *rd)
 {
   /* Only called by gc_delete_reader, so we actually have a reader pointer */
@@ -1810,6 +1839,7 @@ static void proxy_writer_drop_connection (const struct ddsi_guid *pwr_guid, stru
       if (pwr->n_reliable_readers == 0)
         pwr->have_seen_heartbeat = 0;
       local_reader_ary_remove (&pwr->rdary, rd);
+      proxy_writer_update_rxfilter_locked (pwr);
     }
     ddsrt_mutex_unlock (&pwr->e.lock);
     if (m != NULL)
@@ -1847,8 +1877,16 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd)
   m->assumed_in_sync = (wr->e.gv->config.retransmit_merging == REXMIT_MERGE_ALWAYS);
   m->has_replied_to_hb = !m->is_reliable;
   m->all_have_replied_to_hb = 0;
+  m->holding_up_writer = 0;
   m->non_responsive_count = 0;
   m->rexmit_requests = 0;
+  m->rexmit_frag_requests = 0;
+  m->rexmit_count = 0;
+  m->nacked_bytes = 0;
+  m->throttled_time = 0;
+  m->hist_started = 0;
+  m->hist_next_seq = 0;
+  m->hist_max_seq = 0;
   /* m->demoted: see below */
   ddsrt_mutex_lock (&prd->e.lock);
   if (prd->deleting)
@@ -1871,6 +1909,7 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd)
   m->next_acknack = DDSI_COUNT_MIN;
   m->next_nackfrag = DDSI_COUNT_MIN;
   nn_lat_estim_init (&m->hb_to_ack_latency);
+  nn_lat_estim_init (&m->rtt);
   m->hb_to_ack_latency_tlastlog = ddsrt_time_wallclock ();
   m->t_acknack_accepted.v = 0;
 
@@ -1885,17 +1924,38 @@ static void writer_add_connection (struct writer *wr, struct proxy_reader *prd)
               PGUID (wr->e.guid), PGUID (prd->e.guid));
     ddsrt_mutex_unlock (&wr->e.lock);
     nn_lat_estim_fini (&m->hb_to_ack_latency);
+    nn_lat_estim_fini (&m->rtt);
     ddsrt_free (m);
   }
   else
   {
+    bool stream_history = false;
     ELOGDISC (wr, "  writer_add_connection(wr "PGUIDFMT" prd "PGUIDFMT") - ack seq %"PRId64"\n",
               PGUID (wr->e.guid), PGUID (prd->e.guid), m->seq);
+    if (wr->history_xevent && m->is_reliable && !pretend_everything_acked && prd->c.xqos->durability.kind > DDS_DURABILITY_VOLATILE)
+    {
+      /* push the history to the new reader at a controlled rate rather than
+         having it request it sample-by-sample in response to heartbeats; only
+         a reliable reader acknowledges it and so can recover any losses */
+      struct whc_state whcst;
+      whc_get_state (wr->whc, &whcst);
+      if (!WHCST_ISEMPTY (&whcst))
+      {
+        m->hist_next_seq = whcst.min_seq;
+        m->hist_max_seq = whcst.max_seq;
+        stream_history = true;
+        ELOGDISC (wr, "  writer_add_connection(wr "PGUIDFMT" prd "PGUIDFMT") - stream history %"PRId64"..%"PRId64"\n",
+                  PGUID (wr->e.guid), PGUID (prd->e.guid), m->hist_next_seq, m->hist_max_seq);
+      }
+    }
     ddsrt_avl_insert_ipath (&wr_readers_treedef, &wr->readers, m, &path);
     rebuild_writer_addrset (wr);
     wr->num_reliable_readers += m->is_reliable;
     ddsrt_mutex_unlock (&wr->e.lock);
 
+    if (stream_history)
+      (void) resched_xevent_if_earlier (wr->history_xevent, ddsrt_time_monotonic ());
+
     if (wr->status_cb)
     {
       status_cb_data_t data;
@@ -1967,6 +2027,9 @@ static void writer_add_local_connection (struct writer *wr, struct reader *rd)
     {
       struct ddsi_writer_info wrinfo;
       struct ddsi_serdata *payload = sample.serdata;
+      /* commit messages of coherent sets carry no sample */
+      if (payload->kind == SDK_EMPTY)
+        continue;
       /* FIXME: whc has tk reference in its index nodes, which is what we really should be iterating over anyway, and so we don't really have to look them up anymore */
       struct ddsi_tkmap_instance *tk = ddsi_tkmap_lookup_instance_ref (tkmap, payload);
       ddsi_make_writer_info (&wrinfo, &wr->e, wr->xqos, sample.serdata->statusinfo);
@@ -2139,6 +2202,10 @@ static void proxy_writer_add_connection (struct proxy_writer *pwr, struct reader
   m->t_heartbeat_accepted.v = 0;
   m->t_last_nack.v = 0;
   m->seq_last_nack = 0;
+  m->nacks_sent = 0;
+  m->nackfrags_sent = 0;
+  m->nacked_samples = 0;
+  m->nacked_fragments = 0;
 
   /* These can change as a consequence of handling data and/or
      discovery activities. The safe way of dealing with them is to
@@ -2212,6 +2279,7 @@ static void proxy_writer_add_connection (struct proxy_writer *pwr, struct reader
 
   ddsrt_avl_insert_ipath (&pwr_readers_treedef, &pwr->readers, m, &path);
   local_reader_ary_insert(&pwr->rdary, rd);
+  proxy_writer_update_rxfilter_locked (pwr);
   ddsrt_mutex_unlock (&pwr->e.lock);
   qxev_pwr_entityid (pwr, &rd->e.guid.prefix);
 
@@ -2324,7 +2392,7 @@ static void reader_qos_mismatch (struct reader * rd, dds_qos_policy_id_t reason)
   }
 }
 
-static bool topickind_qos_match_p_lock (struct entity_common *rd, const dds_qos_t *rdqos, struct entity_common *wr, const dds_qos_t *wrqos, dds_qos_policy_id_t *reason)
+static bool topickind_qos_match_p_lock (struct entity_common *rd, const dds_qos_t *rdqos, const struct ddsi_partition_set *rdps, struct entity_common *wr, const dds_qos_t *wrqos, const struct ddsi_partition_set *wrps, dds_qos_policy_id_t *reason)
 {
   assert (is_reader_entityid (rd->guid.entityid));
   assert (is_writer_entityid (wr->guid.entityid));
@@ -2337,9 +2405,16 @@ static bool topickind_qos_match_p_lock (struct entity_common *rd, const dds_qos_
   const int shift = (uintptr_t) rd > (uintptr_t) wr;
   for (int i = 0; i < 2; i++)
     ddsrt_mutex_lock (locks[i + shift]);
-  bool ret = qos_match_p (rdqos, wrqos, reason);
+  /* partition is checked last, after all other QoS, so the reason is the same as
+     it would be for qos_match_p; the partition QoS of an endpoint never changes */
+  bool ret = qos_match_mask_p (rdqos, wrqos, ~(uint64_t)QP_PARTITION, reason);
   for (int i = 0; i < 2; i++)
     ddsrt_mutex_unlock (locks[i + shift]);
+  if (ret && (rdqos->present & wrqos->present & QP_PARTITION) && !ddsi_partition_sets_match (rd->gv->partition_match_cache, rdps, wrps))
+  {
+    *reason = DDS_PARTITION_QOS_POLICY_ID;
+    ret = false;
+  }
   return ret;
 }
 
@@ -2353,7 +2428,7 @@ static void connect_writer_with_proxy_reader (struct writer *wr, struct proxy_re
     return;
   if (wr->e.onlylocal)
     return;
-  if (!isb0 && !topickind_qos_match_p_lock (&prd->e, prd->c.xqos, &wr->e, wr->xqos, &reason))
+  if (!isb0 && !topickind_qos_match_p_lock (&prd->e, prd->c.xqos, prd->c.partset, &wr->e, wr->xqos, wr->partset, &reason))
   {
     writer_qos_mismatch (wr, reason);
     return;
@@ -2373,7 +2448,7 @@ static void connect_proxy_writer_with_reader (struct proxy_writer *pwr, struct r
     return;
   if (rd->e.onlylocal)
     return;
-  if (!isb0 && !topickind_qos_match_p_lock (&rd->e, rd->xqos, &pwr->e, pwr->c.xqos, &reason))
+  if (!isb0 && !topickind_qos_match_p_lock (&rd->e, rd->xqos, rd->partset, &pwr->e, pwr->c.xqos, pwr->c.partset, &reason))
   {
     reader_qos_mismatch (rd, reason);
     return;
@@ -2426,7 +2501,7 @@ static void connect_writer_with_reader (struct writer *wr, struct reader *rd, dd
     return;
   if (ignore_local_p (&wr->e.guid, &rd->e.guid, wr->xqos, rd->xqos))
     return;
-  if (!topickind_qos_match_p_lock (&rd->e, rd->xqos, &wr->e, wr->xqos, &reason))
+  if (!topickind_qos_match_p_lock (&rd->e, rd->xqos, rd->partset, &wr->e, wr->xqos, wr->partset, &reason))
   {
     writer_qos_mismatch (wr, reason);
     reader_qos_mismatch (rd, reason);
@@ -2986,6 +3061,8 @@ static void new_writer_guid_common_init (struct writer *wr, const struct ddsi_se
   wr->hbfragcount = 0;
   writer_hbcontrol_init (&wr->hbcontrol);
   wr->throttling = 0;
+  wr->rtt_probe_seq = 0;
+  wr->rtt_probe_t.v = 0;
   wr->retransmitting = 0;
   wr->t_rexmit_end.v = 0;
   wr->t_whc_high_upd.v = 0;
@@ -3009,6 +3086,7 @@ static void new_writer_guid_common_init (struct writer *wr, const struct ddsi_se
   ddsi_xqos_mergein_missing (wr->xqos, &wr->e.gv->default_xqos_wr, ~(uint64_t)0);
   assert (wr->xqos->aliased == 0);
   set_topic_type_name (wr->xqos, topic);
+  wr->partset = ddsi_partition_set_ref (wr->e.gv->partition_match_cache, wr->xqos);
 
   ELOGDISC (wr, "WRITER "PGUIDFMT" QOS={", PGUID (wr->e.guid));
   ddsi_xqos_log (DDS_LC_DISCOVERY, &wr->e.gv->logconfig, wr->xqos);
@@ -3103,6 +3181,27 @@ static void new_writer_guid_common_init (struct writer *wr, const struct ddsi_se
   else
     wr->heartbeat_xevent = NULL;
 
+  /* congestion control only for application writers: the built-in ones
+     must never block */
+  wr->rate_controlled = wr->reliable && wr->e.gv->config.congestion_control && !is_builtin_entityid (wr->e.guid.entityid, NN_VENDORID_ECLIPSE);
+  ddsi_ratecontrol_init (&wr->ratecontrol, wr->e.gv->config.congestion_control_min_rate, wr->e.gv->config.congestion_control_max_rate, ddsrt_time_monotonic ());
+
+  /* same for the event for coalesced retransmits, it only gets scheduled
+     once a retransmit request has been queued */
+  ddsrt_avl_init (&wr_rexmit_reqs_treedef, &wr->rexmit_reqs);
+  wr->rexmit_reqs_bytes = 0;
+  if (wr->reliable && wr->e.gv->config.retransmit_coalescing_window > 0)
+    wr->rexmit_xevent = qxev_rexmit (wr->evq, DDSRT_MTIME_NEVER, &wr->e.guid);
+  else
+    wr->rexmit_xevent = NULL;
+
+  /* and for streaming the history to late-joining readers, which gets
+     scheduled by writer_add_connection */
+  if (wr->reliable && wr->handle_as_transient_local && wr->e.gv->config.history_burst_bytes > 0 && !is_builtin_entityid (wr->e.guid.entityid, NN_VENDORID_ECLIPSE))
+    wr->history_xevent = qxev_history (wr->evq, DDSRT_MTIME_NEVER, &wr->e.guid);
+  else
+    wr->history_xevent = NULL;
+
   assert (wr->xqos->present & QP_LIVELINESS);
   if (wr->xqos->liveliness.lease_duration != DDS_INFINITY)
   {
@@ -3281,6 +3380,11 @@ static void gc_delete_writer (struct gcreq *gcreq)
     wr->hbcontrol.tsched = DDSRT_MTIME_NEVER;
     delete_xevent (wr->heartbeat_xevent);
   }
+  if (wr->rexmit_xevent)
+    delete_xevent (wr->rexmit_xevent);
+  if (wr->history_xevent)
+    delete_xevent (wr->history_xevent);
+  ddsrt_avl_free (&wr_rexmit_reqs_treedef, &wr->rexmit_reqs, ddsrt_free);
 
   /* Tear down connections -- no proxy reader can be adding/removing
       us now, because we can't be found via entity_index anymore.  We
@@ -3320,10 +3424,12 @@ static void gc_delete_writer (struct gcreq *gcreq)
     unref_addrset (wr->ssm_as);
 #endif
   unref_addrset (wr->as); /* must remain until readers gone (rebuilding of addrset) */
+  ddsi_partition_set_unref (wr->e.gv->partition_match_cache, wr->partset);
   ddsi_xqos_fini (wr->xqos);
   ddsrt_free (wr->xqos);
   local_reader_ary_fini (&wr->rdary);
   ddsrt_cond_destroy (&wr->throttle_cond);
+  ddsi_ratecontrol_fini (&wr->ratecontrol);
 
   ddsi_sertopic_unref ((struct ddsi_sertopic *) wr->topic);
   endpoint_common_fini (&wr->e, &wr->c);
@@ -3646,6 +3752,7 @@ static dds_return_t new_reader_guid
   ddsi_xqos_mergein_missing (rd->xqos, &pp->e.gv->default_xqos_rd, ~(uint64_t)0);
   assert (rd->xqos->aliased == 0);
   set_topic_type_name (rd->xqos, topic);
+  rd->partset = ddsi_partition_set_ref (rd->e.gv->partition_match_cache, rd->xqos);
 
   if (rd->e.gv->logconfig.c.mask & DDS_LC_DISCOVERY)
   {
@@ -3818,6 +3925,7 @@ static void gc_delete_reader (struct gcreq *gcreq)
   }
   ddsi_sertopic_unref ((struct ddsi_sertopic *) rd->topic);
 
+  ddsi_partition_set_unref (rd->e.gv->partition_match_cache, rd->partset);
   ddsi_xqos_fini (rd->xqos);
   ddsrt_free (rd->xqos);
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
@@ -3998,6 +4106,7 @@ void new_proxy_participant (struct ddsi_domaingv *gv, const struct ddsi_guid *pp
   proxypp->vendor = vendor;
   proxypp->bes = bes;
   proxypp->seq = seq;
+  proxypp->spdp_hash = 0;
   if (privileged_pp_guid) {
     proxypp->privileged_pp_guid = *privileged_pp_guid;
   } else {
@@ -4421,6 +4530,10 @@ int delete_proxy_participant_by_guid (struct ddsi_domaingv *gv, const struct dds
   remember_deleted_participant_guid (gv->deleted_participants, &ppt->e.guid);
   entidx_remove_proxy_participant_guid (gv->entity_index, ppt);
   ddsrt_mutex_unlock (&gv->lock);
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_remove (gv->discovery_cache, guid);
+  if (gv->shm_xmit_conn)
+    ddsi_shm_remove_peer (gv, &guid->prefix);
   delete_ppt (ppt, timestamp, isimplicit);
 
   return 0;
@@ -4453,9 +4566,11 @@ static int proxy_endpoint_common_init (struct entity_common *e, struct proxy_end
   name = (plist->present & PP_ENTITY_NAME) ? plist->entity_name : "";
   entity_common_init (e, proxypp->e.gv, guid, name, kind, tcreate, proxypp->vendor, false);
   c->xqos = ddsi_xqos_dup (&plist->qos);
+  c->partset = ddsi_partition_set_ref (proxypp->e.gv->partition_match_cache, c->xqos);
   c->as = ref_addrset (as);
   c->vendor = proxypp->vendor;
   c->seq = seq;
+  c->sedp_hash = 0;
 
   if (plist->present & PP_GROUP_GUID)
     c->group_guid = plist->group_guid;
@@ -4464,6 +4579,7 @@ static int proxy_endpoint_common_init (struct entity_common *e, struct proxy_end
 
   if ((ret = ref_proxy_participant (proxypp, c)) != DDS_RETCODE_OK)
   {
+    ddsi_partition_set_unref (proxypp->e.gv->partition_match_cache, c->partset);
     ddsi_xqos_fini (c->xqos);
     ddsrt_free (c->xqos);
     unref_addrset (c->as);
@@ -4477,6 +4593,7 @@ static int proxy_endpoint_common_init (struct entity_common *e, struct proxy_end
 static void proxy_endpoint_common_fini (struct entity_common *e, struct proxy_endpoint_common *c)
 {
   unref_proxy_participant (c->proxypp, c);
+  ddsi_partition_set_unref (e->gv->partition_match_cache, c->partset);
   ddsi_xqos_fini (c->xqos);
   ddsrt_free (c->xqos);
   unref_addrset (c->as);
@@ -4580,6 +4697,7 @@ int new_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *ppguid,
   /* locking the entity prevents matching while the built-in topic hasn't been published yet */
   ddsrt_mutex_lock (&pwr->e.lock);
   entidx_insert_proxy_writer_guid (gv->entity_index, pwr);
+  proxy_writer_update_rxfilter_locked (pwr);
   builtintopic_write (gv->builtin_topic_interface, &pwr->e, timestamp, true);
   ddsrt_mutex_unlock (&pwr->e.lock);
 
@@ -4734,6 +4852,11 @@ int delete_proxy_writer (struct ddsi_domaingv *gv, const struct ddsi_guid *guid,
   builtintopic_write (gv->builtin_topic_interface, &pwr->e, timestamp, false);
   entidx_remove_proxy_writer_guid (gv->entity_index, pwr);
   ddsrt_mutex_unlock (&gv->lock);
+  ddsrt_mutex_lock (&pwr->e.lock);
+  ddsi_rxfilter_remove (gv->rxfilter, pwr);
+  ddsrt_mutex_unlock (&pwr->e.lock);
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_remove (gv->discovery_cache, guid);
   if (pwr->c.xqos->liveliness.lease_duration != DDS_INFINITY &&
       pwr->c.xqos->liveliness.kind == DDS_LIVELINESS_MANUAL_BY_TOPIC)
     lease_unregister (pwr->lease);
@@ -4945,6 +5068,8 @@ int delete_proxy_reader (struct ddsi_domaingv *gv, const struct ddsi_guid *guid,
   builtintopic_write (gv->builtin_topic_interface, &prd->e, timestamp, false);
   entidx_remove_proxy_reader_guid (gv->entity_index, prd);
   ddsrt_mutex_unlock (&gv->lock);
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_remove (gv->discovery_cache, guid);
   GVLOGDISC ("- deleting\n");
 
   /* If the proxy reader is reliable, pretend it has just acked all
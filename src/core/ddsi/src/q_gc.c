@@ -26,8 +26,17 @@
 #include "dds/ddsi/ddsi_domaingv.h" /* for mattr, cattr */
 #include "dds/ddsi/q_receive.h" /* for trigger_receive_threads */
 
+/* Requests are retired in batches: all requests that are enqueued while
+   a batch is waiting for the threads to make progress are collected and
+   form the next batch, for which the thread states are gathered only
+   once.  So a request never waits for more than two batches, regardless
+   of how many requests there are.
+
+   A request that has been requeued (or that doesn't depend on the
+   threads in the first place) need not wait and is handled right
+   away. */
 struct gcreq_queue {
-  struct gcreq *first;
+  struct gcreq *first; /* incoming requests */
   struct gcreq *last;
   ddsrt_mutex_t lock;
   ddsrt_cond_t cond;
@@ -35,6 +44,13 @@ struct gcreq_queue {
   int32_t count;
   struct ddsi_domaingv *gv;
   struct thread_state1 *ts;
+
+  /* only accessed by the gc thread */
+  uint32_t epoch; /* number of batches started, for tracing */
+  struct gcreq *batch; /* requests waiting for the threads in vtimes to make progress */
+  struct gcreq *next_batch, *next_batch_last; /* requests waiting for a new batch to start */
+  uint32_t nvtimes;
+  struct idx_vtime *vtimes;
 };
 
 static void threads_vtime_gather_for_wait (const struct ddsi_domaingv *gv, unsigned *nivs, struct idx_vtime *ivs)
@@ -85,14 +101,55 @@ static int threads_vtime_check (uint32_t *nivs, struct idx_vtime *ivs)
   return *nivs == 0;
 }
 
+static void gcreq_run_list (struct thread_state1 * const ts1, struct gcreq *list)
+{
+  /* the callback is responsible for requeueing (if complex multi-phase
+     delete) or freeing the delete request, so "next" must be read first */
+  thread_state_awake_fixed_domain (ts1);
+  while (list)
+  {
+    struct gcreq *gcreq = list;
+    list = list->next;
+    gcreq->cb (gcreq);
+  }
+  thread_state_asleep (ts1);
+}
+
+static void gcreq_queue_sort_incoming (struct thread_state1 * const ts1, struct gcreq_queue *q, struct gcreq *list)
+{
+  /* handle those that needn't wait immediately, append the others to the
+     next batch, preserving order */
+  struct gcreq *ready = NULL, **ready_tail = &ready;
+  while (list)
+  {
+    struct gcreq *gcreq = list;
+    list = list->next;
+    gcreq->next = NULL;
+    if (gcreq->ready)
+    {
+      *ready_tail = gcreq;
+      ready_tail = &gcreq->next;
+    }
+    else
+    {
+      if (q->next_batch == NULL)
+        q->next_batch = gcreq;
+      else
+        q->next_batch_last->next = gcreq;
+      q->next_batch_last = gcreq;
+    }
+  }
+  if (ready)
+    gcreq_run_list (ts1, ready);
+}
+
 static uint32_t gcreq_queue_thread (struct gcreq_queue *q)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
   ddsrt_mtime_t next_thread_cputime = { 0 };
   ddsrt_mtime_t t_trigger_recv_threads = { 0 };
-  int64_t shortsleep = DDS_MSECS (1);
+  const int64_t shortsleep = DDS_MSECS (1);
   int64_t delay = DDS_MSECS (1); /* force evaluation after startup */
-  struct gcreq *gcreq = NULL;
   int trace_shortsleep = 1;
   ddsrt_mutex_lock (&q->lock);
   while (!(q->terminate && q->count == 0))
@@ -112,32 +169,22 @@ static uint32_t gcreq_queue_thread (struct gcreq_queue *q)
       }
     }
 
-    /* If we are waiting for a gcreq to become ready, don't bother
-       looking at the queue; if we aren't, wait for a request to come
-       in.  We can't really wait until something came in because we're
-       also checking lease expirations. */
-    if (gcreq == NULL)
+    /* Wait for requests to come in, or, if a batch is waiting for the
+       threads to make progress, for a short while before checking again.
+       We can't really wait until something came in because we're also
+       checking lease expirations. */
+    if (q->first == NULL)
     {
-      assert (trace_shortsleep);
-      if (q->first == NULL)
-      {
-        /* FIXME: use absolute timeouts */
-        /* avoid overflows; ensure periodic wakeups of receive thread if deaf */
-        const int64_t maxdelay = q->gv->deaf ? DDS_MSECS (100) : DDS_SECS (1000);
-        dds_time_t to;
-        if (delay >= maxdelay) {
-          to = maxdelay;
-        } else {
-          to = delay;
-        }
-        (void) ddsrt_cond_waitfor (&q->cond, &q->lock, to);
-      }
-      if (q->first)
-      {
-        gcreq = q->first;
-        q->first = q->first->next;
-      }
+      /* FIXME: use absolute timeouts */
+      /* avoid overflows; ensure periodic wakeups of receive thread if deaf */
+      const int64_t maxdelay = q->gv->deaf ? DDS_MSECS (100) : DDS_SECS (1000);
+      dds_time_t to = (delay >= maxdelay) ? maxdelay : delay;
+      if (q->batch != NULL && to > shortsleep)
+        to = shortsleep;
+      (void) ddsrt_cond_waitfor (&q->cond, &q->lock, to);
     }
+    struct gcreq * const incoming = q->first;
+    q->first = q->last = NULL;
     ddsrt_mutex_unlock (&q->lock);
 
     /* Cleanup dead proxy entities. One can argue this should be an
@@ -151,40 +198,52 @@ static uint32_t gcreq_queue_thread (struct gcreq_queue *q)
     delay = check_and_handle_lease_expiration (q->gv, ddsrt_time_elapsed ());
     thread_state_asleep (ts1);
 
-    if (gcreq)
+    gcreq_queue_sort_incoming (ts1, q, incoming);
+
+    if (q->batch == NULL && q->next_batch != NULL)
+    {
+      /* Start a new batch: the requests are all for objects that have
+         become unreachable before now, so once all threads that are
+         currently awake have made progress, none can still reference
+         them. */
+      q->batch = q->next_batch;
+      q->next_batch = q->next_batch_last = NULL;
+      q->epoch++;
+      threads_vtime_gather_for_wait (q->gv, &q->nvtimes, q->vtimes);
+    }
+
+    if (q->batch != NULL)
     {
-      if (!threads_vtime_check (&gcreq->nvtimes, gcreq->vtimes))
+      if (!threads_vtime_check (&q->nvtimes, q->vtimes))
       {
-        /* Not all threads made enough progress => gcreq is not ready
-           yet => sleep for a bit and retry.  Note that we can't even
-           terminate while this gcreq is waiting and that there is no
-           condition on which to wait, so a plain sleep is quite
-           reasonable. */
+        /* Not all threads made enough progress => batch is not ready
+           yet => wait a bit and retry, meanwhile accepting new
+           requests for the next batch. */
         if (trace_shortsleep)
         {
-          DDS_CTRACE (&q->gv->logconfig, "gc %p: not yet, shortsleep\n", (void *) gcreq);
+          DDS_CTRACE (&q->gv->logconfig, "gc epoch %"PRIu32": not yet, shortsleep\n", q->epoch);
           trace_shortsleep = 0;
         }
-        dds_sleepfor (shortsleep);
       }
       else
       {
         /* Sufficient progress has been made: may now continue deleting
-           it; the callback is responsible for requeueing (if complex
-           multi-phase delete) or freeing the delete request.  Reset
-           the current gcreq as this one obviously is no more.  */
-        DDS_CTRACE (&q->gv->logconfig, "gc %p: deleting\n", (void *) gcreq);
-        thread_state_awake_fixed_domain (ts1);
-        gcreq->cb (gcreq);
-        thread_state_asleep (ts1);
-        gcreq = NULL;
+           everything in the batch. */
+        struct gcreq * const batch = q->batch;
+        DDS_CTRACE (&q->gv->logconfig, "gc epoch %"PRIu32": deleting\n", q->epoch);
+        q->batch = NULL;
+        gcreq_run_list (ts1, batch);
         trace_shortsleep = 1;
+        /* don't wait before starting the next batch */
+        if (q->next_batch != NULL)
+          delay = 0;
       }
     }
 
     ddsrt_mutex_lock (&q->lock);
   }
   ddsrt_mutex_unlock (&q->lock);
+  assert (q->batch == NULL && q->next_batch == NULL);
   return 0;
 }
 
@@ -196,6 +255,10 @@ struct gcreq_queue *gcreq_queue_new (struct ddsi_domaingv *gv)
   q->terminate = 0;
   q->count = 0;
   q->gv = gv;
+  q->epoch = 0;
+  q->batch = q->next_batch = q->next_batch_last = NULL;
+  q->nvtimes = 0;
+  q->vtimes = ddsrt_malloc (thread_states.nthreads * sizeof (*q->vtimes));
   ddsrt_mutex_init (&q->lock);
   ddsrt_cond_init (&q->cond);
   if (create_thread (&q->ts, gv, "gc", (uint32_t (*) (void *)) gcreq_queue_thread, q) == DDS_RETCODE_OK)
@@ -204,6 +267,7 @@ struct gcreq_queue *gcreq_queue_new (struct ddsi_domaingv *gv)
   {
     ddsrt_mutex_destroy (&q->lock);
     ddsrt_cond_destroy (&q->cond);
+    ddsrt_free (q->vtimes);
     ddsrt_free (q);
     return NULL;
   }
@@ -223,7 +287,7 @@ void gcreq_queue_free (struct gcreq_queue *q)
 
   /* Create a no-op not dependent on any thread */
   gcreq = gcreq_new (q, gcreq_free);
-  gcreq->nvtimes = 0;
+  gcreq->ready = 1;
 
   ddsrt_mutex_lock (&q->lock);
   q->terminate = 1;
@@ -244,16 +308,17 @@ void gcreq_queue_free (struct gcreq_queue *q)
   assert (q->first == NULL);
   ddsrt_cond_destroy (&q->cond);
   ddsrt_mutex_destroy (&q->lock);
+  ddsrt_free (q->vtimes);
   ddsrt_free (q);
 }
 
 struct gcreq *gcreq_new (struct gcreq_queue *q, gcreq_cb_t cb)
 {
   struct gcreq *gcreq;
-  gcreq = ddsrt_malloc (offsetof (struct gcreq, vtimes) + thread_states.nthreads * sizeof (*gcreq->vtimes));
+  gcreq = ddsrt_malloc (sizeof (*gcreq));
   gcreq->cb = cb;
   gcreq->queue = q;
-  threads_vtime_gather_for_wait (q->gv, &gcreq->nvtimes, gcreq->vtimes);
+  gcreq->ready = 0;
   ddsrt_mutex_lock (&q->lock);
   q->count++;
   ddsrt_mutex_unlock (&q->lock);
@@ -301,6 +366,8 @@ void gcreq_enqueue (struct gcreq *gcreq)
 
 int gcreq_requeue (struct gcreq *gcreq, gcreq_cb_t cb)
 {
+  /* the threads have made progress already */
   gcreq->cb = cb;
+  gcreq->ready = 1;
   return gcreq_enqueue_common (gcreq);
 }
@@ -18,6 +18,7 @@
 #include "dds/ddsrt/time.h"
 #include "dds/ddsrt/string.h"
 #include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/sockets.h"
 
 #include "dds/ddsrt/avl.h"
 #include "dds/ddsrt/thread_pool.h"
@@ -48,6 +49,8 @@
 #include "dds/ddsi/q_pcap.h"
 #include "dds/ddsi/q_feature_check.h"
 #include "dds/ddsi/q_debmon.h"
+#include "dds/ddsi/ddsi_discovery_cache.h"
+#include "dds/ddsi/ddsi_partition_match.h"
 #include "dds/ddsi/q_init.h"
 #include "dds/ddsi/ddsi_threadmon.h"
 
@@ -55,6 +58,8 @@
 #include "dds/ddsi/ddsi_udp.h"
 #include "dds/ddsi/ddsi_tcp.h"
 #include "dds/ddsi/ddsi_raweth.h"
+#include "dds/ddsi/ddsi_shm.h"
+#include "dds/ddsi/ddsi_rxfilter.h"
 #include "dds/ddsi/ddsi_mcgroup.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
 
@@ -504,6 +509,14 @@ int rtps_config_prep (struct ddsi_domaingv *gv, struct cfgst *cfgst)
     goto err_config_late_error;
   }
 
+#ifndef SO_BUSY_POLL
+  if (gv->config.recv_busy_poll_socket)
+  {
+    DDS_ILOG (DDS_LC_ERROR, gv->config.domainId, "ReceiveBusyPoll[@socket]: SO_BUSY_POLL is not supported on this platform\n");
+    goto err_config_late_error;
+  }
+#endif
+
   /* Dependencies between default values is not handled
    automatically by the gv->config processing (yet) */
   if (gv->config.many_sockets_mode == MSM_MANY_UNICAST)
@@ -531,6 +544,14 @@ int rtps_config_prep (struct ddsi_domaingv *gv, struct cfgst *cfgst)
 #endif /* DDSI_INCLUDE_BANDWIDTH_LIMITING */
   }
 
+  /* Coalesced fragments are sent so fast that the receivers can't keep up
+     unless they are paced */
+  if (gv->config.large_sample_rate.isdefault)
+  {
+    gv->config.large_sample_rate.value = gv->config.coalesce_fragments ? 1000000000u /* 1 GB/s */ : 0;
+    gv->config.large_sample_rate.isdefault = 0;
+  }
+
   /* Verify thread properties refer to defined threads */
   if (!check_thread_properties (gv))
   {
@@ -839,6 +860,8 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
     gv->recv_threads[i].arg.gv = gv;
     gv->recv_threads[i].arg.u.single.loc = NULL;
     gv->recv_threads[i].arg.u.single.conn = NULL;
+    ddsrt_atomic_st64 (&gv->recv_threads[i].arg.u.single.npoll_spin, 0);
+    ddsrt_atomic_st64 (&gv->recv_threads[i].arg.u.single.npoll_block, 0);
   }
 
   /* First thread always uses a waitset and gobbles up all sockets not handled by dedicated threads - FIXME: MSM_NO_UNICAST mode with UDP probably doesn't even need this one to use a waitset */
@@ -868,6 +891,24 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
       gv->n_recv_threads++;
     }
   }
+  if (gv->config.recv_busy_poll > 0 && gv->n_recv_threads == 1)
+    GVWARNING ("ReceiveBusyPoll has no effect without receive threads dedicated to a single socket (see MultipleReceiveThreads)\n");
+  /* The shared-memory rings can't be waited on together with sockets, each
+     gets a thread of its own */
+  if (gv->shm_disc_conn)
+  {
+    gv->recv_threads[gv->n_recv_threads].name = "recvSHM";
+    gv->recv_threads[gv->n_recv_threads].arg.mode = RTM_SINGLE;
+    gv->recv_threads[gv->n_recv_threads].arg.u.single.conn = gv->shm_disc_conn;
+    gv->n_recv_threads++;
+  }
+  if (gv->shm_data_conn)
+  {
+    gv->recv_threads[gv->n_recv_threads].name = "recvSHMUC";
+    gv->recv_threads[gv->n_recv_threads].arg.mode = RTM_SINGLE;
+    gv->recv_threads[gv->n_recv_threads].arg.u.single.conn = gv->shm_data_conn;
+    gv->n_recv_threads++;
+  }
   assert (gv->n_recv_threads <= MAX_RECV_THREADS);
 
   /* For each thread, create rbufpool and waitset if needed, then start it */
@@ -876,7 +917,7 @@ static int setup_and_start_recv_threads (struct ddsi_domaingv *gv)
     /* We create the rbufpool for the receive thread, and so we'll
        become the initial owner thread. The receive thread will change
        it before it does anything with it. */
-    if ((gv->recv_threads[i].arg.rbpool = nn_rbufpool_new (&gv->logconfig, gv->config.rbuf_size, gv->config.rmsg_chunk_size)) == NULL)
+    if ((gv->recv_threads[i].arg.rbpool = nn_rbufpool_new (&gv->logconfig, gv->config.rbuf_size, gv->config.rmsg_chunk_size, gv->config.rbuf_arena_size)) == NULL)
     {
       GVERROR ("rtps_init: can't allocate receive buffer pool for thread %s\n", gv->recv_threads[i].name);
       goto fail;
@@ -960,6 +1001,9 @@ int rtps_init (struct ddsi_domaingv *gv)
   gv->disc_conn_mc = NULL;
   gv->data_conn_mc = NULL;
   gv->xmit_conn = NULL;
+  gv->shm_xmit_conn = NULL;
+  gv->shm_disc_conn = NULL;
+  gv->shm_data_conn = NULL;
   gv->listener = NULL;
   gv->thread_pool = NULL;
   gv->debmon = NULL;
@@ -1125,12 +1169,14 @@ int rtps_init (struct ddsi_domaingv *gv)
   ddsrt_mutex_init (&gv->sertopics_lock);
   gv->sertopics = ddsrt_hh_new (1, ddsi_sertopic_hash_wrap, ddsi_sertopic_equal_wrap);
   make_special_topics (gv);
+  gv->partition_match_cache = ddsi_partition_match_cache_new ();
 
   ddsrt_mutex_init (&gv->participant_set_lock);
   ddsrt_cond_init (&gv->participant_set_cond);
   lease_management_init (gv);
   gv->deleted_participants = deleted_participants_admin_new (&gv->logconfig, gv->config.prune_deleted_ppant.delay);
   gv->entity_index = entity_index_new (gv);
+  gv->rxfilter = ddsi_rxfilter_new (gv);
 
   ddsrt_mutex_init (&gv->privileged_pp_lock);
   gv->privileged_pp = NULL;
@@ -1236,18 +1282,7 @@ int rtps_init (struct ddsi_domaingv *gv)
   }
   GVLOG (DDS_LC_CONFIG, "rtps_init: domainid %"PRIu32" participantid %d\n", gv->config.domainId, gv->config.participantIndex);
 
-  if (gv->config.pcap_file && *gv->config.pcap_file)
-  {
-    gv->pcap_fp = new_pcap_file (gv, gv->config.pcap_file);
-    if (gv->pcap_fp)
-    {
-      ddsrt_mutex_init (&gv->pcap_lock);
-    }
-  }
-  else
-  {
-    gv->pcap_fp = NULL;
-  }
+  pcap_init (gv);
 
   gv->mship = new_group_membership();
 
@@ -1318,6 +1353,31 @@ int rtps_init (struct ddsi_domaingv *gv)
       goto err_mc_conn;
   }
 
+  /* Shared-memory rings for the unicast ports, failure to set them up is not
+     fatal because the regular transport is always available */
+  if (gv->config.enable_shm)
+  {
+    if (gv->config.transport_selector != TRANS_UDP && gv->config.transport_selector != TRANS_UDP6)
+      GVWARNING ("shared memory is only supported in combination with UDP\n");
+    else if (gv->config.many_sockets_mode == MSM_NO_UNICAST)
+      GVWARNING ("shared memory requires unicast sockets\n");
+    else if (ddsi_shm_init (gv) < 0)
+      GVWARNING ("shared memory is not supported on this platform\n");
+    else
+    {
+      struct ddsi_tran_factory * const fact = ddsi_factory_find (gv, "shm");
+      const ddsi_tran_qos_t qos_xmit = { .m_purpose = DDSI_TRAN_QOS_XMIT, .m_diffserv = 0 };
+      const ddsi_tran_qos_t qos_recv = { .m_purpose = DDSI_TRAN_QOS_RECV_UC, .m_diffserv = 0 };
+      if (ddsi_factory_create_conn (&gv->shm_disc_conn, fact, gv->loc_meta_uc.port, &qos_recv) != DDS_RETCODE_OK)
+        gv->shm_disc_conn = NULL;
+      if (gv->loc_default_uc.port != gv->loc_meta_uc.port &&
+          ddsi_factory_create_conn (&gv->shm_data_conn, fact, gv->loc_default_uc.port, &qos_recv) != DDS_RETCODE_OK)
+        gv->shm_data_conn = NULL;
+      if (ddsi_factory_create_conn (&gv->shm_xmit_conn, fact, 0, &qos_xmit) != DDS_RETCODE_OK)
+        gv->shm_xmit_conn = NULL;
+    }
+  }
+
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
   {
     struct config_channel_listelem *chptr = gv->config.channels;
@@ -1436,19 +1496,26 @@ int rtps_init (struct ddsi_domaingv *gv)
   gv->user_dqueue = nn_dqueue_new ("user", gv, gv->config.delivery_queue_maxsamples, user_dqueue_handler, NULL);
 #endif
 
+  gv->discovery_cache = ddsi_discovery_cache_new (gv);
+
   if (reset_deaf_mute_time.v < DDS_NEVER)
     qxev_callback (gv->xevents, reset_deaf_mute_time, reset_deaf_mute, gv);
   return 0;
 
 err_mc_conn:
+  if (gv->shm_xmit_conn)
+    ddsi_conn_free (gv->shm_xmit_conn);
+  if (gv->shm_data_conn)
+    ddsi_conn_free (gv->shm_data_conn);
+  if (gv->shm_disc_conn)
+    ddsi_conn_free (gv->shm_disc_conn);
   if (gv->xmit_conn)
     ddsi_conn_free (gv->xmit_conn);
   if (gv->disc_conn_mc)
     ddsi_conn_free (gv->disc_conn_mc);
   if (gv->data_conn_mc && gv->data_conn_mc != gv->disc_conn_mc)
     ddsi_conn_free (gv->data_conn_mc);
-  if (gv->pcap_fp)
-    ddsrt_mutex_destroy (&gv->pcap_lock);
+  pcap_fini (gv);
   if (gv->disc_conn_uc != gv->disc_conn_mc)
     ddsi_conn_free (gv->disc_conn_uc);
   if (gv->data_conn_uc != gv->disc_conn_uc)
@@ -1461,6 +1528,8 @@ err_unicast_sockets:
   ddsrt_mutex_destroy (&gv->spdp_lock);
   ddsrt_mutex_destroy (&gv->lock);
   ddsrt_mutex_destroy (&gv->privileged_pp_lock);
+  ddsi_rxfilter_free (gv->rxfilter);
+  gv->rxfilter = NULL;
   entity_index_free (gv->entity_index);
   gv->entity_index = NULL;
   deleted_participants_admin_free (gv->deleted_participants);
@@ -1476,6 +1545,7 @@ err_unicast_sockets:
 #endif
   ddsrt_hh_free (gv->sertopics);
   ddsrt_mutex_destroy (&gv->sertopics_lock);
+  ddsi_partition_match_cache_free (gv->partition_match_cache);
   ddsi_xqos_fini (&gv->builtin_endpoint_xqos_wr);
   ddsi_xqos_fini (&gv->builtin_endpoint_xqos_rd);
   ddsi_xqos_fini (&gv->spdp_endpoint_xqos);
@@ -1540,8 +1610,15 @@ int rtps_start (struct ddsi_domaingv *gv)
   }
 #endif
 
+  /* Restoring the cached proxies must be done before the receive threads start
+     processing discovery data */
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_start (gv->discovery_cache);
+
   if (setup_and_start_recv_threads (gv) < 0)
   {
+    if (gv->discovery_cache)
+      ddsi_discovery_cache_stop (gv->discovery_cache);
 #ifdef DDSI_INCLUDE_NETWORK_CHANNELS
     stop_all_xeventq_upto (NULL);
 #endif
@@ -1644,6 +1721,10 @@ void rtps_stop (struct ddsi_domaingv *gv)
   nn_defrag_free (gv->spdp_defrag);
   ddsrt_mutex_destroy (&gv->spdp_lock);
 
+  /* Save the discovery cache while all proxies still exist */
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_stop (gv->discovery_cache);
+
   {
     struct entidx_enum_proxy_participant est;
     struct proxy_participant *proxypp;
@@ -1739,6 +1820,9 @@ void rtps_fini (struct ddsi_domaingv *gv)
   nn_dqueue_free (gv->user_dqueue);
 #endif
 
+  if (gv->discovery_cache)
+    ddsi_discovery_cache_free (gv->discovery_cache);
+
   xeventq_free (gv->xevents);
 
   if (gv->config.xpack_send_async)
@@ -1767,6 +1851,12 @@ void rtps_fini (struct ddsi_domaingv *gv)
 
   (void) joinleave_spdp_defmcip (gv, 0);
 
+  if (gv->shm_xmit_conn)
+    ddsi_conn_free (gv->shm_xmit_conn);
+  if (gv->shm_data_conn)
+    ddsi_conn_free (gv->shm_data_conn);
+  if (gv->shm_disc_conn)
+    ddsi_conn_free (gv->shm_disc_conn);
   ddsi_conn_free (gv->xmit_conn);
   ddsi_conn_free (gv->disc_conn_mc);
   if (gv->data_conn_mc != gv->disc_conn_mc)
@@ -1779,11 +1869,7 @@ void rtps_fini (struct ddsi_domaingv *gv)
   free_group_membership(gv->mship);
   ddsi_tran_factories_fini (gv);
 
-  if (gv->pcap_fp)
-  {
-    ddsrt_mutex_destroy (&gv->pcap_lock);
-    fclose (gv->pcap_fp);
-  }
+  pcap_fini (gv);
 
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
   for (struct config_networkpartition_listelem *np = gv->config.networkPartitions; np; np = np->next)
@@ -1805,6 +1891,8 @@ void rtps_fini (struct ddsi_domaingv *gv)
 
   ddsi_tkmap_free (gv->m_tkmap);
 
+  ddsi_rxfilter_free (gv->rxfilter);
+  gv->rxfilter = NULL;
   entity_index_free (gv->entity_index);
   gv->entity_index = NULL;
   deleted_participants_admin_free (gv->deleted_participants);
@@ -1821,6 +1909,7 @@ void rtps_fini (struct ddsi_domaingv *gv)
 #endif
   ddsrt_hh_free (gv->sertopics);
   ddsrt_mutex_destroy (&gv->sertopics_lock);
+  ddsi_partition_match_cache_free (gv->partition_match_cache);
 
   ddsi_xqos_fini (&gv->builtin_endpoint_xqos_wr);
   ddsi_xqos_fini (&gv->builtin_endpoint_xqos_rd);
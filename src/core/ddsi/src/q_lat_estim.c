@@ -77,8 +77,13 @@ int nn_lat_estim_log (uint32_t logcat, const struct ddsrt_log_cfg *logcfg, const
   }
 }
 
-#if 0 /* not implemented yet */
 double nn_lat_estim_current (const struct nn_lat_estim *le)
 {
+  /* median of the most recent measurements in microseconds, which follows
+     changes much more quickly than the smoothed value; 0 if there aren't
+     enough measurements yet */
+  float tmp[NN_LAT_ESTIM_MEDIAN_WINSZ];
+  memcpy (tmp, le->window, sizeof (tmp));
+  qsort (tmp, NN_LAT_ESTIM_MEDIAN_WINSZ, sizeof (tmp[0]), (int (*) (const void *, const void *)) cmpfloat);
+  return tmp[NN_LAT_ESTIM_MEDIAN_WINSZ / 2];
 }
-#endif
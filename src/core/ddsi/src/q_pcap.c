@@ -10,13 +10,23 @@
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "dds/ddsrt/endian.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/sync.h"
 #include "dds/ddsi/q_log.h"
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/q_bswap.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_misc.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/q_pcap.h"
 
 /* pcap format info taken from http://wiki.wireshark.org/Development/LibpcapFileFormat */
@@ -75,8 +85,54 @@ static const ipv4_hdr_t ipv4_hdr_template = {
 
 #define IPV4_HDR_SIZE 20
 #define UDP_HDR_SIZE 8
+#define PCAPREC_SIZE (sizeof (pcaprec_hdr_t) + IPV4_HDR_SIZE + UDP_HDR_SIZE)
+#define PCAP_SYNCBUF_SIZE (PCAPREC_SIZE + 65536)
 
-FILE *new_pcap_file (struct ddsi_domaingv *gv, const char *name)
+/* Asynchronous capture: packets are copied into a ring buffer by whichever
+   thread sends or receives them, and written to the file by a separate
+   thread.  Space in the ring is claimed by atomically advancing "head", the
+   writer thread releases it by advancing "tail".  Each record starts with a
+   header word that the producer sets once the record is complete; a record
+   that doesn't fit in the remainder of the buffer is preceded by a padding
+   record covering that remainder.  The writer thread zeroes all records it
+   has processed before releasing them, so that an unfinished record can
+   always be recognised by its header word. */
+
+#define PCAP_REC_COMMITTED 0x80000000u
+#define PCAP_REC_PAD       0x40000000u
+#define PCAP_REC_SIZE_MASK 0x3fffffffu
+
+struct pcap_rec {
+  ddsrt_atomic_uint32_t state; /* total size including header | flags, 0 while unfinished */
+  uint32_t len; /* length of the pcap record that follows */
+};
+
+struct pcap_ring {
+  ddsrt_atomic_uint32_t head;
+  ddsrt_atomic_uint32_t tail;
+  uint32_t size; /* power of 2 */
+  unsigned char *buf;
+};
+
+struct pcap_state {
+  struct pcap_ring *ring;
+  unsigned char *syncbuf; /* for formatting records without a ring, protected by gv->pcap_lock */
+  uint32_t snaplen; /* 0 if unlimited */
+  uint32_t n_prefixes;
+  unsigned char (*prefixes)[12]; /* in network byte order */
+  uint32_t n_topics;
+  char **topics;
+  ddsrt_atomic_uint32_t n_captured;
+  ddsrt_atomic_uint32_t n_filtered;
+  ddsrt_atomic_uint32_t n_dropped;
+  ddsrt_atomic_uint32_t kicked;
+  ddsrt_mutex_t lock;
+  ddsrt_cond_t cond;
+  bool terminate;
+  struct thread_state1 *ts;
+};
+
+static FILE *new_pcap_file (struct ddsi_domaingv *gv, const char *name, uint32_t snaplen)
 {
   DDSRT_WARNING_MSVC_OFF(4996);
   FILE *fp;
@@ -93,7 +149,7 @@ FILE *new_pcap_file (struct ddsi_domaingv *gv, const char *name)
   hdr.version_minor = 4;
   hdr.thiszone = 0;
   hdr.sigfigs = 0;
-  hdr.snaplen = 65535;
+  hdr.snaplen = (snaplen == 0) ? 65535 : snaplen + IPV4_HDR_SIZE + UDP_HDR_SIZE;
   hdr.network = LINKTYPE_RAW;
   (void) fwrite (&hdr, sizeof (hdr), 1, fp);
 
@@ -101,19 +157,6 @@ FILE *new_pcap_file (struct ddsi_domaingv *gv, const char *name)
   DDSRT_WARNING_MSVC_ON(4996);
 }
 
-static void write_data (FILE *fp, const ddsrt_msghdr_t *msghdr, size_t sz)
-{
-  size_t i, n = 0;
-  for (i = 0; i < (size_t) msghdr->msg_iovlen && n < sz; i++)
-  {
-    size_t m1 = msghdr->msg_iov[i].iov_len;
-    size_t m = (n + m1 <= sz) ? m1 : sz - n;
-    (void) fwrite (msghdr->msg_iov[i].iov_base, m, 1, fp);
-    n += m;
-  }
-  assert (n == sz);
-}
-
 static uint16_t calc_ipv4_checksum (const uint16_t *x)
 {
   uint32_t s = 0;
@@ -126,68 +169,448 @@ static uint16_t calc_ipv4_checksum (const uint16_t *x)
   return (uint16_t) ~s;
 }
 
-void write_pcap_received (struct ddsi_domaingv *gv, ddsrt_wctime_t tstamp, const struct sockaddr_storage *src, const struct sockaddr_storage *dst, unsigned char *buf, size_t sz)
+/* Sequential access to the contents of an iovec, for inspecting the
+   submessages of packets that are about to be sent */
+struct iovcursor {
+  const ddsrt_iovec_t *iov;
+  size_t niov;
+  size_t idx;  /* index of iovec containing ... */
+  size_t base; /* ... offset base */
+};
+
+static bool iovcursor_read (struct iovcursor *c, size_t off, void *dst, size_t n)
+{
+  unsigned char *d = dst;
+  assert (off >= c->base);
+  while (c->idx < c->niov && off >= c->base + c->iov[c->idx].iov_len)
+    c->base += c->iov[c->idx++].iov_len;
+  size_t i = c->idx, b = c->base;
+  while (n > 0 && i < c->niov)
+  {
+    const size_t o = off - b, m1 = c->iov[i].iov_len - o, m = (m1 < n) ? m1 : n;
+    memcpy (d, (const unsigned char *) c->iov[i].iov_base + o, m);
+    d += m; off += m; n -= m;
+    b += c->iov[i++].iov_len;
+  }
+  return n == 0;
+}
+
+static uint16_t smhdr_octets (const unsigned char smhdr[4])
+{
+  if (smhdr[1] & SMFLAG_ENDIANNESS)
+    return (uint16_t) (smhdr[2] | (smhdr[3] << 8));
+  else
+    return (uint16_t) ((smhdr[2] << 8) | smhdr[3]);
+}
+
+static bool prefix_filter_match (const struct pcap_state *st, const ddsrt_iovec_t *iov, size_t niov, size_t sz)
+{
+  /* Matches if the source GUID prefix in the RTPS header or the destination
+     prefix in any INFO_DST submessage is listed */
+  struct iovcursor c = { iov, niov, 0, 0 };
+  unsigned char prefix[12], smhdr[4];
+  size_t off = RTPS_MESSAGE_HEADER_SIZE;
+  bool more = iovcursor_read (&c, offsetof (Header_t, guid_prefix), prefix, sizeof (prefix));
+  while (more)
+  {
+    for (uint32_t i = 0; i < st->n_prefixes; i++)
+      if (memcmp (prefix, st->prefixes[i], sizeof (prefix)) == 0)
+        return true;
+    more = false;
+    while (off + 4 <= sz && iovcursor_read (&c, off, smhdr, sizeof (smhdr)))
+    {
+      const uint16_t octets = smhdr_octets (smhdr);
+      if (smhdr[0] == SMID_INFO_DST && iovcursor_read (&c, off + 4, prefix, sizeof (prefix)))
+        more = true;
+      off = (octets == 0) ? sz : off + 4 + octets;
+      if (more)
+        break;
+    }
+  }
+  return false;
+}
+
+static bool topic_match (const struct pcap_state *st, const struct ddsi_domaingv *gv, const ddsi_guid_prefix_t *prefix, const unsigned char *wrid)
+{
+  ddsi_guid_t guid;
+  const char *name = NULL;
+  struct writer *wr;
+  struct proxy_writer *pwr;
+  guid.prefix = *prefix;
+  memcpy (&guid.entityid, wrid, sizeof (guid.entityid));
+  guid.entityid = nn_ntoh_entityid (guid.entityid);
+  if (!is_writer_entityid (guid.entityid))
+    return false;
+  /* built-in writers have no topic name in their QoS */
+  if ((wr = entidx_lookup_writer_guid (gv->entity_index, &guid)) != NULL && (wr->xqos->present & QP_TOPIC_NAME))
+    name = wr->xqos->topic_name;
+  else if ((pwr = entidx_lookup_proxy_writer_guid (gv->entity_index, &guid)) != NULL && (pwr->c.xqos->present & QP_TOPIC_NAME))
+    name = pwr->c.xqos->topic_name;
+  if (name == NULL)
+    return false;
+  for (uint32_t i = 0; i < st->n_topics; i++)
+    if (ddsi2_patmatch (st->topics[i], name))
+      return true;
+  return false;
+}
+
+static bool topic_filter_match (const struct pcap_state *st, const struct ddsi_domaingv *gv, const ddsrt_iovec_t *iov, size_t niov, size_t sz)
+{
+  /* Matches if any submessage refers to a writer of one of the topics;
+     entity lookups require the calling thread to be awake */
+  struct iovcursor c = { iov, niov, 0, 0 };
+  ddsi_guid_prefix_t src, dst;
+  unsigned char sm[16];
+  size_t off = RTPS_MESSAGE_HEADER_SIZE;
+  if (!iovcursor_read (&c, offsetof (Header_t, guid_prefix), &src, sizeof (src)))
+    return false;
+  src = nn_ntoh_guid_prefix (src);
+  memset (&dst, 0, sizeof (dst));
+  while (off + 4 <= sz && iovcursor_read (&c, off, sm, (off + sizeof (sm) <= sz) ? sizeof (sm) : 4))
+  {
+    const uint16_t octets = smhdr_octets (sm);
+    const size_t end = (octets == 0) ? sz : off + 4 + octets;
+    switch (sm[0])
+    {
+      case SMID_INFO_DST:
+        if (off + 16 <= sz)
+        {
+          memcpy (&dst, sm + 4, sizeof (dst));
+          dst = nn_ntoh_guid_prefix (dst);
+        }
+        break;
+      case SMID_DATA: case SMID_DATA_FRAG:
+        if (off + 16 <= sz && topic_match (st, gv, &src, sm + 12))
+          return true;
+        break;
+      case SMID_HEARTBEAT: case SMID_GAP: case SMID_HEARTBEAT_FRAG:
+        if (off + 12 <= sz && topic_match (st, gv, &src, sm + 8))
+          return true;
+        break;
+      case SMID_ACKNACK: case SMID_NACK_FRAG:
+        if (off + 12 <= sz && topic_match (st, gv, &dst, sm + 8))
+          return true;
+        break;
+    }
+    off = end;
+  }
+  return false;
+}
+
+static void write_record (struct ddsi_domaingv *gv, const unsigned char *rec, size_t len)
+{
+  struct pcap_state * const st = gv->pcap;
+  (void) fwrite (rec, len, 1, gv->pcap_fp);
+  ddsrt_atomic_inc32 (&st->n_captured);
+}
+
+static unsigned char *ring_reserve (struct pcap_ring *r, uint32_t size)
+{
+  uint32_t h, t, off, pad;
+  do {
+    h = ddsrt_atomic_ld32 (&r->head);
+    t = ddsrt_atomic_ld32 (&r->tail);
+    off = h & (r->size - 1);
+    pad = (off + size > r->size) ? r->size - off : 0;
+    if (h + pad + size - t > r->size)
+      return NULL;
+  } while (!ddsrt_atomic_cas32 (&r->head, h, h + pad + size));
+  ddsrt_atomic_fence_acq ();
+  if (pad > 0)
+  {
+    struct pcap_rec *rec = (struct pcap_rec *) (r->buf + off);
+    ddsrt_atomic_st32 (&rec->state, pad | PCAP_REC_PAD | PCAP_REC_COMMITTED);
+  }
+  return r->buf + ((h + pad) & (r->size - 1));
+}
+
+static bool ring_consume (struct ddsi_domaingv *gv, struct pcap_ring *r)
+{
+  uint32_t t = ddsrt_atomic_ld32 (&r->tail);
+  const uint32_t h = ddsrt_atomic_ld32 (&r->head);
+  bool progress = false;
+  while (t != h)
+  {
+    struct pcap_rec *rec = (struct pcap_rec *) (r->buf + (t & (r->size - 1)));
+    const uint32_t state = ddsrt_atomic_ld32 (&rec->state);
+    if (!(state & PCAP_REC_COMMITTED))
+      break;
+    ddsrt_atomic_fence_acq ();
+    if (!(state & PCAP_REC_PAD))
+      write_record (gv, (const unsigned char *) (rec + 1), rec->len);
+    memset (rec, 0, state & PCAP_REC_SIZE_MASK);
+    ddsrt_atomic_fence_rel ();
+    t += state & PCAP_REC_SIZE_MASK;
+    ddsrt_atomic_st32 (&r->tail, t);
+    progress = true;
+  }
+  return progress;
+}
+
+static uint32_t pcap_writer_thread (struct ddsi_domaingv *gv)
+{
+  struct pcap_state * const st = gv->pcap;
+  ddsrt_mutex_lock (&st->lock);
+  while (true)
+  {
+    ddsrt_atomic_st32 (&st->kicked, 0);
+    ddsrt_mutex_unlock (&st->lock);
+    const bool progress = ring_consume (gv, st->ring);
+    if (!progress)
+      (void) fflush (gv->pcap_fp);
+    ddsrt_mutex_lock (&st->lock);
+    if (!progress)
+    {
+      if (st->terminate && ddsrt_atomic_ld32 (&st->ring->head) == ddsrt_atomic_ld32 (&st->ring->tail))
+        break;
+      (void) ddsrt_cond_waitfor (&st->cond, &st->lock, DDS_MSECS (10));
+    }
+  }
+  ddsrt_mutex_unlock (&st->lock);
+  return 0;
+}
+
+static void fill_record (unsigned char *dst, ddsrt_wctime_t tstamp, unsigned char ttl, const struct sockaddr_storage *src, const struct sockaddr_storage *dst_addr, const ddsrt_iovec_t *iov, size_t niov, size_t sz, size_t incl)
+{
+  pcaprec_hdr_t pcap_hdr;
+  union {
+    ipv4_hdr_t ipv4_hdr;
+    uint16_t x[10];
+  } u;
+  udp_hdr_t udp_hdr;
+  size_t sz_ud = sz + UDP_HDR_SIZE;
+  size_t sz_iud = sz_ud + IPV4_HDR_SIZE;
+  ddsrt_wctime_to_sec_usec (&pcap_hdr.ts_sec, &pcap_hdr.ts_usec, tstamp);
+  pcap_hdr.incl_len = (uint32_t) (incl + UDP_HDR_SIZE + IPV4_HDR_SIZE);
+  pcap_hdr.orig_len = (uint32_t) sz_iud;
+  memcpy (dst, &pcap_hdr, sizeof (pcap_hdr));
+  dst += sizeof (pcap_hdr);
+  u.ipv4_hdr = ipv4_hdr_template;
+  u.ipv4_hdr.totallength = ddsrt_toBE2u ((unsigned short) sz_iud);
+  u.ipv4_hdr.ttl = ttl;
+  u.ipv4_hdr.srcip = ((const struct sockaddr_in*) src)->sin_addr.s_addr;
+  u.ipv4_hdr.dstip = ((const struct sockaddr_in*) dst_addr)->sin_addr.s_addr;
+  u.ipv4_hdr.checksum = calc_ipv4_checksum (u.x);
+  memcpy (dst, &u.ipv4_hdr, IPV4_HDR_SIZE);
+  dst += IPV4_HDR_SIZE;
+  udp_hdr.srcport = ((const struct sockaddr_in*) src)->sin_port;
+  udp_hdr.dstport = ((const struct sockaddr_in*) dst_addr)->sin_port;
+  udp_hdr.length = ddsrt_toBE2u ((unsigned short) sz_ud);
+  udp_hdr.checksum = 0; /* don't have to compute a checksum for UDPv4 */
+  memcpy (dst, &udp_hdr, UDP_HDR_SIZE);
+  dst += UDP_HDR_SIZE;
+  for (size_t i = 0, n = 0; i < niov && n < incl; i++)
+  {
+    size_t m1 = iov[i].iov_len;
+    size_t m = (n + m1 <= incl) ? m1 : incl - n;
+    memcpy (dst + n, iov[i].iov_base, m);
+    n += m;
+  }
+}
+
+static bool filter_match (struct ddsi_domaingv *gv, const ddsrt_iovec_t *iov, size_t niov, size_t sz)
 {
-  if (gv->config.transport_selector == TRANS_UDP)
+  /* Both filters are evaluated by the thread capturing the packet, while the
+     writers it refers to are guaranteed to still exist */
+  struct pcap_state * const st = gv->pcap;
+  bool match = true;
+  if (st->n_prefixes > 0)
+    match = prefix_filter_match (st, iov, niov, sz);
+  if (match && st->n_topics > 0)
+  {
+    struct thread_state1 * const ts1 = lookup_thread_state ();
+    thread_state_awake (ts1, gv);
+    match = topic_filter_match (st, gv, iov, niov, sz);
+    thread_state_asleep (ts1);
+  }
+  if (!match)
+    ddsrt_atomic_inc32 (&st->n_filtered);
+  return match;
+}
+
+static void capture (struct ddsi_domaingv *gv, ddsrt_wctime_t tstamp, unsigned char ttl, const struct sockaddr_storage *src, const struct sockaddr_storage *dst, const ddsrt_iovec_t *iov, size_t niov, size_t sz)
+{
+  struct pcap_state * const st = gv->pcap;
+  const size_t incl = (st->snaplen > 0 && sz > st->snaplen) ? st->snaplen : sz;
+  const size_t len = PCAPREC_SIZE + incl;
+
+  if (gv->config.transport_selector != TRANS_UDP)
+    return;
+  if (!filter_match (gv, iov, niov, sz))
+    return;
+
+  if (st->ring)
+  {
+    const uint32_t size = (uint32_t) ((sizeof (struct pcap_rec) + len + 7) & ~(size_t) 7);
+    struct pcap_rec *rec;
+    if ((rec = (struct pcap_rec *) ring_reserve (st->ring, size)) == NULL)
+    {
+      ddsrt_atomic_inc32 (&st->n_dropped);
+      return;
+    }
+    rec->len = (uint32_t) len;
+    fill_record ((unsigned char *) (rec + 1), tstamp, ttl, src, dst, iov, niov, sz, incl);
+    ddsrt_atomic_fence_rel ();
+    ddsrt_atomic_st32 (&rec->state, size | PCAP_REC_COMMITTED);
+    /* wake up the writer thread early if the ring is filling up */
+    if (ddsrt_atomic_ld32 (&st->ring->head) - ddsrt_atomic_ld32 (&st->ring->tail) > st->ring->size / 2 &&
+        ddsrt_atomic_cas32 (&st->kicked, 0, 1))
+    {
+      ddsrt_mutex_lock (&st->lock);
+      ddsrt_cond_signal (&st->cond);
+      ddsrt_mutex_unlock (&st->lock);
+    }
+  }
+  else if (len > PCAP_SYNCBUF_SIZE)
+  {
+    /* can't happen for UDP, whose datagrams are limited to 64kB */
+    ddsrt_atomic_inc32 (&st->n_dropped);
+  }
+  else
   {
-    pcaprec_hdr_t pcap_hdr;
-    union {
-      ipv4_hdr_t ipv4_hdr;
-      uint16_t x[10];
-    } u;
-    udp_hdr_t udp_hdr;
-    size_t sz_ud = sz + UDP_HDR_SIZE;
-    size_t sz_iud = sz_ud + IPV4_HDR_SIZE;
     ddsrt_mutex_lock (&gv->pcap_lock);
-    ddsrt_wctime_to_sec_usec (&pcap_hdr.ts_sec, &pcap_hdr.ts_usec, tstamp);
-    pcap_hdr.incl_len = pcap_hdr.orig_len = (uint32_t) sz_iud;
-    (void) fwrite (&pcap_hdr, sizeof (pcap_hdr), 1, gv->pcap_fp);
-    u.ipv4_hdr = ipv4_hdr_template;
-    u.ipv4_hdr.totallength = ddsrt_toBE2u ((unsigned short) sz_iud);
-    u.ipv4_hdr.ttl = 128;
-    u.ipv4_hdr.srcip = ((struct sockaddr_in*) src)->sin_addr.s_addr;
-    u.ipv4_hdr.dstip = ((struct sockaddr_in*) dst)->sin_addr.s_addr;
-    u.ipv4_hdr.checksum = calc_ipv4_checksum (u.x);
-    (void) fwrite (&u.ipv4_hdr, sizeof (u.ipv4_hdr), 1, gv->pcap_fp);
-    udp_hdr.srcport = ((struct sockaddr_in*) src)->sin_port;
-    udp_hdr.dstport = ((struct sockaddr_in*) dst)->sin_port;
-    udp_hdr.length = ddsrt_toBE2u ((unsigned short) sz_ud);
-    udp_hdr.checksum = 0; /* don't have to compute a checksum for UDPv4 */
-    (void) fwrite (&udp_hdr, sizeof (udp_hdr), 1, gv->pcap_fp);
-    (void) fwrite (buf, sz, 1, gv->pcap_fp);
+    fill_record (st->syncbuf, tstamp, ttl, src, dst, iov, niov, sz, incl);
+    write_record (gv, st->syncbuf, len);
     ddsrt_mutex_unlock (&gv->pcap_lock);
   }
 }
 
+void write_pcap_received (struct ddsi_domaingv *gv, ddsrt_wctime_t tstamp, const struct sockaddr_storage *src, const struct sockaddr_storage *dst, unsigned char *buf, size_t sz)
+{
+  ddsrt_iovec_t iov;
+  iov.iov_base = buf;
+  iov.iov_len = (ddsrt_iov_len_t) sz;
+  capture (gv, tstamp, 128, src, dst, &iov, 1, sz);
+}
+
 void write_pcap_sent (struct ddsi_domaingv *gv, ddsrt_wctime_t tstamp, const struct sockaddr_storage *src, const ddsrt_msghdr_t *hdr, size_t sz)
 {
-  if (gv->config.transport_selector == TRANS_UDP)
+  capture (gv, tstamp, 255, src, hdr->msg_name, hdr->msg_iov, (size_t) hdr->msg_iovlen, sz);
+}
+
+static bool parse_filters (struct ddsi_domaingv *gv, struct pcap_state *st)
+{
+  char *copy, *cursor, *tok;
+  if (gv->config.pcap_guid_prefixes && *gv->config.pcap_guid_prefixes)
   {
-    pcaprec_hdr_t pcap_hdr;
-    union {
-      ipv4_hdr_t ipv4_hdr;
-      uint16_t x[10];
-    } u;
-    udp_hdr_t udp_hdr;
-    size_t sz_ud = sz + UDP_HDR_SIZE;
-    size_t sz_iud = sz_ud + IPV4_HDR_SIZE;
-    ddsrt_mutex_lock (&gv->pcap_lock);
-    ddsrt_wctime_to_sec_usec (&pcap_hdr.ts_sec, &pcap_hdr.ts_usec, tstamp);
-    pcap_hdr.incl_len = pcap_hdr.orig_len = (uint32_t) sz_iud;
-    (void) fwrite (&pcap_hdr, sizeof (pcap_hdr), 1, gv->pcap_fp);
-    u.ipv4_hdr = ipv4_hdr_template;
-    u.ipv4_hdr.totallength = ddsrt_toBE2u ((unsigned short) sz_iud);
-    u.ipv4_hdr.ttl = 255;
-    u.ipv4_hdr.srcip = ((struct sockaddr_in*) src)->sin_addr.s_addr;
-    u.ipv4_hdr.dstip = ((struct sockaddr_in*) hdr->msg_name)->sin_addr.s_addr;
-    u.ipv4_hdr.checksum = calc_ipv4_checksum (u.x);
-    (void) fwrite (&u.ipv4_hdr, sizeof (u.ipv4_hdr), 1, gv->pcap_fp);
-    udp_hdr.srcport = ((struct sockaddr_in*) src)->sin_port;
-    udp_hdr.dstport = ((struct sockaddr_in*) hdr->msg_name)->sin_port;
-    udp_hdr.length = ddsrt_toBE2u ((unsigned short) sz_ud);
-    udp_hdr.checksum = 0; /* don't have to compute a checksum for UDPv4 */
-    (void) fwrite (&udp_hdr, sizeof (udp_hdr), 1, gv->pcap_fp);
-    write_data (gv->pcap_fp, hdr, sz);
-    ddsrt_mutex_unlock (&gv->pcap_lock);
+    cursor = copy = ddsrt_strdup (gv->config.pcap_guid_prefixes);
+    while ((tok = ddsrt_strsep (&cursor, ",")) != NULL)
+    {
+      ddsi_guid_prefix_t p;
+      int pos;
+      if (sscanf (tok, " %"SCNx32":%"SCNx32":%"SCNx32" %n", &p.u[0], &p.u[1], &p.u[2], &pos) != 3 || tok[pos] != 0)
+      {
+        GVWARNING ("packet capture disabled: invalid GUID prefix \"%s\" in Tracing/PacketCaptureGuidPrefixes\n", tok);
+        ddsrt_free (copy);
+        return false;
+      }
+      p = nn_hton_guid_prefix (p);
+      st->prefixes = ddsrt_realloc (st->prefixes, (st->n_prefixes + 1) * sizeof (*st->prefixes));
+      memcpy (st->prefixes[st->n_prefixes++], &p, sizeof (p));
+    }
+    ddsrt_free (copy);
+  }
+  if (gv->config.pcap_topics && *gv->config.pcap_topics)
+  {
+    cursor = copy = ddsrt_strdup (gv->config.pcap_topics);
+    while ((tok = ddsrt_strsep (&cursor, ",")) != NULL)
+    {
+      if (*tok == 0)
+        continue;
+      st->topics = ddsrt_realloc (st->topics, (st->n_topics + 1) * sizeof (*st->topics));
+      st->topics[st->n_topics++] = ddsrt_strdup (tok);
+    }
+    ddsrt_free (copy);
+  }
+  return true;
+}
+
+static void free_pcap_state (struct pcap_state *st)
+{
+  for (uint32_t i = 0; i < st->n_topics; i++)
+    ddsrt_free (st->topics[i]);
+  ddsrt_free (st->topics);
+  ddsrt_free (st->prefixes);
+  ddsrt_free (st->syncbuf);
+  if (st->ring)
+  {
+    ddsrt_free (st->ring->buf);
+    ddsrt_free (st->ring);
+  }
+  ddsrt_cond_destroy (&st->cond);
+  ddsrt_mutex_destroy (&st->lock);
+  ddsrt_free (st);
+}
+
+void pcap_init (struct ddsi_domaingv *gv)
+{
+  struct pcap_state *st;
+  gv->pcap_fp = NULL;
+  gv->pcap = NULL;
+  if (gv->config.pcap_file == NULL || *gv->config.pcap_file == 0)
+    return;
+
+  st = ddsrt_malloc (sizeof (*st));
+  memset (st, 0, sizeof (*st));
+  ddsrt_mutex_init (&st->lock);
+  ddsrt_cond_init (&st->cond);
+  st->snaplen = gv->config.pcap_snaplen;
+  if (!parse_filters (gv, st))
+  {
+    free_pcap_state (st);
+    return;
+  }
+  if (gv->config.pcap_buffer_size > 0)
+  {
+    /* rounded down to a power of two, but large enough for a maximum-sized UDP datagram */
+    uint32_t size = 128 * 1024;
+    while (size <= gv->config.pcap_buffer_size / 2 && size < (PCAP_REC_SIZE_MASK + 1) / 2)
+      size *= 2;
+    st->ring = ddsrt_malloc (sizeof (*st->ring));
+    ddsrt_atomic_st32 (&st->ring->head, 0);
+    ddsrt_atomic_st32 (&st->ring->tail, 0);
+    st->ring->size = size;
+    st->ring->buf = ddsrt_calloc (1, size);
+  }
+  else
+  {
+    st->syncbuf = ddsrt_malloc (PCAP_SYNCBUF_SIZE);
+  }
+  if ((gv->pcap_fp = new_pcap_file (gv, gv->config.pcap_file, st->snaplen)) == NULL)
+  {
+    free_pcap_state (st);
+    return;
+  }
+  ddsrt_mutex_init (&gv->pcap_lock);
+  gv->pcap = st;
+  if (st->ring && create_thread (&st->ts, gv, "pcap", (uint32_t (*) (void *)) pcap_writer_thread, gv) != DDS_RETCODE_OK)
+  {
+    GVWARNING ("failed to create packet capture thread, capturing synchronously\n");
+    st->syncbuf = ddsrt_malloc (PCAP_SYNCBUF_SIZE);
+    ddsrt_free (st->ring->buf);
+    ddsrt_free (st->ring);
+    st->ring = NULL;
+  }
+}
+
+void pcap_fini (struct ddsi_domaingv *gv)
+{
+  struct pcap_state * const st = gv->pcap;
+  if (st == NULL)
+    return;
+  if (st->ring)
+  {
+    ddsrt_mutex_lock (&st->lock);
+    st->terminate = true;
+    ddsrt_cond_signal (&st->cond);
+    ddsrt_mutex_unlock (&st->lock);
+    join_thread (st->ts);
   }
+  GVLOG (DDS_LC_CONFIG, "packet capture: %"PRIu32" packets written, %"PRIu32" filtered, %"PRIu32" dropped\n",
+         ddsrt_atomic_ld32 (&st->n_captured), ddsrt_atomic_ld32 (&st->n_filtered), ddsrt_atomic_ld32 (&st->n_dropped));
+  free_pcap_state (st);
+  gv->pcap = NULL;
+  ddsrt_mutex_destroy (&gv->pcap_lock);
+  fclose (gv->pcap_fp);
+  gv->pcap_fp = NULL;
 }
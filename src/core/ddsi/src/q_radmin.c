@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <string.h>
 
 #if HAVE_VALGRIND && ! defined (NDEBUG)
 #include <memcheck.h>
@@ -42,6 +43,17 @@
 #include "dds/ddsi/q_bitset.h"
 #include "dds/ddsi/q_thread.h"
 #include "dds/ddsi/ddsi_domaingv.h" /* for mattr, cattr */
+#include "dds/ddsi/ddsi_latency_stats.h"
+
+#if defined (__linux)
+#include <stdio.h>
+#include <sys/mman.h>
+#define RBUF_ARENA_MMAP 1
+/* huge page size to assume if the system doesn't say */
+#define RBUF_ARENA_DEFAULT_HUGEPAGE_SIZE ((size_t) 2 << 20)
+#else
+#define RBUF_ARENA_MMAP 0
+#endif
 
 /* OVERVIEW ------------------------------------------------------------
 
@@ -267,6 +279,12 @@
 
 /* RBUFPOOL ------------------------------------------------------------ */
 
+enum rbuf_arena_kind {
+  RBAK_HUGETLB, /* explicitly reserved huge pages */
+  RBAK_THP,     /* transparent huge pages requested, but no guarantee */
+  RBAK_HEAP     /* just one big block of memory */
+};
+
 struct nn_rbufpool {
   /* An rbuf pool is owned by a receive thread, and that thread is the
      only allocating rmsgs from the rbufs in the pool. Any thread may
@@ -286,6 +304,22 @@ struct nn_rbufpool {
   uint32_t max_rmsg_size;
   const struct ddsrt_log_cfg *logcfg;
   bool trace;
+
+  /* Optionally, rbufs are taken from a pre-faulted arena (backed by
+     huge pages where possible) rather than allocated and freed one
+     at a time, so that steady-state operation doesn't touch the heap
+     and needs fewer TLB entries.  The stack of free slots is
+     protected by "lock", the owner pops and any thread releasing the
+     last reference pushes.  When the arena is exhausted, rbufs are
+     allocated on the heap as usual. */
+  unsigned char *arena;
+  size_t arena_size;
+  enum rbuf_arena_kind arena_kind;
+  uint32_t arena_nslots;
+  uint32_t arena_nfree;
+  struct nn_rbuf **arena_free;
+  uint64_t n_arena_allocs;
+  uint64_t n_heap_allocs;
 #ifndef NDEBUG
   /* Thread that owns this pool, so we can check that no other thread
      is calling functions only the owner may use. */
@@ -293,6 +327,8 @@ struct nn_rbufpool {
 #endif
 };
 
+static void nn_rbufpool_init_arena (struct nn_rbufpool *rbp, uint32_t arena_size);
+static void nn_rbufpool_fini_arena (struct nn_rbufpool *rbp);
 static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp);
 static void nn_rbuf_release (struct nn_rbuf *rbuf);
 
@@ -336,7 +372,7 @@ static uint32_t max_rmsg_size_w_hdr (uint32_t max_rmsg_size)
     + max_rmsg_size;
 }
 
-struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size)
+struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_t rbuf_size, uint32_t max_rmsg_size, uint32_t arena_size)
 {
   struct nn_rbufpool *rbp;
 
@@ -366,11 +402,13 @@ struct nn_rbufpool *nn_rbufpool_new (const struct ddsrt_log_cfg *logcfg, uint32_
   VALGRIND_CREATE_MEMPOOL (rbp, 0, 0);
 #endif
 
+  nn_rbufpool_init_arena (rbp, arena_size);
   if ((rbp->current = nn_rbuf_alloc_new (rbp)) == NULL)
     goto fail_rbuf;
   return rbp;
 
  fail_rbuf:
+  nn_rbufpool_fini_arena (rbp);
 #if USE_VALGRIND
   VALGRIND_DESTROY_MEMPOOL (rbp);
 #endif
@@ -387,6 +425,14 @@ void nn_rbufpool_setowner (UNUSED_ARG_NDEBUG (struct nn_rbufpool *rbp), UNUSED_A
 #endif
 }
 
+void nn_rbufpool_get_stats (const struct nn_rbufpool *rbp, struct nn_rbufpool_stats *st)
+{
+  ASSERT_RBUFPOOL_OWNER (rbp);
+  st->arena_size = rbp->arena_size;
+  st->n_arena_allocs = rbp->n_arena_allocs;
+  st->n_heap_allocs = rbp->n_heap_allocs;
+}
+
 void nn_rbufpool_free (struct nn_rbufpool *rbp)
 {
 #if 0
@@ -397,6 +443,10 @@ void nn_rbufpool_free (struct nn_rbufpool *rbp)
   ASSERT_RBUFPOOL_OWNER (rbp);
 #endif
   nn_rbuf_release (rbp->current);
+  if (rbp->arena)
+    DDS_CLOG (DDS_LC_CONFIG, rbp->logcfg, "rbufpool %p: %"PRIu64" buffers taken from arena, %"PRIu64" allocated on heap\n",
+              (void *) rbp, rbp->n_arena_allocs, rbp->n_heap_allocs);
+  nn_rbufpool_fini_arena (rbp);
 #if USE_VALGRIND
   VALGRIND_DESTROY_MEMPOOL (rbp);
 #endif
@@ -430,13 +480,157 @@ struct nn_rbuf {
   unsigned char raw[];
 };
 
+static uint32_t rbuf_arena_slot_size (const struct nn_rbufpool *rbp)
+{
+  return (uint32_t) ((sizeof (struct nn_rbuf) + rbp->rbuf_size + 63) & ~(size_t) 63);
+}
+
+#if RBUF_ARENA_MMAP
+static size_t rbuf_arena_hugepage_size (void)
+{
+  /* The default huge page size is what MAP_HUGETLB uses, and on all common
+     platforms it is also the size of a transparent huge page */
+  size_t size = 0;
+  FILE *fp;
+  if ((fp = fopen ("/proc/meminfo", "r")) != NULL)
+  {
+    char line[128];
+    unsigned long kb;
+    while (size == 0 && fgets (line, sizeof (line), fp) != NULL)
+    {
+      if (sscanf (line, "Hugepagesize: %lu kB", &kb) == 1)
+        size = (size_t) kb * 1024;
+    }
+    fclose (fp);
+  }
+  if (size == 0 || (size & (size - 1)) != 0)
+    size = RBUF_ARENA_DEFAULT_HUGEPAGE_SIZE;
+  return size;
+}
+
+static unsigned char *rbuf_arena_map (size_t size, size_t hpsize, enum rbuf_arena_kind *kind)
+{
+  /* Explicitly reserved huge pages are best, but often none have been
+     configured, in which case it falls back to a huge page-aligned
+     ordinary mapping that is marked as eligible for transparent huge
+     pages and then pre-faulted by touching it.  An arena smaller than
+     a huge page (hpsize = 0) gets an ordinary mapping. */
+  unsigned char *p;
+#ifdef MAP_HUGETLB
+  if (hpsize > 0 && (p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0)) != MAP_FAILED)
+  {
+    *kind = RBAK_HUGETLB;
+    return p;
+  }
+#endif
+  if ((p = mmap (NULL, size + hpsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    return NULL;
+  if (hpsize > 0)
+  {
+    const size_t head = (hpsize - (uintptr_t) p % hpsize) % hpsize;
+    if (head > 0)
+      (void) munmap (p, head);
+    (void) munmap (p + head + size, hpsize - head);
+    p += head;
+  }
+#ifdef MADV_HUGEPAGE
+  (void) madvise (p, size, MADV_HUGEPAGE);
+#endif
+  memset (p, 0, size);
+  *kind = RBAK_THP;
+  return p;
+}
+#endif
+
+static void nn_rbufpool_init_arena (struct nn_rbufpool *rbp, uint32_t arena_size)
+{
+  static const char *kindstr[] = { "huge pages", "transparent huge pages", "heap" };
+  const uint32_t slot_size = rbuf_arena_slot_size (rbp);
+  size_t size = arena_size - arena_size % slot_size;
+  rbp->arena = NULL;
+  rbp->arena_size = 0;
+  rbp->arena_nslots = rbp->arena_nfree = 0;
+  rbp->arena_free = NULL;
+  rbp->n_arena_allocs = rbp->n_heap_allocs = 0;
+  if (arena_size == 0)
+    return;
+  else if (size == 0)
+  {
+    DDS_CWARNING (rbp->logcfg, "rbufpool %p: arena of %"PRIu32" bytes too small for a receive buffer of %"PRIu32" bytes\n", (void *) rbp, arena_size, slot_size);
+    return;
+  }
+
+#if RBUF_ARENA_MMAP
+  /* no point in leaving part of the last huge page unused, but rounding up a
+     small arena to a (possibly 1GB) huge page would waste most of it */
+  size_t hpsize = rbuf_arena_hugepage_size ();
+  if (hpsize <= size)
+    size = (size + hpsize - 1) & ~(hpsize - 1);
+  else
+    hpsize = 0;
+  rbp->arena = rbuf_arena_map (size, hpsize, &rbp->arena_kind);
+#else
+  if ((rbp->arena = ddsrt_malloc_s (size)) != NULL)
+  {
+    memset (rbp->arena, 0, size);
+    rbp->arena_kind = RBAK_HEAP;
+  }
+#endif
+  if (rbp->arena == NULL)
+  {
+    DDS_CWARNING (rbp->logcfg, "rbufpool %p: failed to allocate arena of %"PRIuSIZE" bytes, using heap\n", (void *) rbp, size);
+    return;
+  }
+  rbp->arena_size = size;
+  rbp->arena_nslots = (uint32_t) (size / slot_size);
+  rbp->arena_free = ddsrt_malloc (rbp->arena_nslots * sizeof (*rbp->arena_free));
+  /* slots in reverse order, so that they get used in address order */
+  for (uint32_t i = 0; i < rbp->arena_nslots; i++)
+    rbp->arena_free[i] = (struct nn_rbuf *) (rbp->arena + (size_t) (rbp->arena_nslots - 1 - i) * slot_size);
+  rbp->arena_nfree = rbp->arena_nslots;
+  DDS_CLOG (DDS_LC_CONFIG, rbp->logcfg, "rbufpool %p: arena of %"PRIu32" receive buffers (%"PRIuSIZE" bytes) using %s\n",
+            (void *) rbp, rbp->arena_nslots, size, kindstr[rbp->arena_kind]);
+}
+
+static void nn_rbufpool_fini_arena (struct nn_rbufpool *rbp)
+{
+  if (rbp->arena == NULL)
+    return;
+  /* all rbufs must have been released, else unmapping the arena pulls
+     the rug from under the remaining ones */
+  assert (rbp->arena_nfree == rbp->arena_nslots);
+#if RBUF_ARENA_MMAP
+  (void) munmap (rbp->arena, rbp->arena_size);
+#else
+  ddsrt_free (rbp->arena);
+#endif
+  ddsrt_free (rbp->arena_free);
+}
+
+static bool nn_rbuf_in_arena (const struct nn_rbufpool *rbp, const struct nn_rbuf *rbuf)
+{
+  const uintptr_t a = (uintptr_t) rbp->arena, x = (uintptr_t) rbuf;
+  return rbp->arena != NULL && x >= a && x < a + rbp->arena_size;
+}
+
 static struct nn_rbuf *nn_rbuf_alloc_new (struct nn_rbufpool *rbp)
 {
-  struct nn_rbuf *rb;
+  struct nn_rbuf *rb = NULL;
   ASSERT_RBUFPOOL_OWNER (rbp);
 
-  if ((rb = ddsrt_malloc (sizeof (struct nn_rbuf) + rbp->rbuf_size)) == NULL)
+  if (rbp->arena)
+  {
+    ddsrt_mutex_lock (&rbp->lock);
+    if (rbp->arena_nfree > 0)
+      rb = rbp->arena_free[--rbp->arena_nfree];
+    ddsrt_mutex_unlock (&rbp->lock);
+  }
+  if (rb != NULL)
+    rbp->n_arena_allocs++;
+  else if ((rb = ddsrt_malloc (sizeof (struct nn_rbuf) + rbp->rbuf_size)) == NULL)
     return NULL;
+  else
+    rbp->n_heap_allocs++;
 #if USE_VALGRIND
   VALGRIND_MAKE_MEM_NOACCESS (rb->raw, rbp->rbuf_size);
 #endif
@@ -458,10 +652,13 @@ static struct nn_rbuf *nn_rbuf_new (struct nn_rbufpool *rbp)
   ASSERT_RBUFPOOL_OWNER (rbp);
   if ((rb = nn_rbuf_alloc_new (rbp)) != NULL)
   {
+    struct nn_rbuf *old;
     ddsrt_mutex_lock (&rbp->lock);
-    nn_rbuf_release (rbp->current);
+    old = rbp->current;
     rbp->current = rb;
     ddsrt_mutex_unlock (&rbp->lock);
+    /* releasing may return it to the arena, which requires the lock */
+    nn_rbuf_release (old);
   }
   return rb;
 }
@@ -473,7 +670,15 @@ static void nn_rbuf_release (struct nn_rbuf *rbuf)
   if (ddsrt_atomic_dec32_ov (&rbuf->n_live_rmsg_chunks) == 1)
   {
     RBPTRACE ("rbuf_release(%p) free\n", (void *) rbuf);
-    ddsrt_free (rbuf);
+    if (!nn_rbuf_in_arena (rbp, rbuf))
+      ddsrt_free (rbuf);
+    else
+    {
+      ddsrt_mutex_lock (&rbp->lock);
+      assert (rbp->arena_nfree < rbp->arena_nslots);
+      rbp->arena_free[rbp->arena_nfree++] = rbuf;
+      ddsrt_mutex_unlock (&rbp->lock);
+    }
   }
 }
 
@@ -547,6 +752,9 @@ struct nn_rmsg *nn_rmsg_new (struct nn_rbufpool *rbp)
   init_rmsg_chunk (&rmsg->chunk, rbp->current);
   rmsg->trace = rbp->trace;
   rmsg->lastchunk = &rmsg->chunk;
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  rmsg->tlat = 0;
+#endif
   /* Incrementing freeptr happens in commit(), so that discarding the
      message is really simple. */
   RBPTRACE ("rmsg_new(%p) = %p\n", (void *) rbp, (void *) rmsg);
@@ -2460,6 +2668,10 @@ static uint32_t dqueue_thread (struct nn_dqueue *q)
       switch (dqueue_elem_kind (e))
       {
         case DQEK_DATA:
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+          if (e->sampleinfo->tlat != 0)
+            e->sampleinfo->tlat = ddsi_latency_stats_lap (DDSI_LATENCY_DQUEUE, e->sampleinfo->tlat);
+#endif
           ret = q->handler (e->sampleinfo, e->fragchain, prdguid, q->handler_arg);
           (void) ret; /* eliminate set-but-not-used in NDEBUG case */
           assert (ret == 0); /* so every handler will return 0 */
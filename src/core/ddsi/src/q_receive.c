@@ -54,6 +54,8 @@
 #include "dds/ddsi/ddsi_mcgroup.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_serdata_default.h" /* FIXME: get rid of this */
+#include "dds/ddsi/ddsi_rxfilter.h"
+#include "dds/ddsi/ddsi_latency_stats.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -718,6 +720,30 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
     }
   }
 
+  /* Round-trip time to this reader: the time from transmitting the writer's
+     probe sample until the reader first acknowledges it */
+  if (wr->rtt_probe_seq != 0 && rn->seq < wr->rtt_probe_seq && seqbase - 1 >= wr->rtt_probe_seq)
+    nn_lat_estim_update (&rn->rtt, ddsrt_time_monotonic ().v - wr->rtt_probe_t.v);
+
+  /* Congestion control: a NACK from a reader that is in sync means data
+     got lost, an ACK of new data that the current rate is sustainable */
+  if (wr->rate_controlled)
+  {
+    const ddsrt_mtime_t tnow_mt = ddsrt_time_monotonic ();
+    const dds_duration_t rtt = (dds_duration_t) (nn_lat_estim_current (&rn->rtt) * 1e3);
+    bool rate_changed;
+    if (is_pure_ack)
+      rate_changed = ddsi_ratecontrol_ack (&wr->ratecontrol, seqbase - 1 > rn->seq, rtt, tnow_mt);
+    else
+      rate_changed = rn->assumed_in_sync && ddsi_ratecontrol_loss (&wr->ratecontrol, rtt, tnow_mt);
+    if (rate_changed)
+    {
+      RSTTRACE (" rate %.0f", ddsi_ratecontrol_rate (&wr->ratecontrol));
+      if (wr->throttling)
+        ddsrt_cond_broadcast (&wr->throttle_cond);
+    }
+  }
+
   /* First, the ACK part: if the AckNack advances the highest sequence
      number ack'd by the remote reader, update state & try dropping
      some messages */
@@ -732,6 +758,8 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
       rn->seq = wr->seq;
     }
     ddsrt_avl_augment_update (&wr_readers_treedef, rn);
+    if (wr->rtt_probe_seq != 0 && ((struct wr_prd_match *) ddsrt_avl_root (&wr_readers_treedef, &wr->readers))->min_seq >= wr->rtt_probe_seq)
+      wr->rtt_probe_seq = 0;
     n = remove_acked_messages (wr, &whcst, &deferred_free_list);
     RSTTRACE (" ACK%"PRId64" RM%u", n_ack, n);
   }
@@ -839,6 +867,18 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
   seq_xmit = writer_read_seq_xmit (wr);
   const bool gap_for_already_acked = vendor_is_eclipse (rst->vendor) && prd->c.xqos->durability.kind == DDS_DURABILITY_VOLATILE && seqbase <= rn->seq;
   const seqno_t min_seq_to_rexmit = gap_for_already_acked ? rn->seq + 1 : 0;
+  /* While the history is being streamed to this reader, requests for samples
+     not yet streamed are served like any other, and the stream then skips the
+     leading part of what remains that this reply takes care of: everything
+     below seqbase has been acknowledged, the rest in order up to the first
+     sample that couldn't be queued */
+  seqno_t hist_next_seq = rn->hist_next_seq;
+  if (hist_next_seq > 0)
+  {
+    RSTTRACE (" streaming %"PRId64"..%"PRId64, rn->hist_next_seq, rn->hist_max_seq);
+    if (seqbase > hist_next_seq)
+      hist_next_seq = seqbase;
+  }
   for (uint32_t i = 0; i < numbits && seqbase + i <= seq_xmit && enqueued; i++)
   {
     /* Accelerated schedule may run ahead of sequence number set
@@ -851,10 +891,24 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
       struct whc_borrowed_sample sample;
       if (seqbase + i >= min_seq_to_rexmit && whc_borrow_sample (wr->whc, seq, &sample))
       {
+        rn->nacked_bytes += ddsi_serdata_size (sample.serdata);
         if (!wr->retransmitting && sample.unacked)
           writer_set_retransmitting (wr);
 
-        if (rst->gv->config.retransmit_merging != REXMIT_MERGE_NEVER && rn->assumed_in_sync)
+        if (wr->rexmit_xevent)
+        {
+          /* leave it to the retransmit scheduler, which combines it with
+             the requests from other readers */
+          RSTTRACE (" RX%"PRId64" (sched)", seqbase + i);
+          enqueued = writer_rexmit_request_wrlock_held (wr, prd, seq, ddsi_serdata_size (sample.serdata), 0, 0, NULL);
+          if (enqueued)
+          {
+            max_seq_in_reply = seqbase + i;
+            msgs_sent++;
+            rn->rexmit_count++;
+          }
+        }
+        else if (rst->gv->config.retransmit_merging != REXMIT_MERGE_NEVER && rn->assumed_in_sync)
         {
           /* send retransmit to all receivers, but skip if recently done */
           ddsrt_mtime_t tstamp = ddsrt_time_monotonic ();
@@ -866,6 +920,7 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
             {
               max_seq_in_reply = seqbase + i;
               msgs_sent++;
+              rn->rexmit_count++;
               sample.last_rexmit_ts = tstamp;
             }
           }
@@ -883,6 +938,7 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
           {
             max_seq_in_reply = seqbase + i;
             msgs_sent++;
+            rn->rexmit_count++;
             sample.rexmit_count++;
           }
         }
@@ -911,9 +967,18 @@ static int handle_AckNack (struct receiver_state *rst, ddsrt_etime_t tnow, const
         msgs_lost++;
       }
     }
+    if (enqueued && seqbase + i == hist_next_seq)
+      hist_next_seq++;
   }
   if (!enqueued)
     RSTTRACE (" rexmit-limit-hit");
+  if (hist_next_seq > rn->hist_next_seq && rn->hist_next_seq > 0)
+  {
+    /* if this reply covers all of it, the stream is done without its final
+       heartbeat: losses are then recovered like those of any retransmit */
+    rn->hist_next_seq = (hist_next_seq > rn->hist_max_seq) ? 0 : hist_next_seq;
+    RSTTRACE (" stream-next %"PRId64, rn->hist_next_seq);
+  }
   /* Generate a Gap message if some of the sequence is missing */
   if (gapstart > 0)
   {
@@ -1423,24 +1488,52 @@ static int handle_NackFrag (struct receiver_state *rst, ddsrt_etime_t tnow, cons
     goto out;
   }
   rn->next_nackfrag = *countp + 1;
+  rn->rexmit_frag_requests++;
   RSTTRACE (" "PGUIDFMT" -> "PGUIDFMT"", PGUID (src), PGUID (dst));
+  if (wr->rate_controlled && rn->assumed_in_sync && ddsi_ratecontrol_loss (&wr->ratecontrol, (dds_duration_t) (nn_lat_estim_current (&rn->rtt) * 1e3), ddsrt_time_monotonic ()))
+    RSTTRACE (" rate %.0f", ddsi_ratecontrol_rate (&wr->ratecontrol));
 
   /* Resend the requested fragments if we still have the sample, send
      a Gap if we don't have them anymore. */
   if (whc_borrow_sample (wr->whc, seq, &sample))
   {
     const unsigned base = msg->fragmentNumberState.bitmap_base - 1;
+    const uint32_t size = ddsi_serdata_size (sample.serdata);
+    const uint32_t fragsize = rst->gv->config.fragment_size;
+    uint32_t nfrags = 0;
     int enqueued = 1;
     RSTTRACE (" scheduling requested frags ...\n");
-    for (uint32_t i = 0; i < msg->fragmentNumberState.numbits && enqueued; i++)
+    for (uint32_t i = 0; i < msg->fragmentNumberState.numbits; i++)
     {
-      if (nn_bitset_isset (msg->fragmentNumberState.numbits, msg->bits, i))
+      if (nn_bitset_isset (msg->fragmentNumberState.numbits, msg->bits, i) && (base + i) * fragsize < size)
       {
-        struct nn_xmsg *reply;
-        if (create_fragment_message (wr, seq, sample.plist, sample.serdata, base + i, prd, &reply, 0) < 0)
-          enqueued = 0;
-        else
-          enqueued = qxev_msg_rexmit_wrlock_held (wr->evq, reply, 0);
+        const uint32_t off = (base + i) * fragsize;
+        rn->nacked_bytes += (size - off < fragsize) ? size - off : fragsize;
+        nfrags++;
+      }
+    }
+    if (wr->rexmit_xevent)
+    {
+      /* the scheduler deduplicates and combines consecutive fragments */
+      if (writer_rexmit_request_wrlock_held (wr, prd, seq, size, base, msg->fragmentNumberState.numbits, msg->bits))
+        rn->rexmit_count += nfrags;
+    }
+    else
+    {
+      for (uint32_t i = 0; i < msg->fragmentNumberState.numbits && enqueued; i++)
+      {
+        if (nn_bitset_isset (msg->fragmentNumberState.numbits, msg->bits, i))
+        {
+          struct nn_xmsg *reply;
+          if (create_fragment_message (wr, seq, sample.plist, sample.serdata, base + i, prd, &reply, 0) < 0)
+            enqueued = 0;
+          else if ((enqueued = qxev_msg_rexmit_wrlock_held (wr->evq, reply, 0)) != 0)
+          {
+            rn->rexmit_count++;
+            if (wr->rate_controlled)
+              ddsi_ratecontrol_consume (&wr->ratecontrol, rst->gv->config.fragment_size);
+          }
+        }
       }
     }
     whc_return_sample (wr->whc, &sample, false);
@@ -1904,6 +1997,27 @@ static dds_return_t remote_on_delivery_failure_fastpath (struct entity_common *s
   return DDS_RETCODE_TRY_AGAIN;
 }
 
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+static void latency_stats_receive (struct nn_rsample_info *sampleinfo, const struct nn_rmsg *rmsg)
+{
+  /* only application data is of interest; rmsg->tlat is 0 if not enabled */
+  struct proxy_writer const * const pwr = sampleinfo->pwr;
+  if (rmsg->tlat != 0 && pwr != NULL && !is_builtin_entityid (pwr->e.guid.entityid, pwr->c.vendor))
+    sampleinfo->tlat = ddsi_latency_stats_lap (DDSI_LATENCY_RECEIVE, rmsg->tlat);
+  else
+    sampleinfo->tlat = 0;
+}
+
+static void latency_stats_defrag (const struct nn_rsample_chain *sc)
+{
+  /* samples in the chain are complete and in order, what remains is delivery;
+     gaps have no sampleinfo */
+  for (struct nn_rsample_chain_elem *e = sc->first; e; e = e->next)
+    if (e->sampleinfo != NULL && e->sampleinfo->tlat != 0)
+      e->sampleinfo->tlat = ddsi_latency_stats_lap (DDSI_LATENCY_DEFRAG, e->sampleinfo->tlat);
+}
+#endif
+
 static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const struct nn_rdata *fragchain, const ddsi_guid_t *rdguid, int pwr_locked)
 {
   static const struct deliver_locally_ops deliver_locally_ops = {
@@ -1984,6 +2098,8 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
   const ddsrt_wctime_t tstamp = (sampleinfo->timestamp.v != DDSRT_WCTIME_INVALID.v) ? sampleinfo->timestamp : ((ddsrt_wctime_t) {0});
   struct ddsi_writer_info wrinfo;
   ddsi_make_writer_info (&wrinfo, &pwr->e, pwr->c.xqos, statusinfo);
+  if (qos.present & PP_COHERENT_SET)
+    wrinfo.coherent_set_seq = fromSN (qos.coherent_set_seqno);
 
   struct remote_sourceinfo sourceinfo = {
     .sampleinfo = sampleinfo,
@@ -1993,7 +2109,14 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
     .statusinfo = statusinfo,
     .tstamp = tstamp
   };
-  if (rdguid)
+  if (wrinfo.coherent_set_seq != 0 && statusinfo == 0 && !(data_smhdr_flags & (DATA_FLAG_KEYFLAG | DATA_FLAG_DATAFLAG)))
+  {
+    /* No payload but a coherent set: that's the writer committing the set */
+    deliver_locally_commit (gv, &pwr->e, pwr_locked != 0, rdguid, &pwr->rdary, &wrinfo, &deliver_locally_ops);
+    if (rdguid == NULL)
+      ddsrt_atomic_st32 (&pwr->next_deliv_seq_lowword, (uint32_t) (sampleinfo->seq + 1));
+  }
+  else if (rdguid)
     (void) deliver_locally_one (gv, &pwr->e, pwr_locked != 0, rdguid, &wrinfo, &deliver_locally_ops, &sourceinfo);
   else
   {
@@ -2001,6 +2124,10 @@ static int deliver_user_data (const struct nn_rsample_info *sampleinfo, const st
     ddsrt_atomic_st32 (&pwr->next_deliv_seq_lowword, (uint32_t) (sampleinfo->seq + 1));
   }
 
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  if (sampleinfo->tlat != 0)
+    (void) ddsi_latency_stats_lap (DDSI_LATENCY_RHC_INSERT, sampleinfo->tlat);
+#endif
   ddsi_plist_fini (&qos);
   return 0;
 }
@@ -2158,6 +2285,9 @@ static void handle_regular (struct receiver_state *rst, ddsrt_etime_t tnow, stru
 
     if (rres > 0)
     {
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+      latency_stats_defrag (&sc);
+#endif
       /* Enqueue or deliver with pwr->e.lock held: to ensure no other
          receive thread's data gets interleaved -- arguably delivery
          needn't be exactly in-order, which would allow us to do this
@@ -2577,6 +2707,36 @@ static struct receiver_state *rst_cow_if_needed (int *rst_live, struct nn_rmsg *
   }
 }
 
+static bool data_passes_rxfilter (const struct receiver_state *rst, ddsrt_etime_t tnow, const Data_DataFrag_common_t *msg, size_t size)
+{
+  /* Drops data from application writers without local readers before anything gets
+     parsed or allocated.  Anything too short to contain the writer id is left to the
+     validation to complain about, and the built-in writers are never filtered: SPDP
+     is accepted from unknown sources and the others carry little traffic. */
+  ddsi_guid_t pwr_guid, ppguid;
+  struct proxy_participant *proxypp;
+  struct lease *lease;
+  if (size < sizeof (*msg) || !rst->forme)
+    return true;
+  pwr_guid.entityid = nn_ntoh_entityid (msg->writerId);
+  if ((pwr_guid.entityid.u & NN_ENTITYID_SOURCE_MASK) == NN_ENTITYID_SOURCE_BUILTIN)
+    return true;
+  pwr_guid.prefix = rst->src_guid_prefix;
+  if (ddsi_rxfilter_accept (rst->gv->rxfilter, &pwr_guid))
+    return true;
+  RSTTRACE ("%s("PGUIDFMT": filtered)", (msg->smhdr.submessageId == SMID_DATA) ? "DATA" : "DATAFRAG", PGUID (pwr_guid));
+
+  /* The data still asserts the liveliness of the participant, like it does in
+     handle_regular.  Writers with a manual liveliness kind are never filtered, so
+     only the automatic lease needs renewing. */
+  ppguid.prefix = rst->src_guid_prefix;
+  ppguid.entityid.u = NN_ENTITYID_PARTICIPANT;
+  if ((proxypp = entidx_lookup_proxy_participant_guid (rst->gv->entity_index, &ppguid)) != NULL &&
+      (lease = ddsrt_atomic_ldvoidp (&proxypp->minl_auto)) != NULL)
+    lease_renew (lease, tnow);
+  return false;
+}
+
 static int handle_submsg_sequence
 (
   struct thread_state1 * const ts1,
@@ -2759,6 +2919,11 @@ static int handle_submsg_sequence
         break;
       case SMID_DATA_FRAG:
         state = "parse:datafrag";
+        if (!data_passes_rxfilter (rst, tnowE, &sm->datafrag.x, submsg_size))
+        {
+          ts_for_latmeas = 0;
+          break;
+        }
         {
           struct nn_rsample_info sampleinfo;
           unsigned char *datap;
@@ -2767,6 +2932,9 @@ static int handle_submsg_sequence
             goto malformed;
           sampleinfo.timestamp = timestamp;
           sampleinfo.reception_timestamp = tnowWC;
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+          latency_stats_receive (&sampleinfo, rmsg);
+#endif
           handle_DataFrag (rst, tnowE, rmsg, &sm->datafrag, submsg_size, &sampleinfo, datap, &deferred_wakeup);
           rst_live = 1;
           ts_for_latmeas = 0;
@@ -2774,6 +2942,11 @@ static int handle_submsg_sequence
         break;
       case SMID_DATA:
         state = "parse:data";
+        if (!data_passes_rxfilter (rst, tnowE, &sm->data.x, submsg_size))
+        {
+          ts_for_latmeas = 0;
+          break;
+        }
         {
           struct nn_rsample_info sampleinfo;
           unsigned char *datap;
@@ -2782,6 +2955,9 @@ static int handle_submsg_sequence
             goto malformed;
           sampleinfo.timestamp = timestamp;
           sampleinfo.reception_timestamp = tnowWC;
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+          latency_stats_receive (&sampleinfo, rmsg);
+#endif
           handle_Data (rst, tnowE, rmsg, &sm->data, submsg_size, &sampleinfo, datap, &deferred_wakeup);
           rst_live = 1;
           ts_for_latmeas = 0;
@@ -2945,6 +3121,10 @@ static bool do_packet (struct thread_state1 * const ts1, struct ddsi_domaingv *g
 
   if (sz > 0 && !gv->deaf)
   {
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+    if (gv->config.latency_stats)
+      rmsg->tlat = ddsrt_time_monotonic ().v;
+#endif
     nn_rmsg_setsize (rmsg, (uint32_t) sz);
     assert (thread_is_asleep ());
 
@@ -3115,8 +3295,16 @@ uint32_t listen_thread (struct ddsi_tran_listener *listener)
     conn = ddsi_listener_accept (listener);
     if (conn)
     {
-      os_sockWaitsetAdd (gv->recv_threads[0].arg.u.many.ws, conn);
-      os_sockWaitsetTrigger (gv->recv_threads[0].arg.u.many.ws);
+      /* the connection remains owned by the listener, without a waitset nothing
+         gets received on it but it can still be used for sending */
+      os_sockWaitset ws = recv_thread_waitset (gv);
+      if (ws == NULL)
+        GVWARNING ("listen_thread: no receive thread for accepted connections\n");
+      else
+      {
+        os_sockWaitsetAdd (ws, conn);
+        os_sockWaitsetTrigger (ws);
+      }
     }
   }
   return 0;
@@ -3136,6 +3324,15 @@ static int recv_thread_waitset_add_conn (os_sockWaitset ws, ddsi_tran_conn_t con
   }
 }
 
+struct os_sockWaitset *recv_thread_waitset (const struct ddsi_domaingv *gv)
+{
+  /* The first thread normally is the one, but don't rely on it */
+  for (uint32_t i = 0; i < gv->n_recv_threads; i++)
+    if (gv->recv_threads[i].arg.mode == RTM_MANY && gv->recv_threads[i].arg.u.many.ws != NULL)
+      return gv->recv_threads[i].arg.u.many.ws;
+  return NULL;
+}
+
 void trigger_recv_threads (const struct ddsi_domaingv *gv)
 {
   for (uint32_t i = 0; i < gv->n_recv_threads; i++)
@@ -3151,8 +3348,17 @@ void trigger_recv_threads (const struct ddsi_domaingv *gv)
         ddsrt_iovec_t iov;
         iov.iov_base = &dummy;
         iov.iov_len = 1;
-        GVTRACE ("trigger_recv_threads: %d single %s\n", i, ddsi_locator_to_string (buf, sizeof (buf), dst));
-        ddsi_conn_write (gv->xmit_conn, dst, 1, &iov, 0);
+        if (dst == NULL)
+        {
+          /* connections without an address (shared memory) can write to themselves */
+          GVTRACE ("trigger_recv_threads: %d single self\n", i);
+          ddsi_conn_write (gv->recv_threads[i].arg.u.single.conn, NULL, 1, &iov, 0);
+        }
+        else
+        {
+          GVTRACE ("trigger_recv_threads: %d single %s\n", i, ddsi_locator_to_string (buf, sizeof (buf), dst));
+          ddsi_conn_write (gv->xmit_conn, dst, 1, &iov, 0);
+        }
         break;
       }
       case RTM_MANY: {
@@ -3164,6 +3370,29 @@ void trigger_recv_threads (const struct ddsi_domaingv *gv)
   }
 }
 
+static bool recv_thread_busy_poll (struct ddsi_domaingv * const gv, ddsrt_socket_t sock)
+{
+  /* Spin on a non-blocking check for the socket becoming readable for at most the
+     configured budget; returns true if data arrived in that time, false if the caller
+     has to block in the read */
+  const ddsrt_mtime_t tend = ddsrt_mtime_add_duration (ddsrt_time_monotonic (), gv->config.recv_busy_poll);
+  do {
+    fd_set fds;
+    int32_t ready = 0;
+    FD_ZERO (&fds);
+#if LWIP_SOCKET == 1
+    DDSRT_WARNING_GNUC_OFF(sign-conversion)
+#endif
+    FD_SET (sock, &fds);
+#if LWIP_SOCKET == 1
+    DDSRT_WARNING_GNUC_ON(sign-conversion)
+#endif
+    if (ddsrt_select (sock + 1, &fds, NULL, NULL, 0, &ready) == DDS_RETCODE_OK && ready > 0)
+      return true;
+  } while (ddsrt_atomic_ld32 (&gv->rtps_keepgoing) && ddsrt_time_monotonic ().v < tend.v);
+  return false;
+}
+
 uint32_t recv_thread (void *vrecv_thread_arg)
 {
   struct thread_state1 * const ts1 = lookup_thread_state ();
@@ -3177,11 +3406,29 @@ uint32_t recv_thread (void *vrecv_thread_arg)
   if (waitset == NULL)
   {
     struct ddsi_tran_conn *conn = recv_thread_arg->u.single.conn;
+    const ddsrt_socket_t sock = ddsi_conn_handle (conn);
+    /* Busy-polling only makes sense for a thread dedicated to a single socket, and
+       is impossible for connections that don't have one (shared memory) */
+    bool busy_poll = (gv->config.recv_busy_poll > 0 && sock != DDSRT_INVALID_SOCKET);
+#ifndef _WIN32
+    busy_poll = busy_poll && sock < FD_SETSIZE;
+#endif
     while (ddsrt_atomic_ld32 (&gv->rtps_keepgoing))
     {
       LOG_THREAD_CPUTIME (&gv->logconfig, next_thread_cputime);
+      if (busy_poll)
+      {
+        /* only this thread updates them, the debug monitor reads them */
+        if (recv_thread_busy_poll (gv, sock))
+          ddsrt_atomic_inc64 (&recv_thread_arg->u.single.npoll_spin);
+        else
+          ddsrt_atomic_inc64 (&recv_thread_arg->u.single.npoll_block);
+      }
       (void) do_packet (ts1, gv, conn, NULL, rbpool);
     }
+    if (busy_poll)
+      GVLOG (DDS_LC_CONFIG, "busy-poll: %"PRIu64" packets received while spinning, %"PRIu64" after blocking\n",
+             ddsrt_atomic_ld64 (&recv_thread_arg->u.single.npoll_spin), ddsrt_atomic_ld64 (&recv_thread_arg->u.single.npoll_block));
   }
   else
   {
@@ -3244,8 +3491,13 @@ uint32_t recv_thread (void *vrecv_thread_arg)
             guid_prefix = NULL;
           else
             guid_prefix = &lps.ps[(unsigned)idx - num_fixed].guid_prefix;
-          /* Process message and clean out connection if failed or closed */
-          if (!do_packet (ts1, gv, conn, guid_prefix, rbpool) && !conn->m_connless)
+          /* Process message and clean out connection if failed or closed; a
+             stream connection may have read more than one message at once */
+          bool ok;
+          do
+            ok = do_packet (ts1, gv, conn, guid_prefix, rbpool);
+          while (ok && ddsi_conn_buffered (conn));
+          if (!ok && !conn->m_connless)
             ddsi_conn_free (conn);
         }
       }
@@ -60,6 +60,8 @@ struct entry {
   ddsi_tran_conn_t conn;
 };
 
+static int want_write_locked (os_sockWaitset ws, struct entry *entry);
+
 struct os_sockWaitset
 {
   int kqueue;
@@ -100,9 +102,18 @@ static int add_entry_locked (os_sockWaitset ws, ddsi_tran_conn_t conn, int fd)
   ws->entries[fidx].conn = conn;
   ws->entries[fidx].fd = fd;
   ws->entries[fidx].index = n;
+  if (conn && ddsi_conn_write_pending (conn))
+    (void) want_write_locked (ws, &ws->entries[fidx]);
   return 1;
 }
 
+static int want_write_locked (os_sockWaitset ws, struct entry *entry)
+{
+  struct kevent kev;
+  EV_SET (&kev, (unsigned)entry->fd, EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, entry);
+  return kevent (ws->kqueue, &kev, 1, NULL, 0, NULL);
+}
+
 os_sockWaitset os_sockWaitsetNew (void)
 {
   const uint32_t sz = WAITSET_DELTA;
@@ -227,11 +238,28 @@ void os_sockWaitsetRemove (os_sockWaitset ws, ddsi_tran_conn_t conn)
     EV_SET(&kev, (unsigned)ws->entries[i].fd, EVFILT_READ, EV_DELETE, 0, 0, 0);
     if (kevent(ws->kqueue, &kev, 1, NULL, 0, NULL) == -1)
       abort (); /* FIXME */
+    /* a write filter is only present while output is queued */
+    EV_SET(&kev, (unsigned)ws->entries[i].fd, EVFILT_WRITE, EV_DELETE, 0, 0, 0);
+    (void) kevent(ws->kqueue, &kev, 1, NULL, 0, NULL);
     ws->entries[i].fd = -1;
   }
   ddsrt_mutex_unlock (&ws->lock);
 }
 
+void os_sockWaitsetWantWrite (os_sockWaitset ws, ddsi_tran_conn_t conn)
+{
+  const int fd = ddsi_conn_handle (conn);
+  uint32_t i, sz;
+  ddsrt_mutex_lock (&ws->lock);
+  sz = ddsrt_atomic_ld32 (&ws->sz);
+  for (i = 1; i < sz; i++)
+    if (ws->entries[i].fd == fd && ws->entries[i].conn == conn)
+      break;
+  if (i < sz && want_write_locked (ws, &ws->entries[i]) == -1)
+    DDS_WARNING("os_sockWaitsetWantWrite: kevent failed, errno = %d\n", errno);
+  ddsrt_mutex_unlock (&ws->lock);
+}
+
 os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws)
 {
   /* if the array of events is smaller than the number of file descriptors in the
@@ -266,7 +294,11 @@ int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, ddsi_tran_conn_t *conn)
   {
     uint32_t idx = ctx->index++;
     struct entry * const entry = ctx->evs[idx].udata;
-    if (entry->index > 0)
+    if (entry->index > 0 && ctx->evs[idx].filter == EVFILT_WRITE)
+    {
+      ddsi_conn_flush (entry->conn);
+    }
+    else if (entry->index > 0)
     {
       *conn = entry->conn;
       return (int)(entry->index - 1);
@@ -354,6 +386,14 @@ void os_sockWaitsetRemove (os_sockWaitset ws, ddsi_tran_conn_t conn)
   ddsrt_mutex_unlock (&ws->mutex);
 }
 
+void os_sockWaitsetWantWrite (os_sockWaitset ws, ddsi_tran_conn_t conn)
+{
+  /* FD_WRITE is only signalled after a send failed with WSAEWOULDBLOCK,
+     which is precisely the condition under which output gets queued */
+  (void) ws;
+  (void) conn;
+}
+
 void os_sockWaitsetTrigger (os_sockWaitset ws)
 {
   if (! WSASetEvent (ws->ctx.events[0]))
@@ -385,7 +425,7 @@ int os_sockWaitsetAdd (os_sockWaitset ws, ddsi_tran_conn_t conn)
       ret = -1;
     else
     {
-      if (WSAEventSelect (sock, ev, FD_READ) == SOCKET_ERROR)
+      if (WSAEventSelect (sock, ev, FD_READ | FD_WRITE) == SOCKET_ERROR)
       {
         DDS_WARNING("os_sockWaitsetAdd: WSAEventSelect(%x,%x) failed, error %d\n", (os_uint32) sock, (os_uint32) ev, os_getErrno ());
         WSACloseEvent (ev);
@@ -488,6 +528,10 @@ int os_sockWaitsetNextEvent (os_sockWaitsetCtx ctx, ddsi_tran_conn_t * conn)
       return -1;
     }
 
+    if (nwev.lNetworkEvents & FD_WRITE)
+      ddsi_conn_flush (ctx->conns[idx]);
+    if (!(nwev.lNetworkEvents & FD_READ))
+      return -1;
     *conn = ctx->conns[idx];
     return idx - 1;
   }
@@ -533,6 +577,7 @@ struct os_sockWaitsetCtx
   os_sockWaitsetSet set;     /* set of connections and descriptors */
   unsigned index;            /* cursor for enumerating */
   fd_set rdset;              /* read file descriptors */
+  fd_set wrset;              /* write file descriptors (queued output) */
 };
 
 struct os_sockWaitset
@@ -628,6 +673,7 @@ static void os_sockWaitsetNewCtx (os_sockWaitsetCtx ctx)
 {
   os_sockWaitsetNewSet (&ctx->set);
   FD_ZERO (&ctx->rdset);
+  FD_ZERO (&ctx->wrset);
 }
 
 static void os_sockWaitsetFreeCtx (os_sockWaitsetCtx ctx)
@@ -811,12 +857,22 @@ void os_sockWaitsetRemove (os_sockWaitset ws, ddsi_tran_conn_t conn)
   ddsrt_mutex_unlock (&ws->mutex);
 }
 
+void os_sockWaitsetWantWrite (os_sockWaitset ws, ddsi_tran_conn_t conn)
+{
+  /* The write set is recomputed from the connections' pending flags on
+     every call to os_sockWaitsetWait, so a trigger suffices */
+  (void) conn;
+  os_sockWaitsetTrigger (ws);
+}
+
 os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws)
 {
   int32_t n = -1;
   unsigned u;
   int fdmax;
+  bool want_write = false;
   fd_set * rdset = NULL;
+  fd_set * wrset = NULL;
   os_sockWaitsetCtx ctx = &ws->ctx;
   os_sockWaitsetSet * dst = &ctx->set;
   os_sockWaitsetSet * src = &ws->set;
@@ -859,9 +915,27 @@ os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws)
   }
 #endif /* LWIP_SOCKET */
 
+  /* Connections with queued output also wait for writability */
+  wrset = &ctx->wrset;
+  FD_ZERO (wrset);
+  for (u = 1; u < dst->n; u++)
+  {
+    if (dst->conns[u] && ddsi_conn_write_pending (dst->conns[u]))
+    {
+#if defined(LWIP_SOCKET)
+      DDSRT_WARNING_GNUC_OFF(sign-conversion)
+#endif
+      FD_SET (dst->fds[u], wrset);
+#if defined(LWIP_SOCKET)
+      DDSRT_WARNING_GNUC_ON(sign-conversion)
+#endif
+      want_write = true;
+    }
+  }
+
   do
   {
-    dds_return_t rc = ddsrt_select (fdmax, rdset, NULL, NULL, DDS_INFINITY, &n);
+    dds_return_t rc = ddsrt_select (fdmax, rdset, want_write ? wrset : NULL, NULL, DDS_INFINITY, &n);
     if (rc != DDS_RETCODE_OK && rc != DDS_RETCODE_INTERRUPTED && rc != DDS_RETCODE_TRY_AGAIN)
     {
       DDS_WARNING("os_sockWaitsetWait: select failed, retcode = %"PRId32, rc);
@@ -874,6 +948,20 @@ os_sockWaitsetCtx os_sockWaitsetWait (os_sockWaitset ws)
   {
     /* this simply skips the trigger fd */
     ctx->index = 1;
+    if (want_write)
+    {
+      for (u = 1; u < dst->n; u++)
+      {
+#if defined(LWIP_SOCKET)
+        DDSRT_WARNING_GNUC_OFF(sign-conversion)
+#endif
+        if (FD_ISSET (dst->fds[u], wrset))
+          ddsi_conn_flush (dst->conns[u]);
+#if defined(LWIP_SOCKET)
+        DDSRT_WARNING_GNUC_ON(sign-conversion)
+#endif
+      }
+    }
 #if ! defined(LWIP_SOCKET)
     if (FD_ISSET (dst->fds[0], rdset))
     {
@@ -27,6 +27,9 @@
 #include "dds/ddsi/q_config.h"
 #include "dds/ddsi/ddsi_domaingv.h"
 #include "dds/ddsi/sysdeps.h"
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+#include "dds/ddsi/ddsi_latency_stats.h"
+#endif
 
 struct thread_states thread_states;
 ddsrt_thread_local struct thread_state1 *tsd_thread_state;
@@ -152,6 +155,9 @@ bool thread_states_fini (void)
   if (others == 0)
   {
     ddsrt_mutex_destroy (&thread_states.lock);
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+    ddsi_latency_stats_fini ();
+#endif
     ddsrt_free_aligned (thread_states.ts);
     thread_states.ts = NULL;
     return true;
@@ -336,6 +342,9 @@ static void reap_thread_state (struct thread_state1 *ts1)
     case THREAD_STATE_INIT:
     case THREAD_STATE_STOPPED:
     case THREAD_STATE_LAZILY_CREATED:
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+      ddsi_latency_stats_retire (ts1);
+#endif
       ts1->state = THREAD_STATE_ZERO;
       break;
     case THREAD_STATE_ZERO:
@@ -31,10 +31,12 @@
 #include "dds/ddsi/q_entity.h"
 #include "dds/ddsi/q_unused.h"
 #include "dds/ddsi/q_hbcontrol.h"
+#include "dds/ddsi/q_bitset.h"
 #include "dds/ddsi/q_lease.h"
 #include "dds/ddsi/ddsi_tkmap.h"
 #include "dds/ddsi/ddsi_serdata.h"
 #include "dds/ddsi/ddsi_sertopic.h"
+#include "dds/ddsi/ddsi_latency_stats.h"
 
 #include "dds/ddsi/sysdeps.h"
 #include "dds__whc.h"
@@ -460,15 +462,14 @@ static dds_return_t create_fragment_message_simple (struct writer *wr, seqno_t s
   return 0;
 }
 
-dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, struct proxy_reader *prd, struct nn_xmsg **pmsg, int isnew)
+static dds_return_t create_fragment_message_nfrags (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, uint16_t nfrags, struct proxy_reader *prd, struct nn_xmsg **pmsg, int isnew)
 {
   /* We always fragment into FRAGMENT_SIZEd fragments, which are near
-     the smallest allowed fragment size & can't be bothered (yet) to
-     put multiple fragments into one DataFrag submessage if it makes
-     sense to send large messages, as it would e.g. on GigE with jumbo
-     frames.  If the sample is small enough to fit into one Data
-     submessage, we require fragnum = 0 & generate a Data instead of a
-     DataFrag.
+     the smallest allowed fragment size, but put "nfrags" consecutive
+     fragments into one DataFrag submessage when transmitting a large
+     sample, so that the message fills a datagram of MaxMessageSize.
+     If the sample is small enough to fit into one Data submessage, we
+     require fragnum = 0 & generate a Data instead of a DataFrag.
 
      Note: fragnum is 0-based here, 1-based in DDSI. But 0-based is
      much easier ...
@@ -484,11 +485,10 @@ dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const stru
   uint32_t fragstart, fraglen;
   enum nn_xmsg_kind xmsg_kind = isnew ? NN_XMSG_KIND_DATA : NN_XMSG_KIND_DATA_REXMIT;
   const uint32_t size = ddsi_serdata_size (serdata);
-  dds_return_t ret = 0;
-  (void)plist;
 
   ASSERT_MUTEX_HELD (&wr->e.lock);
 
+  assert (nfrags >= 1);
   if (fragnum * gv->config.fragment_size >= size && size > 0)
   {
     /* This is the first chance to detect an attempt at retransmitting
@@ -563,22 +563,19 @@ dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const stru
     nn_xmsg_submsg_init (*pmsg, sm_marker, SMID_DATA_FRAG);
     ddcmn->smhdr.flags = (unsigned char) (ddcmn->smhdr.flags | contentflag);
 
+    fragstart = fragnum * gv->config.fragment_size;
+    fraglen = gv->config.fragment_size * nfrags;
+    if (fraglen > size - fragstart)
+    {
+      fraglen = (uint32_t)(size - fragstart);
+      nfrags = (uint16_t) ((fraglen + gv->config.fragment_size - 1) / gv->config.fragment_size);
+    }
+
     frag->fragmentStartingNum = fragnum + 1;
-    frag->fragmentsInSubmessage = 1;
+    frag->fragmentsInSubmessage = nfrags;
     frag->fragmentSize = (unsigned short) gv->config.fragment_size;
     frag->sampleSize = (uint32_t)size;
 
-    fragstart = fragnum * gv->config.fragment_size;
-#if MULTIPLE_FRAGS_IN_SUBMSG /* ugly hack for testing only */
-    if (fragstart + gv->config.fragment_size < ddsi_serdata_size (serdata) &&
-        fragstart + 2 * gv->config.fragment_size >= ddsi_serdata_size (serdata))
-      frag->fragmentsInSubmessage++;
-    ret = frag->fragmentsInSubmessage;
-#endif
-
-    fraglen = gv->config.fragment_size * frag->fragmentsInSubmessage;
-    if (fragstart + fraglen > size)
-      fraglen = (uint32_t)(size - fragstart);
     ddcmn->octetsToInlineQos = (unsigned short) ((char*) (frag+1) - ((char*) &ddcmn->octetsToInlineQos + 2));
 
     if (wr->reliable && (!isnew || fragstart + fraglen == ddsi_serdata_size (serdata)))
@@ -614,6 +611,11 @@ dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const stru
     {
       nn_xmsg_addpar_statusinfo (*pmsg, serdata->statusinfo);
     }
+    if (plist && (plist->present & PP_COHERENT_SET))
+    {
+      nn_sequence_number_t *p = nn_xmsg_addpar (*pmsg, PID_COHERENT_SET, sizeof (*p));
+      *p = plist->coherent_set_seqno;
+    }
     rc = nn_xmsg_addpar_sentinel_ifparam (*pmsg);
     if (rc > 0)
     {
@@ -630,7 +632,12 @@ dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const stru
            seq, fragnum+1, fragstart, fragstart + fraglen);
 #endif
 
-  return ret;
+  return 0;
+}
+
+dds_return_t create_fragment_message (struct writer *wr, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, unsigned fragnum, struct proxy_reader *prd, struct nn_xmsg **pmsg, int isnew)
+{
+  return create_fragment_message_nfrags (wr, seq, plist, serdata, fragnum, 1, prd, pmsg, isnew);
 }
 
 static void create_HeartbeatFrag (struct writer *wr, seqno_t seq, unsigned fragnum, struct proxy_reader *prd, struct nn_xmsg **pmsg)
@@ -729,15 +736,96 @@ static int must_skip_frag (const char *frags_to_skip, unsigned frag)
 }
 #endif
 
+static uint16_t frags_per_msg (const struct ddsi_domaingv *gv)
+{
+  /* Maximum number of fragments put in a single DataFrag, such that the
+     message, including an INFO_DST, INFO_TS, the inline QoS that
+     create_fragment_message may add to the first fragment (key hash, the
+     extended status info, the coherent set and the sentinel) and a
+     HeartbeatFrag, still fits in MaxMessageSize. */
+  const uint32_t inline_qos =
+    (uint32_t) (sizeof (nn_parameter_t) + sizeof (nn_keyhash_t) +
+                sizeof (nn_parameter_t) + 2 * sizeof (uint32_t) +
+                sizeof (nn_parameter_t) + sizeof (nn_sequence_number_t) +
+                sizeof (nn_parameter_t));
+  const uint32_t overhead = (uint32_t) (RTPS_MESSAGE_HEADER_SIZE + sizeof (MsgLen_t) + sizeof (InfoDST_t) + sizeof (InfoTS_t) + sizeof (DataFrag_t) + sizeof (HeartbeatFrag_t)) + inline_qos;
+  uint32_t n;
+  if (gv->config.max_msg_size < overhead + 2 * gv->config.fragment_size)
+    return 1;
+  n = (gv->config.max_msg_size - overhead) / gv->config.fragment_size;
+  return (uint16_t) (n > UINT16_MAX ? UINT16_MAX : n);
+}
+
+static uint16_t lgmsg_frags_per_msg (const struct ddsi_domaingv *gv, uint32_t nfrags, int isnew, struct proxy_reader *prd)
+{
+  /* Number of fragments of a new sample put in a single DataFrag.
+     Retransmits requested by a NackFrag or AckNack are sent one fragment
+     at a time, unless they go through the retransmit scheduler (see
+     writer_rexmit_flush) */
+  uint16_t n;
+  if (!gv->config.coalesce_fragments || !isnew || prd != NULL)
+    return 1;
+  n = frags_per_msg (gv);
+  return (n > nfrags) ? (uint16_t) nfrags : n;
+}
+
+static bool lgmsg_pace (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, uint32_t rate, ddsrt_mtime_t tstart, uint64_t nbytes)
+{
+  /* Spreads the transmission of a large sample over time at the configured
+     LargeSampleRate or the rate set by the congestion controller: once the
+     data queued so far is ahead of schedule by more than a little, send what
+     has been packed and wait to catch up, in the same way as pace_writer.
+     Returns false if the writer is no longer operational. */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  const int64_t tdue = tstart.v + (int64_t) ((double) nbytes * 1e9 / rate);
+  int64_t ahead = tdue - ddsrt_time_monotonic ().v;
+  bool ok;
+  if (ahead <= DDS_MSECS (1))
+    return true;
+
+  nn_xpack_send (xp, true);
+  ddsrt_mutex_lock (&wr->e.lock);
+  wr->throttling++;
+  while (ahead > 0 && ddsrt_atomic_ld32 (&gv->rtps_keepgoing) && wr->state == WRST_OPERATIONAL)
+  {
+    thread_state_asleep (ts1);
+    (void) ddsrt_cond_waitfor (&wr->throttle_cond, &wr->e.lock, ahead);
+    thread_state_awake_domain_ok (ts1);
+    ahead = tdue - ddsrt_time_monotonic ().v;
+  }
+  wr->throttling--;
+  if ((ok = (wr->state == WRST_OPERATIONAL)) == false)
+  {
+    /* gc_delete_writer may be waiting */
+    ddsrt_cond_broadcast (&wr->throttle_cond);
+  }
+  ddsrt_mutex_unlock (&wr->e.lock);
+  return ok;
+}
+
 static void transmit_sample_lgmsg_unlocked (struct nn_xpack *xp, struct writer *wr, const struct whc_state *whcst, seqno_t seq, const struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct proxy_reader *prd, int isnew, uint32_t nfrags)
 {
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  const uint16_t fpm = lgmsg_frags_per_msg (gv, nfrags, isnew, prd);
+  const ddsrt_mtime_t tstart = ddsrt_time_monotonic ();
+  uint32_t rate = gv->config.large_sample_rate.value;
 #if 0
   const char *frags_to_skip = getenv ("SKIPFRAGS");
 #endif
   assert(xp);
   assert((wr->heartbeat_xevent != NULL) == (whcst != NULL));
 
-  for (uint32_t i = 0; i < nfrags; i++)
+  if (wr->rate_controlled)
+  {
+    ddsrt_mutex_lock (&wr->e.lock);
+    const uint32_t rcrate = (uint32_t) ddsi_ratecontrol_rate (&wr->ratecontrol);
+    ddsrt_mutex_unlock (&wr->e.lock);
+    if (rate == 0 || rcrate < rate)
+      rate = rcrate;
+  }
+
+  for (uint32_t i = 0; i < nfrags; i += fpm)
   {
     struct nn_xmsg *fmsg = NULL;
     struct nn_xmsg *hmsg = NULL;
@@ -751,21 +839,19 @@ static void transmit_sample_lgmsg_unlocked (struct nn_xpack *xp, struct writer *
        we haven't yet completed transmitting a fragmented message, add
        a HeartbeatFrag. */
     ddsrt_mutex_lock (&wr->e.lock);
-    ret = create_fragment_message (wr, seq, plist, serdata, i, prd, &fmsg, isnew);
+    ret = create_fragment_message_nfrags (wr, seq, plist, serdata, i, fpm, prd, &fmsg, isnew);
     if (ret >= 0)
     {
-      if (nfrags > 1 && i + 1 < nfrags)
-        create_HeartbeatFrag (wr, seq, i, prd, &hmsg);
+      if (nfrags > 1 && i + fpm < nfrags)
+        create_HeartbeatFrag (wr, seq, i + fpm - 1u, prd, &hmsg);
     }
     ddsrt_mutex_unlock (&wr->e.lock);
 
     if(fmsg) nn_xpack_addmsg (xp, fmsg, 0);
     if(hmsg) nn_xpack_addmsg (xp, hmsg, 0);
 
-#if MULTIPLE_FRAGS_IN_SUBMSG /* ugly hack for testing only */
-    if (ret > 1)
-      i += ret-1;
-#endif
+    if (rate > 0 && i + fpm < nfrags && !lgmsg_pace (ts1, xp, wr, rate, tstart, (uint64_t) (i + fpm) * gv->config.fragment_size))
+      break;
   }
 
   /* Note: wr->heartbeat_xevent != NULL <=> wr is reliable */
@@ -801,6 +887,11 @@ static void transmit_sample_unlocks_wr (struct nn_xpack *xp, struct writer *wr,
     uint32_t nfrags;
     ddsrt_mutex_unlock (&wr->e.lock);
     nfrags = (sz + gv->config.fragment_size - 1) / gv->config.fragment_size;
+    if (nfrags == 0)
+    {
+      /* end-of-transaction messages are empty, but still need to be sent */
+      nfrags = 1;
+    }
     transmit_sample_lgmsg_unlocked (xp, wr, whcst, seq, plist, serdata, prd, isnew, nfrags);
     return;
   }
@@ -833,6 +924,7 @@ int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct dds
 {
   struct ddsi_domaingv const * const gv = wr->e.gv;
   uint32_t i, sz, nfrags;
+  uint16_t fpm;
   int enqueued = 1;
 
   ASSERT_MUTEX_HELD (&wr->e.lock);
@@ -844,7 +936,8 @@ int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct dds
     /* end-of-transaction messages are empty, but still need to be sent */
     nfrags = 1;
   }
-  for (i = 0; i < nfrags && enqueued; i++)
+  fpm = lgmsg_frags_per_msg (gv, nfrags, isnew, prd);
+  for (i = 0; i < nfrags && enqueued; i += fpm)
   {
     struct nn_xmsg *fmsg = NULL;
     struct nn_xmsg *hmsg = NULL;
@@ -852,10 +945,10 @@ int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct dds
        eventually we'll have to retry.  But if a packet went out and
        we haven't yet completed transmitting a fragmented message, add
        a HeartbeatFrag. */
-    if (create_fragment_message (wr, seq, plist, serdata, i, prd, &fmsg, isnew) >= 0)
+    if (create_fragment_message_nfrags (wr, seq, plist, serdata, i, fpm, prd, &fmsg, isnew) >= 0)
     {
-      if (nfrags > 1 && i + 1 < nfrags)
-        create_HeartbeatFrag (wr, seq, i, prd, &hmsg);
+      if (nfrags > 1 && i + fpm < nfrags)
+        create_HeartbeatFrag (wr, seq, i + fpm - 1u, prd, &hmsg);
     }
     if (isnew)
     {
@@ -881,9 +974,267 @@ int enqueue_sample_wrlock_held (struct writer *wr, seqno_t seq, const struct dds
       }
     }
   }
+  if (!isnew && wr->rate_controlled && enqueued)
+    ddsi_ratecontrol_consume (&wr->ratecontrol, sz);
   return enqueued ? 0 : -1;
 }
 
+bool writer_rexmit_request_wrlock_held (struct writer *wr, const struct proxy_reader *prd, seqno_t seq, uint32_t size, uint32_t base, uint32_t numbits, const uint32_t *bits)
+{
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  const uint32_t fragsize = gv->config.fragment_size;
+  struct wr_rexmit_req *req;
+  ddsrt_avl_ipath_t path;
+  uint32_t nset = 0;
+
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  assert (wr->rexmit_xevent != NULL);
+  if ((req = ddsrt_avl_lookup_ipath (&wr_rexmit_reqs_treedef, &wr->rexmit_reqs, &seq, &path)) != NULL)
+  {
+    if (!req->multiple && memcmp (&req->prd_guid, &prd->e.guid, sizeof (req->prd_guid)) != 0)
+      req->multiple = 1;
+  }
+  else
+  {
+    /* Like the retransmit queue, accept a request for a single sample
+       regardless of its size so that it can always be retransmitted */
+    const uint32_t nfrags = (size == 0) ? 1 : (size + fragsize - 1) / fragsize;
+    const size_t nwords = (nfrags + 31) / 32;
+    if (wr->rexmit_reqs_bytes > 0 && wr->rexmit_reqs_bytes >= gv->config.max_queued_rexmit_bytes)
+      return false;
+    req = ddsrt_malloc (sizeof (*req) + nwords * sizeof (req->frags[0]));
+    req->seq = seq;
+    req->prd_guid = prd->e.guid;
+    req->multiple = 0;
+    req->bytes = 0;
+    req->nfrags = nfrags;
+    memset (req->frags, 0, nwords * sizeof (req->frags[0]));
+    if (ddsrt_avl_is_empty (&wr->rexmit_reqs))
+    {
+      const ddsrt_mtime_t tsched = ddsrt_mtime_add_duration (ddsrt_time_monotonic (), gv->config.retransmit_coalescing_window);
+      (void) resched_xevent_if_earlier (wr->rexmit_xevent, tsched);
+    }
+    ddsrt_avl_insert_ipath (&wr_rexmit_reqs_treedef, &wr->rexmit_reqs, req, &path);
+  }
+
+  /* bits == NULL: the full sample, else the fragments in the NackFrag's bitmap */
+  for (uint32_t i = 0; i < (bits ? numbits : req->nfrags); i++)
+  {
+    const uint32_t f = bits ? base + i : i;
+    if (f < req->nfrags && (bits == NULL || nn_bitset_isset (numbits, bits, i)) && !nn_bitset_isset (req->nfrags, req->frags, f))
+    {
+      nn_bitset_set (req->nfrags, req->frags, f);
+      nset++;
+    }
+  }
+  if (nset > 0)
+  {
+    const uint32_t nbytes = (req->nfrags == 1) ? size : nset * fragsize;
+    req->bytes += nbytes;
+    wr->rexmit_reqs_bytes += nbytes;
+  }
+  return true;
+}
+
+static void append_msg (struct nn_xmsg ***msgs, uint32_t *nmsgs, uint32_t *maxmsgs, struct nn_xmsg *msg)
+{
+  if (*nmsgs == *maxmsgs)
+  {
+    *maxmsgs = (*maxmsgs == 0) ? 8 : 2 * *maxmsgs;
+    *msgs = ddsrt_realloc (*msgs, *maxmsgs * sizeof (**msgs));
+  }
+  (*msgs)[(*nmsgs)++] = msg;
+}
+
+static bool writer_rexmit_req_msgs (struct writer *wr, struct wr_rexmit_req *req, ddsrt_mtime_t tnow, struct nn_xmsg ***msgs, uint32_t *nmsgs, uint32_t *maxmsgs)
+{
+  /* Constructs the messages for a single request, combining as many
+     consecutive fragments as fit in a single message */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  const uint16_t fpm = frags_per_msg (gv);
+  struct whc_borrowed_sample sample;
+  struct proxy_reader *prd = NULL;
+
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if (!req->multiple && (prd = entidx_lookup_proxy_reader_guid (gv->entity_index, &req->prd_guid)) == NULL)
+    return false;
+  if (!whc_borrow_sample (wr->whc, req->seq, &sample))
+    return false;
+  for (uint32_t i = 0; i < req->nfrags; )
+  {
+    struct nn_xmsg *fmsg;
+    uint32_t n = 1;
+    if (!nn_bitset_isset (req->nfrags, req->frags, i))
+    {
+      i++;
+      continue;
+    }
+    while (n < fpm && i + n < req->nfrags && nn_bitset_isset (req->nfrags, req->frags, i + n))
+      n++;
+    if (create_fragment_message_nfrags (wr, req->seq, sample.plist, sample.serdata, i, (uint16_t) n, prd, &fmsg, 0) >= 0 && fmsg)
+      append_msg (msgs, nmsgs, maxmsgs, fmsg);
+    i += n;
+  }
+  if (wr->rate_controlled)
+    ddsi_ratecontrol_consume (&wr->ratecontrol, req->bytes);
+  if (prd == NULL)
+    sample.last_rexmit_ts = tnow;
+  else
+    sample.rexmit_count++;
+  whc_return_sample (wr->whc, &sample, true);
+  return true;
+}
+
+void writer_rexmit_flush (struct nn_xpack *xp, struct writer *wr)
+{
+  /* Retransmits the pending requests in order of sequence number, one
+     request at a time so the writer lock isn't held for long, and outside
+     the writer lock as adding them to the packet may send it */
+  const ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  struct nn_xmsg **msgs = NULL;
+  uint32_t maxmsgs = 0;
+  struct wr_rexmit_req *req;
+  ddsrt_mutex_lock (&wr->e.lock);
+  while ((req = ddsrt_avl_find_min (&wr_rexmit_reqs_treedef, &wr->rexmit_reqs)) != NULL)
+  {
+    uint32_t nmsgs = 0;
+    ddsrt_avl_delete (&wr_rexmit_reqs_treedef, &wr->rexmit_reqs, req);
+    wr->rexmit_reqs_bytes -= req->bytes;
+    if (!writer_rexmit_req_msgs (wr, req, tnow, &msgs, &nmsgs, &maxmsgs))
+      ETRACE (wr, "writer_rexmit_flush: "PGUIDFMT" #%"PRId64" skipped\n", PGUID (wr->e.guid), req->seq);
+    else
+    {
+      ETRACE (wr, "writer_rexmit_flush: "PGUIDFMT" #%"PRId64" to %s: %"PRIu32" msgs\n",
+              PGUID (wr->e.guid), req->seq, req->multiple ? "all" : "one", nmsgs);
+      ddsrt_mutex_unlock (&wr->e.lock);
+      for (uint32_t i = 0; i < nmsgs; i++)
+        nn_xpack_addmsg (xp, msgs[i], 0);
+      ddsrt_mutex_lock (&wr->e.lock);
+    }
+    ddsrt_free (req);
+  }
+  ddsrt_mutex_unlock (&wr->e.lock);
+  ddsrt_free (msgs);
+}
+
+static struct nn_xmsg *writer_history_heartbeat (struct writer *wr, const struct proxy_reader *prd, int hbansreq)
+{
+  struct nn_xmsg *msg = nn_xmsg_new (wr->e.gv->xmsgpool, &wr->e.guid.prefix, 0, NN_XMSG_KIND_CONTROL);
+  struct whc_state whcst;
+  if (nn_xmsg_setdstPRD (msg, prd) < 0)
+  {
+    nn_xmsg_free (msg);
+    return NULL;
+  }
+  whc_get_state (wr->whc, &whcst);
+  add_Heartbeat (msg, wr, &whcst, hbansreq, 0, prd->e.guid.entityid, 0);
+  return msg;
+}
+
+static bool writer_history_burst_msgs (struct writer *wr, struct wr_prd_match *m, struct nn_xmsg ***msgs, uint32_t *nmsgs, uint32_t *maxmsgs)
+{
+  /* Constructs the messages for the next burst of historical data for the
+     reader of "m", stepping through the WHC one sample at a time because
+     the lock is released between bursts.  Returns true if there is more
+     to send to this reader. */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  const uint16_t fpm = frags_per_msg (gv);
+  struct proxy_reader *prd;
+  struct nn_xmsg *hmsg;
+  uint32_t bytes = 0;
+  seqno_t seq;
+
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  if ((prd = entidx_lookup_proxy_reader_guid (gv->entity_index, &m->prd_guid)) == NULL)
+  {
+    m->hist_next_seq = 0;
+    return false;
+  }
+  if (!m->hist_started)
+  {
+    /* the reader ignores data from a writer until it has received a heartbeat
+       from it, so the history is preceded by one */
+    if ((hmsg = writer_history_heartbeat (wr, prd, 0)) != NULL)
+      append_msg (msgs, nmsgs, maxmsgs, hmsg);
+    m->hist_started = 1;
+  }
+  seq = m->hist_next_seq;
+  while (seq <= m->hist_max_seq && bytes < gv->config.history_burst_bytes)
+  {
+    struct whc_borrowed_sample sample;
+    if (whc_borrow_sample (wr->whc, seq, &sample))
+    {
+      const uint32_t size = ddsi_serdata_size (sample.serdata);
+      const uint32_t nfrags = (size == 0) ? 1 : (size + gv->config.fragment_size - 1) / gv->config.fragment_size;
+      for (uint32_t i = 0; i < nfrags; i += fpm)
+      {
+        const uint16_t n = (nfrags - i < fpm) ? (uint16_t) (nfrags - i) : fpm;
+        struct nn_xmsg *fmsg;
+        if (create_fragment_message_nfrags (wr, seq, sample.plist, sample.serdata, i, n, prd, &fmsg, 0) >= 0 && fmsg)
+          append_msg (msgs, nmsgs, maxmsgs, fmsg);
+      }
+      whc_return_sample (wr->whc, &sample, false);
+      bytes += (size == 0) ? 1 : size;
+    }
+    seq = whc_next_seq (wr->whc, seq);
+  }
+  if (wr->rate_controlled)
+    ddsi_ratecontrol_consume (&wr->ratecontrol, bytes);
+
+  if (seq <= m->hist_max_seq)
+  {
+    m->hist_next_seq = seq;
+    return true;
+  }
+  else
+  {
+    /* Done: follow it with a heartbeat so that the reader requests any
+       samples it still misses through the normal path */
+    m->hist_next_seq = 0;
+    if ((hmsg = writer_history_heartbeat (wr, prd, 1)) != NULL)
+      append_msg (msgs, nmsgs, maxmsgs, hmsg);
+    return false;
+  }
+}
+
+ddsrt_mtime_t writer_history_push (struct nn_xpack *xp, struct writer *wr, ddsrt_mtime_t tnow)
+{
+  /* Sends the next burst of historical data to each of the readers that is
+     catching up, outside the writer lock like writer_rexmit_flush */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  struct nn_xmsg **msgs = NULL;
+  uint32_t maxmsgs = 0;
+  bool more = false;
+  struct wr_prd_match *m;
+  ddsrt_mutex_lock (&wr->e.lock);
+  m = ddsrt_avl_find_min (&wr_readers_treedef, &wr->readers);
+  while (m != NULL)
+  {
+    if (m->hist_next_seq == 0)
+      m = ddsrt_avl_find_succ (&wr_readers_treedef, &wr->readers, m);
+    else
+    {
+      const ddsi_guid_t prd_guid = m->prd_guid;
+      const seqno_t from = m->hist_next_seq;
+      uint32_t nmsgs = 0;
+      if (writer_history_burst_msgs (wr, m, &msgs, &nmsgs, &maxmsgs))
+        more = true;
+      ETRACE (wr, "writer_history_push: "PGUIDFMT" -> "PGUIDFMT" #%"PRId64"..%"PRId64": %"PRIu32" msgs%s\n",
+              PGUID (wr->e.guid), PGUID (prd_guid), from, m->hist_next_seq ? m->hist_next_seq - 1 : m->hist_max_seq,
+              nmsgs, m->hist_next_seq ? "" : " (done)");
+      ddsrt_mutex_unlock (&wr->e.lock);
+      for (uint32_t i = 0; i < nmsgs; i++)
+        nn_xpack_addmsg (xp, msgs[i], 0);
+      ddsrt_mutex_lock (&wr->e.lock);
+      /* the reader may have been removed while the lock was released */
+      m = ddsrt_avl_lookup_succ (&wr_readers_treedef, &wr->readers, &prd_guid);
+    }
+  }
+  ddsrt_mutex_unlock (&wr->e.lock);
+  ddsrt_free (msgs);
+  return more ? ddsrt_mtime_add_duration (tnow, gv->config.history_burst_interval) : DDSRT_MTIME_NEVER;
+}
+
 static int insert_sample_in_whc (struct writer *wr, seqno_t seq, struct ddsi_plist *plist, struct ddsi_serdata *serdata, struct ddsi_tkmap_instance *tk)
 {
   /* returns: < 0 on error, 0 if no need to insert in whc, > 0 if inserted */
@@ -961,6 +1312,34 @@ static int writer_may_continue (const struct writer *wr, const struct whc_state
   return (whcst->unacked_bytes <= wr->whc_low && !wr->retransmitting) || (wr->state != WRST_OPERATIONAL);
 }
 
+static void mark_readers_holding_up_writer (struct writer *wr)
+{
+  /* The time spent throttled is charged to the reliable readers that
+     were the furthest behind when the writer got blocked, those are the
+     ones preventing the WHC from shrinking */
+  const struct wr_prd_match *root;
+  struct wr_prd_match *m;
+  ddsrt_avl_iter_t it;
+  if ((root = ddsrt_avl_root (&wr_readers_treedef, &wr->readers)) == NULL)
+    return;
+  for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+    m->holding_up_writer = (m->is_reliable && m->seq == root->min_seq);
+}
+
+static void charge_readers_holding_up_writer (struct writer *wr, dds_duration_t throttled_time)
+{
+  struct wr_prd_match *m;
+  ddsrt_avl_iter_t it;
+  for (m = ddsrt_avl_iter_first (&wr_readers_treedef, &wr->readers, &it); m; m = ddsrt_avl_iter_next (&it))
+  {
+    if (m->holding_up_writer)
+    {
+      m->throttled_time += throttled_time;
+      m->holding_up_writer = 0;
+    }
+  }
+}
+
 static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr)
 {
   /* Sleep (cond_wait) without updating the thread's vtime: the
@@ -998,7 +1377,8 @@ static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn
      writer. */
   struct ddsi_domaingv const * const gv = wr->e.gv;
   dds_return_t result = DDS_RETCODE_OK;
-  ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  const ddsrt_mtime_t tstart = ddsrt_time_monotonic ();
+  ddsrt_mtime_t tnow = tstart;
   const ddsrt_mtime_t abstimeout = ddsrt_mtime_add_duration (tnow, wr->xqos->reliability.max_blocking_time);
   struct whc_state whcst;
   whc_get_state (wr->whc, &whcst);
@@ -1015,6 +1395,7 @@ static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn
          PGUID (wr->e.guid), whcst.unacked_bytes, wr->whc_low, wr->whc_high);
   wr->throttling++;
   wr->throttle_count++;
+  mark_readers_holding_up_writer (wr);
 
   /* Force any outstanding packet out: there will be a heartbeat
      requesting an answer in it.  FIXME: obviously, this is doing
@@ -1052,6 +1433,7 @@ static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn
     }
   }
 
+  charge_readers_holding_up_writer (wr, ddsrt_time_monotonic ().v - tstart.v);
   wr->throttling--;
   if (wr->state != WRST_OPERATIONAL)
   {
@@ -1065,6 +1447,56 @@ static dds_return_t throttle_writer (struct thread_state1 * const ts1, struct nn
   return result;
 }
 
+static dds_return_t pace_writer (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr)
+{
+  /* Blocks until the congestion controller allows sending, in the same
+     way as throttle_writer, and like it for at most the max_blocking_time
+     of the reliability QoS.  Acknowledgements wake it up early, which is
+     harmless as it simply recomputes the delay. */
+  struct ddsi_domaingv const * const gv = wr->e.gv;
+  dds_return_t result = DDS_RETCODE_OK;
+  ddsrt_mtime_t tnow = ddsrt_time_monotonic ();
+  const ddsrt_mtime_t abstimeout = ddsrt_mtime_add_duration (tnow, wr->xqos->reliability.max_blocking_time);
+  dds_duration_t delay;
+
+  ASSERT_MUTEX_HELD (&wr->e.lock);
+  assert (wr->rate_controlled);
+  assert (wr->throttling == 0);
+  if ((delay = ddsi_ratecontrol_delay (&wr->ratecontrol, tnow)) <= 0)
+    return DDS_RETCODE_OK;
+
+  GVLOG (DDS_LC_THROTTLE, "writer "PGUIDFMT" pacing at %.0f B/s, waiting %"PRId64" ns\n",
+         PGUID (wr->e.guid), ddsi_ratecontrol_rate (&wr->ratecontrol), delay);
+  wr->throttling++;
+  if (xp)
+  {
+    ddsrt_mutex_unlock (&wr->e.lock);
+    nn_xpack_send (xp, true);
+    ddsrt_mutex_lock (&wr->e.lock);
+  }
+  while (delay > 0 && ddsrt_atomic_ld32 (&gv->rtps_keepgoing) && wr->state == WRST_OPERATIONAL)
+  {
+    const int64_t reltimeout = abstimeout.v - tnow.v;
+    if (reltimeout <= 0)
+    {
+      result = DDS_RETCODE_TIMEOUT;
+      break;
+    }
+    thread_state_asleep (ts1);
+    (void) ddsrt_cond_waitfor (&wr->throttle_cond, &wr->e.lock, (delay < reltimeout) ? delay : reltimeout);
+    thread_state_awake_domain_ok (ts1);
+    tnow = ddsrt_time_monotonic ();
+    delay = ddsi_ratecontrol_delay (&wr->ratecontrol, tnow);
+  }
+  wr->throttling--;
+  if (wr->state != WRST_OPERATIONAL)
+  {
+    /* gc_delete_writer may be waiting */
+    ddsrt_cond_broadcast (&wr->throttle_cond);
+  }
+  return result;
+}
+
 static int maybe_grow_whc (struct writer *wr)
 {
   struct ddsi_domaingv const * const gv = wr->e.gv;
@@ -1153,6 +1585,13 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     }
   }
 
+  if (wr->rate_controlled && pace_writer (ts1, xp, wr) == DDS_RETCODE_TIMEOUT)
+  {
+    ddsrt_mutex_unlock (&wr->e.lock);
+    r = DDS_RETCODE_TIMEOUT;
+    goto drop;
+  }
+
   if (wr->state != WRST_OPERATIONAL)
   {
     r = DDS_RETCODE_PRECONDITION_NOT_MET;
@@ -1163,6 +1602,7 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
   /* Always use the current monotonic time */
   tnow = ddsrt_time_monotonic ();
   serdata->twrite = tnow;
+  int64_t tlat = DDSI_LATENCY_START (gv->config.latency_stats && !is_builtin_entityid (wr->e.guid.entityid, NN_VENDORID_ECLIPSE));
 
   seq = ++wr->seq;
   if (wr->cs_seq != 0)
@@ -1177,7 +1617,9 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     plist->coherent_set_seqno = toSN (wr->cs_seq);
   }
 
-  if ((r = insert_sample_in_whc (wr, seq, plist, serdata, tk)) < 0)
+  r = insert_sample_in_whc (wr, seq, plist, serdata, tk);
+  tlat = DDSI_LATENCY_LAP (DDSI_LATENCY_WHC_INSERT, tlat);
+  if (r < 0)
   {
     /* Failure of some kind */
     ddsrt_mutex_unlock (&wr->e.lock);
@@ -1197,7 +1639,8 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
       matching proxy readers.  The exception is the SPDP writer.) */
     writer_update_seq_xmit (wr, seq);
     ddsrt_mutex_unlock (&wr->e.lock);
-    if (plist != NULL)
+    /* If not actually inserted, WHC didn't take ownership of plist */
+    if (r == 0 && plist != NULL)
     {
       ddsi_plist_fini (plist);
       ddsrt_free (plist);
@@ -1208,6 +1651,16 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
     /* Note the subtlety of enqueueing with the lock held but
        transmitting without holding the lock. Still working on
        cleaning that up. */
+    if (wr->rate_controlled)
+      ddsi_ratecontrol_consume (&wr->ratecontrol, ddsi_serdata_size (serdata));
+    /* Use this sample for measuring the round-trip times to the readers,
+       unless a measurement is still in progress; a reader that fails to
+       ack it within a second simply doesn't get a measurement */
+    if (wr->reliable && (wr->rtt_probe_seq == 0 || tnow.v - wr->rtt_probe_t.v > DDS_SECS (1)))
+    {
+      wr->rtt_probe_seq = seq;
+      wr->rtt_probe_t = tnow;
+    }
     if (xp)
     {
       /* If all reliable readers disappear between unlocking the writer and
@@ -1241,6 +1694,7 @@ static int write_sample_eot (struct thread_state1 * const ts1, struct nn_xpack *
       enqueue_sample_wrlock_held (wr, seq, plist, serdata, NULL, 1);
       ddsrt_mutex_unlock (&wr->e.lock);
     }
+    (void) DDSI_LATENCY_LAP (DDSI_LATENCY_XPACK, tlat);
 
     /* If not actually inserted, WHC didn't take ownership of plist */
     if (r == 0 && plist != NULL)
@@ -1287,3 +1741,45 @@ int write_sample_nogc_notk (struct thread_state1 * const ts1, struct nn_xpack *x
   ddsi_tkmap_instance_unref (wr->e.gv->m_tkmap, tk);
   return res;
 }
+
+void writer_begin_coherent (struct writer *wr)
+{
+  /* Coherent sets are only meaningful for a writer with PRESENTATION coherent_access,
+     and only such writers can be matched with readers that expect them; the set
+     starts with the next sample written */
+  if (!wr->xqos->presentation.coherent_access)
+    return;
+  ddsrt_mutex_lock (&wr->e.lock);
+  if (wr->cs_seq == 0)
+    wr->cs_seq = wr->seq + 1;
+  ddsrt_mutex_unlock (&wr->e.lock);
+}
+
+int writer_end_coherent (struct thread_state1 * const ts1, struct nn_xpack *xp, struct writer *wr, seqno_t *cs_seq)
+{
+  /* Terminates the set with a "commit" message: a DATA without payload (a serdata of
+     kind EMPTY) with the coherent set sequence number as inline QoS */
+  struct ddsi_serdata *serdata;
+  ddsi_plist_t *plist;
+  ddsrt_mutex_lock (&wr->e.lock);
+  *cs_seq = wr->cs_seq;
+  if (*cs_seq != 0 && *cs_seq > wr->seq)
+  {
+    /* nothing written since the set began: there is nothing to commit */
+    wr->cs_seq = 0;
+    *cs_seq = 0;
+  }
+  ddsrt_mutex_unlock (&wr->e.lock);
+  if (*cs_seq == 0)
+    return 0;
+
+  serdata = ddsi_serdata_new_empty (wr->topic);
+  serdata->statusinfo = 0;
+  serdata->timestamp = ddsrt_time_wallclock ();
+  plist = ddsrt_malloc (sizeof (*plist));
+  ddsi_plist_init_empty (plist);
+  plist->present |= PP_COHERENT_SET;
+  plist->coherent_set_seqno = toSN (*cs_seq);
+  ETRACE (wr, "writer_end_coherent "PGUIDFMT" C#%"PRId64"\n", PGUID (wr->e.guid), *cs_seq);
+  return write_sample_eot (ts1, xp, wr, plist, serdata, NULL, 1, 1);
+}
@@ -58,6 +58,8 @@ enum xeventkind
   XEVK_SPDP,
   XEVK_PMD_UPDATE,
   XEVK_DELETE_WRITER,
+  XEVK_REXMIT,
+  XEVK_HISTORY,
   XEVK_CALLBACK
 };
 
@@ -90,6 +92,12 @@ struct xevent
     struct {
       ddsi_guid_t guid;
     } delete_writer;
+    struct {
+      ddsi_guid_t wr_guid;
+    } rexmit;
+    struct {
+      ddsi_guid_t wr_guid;
+    } history;
     struct {
       void (*cb) (struct xevent *ev, void *arg, ddsrt_mtime_t tnow);
       void *arg;
@@ -148,10 +156,18 @@ struct xeventq {
   ddsrt_cond_t cond;
   ddsi_tran_conn_t tev_conn;
   uint32_t auxiliary_bandwidth_limit;
+
+  /* HEARTBEAT/ACKNACK messages collected while handling the due timed
+     events, only used if ControlAggregationWindow is set and only ever
+     touched by the event thread */
+  struct nn_xmsg **ctrl_msgs;
+  size_t n_ctrl_msgs;
+  size_t max_ctrl_msgs;
 };
 
 static uint32_t xevent_thread (struct xeventq *xevq);
 static ddsrt_mtime_t earliest_in_xeventq (struct xeventq *evq);
+static ddsrt_mtime_t control_xevent_tsched (const struct xeventq *evq, enum xeventkind kind, ddsrt_mtime_t tsched);
 static int msg_xevents_cmp (const void *a, const void *b);
 static int compare_xevent_tsched (const void *va, const void *vb);
 static void handle_nontimed_xevent (struct xevent_nt *xev, struct nn_xpack *xp);
@@ -305,6 +321,8 @@ static void free_xevent (struct xeventq *evq, struct xevent *ev)
       case XEVK_SPDP:
       case XEVK_PMD_UPDATE:
       case XEVK_DELETE_WRITER:
+      case XEVK_REXMIT:
+      case XEVK_HISTORY:
       case XEVK_CALLBACK:
         break;
     }
@@ -371,6 +389,7 @@ int resched_xevent_if_earlier (struct xevent *ev, ddsrt_mtime_t tsched)
      but with TSCHED_DELETE = MIN_INT64, tsched >= ev->tsched is
      guaranteed to be false. */
   assert (tsched.v != TSCHED_DELETE);
+  tsched = control_xevent_tsched (evq, ev->kind, tsched);
   if (tsched.v >= ev->tsched.v)
     is_resched = 0;
   else
@@ -412,6 +431,18 @@ static ddsrt_mtime_t mtime_round_up (ddsrt_mtime_t t, int64_t round)
   }
 }
 
+static ddsrt_mtime_t control_xevent_tsched (const struct xeventq *evq, enum xeventkind kind, ddsrt_mtime_t tsched)
+{
+  /* Rounding up the times of all heartbeat and acknack events to a multiple
+     of the aggregation window makes those that are due within the same
+     window fire together, so that the messages can be combined per
+     destination */
+  if ((kind == XEVK_HEARTBEAT || kind == XEVK_ACKNACK) && tsched.v != DDS_NEVER)
+    return mtime_round_up (tsched, evq->gv->config.control_aggregation_window);
+  else
+    return tsched;
+}
+
 static struct xevent *qxev_common (struct xeventq *evq, ddsrt_mtime_t tsched, enum xeventkind kind)
 {
   /* qxev_common is the route by which all timed xevents are
@@ -428,6 +459,7 @@ static struct xevent *qxev_common (struct xeventq *evq, ddsrt_mtime_t tsched, en
     EVQTRACE ("rounded event scheduled for %"PRId64" to %"PRId64"\n", tsched.v, tsched_rounded.v);
     tsched = tsched_rounded;
   }
+  tsched = control_xevent_tsched (evq, kind, tsched);
 
   ev->evq = evq;
   ev->tsched = tsched;
@@ -505,6 +537,9 @@ struct xeventq * xeventq_new
   evq->queued_rexmit_msgs = 0;
   evq->tev_conn = conn;
   evq->gv = conn->m_base.gv;
+  evq->ctrl_msgs = NULL;
+  evq->n_ctrl_msgs = 0;
+  evq->max_ctrl_msgs = 0;
   ddsrt_mutex_init (&evq->lock);
   ddsrt_cond_init (&evq->cond);
   return evq;
@@ -567,6 +602,8 @@ void xeventq_free (struct xeventq *evq)
   }
 
   assert (ddsrt_avl_is_empty (&evq->msg_xevents));
+  assert (evq->n_ctrl_msgs == 0);
+  ddsrt_free (evq->ctrl_msgs);
   ddsrt_cond_destroy (&evq->cond);
   ddsrt_mutex_destroy (&evq->lock);
   ddsrt_free (evq);
@@ -574,6 +611,35 @@ void xeventq_free (struct xeventq *evq)
 
 /* EVENT QUEUE EVENT HANDLERS ******************************************************/
 
+static void add_control_msg (struct xeventq *evq, struct nn_xpack *xp, struct nn_xmsg *msg)
+{
+  /* Heartbeats and acknacks are added to the pack straightaway, unless they
+     are to be aggregated, in which case they are collected and added in
+     bulk by flush_control_msgs once all due events have been handled */
+  if (evq->gv->config.control_aggregation_window == 0)
+    nn_xpack_addmsg (xp, msg, 0);
+  else
+  {
+    if (evq->n_ctrl_msgs == evq->max_ctrl_msgs)
+    {
+      evq->max_ctrl_msgs = (evq->max_ctrl_msgs == 0) ? 32 : 2 * evq->max_ctrl_msgs;
+      evq->ctrl_msgs = ddsrt_realloc (evq->ctrl_msgs, evq->max_ctrl_msgs * sizeof (*evq->ctrl_msgs));
+    }
+    evq->ctrl_msgs[evq->n_ctrl_msgs++] = msg;
+  }
+}
+
+static void flush_control_msgs (struct xeventq *evq, struct nn_xpack *xp)
+{
+  struct ddsi_domaingv const * const gv = evq->gv;
+  if (evq->n_ctrl_msgs > 0)
+  {
+    GVTRACE ("aggregating %"PRIuSIZE" heartbeat/acknack messages\n", evq->n_ctrl_msgs);
+    nn_xpack_addmsgs_by_dst (xp, evq->ctrl_msgs, evq->n_ctrl_msgs);
+    evq->n_ctrl_msgs = 0;
+  }
+}
+
 static void handle_xevk_msg (struct nn_xpack *xp, struct xevent_nt *ev)
 {
   assert (!nontimed_xevent_in_queue (ev->evq, ev));
@@ -657,7 +723,7 @@ static void handle_xevk_heartbeat (struct nn_xpack *xp, struct xevent *ev, ddsrt
      and we certainly don't want to hold the lock during that time. */
   if (msg)
   {
-    nn_xpack_addmsg (xp, msg, 0);
+    add_control_msg (ev->evq, xp, msg);
   }
 }
 
@@ -828,6 +894,12 @@ static void add_AckNack (struct nn_xmsg *msg, struct proxy_writer *pwr, struct p
             base, an->readerSNState.numbits);
     for (uint32_t ui = 0; ui != an->readerSNState.numbits; ui++)
       ETRACE (pwr, "%c", nn_bitset_isset (numbits, an->bits, ui) ? '1' : '0');
+    if (*nack_seq)
+    {
+      rwn->nacks_sent++;
+      for (uint32_t ui = 0; ui != an->readerSNState.numbits; ui++)
+        rwn->nacked_samples += (uint64_t) nn_bitset_isset (numbits, an->bits, ui);
+    }
   }
 
   if (nackfrag_numbits > 0)
@@ -858,6 +930,9 @@ static void add_AckNack (struct nn_xmsg *msg, struct proxy_writer *pwr, struct p
       for (uint32_t ui = 0; ui != nf->fragmentNumberState.numbits; ui++)
         ETRACE (pwr, "%c", nn_bitset_isset (nf->fragmentNumberState.numbits, nf->bits, ui) ? '1' : '0');
     }
+    rwn->nackfrags_sent++;
+    for (uint32_t ui = 0; ui != nf->fragmentNumberState.numbits; ui++)
+      rwn->nacked_fragments += (uint64_t) nn_bitset_isset (nf->fragmentNumberState.numbits, nf->bits, ui);
   }
 
   ETRACE (pwr, "\n");
@@ -951,7 +1026,7 @@ static void handle_xevk_acknack (UNUSED_ARG (struct nn_xpack *xp), struct xevent
   /* nn_xpack_addmsg may sleep (for bandwidth-limited channels), so
      must be outside the lock */
   if (msg)
-    nn_xpack_addmsg (xp, msg, 0);
+    add_control_msg (ev->evq, xp, msg);
   return;
 
  outofmem:
@@ -1156,6 +1231,37 @@ static void handle_xevk_delete_writer (UNUSED_ARG (struct nn_xpack *xp), struct
   delete_xevent (ev);
 }
 
+static void handle_xevk_rexmit (struct nn_xpack *xp, struct xevent *ev, UNUSED_ARG (ddsrt_mtime_t tnow))
+{
+  /* the event is rescheduled whenever a new retransmit request is queued,
+     so once the writer is gone it simply stays unscheduled until it gets
+     deleted with the writer */
+  struct ddsi_domaingv * const gv = ev->evq->gv;
+  struct writer *wr;
+  if ((wr = entidx_lookup_writer_guid (gv->entity_index, &ev->u.rexmit.wr_guid)) == NULL)
+  {
+    GVTRACE ("handle_xevk_rexmit: "PGUIDFMT" not found\n", PGUID (ev->u.rexmit.wr_guid));
+    return;
+  }
+  writer_rexmit_flush (xp, wr);
+}
+
+static void handle_xevk_history (struct nn_xpack *xp, struct xevent *ev, ddsrt_mtime_t tnow)
+{
+  /* rescheduled by writer_add_connection when a reader needs the history,
+     and by itself for as long as the history is still being streamed */
+  struct ddsi_domaingv * const gv = ev->evq->gv;
+  struct writer *wr;
+  ddsrt_mtime_t tnext;
+  if ((wr = entidx_lookup_writer_guid (gv->entity_index, &ev->u.history.wr_guid)) == NULL)
+  {
+    GVTRACE ("handle_xevk_history: "PGUIDFMT" not found\n", PGUID (ev->u.history.wr_guid));
+    return;
+  }
+  if ((tnext = writer_history_push (xp, wr, tnow)).v != DDS_NEVER)
+    (void) resched_xevent_if_earlier (ev, tnext);
+}
+
 static void handle_individual_xevent (struct thread_state1 * const ts1, struct xevent *xev, struct nn_xpack *xp, ddsrt_mtime_t tnow)
 {
   struct xeventq *xevq = xev->evq;
@@ -1191,6 +1297,12 @@ static void handle_individual_xevent (struct thread_state1 * const ts1, struct x
       case XEVK_DELETE_WRITER:
         handle_xevk_delete_writer (xp, xev, tnow);
         break;
+      case XEVK_REXMIT:
+        handle_xevk_rexmit (xp, xev, tnow);
+        break;
+      case XEVK_HISTORY:
+        handle_xevk_history (xp, xev, tnow);
+        break;
       case XEVK_CALLBACK:
         assert (0);
         break;
@@ -1285,6 +1397,15 @@ static void handle_xevents (struct thread_state1 * const ts1, struct xeventq *xe
       tnow = ddsrt_time_monotonic ();
     }
 
+    if (xevq->n_ctrl_msgs > 0)
+    {
+      /* nn_xpack_addmsg may sleep (for bandwidth-limited channels), so
+         must be outside the lock */
+      ddsrt_mutex_unlock (&xevq->lock);
+      flush_control_msgs (xevq, xp);
+      ddsrt_mutex_lock (&xevq->lock);
+    }
+
     if (!non_timed_xmit_list_is_empty (xevq))
     {
       struct xevent_nt *xev = getnext_from_non_timed_xmit_list (xevq);
@@ -1538,6 +1659,30 @@ struct xevent *qxev_delete_writer (struct xeventq *evq, ddsrt_mtime_t tsched, co
   return ev;
 }
 
+struct xevent *qxev_rexmit (struct xeventq *evq, ddsrt_mtime_t tsched, const ddsi_guid_t *wr_guid)
+{
+  /* Like qxev_heartbeat, used exclusively for wr->rexmit_xevent */
+  struct xevent *ev;
+  ddsrt_mutex_lock (&evq->lock);
+  ev = qxev_common (evq, tsched, XEVK_REXMIT);
+  ev->u.rexmit.wr_guid = *wr_guid;
+  qxev_insert (ev);
+  ddsrt_mutex_unlock (&evq->lock);
+  return ev;
+}
+
+struct xevent *qxev_history (struct xeventq *evq, ddsrt_mtime_t tsched, const ddsi_guid_t *wr_guid)
+{
+  /* Like qxev_heartbeat, used exclusively for wr->history_xevent */
+  struct xevent *ev;
+  ddsrt_mutex_lock (&evq->lock);
+  ev = qxev_common (evq, tsched, XEVK_HISTORY);
+  ev->u.history.wr_guid = *wr_guid;
+  qxev_insert (ev);
+  ddsrt_mutex_unlock (&evq->lock);
+  return ev;
+}
+
 struct xevent *qxev_callback (struct xeventq *evq, ddsrt_mtime_t tsched, void (*cb) (struct xevent *ev, void *arg, ddsrt_mtime_t tnow), void *arg)
 {
   struct xevent *ev;
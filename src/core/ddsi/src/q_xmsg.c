@@ -41,6 +41,7 @@
 #include "dds/ddsi/ddsi_entity_index.h"
 #include "dds/ddsi/q_freelist.h"
 #include "dds/ddsi/ddsi_serdata_default.h"
+#include "dds/ddsi/ddsi_latency_stats.h"
 
 #define NN_XMSG_MAX_ALIGN 8
 #define NN_XMSG_CHUNK_SIZE 128
@@ -59,6 +60,11 @@ struct nn_xmsg_chain_elem {
   struct nn_xmsg_chain_elem *older;
 };
 
+/* Serialised data need not be stored contiguously, in which case the payload
+   of a single submessage may consist of multiple pieces.  If there are more
+   pieces than iovecs, all but the first few get copied */
+#define NN_XMSG_MAX_PAYLOAD_IOVECS 4
+
 enum nn_xmsg_dstmode {
   NN_XMSG_DST_UNSET,
   NN_XMSG_DST_ONE,
@@ -71,7 +77,10 @@ struct nn_xmsg {
   size_t sz;
   int have_params;
   struct ddsi_serdata *refd_payload;
-  ddsrt_iovec_t refd_payload_iov;
+  ddsrt_iovec_t refd_payload_iov[NN_XMSG_MAX_PAYLOAD_IOVECS];
+  uint32_t refd_payload_nref; /* iovecs obtained from to_ser_ref */
+  uint32_t refd_payload_niov; /* refd_payload_nref + 1 if remainder had to be copied */
+  size_t refd_payload_size;
   int64_t maxdelay;
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
   uint32_t encoderid;
@@ -109,9 +118,10 @@ struct nn_xmsg {
 };
 
 /* Worst-case: change of SRC [+1] but no DST, submessage [+1], ref'd
-   payload [+1].  So 128 iovecs => at least ~40 submessages, so for
+   payload [+NN_XMSG_MAX_PAYLOAD_IOVECS].  Typically the payload is a
+   single iovec and so 128 iovecs => at least ~40 submessages, so for
    very small ones still >1kB. */
-#define NN_XMSG_MAX_SUBMESSAGE_IOVECS 3
+#define NN_XMSG_MAX_SUBMESSAGE_IOVECS (2 + NN_XMSG_MAX_PAYLOAD_IOVECS)
 
 #ifdef IOV_MAX
 #if IOV_MAX > 0 && IOV_MAX < 256
@@ -140,51 +150,6 @@ struct nn_bw_limiter {
 };
 #endif
 
-///////////////////////////
-typedef struct {
-  ddsrt_mutex_t mtx;
-  uint32_t value;
-  ddsrt_cond_t cv;
-} ddsi_sem_t;
-
-static dds_return_t
-ddsi_sem_init (ddsi_sem_t *sem, uint32_t value)
-{
-  sem->value = value;
-  ddsrt_mutex_init (&sem->mtx);
-  ddsrt_cond_init (&sem->cv);
-  return DDS_RETCODE_OK;
-}
-
-static dds_return_t
-ddsi_sem_destroy (ddsi_sem_t *sem)
-{
-  ddsrt_cond_destroy (&sem->cv);
-  ddsrt_mutex_destroy (&sem->mtx);
-  return DDS_RETCODE_OK;
-}
-
-static dds_return_t
-ddsi_sem_post (ddsi_sem_t *sem)
-{
-  ddsrt_mutex_lock (&sem->mtx);
-  if (sem->value++ == 0)
-    ddsrt_cond_signal (&sem->cv);
-  ddsrt_mutex_unlock (&sem->mtx);
-  return DDS_RETCODE_OK;
-}
-
-static dds_return_t
-ddsi_sem_wait (ddsi_sem_t *sem)
-{
-  ddsrt_mutex_lock (&sem->mtx);
-  while (sem->value == 0)
-    ddsrt_cond_wait (&sem->cv, &sem->mtx);
-  ddsrt_mutex_unlock (&sem->mtx);
-  return DDS_RETCODE_OK;
-}
-///////////////////////////
-
 struct nn_xpack
 {
   struct nn_xpack *sendq_next;
@@ -195,10 +160,8 @@ struct nn_xpack
   InfoDST_t *last_dst;
   int64_t maxdelay;
   unsigned packetid;
-  ddsrt_atomic_uint32_t calls;
   uint32_t call_flags;
   ddsi_tran_conn_t conn;
-  ddsi_sem_t sem;
   size_t niov;
   ddsrt_iovec_t *iov;
   enum nn_xmsg_dstmode dstmode;
@@ -223,6 +186,10 @@ struct nn_xpack
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
   uint32_t encoderId;
 #endif /* DDSI_INCLUDE_NETWORK_PARTITIONS */
+
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  int64_t tlat; /* time at which the first application data was added, 0 if none */
+#endif
 };
 
 static size_t align4u (size_t x)
@@ -280,6 +247,9 @@ static void nn_xmsg_reinit (struct nn_xmsg *m, enum nn_xmsg_kind kind)
   m->sz = 0;
   m->have_params = 0;
   m->refd_payload = NULL;
+  m->refd_payload_nref = 0;
+  m->refd_payload_niov = 0;
+  m->refd_payload_size = 0;
   m->dstmode = NN_XMSG_DST_UNSET;
   m->kind = kind;
   m->maxdelay = 0;
@@ -343,7 +313,12 @@ void nn_xmsg_free (struct nn_xmsg *m)
 {
   struct nn_xmsgpool *pool = m->pool;
   if (m->refd_payload)
-    ddsi_serdata_to_ser_unref (m->refd_payload, &m->refd_payload_iov);
+  {
+    for (uint32_t i = 0; i < m->refd_payload_nref; i++)
+      ddsi_serdata_to_ser_unref (m->refd_payload, &m->refd_payload_iov[i]);
+    if (m->refd_payload_niov > m->refd_payload_nref)
+      ddsrt_free (m->refd_payload_iov[m->refd_payload_nref].iov_base);
+  }
   if (m->dstmode == NN_XMSG_DST_ALL)
   {
     unref_addrset (m->dstaddr.all.as);
@@ -484,7 +459,7 @@ void nn_xmsg_submsg_init (struct nn_xmsg *msg, struct nn_xmsg_marker marker, Sub
 void nn_xmsg_submsg_setnext (struct nn_xmsg *msg, struct nn_xmsg_marker marker)
 {
   SubmessageHeader_t *hdr = (SubmessageHeader_t *) (msg->data->payload + marker.offset);
-  unsigned plsize = msg->refd_payload ? (unsigned) msg->refd_payload_iov.iov_len : 0;
+  unsigned plsize = (unsigned) msg->refd_payload_size;
   assert ((msg->sz % 4) == 0);
   assert ((plsize % 4) == 0);
   assert ((unsigned) (msg->data->payload + msg->sz + plsize - (char *) hdr) >= RTPS_SUBMESSAGE_HEADER_SIZE);
@@ -562,9 +537,27 @@ void nn_xmsg_serdata (struct nn_xmsg *m, struct ddsi_serdata *serdata, size_t of
 {
   if (serdata->kind != SDK_EMPTY)
   {
-    size_t len4 = align4u (len);
+    const size_t end = off + align4u (len);
+    size_t pos = off;
     assert (m->refd_payload == NULL);
-    m->refd_payload = ddsi_serdata_to_ser_ref (serdata, off, len4, &m->refd_payload_iov);
+    while (pos < end && m->refd_payload_nref < NN_XMSG_MAX_PAYLOAD_IOVECS - 1)
+    {
+      ddsrt_iovec_t * const iov = &m->refd_payload_iov[m->refd_payload_nref++];
+      struct ddsi_serdata * const refd = ddsi_serdata_to_ser_ref (serdata, pos, end - pos, iov);
+      assert (m->refd_payload == NULL || m->refd_payload == refd);
+      m->refd_payload = refd;
+      assert (iov->iov_len > 0);
+      pos += iov->iov_len;
+    }
+    m->refd_payload_niov = m->refd_payload_nref;
+    if (pos < end)
+    {
+      ddsrt_iovec_t * const iov = &m->refd_payload_iov[m->refd_payload_niov++];
+      iov->iov_base = ddsrt_malloc (end - pos);
+      iov->iov_len = (ddsrt_iov_len_t) (end - pos);
+      ddsi_serdata_to_ser (serdata, pos, end - pos, iov->iov_base);
+    }
+    m->refd_payload_size = end - off;
   }
 }
 
@@ -953,6 +946,9 @@ static void nn_xpack_reinit (struct nn_xpack *xp)
   xp->maxdelay = DDS_INFINITY;
 #ifdef DDSI_INCLUDE_NETWORK_PARTITIONS
   xp->encoderId = 0;
+#endif
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  xp->tlat = 0;
 #endif
   xp->packetid++;
 }
@@ -989,9 +985,6 @@ struct nn_xpack * nn_xpack_new (ddsi_tran_conn_t conn, uint32_t bw_limit, bool a
   xp->conn = conn;
   nn_xpack_reinit (xp);
 
-  if (xp->gv->thread_pool)
-    ddsi_sem_init (&xp->sem, 0);
-
 #ifdef DDSI_INCLUDE_BANDWIDTH_LIMITING
   nn_bw_limit_init (&xp->limiter, bw_limit);
 #else
@@ -1004,8 +997,6 @@ void nn_xpack_free (struct nn_xpack *xp)
 {
   assert (xp->niov == 0);
   assert (xp->included_msgs.latest == NULL);
-  if (xp->gv->thread_pool)
-    ddsi_sem_destroy (&xp->sem);
   ddsrt_free (xp->iov);
   ddsrt_free (xp);
 }
@@ -1036,7 +1027,10 @@ static ssize_t nn_xpack_send1 (const nn_locator_t *loc, void * varg)
 
   if (!gv->mute)
   {
-    nbytes = ddsi_conn_write (xp->conn, loc, xp->niov, xp->iov, xp->call_flags);
+    /* Same-host peers are reached via shared memory when possible, it
+       refuses anything else */
+    if (gv->shm_xmit_conn == NULL || (nbytes = ddsi_conn_write (gv->shm_xmit_conn, loc, xp->niov, xp->iov, xp->call_flags)) < 0)
+      nbytes = ddsi_conn_write (xp->conn, loc, xp->niov, xp->iov, xp->call_flags);
 #ifndef NDEBUG
     {
       size_t i, len;
@@ -1072,29 +1066,49 @@ static void nn_xpack_send1v (const nn_locator_t *loc, void * varg)
   (void) nn_xpack_send1 (loc, varg);
 }
 
-typedef struct nn_xpack_send1_thread_arg {
-  const nn_locator_t *loc;
-  struct nn_xpack *xp;
-} *nn_xpack_send1_thread_arg_t;
+struct nn_xpack_send1_locs {
+  uint32_t n, max;
+  nn_locator_t *locs;
+  nn_locator_t locs_inline[16];
+};
 
-static void nn_xpack_send1_thread (void * varg)
+static void nn_xpack_collect_loc (const nn_locator_t *loc, void * varg)
 {
-  nn_xpack_send1_thread_arg_t arg = varg;
-  (void) nn_xpack_send1 (arg->loc, arg->xp);
-  if (ddsrt_atomic_dec32_ov (&arg->xp->calls) == 1)
+  struct nn_xpack_send1_locs *arg = varg;
+  if (arg->n == arg->max)
   {
-    ddsi_sem_post (&arg->xp->sem);
+    arg->max *= 2;
+    if (arg->locs == arg->locs_inline)
+    {
+      arg->locs = ddsrt_malloc (arg->max * sizeof (*arg->locs));
+      memcpy (arg->locs, arg->locs_inline, arg->n * sizeof (*arg->locs));
+    }
+    else
+    {
+      arg->locs = ddsrt_realloc (arg->locs, arg->max * sizeof (*arg->locs));
+    }
   }
-  ddsrt_free (varg);
+  arg->locs[arg->n++] = *loc;
+}
+
+static void nn_xpack_send1_batchjob (void *ctx, void *arg)
+{
+  (void) nn_xpack_send1 (arg, ctx);
 }
 
-static void nn_xpack_send1_threaded (const nn_locator_t *loc, void * varg)
+static size_t nn_xpack_send1_threaded (struct nn_xpack *xp, struct addrset *as)
 {
-  nn_xpack_send1_thread_arg_t arg = ddsrt_malloc (sizeof (*arg));
-  arg->xp = (struct nn_xpack *) varg;
-  arg->loc = loc;
-  ddsrt_atomic_inc32 (&arg->xp->calls);
-  ddsrt_thread_pool_submit (arg->xp->gv->thread_pool, nn_xpack_send1_thread, arg);
+  /* Copy the addresses so the address set is not locked while sending, then
+     let the thread pool send to all of them in a single batch */
+  struct nn_xpack_send1_locs arg;
+  arg.n = 0;
+  arg.max = (uint32_t) (sizeof (arg.locs_inline) / sizeof (arg.locs_inline[0]));
+  arg.locs = arg.locs_inline;
+  addrset_forall (as, nn_xpack_collect_loc, &arg);
+  ddsrt_thread_pool_submit_batch (xp->gv->thread_pool, nn_xpack_send1_batchjob, xp, arg.locs, sizeof (*arg.locs), arg.n);
+  if (arg.locs != arg.locs_inline)
+    ddsrt_free (arg.locs);
+  return arg.n;
 }
 
 static void nn_xpack_send_real (struct nn_xpack *xp)
@@ -1141,14 +1155,7 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
       }
       else
       {
-        ddsrt_atomic_st32 (&xp->calls, 1);
-        calls = addrset_forall_count (xp->dstaddr.all.as, nn_xpack_send1_threaded, xp);
-        /* Wait for the thread pool to complete the write; if we're the one
-           decrementing "calls" to 0, all of the work has been completed and
-           none of the threads will be posting; else some thread will be
-           posting it and we had better wait for it */
-        if (ddsrt_atomic_dec32_ov (&xp->calls) != 1)
-          ddsi_sem_wait (&xp->sem);
+        calls = nn_xpack_send1_threaded (xp, xp->dstaddr.all.as);
       }
       unref_addrset (xp->dstaddr.all.as);
     }
@@ -1169,6 +1176,10 @@ static void nn_xpack_send_real (struct nn_xpack *xp)
   {
     GVLOG (DDS_LC_TRAFFIC, "traffic-xmit (%lu) %"PRIu32"\n", (unsigned long) calls, xp->msg_len.length);
   }
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+  if (xp->tlat != 0)
+    (void) ddsi_latency_stats_lap (DDSI_LATENCY_SEND, xp->tlat);
+#endif
   nn_xmsg_chain_release (xp->gv, &xp->included_msgs);
   nn_xpack_reinit (xp);
 }
@@ -1315,7 +1326,7 @@ static int nn_xpack_mayaddmsg (const struct nn_xpack *xp, const struct nn_xmsg *
   if (xp->niov + NN_XMSG_MAX_SUBMESSAGE_IOVECS > NN_XMSG_MAX_MESSAGE_IOVECS)
     return 0;
 
-  payload_size = m->refd_payload ? (unsigned) m->refd_payload_iov.iov_len : 0;
+  payload_size = (unsigned) m->refd_payload_size;
 
   /* Check if max message size exceeded */
 
@@ -1370,7 +1381,7 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
      aligned all the time, we don't need to check for padding here. */
   assert ((xp->msg_len.length % 4) == 0);
   assert ((m->sz % 4) == 0);
-  assert (m->refd_payload == NULL || (m->refd_payload_iov.iov_len % 4) == 0);
+  assert ((m->refd_payload_size % 4) == 0);
 
   if (xp->iov == NULL)
     xp->iov = ddsrt_malloc (NN_XMSG_MAX_MESSAGE_IOVECS * sizeof (*xp->iov));
@@ -1505,12 +1516,9 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
      should've taken care of proper alignment for the payload.  The
      ref'd payload is always at some weird address, so no chance of
      merging iovecs here. */
-  if (m->refd_payload)
-  {
-    xp->iov[niov] = m->refd_payload_iov;
-    sz += m->refd_payload_iov.iov_len;
-    niov++;
-  }
+  for (uint32_t i = 0; i < m->refd_payload_niov; i++)
+    xp->iov[niov++] = m->refd_payload_iov[i];
+  sz += m->refd_payload_size;
 
   /* Shouldn't've overrun iov, and shouldn't've tried to add a
      submessage that is too large for a message ... but the latter
@@ -1535,12 +1543,90 @@ int nn_xpack_addmsg (struct nn_xpack *xp, struct nn_xmsg *m, const uint32_t flag
   {
     xp->call_flags = flags;
     nn_xmsg_chain_add (&xp->included_msgs, m);
+#ifdef DDSI_INCLUDE_LATENCY_STATS
+    if (xp->tlat == 0 && m->kind == NN_XMSG_KIND_DATA && gv->config.latency_stats && !is_builtin_entityid (m->kindspecific.data.wrguid.entityid, NN_VENDORID_ECLIPSE))
+      xp->tlat = ddsrt_time_monotonic ().v;
+#endif
     GVTRACE (" => now niov %d sz %"PRIuSIZE"\n", (int) niov, sz);
   }
 
   return result;
 }
 
+struct xpack_dst_sortkey {
+  struct nn_xmsg *m;
+  enum nn_xmsg_dstmode dstmode;
+  nn_locator_t loc;
+  const struct addrset *as_group;
+  size_t idx;
+};
+
+static int compare_xpack_dst_sortkey (const void *va, const void *vb)
+{
+  const struct xpack_dst_sortkey *a = va;
+  const struct xpack_dst_sortkey *b = vb;
+  int c;
+  if (a->dstmode != b->dstmode)
+    return (a->dstmode < b->dstmode) ? -1 : 1;
+  else if ((c = compare_locators (&a->loc, &b->loc)) != 0)
+    return c;
+  else if (a->as_group != b->as_group)
+    return ((uintptr_t) a->as_group < (uintptr_t) b->as_group) ? -1 : 1;
+  else if ((c = memcmp (&a->m->data->dst.guid_prefix, &b->m->data->dst.guid_prefix, sizeof (a->m->data->dst.guid_prefix))) != 0)
+    return c;
+  else if ((c = memcmp (&a->m->data->src.guid_prefix, &b->m->data->src.guid_prefix, sizeof (a->m->data->src.guid_prefix))) != 0)
+    return c;
+  else
+    return (a->idx == b->idx) ? 0 : (a->idx < b->idx) ? -1 : 1;
+}
+
+void nn_xpack_addmsgs_by_dst (struct nn_xpack *xp, struct nn_xmsg **ms, size_t n)
+{
+  /* Messages for the same destination can only be combined into a single
+     RTPS message if they are added consecutively, so order them on
+     destination address first, then on destination and source participant
+     to minimise the number of INFO_DST/INFO_SRC submessages.  Messages with
+     the same key retain their original order.  For a destination set, any
+     address in it will do as a key: addrset_eq_onesidederr only considers
+     singleton sets equal anyway. */
+  struct xpack_dst_sortkey *keys;
+  if (n == 0)
+    return;
+  else if (n == 1)
+  {
+    nn_xpack_addmsg (xp, ms[0], 0);
+    return;
+  }
+  keys = ddsrt_malloc (n * sizeof (*keys));
+  for (size_t i = 0; i < n; i++)
+  {
+    struct nn_xmsg * const m = ms[i];
+    keys[i].m = m;
+    keys[i].dstmode = m->dstmode;
+    keys[i].idx = i;
+    keys[i].as_group = NULL;
+    switch (m->dstmode)
+    {
+      case NN_XMSG_DST_UNSET:
+        assert (0);
+        memset (&keys[i].loc, 0, sizeof (keys[i].loc));
+        break;
+      case NN_XMSG_DST_ONE:
+        keys[i].loc = m->dstaddr.one.loc;
+        break;
+      case NN_XMSG_DST_ALL:
+        if (m->dstaddr.all.as == NULL || (!addrset_any_uc (m->dstaddr.all.as, &keys[i].loc) && !addrset_any_mc (m->dstaddr.all.as, &keys[i].loc)))
+          memset (&keys[i].loc, 0, sizeof (keys[i].loc));
+        keys[i].as_group = m->dstaddr.all.as_group;
+        break;
+    }
+  }
+  qsort (keys, n, sizeof (*keys), compare_xpack_dst_sortkey);
+  for (size_t i = 0; i < n; i++)
+    nn_xpack_addmsg (xp, keys[i].m, 0);
+  ddsrt_free (keys);
+}
+
 int64_t nn_xpack_maxdelay (const struct nn_xpack *xp)
 {
   return xp->maxdelay;
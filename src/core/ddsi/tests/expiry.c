@@ -0,0 +1,104 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stddef.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsi/ddsi_expiry.h"
+
+struct elem {
+  struct expiry_node e;
+  ddsrt_mtime_t t;
+  bool registered;
+};
+
+static void check_due (struct expiry_adm *adm, struct elem *es, size_t n, ddsrt_mtime_t tnow)
+{
+  /* drain everything due at tnow: all of it must have expired, and anything
+     that expired more than a granularity ago must have been returned */
+  struct expiry_node *node;
+  ddsrt_mtime_t tnext;
+  while ((node = expiry_next_due (adm, tnow, &tnext)) != NULL)
+  {
+    struct elem *e = (struct elem *) node;
+    CU_ASSERT_FATAL (e->registered);
+    CU_ASSERT_FATAL (e->t.v <= tnow.v);
+    expiry_remove (adm, &e->e);
+    e->registered = false;
+  }
+  CU_ASSERT_FATAL (tnext.v > tnow.v || tnext.v == DDS_NEVER);
+  for (size_t i = 0; i < n; i++)
+  {
+    if (es[i].registered)
+    {
+      CU_ASSERT_FATAL (es[i].t.v > tnow.v - adm->granularity);
+      CU_ASSERT_FATAL (tnext.v <= es[i].t.v + adm->granularity - 1);
+    }
+  }
+}
+
+CU_Test (ddsi_expiry, random)
+{
+  const dds_duration_t gran[] = { 0, 1, DDS_USECS (10), DDS_MSECS (1) };
+  const size_t n = 1000;
+  struct elem *es = ddsrt_malloc (n * sizeof (*es));
+  for (size_t g = 0; g < sizeof (gran) / sizeof (gran[0]); g++)
+  {
+    struct expiry_adm adm;
+    ddsrt_mtime_t tnow = { DDS_SECS (1) };
+    expiry_adm_init (&adm, gran[g]);
+    for (size_t i = 0; i < n; i++)
+      es[i].registered = false;
+    for (int round = 0; round < 10000; round++)
+    {
+      struct elem * const e = &es[ddsrt_random () % n];
+      const ddsrt_mtime_t t = { tnow.v + (int64_t) (ddsrt_random () % DDS_MSECS (20)) };
+      switch (ddsrt_random () % 3)
+      {
+        case 0:
+          if (!e->registered)
+          {
+            e->t = t;
+            const ddsrt_mtime_t tdue = expiry_insert (&adm, &e->e, t);
+            CU_ASSERT_FATAL (tdue.v >= t.v && tdue.v < t.v + adm.granularity);
+            e->registered = true;
+          }
+          break;
+        case 1:
+          if (e->registered)
+          {
+            expiry_remove (&adm, &e->e);
+            e->registered = false;
+          }
+          break;
+        case 2:
+          if (e->registered)
+          {
+            e->t = t;
+            expiry_move (&adm, &e->e, t);
+          }
+          break;
+      }
+      if (round % 100 == 0)
+      {
+        tnow.v += (int64_t) (ddsrt_random () % DDS_MSECS (5));
+        check_due (&adm, es, n, tnow);
+      }
+    }
+    check_due (&adm, es, n, DDSRT_MTIME_NEVER);
+    CU_ASSERT_FATAL (expiry_adm_empty (&adm));
+    expiry_adm_fini (&adm);
+  }
+  ddsrt_free (es);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsi/ddsi_latency_stats.h"
+
+static int compare_int64 (const void *va, const void *vb)
+{
+  const int64_t *a = va, *b = vb;
+  return (*a == *b) ? 0 : (*a < *b) ? -1 : 1;
+}
+
+CU_Test (ddsi_latency_stats, small_values_exact)
+{
+  /* values below 16 each have their own bucket */
+  struct ddsi_latency_hist *h = ddsrt_malloc (sizeof (*h));
+  ddsi_latency_hist_init (h);
+  CU_ASSERT (ddsi_latency_hist_percentile (h, 0.5) == 0);
+  for (int64_t v = 1; v <= 10; v++)
+    ddsi_latency_hist_add (h, v);
+  CU_ASSERT (h->count == 10);
+  CU_ASSERT (h->sum == 55);
+  CU_ASSERT (h->min == 1);
+  CU_ASSERT (h->max == 10);
+  CU_ASSERT (ddsi_latency_hist_percentile (h, 0.0) == 1);
+  CU_ASSERT (ddsi_latency_hist_percentile (h, 0.5) == 5);
+  CU_ASSERT (ddsi_latency_hist_percentile (h, 0.9) == 9);
+  CU_ASSERT (ddsi_latency_hist_percentile (h, 0.91) == 10);
+  CU_ASSERT (ddsi_latency_hist_percentile (h, 1.0) == 10);
+  ddsrt_free (h);
+}
+
+CU_Test (ddsi_latency_stats, out_of_range)
+{
+  struct ddsi_latency_hist *h = ddsrt_malloc (sizeof (*h));
+  ddsi_latency_hist_init (h);
+  ddsi_latency_hist_add (h, -5);
+  ddsi_latency_hist_add (h, INT64_MAX);
+  CU_ASSERT (h->count == 2);
+  CU_ASSERT (h->buckets[0] == 1);
+  CU_ASSERT (h->buckets[DDSI_LATENCY_HIST_NBUCKETS - 1] == 1);
+  /* negative values count as 0, large ones as the largest value covered */
+  CU_ASSERT (ddsi_latency_hist_percentile (h, 0.5) == 0);
+  CU_ASSERT (ddsi_latency_hist_percentile (h, 1.0) == (INT64_C (1) << DDSI_LATENCY_HIST_MAXBITS) - 1);
+  ddsrt_free (h);
+}
+
+CU_Test (ddsi_latency_stats, percentile_accuracy)
+{
+  /* percentiles from the histogram must be within the bucket resolution of
+     (and never below) the exact ones, for values spread over many orders of
+     magnitude */
+  const uint32_t n = 100000;
+  const double ps[] = { 0.01, 0.1, 0.5, 0.9, 0.99, 0.999 };
+  int64_t *vs = ddsrt_malloc (n * sizeof (*vs));
+  struct ddsi_latency_hist *h = ddsrt_malloc (sizeof (*h));
+  ddsi_latency_hist_init (h);
+  for (uint32_t i = 0; i < n; i++)
+  {
+    vs[i] = (int64_t) (ddsrt_random () >> (ddsrt_random () % 32));
+    ddsi_latency_hist_add (h, vs[i]);
+  }
+  qsort (vs, n, sizeof (*vs), compare_int64);
+  CU_ASSERT (h->min == vs[0]);
+  CU_ASSERT (h->max == vs[n - 1]);
+  for (size_t i = 0; i < sizeof (ps) / sizeof (ps[0]); i++)
+  {
+    /* allow for rounding of ps[i] * n in either direction */
+    const uint32_t k = (uint32_t) (ps[i] * n) - 1;
+    const int64_t approx = ddsi_latency_hist_percentile (h, ps[i]);
+    CU_ASSERT (approx >= vs[k]);
+    CU_ASSERT (approx <= vs[k + 1] + vs[k + 1] / 16 + 1);
+  }
+  ddsrt_free (h);
+  ddsrt_free (vs);
+}
+
+CU_Test (ddsi_latency_stats, merge)
+{
+  struct ddsi_latency_hist *a = ddsrt_malloc (sizeof (*a));
+  struct ddsi_latency_hist *b = ddsrt_malloc (sizeof (*b));
+  struct ddsi_latency_hist *c = ddsrt_malloc (sizeof (*c));
+  ddsi_latency_hist_init (a);
+  ddsi_latency_hist_init (b);
+  ddsi_latency_hist_init (c);
+  for (int64_t v = 0; v < 100000; v += 7)
+  {
+    ddsi_latency_hist_add ((v % 2) ? a : b, v);
+    ddsi_latency_hist_add (c, v);
+  }
+  ddsi_latency_hist_merge (a, b);
+  CU_ASSERT (memcmp (a, c, sizeof (*a)) == 0);
+  ddsrt_free (c);
+  ddsrt_free (b);
+  ddsrt_free (a);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsi/ddsi_xqos.h"
+#include "dds/ddsi/q_qosmatch.h"
+#include "dds/ddsi/ddsi_partition_match.h"
+
+static void set_partitions (dds_qos_t *qos, uint32_t n, const char **names)
+{
+  ddsi_xqos_init_empty (qos);
+  if (names == NULL)
+    return;
+  qos->present |= QP_PARTITION;
+  qos->partition.n = n;
+  qos->partition.strs = ddsrt_malloc ((n ? n : 1) * sizeof (*qos->partition.strs));
+  for (uint32_t i = 0; i < n; i++)
+    qos->partition.strs[i] = ddsrt_strdup (names[i]);
+}
+
+CU_Test (ddsi_partition_match, compare)
+{
+  /* all combinations of a set of partition lists, matched with the interned sets must
+     give the same result as matching them directly */
+  static const char *p0[] = { "" };
+  static const char *p1[] = { "a" };
+  static const char *p2[] = { "a", "b" };
+  static const char *p3[] = { "b", "a" };
+  static const char *p4[] = { "*" };
+  static const char *p5[] = { "a*" };
+  static const char *p6[] = { "?" };
+  static const char *p7[] = { "x", "a?c" };
+  static const char *p8[] = { "abc" };
+  static const char *p9[] = { "a*c", "b" };
+  static const char *p10[] = { "*b*" };
+  static const char *p11[] = { "ab", "a*" };
+  static const char *p12[] = { "??*" };
+  static const struct { uint32_t n; const char **names; } ps[] = {
+    { 0, NULL }, { 0, p0 }, { 1, p0 }, { 1, p1 }, { 2, p2 }, { 2, p3 }, { 1, p4 },
+    { 1, p5 }, { 1, p6 }, { 2, p7 }, { 1, p8 }, { 2, p9 }, { 1, p10 }, { 2, p11 }, { 1, p12 }
+  };
+  const uint32_t n = (uint32_t) (sizeof (ps) / sizeof (ps[0]));
+  struct ddsi_partition_match_cache *pmc = ddsi_partition_match_cache_new ();
+  dds_qos_t qos[sizeof (ps) / sizeof (ps[0])];
+  struct ddsi_partition_set *sets[sizeof (ps) / sizeof (ps[0])];
+  for (uint32_t i = 0; i < n; i++)
+  {
+    set_partitions (&qos[i], ps[i].n, ps[i].names);
+    sets[i] = ddsi_partition_set_ref (pmc, &qos[i]);
+  }
+  /* twice, the second time all results come from the cache */
+  for (int round = 0; round < 2; round++)
+  {
+    for (uint32_t i = 0; i < n; i++)
+      for (uint32_t j = 0; j < n; j++)
+        CU_ASSERT_FATAL (ddsi_partition_sets_match (pmc, sets[i], sets[j]) == (partitions_match_p (&qos[i], &qos[j]) != 0));
+  }
+  for (uint32_t i = 0; i < n; i++)
+  {
+    ddsi_partition_set_unref (pmc, sets[i]);
+    ddsi_xqos_fini (&qos[i]);
+  }
+  ddsi_partition_match_cache_free (pmc);
+}
+
+CU_Test (ddsi_partition_match, intern)
+{
+  /* equal lists of partition names map to the same set, the default partition is the
+     same as an empty partition name, and the order of the names matters for interning
+     but not for matching */
+  static const char *p0[] = { "" };
+  static const char *p1[] = { "a", "b*" };
+  static const char *p2[] = { "b*", "a" };
+  struct ddsi_partition_match_cache *pmc = ddsi_partition_match_cache_new ();
+  dds_qos_t qos[5];
+  struct ddsi_partition_set *sets[5];
+  set_partitions (&qos[0], 0, NULL);
+  set_partitions (&qos[1], 1, p0);
+  set_partitions (&qos[2], 2, p1);
+  set_partitions (&qos[3], 2, p1);
+  set_partitions (&qos[4], 2, p2);
+  for (int i = 0; i < 5; i++)
+    sets[i] = ddsi_partition_set_ref (pmc, &qos[i]);
+  CU_ASSERT (sets[0] == sets[1]);
+  CU_ASSERT (sets[2] == sets[3]);
+  CU_ASSERT (sets[2] != sets[4]);
+  CU_ASSERT (ddsi_partition_sets_match (pmc, sets[2], sets[3]));
+  CU_ASSERT (ddsi_partition_sets_match (pmc, sets[2], sets[4]));
+  CU_ASSERT (!ddsi_partition_sets_match (pmc, sets[0], sets[2]));
+
+  /* a set remains interned until the last reference is released, a new one for the
+     same names then gets a new identity, which must not pick up stale cached results */
+  for (int i = 0; i < 5; i++)
+    ddsi_partition_set_unref (pmc, sets[i]);
+  ddsi_xqos_fini (&qos[3]);
+  set_partitions (&qos[3], 1, p0);
+  sets[2] = ddsi_partition_set_ref (pmc, &qos[2]);
+  sets[3] = ddsi_partition_set_ref (pmc, &qos[3]);
+  CU_ASSERT (!ddsi_partition_sets_match (pmc, sets[2], sets[3]));
+  ddsi_partition_set_unref (pmc, sets[2]);
+  ddsi_partition_set_unref (pmc, sets[3]);
+  for (int i = 0; i < 5; i++)
+    ddsi_xqos_fini (&qos[i]);
+  ddsi_partition_match_cache_free (pmc);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsi/q_radmin.h"
+
+/* Messages are kept alive for a while after being committed, by holding an
+   extra reference like the defragmenter, reorder admin and delivery queue do,
+   so that the receive buffers actually get used up and replaced */
+#define RETAIN 64
+
+static void rmsg_unref (struct nn_rmsg *rmsg)
+{
+  if (rmsg && ddsrt_atomic_dec32_nv (&rmsg->refcount) == 0)
+    nn_rmsg_free (rmsg);
+}
+
+static uint32_t receive_packets (struct nn_rbufpool *rbp, uint32_t npackets)
+{
+  struct nn_rmsg *retained[RETAIN];
+  uint32_t sum = 0;
+  memset (retained, 0, sizeof (retained));
+  for (uint32_t i = 0; i < npackets; i++)
+  {
+    struct nn_rmsg *rmsg = nn_rmsg_new (rbp);
+    CU_ASSERT_FATAL (rmsg != NULL);
+    /* packet sizes from small to a fragment-sized 1500 bytes and beyond */
+    const uint32_t size = 256 + (i % 16) * 256;
+    unsigned char *payload = NN_RMSG_PAYLOAD (rmsg);
+    memset (payload, (int) (i & 0xff), size);
+    nn_rmsg_setsize (rmsg, size);
+    for (uint32_t j = 0; j < size; j += 64)
+      sum += payload[j];
+    ddsrt_atomic_inc32 (&rmsg->refcount);
+    nn_rmsg_commit (rmsg);
+    rmsg_unref (retained[i % RETAIN]);
+    retained[i % RETAIN] = rmsg;
+  }
+  for (uint32_t i = 0; i < RETAIN; i++)
+    rmsg_unref (retained[i]);
+  return sum;
+}
+
+CU_Test (ddsi_radmin, rbufpool_arena)
+{
+  /* an arena that is too small for all buffers in use must fall back to the heap
+     and continue to work, all buffers must be back in the arena when freeing it */
+  struct ddsrt_log_cfg logcfg;
+  dds_log_cfg_init (&logcfg, 0, 0, NULL, NULL);
+  static const struct { uint32_t size; bool arena; bool heap; } cases[] = {
+    { 0, false, true },                /* no arena */
+    { 1, false, true },                /* too small for a single buffer */
+    { 2 * 1024 * 1024, true, true },   /* a single buffer, more are needed */
+    { 16 * 1024 * 1024, true, false }  /* enough for all buffers ever in use */
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+  {
+    struct nn_rbufpool *rbp = nn_rbufpool_new (&logcfg, 1024 * 1024, 128 * 1024, cases[i].size);
+    struct nn_rbufpool_stats st;
+    CU_ASSERT_FATAL (rbp != NULL);
+    nn_rbufpool_setowner (rbp, ddsrt_thread_self ());
+    (void) receive_packets (rbp, 10000);
+    nn_rbufpool_get_stats (rbp, &st);
+    CU_ASSERT ((st.arena_size > 0) == cases[i].arena);
+    CU_ASSERT ((st.n_arena_allocs > 0) == cases[i].arena);
+    CU_ASSERT ((st.n_heap_allocs > 0) == cases[i].heap);
+    nn_rbufpool_free (rbp);
+  }
+}
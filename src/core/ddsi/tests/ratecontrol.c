@@ -0,0 +1,158 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdint.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsi/ddsi_ratecontrol.h"
+
+/* Without the RTT of the reader giving the feedback, the rate is adjusted at
+   most once per 10ms; the bucket holds at least 64kB */
+#define MIN_BURST 65536
+
+static ddsrt_mtime_t t (int64_t ms)
+{
+  ddsrt_mtime_t x = { DDS_SECS (1000) + DDS_MSECS (ms) };
+  return x;
+}
+
+CU_Test (ddsi_ratecontrol, init)
+{
+  struct ddsi_ratecontrol rc;
+
+  /* starts at the maximum rate */
+  ddsi_ratecontrol_init (&rc, 1000, 1000000, t (0));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 1e6);
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (0)) <= 0);
+  ddsi_ratecontrol_fini (&rc);
+
+  /* 0 means unbounded, which really is INT32_MAX */
+  ddsi_ratecontrol_init (&rc, 0, 0, t (0));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == (double) INT32_MAX);
+  ddsi_ratecontrol_fini (&rc);
+
+  /* minimum is clamped to the maximum */
+  ddsi_ratecontrol_init (&rc, 2000000, 1000000, t (0));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 1e6);
+  CU_ASSERT (!ddsi_ratecontrol_loss (&rc, 0, t (100)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 1e6);
+  ddsi_ratecontrol_fini (&rc);
+}
+
+CU_Test (ddsi_ratecontrol, delay)
+{
+  struct ddsi_ratecontrol rc;
+  ddsi_ratecontrol_init (&rc, 0, 1000000, t (0));
+
+  /* the initial burst may be sent without delay, going into debt by 10kB
+     means waiting 10ms at 1MB/s, less as time passes */
+  ddsi_ratecontrol_consume (&rc, MIN_BURST);
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (0)) <= 0);
+  ddsi_ratecontrol_consume (&rc, 10000);
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (0)) == DDS_MSECS (10) + 1);
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (4)) == DDS_MSECS (6) + 1);
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (10)) <= 0);
+
+  /* idle time doesn't accumulate beyond the burst size */
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (10000)) <= 0);
+  ddsi_ratecontrol_consume (&rc, MIN_BURST + 1000);
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (10000)) == DDS_MSECS (1) + 1);
+
+  /* retransmits count as well */
+  ddsi_ratecontrol_consume (&rc, 1000);
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (10000)) == DDS_MSECS (2) + 1);
+  ddsi_ratecontrol_fini (&rc);
+}
+
+CU_Test (ddsi_ratecontrol, loss)
+{
+  struct ddsi_ratecontrol rc;
+  ddsi_ratecontrol_init (&rc, 300000, 1000000, t (0));
+
+  /* halved at most once per adjustment interval */
+  CU_ASSERT (!ddsi_ratecontrol_loss (&rc, 0, t (5)));
+  CU_ASSERT (ddsi_ratecontrol_loss (&rc, 0, t (10)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 5e5);
+  CU_ASSERT (!ddsi_ratecontrol_loss (&rc, 0, t (15)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 5e5);
+
+  /* but never below the minimum */
+  CU_ASSERT (ddsi_ratecontrol_loss (&rc, 0, t (20)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 3e5);
+  CU_ASSERT (!ddsi_ratecontrol_loss (&rc, 0, t (30)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 3e5);
+
+  /* a lower rate means a longer delay for the same debt */
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (10000)) <= 0);
+  ddsi_ratecontrol_consume (&rc, MIN_BURST + 3000);
+  CU_ASSERT (ddsi_ratecontrol_delay (&rc, t (10000)) == DDS_MSECS (10) + 1);
+  ddsi_ratecontrol_fini (&rc);
+}
+
+CU_Test (ddsi_ratecontrol, ack)
+{
+  struct ddsi_ratecontrol rc;
+  ddsi_ratecontrol_init (&rc, 0, 1000000, t (0));
+  CU_ASSERT (ddsi_ratecontrol_loss (&rc, 0, t (10)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 5e5);
+
+  /* no increase while the rate isn't limiting the writer */
+  CU_ASSERT (!ddsi_ratecontrol_ack (&rc, true, 0, t (20)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 5e5);
+
+  /* once it is, increased by 1/8th when new data is acked, at most once
+     per adjustment interval */
+  ddsi_ratecontrol_consume (&rc, 2 * MIN_BURST);
+  CU_ASSERT (!ddsi_ratecontrol_ack (&rc, false, 0, t (20)));
+  CU_ASSERT (ddsi_ratecontrol_ack (&rc, true, 0, t (20)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 5.625e5);
+  ddsi_ratecontrol_consume (&rc, 2 * MIN_BURST);
+  CU_ASSERT (!ddsi_ratecontrol_ack (&rc, true, 0, t (25)));
+  CU_ASSERT (ddsi_ratecontrol_ack (&rc, true, 0, t (30)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 5.625e5 * 1.125);
+
+  /* but never beyond the maximum */
+  int64_t ms = 30;
+  for (int i = 0; i < 16; i++)
+  {
+    ms += 10;
+    ddsi_ratecontrol_consume (&rc, 100 * MIN_BURST);
+    (void) ddsi_ratecontrol_delay (&rc, t (ms));
+    (void) ddsi_ratecontrol_ack (&rc, true, 0, t (ms));
+    CU_ASSERT (ddsi_ratecontrol_rate (&rc) <= 1e6);
+  }
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 1e6);
+  ddsi_ratecontrol_consume (&rc, 100 * MIN_BURST);
+  CU_ASSERT (!ddsi_ratecontrol_ack (&rc, true, 0, t (ms + 10)));
+  ddsi_ratecontrol_fini (&rc);
+}
+
+CU_Test (ddsi_ratecontrol, rtt)
+{
+  /* adjusted at most once per round-trip time of the reader giving the
+     feedback, but no more often than once per millisecond */
+  struct ddsi_ratecontrol rc;
+  ddsi_ratecontrol_init (&rc, 0, 1000000, t (0));
+  CU_ASSERT (!ddsi_ratecontrol_loss (&rc, DDS_MSECS (50), t (49)));
+  CU_ASSERT (ddsi_ratecontrol_loss (&rc, DDS_MSECS (50), t (50)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 5e5);
+  CU_ASSERT (ddsi_ratecontrol_loss (&rc, DDS_MSECS (2), t (52)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 2.5e5);
+  CU_ASSERT (!ddsi_ratecontrol_loss (&rc, DDS_USECS (10), t (52)));
+  CU_ASSERT (ddsi_ratecontrol_loss (&rc, DDS_USECS (10), t (53)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 1.25e5);
+
+  ddsi_ratecontrol_consume (&rc, 2 * MIN_BURST);
+  CU_ASSERT (!ddsi_ratecontrol_ack (&rc, true, DDS_MSECS (20), t (72)));
+  CU_ASSERT (ddsi_ratecontrol_ack (&rc, true, DDS_MSECS (20), t (73)));
+  CU_ASSERT (ddsi_ratecontrol_rate (&rc) == 1.25e5 * 1.125);
+  ddsi_ratecontrol_fini (&rc);
+}
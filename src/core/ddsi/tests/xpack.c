@@ -0,0 +1,249 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <string.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/endian.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_tran.h"
+#include "dds/ddsi/q_bswap.h"
+#include "dds/ddsi/q_misc.h"
+#include "dds/ddsi/q_xmsg.h"
+
+/* The packets sent are captured by a fake connection, that only keeps the
+   sequence of submessages (id and for INFO_DST the destination, for the
+   others the count/readerId) of each packet for checking */
+#define MAX_PACKETS 16
+#define MAX_SUBMSGS 32
+
+struct submsg {
+  SubmessageKind_t id;
+  ddsi_guid_prefix_t dst;
+  uint32_t tag;
+};
+
+struct packet {
+  nn_locator_t loc;
+  int nsubmsgs;
+  struct submsg submsgs[MAX_SUBMSGS];
+};
+
+struct capture {
+  struct ddsi_tran_conn conn;
+  int npackets;
+  struct packet packets[MAX_PACKETS];
+};
+
+static ssize_t capture_write (ddsi_tran_conn_t conn, const nn_locator_t *dst, size_t niov, const ddsrt_iovec_t *iov, uint32_t flags)
+{
+  struct capture * const cap = (struct capture *) conn;
+  unsigned char buf[65536];
+  size_t len = 0;
+  (void) flags;
+  for (size_t i = 0; i < niov; i++)
+  {
+    CU_ASSERT_FATAL (len + iov[i].iov_len <= sizeof (buf));
+    memcpy (buf + len, iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  CU_ASSERT_FATAL (cap->npackets < MAX_PACKETS);
+  struct packet * const p = &cap->packets[cap->npackets++];
+  p->loc = *dst;
+  p->nsubmsgs = 0;
+  CU_ASSERT_FATAL (len >= RTPS_MESSAGE_HEADER_SIZE && memcmp (buf, "RTPS", 4) == 0);
+  size_t off = RTPS_MESSAGE_HEADER_SIZE;
+  while (off < len)
+  {
+    const SubmessageHeader_t *hdr = (const SubmessageHeader_t *) (buf + off);
+    CU_ASSERT_FATAL ((hdr->flags & SMFLAG_ENDIANNESS) == (DDSRT_ENDIAN == DDSRT_LITTLE_ENDIAN ? SMFLAG_ENDIANNESS : 0));
+    CU_ASSERT_FATAL (p->nsubmsgs < MAX_SUBMSGS);
+    struct submsg * const sm = &p->submsgs[p->nsubmsgs++];
+    memset (sm, 0, sizeof (*sm));
+    sm->id = (SubmessageKind_t) hdr->submessageId;
+    switch (sm->id)
+    {
+      case SMID_INFO_DST:
+        sm->dst = nn_ntoh_guid_prefix (((const InfoDST_t *) hdr)->guid_prefix);
+        break;
+      case SMID_HEARTBEAT:
+        sm->tag = (uint32_t) ((const Heartbeat_t *) hdr)->count;
+        break;
+      case SMID_ACKNACK:
+        sm->tag = ((const AckNack_t *) hdr)->readerId.u;
+        break;
+      default:
+        break;
+    }
+    off += RTPS_SUBMESSAGE_HEADER_SIZE + hdr->octetsToNextHeader;
+  }
+  CU_ASSERT_FATAL (off == len);
+  return (ssize_t) len;
+}
+
+static struct ddsi_domaingv *gv;
+static struct capture *cap;
+static struct nn_xpack *xp;
+
+static void xpack_init (void)
+{
+  /* only the fields looked at by the xpack matter */
+  gv = ddsrt_calloc (1, sizeof (*gv));
+  gv->config.max_msg_size = 14720;
+  gv->xmsgpool = nn_xmsgpool_new ();
+  cap = ddsrt_calloc (1, sizeof (*cap));
+  cap->conn.m_base.gv = gv;
+  cap->conn.m_write_fn = capture_write;
+  cap->conn.m_connless = true;
+  xp = nn_xpack_new (&cap->conn, 0, false);
+}
+
+static void xpack_fini (void)
+{
+  nn_xpack_free (xp);
+  nn_xmsgpool_free (gv->xmsgpool);
+  ddsrt_free (cap);
+  ddsrt_free (gv);
+}
+
+static const ddsi_guid_prefix_t src = { .u = { 1, 1, 1 } };
+static const ddsi_guid_prefix_t dstA = { .u = { 2, 2, 2 } };
+static const ddsi_guid_prefix_t dstB = { .u = { 3, 3, 3 } };
+
+static nn_locator_t mkloc (uint32_t port)
+{
+  nn_locator_t loc;
+  memset (&loc, 0, sizeof (loc));
+  loc.kind = NN_LOCATOR_KIND_UDPv4;
+  loc.address[12] = 127;
+  loc.address[15] = 1;
+  loc.port = port;
+  return loc;
+}
+
+static struct nn_xmsg *mkheartbeat (const ddsi_guid_prefix_t *dst, const nn_locator_t *loc, int32_t count)
+{
+  struct nn_xmsg_marker sm;
+  struct nn_xmsg *m = nn_xmsg_new (gv->xmsgpool, &src, 0, NN_XMSG_KIND_CONTROL);
+  nn_xmsg_setdst1 (m, dst, loc);
+  Heartbeat_t *hb = nn_xmsg_append (m, &sm, sizeof (*hb));
+  nn_xmsg_submsg_init (m, sm, SMID_HEARTBEAT);
+  hb->readerId.u = 0;
+  hb->writerId.u = 0x102;
+  hb->firstSN = toSN (1);
+  hb->lastSN = toSN (10);
+  hb->count = count;
+  nn_xmsg_submsg_setnext (m, sm);
+  return m;
+}
+
+static struct nn_xmsg *mkacknack (const ddsi_guid_prefix_t *dst, const nn_locator_t *loc, uint32_t rdid)
+{
+  struct nn_xmsg_marker sm;
+  struct nn_xmsg *m = nn_xmsg_new (gv->xmsgpool, &src, 0, NN_XMSG_KIND_CONTROL);
+  nn_xmsg_setdst1 (m, dst, loc);
+  AckNack_t *an = nn_xmsg_append (m, &sm, ACKNACK_SIZE (0));
+  nn_xmsg_submsg_init (m, sm, SMID_ACKNACK);
+  an->readerId.u = rdid;
+  an->writerId.u = 0x102;
+  an->readerSNState.bitmap_base = toSN (11);
+  an->readerSNState.numbits = 0;
+  nn_xmsg_submsg_setnext (m, sm);
+  return m;
+}
+
+static bool is_submsg (const struct submsg *sm, SubmessageKind_t id, uint32_t tag)
+{
+  return sm->id == id && sm->tag == tag;
+}
+
+static bool is_info_dst (const struct submsg *sm, const ddsi_guid_prefix_t *dst)
+{
+  return sm->id == SMID_INFO_DST && memcmp (&sm->dst, dst, sizeof (*dst)) == 0;
+}
+
+CU_Test (ddsi_xpack, control_msgs_same_locator, .init = xpack_init, .fini = xpack_fini)
+{
+  /* heartbeats and acknacks for two participants at the same address, as they
+     come out of the event queue: interleaved; they must be grouped per
+     participant, in their original order, in a single packet */
+  const nn_locator_t loc = mkloc (7400);
+  struct nn_xmsg *ms[6];
+  ms[0] = mkheartbeat (&dstA, &loc, 1);
+  ms[1] = mkheartbeat (&dstB, &loc, 2);
+  ms[2] = mkacknack (&dstA, &loc, 0x107);
+  ms[3] = mkacknack (&dstB, &loc, 0x207);
+  ms[4] = mkheartbeat (&dstA, &loc, 3);
+  ms[5] = mkacknack (&dstB, &loc, 0x307);
+  nn_xpack_addmsgs_by_dst (xp, ms, 6);
+  nn_xpack_send (xp, true);
+
+  CU_ASSERT_FATAL (cap->npackets == 1);
+  const struct packet *p = &cap->packets[0];
+  CU_ASSERT_FATAL (p->nsubmsgs == 8);
+  CU_ASSERT (is_info_dst (&p->submsgs[0], &dstA));
+  CU_ASSERT (is_submsg (&p->submsgs[1], SMID_HEARTBEAT, 1));
+  CU_ASSERT (is_submsg (&p->submsgs[2], SMID_ACKNACK, 0x107));
+  CU_ASSERT (is_submsg (&p->submsgs[3], SMID_HEARTBEAT, 3));
+  CU_ASSERT (is_info_dst (&p->submsgs[4], &dstB));
+  CU_ASSERT (is_submsg (&p->submsgs[5], SMID_HEARTBEAT, 2));
+  CU_ASSERT (is_submsg (&p->submsgs[6], SMID_ACKNACK, 0x207));
+  CU_ASSERT (is_submsg (&p->submsgs[7], SMID_ACKNACK, 0x307));
+}
+
+CU_Test (ddsi_xpack, control_msgs_unsorted, .init = xpack_init, .fini = xpack_fini)
+{
+  /* the same messages added one-by-one need an INFO_DST for each of them */
+  const nn_locator_t loc = mkloc (7400);
+  nn_xpack_addmsg (xp, mkheartbeat (&dstA, &loc, 1), 0);
+  nn_xpack_addmsg (xp, mkheartbeat (&dstB, &loc, 2), 0);
+  nn_xpack_addmsg (xp, mkacknack (&dstA, &loc, 0x107), 0);
+  nn_xpack_addmsg (xp, mkacknack (&dstB, &loc, 0x207), 0);
+  nn_xpack_send (xp, true);
+  CU_ASSERT_FATAL (cap->npackets == 1);
+  CU_ASSERT (cap->packets[0].nsubmsgs == 8);
+}
+
+CU_Test (ddsi_xpack, control_msgs_multiple_locators, .init = xpack_init, .fini = xpack_fini)
+{
+  /* messages for different addresses can't share a packet, but interleaving
+     them mustn't result in more than one packet per address */
+  const nn_locator_t locA = mkloc (7410), locB = mkloc (7411);
+  struct nn_xmsg *ms[6];
+  for (int i = 0; i < 6; i++)
+  {
+    if (i % 2)
+      ms[i] = mkheartbeat (&dstB, &locB, i);
+    else
+      ms[i] = mkacknack (&dstA, &locA, (uint32_t) i);
+  }
+  nn_xpack_addmsgs_by_dst (xp, ms, 6);
+  nn_xpack_send (xp, true);
+
+  CU_ASSERT_FATAL (cap->npackets == 2);
+  for (int k = 0; k < 2; k++)
+  {
+    const struct packet *p = &cap->packets[k];
+    const bool isA = (p->loc.port == locA.port);
+    CU_ASSERT (p->loc.port == (isA ? locA.port : locB.port));
+    CU_ASSERT_FATAL (p->nsubmsgs == 4);
+    CU_ASSERT (is_info_dst (&p->submsgs[0], isA ? &dstA : &dstB));
+    for (int i = 0; i < 3; i++)
+    {
+      if (isA)
+        CU_ASSERT (is_submsg (&p->submsgs[1 + i], SMID_ACKNACK, (uint32_t) (2 * i)));
+      else
+        CU_ASSERT (is_submsg (&p->submsgs[1 + i], SMID_HEARTBEAT, (uint32_t) (2 * i + 1)));
+    }
+  }
+  CU_ASSERT (cap->packets[0].loc.port != cap->packets[1].loc.port);
+}
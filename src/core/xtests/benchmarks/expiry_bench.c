@@ -0,0 +1,151 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/fibheap.h"
+#include "dds/ddsrt/circlist.h"
+#include "dds/ddsi/ddsi_expiry.h"
+
+/* Benchmark of the expiry administration for the deadline and lifespan
+   patterns against the fibheap and circular list that were used before:
+   many instances renewing their deadline (mostly moving to the most recent
+   bucket) and many samples registered and unregistered.
+
+   Usage: expiry_bench [NINSTANCES [NRENEWALS]] */
+
+struct bench_elem {
+  struct expiry_node e;
+  ddsrt_fibheap_node_t fhnode;
+  struct ddsrt_circlist_elem le;
+  ddsrt_mtime_t t;
+};
+
+static int compare_bench_elem (const void *va, const void *vb)
+{
+  const struct bench_elem *a = va;
+  const struct bench_elem *b = vb;
+  return (a->t.v == b->t.v) ? 0 : (a->t.v < b->t.v) ? -1 : 1;
+}
+
+static const ddsrt_fibheap_def_t bench_fhdef = DDSRT_FIBHEAPDEF_INITIALIZER (offsetof (struct bench_elem, fhnode), compare_bench_elem);
+
+int main (int argc, char **argv)
+{
+  const uint32_t ninst = (argc > 1) ? (uint32_t) atoi (argv[1]) : 500000;
+  const uint32_t nrenew = (argc > 2) ? (uint32_t) atoi (argv[2]) : 5000000;
+  if (ninst < 1000 || nrenew == 0)
+  {
+    fprintf (stderr, "usage: %s [NINSTANCES >= 1000 [NRENEWALS > 0]]\n", argv[0]);
+    return 2;
+  }
+  const dds_duration_t dur = DDS_MSECS (100), tstep = 50;
+  struct bench_elem *es = ddsrt_malloc (ninst * sizeof (*es));
+  ddsrt_mtime_t tnow;
+  dds_time_t t0, t1;
+
+  /* deadline: circular list vs buckets, for a small number of instances that
+     get renewed often and for many instances that get renewed rarely */
+  struct expiry_adm adm;
+  expiry_adm_init (&adm, DDS_MSECS (1));
+  const uint32_t ndeadline[] = { 1000, ninst };
+  for (size_t k = 0; k < sizeof (ndeadline) / sizeof (ndeadline[0]); k++)
+  {
+    const uint32_t nd = ndeadline[k];
+    struct ddsrt_circlist list;
+    ddsrt_circlist_init (&list);
+    tnow.v = DDS_SECS (1);
+    t0 = dds_time ();
+    for (uint32_t i = 0; i < nd; i++)
+    {
+      es[i].t.v = tnow.v + dur;
+      ddsrt_circlist_append (&list, &es[i].le);
+    }
+    for (uint32_t i = 0; i < nrenew; i++)
+    {
+      struct bench_elem * const e = &es[ddsrt_random () % nd];
+      tnow.v += tstep;
+      ddsrt_circlist_remove (&list, &e->le);
+      e->t.v = tnow.v + dur;
+      ddsrt_circlist_append (&list, &e->le);
+    }
+    for (uint32_t i = 0; i < nd; i++)
+      ddsrt_circlist_remove (&list, &es[i].le);
+    t1 = dds_time ();
+    printf ("deadline renew %"PRIu32" instances: circlist %.1fns/op", nd, (double) (t1 - t0) / (nd + nrenew));
+
+    tnow.v = DDS_SECS (1);
+    t0 = dds_time ();
+    for (uint32_t i = 0; i < nd; i++)
+    {
+      es[i].t.v = tnow.v + dur;
+      (void) expiry_insert (&adm, &es[i].e, es[i].t);
+    }
+    for (uint32_t i = 0; i < nrenew; i++)
+    {
+      struct bench_elem * const e = &es[ddsrt_random () % nd];
+      tnow.v += tstep;
+      e->t.v = tnow.v + dur;
+      expiry_move (&adm, &e->e, e->t);
+    }
+    for (uint32_t i = 0; i < nd; i++)
+      expiry_remove (&adm, &es[i].e);
+    t1 = dds_time ();
+    printf (" buckets %.1fns/op\n", (double) (t1 - t0) / (nd + nrenew));
+  }
+
+  /* lifespan: fibheap, register samples with increasing expiry times and
+     drop them in order of expiry */
+  ddsrt_fibheap_t fh;
+  ddsrt_fibheap_init (&bench_fhdef, &fh);
+  tnow.v = DDS_SECS (1);
+  t0 = dds_time ();
+  for (uint32_t i = 0; i < ninst; i++)
+  {
+    tnow.v += tstep;
+    es[i].t.v = tnow.v + dur;
+    ddsrt_fibheap_insert (&bench_fhdef, &fh, &es[i]);
+  }
+  for (uint32_t i = 0; i < ninst; i++)
+  {
+    struct bench_elem *e = ddsrt_fibheap_min (&bench_fhdef, &fh);
+    ddsrt_fibheap_delete (&bench_fhdef, &fh, e);
+  }
+  t1 = dds_time ();
+  printf ("lifespan: fibheap %.1fns/sample", (double) (t1 - t0) / ninst);
+
+  /* lifespan: buckets */
+  tnow.v = DDS_SECS (1);
+  t0 = dds_time ();
+  for (uint32_t i = 0; i < ninst; i++)
+  {
+    tnow.v += tstep;
+    es[i].t.v = tnow.v + dur;
+    (void) expiry_insert (&adm, &es[i].e, es[i].t);
+  }
+  struct expiry_node *node;
+  ddsrt_mtime_t tnext;
+  while ((node = expiry_next_due (&adm, DDSRT_MTIME_NEVER, &tnext)) != NULL)
+    expiry_remove (&adm, node);
+  t1 = dds_time ();
+  printf (" buckets %.1fns/sample\n", (double) (t1 - t0) / ninst);
+  const bool ok = expiry_adm_empty (&adm);
+  expiry_adm_fini (&adm);
+  ddsrt_free (es);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/threads.h"
+#include "dds/ddsi/q_entity.h"
+#include "dds/ddsi/q_gc.h"
+#include "dds/ddsi/q_addrset.h"
+#include "dds/ddsi/q_thread.h"
+#include "dds/ddsi/q_protocol.h"
+#include "dds/ddsi/ddsi_plist.h"
+#include "dds/ddsi/ddsi_domaingv.h"
+#include "dds/ddsi/ddsi_entity_index.h"
+#include "dds__entity.h"
+
+/* Benchmark of the teardown of a large remote participant: all its proxy
+   endpoints are deleted in one go, each through the garbage collector, while
+   another thread keeps the garbage collector waiting most of the time.
+
+   Usage: gc_bench [NENDPOINTS] */
+
+#define CHECK(x) do { if (!(x)) { fprintf (stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #x); abort (); } } while (0)
+
+static void create_proxy_endpoints (struct ddsi_domaingv *gv, const ddsi_guid_t *ppguid, uint32_t n)
+{
+  struct addrset *as = new_addrset ();
+  ddsi_plist_t plist;
+  ddsi_plist_init_empty (&plist);
+  plist.qos.present |= QP_TOPIC_NAME | QP_TYPE_NAME;
+  plist.qos.topic_name = ddsrt_strdup ("gc_teardown");
+  plist.qos.type_name = ddsrt_strdup ("gc_teardown_type");
+  for (uint32_t i = 0; i < n; i++)
+  {
+    const bool is_writer = (i % 2) == 0;
+    ddsi_guid_t guid = { .prefix = ppguid->prefix, .entityid = { .u = ((i + 1) << 8) | (is_writer ? NN_ENTITYID_KIND_WRITER_WITH_KEY : NN_ENTITYID_KIND_READER_WITH_KEY) } };
+    ddsi_plist_t eplist;
+    ddsi_plist_init_empty (&eplist);
+    ddsi_plist_mergein_missing (&eplist, &plist, ~(uint64_t)0, ~(uint64_t)0);
+    ddsi_xqos_mergein_missing (&eplist.qos, is_writer ? &gv->default_xqos_wr : &gv->default_xqos_rd, ~(uint64_t)0);
+    if (is_writer)
+      CHECK (new_proxy_writer (gv, ppguid, &guid, as, &eplist, gv->user_dqueue, gv->xevents, ddsrt_time_wallclock (), 1) == 0);
+    else
+    {
+#ifdef DDSI_INCLUDE_SSM
+      CHECK (new_proxy_reader (gv, ppguid, &guid, as, &eplist, ddsrt_time_wallclock (), 1, 0) == 0);
+#else
+      CHECK (new_proxy_reader (gv, ppguid, &guid, as, &eplist, ddsrt_time_wallclock (), 1) == 0);
+#endif
+    }
+    ddsi_plist_fini (&eplist);
+  }
+  ddsi_plist_fini (&plist);
+  unref_addrset (as);
+}
+
+struct busy_arg {
+  struct ddsi_domaingv *gv;
+  ddsrt_atomic_uint32_t stop;
+};
+
+static uint32_t busy_thread (void *varg)
+{
+  /* Mimics a receive thread processing a steady stream of packets, which
+     only occasionally allows the garbage collector to make progress */
+  struct busy_arg * const arg = varg;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+  while (!ddsrt_atomic_ld32 (&arg->stop))
+  {
+    thread_state_awake (ts1, arg->gv);
+    const dds_time_t tend = dds_time () + DDS_USECS (500);
+    while (dds_time () < tend)
+      ;
+    thread_state_asleep (ts1);
+  }
+  return 0;
+}
+
+int main (int argc, char **argv)
+{
+  const uint32_t n = (argc > 1) ? (uint32_t) atoi (argv[1]) : 10000;
+  const dds_entity_t pp = dds_create_participant (DDS_DOMAIN_DEFAULT, NULL, NULL);
+  CHECK (pp > 0);
+  struct dds_entity *x;
+  CHECK (dds_entity_pin (pp, &x) == DDS_RETCODE_OK);
+  struct ddsi_domaingv * const gv = &x->m_domain->gv;
+  struct thread_state1 * const ts1 = lookup_thread_state ();
+
+  ddsi_guid_t ppguid;
+  memset (&ppguid, 0, sizeof (ppguid));
+  ppguid.prefix.u[0] = 0x12345678;
+  ppguid.prefix.u[1] = 0x9abcdef0;
+  ppguid.prefix.u[2] = 1;
+  ppguid.entityid.u = NN_ENTITYID_PARTICIPANT;
+  ddsi_plist_t ppplist;
+  ddsi_plist_init_empty (&ppplist);
+
+  thread_state_awake (ts1, gv);
+  new_proxy_participant (gv, &ppguid, 0, NULL, new_addrset (), new_addrset (), &ppplist, DDS_INFINITY, NN_VENDORID_ECLIPSE, 0, ddsrt_time_wallclock (), 1);
+  create_proxy_endpoints (gv, &ppguid, n);
+  thread_state_asleep (ts1);
+  ddsi_plist_fini (&ppplist);
+
+  struct busy_arg arg = { .gv = gv, .stop = DDSRT_ATOMIC_UINT32_INIT (0) };
+  ddsrt_thread_t tid;
+  ddsrt_threadattr_t tattr;
+  ddsrt_threadattr_init (&tattr);
+  CHECK (ddsrt_thread_create (&tid, "busy", &tattr, busy_thread, &arg) == DDS_RETCODE_OK);
+
+  const dds_time_t t0 = dds_time ();
+  thread_state_awake (ts1, gv);
+  CHECK (delete_proxy_participant_by_guid (gv, &ppguid, ddsrt_time_wallclock (), 1) == 0);
+  thread_state_asleep (ts1);
+  gcreq_queue_drain (gv->gcreq_queue);
+  const dds_time_t t1 = dds_time ();
+  printf ("teardown of %"PRIu32" proxy endpoints: %.3fs\n", n, (double) (t1 - t0) / 1e9);
+
+  ddsrt_atomic_st32 (&arg.stop, 1);
+  ddsrt_thread_join (tid, NULL);
+
+  thread_state_awake (ts1, gv);
+  CHECK (entidx_lookup_proxy_participant_guid (gv->entity_index, &ppguid) == NULL);
+  thread_state_asleep (ts1);
+  dds_entity_unpin (x);
+  dds_delete (pp);
+  return 0;
+}
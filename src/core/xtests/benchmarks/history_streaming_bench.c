@@ -0,0 +1,108 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/environ.h"
+#include "dds/ddsrt/process.h"
+#include "HistoryStreamingTypes.h"
+
+/* Benchmark of the time it takes a late-joining reader in another domain to
+   receive the history of many instances, once with the reader requesting the
+   samples in response to heartbeats and once with the writer streaming them
+   (Internal/HistoricalDataStreaming).  The time includes discovery, which is
+   the same in both cases.
+
+   Usage: history_streaming_bench [NINSTANCES [BURSTSIZE]] */
+
+#define CONFIG "${CYCLONEDDS_URI}${CYCLONEDDS_URI:+,}<Discovery><ExternalDomainId>0</ExternalDomainId></Discovery><Internal><HistoricalDataStreaming>%s</HistoricalDataStreaming></Internal>"
+
+static dds_duration_t late_joiner_history_time (int32_t ninstances, const char *streaming)
+{
+  static uint32_t run = 0;
+  char config[256], topicname[100];
+  (void) snprintf (config, sizeof (config), CONFIG, streaming);
+  (void) snprintf (topicname, sizeof (topicname), "history_streaming_bench_%"PRIdPID"_%"PRIu32, ddsrt_getpid (), run++);
+  char *conf_pub = ddsrt_expand_envvars (config, 0);
+  char *conf_sub = ddsrt_expand_envvars (config, 1);
+  const dds_entity_t pub_dom = dds_create_domain (0, conf_pub);
+  const dds_entity_t sub_dom = dds_create_domain (1, conf_sub);
+  dds_free (conf_pub);
+  dds_free (conf_sub);
+  if (pub_dom < 0 || sub_dom < 0)
+  {
+    fprintf (stderr, "dds_create_domain: %s\n", dds_strretcode (pub_dom < 0 ? pub_dom : sub_dom));
+    exit (2);
+  }
+  const dds_entity_t pub_pp = dds_create_participant (0, NULL, NULL);
+  const dds_entity_t sub_pp = dds_create_participant (1, NULL, NULL);
+
+  dds_qos_t *qos = dds_create_qos ();
+  dds_qset_durability (qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+  dds_qset_reliability (qos, DDS_RELIABILITY_RELIABLE, DDS_INFINITY);
+  dds_qset_history (qos, DDS_HISTORY_KEEP_LAST, 1);
+  const dds_entity_t pub_tp = dds_create_topic (pub_pp, &HistoryStreamingTypes_T_desc, topicname, qos, NULL);
+  const dds_entity_t sub_tp = dds_create_topic (sub_pp, &HistoryStreamingTypes_T_desc, topicname, qos, NULL);
+  const dds_entity_t wr = dds_create_writer (pub_pp, pub_tp, qos, NULL);
+  for (int32_t i = 0; i < ninstances; i++)
+  {
+    HistoryStreamingTypes_T sample = { i, 0 };
+    (void) dds_write (wr, &sample);
+  }
+
+  const dds_time_t t0 = dds_time ();
+  const dds_entity_t rd = dds_create_reader (sub_pp, sub_tp, qos, NULL);
+  dds_delete_qos (qos);
+  const dds_time_t tend = t0 + DDS_SECS (60);
+  int32_t count = 0;
+  while (count < ninstances && dds_time () < tend)
+  {
+    HistoryStreamingTypes_T buf[1000];
+    void *ptrs[1000];
+    dds_sample_info_t si[1000];
+    for (size_t i = 0; i < sizeof (ptrs) / sizeof (ptrs[0]); i++)
+      ptrs[i] = &buf[i];
+    const int32_t n = dds_take (rd, ptrs, si, sizeof (ptrs) / sizeof (ptrs[0]), sizeof (ptrs) / sizeof (ptrs[0]));
+    if (n < 0)
+      break;
+    else if (n == 0)
+      dds_sleepfor (DDS_MSECS (1));
+    count += n;
+  }
+  const dds_time_t t1 = dds_time ();
+  dds_delete (pub_dom);
+  dds_delete (sub_dom);
+  if (count != ninstances)
+  {
+    fprintf (stderr, "%s: received %"PRId32" of %"PRId32" instances\n", streaming, count, ninstances);
+    exit (1);
+  }
+  return t1 - t0;
+}
+
+int main (int argc, char **argv)
+{
+  const int32_t ninstances = (argc > 1) ? atoi (argv[1]) : 100000;
+  const char *burst = (argc > 2) ? argv[2] : "4 kB";
+  if (ninstances <= 0)
+  {
+    fprintf (stderr, "usage: %s [NINSTANCES > 0 [BURSTSIZE]]\n", argv[0]);
+    return 2;
+  }
+  const dds_duration_t t_request = late_joiner_history_time (ninstances, "0 B");
+  const dds_duration_t t_stream = late_joiner_history_time (ninstances, burst);
+  printf ("history of %"PRId32" instances: %.3fs on request, %.3fs streamed (%s bursts)\n",
+          ninstances, (double) t_request / 1e9, (double) t_stream / 1e9, burst);
+  return 0;
+}
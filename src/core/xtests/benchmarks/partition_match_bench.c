@@ -0,0 +1,111 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/random.h"
+#include "dds/ddsrt/string.h"
+#include "dds/ddsi/ddsi_xqos.h"
+#include "dds/ddsi/q_qosmatch.h"
+#include "dds/ddsi/ddsi_partition_match.h"
+
+/* Benchmark of matching the partitions of many endpoints spread over many
+   partitions (every endpoint in two of them, one in ten also using a wildcard),
+   for all reader/writer pairs, as happens during discovery; directly and using
+   the interned sets.
+
+   Usage: partition_match_bench [NENDPOINTS [NPARTITIONS]] */
+
+static void set_partitions (dds_qos_t *qos, uint32_t n, const char **names)
+{
+  ddsi_xqos_init_empty (qos);
+  qos->present |= QP_PARTITION;
+  qos->partition.n = n;
+  qos->partition.strs = ddsrt_malloc (n * sizeof (*qos->partition.strs));
+  for (uint32_t i = 0; i < n; i++)
+    qos->partition.strs[i] = ddsrt_strdup (names[i]);
+}
+
+int main (int argc, char **argv)
+{
+  const uint32_t nendpoints = (argc > 1) ? (uint32_t) atoi (argv[1]) : 10000;
+  const uint32_t npartitions = (argc > 2) ? (uint32_t) atoi (argv[2]) : 1000;
+  if (nendpoints < 2 || npartitions == 0)
+  {
+    fprintf (stderr, "usage: %s [NENDPOINTS >= 2 [NPARTITIONS > 0]]\n", argv[0]);
+    return 2;
+  }
+  const uint32_t nwr = nendpoints / 2, nrd = nendpoints - nwr;
+  dds_qos_t *qos = ddsrt_malloc (nendpoints * sizeof (*qos));
+  struct ddsi_partition_set **sets = ddsrt_malloc (nendpoints * sizeof (*sets));
+  struct ddsi_partition_match_cache *pmc = ddsi_partition_match_cache_new ();
+  char names[3][32];
+  const char *ns[3] = { names[0], names[1], names[2] };
+  for (uint32_t i = 0; i < nendpoints; i++)
+  {
+    (void) snprintf (names[0], sizeof (names[0]), "partition_%"PRIu32, ddsrt_random () % npartitions);
+    (void) snprintf (names[1], sizeof (names[1]), "partition_%"PRIu32, ddsrt_random () % npartitions);
+    (void) snprintf (names[2], sizeof (names[2]), "partition_%"PRIu32"*", ddsrt_random () % 100);
+    set_partitions (&qos[i], (i % 10) == 0 ? 3 : 2, ns);
+  }
+
+  dds_time_t t0, t1;
+  uint32_t nmatch_direct = 0, nmatch_cached = 0;
+  t0 = dds_time ();
+  for (uint32_t i = 0; i < nrd; i++)
+    for (uint32_t j = 0; j < nwr; j++)
+      nmatch_direct += (partitions_match_p (&qos[nwr + i], &qos[j]) != 0);
+  t1 = dds_time ();
+  printf ("match %"PRIu32" x %"PRIu32" endpoints: direct %.1fns/pair", nrd, nwr, (double) (t1 - t0) / ((double) nrd * nwr));
+
+  t0 = dds_time ();
+  for (uint32_t i = 0; i < nendpoints; i++)
+    sets[i] = ddsi_partition_set_ref (pmc, &qos[i]);
+  for (uint32_t i = 0; i < nrd; i++)
+    for (uint32_t j = 0; j < nwr; j++)
+      nmatch_cached += ddsi_partition_sets_match (pmc, sets[nwr + i], sets[j]);
+  t1 = dds_time ();
+  printf (" interned %.1fns/pair", (double) (t1 - t0) / ((double) nrd * nwr));
+
+  /* all readers and all writers using the same set, so that matching the same
+     pair of sets repeats */
+  for (uint32_t i = 0; i < nendpoints; i++)
+    ddsi_partition_set_unref (pmc, sets[i]);
+  uint32_t nmatch_repeated = 0;
+  t0 = dds_time ();
+  for (uint32_t i = 0; i < nendpoints; i++)
+    sets[i] = ddsi_partition_set_ref (pmc, &qos[(i % 2) ? 0 : nwr]);
+  for (uint32_t i = 0; i < nrd; i++)
+    for (uint32_t j = 0; j < nwr; j++)
+      nmatch_repeated += ddsi_partition_sets_match (pmc, sets[2 * i], sets[2 * j + 1]);
+  t1 = dds_time ();
+  printf (" repeated %.1fns/pair\n", (double) (t1 - t0) / ((double) nrd * nwr));
+
+  for (uint32_t i = 0; i < nendpoints; i++)
+  {
+    ddsi_partition_set_unref (pmc, sets[i]);
+    ddsi_xqos_fini (&qos[i]);
+  }
+  ddsi_partition_match_cache_free (pmc);
+  ddsrt_free (sets);
+  ddsrt_free (qos);
+  if (nmatch_direct != nmatch_cached)
+  {
+    fprintf (stderr, "direct and interned matching disagree: %"PRIu32" vs %"PRIu32"\n", nmatch_direct, nmatch_cached);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "dds/dds.h"
+#include "dds/ddsrt/log.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsi/q_radmin.h"
+
+/* Benchmark of receiving packets into buffers taken from the arena versus
+   buffers allocated on the heap, reporting the time and (if the performance
+   counters are accessible) the number of data TLB misses per packet.
+
+   Usage: radmin_bench [NPACKETS [ARENASIZE]] */
+
+#if defined (__linux)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static int dtlb_counter_open (void)
+{
+  struct perf_event_attr attr;
+  memset (&attr, 0, sizeof (attr));
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.size = sizeof (attr);
+  attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int) syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void dtlb_counter_start (int fd)
+{
+  if (fd >= 0)
+  {
+    (void) ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+    (void) ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+static bool dtlb_counter_stop (int fd, uint64_t *count)
+{
+  if (fd < 0)
+    return false;
+  (void) ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+  const bool ok = (read (fd, count, sizeof (*count)) == (ssize_t) sizeof (*count));
+  (void) close (fd);
+  return ok;
+}
+#else
+static int dtlb_counter_open (void) { return -1; }
+static void dtlb_counter_start (int fd) { (void) fd; }
+static bool dtlb_counter_stop (int fd, uint64_t *count) { (void) fd; (void) count; return false; }
+#endif
+
+/* Messages are kept alive for a while after being committed, by holding an
+   extra reference like the defragmenter, reorder admin and delivery queue do,
+   so that the receive buffers actually get used up and replaced */
+#define RETAIN 64
+
+static void rmsg_unref (struct nn_rmsg *rmsg)
+{
+  if (rmsg && ddsrt_atomic_dec32_nv (&rmsg->refcount) == 0)
+    nn_rmsg_free (rmsg);
+}
+
+static uint32_t receive_packets (struct nn_rbufpool *rbp, uint32_t npackets)
+{
+  struct nn_rmsg *retained[RETAIN];
+  uint32_t sum = 0;
+  memset (retained, 0, sizeof (retained));
+  for (uint32_t i = 0; i < npackets; i++)
+  {
+    struct nn_rmsg *rmsg;
+    if ((rmsg = nn_rmsg_new (rbp)) == NULL)
+    {
+      fprintf (stderr, "out of memory\n");
+      exit (1);
+    }
+    const uint32_t size = 256 + (i % 16) * 256;
+    unsigned char *payload = NN_RMSG_PAYLOAD (rmsg);
+    memset (payload, (int) (i & 0xff), size);
+    nn_rmsg_setsize (rmsg, size);
+    for (uint32_t j = 0; j < size; j += 64)
+      sum += payload[j];
+    ddsrt_atomic_inc32 (&rmsg->refcount);
+    nn_rmsg_commit (rmsg);
+    rmsg_unref (retained[i % RETAIN]);
+    retained[i % RETAIN] = rmsg;
+  }
+  for (uint32_t i = 0; i < RETAIN; i++)
+    rmsg_unref (retained[i]);
+  return sum;
+}
+
+int main (int argc, char **argv)
+{
+  const uint32_t npackets = (argc > 1) ? (uint32_t) atoi (argv[1]) : 2000000;
+  const uint32_t arena_size = (argc > 2) ? (uint32_t) atoi (argv[2]) : 16 * 1024 * 1024;
+  if (npackets == 0 || arena_size == 0)
+  {
+    fprintf (stderr, "usage: %s [NPACKETS > 0 [ARENASIZE > 0]]\n", argv[0]);
+    return 2;
+  }
+  struct ddsrt_log_cfg logcfg;
+  dds_log_cfg_init (&logcfg, 0, 0, NULL, NULL);
+  const uint32_t arena_sizes[] = { 0, arena_size };
+  uint32_t sums[2];
+  for (size_t i = 0; i < sizeof (arena_sizes) / sizeof (arena_sizes[0]); i++)
+  {
+    struct nn_rbufpool *rbp;
+    struct nn_rbufpool_stats st;
+    if ((rbp = nn_rbufpool_new (&logcfg, 1024 * 1024, 128 * 1024, arena_sizes[i])) == NULL)
+    {
+      fprintf (stderr, "nn_rbufpool_new failed\n");
+      return 1;
+    }
+    nn_rbufpool_setowner (rbp, ddsrt_thread_self ());
+    const int fd = dtlb_counter_open ();
+    uint64_t dtlb_misses;
+    dtlb_counter_start (fd);
+    const dds_time_t t0 = dds_time ();
+    sums[i] = receive_packets (rbp, npackets);
+    const dds_time_t t1 = dds_time ();
+    nn_rbufpool_get_stats (rbp, &st);
+    printf ("receive %s: %.1fns/packet", arena_sizes[i] ? "arena" : "heap", (double) (t1 - t0) / npackets);
+    if (dtlb_counter_stop (fd, &dtlb_misses))
+      printf (" %.3f dTLB misses/packet", (double) dtlb_misses / npackets);
+    else
+      printf (" dTLB misses not available");
+    printf (" (%"PRIu64" buffers from arena, %"PRIu64" from heap)\n", st.n_arena_allocs, st.n_heap_allocs);
+    nn_rbufpool_free (rbp);
+  }
+  return (sums[0] == sums[1]) ? 0 : 1;
+}
@@ -154,6 +154,7 @@ static uint64_t store (struct ddsi_tkmap *tkmap, struct dds_rhc *rhc, struct pro
   pwr_info.guid = wr->e.guid;
   pwr_info.iid = wr->e.iid;
   pwr_info.ownership_strength = wr->c.xqos->ownership_strength.value;
+  pwr_info.coherent_set_seq = 0;
 #ifdef DDSI_INCLUDE_LIFESPAN
   if (lifespan_expiry && (sd->statusinfo & (NN_STATUSINFO_UNREGISTER | NN_STATUSINFO_DISPOSE)) == 0)
     pwr_info.lifespan_exp = rand_texp();
@@ -532,6 +533,41 @@ static bool qcpred_attr3 (const void *vx)
   return (x->x % 3) == 0;
 }
 
+/* A family of distinct filters, more than fit in a single word of the query
+   condition bitmaps in the RHC */
+#define QCPRED_DIV(n) static bool qcpred_div##n (const void *vx) { \
+    const RhcTypes_T *x = vx; \
+    return ((x->x / n + x->k) % 2) == 0; \
+  }
+QCPRED_DIV (1)  QCPRED_DIV (2)  QCPRED_DIV (3)  QCPRED_DIV (4)  QCPRED_DIV (5)  QCPRED_DIV (6)
+QCPRED_DIV (7)  QCPRED_DIV (8)  QCPRED_DIV (9)  QCPRED_DIV (10) QCPRED_DIV (11) QCPRED_DIV (12)
+QCPRED_DIV (13) QCPRED_DIV (14) QCPRED_DIV (15) QCPRED_DIV (16) QCPRED_DIV (17) QCPRED_DIV (18)
+QCPRED_DIV (19) QCPRED_DIV (20) QCPRED_DIV (21) QCPRED_DIV (22) QCPRED_DIV (23) QCPRED_DIV (24)
+QCPRED_DIV (25) QCPRED_DIV (26) QCPRED_DIV (27) QCPRED_DIV (28) QCPRED_DIV (29) QCPRED_DIV (30)
+QCPRED_DIV (31) QCPRED_DIV (32) QCPRED_DIV (33) QCPRED_DIV (34) QCPRED_DIV (35) QCPRED_DIV (36)
+QCPRED_DIV (37) QCPRED_DIV (38) QCPRED_DIV (39) QCPRED_DIV (40) QCPRED_DIV (41) QCPRED_DIV (42)
+QCPRED_DIV (43) QCPRED_DIV (44) QCPRED_DIV (45) QCPRED_DIV (46) QCPRED_DIV (47) QCPRED_DIV (48)
+QCPRED_DIV (49) QCPRED_DIV (50) QCPRED_DIV (51) QCPRED_DIV (52) QCPRED_DIV (53) QCPRED_DIV (54)
+QCPRED_DIV (55) QCPRED_DIV (56) QCPRED_DIV (57) QCPRED_DIV (58) QCPRED_DIV (59) QCPRED_DIV (60)
+QCPRED_DIV (61) QCPRED_DIV (62) QCPRED_DIV (63) QCPRED_DIV (64) QCPRED_DIV (65) QCPRED_DIV (66)
+QCPRED_DIV (67) QCPRED_DIV (68) QCPRED_DIV (69) QCPRED_DIV (70) QCPRED_DIV (71) QCPRED_DIV (72)
+#undef QCPRED_DIV
+
+static dds_querycondition_filter_fn const qcpred_div[] = {
+  qcpred_div1,  qcpred_div2,  qcpred_div3,  qcpred_div4,  qcpred_div5,  qcpred_div6,
+  qcpred_div7,  qcpred_div8,  qcpred_div9,  qcpred_div10, qcpred_div11, qcpred_div12,
+  qcpred_div13, qcpred_div14, qcpred_div15, qcpred_div16, qcpred_div17, qcpred_div18,
+  qcpred_div19, qcpred_div20, qcpred_div21, qcpred_div22, qcpred_div23, qcpred_div24,
+  qcpred_div25, qcpred_div26, qcpred_div27, qcpred_div28, qcpred_div29, qcpred_div30,
+  qcpred_div31, qcpred_div32, qcpred_div33, qcpred_div34, qcpred_div35, qcpred_div36,
+  qcpred_div37, qcpred_div38, qcpred_div39, qcpred_div40, qcpred_div41, qcpred_div42,
+  qcpred_div43, qcpred_div44, qcpred_div45, qcpred_div46, qcpred_div47, qcpred_div48,
+  qcpred_div49, qcpred_div50, qcpred_div51, qcpred_div52, qcpred_div53, qcpred_div54,
+  qcpred_div55, qcpred_div56, qcpred_div57, qcpred_div58, qcpred_div59, qcpred_div60,
+  qcpred_div61, qcpred_div62, qcpred_div63, qcpred_div64, qcpred_div65, qcpred_div66,
+  qcpred_div67, qcpred_div68, qcpred_div69, qcpred_div70, qcpred_div71, qcpred_div72
+};
+
 static dds_readcond *get_condaddr (dds_entity_t x)
 {
   struct dds_entity *e;
@@ -579,7 +615,7 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
 #ifdef DDSI_INCLUDE_DEADLINE_MISSED
   dds_qset_deadline (qos, rand_deadline());
 #endif
-  /* two identical readers because we need 63 conditions while we can currently only attach 32 a single reader */
+  /* two identical readers, each with its own (identical) set of conditions */
   dds_entity_t rd[] = { dds_create_reader (pp, tp, qos, NULL), dds_create_reader (pp, tp, qos, NULL) };
   const size_t nrd = sizeof (rd) / sizeof (rd[0]);
   dds_delete_qos (qos);
@@ -616,34 +652,52 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     DDS_ALIVE_INSTANCE_STATE | DDS_NOT_ALIVE_NO_WRITERS_INSTANCE_STATE | DDS_NOT_ALIVE_DISPOSED_INSTANCE_STATE
   };
   const int nitab = (int) (sizeof (itab) / sizeof (itab[0]));
-  const int nconds = nstab * nvtab * nitab;
+  /* the first copy of the state masks alternates between filter0 and filter1, so
+     those are shared by many conditions; the other copies have many distinct filters */
+  const int nmasks = nstab * nvtab * nitab;
+  const int ncopies = 4;
+  const int nconds = ncopies * nmasks;
 
   dds_entity_t gdcond = dds_create_guardcondition (pp);
   dds_entity_t waitset = dds_create_waitset(pp);
   dds_waitset_attach(waitset, gdcond, 888);
 
-  /* create a conditions for every possible state mask */
-  assert (nconds == 63);
-  dds_entity_t conds[63];
-  dds_readcond *rhcconds[63];
+  /* create ncopies conditions for every possible state mask on each reader */
+  assert (nmasks == 63);
+  uint32_t condmasks[4 * 63];
+  dds_querycondition_filter_fn condfilters[4 * 63];
+  dds_entity_t conds[sizeof (rd) / sizeof (rd[0])][4 * 63];
+  dds_readcond *rhcconds[sizeof (rd) / sizeof (rd[0])][4 * 63];
+  assert (nconds == (int) (sizeof (condmasks) / sizeof (condmasks[0])));
   {
     int ci = 0;
-    for (int s = 0; s < nstab; s++)
-      for (int v = 0; v < nvtab; v++)
-        for (int i = 0; i < nitab; i++)
-        {
-          assert (ci / 32 < (int) (sizeof (rd) / sizeof (rd[0])));
-          conds[ci] = create_cond (rd[ci / 32], stab[s] | vtab[v] | itab[i], ((ci % 2) == 0) ? filter0 : filter1);
-          if (conds[ci] <= 0) abort ();
-          rhcconds[ci] = get_condaddr (conds[ci]);
-          if (print) {
-            char buf[18];
-            snprintf (buf, sizeof (buf), "conds[%d]", ci);
-            print_cond_w_addr (buf, conds[ci]);
+    for (int c = 0; c < ncopies; c++)
+      for (int s = 0; s < nstab; s++)
+        for (int v = 0; v < nvtab; v++)
+          for (int i = 0; i < nitab; i++)
+          {
+            condmasks[ci] = stab[s] | vtab[v] | itab[i];
+            if (c == 0 || filter0 == 0)
+              condfilters[ci] = ((ci % 2) == 0) ? filter0 : filter1;
+            else
+              condfilters[ci] = qcpred_div[ci % (int) (sizeof (qcpred_div) / sizeof (qcpred_div[0]))];
+            ci++;
           }
-          dds_waitset_attach(waitset, conds[ci], ci);
-          ci++;
-        }
+  }
+  for (size_t k = 0; k < nrd; k++)
+  {
+    for (int ci = 0; ci < nconds; ci++)
+    {
+      conds[k][ci] = create_cond (rd[k], condmasks[ci], condfilters[ci]);
+      if (conds[k][ci] <= 0) abort ();
+      rhcconds[k][ci] = get_condaddr (conds[k][ci]);
+      if (print && k == 0) {
+        char buf[18];
+        snprintf (buf, sizeof (buf), "conds[%d]", ci);
+        print_cond_w_addr (buf, conds[k][ci]);
+      }
+      dds_waitset_attach(waitset, conds[k][ci], (dds_attach_t) (k * (size_t) nconds + (size_t) ci));
+    }
   }
 
   /* simply sanity check on the guard condition and waitset triggering */
@@ -684,7 +738,8 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     [10] = "tkc1",
     [11] = "delwr",
     [12] = "drpxp",
-    [13] = "dlmis"
+    [13] = "dlmis",
+    [14] = "recond"
   };
   static const uint32_t opfreqs[] = {
     [0]  = 500, /* write */
@@ -705,10 +760,11 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
     [12] = 0,   /* drop expired sample */
 #endif
 #ifdef DDSI_INCLUDE_DEADLINE_MISSED
-    [13] = 100  /* deadline missed */
+    [13] = 100, /* deadline missed */
 #else
-    [13] = 0    /* drop expired sample */
+    [13] = 0,   /* drop expired sample */
 #endif
+    [14] = 10   /* delete and recreate a condition */
   };
   uint32_t opthres[sizeof (opfreqs) / sizeof (opfreqs[0])];
   {
@@ -808,19 +864,19 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
       case 8: {
         uint32_t cond = ddsrt_prng_random (&prng) % (uint32_t) nconds;
         for (size_t k = 0; k < nrd; k++)
-          rdcond (rhc[k], rhcconds[cond], NULL, 0, print && k == 0, states_seen);
+          rdcond (rhc[k], rhcconds[k][cond], NULL, 0, print && k == 0, states_seen);
         break;
       }
       case 9: {
         uint32_t cond = ddsrt_prng_random (&prng) % (uint32_t) nconds;
         for (size_t k = 0; k < nrd; k++)
-          tkcond (rhc[k], rhcconds[cond], NULL, 0, print && k == 0, states_seen);
+          tkcond (rhc[k], rhcconds[k][cond], NULL, 0, print && k == 0, states_seen);
         break;
       }
       case 10: {
         uint32_t cond = ddsrt_prng_random (&prng) % (uint32_t) nconds;
         for (size_t k = 0; k < nrd; k++)
-          tkcond (rhc[k], rhcconds[cond], NULL, 1, print && k == 0, states_seen);
+          tkcond (rhc[k], rhcconds[k][cond], NULL, 1, print && k == 0, states_seen);
         break;
       }
       case 11: {
@@ -830,6 +886,7 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
         wr_info.guid = wr[which]->e.guid;
         wr_info.iid = wr[which]->e.iid;
         wr_info.ownership_strength = wr[which]->c.xqos->ownership_strength.value;
+        wr_info.coherent_set_seq = 0;
 #ifdef DDSI_INCLUDE_LIFESPAN
         wr_info.lifespan_exp = DDSRT_MTIME_NEVER;
 #endif
@@ -858,6 +915,21 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
 #endif
         break;
       }
+      case 14: {
+        /* deleting the last condition with some filter frees its slot in the bitmaps,
+           which may then get reused by a different filter */
+        const uint32_t cond = ddsrt_prng_random (&prng) % (uint32_t) nconds;
+        for (size_t k = 0; k < nrd; k++)
+        {
+          dds_waitset_detach (waitset, conds[k][cond]);
+          dds_delete (conds[k][cond]);
+          conds[k][cond] = create_cond (rd[k], condmasks[cond], condfilters[cond]);
+          if (conds[k][cond] <= 0) abort ();
+          rhcconds[k][cond] = get_condaddr (conds[k][cond]);
+          dds_waitset_attach (waitset, conds[k][cond], (dds_attach_t) (k * (size_t) nconds + cond));
+        }
+        break;
+      }
     }
 
     if ((i % 200) == 0)
@@ -875,12 +947,14 @@ static void test_conditions (dds_entity_t pp, dds_entity_t tp, const int count,
   }
 
   dds_waitset_detach (waitset, gdcond);
-  for (int ci = 0; ci < nconds; ci++)
-    dds_waitset_detach (waitset, conds[ci]);
+  for (size_t k = 0; k < nrd; k++)
+    for (int ci = 0; ci < nconds; ci++)
+      dds_waitset_detach (waitset, conds[k][ci]);
   dds_delete (waitset);
   dds_delete (gdcond);
-  for (int ci = 0; ci < nconds; ci++)
-    dds_delete (conds[ci]);
+  for (size_t k = 0; k < nrd; k++)
+    for (int ci = 0; ci < nconds; ci++)
+      dds_delete (conds[k][ci]);
   for (size_t i = 0; i < nrd; i++)
     dds_delete (rd[i]);
   for (size_t i = 0; i < sizeof (wr) / sizeof (wr[0]); i++)
@@ -961,6 +1035,7 @@ int main (int argc, char **argv)
     wr0_info.guid = wr0->e.guid;
     wr0_info.iid = wr0->e.iid;
     wr0_info.ownership_strength = wr0->c.xqos->ownership_strength.value;
+    wr0_info.coherent_set_seq = 0;
 #ifdef DDSI_INCLUDE_LIFESPAN
     wr0_info.lifespan_exp = DDSRT_MTIME_NEVER;
 #endif
@@ -12,6 +12,7 @@
 #ifndef DDSRT_THREAD_POOL_H
 #define DDSRT_THREAD_POOL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "dds/export.h"
@@ -62,6 +63,26 @@ DDS_EXPORT dds_return_t ddsrt_thread_pool_submit
   void * arg            /* Argument passed to invoked function */
 );
 
+/*
+  ddsrt_thread_pool_submit_batch: Invoke fn for each of the n arguments in the
+  array args (each of size argsize), using threads from the pool as well as the
+  calling thread, and return once all invocations have completed. The jobs are
+  divided over per-thread deques from which idle participants steal, so no
+  locking or allocation takes place per job. Threads are created on demand
+  within the pool maximum; if none are available, the calling thread executes
+  all jobs itself.
+*/
+
+DDS_EXPORT void ddsrt_thread_pool_submit_batch
+(
+  ddsrt_thread_pool pool,  /* Thread pool instance */
+  void (*fn) (void *ctx, void *arg), /* Function to be invoked for each argument */
+  void * ctx,           /* Context passed to all invocations */
+  void * args,          /* Array of n arguments */
+  size_t argsize,       /* Size of an element of args */
+  uint32_t n            /* Number of arguments */
+);
+
 #if defined (__cplusplus)
 }
 #endif
@@ -9,14 +9,24 @@
  *
  * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
  */
+#include <assert.h>
+#include <stdbool.h>
 #include <string.h>
 
+#include "dds/ddsrt/atomics.h"
 #include "dds/ddsrt/io.h"
 #include "dds/ddsrt/heap.h"
 #include "dds/ddsrt/sync.h"
 #include "dds/ddsrt/threads.h"
 #include "dds/ddsrt/thread_pool.h"
 
+/* Maximum number of participants (pool threads plus submitting thread) in a
+   batch and maximum number of jobs in a batch: the range of jobs owned by a
+   participant is stored as a pair of 16-bit indices in a single 32-bit word,
+   so that both the owner and thieves can update it with a single CAS */
+#define DDSRT_THREAD_POOL_MAX_SLOTS 32
+#define DDSRT_THREAD_POOL_MAX_BATCH 65535u
+
 typedef struct ddsi_work_queue_job
 {
     struct ddsi_work_queue_job * m_next_job; /* Jobs list pointer */
@@ -25,46 +35,165 @@ typedef struct ddsi_work_queue_job
 }
 * ddsi_work_queue_job_t;
 
+typedef struct ddsrt_thread_pool_batch
+{
+    struct ddsrt_thread_pool_batch * m_next; /* Pending batches list pointer */
+    void (*m_fn) (void *ctx, void *arg);      /* Job function */
+    void * m_ctx;                            /* Context shared by all jobs */
+    char * m_args;                           /* Array of job arguments */
+    size_t m_argsize;                        /* Size of a job argument */
+    uint32_t m_nslots;                       /* Number of participants */
+    uint32_t m_joined;                       /* Number of slots taken (guarded by pool mutex) */
+    uint32_t m_active;                       /* Number of participants still running (guarded by pool mutex) */
+    bool m_linked;                           /* Whether on pending batches list (guarded by pool mutex) */
+    ddsrt_cond_t m_cv;                       /* Signalled when m_active drops to 0 */
+    ddsrt_atomic_uint32_t m_slots[DDSRT_THREAD_POOL_MAX_SLOTS]; /* Per-participant job deques */
+}
+* ddsrt_thread_pool_batch_t;
+
+typedef struct ddsrt_thread_pool_worker
+{
+    struct ddsrt_thread_pool_worker * m_next; /* Workers list pointer */
+    ddsrt_thread_t m_tid;                     /* Thread id, for joining */
+    bool m_exited;                            /* Set when thread is about to terminate */
+}
+* ddsrt_thread_pool_worker_t;
+
 struct ddsrt_thread_pool_s
 {
     ddsi_work_queue_job_t m_jobs;      /* Job queue */
     ddsi_work_queue_job_t m_jobs_tail; /* Tail of job queue */
     ddsi_work_queue_job_t m_free;      /* Job free list */
+    ddsrt_thread_pool_batch_t m_batches; /* Batches waiting for participants */
+    ddsrt_thread_pool_worker_t m_workers; /* All threads that have not been joined yet */
     uint32_t m_thread_max;            /* Maximum number of threads */
     uint32_t m_thread_min;            /* Minimum number of threads */
     uint32_t m_threads;               /* Current number of threads */
-    uint32_t m_waiting;               /* Number of threads waiting for a job */
+    uint32_t m_idle;                  /* Number of threads not executing a job */
+    uint32_t m_excess;                /* Number of threads to terminate because of a purge */
     uint32_t m_job_count;             /* Number of queued jobs */
     uint32_t m_job_max;               /* Maximum number of jobs to queue */
+    bool m_terminate;                 /* Set when pool is being freed */
     unsigned short m_count;            /* Counter for thread name */
     ddsrt_threadattr_t m_attr;              /* Thread creation attribute */
     ddsrt_cond_t m_cv;                    /* Thread wait semaphore */
     ddsrt_mutex_t m_mutex;                  /* Pool guard mutex */
 };
 
-static uint32_t ddsrt_thread_start_fn (void * arg)
+struct ddsrt_thread_pool_start_arg
 {
-    ddsi_work_queue_job_t job;
-    ddsrt_thread_pool pool = (ddsrt_thread_pool) arg;
+    ddsrt_thread_pool pool;
+    ddsrt_thread_pool_worker_t self;
+};
+
+/* Takes the next job from the front of a deque, this is what the owner does */
+
+static bool ddsrt_thread_pool_claim_front (ddsrt_atomic_uint32_t *slot, uint32_t *idx)
+{
+    uint32_t v, lo, hi;
+    do {
+        v = ddsrt_atomic_ld32 (slot);
+        lo = v >> 16;
+        hi = v & 0xffff;
+        if (lo >= hi)
+            return false;
+    } while (!ddsrt_atomic_cas32 (slot, v, ((lo + 1) << 16) | hi));
+    *idx = lo;
+    return true;
+}
+
+/* Takes the last job from the back of a deque, this is what thieves do */
+
+static bool ddsrt_thread_pool_claim_back (ddsrt_atomic_uint32_t *slot, uint32_t *idx)
+{
+    uint32_t v, lo, hi;
+    do {
+        v = ddsrt_atomic_ld32 (slot);
+        lo = v >> 16;
+        hi = v & 0xffff;
+        if (lo >= hi)
+            return false;
+    } while (!ddsrt_atomic_cas32 (slot, v, (lo << 16) | (hi - 1)));
+    *idx = hi - 1;
+    return true;
+}
+
+static void ddsrt_thread_pool_run_batch (ddsrt_thread_pool_batch_t batch, uint32_t slot)
+{
+    uint32_t idx;
+
+    /* Drain own deque first, then steal from the others until all is gone */
+
+    while (ddsrt_thread_pool_claim_front (&batch->m_slots[slot], &idx))
+    {
+        batch->m_fn (batch->m_ctx, batch->m_args + idx * batch->m_argsize);
+    }
+    for (uint32_t k = 1; k < batch->m_nslots; k++)
+    {
+        uint32_t victim = (slot + k) % batch->m_nslots;
+        while (ddsrt_thread_pool_claim_back (&batch->m_slots[victim], &idx))
+        {
+            batch->m_fn (batch->m_ctx, batch->m_args + idx * batch->m_argsize);
+        }
+    }
+}
+
+static void ddsrt_thread_pool_unlink_batch (ddsrt_thread_pool pool, ddsrt_thread_pool_batch_t batch)
+{
+    ddsrt_thread_pool_batch_t *b = &pool->m_batches;
+    while (*b != batch)
+    {
+        b = &(*b)->m_next;
+    }
+    *b = batch->m_next;
+    batch->m_linked = false;
+}
+
+static uint32_t ddsrt_thread_start_fn (void * varg)
+{
+    struct ddsrt_thread_pool_start_arg * arg = varg;
+    ddsrt_thread_pool pool = arg->pool;
+    ddsrt_thread_pool_worker_t self = arg->self;
+    ddsrt_free (arg);
 
-    /* Thread loops, pulling jobs from queue */
+    /* Thread loops, taking part in batches and pulling jobs from queue */
 
     ddsrt_mutex_lock (&pool->m_mutex);
 
-    while (pool->m_jobs != NULL) {
-        /* Wait for job */
-        ddsrt_cond_wait (&pool->m_cv, &pool->m_mutex);
+    while (!pool->m_terminate)
+    {
+        if (pool->m_batches)
+        {
+            /* Join the oldest batch; it need not be advertised anymore once
+               all slots have been taken */
 
-        /* Check if pool deleted or being purged */
+            ddsrt_thread_pool_batch_t batch = pool->m_batches;
+            uint32_t slot = batch->m_joined++;
+            if (batch->m_joined == batch->m_nslots)
+            {
+                ddsrt_thread_pool_unlink_batch (pool, batch);
+            }
+            batch->m_active++;
+            pool->m_idle--;
+            ddsrt_mutex_unlock (&pool->m_mutex);
+
+            ddsrt_thread_pool_run_batch (batch, slot);
 
-        if (pool->m_jobs) {
+            ddsrt_mutex_lock (&pool->m_mutex);
+            pool->m_idle++;
+            if (--batch->m_active == 0)
+            {
+                ddsrt_cond_signal (&batch->m_cv);
+            }
+        }
+        else if (pool->m_jobs)
+        {
             /* Take job from queue head */
 
-            pool->m_waiting--;
-            job = pool->m_jobs;
+            ddsi_work_queue_job_t job = pool->m_jobs;
             pool->m_jobs = job->m_next_job;
             pool->m_job_count--;
-
+            pool->m_idle--;
             ddsrt_mutex_unlock (&pool->m_mutex);
 
             /* Do job */
@@ -74,42 +203,98 @@ static uint32_t ddsrt_thread_start_fn (void * arg)
             /* Put job back on free list */
 
             ddsrt_mutex_lock (&pool->m_mutex);
-            pool->m_waiting++;
+            pool->m_idle++;
             job->m_next_job = pool->m_free;
             pool->m_free = job;
         }
-    }
+        else if (pool->m_excess > 0)
+        {
+            /* Pool being purged */
 
-    if (--pool->m_threads) {
-        /* last to leave triggers thread_pool_free */
-        ddsrt_cond_broadcast (&pool->m_cv);
+            pool->m_excess--;
+            break;
+        }
+        else
+        {
+            /* Wait for job */
+
+            ddsrt_cond_wait (&pool->m_cv, &pool->m_mutex);
+        }
     }
+
+    pool->m_threads--;
+    pool->m_idle--;
+    self->m_exited = true;
     ddsrt_mutex_unlock (&pool->m_mutex);
     return 0;
 }
 
+static void ddsrt_thread_pool_reap (ddsrt_thread_pool pool, bool all)
+{
+    /* Joins terminated threads (or all threads), pool mutex must be held
+       unless "all" is set, in which case the threads must have been
+       told to terminate */
+
+    ddsrt_thread_pool_worker_t *w = &pool->m_workers;
+    while (*w)
+    {
+        ddsrt_thread_pool_worker_t worker = *w;
+        if (all || worker->m_exited)
+        {
+            (void) ddsrt_thread_join (worker->m_tid, NULL);
+            *w = worker->m_next;
+            ddsrt_free (worker);
+        }
+        else
+        {
+            w = &worker->m_next;
+        }
+    }
+}
+
 static dds_return_t ddsrt_thread_pool_new_thread (ddsrt_thread_pool pool)
 {
+    /* Must be called with pool mutex held */
+
     static unsigned char pools = 0; /* Pool counter - TODO make atomic */
 
     char name [64];
-    ddsrt_thread_t id;
     dds_return_t res;
+    ddsrt_thread_pool_worker_t worker;
+    struct ddsrt_thread_pool_start_arg * arg;
+
+    ddsrt_thread_pool_reap (pool, false);
+
+    worker = ddsrt_malloc (sizeof (*worker));
+    worker->m_exited = false;
+    arg = ddsrt_malloc (sizeof (*arg));
+    arg->pool = pool;
+    arg->self = worker;
 
     (void) snprintf (name, sizeof (name), "OSPL-%u-%u", pools++, pool->m_count++);
-    res = ddsrt_thread_create (&id, name, &pool->m_attr, &ddsrt_thread_start_fn, pool);
+    res = ddsrt_thread_create (&worker->m_tid, name, &pool->m_attr, &ddsrt_thread_start_fn, arg);
 
     if (res == DDS_RETCODE_OK)
     {
-        ddsrt_mutex_lock (&pool->m_mutex);
+        worker->m_next = pool->m_workers;
+        pool->m_workers = worker;
         pool->m_threads++;
-        pool->m_waiting++;
-        ddsrt_mutex_unlock (&pool->m_mutex);
+        pool->m_idle++;
+    }
+    else
+    {
+        ddsrt_free (arg);
+        ddsrt_free (worker);
     }
 
     return res;
 }
 
+static bool ddsrt_thread_pool_may_grow (ddsrt_thread_pool pool)
+{
+    return (pool->m_thread_max == 0) || (pool->m_threads < pool->m_thread_max);
+}
+
 ddsrt_thread_pool ddsrt_thread_pool_new (uint32_t threads, uint32_t max_threads, uint32_t max_queue, ddsrt_threadattr_t * attr)
 {
     ddsrt_thread_pool pool;
@@ -144,7 +329,11 @@ ddsrt_thread_pool ddsrt_thread_pool_new (uint32_t threads, uint32_t max_threads,
 
     while (threads--)
     {
-        if (ddsrt_thread_pool_new_thread (pool) != DDS_RETCODE_OK)
+        dds_return_t res;
+        ddsrt_mutex_lock (&pool->m_mutex);
+        res = ddsrt_thread_pool_new_thread (pool);
+        ddsrt_mutex_unlock (&pool->m_mutex);
+        if (res != DDS_RETCODE_OK)
         {
             ddsrt_thread_pool_free (pool);
             pool = NULL;
@@ -180,16 +369,16 @@ void ddsrt_thread_pool_free (ddsrt_thread_pool pool)
 
     /* Wake all waiting threads */
 
+    assert (pool->m_batches == NULL);
+    pool->m_terminate = true;
     ddsrt_cond_broadcast (&pool->m_cv);
 
     ddsrt_mutex_unlock (&pool->m_mutex);
 
     /* Wait for threads to complete */
 
-    ddsrt_mutex_lock (&pool->m_mutex);
-    while (pool->m_threads != 0)
-        ddsrt_cond_wait (&pool->m_cv, &pool->m_mutex);
-    ddsrt_mutex_unlock (&pool->m_mutex);
+    ddsrt_thread_pool_reap (pool, true);
+    assert (pool->m_threads == 0);
 
     /* Delete all free jobs from queue */
 
@@ -248,15 +437,12 @@ dds_return_t ddsrt_thread_pool_submit (ddsrt_thread_pool pool, void (*fn) (void
         pool->m_jobs_tail = job;
         pool->m_job_count++;
 
-        /* Allocate thread if more jobs than waiting threads and within maximum */
+        /* Allocate thread if more jobs than idle threads and within maximum */
 
-        if (pool->m_waiting < pool->m_job_count)
+        if (pool->m_idle < pool->m_job_count && ddsrt_thread_pool_may_grow (pool))
         {
-            if ((pool->m_thread_max == 0) || (pool->m_threads < pool->m_thread_max))
-            {
-                /* OK if fails as have queued job */
-                (void) ddsrt_thread_pool_new_thread (pool);
-            }
+            /* OK if fails as have queued job */
+            (void) ddsrt_thread_pool_new_thread (pool);
         }
 
         /* Wakeup processing thread */
@@ -269,16 +455,117 @@ dds_return_t ddsrt_thread_pool_submit (ddsrt_thread_pool pool, void (*fn) (void
     return res;
 }
 
-void ddsrt_thread_pool_purge (ddsrt_thread_pool pool)
+static void ddsrt_thread_pool_submit_batch1 (ddsrt_thread_pool pool, void (*fn) (void *ctx, void *arg), void * ctx, char * args, size_t argsize, uint32_t n)
+{
+    struct ddsrt_thread_pool_batch batch;
+    uint32_t helpers;
+
+    assert (n > 0 && n <= DDSRT_THREAD_POOL_MAX_BATCH);
+
+    ddsrt_mutex_lock (&pool->m_mutex);
+
+    /* Recruit as many threads as useful, creating them within the maximum if
+       there aren't enough idle ones */
+
+    helpers = (n - 1 < DDSRT_THREAD_POOL_MAX_SLOTS - 1) ? n - 1 : DDSRT_THREAD_POOL_MAX_SLOTS - 1;
+    while (pool->m_idle < helpers && ddsrt_thread_pool_may_grow (pool))
+    {
+        if (ddsrt_thread_pool_new_thread (pool) != DDS_RETCODE_OK)
+            break;
+    }
+    if (helpers > pool->m_idle)
+    {
+        helpers = pool->m_idle;
+    }
+
+    if (helpers == 0)
+    {
+        ddsrt_mutex_unlock (&pool->m_mutex);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            fn (ctx, args + i * argsize);
+        }
+        return;
+    }
+
+    /* Divide the jobs evenly over the participants, the submitting thread
+       takes the first slot */
+
+    batch.m_fn = fn;
+    batch.m_ctx = ctx;
+    batch.m_args = args;
+    batch.m_argsize = argsize;
+    batch.m_nslots = 1 + helpers;
+    batch.m_joined = 1;
+    batch.m_active = 1;
+    for (uint32_t i = 0; i < batch.m_nslots; i++)
+    {
+        uint32_t lo = (uint32_t) (((uint64_t) i * n) / batch.m_nslots);
+        uint32_t hi = (uint32_t) (((uint64_t) (i + 1) * n) / batch.m_nslots);
+        ddsrt_atomic_st32 (&batch.m_slots[i], (lo << 16) | hi);
+    }
+    ddsrt_cond_init (&batch.m_cv);
+
+    /* Add batch to end of list */
+
+    batch.m_next = NULL;
+    batch.m_linked = true;
+    {
+        ddsrt_thread_pool_batch_t *b = &pool->m_batches;
+        while (*b)
+        {
+            b = &(*b)->m_next;
+        }
+        *b = &batch;
+    }
+    if (helpers == 1)
+    {
+        ddsrt_cond_signal (&pool->m_cv);
+    }
+    else
+    {
+        ddsrt_cond_broadcast (&pool->m_cv);
+    }
+    ddsrt_mutex_unlock (&pool->m_mutex);
+
+    ddsrt_thread_pool_run_batch (&batch, 0);
+
+    /* All jobs have been claimed, wait for the other participants to complete
+       theirs: the batch lives on this stack */
+
+    ddsrt_mutex_lock (&pool->m_mutex);
+    if (batch.m_linked)
+    {
+        ddsrt_thread_pool_unlink_batch (pool, &batch);
+    }
+    batch.m_active--;
+    while (batch.m_active > 0)
+    {
+        ddsrt_cond_wait (&batch.m_cv, &pool->m_mutex);
+    }
+    ddsrt_mutex_unlock (&pool->m_mutex);
+    ddsrt_cond_destroy (&batch.m_cv);
+}
+
+void ddsrt_thread_pool_submit_batch (ddsrt_thread_pool pool, void (*fn) (void *ctx, void *arg), void * ctx, void * args, size_t argsize, uint32_t n)
 {
-    uint32_t total;
+    char * base = args;
+    while (n > 0)
+    {
+        uint32_t m = (n > DDSRT_THREAD_POOL_MAX_BATCH) ? DDSRT_THREAD_POOL_MAX_BATCH : n;
+        ddsrt_thread_pool_submit_batch1 (pool, fn, ctx, base, argsize, m);
+        base += m * argsize;
+        n -= m;
+    }
+}
 
+void ddsrt_thread_pool_purge (ddsrt_thread_pool pool)
+{
     ddsrt_mutex_lock (&pool->m_mutex);
-    total = pool->m_threads;
-    while (pool->m_waiting && (total > pool->m_thread_min))
+    if (pool->m_threads > pool->m_thread_min + pool->m_excess)
     {
-        pool->m_waiting--;
-        total--;
+        uint32_t surplus = pool->m_threads - pool->m_thread_min - pool->m_excess;
+        pool->m_excess += (surplus < pool->m_idle) ? surplus : pool->m_idle;
     }
     ddsrt_cond_broadcast (&pool->m_cv);
     ddsrt_mutex_unlock (&pool->m_mutex);
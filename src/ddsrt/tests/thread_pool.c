@@ -0,0 +1,94 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+#include <stdlib.h>
+
+#include "CUnit/Test.h"
+#include "dds/ddsrt/atomics.h"
+#include "dds/ddsrt/heap.h"
+#include "dds/ddsrt/sync.h"
+#include "dds/ddsrt/time.h"
+#include "dds/ddsrt/thread_pool.h"
+
+struct single_job_arg {
+  ddsrt_mutex_t lock;
+  ddsrt_cond_t cond;
+  uint32_t count;
+};
+
+static void single_job (void *varg)
+{
+  struct single_job_arg *arg = varg;
+  ddsrt_mutex_lock (&arg->lock);
+  arg->count++;
+  ddsrt_cond_broadcast (&arg->cond);
+  ddsrt_mutex_unlock (&arg->lock);
+}
+
+CU_Test(ddsrt_thread_pool, submit)
+{
+  struct single_job_arg arg;
+  ddsrt_thread_pool pool = ddsrt_thread_pool_new (2, 4, 0, NULL);
+  CU_ASSERT_FATAL (pool != NULL);
+  ddsrt_mutex_init (&arg.lock);
+  ddsrt_cond_init (&arg.cond);
+  arg.count = 0;
+  for (int i = 0; i < 100; i++)
+  {
+    dds_return_t rc = ddsrt_thread_pool_submit (pool, single_job, &arg);
+    CU_ASSERT_FATAL (rc == DDS_RETCODE_OK);
+  }
+  ddsrt_mutex_lock (&arg.lock);
+  while (arg.count < 100)
+    ddsrt_cond_wait (&arg.cond, &arg.lock);
+  ddsrt_mutex_unlock (&arg.lock);
+  CU_ASSERT_EQUAL (arg.count, 100);
+  ddsrt_thread_pool_purge (pool);
+  ddsrt_thread_pool_free (pool);
+  ddsrt_cond_destroy (&arg.cond);
+  ddsrt_mutex_destroy (&arg.lock);
+}
+
+static void batch_job (void *ctx, void *arg)
+{
+  ddsrt_atomic_uint32_t *total = ctx;
+  uint32_t *x = arg;
+  (*x)++;
+  ddsrt_atomic_inc32 (total);
+  if ((*x % 7) == 0)
+    dds_sleepfor (DDS_USECS (10));
+}
+
+static void run_batch (uint32_t threads, uint32_t max_threads, uint32_t n)
+{
+  ddsrt_atomic_uint32_t total = DDSRT_ATOMIC_UINT32_INIT (0);
+  uint32_t *xs = ddsrt_malloc (n * sizeof (*xs));
+  ddsrt_thread_pool pool = ddsrt_thread_pool_new (threads, max_threads, 0, NULL);
+  CU_ASSERT_FATAL (pool != NULL);
+  for (uint32_t i = 0; i < n; i++)
+    xs[i] = i;
+  ddsrt_thread_pool_submit_batch (pool, batch_job, &total, xs, sizeof (*xs), n);
+  /* every job must have been executed exactly once before returning */
+  CU_ASSERT_EQUAL (ddsrt_atomic_ld32 (&total), n);
+  for (uint32_t i = 0; i < n; i++)
+    CU_ASSERT_EQUAL_FATAL (xs[i], i + 1);
+  ddsrt_thread_pool_free (pool);
+  ddsrt_free (xs);
+}
+
+CU_Test(ddsrt_thread_pool, batch)
+{
+  run_batch (0, 1, 1);
+  run_batch (0, 1, 10);
+  run_batch (4, 4, 3);
+  run_batch (4, 8, 1000);
+  run_batch (2, 0, 70000);
+}
@@ -20,6 +20,7 @@ public class IdlParams
     timestamp = !opts.nostamp;
     quiet = opts.quiet;
     lax = opts.lax;
+    specialize = opts.specialize;
     mapwide = opts.mapwide;
     mapld = opts.mapld;
     forcpp = opts.forcpp;
@@ -33,6 +34,7 @@ public class IdlParams
   public boolean timestamp;
   public boolean quiet;
   public boolean lax;
+  public boolean specialize;
   public boolean mapwide;
   public boolean mapld;
   public boolean forcpp;
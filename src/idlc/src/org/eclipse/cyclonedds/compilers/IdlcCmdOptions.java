@@ -35,6 +35,7 @@ public class IdlcCmdOptions extends CmdOptions
     io.println ("   -notopics        Generate type definitions only");
     io.println ("   -nostamp         Do not timestamp generated code");
     io.println ("   -lax             Skip over structs containing unsupported datatypes");
+    io.println ("   -specialize      Generate type-specific (de)serializers where supported");
     io.println ("   -quiet           Suppress console output other than error messages (default)");
     io.println ("   -verbose         Enable console output other than error messages");
     io.println ("   -map_wide        Map the unsupported wchar and wstring types to char and string");
@@ -81,6 +82,10 @@ public class IdlcCmdOptions extends CmdOptions
     {
       lax = true;
     }
+    else if (arg1.equals ("-specialize"))
+    {
+      specialize = true;
+    }
     else if (arg1.equals ("-map_wide"))
     {
       mapwide = true;
@@ -118,6 +123,7 @@ public class IdlcCmdOptions extends CmdOptions
   public boolean nostamp;
   public boolean quiet         = true;
   public boolean lax;
+  public boolean specialize;
   public boolean mapwide;
   public boolean mapld;
   public boolean dumptokens;
@@ -175,7 +175,12 @@ public class ArrayType extends AbstractType
     return TypeUtil.deptest (subtype, deps, null);
   }
 
-  private long size()
+  Type getRealSubtype ()
+  {
+    return realsub;
+  }
+
+  long size ()
   {
     long result = 1;
     for (Long d : dimensions)
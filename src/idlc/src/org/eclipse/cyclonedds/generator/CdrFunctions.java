@@ -0,0 +1,310 @@
+/*
+ * Copyright(c) 2020 ADLINK Technology Limited and others
+ *
+ * This program and the accompanying materials are made available under the
+ * terms of the Eclipse Public License v. 2.0 which is available at
+ * http://www.eclipse.org/legal/epl-2.0, or the Eclipse Distribution License
+ * v. 1.0 which is available at
+ * http://www.eclipse.org/org/documents/edl-v10.php.
+ *
+ * SPDX-License-Identifier: EPL-2.0 OR BSD-3-Clause
+ */
+package org.eclipse.cyclonedds.generator;
+
+import java.util.*;
+
+/* Generates the type-specific (de)serializers for a topic type (-specialize).
+ * These are straight-line code equivalent to interpreting the marshalling ops
+ * using the same stream primitives.  Only types built from primitive types,
+ * strings, nested structs and arrays and sequences of (non-string) primitive
+ * types are supported; for other types nothing is generated and the
+ * interpreter remains in use. */
+public class CdrFunctions
+{
+  private enum Kind { PRIM, STRING, BSTRING, ARRAY, SEQUENCE };
+
+  private static class Field
+  {
+    private Field (String name, Kind kind, int size, long count, boolean key)
+    {
+      this.name = name;
+      this.kind = kind;
+      this.size = size;
+      this.count = count;
+      this.key = key;
+    }
+
+    private final String name;   // C expression relative to the sample
+    private final Kind kind;
+    private final int size;      // element size for PRIM, ARRAY and SEQUENCE
+    private final long count;    // bound + 1 for BSTRING, #elements for ARRAY
+    private final boolean key;
+  };
+
+  public CdrFunctions (StructType topic)
+  {
+    fields = new ArrayList <Field> ();
+    supported = flatten (topic, null);
+  }
+
+  public boolean isSupported ()
+  {
+    return supported;
+  }
+
+  private static Type resolve (Type t)
+  {
+    while (t instanceof TypedefType)
+    {
+      t = ((TypedefType)t).getRef ();
+    }
+    return t;
+  }
+
+  private static int primSize (Type t)
+  {
+    /* BasicType, but not a string */
+    if (!(t instanceof BasicType))
+    {
+      return 0;
+    }
+    switch (((BasicType)t).type)
+    {
+      case BOOLEAN: case OCTET: case CHAR:
+        return 1;
+      case SHORT: case USHORT:
+        return 2;
+      case LONG: case ULONG: case FLOAT:
+        return 4;
+      case LONGLONG: case ULONGLONG: case DOUBLE:
+        return 8;
+      default:
+        return 0;
+    }
+  }
+
+  private boolean flatten (StructType st, String prefix)
+  {
+    List <String> names = new ArrayList <String> ();
+    List <Type> types = new ArrayList <Type> ();
+    st.getMembers (names, types);
+    for (int i = 0; i < names.size (); i++)
+    {
+      String name = (prefix == null) ? names.get (i) : prefix + "." + names.get (i);
+      Type t = resolve (types.get (i));
+      int size;
+      if (t instanceof StructType)
+      {
+        if (!flatten ((StructType)t, name))
+        {
+          return false;
+        }
+      }
+      else if ((size = primSize (t)) > 0)
+      {
+        fields.add (new Field (name, Kind.PRIM, size, 1, t.isKeyField ()));
+      }
+      else if (t instanceof BasicType)
+      {
+        fields.add (new Field (name, Kind.STRING, 0, 0, t.isKeyField ()));
+      }
+      else if (t instanceof BoundedStringType)
+      {
+        long bound = ((BoundedStringType)t).getBound () + 1;
+        fields.add (new Field (name, Kind.BSTRING, 0, bound, t.isKeyField ()));
+      }
+      else if (t instanceof ArrayType && (size = primSize (((ArrayType)t).getRealSubtype ())) > 0)
+      {
+        long count = ((ArrayType)t).size ();
+        fields.add (new Field (name, Kind.ARRAY, size, count, t.isKeyField ()));
+      }
+      else if (t instanceof SequenceType && (size = primSize (((SequenceType)t).getRealSubtype ())) > 0)
+      {
+        fields.add (new Field (name, Kind.SEQUENCE, size, 0, false));
+      }
+      else
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  private void genWrite (StringBuffer str, String ctype)
+  {
+    str.append ("static void " + ctype + "_cdr_write (dds_ostream_t * __restrict os, const void * __restrict vsample)\n{\n");
+    str.append ("  const " + ctype + " *s = vsample;\n");
+    for (Field f : fields)
+    {
+      switch (f.kind)
+      {
+        case PRIM:
+          str.append ("  dds_os_put" + f.size + "p (os, &s->" + f.name + ");\n");
+          break;
+        case STRING: case BSTRING:
+          str.append ("  dds_stream_write_string (os, s->" + f.name + ");\n");
+          break;
+        case ARRAY:
+          str.append ("  dds_os_put_bytes_aligned (os, &s->" + f.name + ", " + f.count + ", " + f.size + ");\n");
+          break;
+        case SEQUENCE:
+          str.append ("  dds_stream_write_primseq (os, (const dds_sequence_t *) &s->" + f.name + ", " + f.size + ");\n");
+          break;
+      }
+    }
+    str.append ("}\n\n");
+  }
+
+  private void genRead (StringBuffer str, String ctype)
+  {
+    str.append ("static void " + ctype + "_cdr_read (dds_istream_t * __restrict is, void * __restrict vsample)\n{\n");
+    str.append ("  " + ctype + " *s = vsample;\n");
+    for (Field f : fields)
+    {
+      switch (f.kind)
+      {
+        case PRIM:
+          str.append ("  dds_is_get" + f.size + "p (is, &s->" + f.name + ");\n");
+          break;
+        case STRING:
+          str.append ("  s->" + f.name + " = dds_stream_reuse_string (is, s->" + f.name + ");\n");
+          break;
+        case BSTRING:
+          str.append ("  dds_stream_reuse_string_bound (is, s->" + f.name + ", " + f.count + ");\n");
+          break;
+        case ARRAY:
+          str.append ("  dds_is_get_bytes (is, &s->" + f.name + ", " + f.count + ", " + f.size + ");\n");
+          break;
+        case SEQUENCE:
+          str.append ("  dds_stream_read_primseq (is, (dds_sequence_t *) &s->" + f.name + ", " + f.size + ");\n");
+          break;
+      }
+    }
+    str.append ("}\n\n");
+  }
+
+  private void genNormalize (StringBuffer str, String ctype)
+  {
+    str.append ("static bool " + ctype + "_cdr_normalize (char * __restrict data, uint32_t * __restrict off, uint32_t size, bool bswap)\n{\n");
+    if (fields.isEmpty ())
+    {
+      str.append ("  (void) data;\n  (void) off;\n  (void) size;\n  (void) bswap;\n  return true;\n}\n\n");
+      return;
+    }
+    str.append ("  return");
+    String sep = "\n    ";
+    for (Field f : fields)
+    {
+      str.append (sep);
+      switch (f.kind)
+      {
+        case PRIM:
+          if (f.size == 1)
+          {
+            str.append ("dds_stream_normalize_uint8 (off, size)");
+          }
+          else
+          {
+            str.append ("dds_stream_normalize_uint" + (8 * f.size) + " (data, off, size, bswap)");
+          }
+          break;
+        case STRING:
+          str.append ("dds_stream_normalize_string (data, off, size, bswap, SIZE_MAX)");
+          break;
+        case BSTRING:
+          str.append ("dds_stream_normalize_string (data, off, size, bswap, " + f.count + ")");
+          break;
+        case ARRAY:
+          str.append ("dds_stream_normalize_primarray (data, off, size, bswap, " + f.count + ", " + f.size + ")");
+          break;
+        case SEQUENCE:
+          str.append ("dds_stream_normalize_primseq (data, off, size, bswap, " + f.size + ")");
+          break;
+      }
+      sep = " &&\n    ";
+    }
+    str.append (";\n}\n\n");
+  }
+
+  private boolean genExtractKey (StringBuffer str, String ctype)
+  {
+    int last = -1;
+    for (int i = 0; i < fields.size (); i++)
+    {
+      if (fields.get (i).key)
+      {
+        last = i;
+      }
+    }
+    if (last < 0)
+    {
+      return false;
+    }
+
+    /* Keys are extracted in member order, everything after the last key is
+       of no interest */
+    str.append ("static void " + ctype + "_cdr_extract_key (dds_istream_t * __restrict is, dds_ostream_t * __restrict os)\n{\n");
+    for (Field f : fields.subList (0, last + 1))
+    {
+      switch (f.kind)
+      {
+        case PRIM:
+          if (f.key)
+          {
+            str.append ("  dds_os_put" + f.size + " (os, dds_is_get" + f.size + " (is));\n");
+          }
+          else
+          {
+            str.append ("  dds_is_skip (is, 1, " + f.size + ");\n");
+          }
+          break;
+        case STRING: case BSTRING:
+          if (f.key)
+          {
+            str.append ("  dds_stream_extract_string (is, os);\n");
+          }
+          else
+          {
+            str.append ("  dds_stream_skip_string (is);\n");
+          }
+          break;
+        case ARRAY:
+          if (f.key)
+          {
+            long bytes = f.count * f.size;
+            str.append ("  dds_cdr_alignto_clear_and_resize (os, " + f.size + ", " + bytes + ");\n");
+            str.append ("  dds_is_get_bytes (is, os->m_buffer + os->m_index, " + f.count + ", " + f.size + ");\n");
+            str.append ("  os->m_index += " + bytes + ";\n");
+          }
+          else
+          {
+            str.append ("  dds_is_skip (is, " + f.count + ", " + f.size + ");\n");
+          }
+          break;
+        case SEQUENCE:
+          str.append ("  dds_stream_skip_primseq (is, " + f.size + ");\n");
+          break;
+      }
+    }
+    str.append ("}\n\n");
+    return true;
+  }
+
+  public String generate (String ctype)
+  {
+    StringBuffer str = new StringBuffer ();
+    genWrite (str, ctype);
+    genRead (str, ctype);
+    genNormalize (str, ctype);
+    boolean haskey = genExtractKey (str, ctype);
+    str.append ("const dds_topic_cdr_ops_t " + ctype + "_cdr_ops =\n{\n");
+    str.append ("  " + ctype + "_cdr_write,\n");
+    str.append ("  " + ctype + "_cdr_read,\n");
+    str.append ("  " + ctype + "_cdr_normalize,\n");
+    str.append ("  " + (haskey ? ctype + "_cdr_extract_key" : "NULL") + "\n};");
+    return str.toString ();
+  }
+
+  private final List <Field> fields;
+  private final boolean supported;
+}
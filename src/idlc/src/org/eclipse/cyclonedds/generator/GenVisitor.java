@@ -1188,6 +1188,7 @@ public class GenVisitor extends org.eclipse.cyclonedds.parser.IDLBaseVisitor <Vo
     ST topicST;
     StructType topicmeta;
     BufferedOutputStream bos = null;
+    boolean specialized = false;
 
     for (ScopedName topicname : topics.keySet ())
     {
@@ -1212,6 +1213,20 @@ public class GenVisitor extends org.eclipse.cyclonedds.parser.IDLBaseVisitor <Vo
         topicST.add ("flags", "DDS_TOPIC_CONTAINS_UNION");
       }
       topicST.add ("alignment", topicmeta.getAlignment ());
+      if (params.specialize)
+      {
+        CdrFunctions cdrfuncs = new CdrFunctions (topicmeta);
+        if (cdrfuncs.isSupported ())
+        {
+          topicST.add ("cdrops", cdrfuncs.generate (topicmeta.getCType ()));
+          topicST.add ("flags", "DDS_TOPIC_CDR_OPS");
+          specialized = true;
+        }
+      }
+    }
+    if (specialized)
+    {
+      file.add ("specialize", "true");
     }
 
     try
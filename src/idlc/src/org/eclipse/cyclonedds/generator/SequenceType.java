@@ -154,6 +154,11 @@ public class SequenceType extends AbstractType
     return TypeUtil.deptest (subtype, deps, null);
   }
 
+  Type getRealSubtype ()
+  {
+    return realsub;
+  }
+
   private final Type subtype;
   private Type realsub;
   private final String ctype;
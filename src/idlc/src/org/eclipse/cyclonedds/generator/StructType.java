@@ -41,6 +41,15 @@ public class StructType extends AbstractType implements NamedType
     members.add (new Member (name, type.dup ()));
   }
 
+  void getMembers (List <String> names, List <Type> types)
+  {
+    for (Member m : members)
+    {
+      names.add (m.name);
+      types.add (m.type);
+    }
+  }
+
   public int addKeyField (String fieldname)
   {
     // returns the offset in metadata of the field
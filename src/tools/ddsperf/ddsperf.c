@@ -1487,6 +1487,28 @@ static bool print_stats (dds_time_t tref, dds_time_t tnow, dds_time_t tprev, str
   return output;
 }
 
+static void print_latency_stats (void)
+{
+  /* Only available if built with ENABLE_LATENCY_STATS and enabled in the configuration
+     (Internal/LatencyStatistics), silently skip it otherwise */
+  dds_latency_stats_t ls;
+  char prefix[128];
+  if (dds_get_latency_stats (dp, &ls) != DDS_RETCODE_OK)
+    return;
+  snprintf (prefix, sizeof (prefix), "[%"PRIdPID"]", ddsrt_getpid ());
+  for (int i = 0; i < DDS_LATENCY_NSTAGES; i++)
+  {
+    const dds_latency_stage_stats_t *s = &ls.stage[i];
+    if (s->count == 0)
+      continue;
+    printf ("%s latency %-10s mean %.3fus min %.3fus 50%% %.3fus 90%% %.3fus 99%% %.3fus 99.9%% %.3fus max %.3fus cnt %"PRIu64"\n",
+            prefix, s->name, (double) s->mean / 1e3, (double) s->min / 1e3,
+            (double) s->p50 / 1e3, (double) s->p90 / 1e3, (double) s->p99 / 1e3, (double) s->p999 / 1e3,
+            (double) s->max / 1e3, s->count);
+  }
+  fflush (stdout);
+}
+
 static void subthread_arg_init (struct subthread_arg *arg, dds_entity_t rd, uint32_t max_samples)
 {
   arg->rd = rd;
@@ -2386,6 +2408,7 @@ int main (int argc, char *argv[])
   subthread_arg_fini (&subarg_data);
   subthread_arg_fini (&subarg_ping);
   subthread_arg_fini (&subarg_pong);
+  print_latency_stats ();
   dds_delete (dp);
   ddsrt_mutex_destroy (&disc_lock);
   ddsrt_mutex_destroy (&pongwr_lock);